@@ -35,6 +35,22 @@ void log_test(chr_t *test, stringer_t *error) {
 	return;
 }
 
+/**
+ * @brief Print the measurements taken by a timing check, on the line below its result. The checks run with the log disabled, so
+		the measurements are held until the result has been printed.
+ * @param measured	The measurements to print, which may be NULL or empty if nothing was measured.
+ */
+void log_measure(stringer_t *measured) {
+
+	log_enable();
+
+	if (st_populated(measured)) {
+		log_unit("    %.*s\n", st_length_int(measured), st_char_get(measured));
+	}
+
+	return;
+}
+
 Suite * suite_check_magma(void) {
   Suite *s = suite_create("\n\tMagma");
   return s;
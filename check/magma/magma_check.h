@@ -45,6 +45,7 @@ extern int case_timeout;
 //#define testcase(s, tc, name, func) tcase_add_test((tc = tcase_create(name)), func); tcase_set_timeout(tc, case_timeout); suite_add_tcase(s, tc)
 
 Suite * suite_check_sample(void);
+void log_measure(stringer_t *measured);
 void log_test(chr_t *test, stringer_t *error);
 void suite_check_testcase(Suite *s, const char *tags, const char *name, TFun func);
 
@@ -124,8 +125,20 @@ void suite_check_testcase(Suite *s, const char *tags, const char *name, TFun fun
 
 #define OBJECT_CHECK_ITERATIONS 16
 
+#define PATTERN_CHECK_PATTERNS 4096
+#define PATTERN_CHECK_MESSAGE_SIZE (1024 * 1024) // 1 megabyte
+#define PATTERN_CHECK_NAIVE_SIZE (64 * 1024) // 64 kilobytes
+
 #define MAIL_CHECK_LOAD_MAX 64 // Maximum number of messages loaded per user.
 
+#define IMAP_CHECK_PARSE_LENGTH 128
+#define IMAP_CHECK_PARSE_ITERATIONS 1024
+#define IMAP_CHECK_PARSE_ROUNDS 1024
+
+#define SMTP_CHECK_CHUNKING_SIZE (4 * 1024 * 1024) // 4 megabytes
+#define SMTP_CHECK_CHUNKING_CHUNK (1024 * 1024) // 1 megabyte
+#define SMTP_CHECK_DATA_ROUNDS 16
+
 #define REGRESSION_CHECK_FILE_DESCRIPTORS_LEAK_MTHREADS 8
 
 //! Exhaustive Test
@@ -208,8 +221,20 @@ void suite_check_testcase(Suite *s, const char *tags, const char *name, TFun fun
 
 #define OBJECT_CHECK_ITERATIONS 256
 
+#define PATTERN_CHECK_PATTERNS 16384
+#define PATTERN_CHECK_MESSAGE_SIZE (16 * 1024 * 1024) // 16 megabytes
+#define PATTERN_CHECK_NAIVE_SIZE (64 * 1024) // 64 kilobytes
+
 #define MAIL_CHECK_LOAD_MAX UINT64_MAX // Maximum number of messages loaded per user.
 
+#define IMAP_CHECK_PARSE_LENGTH 1024
+#define IMAP_CHECK_PARSE_ITERATIONS 65536
+#define IMAP_CHECK_PARSE_ROUNDS 65536
+
+#define SMTP_CHECK_CHUNKING_SIZE (8 * 1024 * 1024) // 8 megabytes
+#define SMTP_CHECK_CHUNKING_CHUNK (256 * 1024) // 256 kilobytes
+#define SMTP_CHECK_DATA_ROUNDS 256
+
 #define REGRESSION_CHECK_FILE_DESCRIPTORS_LEAK_MTHREADS 32
 
 #endif
@@ -0,0 +1,85 @@
+
+/**
+ * @file /magma/check/magma/mail/envelopes_check.c
+ */
+
+#include "magma_check.h"
+
+bool_t check_mail_envelopes_sthread(stringer_t *errmsg) {
+
+	bool_t result = true;
+	stringer_t *data = NULL;
+	mail_envelope_t *envelope = NULL;
+	uint32_t max = check_message_max();
+	stringer_t *sample = NULLER("From: Sender <sender@example.com>\r\nTo: recipient@example.com\r\nSubject: Envelope Test\r\n" \
+		"Content-Type: text/plain\r\nContent-Transfer-Encoding: quoted-printable\r\n\r\nHello,=0D=0A\r\n\r\n   world=3D \t again\r\n");
+
+	// Check the fields and snippet generated for a known message.
+	if (!(envelope = mail_envelope_build(sample))) {
+		st_sprint(errmsg, "Envelope generation failed for the sample message.");
+		result = false;
+	}
+	else if (st_cmp_cs_eq(envelope->subject, PLACER("Envelope Test", 13)) || st_cmp_cs_eq(envelope->to, PLACER("recipient@example.com", 21))) {
+		st_sprint(errmsg, "The sample envelope header fields didn't match.");
+		result = false;
+	}
+	else if (st_cmp_cs_eq(envelope->snippet, PLACER("Hello, world= again", 19))) {
+		st_sprint(errmsg, "The sample envelope snippet didn't match. { snippet = %.*s }", st_length_int(envelope->snippet), st_char_get(envelope->snippet));
+		result = false;
+	}
+
+	mail_envelope_free(envelope);
+	envelope = NULL;
+
+	// Check the identifiers extracted for threading, which fall back to In-Reply-To when the References header is missing.
+	if (result && !(envelope = mail_envelope_build(NULLER("Message-ID: <three@example.com>\r\nIn-Reply-To: Someone <two@example.com>\r\n" \
+		"References: <one@example.com>\r\n\t(comment) <two@example.com>\r\nSubject: Re: Envelope Test\r\n\r\nHello\r\n")))) {
+		st_sprint(errmsg, "Envelope generation failed for the threaded sample message.");
+		result = false;
+	}
+	else if (result && (st_cmp_cs_eq(envelope->message_id, PLACER("<three@example.com>", 19)) ||
+		st_cmp_cs_eq(envelope->references, PLACER("<one@example.com> <two@example.com>", 35)))) {
+		st_sprint(errmsg, "The threaded sample envelope identifiers didn't match.");
+		result = false;
+	}
+
+	mail_envelope_free(envelope);
+	envelope = NULL;
+
+	if (result && !(envelope = mail_envelope_build(NULLER("Message-ID: <four@example.com>\r\nIn-Reply-To: <three@example.com> <two@example.com>\r\n\r\nHello\r\n")))) {
+		st_sprint(errmsg, "Envelope generation failed for the reply sample message.");
+		result = false;
+	}
+	else if (result && st_cmp_cs_eq(envelope->references, PLACER("<three@example.com>", 19))) {
+		st_sprint(errmsg, "The reply sample envelope references didn't match.");
+		result = false;
+	}
+
+	mail_envelope_free(envelope);
+	envelope = NULL;
+
+	// Make sure every sample message yields an envelope within the size limits.
+	for (uint32_t i = 0; i < max && result && status(); i++) {
+
+		if (!(data = check_message_get(i))) {
+			st_sprint(errmsg, "Failed to get the message data. { message = %i }", i);
+			result = false;
+		}
+		else if (!(envelope = mail_envelope_build(data))) {
+			st_sprint(errmsg, "Envelope generation failed. { message = %i }", i);
+			result = false;
+		}
+		else if (st_length_get(envelope->snippet) > MAIL_ENVELOPE_SNIPPET_MAX || st_length_get(envelope->subject) > MAIL_ENVELOPE_FIELD_MAX ||
+			st_length_get(envelope->from) > MAIL_ENVELOPE_FIELD_MAX || st_length_get(envelope->to) > MAIL_ENVELOPE_FIELD_MAX) {
+			st_sprint(errmsg, "The envelope exceeded the field size limits. { message = %i }", i);
+			result = false;
+		}
+
+		mail_envelope_free(envelope);
+		st_cleanup(data);
+		envelope = NULL;
+		data = NULL;
+	}
+
+	return result;
+}
@@ -50,6 +50,45 @@ START_TEST (check_mail_headers_s) {
 }
 END_TEST
 
+START_TEST (check_mail_envelopes_s) {
+
+	log_disable();
+	bool_t result = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) result = check_mail_envelopes_sthread(errmsg);
+
+	log_test("MAIL / ENVELOPES / SINGLE THREADED:", errmsg);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_mail_terms_s) {
+
+	log_disable();
+	bool_t result = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) result = check_mail_terms_sthread(errmsg);
+
+	log_test("MAIL / TERMS / SINGLE THREADED:", errmsg);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_mail_structures_s) {
+
+	log_disable();
+	bool_t result = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) result = check_mail_structures_sthread(errmsg);
+
+	log_test("MAIL / STRUCTURES / SINGLE THREADED:", errmsg);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
 Suite * suite_check_mail(void) {
 
 	Suite *s = suite_create("\tMail");
@@ -57,6 +96,9 @@ Suite * suite_check_mail(void) {
 	suite_check_testcase(s, "MAIL", "Mail Store/S", check_mail_store_s);
 	suite_check_testcase(s, "MAIL", "Mail Load/S", check_mail_load_s);
 	suite_check_testcase(s, "MAIL", "Mail Headers/S", check_mail_headers_s);
+	suite_check_testcase(s, "MAIL", "Mail Envelopes/S", check_mail_envelopes_s);
+	suite_check_testcase(s, "MAIL", "Mail Terms/S", check_mail_terms_s);
+	suite_check_testcase(s, "MAIL", "Mail Structures/S", check_mail_structures_s);
 
 	return s;
 }
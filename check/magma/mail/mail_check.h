@@ -16,6 +16,15 @@ bool_t   check_mail_load_sthread(stringer_t *errmsg);
 /// headers_check.c
 bool_t   check_mail_headers_sthread(stringer_t *errmsg);
 
+/// envelopes_check.c
+bool_t   check_mail_envelopes_sthread(stringer_t *errmsg);
+
+/// terms_check.c
+bool_t   check_mail_terms_sthread(stringer_t *errmsg);
+
+/// structures_check.c
+bool_t   check_mail_structures_sthread(stringer_t *errmsg);
+
 /// mail_check.c
 Suite *  suite_check_mail(void);
 
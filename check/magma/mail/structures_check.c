@@ -0,0 +1,82 @@
+/**
+ * @file /magma/check/magma/mail/structures_check.c
+ */
+
+#include "magma_check.h"
+
+/**
+ * @brief	Return true if a section of the sample message resolves to a body with the expected contents.
+ */
+static bool_t check_mail_structures_body(mail_structure_t *structure, stringer_t *text, chr_t *section, chr_t *expected) {
+
+	mail_part_t *part;
+	mail_mime_t location;
+
+	if (!(part = mail_structure_part(structure, pl_init(section, ns_length_get(section)))) ||
+		!mail_structure_mime(structure, part, text, &location) || st_cmp_cs_starts(&(location.body), NULLER(expected))) {
+		return false;
+	}
+
+	return true;
+}
+
+bool_t check_mail_structures_sthread(stringer_t *errmsg) {
+
+	placer_t part;
+	mail_mime_t *mime = NULL;
+	bool_t result = true;
+	stringer_t *parts = NULL;
+	mail_structure_t *structure = NULL, *parsed = NULL;
+	stringer_t *sample = NULLER("Subject: Nested\r\nContent-Type: multipart/mixed; boundary=\"AA\"\r\n\r\n--AA\r\nContent-Type: text/plain\r\n\r\n" \
+		"First part.\r\n--AA\r\nContent-Type: multipart/alternative; boundary=\"BB\"\r\n\r\n--BB\r\nContent-Type: text/plain\r\n\r\n" \
+		"Plain alternative.\r\n--BB\r\nContent-Type: text/html\r\n\r\n<p>HTML alternative.</p>\r\n--BB--\r\n--AA--\r\n");
+	stringer_t *single = NULLER("Subject: Single\r\nContent-Type: text/plain\r\n\r\nJust one part.\r\n");
+
+	part = pl_init(st_char_get(sample), st_length_get(sample));
+
+	// Build the structure of a nested multipart message, and check each section resolves to the right part.
+	if (!(mime = mail_mime_part(&part, 1)) || !(structure = mail_structure_build(mime, sample, st_import("(\"TEXT\")", 8)))) {
+		st_sprint(errmsg, "Structure generation failed for the sample message.");
+		result = false;
+	}
+	else if (structure->count != 5 || !check_mail_structures_body(structure, sample, "1", "First part.") ||
+		!check_mail_structures_body(structure, sample, "2.1", "Plain alternative.") || !check_mail_structures_body(structure, sample, "2.2", "<p>HTML") ||
+		mail_structure_part(structure, pl_init("3", 1)) || mail_structure_part(structure, pl_init("1.1", 3)) || mail_structure_part(structure, pl_init("", 0))) {
+		st_sprint(errmsg, "The sample message sections didn't resolve to the expected parts.");
+		result = false;
+	}
+
+	// The serialized part table must round trip, and be rejected if it's used with text of a different length.
+	else if (!(parts = mail_structure_serialize(structure)) || !(parsed = mail_structure_parse(structure->length, st_dupe(structure->bodystructure), parts)) ||
+		parsed->count != structure->count || memcmp(parsed->parts, structure->parts, sizeof(mail_part_t) * parsed->count) ||
+		st_cmp_cs_eq(parsed->bodystructure, structure->bodystructure)) {
+		st_sprint(errmsg, "The serialized message structure didn't round trip.");
+		result = false;
+	}
+	else if (check_mail_structures_body(parsed, single, "1", "First part.") || mail_structure_parse(16, NULLER("(\"TEXT\")"), parts)) {
+		st_sprint(errmsg, "A message structure was used with text it doesn't describe.");
+		result = false;
+	}
+
+	mail_structure_free(structure);
+	mail_structure_free(parsed);
+	mail_mime_free(mime);
+	st_cleanup(parts);
+	structure = NULL;
+	mime = NULL;
+
+	// A single part message treats the body as section 1.
+	part = pl_init(st_char_get(single), st_length_get(single));
+
+	if (result && (!(mime = mail_mime_part(&part, 1)) || !(structure = mail_structure_build(mime, single, st_import("(\"TEXT\")", 8))) ||
+		structure->count != 2 || !check_mail_structures_body(structure, single, "1", "Just one part.") ||
+		mail_structure_part(structure, pl_init("2", 1)))) {
+		st_sprint(errmsg, "The single part message structure didn't match.");
+		result = false;
+	}
+
+	mail_structure_free(structure);
+	mail_mime_free(mime);
+
+	return result;
+}
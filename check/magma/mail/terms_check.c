@@ -0,0 +1,172 @@
+/**
+ * @file /magma/check/magma/mail/terms_check.c
+ */
+
+#include "magma_check.h"
+
+/**
+ * @brief	Return the field mask stored for a term, or 0 if the term isn't in the list.
+ */
+static uint8_t check_mail_terms_fields(mail_terms_t *terms, chr_t *term) {
+
+	size_t length = ns_length_get(term);
+
+	for (size_t i = 0; i < terms->count; i++) {
+		if (terms->list[i].length == length && !memcmp(terms->list[i].term, term, length)) {
+			return terms->list[i].fields;
+		}
+	}
+
+	return 0;
+}
+
+bool_t check_mail_terms_sthread(stringer_t *errmsg) {
+
+	bool_t result = true;
+	stringer_t *data = NULL;
+	mail_terms_t *terms = NULL;
+	uint32_t max = check_message_max();
+	uint64_t numbers[] = { 3, 7, 19, 42 };
+	mail_matches_t matches = { .count = 4, .messages = numbers };
+	stringer_t *sample = NULLER("From: Sender <sender@example.com>\r\nTo: recipient@example.com\r\nSubject: Quarterly Report\r\n" \
+		"Content-Type: multipart/alternative; boundary=\"XX\"\r\n\r\n--XX\r\nContent-Type: text/plain\r\n" \
+		"Content-Transfer-Encoding: quoted-printable\r\n\r\nThe numbers are=\r\n in.\r\n--XX\r\nContent-Type: text/html\r\n\r\n" \
+		"<p class=\"hidden\">Revenue <b>grew</b></p>\r\n--XX--\r\n");
+
+	// Check the terms, and fields, extracted from a known message.
+	if (!(terms = mail_terms_build(sample))) {
+		st_sprint(errmsg, "Term generation failed for the sample message.");
+		result = false;
+	}
+	else if (!(check_mail_terms_fields(terms, "quarterly") & MAIL_TERM_SUBJECT) || !(check_mail_terms_fields(terms, "sender") & MAIL_TERM_FROM) ||
+		!(check_mail_terms_fields(terms, "recipient") & MAIL_TERM_TO) || (check_mail_terms_fields(terms, "report") & MAIL_TERM_BODY)) {
+		st_sprint(errmsg, "The sample header terms didn't match.");
+		result = false;
+	}
+	else if (check_mail_terms_fields(terms, "numbers") != MAIL_TERM_BODY || check_mail_terms_fields(terms, "arein") ||
+		check_mail_terms_fields(terms, "revenue") != MAIL_TERM_BODY || check_mail_terms_fields(terms, "hidden")) {
+		st_sprint(errmsg, "The sample body terms didn't match.");
+		result = false;
+	}
+
+	// Every suffix of a word is stored, so a search word can be matched anywhere inside a message word.
+	else if (!(check_mail_terms_fields(terms, "port") & MAIL_TERM_SUBJECT) || !(check_mail_terms_fields(terms, "evenue") & MAIL_TERM_BODY) ||
+		terms->truncated) {
+		st_sprint(errmsg, "The sample word suffixes weren't stored.");
+		result = false;
+	}
+
+	// The terms must be sorted and distinct.
+	for (size_t i = 1; result && i < terms->count; i++) {
+		if (memcmp(terms->list[i - 1].term, terms->list[i].term, terms->list[i - 1].length < terms->list[i].length ? terms->list[i - 1].length : terms->list[i].length) > 0 ||
+			(terms->list[i - 1].length == terms->list[i].length && !memcmp(terms->list[i - 1].term, terms->list[i].term, terms->list[i].length))) {
+			st_sprint(errmsg, "The sample terms weren't sorted and distinct. { term = %zu }", i);
+			result = false;
+		}
+	}
+
+	mail_terms_free(terms);
+	terms = NULL;
+
+	// Search values are lowercased, and values without any indexable words are rejected.
+	if (result && (!(terms = mail_terms_query(PLACER("Quarterly REPORT, report", 24))) || terms->count != 2 ||
+		!check_mail_terms_fields(terms, "quarterly") || !check_mail_terms_fields(terms, "report"))) {
+		st_sprint(errmsg, "The search value wasn't split into the expected terms.");
+		result = false;
+	}
+	else if (result && (mail_terms_query(PLACER("a @ !", 5)) || mail_terms_query(PLACER("", 0)))) {
+		st_sprint(errmsg, "A search value without any indexable words produced terms.");
+		result = false;
+	}
+	else if (result && (!mail_matches_find(&matches, 3) || !mail_matches_find(&matches, 42) || mail_matches_find(&matches, 4) ||
+		mail_matches_find(&matches, 43))) {
+		st_sprint(errmsg, "The match list lookups returned the wrong result.");
+		result = false;
+	}
+
+	mail_terms_free(terms);
+	terms = NULL;
+
+	// Only a single whole word can be answered by the index without confirming the match against the message.
+	if (result && (!mail_terms_conclusive(PLACER("Report", 6)) || mail_terms_conclusive(PLACER("quarterly report", 16)) ||
+		mail_terms_conclusive(PLACER("re-port", 7)) || mail_terms_conclusive(PLACER("abcdefghijklmnopqrstuvwxyz0123456789", 36)))) {
+		st_sprint(errmsg, "The search values weren't classified correctly.");
+		result = false;
+	}
+
+	// Empty messages, and messages without a body, must still produce a list, so they can be recorded as indexed.
+	else if (result && (!(terms = mail_terms_build(PLACER("", 0))) || terms->count)) {
+		st_sprint(errmsg, "An empty message didn't produce an empty term list.");
+		result = false;
+	}
+
+	mail_terms_free(terms);
+	terms = NULL;
+
+	if (result && (!(terms = mail_terms_build(PLACER("Subject: Headers only", 21))) || !(check_mail_terms_fields(terms, "headers") & MAIL_TERM_SUBJECT))) {
+		st_sprint(errmsg, "A message without a body wasn't indexed.");
+		result = false;
+	}
+
+	mail_terms_free(terms);
+	terms = NULL;
+
+	// A long word is stored from every offset, so text past the term length limit can still be found.
+	if (result && (!(terms = mail_terms_build(PLACER("Subject: abcdefghijklmnopqrstuvwxyz0123456789ABCDEF", 51))) ||
+		!(check_mail_terms_fields(terms, "uvwxyz0123456789abcdef") & MAIL_TERM_SUBJECT) ||
+		!(check_mail_terms_fields(terms, "abcdefghijklmnopqrstuvwxyz012345") & MAIL_TERM_SUBJECT))) {
+		st_sprint(errmsg, "The suffixes of a long word weren't stored.");
+		result = false;
+	}
+
+	mail_terms_free(terms);
+	terms = NULL;
+
+	// A message with more distinct terms than the index holds must be flagged, so searches don't rule it out.
+	if (result && !(data = st_alloc_opts(MANAGED_T | JOINTED | HEAP, MAIL_TERMS_MAX * 12))) {
+		st_sprint(errmsg, "Unable to allocate the oversized sample message.");
+		result = false;
+	}
+	else if (result) {
+
+		st_sprint(data, "Subject: Oversized\r\n\r\n");
+
+		for (uint32_t i = 0; i < MAIL_TERMS_MAX && st_length_get(data) + 12 < st_avail_get(data); i++) {
+			st_append(data, st_quick(MANAGEDBUF(16), "w%08x ", i * 2654435761U));
+		}
+
+		if (!(terms = mail_terms_build(data)) || !terms->truncated || terms->count != MAIL_TERMS_MAX) {
+			st_sprint(errmsg, "An oversized message wasn't flagged as truncated. { count = %zu }", terms ? terms->count : 0);
+			result = false;
+		}
+	}
+
+	mail_terms_free(terms);
+	st_cleanup(data);
+	terms = NULL;
+	data = NULL;
+
+	// Make sure every sample message yields a bounded list of terms.
+	for (uint32_t i = 0; i < max && result && status(); i++) {
+
+		if (!(data = check_message_get(i))) {
+			st_sprint(errmsg, "Failed to get the message data. { message = %i }", i);
+			result = false;
+		}
+		else if (!(terms = mail_terms_build(data))) {
+			st_sprint(errmsg, "Term generation failed. { message = %i }", i);
+			result = false;
+		}
+		else if (terms->count > MAIL_TERMS_MAX) {
+			st_sprint(errmsg, "The message produced too many terms. { message = %i / count = %zu }", i, terms->count);
+			result = false;
+		}
+
+		mail_terms_free(terms);
+		st_cleanup(data);
+		terms = NULL;
+		data = NULL;
+	}
+
+	return result;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file /check/magma/network/idle_check.c
+ *
+ * @brief Check the idle connection parking functions.
+ */
+
+#include "magma_check.h"
+
+struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t events;
+	bool_t woken;
+} check_idle = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.events = 0,
+	.woken = false
+};
+
+/**
+ * @brief	The wake function for the parked test connections, which records why the connection was woken up.
+ * @param	con		the connection which was woken up.
+ * @return	This function returns no value.
+ */
+static void check_network_idle_wake(connection_t *con) {
+
+	mutex_lock(&check_idle.lock);
+	check_idle.events = con->network.idle;
+	check_idle.woken = true;
+	pthread_cond_signal(&check_idle.cond);
+	mutex_unlock(&check_idle.lock);
+
+	return;
+}
+
+/**
+ * @brief	Wait for a parked test connection to be woken up.
+ * @param	seconds		the number of seconds to wait.
+ * @return	the CON_IDLE_* events the connection was woken up with, or 0 if it wasn't woken up in time.
+ */
+static uint32_t check_network_idle_wait(time_t seconds) {
+
+	uint32_t result = 0;
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += seconds;
+
+	mutex_lock(&check_idle.lock);
+
+	while (!check_idle.woken && pthread_cond_timedwait(&check_idle.cond, &check_idle.lock, &deadline) != ETIMEDOUT);
+
+	if (check_idle.woken) {
+		result = check_idle.events;
+	}
+
+	check_idle.woken = false;
+	check_idle.events = 0;
+	mutex_unlock(&check_idle.lock);
+
+	return result;
+}
+
+bool_t check_network_idle_sthread(stringer_t *errmsg) {
+
+	int pair[2];
+	uint32_t events = 0;
+	connection_t con;
+	bool_t stopped = false;
+	uint64_t usernum = UINT64_MAX - 1;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair)) {
+		st_sprint(errmsg, "Unable to create the socket pair for the idle connection.");
+		return false;
+	}
+
+	mm_wipe(&con, sizeof(connection_t));
+	con.network.sockd = pair[0];
+
+	// Input from the client should wake the connection.
+	if (!con_idle_park(&con, usernum, CON_IDLE_TIMEOUT, &check_network_idle_wake, NULL)) {
+		st_sprint(errmsg, "Unable to park the idle connection.");
+	}
+	else if (write(pair[1], "DONE\r\n", 6) != 6 || ((events = check_network_idle_wait(5)) & CON_IDLE_READ) != CON_IDLE_READ) {
+		st_sprint(errmsg, "The parked connection wasn't woken up by client input. { events = %u }", events);
+	}
+
+	// Drain the input, so it doesn't wake up the rest of the checks.
+	else if (read(pair[0], MEMORYBUF(16), 16) != 6) {
+		st_sprint(errmsg, "Unable to read the client input sent to the parked connection.");
+	}
+
+	// A change notification for the user should wake the connection, without waiting for the next tick.
+	else if (!con_idle_park(&con, usernum, CON_IDLE_TIMEOUT, &check_network_idle_wake, NULL)) {
+		st_sprint(errmsg, "Unable to park the idle connection.");
+	}
+	else {
+		con_idle_notify(usernum);
+
+		if (((events = check_network_idle_wait(5)) & CON_IDLE_NOTIFY) != CON_IDLE_NOTIFY) {
+			st_sprint(errmsg, "The parked connection wasn't woken up by a change notification. { events = %u }", events);
+		}
+	}
+
+	// The connection should be dropped once its timeout passes.
+	if (st_empty(errmsg) && !con_idle_park(&con, usernum, 1, &check_network_idle_wake, NULL)) {
+		st_sprint(errmsg, "Unable to park the idle connection.");
+	}
+	else if (st_empty(errmsg) && ((events = check_network_idle_wait(5)) & CON_IDLE_EXPIRED) != CON_IDLE_EXPIRED) {
+		st_sprint(errmsg, "The parked connection wasn't expired once its timeout passed. { events = %u }", events);
+	}
+
+	// Stopping the idle thread should return the parked connections to the workers.
+	if (st_empty(errmsg) && !con_idle_park(&con, usernum, CON_IDLE_TIMEOUT, &check_network_idle_wake, NULL)) {
+		st_sprint(errmsg, "Unable to park the idle connection.");
+	}
+	else if (st_empty(errmsg)) {
+		con_idle_stop();
+		stopped = true;
+
+		if (((events = check_network_idle_wait(5)) & CON_IDLE_SHUTDOWN) != CON_IDLE_SHUTDOWN) {
+			st_sprint(errmsg, "The parked connection wasn't woken up when the idle thread stopped. { events = %u }", events);
+		}
+	}
+
+	// If a check failed, the connection may still be parked, so the thread is stopped to hand it back before the stack is released.
+	if (!stopped) {
+		con_idle_stop();
+		check_network_idle_wait(1);
+	}
+
+	// Restart the idle thread for the rest of the checks.
+	if (!con_idle_start() && st_empty(errmsg)) {
+		st_sprint(errmsg, "Unable to restart the idle connection thread.");
+	}
+
+	close(pair[0]);
+	close(pair[1]);
+
+	return st_empty(errmsg);
+}
@@ -7,12 +7,26 @@
 
 #include "magma_check.h"
 
+START_TEST (check_network_idle_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) outcome = check_network_idle_sthread(errmsg);
+
+	log_test("NETWORK / IDLE / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
 Suite * suite_check_network(void) {
 
 	Suite *s = suite_create("\tNetwork");
 
-	// The IP address checks were the only thing handled by this suite. Those checks have since moved to
-	// to core. The empty suite remains to remind us what needs doing.
+	suite_check_testcase(s, "NETWORK", "Network Idle/S", check_network_idle_s);
+
+	// The IP address checks were once handled by this suite, but those checks have since moved to core.
 
 	/// MEDIUM: Write checks which stress the connection accept logic.
 	/// MEDIUM: Write checks for the con_write/con_read/con_read_line interfaces.
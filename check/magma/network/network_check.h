@@ -8,6 +8,9 @@
 #ifndef NETWORK_CHECK_H
 #define NETWORK_CHECK_H
 
+/// idle_check.c
+bool_t check_network_idle_sthread(stringer_t *errmsg);
+
 Suite * suite_check_network(void);
 
 #endif
@@ -16,6 +16,7 @@ START_TEST (check_object_serials_s) {
 
 	// Flush the cache, otherwise we won't get what we expect back.
 	cache_flush();
+	serial_local_truncate();
 
 	for (uint32_t i = 0; i < 128 && result; i++) {
 
@@ -79,6 +80,333 @@ START_TEST (check_object_serials_s) {
 }
 END_TEST
 
+START_TEST (check_object_serials_local_s) {
+
+	log_disable();
+	bool_t result = true;
+	stringer_t *errmsg = NULL, *key = NULL;
+	uint64_t num = 0x1000000 + rand_get_uint16(), timeout = magma.iface.cache.serial_timeout;
+
+	cache_flush();
+	serial_local_truncate();
+
+	// Use a long timeout so the local copy can't expire while the test is running.
+	magma.iface.cache.serial_timeout = 60;
+
+	if (!(key = st_aprint("magma.folders.%lu", num))) {
+		errmsg = NULLER("Unable to build the serial key.");
+		result = false;
+	}
+
+	// The first request should load every object type, so the folder serial should be answered from the local copy.
+	else if (serial_increment(OBJECT_FOLDERS, num) != 1 || serial_get(OBJECT_USER, num) != 0 || serial_get(OBJECT_FOLDERS, num) != 1) {
+		errmsg = NULLER("The local serial number copy was not loaded correctly.");
+		result = false;
+	}
+
+	// Changes made by another process shouldn't be visible until the local copy expires.
+	else if (cache_increment(key, 1, 1, 2592000) != 2 || serial_get(OBJECT_FOLDERS, num) != 1) {
+		errmsg = NULLER("The local serial number copy was refreshed unexpectedly.");
+		result = false;
+	}
+
+	// Increments made by this process should be visible immediately.
+	else if (serial_increment(OBJECT_FOLDERS, num) != 3 || serial_get(OBJECT_FOLDERS, num) != 3) {
+		errmsg = NULLER("The local serial number copy did not track a local increment.");
+		result = false;
+	}
+
+	// A reset discards the local copy.
+	else if (serial_reset(OBJECT_FOLDERS, num) != 1 || serial_get(OBJECT_FOLDERS, num) != 1) {
+		errmsg = NULLER("The local serial number copy was not discarded after a reset.");
+		result = false;
+	}
+
+	magma.iface.cache.serial_timeout = timeout;
+	serial_local_truncate();
+	st_cleanup(key);
+
+	log_test("OBJECTS / SERIALS / LOCAL / SINGLE THREADED:", errmsg);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_object_cache_lru_s) {
+
+	log_disable();
+	bool_t result = true;
+	meta_user_t *user = NULL;
+	stringer_t *errmsg = NULL;
+	uint64_t base = 0x2000000 + (rand_get_uint16() * 16), limit = magma.objects.meta_limit;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = base };
+
+	// Load a handful of empty user objects, and then release them so they become candidates for eviction.
+	for (uint64_t i = 0; i < 8 && result; i++) {
+		if (!(user = meta_inx_find(base + i, META_PROTOCOL_GENERIC))) {
+			errmsg = NULLER("Unable to add a user object to the cache.");
+			result = false;
+		}
+		else if (!user->cache.object || objects.lru.meta.head != &(user->cache)) {
+			errmsg = NULLER("The new user object was not placed at the head of the cache list.");
+			result = false;
+		}
+		else {
+			meta_inx_remove(base + i, META_PROTOCOL_GENERIC);
+		}
+	}
+
+	// Hold a reference to the first object, then shrink the budget so everything else is evicted.
+	if (result && (!(user = meta_inx_find(base, META_PROTOCOL_GENERIC)) || objects.lru.meta.head != &(user->cache))) {
+		errmsg = NULLER("The cached user object was not moved to the head of the list when it was found.");
+		result = false;
+	}
+	else if (result) {
+
+		magma.objects.meta_limit = 1;
+		obj_cache_prune();
+		magma.objects.meta_limit = limit;
+
+		inx_lock_read(objects.meta);
+
+		if (inx_find(objects.meta, key) != user) {
+			errmsg = NULLER("A referenced user object was evicted from the cache.");
+			result = false;
+		}
+
+		for (uint64_t i = 1; i < 8 && result; i++) {
+			key.val.u64 = base + i;
+			if (inx_find(objects.meta, key)) {
+				errmsg = NULLER("An unreferenced user object was not evicted when the cache was over budget.");
+				result = false;
+			}
+		}
+
+		inx_unlock(objects.meta);
+
+		if (result && objects.lru.meta.count != inx_count(objects.meta)) {
+			errmsg = NULLER("The cache list and the user object index are out of sync.");
+			result = false;
+		}
+
+		meta_inx_remove(base, META_PROTOCOL_GENERIC);
+	}
+
+	log_test("OBJECTS / CACHE / LRU / SINGLE THREADED:", errmsg);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_object_meta_snapshots_s) {
+
+	log_disable();
+	bool_t result = true;
+	stringer_t *errmsg = NULL;
+	meta_user_t *user = NULL;
+	meta_message_t *message = NULL;
+	meta_snapshot_t *first = NULL, *second = NULL, *third = NULL, *fourth = NULL;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (!(user = meta_alloc()) || !(user->messages = inx_alloc(M_INX_LINKED, &meta_message_free))) {
+		errmsg = NULLER("Unable to allocate a meta user object.");
+		result = false;
+	}
+
+	for (uint64_t i = 1; i <= 16 && result; i++) {
+		if (!(message = mm_alloc(sizeof(meta_message_t)))) {
+			errmsg = NULLER("Unable to allocate a meta message object.");
+			result = false;
+		}
+		else if (!(key.val.u64 = message->messagenum = i) || !(message->foldernum = 1) || !(message->sequencenum = i) ||
+			!inx_append(user->messages, key, message)) {
+			errmsg = NULLER("Unable to add a message to the meta user object.");
+			mm_free(message);
+			result = false;
+		}
+	}
+
+	// Readers should share the published snapshot, rather than getting their own copy.
+	if (result && (!(first = meta_snapshot_get(user)) || !(second = meta_snapshot_get(user)) || first != second ||
+		inx_count(first->messages) != 16)) {
+		errmsg = NULLER("The message snapshot was not shared between readers.");
+		result = false;
+	}
+
+	// Change the live messages and confirm the next reader gets a new snapshot, while the pinned one is left untouched.
+	else if (result) {
+
+		key.val.u64 = 1;
+		((meta_message_t *)inx_find(user->messages, key))->status = MAIL_STATUS_SEEN;
+		meta_snapshot_invalidate(user);
+
+		if (!(third = meta_snapshot_get(user)) || third == first) {
+			errmsg = NULLER("The message snapshot was not replaced after it was invalidated.");
+			result = false;
+		}
+		else if (((meta_message_t *)inx_find(third->messages, key))->status != MAIL_STATUS_SEEN ||
+			((meta_message_t *)inx_find(first->messages, key))->status == MAIL_STATUS_SEEN) {
+			errmsg = NULLER("The message snapshots did not hold the expected versions of the messages.");
+			result = false;
+		}
+
+		// Only the changed message should have been copied, the rest should be shared with the earlier snapshot.
+		for (uint64_t i = 2; i <= 16 && result; i++) {
+			key.val.u64 = i;
+			if (inx_find(third->messages, key) != inx_find(first->messages, key)) {
+				errmsg = NULLER("An unchanged message was copied, instead of being shared with the earlier snapshot.");
+				result = false;
+			}
+		}
+	}
+
+	// Removing a message puts the two collections out of step, but the remaining copies should still be shared.
+	if (result) {
+
+		key.val.u64 = 8;
+		inx_delete(user->messages, key);
+		meta_snapshot_invalidate(user);
+
+		if (!(fourth = meta_snapshot_get(user)) || fourth == third || inx_count(fourth->messages) != 15 || inx_find(fourth->messages, key)) {
+			errmsg = NULLER("The message snapshot did not reflect the removed message.");
+			result = false;
+		}
+
+		for (uint64_t i = 1; i <= 16 && result; i++) {
+			key.val.u64 = i;
+			if (i != 8 && inx_find(fourth->messages, key) != inx_find(third->messages, key)) {
+				errmsg = NULLER("A message copy was not shared after another message was removed.");
+				result = false;
+			}
+		}
+	}
+
+	meta_snapshot_release(first);
+	meta_snapshot_release(second);
+	meta_snapshot_release(third);
+	meta_snapshot_release(fourth);
+	meta_free(user);
+
+	log_test("OBJECTS / META / SNAPSHOTS / SINGLE THREADED:", errmsg);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_object_meta_counters_s) {
+
+	log_disable();
+	uint32_t status;
+	bool_t result = true;
+	inx_cursor_t *cursor;
+	meta_counters_t totals;
+	uint64_t visible = 0, bytes = 0;
+	stringer_t *errmsg = NULL;
+	meta_user_t *user = NULL;
+	meta_folder_t *folder = NULL;
+	meta_message_t *message = NULL;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (!(user = meta_alloc()) || !(user->messages = inx_alloc(M_INX_LINKED, &meta_message_free)) ||
+		!(user->folders = inx_alloc(M_INX_LINKED, &mm_free))) {
+		errmsg = NULLER("Unable to allocate a meta user object.");
+		result = false;
+	}
+
+	for (uint64_t i = 1; i <= 4 && result; i++) {
+		if (!(folder = mm_alloc(sizeof(meta_folder_t)))) {
+			errmsg = NULLER("Unable to allocate a meta folder object.");
+			result = false;
+		}
+		else if (!(key.val.u64 = folder->foldernum = i) || !inx_insert(user->folders, key, folder)) {
+			errmsg = NULLER("Unable to add a folder to the meta user object.");
+			mm_free(folder);
+			result = false;
+		}
+	}
+
+	// Half of the messages are loaded up front, like a database fetch, and the counters rebuilt with a full scan.
+	for (uint64_t i = 1; i <= 64 && result; i++) {
+		if (!(message = mm_alloc(sizeof(meta_message_t)))) {
+			errmsg = NULLER("Unable to allocate a meta message object.");
+			result = false;
+		}
+		else if (!(key.val.u64 = message->messagenum = i) || !(message->foldernum = (rand_get_uint64() % 4) + 1) ||
+			!(message->size = (rand_get_uint64() % 4096) + 1) || !inx_append(user->messages, key, message)) {
+			errmsg = NULLER("Unable to add a message to the meta user object.");
+			mm_free(message);
+			result = false;
+		}
+		else {
+			message->status = rand_get_uint32() & (MAIL_STATUS_SEEN | MAIL_STATUS_RECENT | MAIL_STATUS_TAGGED | MAIL_STATUS_APPENDED | MAIL_STATUS_HIDDEN);
+			if (i == 32) meta_counters_rebuild(user->folders, user->messages);
+			else if (i > 32) meta_counters_add(user->folders, message);
+		}
+	}
+
+	if (result && !meta_counters_verify(user->folders, user->messages)) {
+		errmsg = NULLER("The folder counters did not match a full scan after loading the messages.");
+		result = false;
+	}
+
+	// Apply a random mix of flag changes, moves and removals, checking the counters against a full scan after each one.
+	for (uint64_t i = 0; i < 256 && result; i++) {
+
+		key.val.u64 = (rand_get_uint64() % 64) + 1;
+
+		if (!(message = inx_find(user->messages, key))) {
+			continue;
+		}
+
+		switch (rand_get_uint32() % 5) {
+			case (0):
+				status = rand_get_uint32() & (MAIL_STATUS_SEEN | MAIL_STATUS_RECENT | MAIL_STATUS_TAGGED | MAIL_STATUS_APPENDED | MAIL_STATUS_HIDDEN);
+				meta_counters_status(user->folders, message, status);
+				break;
+			case (1):
+				meta_counters_move(user->folders, message, (rand_get_uint64() % 4) + 1);
+				break;
+			case (2):
+				meta_counters_recent_clear(user->folders, user->messages, message->foldernum);
+				break;
+			case (3):
+				meta_counters_remove(user->folders, message);
+				inx_delete(user->messages, key);
+				break;
+			default:
+				meta_counters_status(user->folders, message, message->status | MAIL_STATUS_SEEN);
+				break;
+		}
+
+		if (!meta_counters_verify(user->folders, user->messages)) {
+			errmsg = NULLER("The folder counters drifted away from a full scan of the messages.");
+			result = false;
+		}
+	}
+
+	// The summed totals are what POP reports, so compare them against a scan of the visible messages.
+	if (result && (cursor = inx_cursor_alloc(user->messages))) {
+
+		while ((message = inx_cursor_value_next(cursor))) {
+			if (!(message->status & (MAIL_STATUS_APPENDED | MAIL_STATUS_HIDDEN))) {
+				visible++;
+				bytes += message->size;
+			}
+		}
+
+		inx_cursor_free(cursor);
+		meta_counters_total(user->folders, &totals);
+
+		if (totals.visible != visible || totals.visible_bytes != bytes) {
+			errmsg = NULLER("The folder counter totals did not match a scan of the visible messages.");
+			result = false;
+		}
+	}
+
+	meta_free(user);
+
+	log_test("OBJECTS / META / COUNTERS / SINGLE THREADED:", errmsg);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
 START_TEST (check_warehouse_domains_s) {
 
 	log_disable();
@@ -117,12 +445,178 @@ START_TEST (check_warehouse_domains_s) {
 }
 END_TEST
 
+START_TEST (check_warehouse_patterns_s) {
+
+	log_disable();
+	size_t length;
+	uchr_t *data;
+	bool_t result = true;
+	inx_t *patterns = NULL;
+	struct timeval start, end;
+	stringer_t *errmsg = NULL, *message = NULL, *pattern, *measured = MANAGEDBUF(256);
+	pattern_automaton_t *automaton = NULL;
+	uint64_t compile_time = 0, naive_time = 0, search_time = 0, offset;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+	inx_cursor_t *cursor = NULL;
+	chr_t *fixed[] = { "abcd", "bc", "HERS" };
+
+	// A handful of patterns which can only be found by following the failure links, or by ignoring case.
+	if (!(patterns = inx_alloc(M_INX_LINKED, &st_free))) {
+		errmsg = NULLER("Unable to allocate the list of patterns.");
+		result = false;
+	}
+
+	for (uint64_t i = 0; result && i < sizeof(fixed) / sizeof(chr_t *); i++) {
+		key.val.u64 = i;
+		if (!(pattern = st_import(fixed[i], ns_length_get(fixed[i])))) {
+			errmsg = NULLER("Unable to allocate a pattern.");
+			result = false;
+		}
+		else if (inx_insert(patterns, key, pattern) != 1) {
+			errmsg = NULLER("Unable to add a pattern to the list.");
+			st_free(pattern);
+			result = false;
+		}
+	}
+
+	if (result && !(automaton = pattern_compile(patterns))) {
+		errmsg = NULLER("Unable to compile the list of patterns.");
+		result = false;
+	}
+	else if (result && (!pattern_search(automaton, NULLER("xxABCe")) || !pattern_search(automaton, NULLER("ushers")) ||
+		!pattern_search(automaton, NULLER("ABCD")) || pattern_search(automaton, NULLER("abdc hres acbd")) ||
+		pattern_search(automaton, NULLER("")))) {
+		errmsg = NULLER("The compiled patterns returned the wrong result.");
+		result = false;
+	}
+
+	pattern_free(automaton);
+	inx_cleanup(patterns);
+	automaton = NULL;
+
+	// Generate thousands of random lower case patterns, and a large message, made up of random words, which doesn't contain any of them.
+	if (result && (!(patterns = inx_alloc(M_INX_LINKED, &st_free)) || !(message = st_alloc(PATTERN_CHECK_MESSAGE_SIZE)))) {
+		errmsg = NULLER("Unable to allocate the list of patterns and the message.");
+		result = false;
+	}
+
+	for (uint64_t i = 0; result && i < PATTERN_CHECK_PATTERNS; i++) {
+
+		key.val.u64 = i;
+		length = (rand_get_uint32() % 12) + 12;
+
+		if (!(pattern = st_alloc(length))) {
+			errmsg = NULLER("Unable to allocate a pattern.");
+			result = false;
+		}
+		else {
+
+			data = st_data_get(pattern);
+			for (size_t j = 0; j < length; j++) data[j] = 'a' + (rand_get_uint8() % 26);
+			st_length_set(pattern, length);
+
+			if (inx_insert(patterns, key, pattern) != 1) {
+				errmsg = NULLER("Unable to add a pattern to the list.");
+				st_free(pattern);
+				result = false;
+			}
+		}
+	}
+
+	if (result) {
+		data = st_data_get(message);
+		for (size_t j = 0; j < PATTERN_CHECK_MESSAGE_SIZE; j++) data[j] = (rand_get_uint8() % 7) ? 'a' + (rand_get_uint8() % 26) : ' ';
+		st_length_set(message, PATTERN_CHECK_MESSAGE_SIZE);
+	}
+
+	gettimeofday(&start, NULL);
+
+	if (result && !(automaton = pattern_compile(patterns))) {
+		errmsg = NULLER("Unable to compile the list of random patterns.");
+		result = false;
+	}
+
+	gettimeofday(&end, NULL);
+	compile_time = ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+
+	// A single pass over the whole message, compared with a separate search for each pattern over the start of the message.
+	if (result) {
+
+		gettimeofday(&start, NULL);
+
+		if (pattern_search(automaton, message)) {
+			errmsg = NULLER("The compiled patterns matched a message which didn't contain any of them.");
+			result = false;
+		}
+
+		gettimeofday(&end, NULL);
+		search_time = ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+		gettimeofday(&start, NULL);
+
+		if (!(cursor = inx_cursor_alloc(patterns))) {
+			errmsg = NULLER("Unable to iterate through the list of random patterns.");
+			result = false;
+		}
+
+		while (result && (pattern = inx_cursor_value_next(cursor))) {
+			if (st_search_ci(PLACER(st_data_get(message), PATTERN_CHECK_NAIVE_SIZE), pattern, NULL)) {
+				errmsg = NULLER("The random message contained one of the random patterns.");
+				result = false;
+			}
+		}
+
+		if (cursor) {
+			inx_cursor_free(cursor);
+		}
+
+		gettimeofday(&end, NULL);
+		naive_time = ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+	}
+
+	// Copy one of the patterns, in upper case, into the middle of the message, and make sure it's found.
+	if (result) {
+
+		key.val.u64 = rand_get_uint32() % PATTERN_CHECK_PATTERNS;
+		pattern = inx_find(patterns, key);
+		offset = PATTERN_CHECK_MESSAGE_SIZE / 2;
+
+		for (size_t j = 0; j < st_length_get(pattern); j++) {
+			*((uchr_t *)st_data_get(message) + offset + j) = *((uchr_t *)st_data_get(pattern) + j) - 32;
+		}
+
+		if (!pattern_search(automaton, message)) {
+			errmsg = NULLER("The compiled patterns didn't match a message which contained one of them.");
+			result = false;
+		}
+	}
+
+	if (result) {
+		st_sprint(measured, "Searched a %u byte message for %u patterns. { compile = %lu microseconds / automaton = %lu microseconds / "
+			"naive over %u bytes = %lu microseconds }", PATTERN_CHECK_MESSAGE_SIZE, PATTERN_CHECK_PATTERNS, compile_time, search_time,
+			PATTERN_CHECK_NAIVE_SIZE, naive_time);
+	}
+
+	pattern_free(automaton);
+	inx_cleanup(patterns);
+	st_cleanup(message);
+
+	log_test("OBJECTS / WAREHOUSE / PATTERNS / SINGLE THREADED:", errmsg);
+	log_measure(measured);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
 Suite * suite_check_objects(void) {
 
 	Suite *s = suite_create("\tObjects");
 
 	suite_check_testcase(s, "OBJECTS", "Object Serials/S", check_object_serials_s);
+	suite_check_testcase(s, "OBJECTS", "Object Serials Local/S", check_object_serials_local_s);
+	suite_check_testcase(s, "OBJECTS", "Object Cache LRU/S", check_object_cache_lru_s);
+	suite_check_testcase(s, "OBJECTS", "Object Meta Snapshots/S", check_object_meta_snapshots_s);
+	suite_check_testcase(s, "OBJECTS", "Object Meta Counters/S", check_object_meta_counters_s);
 	suite_check_testcase(s, "OBJECTS", "Object Warehouse Domains/S", check_warehouse_domains_s);
+	suite_check_testcase(s, "OBJECTS", "Object Warehouse Patterns/S", check_warehouse_patterns_s);
 
 	return s;
 }
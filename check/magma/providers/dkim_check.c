@@ -139,7 +139,7 @@ bool_t check_dkim_sign_sthread(stringer_t *errmsg) {
 		// We only attempt to generate signatures for messages without an existing signature. Note we have to
 		// run the input messages through the cleanup function, otherwise messages without a proper CRLF line
 		// endings will fail.
-		else if (check_message_dkim_sign(i) && mail_message_cleanup(&data) && !(signature = dkim_signature_create(id, data))) {
+		else if (check_message_dkim_sign(i) && mail_message_cleanup(&data, 0) && !(signature = dkim_signature_create(id, data))) {
 			st_sprint(errmsg, "Failed to generate the domain keys message signature. { message = %i }", i);
 			st_free(data);
 			st_free(id);
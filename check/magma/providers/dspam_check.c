@@ -105,3 +105,61 @@ bool_t check_dspam_mail_sthread(void) {
 
 	return true;
 }
+
+bool_t check_dspam_throughput_sthread(stringer_t *errmsg, stringer_t *measured) {
+
+	stringer_t *data;
+	struct timeval start, end;
+	uint64_t cold = 0, warm = 0, bytes = 0, reused;
+	uint32_t max = check_message_max(), count = 0;
+
+	// Classify the corpus twice. The first pass discards the idle contexts before each message, so every message has to attach a new
+	// context to the statistical database, while the second pass classifies every message using the same pooled context.
+	for (int_t pass = 0; pass < 2; pass++) {
+
+		reused = stats_get_value_by_name("provider.spam.contexts.reused");
+
+		for (uint32_t i = 0; status() && i < max; i++) {
+
+			if (!(data = check_message_get(i))) {
+				st_sprint(errmsg, "Failed to get the message data. { message = %u }", i);
+				return false;
+			}
+
+			if (!pass) {
+				dspam_truncate();
+			}
+
+			gettimeofday(&start, NULL);
+
+			if (dspam_check(DSPAM_CHECK_DATA_UNUM, data, NULL) == -1) {
+				st_sprint(errmsg, "There was a dspam_check error. { message = %u / pass = %i }", i, pass);
+				st_free(data);
+				return false;
+			}
+
+			gettimeofday(&end, NULL);
+
+			if (!pass) {
+				cold += ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+				bytes += st_length_get(data);
+				count++;
+			}
+			else {
+				warm += ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+			}
+
+			st_free(data);
+		}
+
+		if (pass && magma.iface.spam.contexts && count && stats_get_value_by_name("provider.spam.contexts.reused") - reused < count - 1) {
+			st_sprint(errmsg, "The pooled DSPAM contexts weren't reused. { messages = %u / reused = %lu }", count,
+				stats_get_value_by_name("provider.spam.contexts.reused") - reused);
+			return false;
+		}
+	}
+
+	st_sprint(measured, "Classified %u messages totalling %lu bytes. { attached = %lu microseconds / pooled = %lu microseconds }", count, bytes, cold, warm);
+
+	return true;
+}
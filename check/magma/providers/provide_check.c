@@ -545,6 +545,22 @@ START_TEST (check_dspam_bin_s) {
 }
 END_TEST
 
+START_TEST (check_dspam_throughput_s) {
+
+	log_disable();
+	bool_t result = true;
+	stringer_t *errmsg = MANAGEDBUF(1024), *measured = MANAGEDBUF(256);
+
+	if (status()) {
+		result = check_dspam_throughput_sthread(errmsg, measured);
+	}
+
+	log_test("CHECKERS / DSPAM / THROUGHPUT / SINGLE THREADED:", errmsg);
+	log_measure(measured);
+	ck_assert_msg(result, st_char_get(errmsg));
+}
+END_TEST
+
 //! DKIM Tests
 START_TEST (check_dkim_s) {
 
@@ -637,6 +653,7 @@ Suite * suite_check_provide(void) {
 	if (do_dspam_check) {
 		suite_check_testcase(s, "PROVIDERS", "DSPAM Mail/S", check_dspam_mail_s);
 		suite_check_testcase(s, "PROVIDERS", "DSPAM Binary/S", check_dspam_bin_s);
+		suite_check_testcase(s, "PROVIDERS", "DSPAM Throughput/S", check_dspam_throughput_s);
 	}
 	else {
 		log_unit("Skipping DSPAM checks...\n");
@@ -47,6 +47,7 @@ bool_t   check_scramble_sthread(void);
 /// dspam_check.c
 bool_t   check_dspam_binary_sthread(void);
 bool_t   check_dspam_mail_sthread(void);
+bool_t   check_dspam_throughput_sthread(stringer_t *errmsg, stringer_t *measured);
 
 /// provide_check.c
 Suite *      suite_check_provide(void);
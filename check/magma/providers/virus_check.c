@@ -9,8 +9,10 @@
 
  bool_t check_virus_sthread(stringer_t *errmsg) {
 
+	size_t length = 0;
 	stringer_t *data = NULL;
 	uint32_t max = check_message_max();
+	uint64_t bytes = stats_get_value_by_name("provider.virus.scan.bytes"), memory = stats_get_value_by_name("provider.virus.scan.memory");
 
 	for (uint32_t i = 0; i < max && status(); i++) {
 
@@ -25,8 +27,21 @@
 			return false;
 		}
 
+		length += st_length_get(data);
 		st_cleanup(data);
 	}
 
+	// The messages should have been scanned straight from memory, without using the spool.
+	if (stats_get_value_by_name("provider.virus.scan.memory") - memory < max) {
+		st_sprint(errmsg, "The messages weren't scanned from memory. { scanned = %lu / messages = %u }",
+			stats_get_value_by_name("provider.virus.scan.memory") - memory, max);
+		return false;
+	}
+	else if (stats_get_value_by_name("provider.virus.scan.bytes") - bytes < length) {
+		st_sprint(errmsg, "The number of bytes scanned wasn't recorded. { recorded = %lu / scanned = %zu }",
+			stats_get_value_by_name("provider.virus.scan.bytes") - bytes, length);
+		return false;
+	}
+
 	return true;
 }
@@ -6,6 +6,52 @@
 
 #include "magma_check.h"
 
+START_TEST (check_imap_parse_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status() && !check_imap_parse_sthread(errmsg)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / PARSE / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_imap_parse_random_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status() && !check_imap_parse_random_sthread(errmsg)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / PARSE / RANDOM / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_imap_parse_benchmark_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024), *measured = MANAGEDBUF(256);
+
+	if (status() && !check_imap_parse_benchmark_sthread(errmsg, measured)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / PARSE / BENCHMARK / SINGLE THREADED:", errmsg);
+	log_measure(measured);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
 START_TEST (check_imap_network_basic_tcp_s) {
 
 	log_disable();
@@ -86,6 +132,126 @@ START_TEST (check_imap_network_fetch_s) {
 }
 END_TEST
 
+START_TEST (check_imap_network_condstore_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	server_t *server = NULL;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (!(server = servers_get_by_protocol(IMAP, false))) {
+		st_sprint(errmsg, "No IMAP servers were configured to support TCP connections.");
+		outcome = false;
+	}
+	else if (status() && !check_imap_network_condstore_sthread(errmsg, server->network.port, false)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / NETWORK / CONDSTORE / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_imap_network_compress_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	server_t *server = NULL;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (!(server = servers_get_by_protocol(IMAP, false))) {
+		st_sprint(errmsg, "No IMAP servers were configured to support TCP connections.");
+		outcome = false;
+	}
+	else if (status() && !check_imap_network_compress_sthread(errmsg, server->network.port, false)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / NETWORK / COMPRESS / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_imap_network_sort_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	server_t *server = NULL;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (!(server = servers_get_by_protocol(IMAP, false))) {
+		st_sprint(errmsg, "No IMAP servers were configured to support TCP connections.");
+		outcome = false;
+	}
+	else if (status() && !check_imap_network_sort_sthread(errmsg, server->network.port, false)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / NETWORK / SORT / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_imap_network_idle_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	server_t *server = NULL;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (!(server = servers_get_by_protocol(IMAP, false))) {
+		st_sprint(errmsg, "No IMAP servers were configured to support TCP connections.");
+		outcome = false;
+	}
+	else if (status() && !check_imap_network_idle_sthread(errmsg, server->network.port, false)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / NETWORK / IDLE / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_imap_network_literal_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	server_t *server = NULL;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (!(server = servers_get_by_protocol(IMAP, false))) {
+		st_sprint(errmsg, "No IMAP servers were configured to support TCP connections.");
+		outcome = false;
+	}
+	else if (status() && !check_imap_network_literal_sthread(errmsg, server->network.port, false)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / NETWORK / LITERAL / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_imap_network_move_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	server_t *server = NULL;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (!(server = servers_get_by_protocol(IMAP, false))) {
+		st_sprint(errmsg, "No IMAP servers were configured to support TCP connections.");
+		outcome = false;
+	}
+	else if (status() && !check_imap_network_move_sthread(errmsg, server->network.port, false)) {
+		outcome = false;
+	}
+
+	log_test("IMAP / NETWORK / MOVE / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
 START_TEST (check_imap_network_starttls_s) {
 
 	log_disable();
@@ -112,10 +278,19 @@ Suite * suite_check_imap(void) {
 
 	Suite *s = suite_create("\tIMAP");
 
+	suite_check_testcase(s, "IMAP", "IMAP Parse/S", check_imap_parse_s);
+	suite_check_testcase(s, "IMAP", "IMAP Parse Random/S", check_imap_parse_random_s);
+	suite_check_testcase(s, "IMAP", "IMAP Parse Benchmark/S", check_imap_parse_benchmark_s);
 	suite_check_testcase(s, "IMAP", "IMAP Network Basic/ TCP/S", check_imap_network_basic_tcp_s);
 	suite_check_testcase(s, "IMAP", "IMAP Network Basic/ TLS/S", check_imap_network_basic_tls_s);
 	suite_check_testcase(s, "IMAP", "IMAP Network Search/S", check_imap_network_search_s);
 	suite_check_testcase(s, "IMAP", "IMAP Network Fetch/S", check_imap_network_fetch_s);
+	suite_check_testcase(s, "IMAP", "IMAP Network CONDSTORE/S", check_imap_network_condstore_s);
+	suite_check_testcase(s, "IMAP", "IMAP Network COMPRESS/S", check_imap_network_compress_s);
+	suite_check_testcase(s, "IMAP", "IMAP Network SORT/S", check_imap_network_sort_s);
+	suite_check_testcase(s, "IMAP", "IMAP Network IDLE/S", check_imap_network_idle_s);
+	suite_check_testcase(s, "IMAP", "IMAP Network Literal/S", check_imap_network_literal_s);
+	suite_check_testcase(s, "IMAP", "IMAP Network MOVE/S", check_imap_network_move_s);
 	suite_check_testcase(s, "IMAP", "IMAP Network STARTTLS/S", check_imap_network_starttls_s);
 
 	return s;
@@ -10,13 +10,25 @@
 /// imap_check_network.c
 bool_t check_imap_client_read_end(client_t *client, chr_t *tag);
 bool_t check_imap_network_basic_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
+bool_t check_imap_network_compress_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
+bool_t check_imap_network_condstore_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
 bool_t check_imap_network_fetch_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
+bool_t check_imap_network_idle_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
+bool_t check_imap_network_literal_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
+bool_t check_imap_network_move_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
 bool_t check_imap_network_search_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
+bool_t check_imap_network_sort_sthread(stringer_t *errmsg, uint32_t port, bool_t secure);
 bool_t check_imap_client_close_logout(client_t *client, uint32_t tag_num, stringer_t *errmsg);
+bool_t check_imap_client_expect(client_t *client, chr_t *tag, chr_t *command, chr_t *expected);
 bool_t check_imap_client_select(client_t *client, chr_t *folder, chr_t *tag, stringer_t *errmsg);
 bool_t check_imap_network_starttls_sthread(stringer_t *errmsg, uint32_t tcp_port, uint32_t tls_port);
 bool_t check_imap_client_login(client_t *client, chr_t *user, chr_t *pass, chr_t *tag, stringer_t *errmsg);
 
+/// imap_check_parse.c
+bool_t check_imap_parse_benchmark_sthread(stringer_t *errmsg, stringer_t *measured);
+bool_t check_imap_parse_random_sthread(stringer_t *errmsg);
+bool_t check_imap_parse_sthread(stringer_t *errmsg);
+
 Suite * suite_check_imap(void);
 
 #endif
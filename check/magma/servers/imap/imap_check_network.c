@@ -317,7 +317,9 @@ bool_t check_imap_network_fetch_sthread(stringer_t *errmsg, uint32_t port, bool_
 		"FETCH 1:* INTERNALDATE\r\n"
 		"FETCH 1 (BODY [HEADER])\r\n",
 		"FETCH 1 (BODY.PEEK[HEADER])\r\n",
-		"FETCH 1 (FLAGS BODY[HEADER.FIELDS (DATE FROM SUBJECT)])\r\n"
+		"FETCH 1 (FLAGS BODY[HEADER.FIELDS (DATE FROM SUBJECT)])\r\n",
+		"FETCH 1:* (BODY.PEEK[])\r\n",
+		"FETCH 1:* (ENVELOPE RFC822.SIZE)\r\n"
 	};
 
 	// Check the initial response.
@@ -375,6 +377,383 @@ bool_t check_imap_network_fetch_sthread(stringer_t *errmsg, uint32_t port, bool_
 	return true;
 }
 
+/**
+ * @brief	Sends a command, and reads the response until the tagged line, recording whether an expected untagged response was seen.
+ *
+ * @param	client		The client_t* to print the command to. It should be connected to an IMAP server.
+ * @param	tag			A chr_t* holding the tag to place at the beginning of the command.
+ * @param	command		A chr_t* holding the command, without the tag or line terminator.
+ * @param	expected	A chr_t* holding a string which must appear in the response, or NULL.
+ * @return	True if the command completed successfully and the expected string was found, otherwise false.
+ */
+bool_t check_imap_client_expect(client_t *client, chr_t *tag, chr_t *command, chr_t *expected) {
+
+	bool_t found = (expected == NULL);
+	stringer_t *success = st_merge("nn", tag, " OK");
+
+	if (!success || client_print(client, "%s %s\r\n", tag, command) <= 0) {
+		st_cleanup(success);
+		return false;
+	}
+
+	while (client_read_line(client) > 0 && st_cmp_cs_starts(&(client->line), success)) {
+		if (expected && st_search_cs(&(client->line), NULLER(expected), NULL)) found = true;
+	}
+
+	// The expected string may also appear in the tagged response code.
+	if (expected && client_status(client) == 1 && st_search_cs(&(client->line), NULLER(expected), NULL)) found = true;
+
+	if (client_status(client) != 1 || st_cmp_cs_starts(&(client->line), success)) found = false;
+
+	st_free(success);
+	return found;
+}
+
+bool_t check_imap_network_condstore_sthread(stringer_t *errmsg, uint32_t port, bool_t secure) {
+
+	client_t *client = NULL;
+	chr_t *commands[][3] = {
+		{ "A1", "ENABLE QRESYNC", "* ENABLED" },
+		{ "A2", "SELECT Inbox", "* OK [HIGHESTMODSEQ " },
+		{ "A3", "STATUS Inbox (MESSAGES HIGHESTMODSEQ)", "HIGHESTMODSEQ " },
+		{ "A4", "FETCH 1:* (FLAGS MODSEQ)", "MODSEQ (" },
+		{ "A5", "UID FETCH 1:* (FLAGS) (CHANGEDSINCE 1 VANISHED)", NULL },
+		{ "A6", "STORE 1 (UNCHANGEDSINCE 0) +FLAGS (\\Flagged)", "[MODIFIED 1]" },
+		{ "A7", "SELECT Inbox (QRESYNC (1 1))", NULL }
+	};
+
+	// Check the initial response.
+	if (!(client = client_connect("localhost", port)) || (secure && (client_secure(client) == -1)) ||
+		!net_set_timeout(client->sockd, 20, 20) || client_read_line(client) <= 0 || (client->status != 1) ||
+		st_cmp_cs_starts(&(client->line), NULLER("* OK"))) {
+
+		st_sprint(errmsg, "Failed to connect with the IMAP server.");
+		client_close(client);
+		return false;
+	}
+	// Test the LOGIN command.
+	else if (!check_imap_client_login(client, "princess", "password", "A0", errmsg)) {
+		client_close(client);
+		return false;
+	}
+
+	// Test each of the commands, and make sure the CONDSTORE and QRESYNC responses are present.
+	for (uint32_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		if (!check_imap_client_expect(client, commands[i][0], commands[i][1], commands[i][2])) {
+			st_sprint(errmsg, "Failed to return the expected response. { command = \"%s\" }", commands[i][1]);
+			client_close(client);
+			return false;
+		}
+	}
+
+	// Test the LOGOUT command.
+	if (!check_imap_client_close_logout(client, 8, errmsg)) {
+		client_close(client);
+		return false;
+	}
+
+	client_close(client);
+
+	return true;
+}
+
+bool_t check_imap_network_move_sthread(stringer_t *errmsg, uint32_t port, bool_t secure) {
+
+	client_t *client = NULL;
+	chr_t *commands[][3] = {
+		{ "A1", "CAPABILITY", " MOVE" },
+		{ "A2", "CREATE MoveSource", NULL },
+		{ "A3", "CREATE MoveTarget", NULL },
+		{ "A4", "SELECT Inbox", NULL },
+		{ "A5", "COPY 1 MoveSource", "[COPYUID " },
+		{ "A6", "COPY 1 MoveSource", "[COPYUID " },
+		{ "A7", "SELECT MoveSource", "* 2 EXISTS" },
+		{ "A8", "MOVE 2 MoveTarget", "* 2 EXPUNGE" },
+		{ "A9", "UID MOVE 1:* MoveTarget", "* OK [COPYUID " },
+		{ "A10", "STATUS MoveTarget (MESSAGES)", "(MESSAGES 2)" },
+		{ "A11", "SELECT MoveTarget", "* 2 EXISTS" },
+		{ "A12", "DELETE MoveSource", NULL },
+		{ "A13", "DELETE MoveTarget", NULL }
+	};
+
+	// Check the initial response.
+	if (!(client = client_connect("localhost", port)) || (secure && (client_secure(client) == -1)) ||
+		!net_set_timeout(client->sockd, 20, 20) || client_read_line(client) <= 0 || (client->status != 1) ||
+		st_cmp_cs_starts(&(client->line), NULLER("* OK"))) {
+
+		st_sprint(errmsg, "Failed to connect with the IMAP server.");
+		client_close(client);
+		return false;
+	}
+	// Test the LOGIN command.
+	else if (!check_imap_client_login(client, "princess", "password", "A0", errmsg)) {
+		client_close(client);
+		return false;
+	}
+
+	// Test each of the commands, and make sure the messages are expunged from the source folder and arrive in the target.
+	for (uint32_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		if (!check_imap_client_expect(client, commands[i][0], commands[i][1], commands[i][2])) {
+			st_sprint(errmsg, "Failed to return the expected response. { command = \"%s\" }", commands[i][1]);
+			client_close(client);
+			return false;
+		}
+	}
+
+	// Test the LOGOUT command.
+	if (!check_imap_client_close_logout(client, 14, errmsg)) {
+		client_close(client);
+		return false;
+	}
+
+	client_close(client);
+
+	return true;
+}
+
+bool_t check_imap_network_sort_sthread(stringer_t *errmsg, uint32_t port, bool_t secure) {
+
+	client_t *client = NULL;
+	chr_t *commands[][3] = {
+		{ "A1", "CAPABILITY", "THREAD=REFERENCES" },
+		{ "A2", "SELECT Inbox", NULL },
+		{ "A3", "SORT (DATE) UTF-8 ALL", "* SORT" },
+		{ "A4", "SORT (REVERSE ARRIVAL SUBJECT) US-ASCII ALL", "* SORT" },
+		{ "A5", "UID SORT (FROM REVERSE SIZE) UTF-8 UNDELETED", "* SORT" },
+		{ "A6", "SORT (CC TO) UTF-8 1:*", "* SORT" },
+		{ "A7", "THREAD REFERENCES UTF-8 ALL", "* THREAD" },
+		{ "A8", "UID THREAD REFERENCES US-ASCII SINCE 01-Jan-2017", "* THREAD" }
+	};
+
+	// Check the initial response.
+	if (!(client = client_connect("localhost", port)) || (secure && (client_secure(client) == -1)) ||
+		!net_set_timeout(client->sockd, 20, 20) || client_read_line(client) <= 0 || (client->status != 1) ||
+		st_cmp_cs_starts(&(client->line), NULLER("* OK"))) {
+
+		st_sprint(errmsg, "Failed to connect with the IMAP server.");
+		client_close(client);
+		return false;
+	}
+	// Test the LOGIN command.
+	else if (!check_imap_client_login(client, "princess", "password", "A0", errmsg)) {
+		client_close(client);
+		return false;
+	}
+
+	// Test each of the commands, and make sure the untagged SORT and THREAD responses are present.
+	for (uint32_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		if (!check_imap_client_expect(client, commands[i][0], commands[i][1], commands[i][2])) {
+			st_sprint(errmsg, "Failed to return the expected response. { command = \"%s\" }", commands[i][1]);
+			client_close(client);
+			return false;
+		}
+	}
+
+	// An unsupported charset should be rejected, without closing the connection.
+	if (client_print(client, "A9 SORT (DATE) KOI8-R ALL\r\n") <= 0 || client_read_line(client) <= 0 ||
+		client_status(client) != 1 || st_cmp_cs_starts(&(client->line), NULLER("A9 NO [BADCHARSET"))) {
+		st_sprint(errmsg, "Failed to reject a SORT command with an unsupported charset.");
+		client_close(client);
+		return false;
+	}
+
+	// Test the LOGOUT command.
+	if (!check_imap_client_close_logout(client, 10, errmsg)) {
+		client_close(client);
+		return false;
+	}
+
+	client_close(client);
+
+	return true;
+}
+
+/**
+ * @brief	Read responses from the server until one containing the expected string arrives.
+ * @param	client	the client connection being read.
+ * @param	expected	the string being waited for.
+ * @return	true if the expected string was found, or false if the connection failed or timed out first.
+ */
+static bool_t check_imap_client_wait(client_t *client, chr_t *expected) {
+
+	while (client_read_line(client) > 0) {
+		if (st_search_cs(&(client->line), NULLER(expected), NULL)) return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief	Connect to the IMAP server and login.
+ * @param	port	the port the IMAP server is listening on.
+ * @param	secure	if true, the connection is secured with TLS.
+ * @param	errmsg	a managed string which will receive an error message on failure.
+ * @return	the connected client, or NULL on failure.
+ */
+static client_t * check_imap_client_open(uint32_t port, bool_t secure, stringer_t *errmsg) {
+
+	client_t *client = NULL;
+
+	if (!(client = client_connect("localhost", port)) || (secure && (client_secure(client) == -1)) ||
+		!net_set_timeout(client->sockd, 20, 20) || client_read_line(client) <= 0 || (client->status != 1) ||
+		st_cmp_cs_starts(&(client->line), NULLER("* OK"))) {
+
+		st_sprint(errmsg, "Failed to connect with the IMAP server.");
+		client_close(client);
+		return NULL;
+	}
+	else if (!check_imap_client_login(client, "princess", "password", "A0", errmsg)) {
+		client_close(client);
+		return NULL;
+	}
+
+	return client;
+}
+
+bool_t check_imap_network_idle_sthread(stringer_t *errmsg, uint32_t port, bool_t secure) {
+
+	client_t *idler = NULL, *other = NULL;
+	chr_t *setup[][3] = {
+		{ "A1", "CREATE IdleCheck", NULL },
+		{ "A2", "SELECT Inbox", NULL },
+		{ "A3", "COPY 1 IdleCheck", "[COPYUID " },
+		{ "A4", "COPY 1 IdleCheck", "[COPYUID " },
+		{ "A5", "SELECT IdleCheck", "* 2 EXISTS" }
+	};
+
+	if (!(idler = check_imap_client_open(port, secure, errmsg))) {
+		return false;
+	}
+	else if (!(other = check_imap_client_open(port, secure, errmsg))) {
+		client_close(idler);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < sizeof(setup) / sizeof(setup[0]); i++) {
+		if (!check_imap_client_expect(idler, setup[i][0], setup[i][1], setup[i][2])) {
+			st_sprint(errmsg, "Failed to return the expected response. { command = \"%s\" }", setup[i][1]);
+			client_close(idler);
+			client_close(other);
+			return false;
+		}
+	}
+
+	// The continuation request shows the session is idling. Every change made by the other session should be pushed to the
+	// idling session right away, well before the idle thread would poll for changes.
+	if (client_print(idler, "A6 IDLE\r\n") <= 0 || client_read_line(idler) <= 0 || st_cmp_cs_starts(&(idler->line), NULLER("+ idling"))) {
+		st_sprint(errmsg, "Failed to start idling.");
+	}
+	else if (!check_imap_client_expect(other, "A1", "SELECT Inbox", NULL) || !check_imap_client_expect(other, "A2", "COPY 1 IdleCheck", NULL) ||
+		!check_imap_client_wait(idler, "* 3 EXISTS")) {
+		st_sprint(errmsg, "The idling session wasn't told about a new message.");
+	}
+	else if (!check_imap_client_expect(other, "A3", "SELECT IdleCheck", NULL) ||
+		!check_imap_client_expect(other, "A4", "STORE 1 +FLAGS (\\Flagged)", NULL) || !check_imap_client_wait(idler, "\\Flagged")) {
+		st_sprint(errmsg, "The idling session wasn't told about a flag change.");
+	}
+	else if (!check_imap_client_expect(other, "A5", "STORE 2 +FLAGS (\\Deleted)", NULL) || !check_imap_client_expect(other, "A6", "EXPUNGE", NULL) ||
+		!check_imap_client_wait(idler, "* 2 EXPUNGE")) {
+		st_sprint(errmsg, "The idling session wasn't told about an expunged message.");
+	}
+	else if (client_print(idler, "DONE\r\n") <= 0 || !check_imap_client_read_end(idler, "A6")) {
+		st_sprint(errmsg, "Failed to terminate the IDLE command.");
+	}
+	else if (!check_imap_client_expect(other, "A7", "SELECT Inbox", NULL) || !check_imap_client_expect(idler, "A7", "SELECT Inbox", NULL) ||
+		!check_imap_client_expect(idler, "A8", "DELETE IdleCheck", NULL)) {
+		st_sprint(errmsg, "Failed to delete the folder used for the idle check.");
+	}
+	else if (check_imap_client_close_logout(other, 8, errmsg)) {
+		check_imap_client_close_logout(idler, 9, errmsg);
+	}
+
+	client_close(idler);
+	client_close(other);
+
+	return st_empty(errmsg);
+}
+
+/**
+ * @brief	Append a message larger than magma.imap.literal_spool, so the literal is read into a spooled memory map, and make sure the
+ * 			stored copy is intact.
+ */
+bool_t check_imap_network_literal_sthread(stringer_t *errmsg, uint32_t port, bool_t secure) {
+
+	size_t length;
+	uint64_t spooled;
+	client_t *client = NULL;
+	stringer_t *message = NULL, *header = NULLER("Subject: Spooled Literal Check\r\n\r\n");
+
+	// Build a message large enough to be spooled, using lines of 78 characters.
+	length = st_length_get(header) + (((magma.imap.literal_spool / 80) + 2) * 80);
+
+	if (!(message = st_alloc(length))) {
+		st_sprint(errmsg, "Failed to allocate the spooled literal message.");
+		return false;
+	}
+
+	st_copy_in(message, st_data_get(header), st_length_get(header));
+
+	for (size_t i = st_length_get(header); i < length; i += 80) {
+		mm_set(st_char_get(message) + i, 'x', 78);
+		mm_copy(st_char_get(message) + i + 78, "\r\n", 2);
+	}
+
+	st_length_set(message, length);
+	spooled = stats_get_value_by_name("imap.literals.spooled");
+
+	// Check the initial response.
+	if (!(client = client_connect("localhost", port)) || (secure && (client_secure(client) == -1)) ||
+		!net_set_timeout(client->sockd, 20, 20) || client_read_line(client) <= 0 || (client->status != 1) ||
+		st_cmp_cs_starts(&(client->line), NULLER("* OK"))) {
+
+		st_sprint(errmsg, "Failed to connect with the IMAP server.");
+		client_close(client);
+		st_free(message);
+		return false;
+	}
+	// Test the LOGIN command.
+	else if (!check_imap_client_login(client, "princess", "password", "A0", errmsg)) {
+		client_close(client);
+		st_free(message);
+		return false;
+	}
+	else if (!check_imap_client_expect(client, "A1", "CREATE LiteralSpool", NULL)) {
+		st_sprint(errmsg, "Failed to create the folder for the spooled literal.");
+		client_close(client);
+		st_free(message);
+		return false;
+	}
+
+	// Send a synchronizing literal, and wait for the continuation before sending the message.
+	if (client_print(client, "A2 APPEND LiteralSpool {%zu}\r\n", length) <= 0 || client_read_line(client) <= 0 ||
+		st_cmp_cs_starts(&(client->line), NULLER("+")) || client_write(client, message) != (int64_t)length ||
+		client_print(client, "\r\n") <= 0 || !check_imap_client_read_end(client, "A2")) {
+		st_sprint(errmsg, "Failed to append a message using a spooled literal.");
+	}
+	else if (stats_get_value_by_name("imap.literals.spooled") <= spooled) {
+		st_sprint(errmsg, "The large literal wasn't spooled.");
+	}
+	else if (!check_imap_client_expect(client, "A3", "SELECT LiteralSpool", "* 1 EXISTS")) {
+		st_sprint(errmsg, "The spooled literal wasn't stored.");
+	}
+	else if (!check_imap_client_expect(client, "A4", "FETCH 1 (BODY.PEEK[HEADER.FIELDS (SUBJECT)])", "Spooled Literal Check")) {
+		st_sprint(errmsg, "The message stored from the spooled literal doesn't match.");
+	}
+
+	st_free(message);
+
+	if (!check_imap_client_expect(client, "A5", "DELETE LiteralSpool", NULL) && st_empty(errmsg)) {
+		st_sprint(errmsg, "Failed to delete the folder used for the spooled literal.");
+	}
+	else if (st_empty(errmsg)) {
+		check_imap_client_close_logout(client, 6, errmsg);
+	}
+
+	client_close(client);
+
+	return st_empty(errmsg);
+}
+
 bool_t check_imap_network_starttls_sthread(stringer_t *errmsg, uint32_t tcp_port, uint32_t tls_port) {
 
 	size_t location = 0;
@@ -445,3 +824,133 @@ bool_t check_imap_network_starttls_sthread(stringer_t *errmsg, uint32_t tcp_port
 	client_close(client);
 	return true;
 }
+
+/**
+ * @brief	Send a command across a compressed IMAP session, and wait for the tagged response.
+ * @param	client		the client connection, which has already negotiated COMPRESS=DEFLATE.
+ * @param	deflate		the stream used to compress the client output.
+ * @param	inflate		the stream used to decompress the server responses.
+ * @param	tag			the command tag.
+ * @param	command		the command, and its arguments.
+ * @param	expected	the prefix of the expected tagged response.
+ * @return	true if the tagged response was found and began with the expected prefix, otherwise false.
+ */
+static bool_t check_imap_client_deflate(client_t *client, z_stream *deflate, z_stream *inflate, chr_t *tag, chr_t *command, chr_t *expected) {
+
+	size_t location = 0;
+	uchr_t compressed[4096];
+	stringer_t *line = NULL, *output = MANAGEDBUF(65536), *response = NULL;
+
+	if (!(line = st_merge("nsnsn", tag, " ", command, "\r\n")) || !(response = st_merge("nsn", "\r\n", tag, " "))) {
+		st_cleanup(line, response);
+		return false;
+	}
+
+	deflate->next_in = st_data_get(line);
+	deflate->avail_in = st_length_get(line);
+	deflate->next_out = compressed;
+	deflate->avail_out = sizeof(compressed);
+
+	if (deflate_d(deflate, Z_SYNC_FLUSH) != Z_OK || client_write(client, PLACER(compressed, sizeof(compressed) - deflate->avail_out)) !=
+		sizeof(compressed) - deflate->avail_out) {
+		st_free(line);
+		st_free(response);
+		return false;
+	}
+
+	// Prepend a line break, so the tag is only matched at the start of a line, and then decompress until the tagged response arrives.
+	st_sprint(output, "\r\n");
+
+	while (st_search_cs(output, response, &location) && client_read(client) > 0) {
+
+		inflate->next_in = st_data_get(client->buffer);
+		inflate->avail_in = st_length_get(client->buffer);
+		inflate->next_out = st_data_get(output) + st_length_get(output);
+		inflate->avail_out = st_avail_get(output) - st_length_get(output);
+
+		if (inflate_d(inflate, Z_SYNC_FLUSH) != Z_OK || inflate->avail_in) {
+			st_free(line);
+			st_free(response);
+			return false;
+		}
+
+		st_length_set(output, st_avail_get(output) - inflate->avail_out);
+		st_length_set(client->buffer, 0);
+	}
+
+	if (st_search_cs(output, response, &location) || st_cmp_cs_starts(PLACER(st_char_get(output) + location + 2,
+		st_length_get(output) - location - 2), NULLER(expected))) {
+		st_free(line);
+		st_free(response);
+		return false;
+	}
+
+	st_free(line);
+	st_free(response);
+	return true;
+}
+
+bool_t check_imap_network_compress_sthread(stringer_t *errmsg, uint32_t port, bool_t secure) {
+
+	client_t *client = NULL;
+	z_stream deflate, inflate;
+	size_t location = 0;
+
+	mm_wipe(&deflate, sizeof(z_stream));
+	mm_wipe(&inflate, sizeof(z_stream));
+
+	// Check the initial response.
+	if (!(client = client_connect("localhost", port)) || (secure && (client_secure(client) == -1)) ||
+		!net_set_timeout(client->sockd, 20, 20) || client_read_line(client) <= 0 || (client->status != 1) ||
+		st_cmp_cs_starts(&(client->line), NULLER("* OK")) || st_search_cs(&(client->line), NULLER("COMPRESS=DEFLATE"), &location)) {
+
+		st_sprint(errmsg, "Failed to connect with the IMAP server, or COMPRESS=DEFLATE wasn't advertised.");
+		client_close(client);
+		return false;
+	}
+	// Compression is only available after authentication.
+	else if (check_imap_client_expect(client, "A0", "COMPRESS DEFLATE", NULL)) {
+		st_sprint(errmsg, "The COMPRESS command was accepted before authentication.");
+		client_close(client);
+		return false;
+	}
+	else if (!check_imap_client_login(client, "princess", "password", "A1", errmsg)) {
+		client_close(client);
+		return false;
+	}
+	else if (!check_imap_client_expect(client, "A2", "COMPRESS DEFLATE", NULL)) {
+		st_sprint(errmsg, "Failed to enable DEFLATE compression.");
+		client_close(client);
+		return false;
+	}
+	else if (deflateInit2__d(&deflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY, ZLIB_VERSION, sizeof(z_stream)) != Z_OK ||
+		inflateInit2__d(&inflate, -15, ZLIB_VERSION, sizeof(z_stream)) != Z_OK) {
+		st_sprint(errmsg, "Failed to initialize the client compression streams.");
+		deflateEnd_d(&deflate);
+		client_close(client);
+		return false;
+	}
+
+	// Every command from here on is compressed, in both directions.
+	if (!check_imap_client_deflate(client, &deflate, &inflate, "A3", "NOOP", "OK")) {
+		st_sprint(errmsg, "Failed to return a successful state after a compressed NOOP.");
+	}
+	else if (!check_imap_client_deflate(client, &deflate, &inflate, "A4", "SELECT Inbox", "OK")) {
+		st_sprint(errmsg, "Failed to return a successful state after a compressed SELECT.");
+	}
+	else if (!check_imap_client_deflate(client, &deflate, &inflate, "A5", "FETCH 1:* (FLAGS RFC822.SIZE)", "OK")) {
+		st_sprint(errmsg, "Failed to return a successful state after a compressed FETCH.");
+	}
+	else if (!check_imap_client_deflate(client, &deflate, &inflate, "A6", "COMPRESS DEFLATE", "NO [COMPRESSIONACTIVE]")) {
+		st_sprint(errmsg, "Failed to reject a second COMPRESS command.");
+	}
+	else if (!check_imap_client_deflate(client, &deflate, &inflate, "A7", "LOGOUT", "OK")) {
+		st_sprint(errmsg, "Failed to return a successful state after a compressed LOGOUT.");
+	}
+
+	deflateEnd_d(&deflate);
+	inflateEnd_d(&inflate);
+	client_close(client);
+
+	return st_empty(errmsg);
+}
@@ -0,0 +1,236 @@
+
+/**
+ * @file /magma/check/magma/servers/imap/imap_check_parse.c
+ *
+ * @brief Checks the IMAP command parser against known commands, and against randomly generated input, and times it over a recorded command corpus.
+ */
+
+#include "magma_check.h"
+
+/**
+ * @brief	Parse a command line using a connection which isn't attached to the network.
+ * @note	The line must not contain any literals, since those are read from the network.
+ * @param	con		a pointer to a zeroed connection, which receives the parsed tag, command and arguments.
+ * @param	line	a null-terminated string holding the command line, including the line terminator.
+ * @return	the value returned by imap_command_parser().
+ */
+static int_t check_imap_parse_line(connection_t *con, chr_t *line) {
+
+	con->network.line = pl_init(line, ns_length_get(line));
+	return imap_command_parser(con);
+}
+
+/**
+ * @brief	Release the tag, command and arguments left behind in a connection by the command parser.
+ * @param	con		a pointer to the connection.
+ * @return	This function returns no value.
+ */
+static void check_imap_parse_cleanup(connection_t *con) {
+
+	st_cleanup(con->imap.tag);
+	st_cleanup(con->imap.command);
+	if (con->imap.arguments) ar_free(con->imap.arguments);
+
+	con->imap.tag = con->imap.command = NULL;
+	con->imap.arguments = NULL;
+
+	return;
+}
+
+/**
+ * @brief	Check the type, and optionally the value, of an element in a parsed argument array.
+ * @param	array	a pointer to the parsed argument array.
+ * @param	element	the zero-based index of the element being checked.
+ * @param	type	the expected IMAP argument type.
+ * @param	value	if not NULL, the expected value of a string element.
+ * @return	true if the element matches, otherwise false.
+ */
+static bool_t check_imap_parse_element(imap_arguments_t *array, size_t element, int_t type, chr_t *value) {
+
+	stringer_t *string;
+
+	if (!array || element >= ar_length_get(array) || imap_get_type_ar(array, element) != type) {
+		return false;
+	}
+	else if (value && (!(string = imap_get_st_ar(array, element)) || st_cmp_cs_eq(string, NULLER(value)))) {
+		return false;
+	}
+
+	return true;
+}
+
+bool_t check_imap_parse_sthread(stringer_t *errmsg) {
+
+	int_t result;
+	connection_t con;
+	imap_arguments_t *inner;
+
+	mm_wipe(&con, sizeof(connection_t));
+
+	// A fetch, with the nested arrays used by a section specifier.
+	if ((result = check_imap_parse_line(&con, "A001 UID FETCH 1:* (FLAGS BODY.PEEK[HEADER.FIELDS (From To)])\r\n")) != 1 ||
+		st_cmp_cs_eq(con.imap.tag, NULLER("A001")) || st_cmp_cs_eq(con.imap.command, NULLER("FETCH")) || con.imap.uid != 1 ||
+		ar_length_get(con.imap.arguments) != 2 || !check_imap_parse_element(con.imap.arguments, 0, IMAP_ARGUMENT_TYPE_ASTRING, "1:*") ||
+		!check_imap_parse_element(con.imap.arguments, 1, IMAP_ARGUMENT_TYPE_ARRAY, NULL) ||
+		ar_length_get((inner = imap_get_ar_ar(con.imap.arguments, 1))) != 3 ||
+		!check_imap_parse_element(inner, 0, IMAP_ARGUMENT_TYPE_NSTRING, "FLAGS") ||
+		!check_imap_parse_element(inner, 1, IMAP_ARGUMENT_TYPE_NSTRING, "BODY.PEEK") ||
+		!check_imap_parse_element(inner, 2, IMAP_ARGUMENT_TYPE_ARRAY, NULL) ||
+		ar_length_get((inner = imap_get_ar_ar(inner, 2))) != 2 ||
+		!check_imap_parse_element(inner, 0, IMAP_ARGUMENT_TYPE_NSTRING, "HEADER.FIELDS") ||
+		!check_imap_parse_element(inner, 1, IMAP_ARGUMENT_TYPE_ARRAY, NULL) ||
+		ar_length_get((inner = imap_get_ar_ar(inner, 1))) != 2 ||
+		!check_imap_parse_element(inner, 0, IMAP_ARGUMENT_TYPE_NSTRING, "From") ||
+		!check_imap_parse_element(inner, 1, IMAP_ARGUMENT_TYPE_NSTRING, "To")) {
+		st_sprint(errmsg, "Failed to parse a FETCH command with nested arrays. { result = %i }", result);
+		check_imap_parse_cleanup(&con);
+		return false;
+	}
+
+	check_imap_parse_cleanup(&con);
+
+	// Quoted strings, with an escape, and an empty string which yields a NULL value.
+	if ((result = check_imap_parse_line(&con, "a2 LOGIN \"jo\\\"hn\" \"\"\r\n")) != 1 || con.imap.uid != 0 ||
+		ar_length_get(con.imap.arguments) != 2 || !check_imap_parse_element(con.imap.arguments, 0, IMAP_ARGUMENT_TYPE_QSTRING, "jo\"hn") ||
+		!check_imap_parse_element(con.imap.arguments, 1, IMAP_ARGUMENT_TYPE_QSTRING, NULL) || imap_get_ptr(con.imap.arguments, 1)) {
+		st_sprint(errmsg, "Failed to parse a LOGIN command with quoted strings. { result = %i }", result);
+		check_imap_parse_cleanup(&con);
+		return false;
+	}
+
+	check_imap_parse_cleanup(&con);
+
+	// An empty list is stored as an array element without a value.
+	if ((result = check_imap_parse_line(&con, "a3 STATUS Inbox ()\r\n")) != 1 || ar_length_get(con.imap.arguments) != 2 ||
+		!check_imap_parse_element(con.imap.arguments, 1, IMAP_ARGUMENT_TYPE_ARRAY, NULL) || imap_get_ptr(con.imap.arguments, 1)) {
+		st_sprint(errmsg, "Failed to parse a STATUS command with an empty list. { result = %i }", result);
+		check_imap_parse_cleanup(&con);
+		return false;
+	}
+
+	check_imap_parse_cleanup(&con);
+
+	// A command without any arguments.
+	if ((result = check_imap_parse_line(&con, "a4 NOOP\r\n")) != 1 || con.imap.arguments) {
+		st_sprint(errmsg, "Failed to parse a command without arguments. { result = %i }", result);
+		check_imap_parse_cleanup(&con);
+		return false;
+	}
+
+	check_imap_parse_cleanup(&con);
+
+	// A list long enough to outgrow the parser's local scratch space.
+	if ((result = check_imap_parse_line(&con, "a5 STORE 1 +FLAGS (a b c d e f g h i j k l m n o p q r s t u v w x y z)\r\n")) != 1 ||
+		ar_length_get(con.imap.arguments) != 3 || ar_length_get(imap_get_ar_ar(con.imap.arguments, 2)) != 26 ||
+		!check_imap_parse_element(imap_get_ar_ar(con.imap.arguments, 2), 25, IMAP_ARGUMENT_TYPE_NSTRING, "z")) {
+		st_sprint(errmsg, "Failed to parse a STORE command with a long list. { result = %i }", result);
+		check_imap_parse_cleanup(&con);
+		return false;
+	}
+
+	check_imap_parse_cleanup(&con);
+
+	// Malformed input must be rejected, and leave no arguments behind.
+	if (check_imap_parse_line(&con, "\r\n") != -1 || check_imap_parse_line(&con, "a6\r\n") != -2 ||
+		check_imap_parse_line(&con, "a7 SELECT \"Inbox\r\n") != -3 || con.imap.arguments ||
+		check_imap_parse_line(&con, "a8 FETCH 1 (FLAGS\r\n") != -3 || con.imap.arguments ||
+		check_imap_parse_line(&con, "a9 SELECT \"In\x80\"\r\n") != -3 || con.imap.arguments) {
+		st_sprint(errmsg, "Failed to reject a malformed command.");
+		check_imap_parse_cleanup(&con);
+		return false;
+	}
+
+	check_imap_parse_cleanup(&con);
+
+	return true;
+}
+
+bool_t check_imap_parse_random_sthread(stringer_t *errmsg) {
+
+	size_t length;
+	connection_t con;
+	chr_t line[IMAP_CHECK_PARSE_LENGTH + 3];
+	// Everything the grammar treats specially, except the opening brace of a literal, which would require a network connection.
+	chr_t alphabet[] = "abcXYZ019:*.\\\"()[]<>+- \t\x01\x7f\x80\xff";
+
+	mm_wipe(&con, sizeof(connection_t));
+
+	for (uint64_t i = 0; status() && i < IMAP_CHECK_PARSE_ITERATIONS; i++) {
+
+		length = rand_get_uint32() % IMAP_CHECK_PARSE_LENGTH;
+
+		for (size_t j = 0; j < length; j++) {
+			line[j] = alphabet[rand_get_uint32() % (sizeof(alphabet) - 1)];
+		}
+
+		line[length] = '\r';
+		line[length + 1] = '\n';
+		line[length + 2] = '\0';
+
+		// Any outcome is acceptable, provided the parser doesn't crash, and doesn't return arguments for a line it rejected.
+		con.network.line = pl_init(line, length + 2);
+
+		if (imap_command_parser(&con) != 1 && con.imap.arguments) {
+			st_sprint(errmsg, "The parser returned arguments for a rejected command. { line = %.*s }", (int)length, line);
+			check_imap_parse_cleanup(&con);
+			return false;
+		}
+
+		check_imap_parse_cleanup(&con);
+	}
+
+	return true;
+}
+
+bool_t check_imap_parse_benchmark_sthread(stringer_t *errmsg, stringer_t *measured) {
+
+	connection_t con;
+	uint64_t elapsed, count = 0;
+	struct timeval start, end;
+	// Command lines recorded from real clients, minus any literals, which would require a network connection.
+	chr_t *corpus[] = {
+		"a001 CAPABILITY\r\n",
+		"a002 LOGIN \"magma\" \"password\"\r\n",
+		"a003 LIST \"\" \"*\"\r\n",
+		"a004 SELECT \"Inbox\" (CONDSTORE)\r\n",
+		"a005 STATUS \"Sent Items\" (MESSAGES RECENT UIDNEXT UIDVALIDITY UNSEEN HIGHESTMODSEQ)\r\n",
+		"a006 UID FETCH 1:* (FLAGS) (CHANGEDSINCE 1024)\r\n",
+		"a007 UID FETCH 1,3,5:9,12,15:22,31,40:48,52,60:75,81,90:99,104,110:128,133,140:160,171,180:200,215,220:256 "
+			"(UID RFC822.SIZE FLAGS INTERNALDATE BODY.PEEK[HEADER.FIELDS (From To Cc Bcc Subject Date Message-ID Priority "
+			"X-Priority References Newsgroups In-Reply-To Content-Type Reply-To)])\r\n",
+		"a008 UID FETCH 42 (BODYSTRUCTURE BODY.PEEK[1.MIME] BODY.PEEK[1]<0.2048>)\r\n",
+		"a009 UID SEARCH UNDELETED UNSEEN SINCE 1-Jan-2016 OR FROM \"alice@example.com\" SUBJECT \"quarterly report\" "
+			"NOT HEADER X-Spam-Flag YES LARGER 4096\r\n",
+		"a010 UID STORE 1:64 +FLAGS.SILENT (\\Seen \\Flagged $Forwarded)\r\n",
+		"a011 UID COPY 7,9,11:15 \"Archive/2016\"\r\n",
+		"a012 UID EXPUNGE 1:64\r\n",
+		"a013 IDLE\r\n",
+		"a014 NOOP\r\n",
+		"a015 LOGOUT\r\n"
+	};
+
+	mm_wipe(&con, sizeof(connection_t));
+	gettimeofday(&start, NULL);
+
+	for (uint64_t i = 0; status() && i < IMAP_CHECK_PARSE_ROUNDS; i++) {
+		for (size_t j = 0; j < sizeof(corpus) / sizeof(chr_t *); j++, count++) {
+
+			if (check_imap_parse_line(&con, corpus[j]) != 1) {
+				st_sprint(errmsg, "Failed to parse a command from the recorded corpus. { line = %.*s }",
+					(int)(ns_length_get(corpus[j]) - 2), corpus[j]);
+				check_imap_parse_cleanup(&con);
+				return false;
+			}
+
+			check_imap_parse_cleanup(&con);
+		}
+	}
+
+	gettimeofday(&end, NULL);
+	elapsed = ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+
+	st_sprint(measured, "Parsed %lu commands in %lu microseconds, for %lu commands per second.", count, elapsed,
+		elapsed ? (count * 1000000) / elapsed : count * 1000000);
+
+	return true;
+}
@@ -321,3 +321,107 @@ bool_t check_smtp_checkers_rbl_sthread(stringer_t *errmsg) {
 	mm_free(con.network.reverse.ip);
 	return true;
 }
+
+/**
+ * @brief	A stub name server, which lists 127.0.0.2 on the "listed.check" blacklist, never answers queries for the "slow.check"
+ * 			blacklist, and reports every other name as missing.
+ * @param	sock	a pointer to the bound UDP socket the stub answers on, which is closed by the caller to stop the stub.
+ * @return	This function always returns NULL.
+ */
+static void * check_smtp_checkers_rbl_stub(int *sock) {
+
+	ns_msg msg;
+	ns_rr record;
+	HEADER *header;
+	ssize_t received;
+	struct pollfd pfd;
+	socklen_t length;
+	struct sockaddr_in from;
+	uchr_t packet[NS_PACKETSZ];
+	uchr_t answer[] = { 0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x04, 0x7f, 0x00, 0x00, 0x02 };
+
+	pfd.fd = *sock;
+	pfd.events = POLLIN;
+
+	while (poll(&pfd, 1, 100) >= 0 && !(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+
+		length = sizeof(struct sockaddr_in);
+
+		if (!(pfd.revents & POLLIN) || (received = recvfrom(*sock, packet, NS_PACKETSZ - sizeof(answer), 0, (struct sockaddr *)&from, &length)) <= 0 ||
+			ns_initparse(packet, received, &msg) || ns_parserr(&msg, ns_s_qd, 0, &record) || !st_cmp_cs_ends(NULLER((chr_t *)ns_rr_name(record)),
+			CONSTANT(".slow.check"))) {
+			continue;
+		}
+
+		header = (HEADER *)packet;
+		header->qr = 1;
+		header->ra = 1;
+
+		if (!st_cmp_cs_eq(NULLER((chr_t *)ns_rr_name(record)), CONSTANT("2.0.0.127.listed.check"))) {
+			mm_copy(packet + received, answer, sizeof(answer));
+			header->ancount = htons(1);
+			received += sizeof(answer);
+			header->rcode = ns_r_noerror;
+		}
+		else {
+			header->rcode = ns_r_nxdomain;
+		}
+
+		sendto(*sock, packet, received, 0, (struct sockaddr *)&from, length);
+	}
+
+	return NULL;
+}
+
+bool_t check_smtp_checkers_rbl_stub_sthread(stringer_t *errmsg) {
+
+	int_t result;
+	int sock = -1;
+	pthread_t stub;
+	socklen_t length;
+	uint64_t elapsed;
+	struct sockaddr_in resolver;
+	struct timeval start, end;
+	stringer_t *lists[] = { NULLER("clean.check"), NULLER("slow.check"), NULLER("listed.check") };
+
+	mm_wipe(&resolver, sizeof(struct sockaddr_in));
+	resolver.sin_family = AF_INET;
+	resolver.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	length = sizeof(struct sockaddr_in);
+
+	if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) == -1 || bind(sock, (struct sockaddr *)&resolver, length) ||
+		getsockname(sock, (struct sockaddr *)&resolver, &length) || pthread_create(&stub, NULL, (void *(*)(void *))&check_smtp_checkers_rbl_stub, &sock)) {
+		st_sprint(errmsg, "Unable to start the stub name server.");
+		if (sock != -1) close(sock);
+		return false;
+	}
+
+	// The listing should be found without waiting for the list which never answers.
+	gettimeofday(&start, NULL);
+	result = smtp_rbl_query(NULLER("2.0.0.127"), lists, 3, (struct sockaddr *)&resolver, length);
+	gettimeofday(&end, NULL);
+	elapsed = (((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec)) / 1000;
+
+	if (result != -2) {
+		st_sprint(errmsg, "The stub blacklist listing wasn't found. { result = %i }", result);
+	}
+	else if (elapsed >= magma.smtp.blacklists.timeout / 2) {
+		st_sprint(errmsg, "The blacklist queries waited on the list which never answers. { elapsed = %lu }", elapsed);
+	}
+	else if ((result = smtp_rbl_query(NULLER("1.0.0.127"), lists, 1, (struct sockaddr *)&resolver, length)) != 1) {
+		st_sprint(errmsg, "The stub blacklist reported an address which isn't listed. { result = %i }", result);
+	}
+	else if ((result = smtp_rbl_query(NULLER("2.0.0.127"), lists + 1, 1, (struct sockaddr *)&resolver, length)) != -1) {
+		st_sprint(errmsg, "The blacklist which never answers returned a verdict. { result = %i }", result);
+	}
+	// A clean answer from some of the lists, while another never answers, shouldn't be reported as a complete verdict.
+	else if ((result = smtp_rbl_query(NULLER("1.0.0.127"), lists, 2, (struct sockaddr *)&resolver, length)) != 0) {
+		st_sprint(errmsg, "The blacklist queries reported a complete verdict when one list never answered. { result = %i }", result);
+	}
+
+	shutdown(sock, SHUT_RDWR);
+	pthread_join(stub, NULL);
+	close(sock);
+
+	return st_empty(errmsg);
+}
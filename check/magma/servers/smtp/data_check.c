@@ -0,0 +1,196 @@
+/**
+ * @file /check/magma/servers/smtp/data_check.c
+ *
+ * @brief SMTP DATA reader test functions.
+ */
+
+#include "magma_check.h"
+
+typedef struct {
+	int sockd;
+	stringer_t *input;
+} check_smtp_data_writer_t;
+
+/**
+ * @brief	Write the client side of a DATA transfer, and then close the socket.
+ * @note	The write runs on its own thread, so messages larger than the socket buffer can be sent while the reader drains it.
+ * @param	writer	the socket, and the message data to be written.
+ * @return	This function returns no value.
+ */
+static void check_smtp_data_write(check_smtp_data_writer_t *writer) {
+
+	ssize_t written;
+	size_t position = 0;
+
+	while (position < st_length_get(writer->input) &&
+		(written = send(writer->sockd, st_char_get(writer->input) + position, st_length_get(writer->input) - position, MSG_NOSIGNAL)) > 0) {
+		position += written;
+	}
+
+	// Closing the write end means a missing terminator will end the read, instead of blocking forever.
+	close(writer->sockd);
+	pthread_exit(NULL);
+	return;
+}
+
+/**
+ * @brief	Feed a message into the SMTP DATA reader over a local socket pair.
+ * @param	input		the raw message data, as a client would send it, including the terminating sequence.
+ * @param	chunk		the size of the network buffer, which controls how many bytes are handed to the reader at a time.
+ * @param	suggested	the message size announced by the client with the SIZE parameter, or 0 if none was provided.
+ * @param	output		the address of a managed string pointer that will receive the message.
+ * @return	the result returned by smtp_data_read(), or -5 if the socket pair couldn't be setup.
+ */
+static int_t check_smtp_data_read(stringer_t *input, size_t chunk, size_t suggested, stringer_t **output) {
+
+	int_t result;
+	int pair[2];
+	pthread_t thread;
+	connection_t con;
+	check_smtp_data_writer_t writer;
+
+	*output = NULL;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair)) {
+		return -5;
+	}
+
+	mm_wipe(&con, sizeof(connection_t));
+	con.network.sockd = pair[0];
+	con.network.status = 1;
+	con.smtp.max_length = 1024 * 1024;
+	con.smtp.suggested_length = suggested;
+
+	writer.sockd = pair[1];
+	writer.input = input;
+
+	if (!(con.network.buffer = st_alloc(chunk))) {
+		close(pair[0]);
+		close(pair[1]);
+		return -5;
+	}
+	else if (thread_launch(&thread, &check_smtp_data_write, &writer)) {
+		st_free(con.network.buffer);
+		close(pair[0]);
+		close(pair[1]);
+		return -5;
+	}
+
+	result = smtp_data_read(&con, output);
+
+	// Closing the read end first unblocks the writer if the reader stopped early.
+	close(pair[0]);
+	thread_join(thread);
+	st_free(con.network.buffer);
+
+	return result;
+}
+
+bool_t check_smtp_data_sthread(stringer_t *errmsg, stringer_t *measured) {
+
+	int_t result;
+	uint64_t remapped, elapsed = 0;
+	struct timespec start, end;
+	stringer_t *output = NULL, *input = NULL, *body = NULL;
+	stringer_t *stuffed = NULLER("Subject: Dots\r\n\r\n..stuffed\r\n..\r\nbare\nline\r\n...\r\n.\r\n"),
+		*unstuffed = NULLER("Subject: Dots\r\n\r\n.stuffed\r\n.\r\nbare\r\nline\r\n..\r\n"),
+		*lf = NULLER("Subject: Bare\n\nline\n.\n"), *crlf = NULLER("Subject: Bare\r\n\r\nline\r\n");
+
+	// Every chunk size lands the dot stuffing, and the terminator, on a different read boundary.
+	for (size_t chunk = 1; chunk <= 8; chunk++) {
+
+		if ((result = check_smtp_data_read(stuffed, chunk, 0, &output)) != 1 || st_cmp_cs_eq(output, unstuffed)) {
+			st_sprint(errmsg, "The DATA reader failed to unstuff the message. { chunk = %zu / result = %i / output = %.*s }",
+				chunk, result, st_length_int(output), st_char_get(output));
+			st_cleanup(output);
+			return false;
+		}
+
+		st_free(output);
+
+		if ((result = check_smtp_data_read(lf, chunk, 0, &output)) != 1 || st_cmp_cs_eq(output, crlf)) {
+			st_sprint(errmsg, "The DATA reader failed to normalize bare line feeds. { chunk = %zu / result = %i / output = %.*s }",
+				chunk, result, st_length_int(output), st_char_get(output));
+			st_cleanup(output);
+			return false;
+		}
+
+		st_free(output);
+	}
+
+	// A message without a terminator should be reported as a disconnect.
+	if ((result = check_smtp_data_read(NULLER("Subject: Cut\r\n\r\nline\r\n.."), 4, 0, &output)) != -4 || output) {
+		st_sprint(errmsg, "The DATA reader accepted a message which was never terminated. { result = %i }", result);
+		st_cleanup(output);
+		return false;
+	}
+
+	// Build a message big enough that it would outgrow the default buffer, if the SIZE hint were ignored.
+	if (!(body = st_alloc(256 * 1024)) || !(input = st_alloc(256 * 1024 + 64))) {
+		st_sprint(errmsg, "Unable to allocate the SIZE test message.");
+		st_cleanup(body, input);
+		return false;
+	}
+
+	mm_set(st_data_get(body), 'a', 256 * 1024);
+	for (size_t i = 78; i < 256 * 1024; i += 80) {
+		*(st_char_get(body) + i) = '\r';
+		*(st_char_get(body) + i + 1) = '\n';
+	}
+
+	st_length_set(body, 256 * 1024);
+	st_sprint(input, "Subject: Size\r\n\r\n%.*s\r\n.\r\n", st_length_int(body), st_char_get(body));
+
+	// When the SIZE hint is provided, the buffer should be allocated once, and never remapped.
+	remapped = stats_get_value_by_name("smtp.data.remapped");
+
+	if ((result = check_smtp_data_read(input, magma.system.network_buffer, st_length_get(input), &output)) != 1 ||
+		st_length_get(output) != st_length_get(input) - 3 || st_avail_get(output) < st_length_get(output) ||
+		stats_get_value_by_name("smtp.data.remapped") != remapped) {
+		st_sprint(errmsg, "The DATA reader didn't presize the buffer using the SIZE hint. { result = %i / length = %zu / avail = %zu / remapped = %lu }",
+			result, st_length_get(output), st_avail_get(output), stats_get_value_by_name("smtp.data.remapped") - remapped);
+		st_cleanup(output, input, body);
+		return false;
+	}
+
+	st_free(output);
+
+	// Without a hint, the buffer should grow until the message fits.
+	remapped = stats_get_value_by_name("smtp.data.remapped");
+
+	if ((result = check_smtp_data_read(input, magma.system.network_buffer, 0, &output)) != 1 || st_length_get(output) != st_length_get(input) - 3 ||
+		st_avail_get(output) < st_length_get(output) || stats_get_value_by_name("smtp.data.remapped") == remapped) {
+		st_sprint(errmsg, "The DATA reader failed to grow the buffer. { result = %i / length = %zu / avail = %zu }",
+			result, st_length_get(output), st_avail_get(output));
+		st_cleanup(output, input, body);
+		return false;
+	}
+
+	st_free(output);
+
+	// Measure how fast the reader processes the message, using the processor time of this thread, so the writer thread isn't counted.
+	for (uint32_t i = 0; i < SMTP_CHECK_DATA_ROUNDS && status(); i++) {
+
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+		result = check_smtp_data_read(input, magma.system.network_buffer, st_length_get(input), &output);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+
+		st_cleanup(output);
+		output = NULL;
+
+		if (result != 1) {
+			st_sprint(errmsg, "The DATA reader failed while being timed. { result = %i / round = %u }", result, i);
+			st_cleanup(input, body);
+			return false;
+		}
+
+		elapsed += ((end.tv_sec - start.tv_sec) * 1000000) + ((end.tv_nsec - start.tv_nsec) / 1000);
+	}
+
+	st_sprint(measured, "Read %u messages of %zu bytes using DATA. { cpu = %lu microseconds / throughput = %lu MB per core second }",
+		SMTP_CHECK_DATA_ROUNDS, st_length_get(input), elapsed, elapsed ? (SMTP_CHECK_DATA_ROUNDS * st_length_get(input)) / elapsed : 0);
+
+	st_cleanup(input, body);
+
+	return true;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file /check/magma/servers/smtp/inspect_check.c
+ *
+ * @brief SMTP content checker pool test functions.
+ */
+
+#include "magma_check.h"
+
+/**
+ * @brief	Sum the content check latency histograms.
+ * @return	the number of content checks which have been run.
+ */
+static uint64_t check_smtp_inspect_count(void) {
+
+	uint64_t result = 0;
+	chr_t *names[] = { "smtp.checks.virus.10ms", "smtp.checks.virus.100ms", "smtp.checks.virus.1s", "smtp.checks.virus.10s",
+		"smtp.checks.virus.slow", "smtp.checks.dkim.10ms", "smtp.checks.dkim.100ms", "smtp.checks.dkim.1s", "smtp.checks.dkim.10s",
+		"smtp.checks.dkim.slow" };
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(chr_t *); i++) {
+		result += stats_get_value_by_name(names[i]);
+	}
+
+	return result;
+}
+
+bool_t check_smtp_inspect_sthread(stringer_t *errmsg) {
+
+	connection_t con;
+	uint64_t checks, parallel;
+	smtp_message_t message;
+	smtp_inbound_prefs_t first, second;
+
+	mm_wipe(&con, sizeof(connection_t));
+	mm_wipe(&message, sizeof(smtp_message_t));
+	mm_wipe(&first, sizeof(smtp_inbound_prefs_t));
+	mm_wipe(&second, sizeof(smtp_inbound_prefs_t));
+
+	message.id = NULLER("check");
+	message.text = NULLER("To: \"Princess\" <princess@example.com>\r\nFrom: \"Magma\" <magma@lavabit.com>\r\nSubject: Checker Pool Test\r\n\r\n" \
+		"The virus and DKIM checks for this message should run at the same time.\r\n");
+
+	// Each recipient wants a different check, but they should be run once for the message.
+	first.virus = 1;
+	second.dkim = 1;
+	first.next = (struct smtp_inbound_prefs_t *)&second;
+
+	con.smtp.message = &message;
+	con.smtp.in_prefs = &first;
+
+	checks = check_smtp_inspect_count();
+	parallel = stats_get_value_by_name("smtp.checks.parallel");
+
+	smtp_inspect_message(&con);
+
+	if (!con.smtp.checked.virus || !con.smtp.checked.dkim) {
+		st_sprint(errmsg, "The content check results weren't stored. { virus = %i / dkim = %i }", con.smtp.checked.virus, con.smtp.checked.dkim);
+		return false;
+	}
+	else if (check_smtp_inspect_count() != checks + 2) {
+		st_sprint(errmsg, "The content check latencies weren't recorded. { expected = %lu / recorded = %lu }", 2UL, check_smtp_inspect_count() - checks);
+		return false;
+	}
+	else if (magma.smtp.checker_threads && stats_get_value_by_name("smtp.checks.parallel") != parallel + 1) {
+		st_sprint(errmsg, "The content checks weren't run concurrently.");
+		return false;
+	}
+
+	// Once there are results, the checks shouldn't be run again.
+	con.smtp.checked.virus = 1;
+	checks = check_smtp_inspect_count();
+
+	smtp_inspect_message(&con);
+
+	if (check_smtp_inspect_count() != checks) {
+		st_sprint(errmsg, "The content checks were repeated, even though the results were already known.");
+		return false;
+	}
+
+	// A recipient whose message has already been marked doesn't get a signature check, the same as the accept path.
+	con.smtp.checked.dkim = 0;
+	second.mark = SMTP_MARK_SPAM;
+
+	smtp_inspect_message(&con);
+
+	if (check_smtp_inspect_count() != checks || con.smtp.checked.dkim) {
+		st_sprint(errmsg, "The signature check was run for a recipient whose message was already marked.");
+		return false;
+	}
+
+	return true;
+}
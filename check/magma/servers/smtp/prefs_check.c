@@ -0,0 +1,109 @@
+/**
+ * @file /check/magma/servers/smtp/prefs_check.c
+ *
+ * @brief SMTP recipient preferences cache test functions.
+ */
+
+#include "magma_check.h"
+
+bool_t check_smtp_prefs_sthread(stringer_t *errmsg) {
+
+	uint64_t queries;
+	int_t state, cached;
+	smtp_inbound_prefs_t *first = NULL, *second = NULL;
+	stringer_t *address = NULLER("ladar@lavabit.com"), *missing = MANAGEDBUF(128);
+
+	if (!magma.smtp.prefs.limit || !magma.smtp.prefs.timeout) {
+		return true;
+	}
+
+	// Start with an empty cache, so the first lookup has to query the database.
+	smtp_prefs_truncate();
+
+	queries = stats_get_value_by_name("smtp.prefs.queries");
+
+	if ((state = smtp_prefs_fetch(address, &first)) != 1 || !first) {
+		st_sprint(errmsg, "The recipient preferences lookup failed. { state = %i }", state);
+		smtp_free_inbound(first);
+		return false;
+	}
+	else if (stats_get_value_by_name("smtp.prefs.queries") == queries) {
+		st_sprint(errmsg, "The first recipient preferences lookup didn't query the database.");
+		smtp_free_inbound(first);
+		return false;
+	}
+
+	// The second lookup should be answered by the cache, and return a separate copy of the preferences.
+	queries = stats_get_value_by_name("smtp.prefs.queries");
+
+	if ((state = smtp_prefs_fetch(address, &second)) != 1 || !second) {
+		st_sprint(errmsg, "The cached recipient preferences lookup failed. { state = %i }", state);
+		smtp_free_inbound(first);
+		smtp_free_inbound(second);
+		return false;
+	}
+	else if (stats_get_value_by_name("smtp.prefs.queries") != queries) {
+		st_sprint(errmsg, "The second recipient preferences lookup queried the database.");
+		smtp_free_inbound(first);
+		smtp_free_inbound(second);
+		return false;
+	}
+	else if (first == second || first->rcptto == second->rcptto || first->usernum != second->usernum || first->quota != second->quota ||
+		st_cmp_cs_eq(first->rcptto, second->rcptto) || (first->signet == NULL) != (second->signet == NULL) ||
+		inx_count(first->filters) != inx_count(second->filters)) {
+		st_sprint(errmsg, "The cached recipient preferences don't match the original lookup.");
+		smtp_free_inbound(first);
+		smtp_free_inbound(second);
+		return false;
+	}
+
+	smtp_free_inbound(second);
+	second = NULL;
+
+	// Changing the user serial number should force the preferences to be fetched from the database again.
+	serial_increment(OBJECT_USER, first->usernum);
+	serial_local_truncate();
+	queries = stats_get_value_by_name("smtp.prefs.queries");
+
+	if ((state = smtp_prefs_fetch(address, &second)) != 1 || !second) {
+		st_sprint(errmsg, "The recipient preferences lookup failed after the user serial changed. { state = %i }", state);
+		smtp_free_inbound(first);
+		smtp_free_inbound(second);
+		return false;
+	}
+	else if (stats_get_value_by_name("smtp.prefs.queries") == queries) {
+		st_sprint(errmsg, "The cached recipient preferences were used after the user serial changed.");
+		smtp_free_inbound(first);
+		smtp_free_inbound(second);
+		return false;
+	}
+
+	smtp_free_inbound(first);
+	smtp_free_inbound(second);
+	first = second = NULL;
+
+	// Addresses which don't match a mailbox should be cached too.
+	if (st_sprint(missing, "missing.%lu@lavabit.com", rand_get_uint64()) <= 0) {
+		st_sprint(errmsg, "Unable to generate a random recipient address.");
+		return false;
+	}
+
+	state = smtp_prefs_fetch(missing, &first);
+	smtp_free_inbound(first);
+	first = NULL;
+
+	queries = stats_get_value_by_name("smtp.prefs.queries");
+	cached = smtp_prefs_fetch(missing, &first);
+	smtp_free_inbound(first);
+
+	if (state == -1 || cached != state) {
+		st_sprint(errmsg, "The cached lookup for a missing recipient returned a different result. { state = %i / cached = %i }", state, cached);
+		return false;
+	}
+	else if (stats_get_value_by_name("smtp.prefs.queries") != queries) {
+		st_sprint(errmsg, "The second lookup for a missing recipient queried the database.");
+		return false;
+	}
+
+	return true;
+}
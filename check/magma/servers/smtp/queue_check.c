@@ -0,0 +1,70 @@
+/**
+ * @file /check/magma/servers/smtp/queue_check.c
+ *
+ * @brief SMTP outbound queue test functions.
+ */
+
+#include "magma_check.h"
+
+bool_t check_smtp_queue_sthread(stringer_t *errmsg) {
+
+	int fd;
+	smtp_recipients_t recipient;
+	stringer_t *path = NULL, *queue = NULL;
+	uint64_t delivered = stats_get_value_by_name("smtp.queue.delivered");
+	stringer_t *mailfrom = NULLER("magma@lavabit.com"), *rcptto = NULLER("princess@example.com"),
+		*message = NULLER("To: \"Princess\" <princess@example.com>\r\n" \
+		"From: \"Magma\" <magma@lavabit.com>\r\n" \
+		"Subject: Outbound Queue Test\r\n\r\n" \
+		"This message is stored in the outbound queue, and delivered in the background.\r\n" \
+		".\r\n" \
+		"The line above should be dot stuffed when the message is delivered.\r\n");
+
+	// Files inside the queue spool must survive the cleanup which removes the stale files from the rest of the spool.
+	if (!(queue = spool_path(MAGMA_SPOOL_QUEUE)) || !(path = st_aprint("%.*scheck_%lu", st_length_int(queue), st_char_get(queue), rand_get_uint64())) ||
+		(fd = open(st_char_get(path), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR)) == -1) {
+		st_sprint(errmsg, "Unable to create a file inside the outbound queue spool.");
+		st_cleanup(queue);
+		st_cleanup(path);
+		return false;
+	}
+
+	close(fd);
+
+	if (spool_cleanup() < 0 || !file_accessible(st_char_get(path))) {
+		st_sprint(errmsg, "The spool cleanup removed a file from the outbound queue spool.");
+		unlink(st_char_get(path));
+		st_free(queue);
+		st_free(path);
+		return false;
+	}
+
+	unlink(st_char_get(path));
+	st_free(queue);
+	st_free(path);
+
+	if (!magma.relay.queue.enable) {
+		return true;
+	}
+
+	recipient.address = rcptto;
+	recipient.response = NULL;
+	recipient.next = NULL;
+
+	if (smtp_queue_message(0, mailfrom, &recipient, message, NULL) != 1) {
+		st_sprint(errmsg, "Failed to queue the message.");
+		return false;
+	}
+
+	// The message is delivered by a worker thread, so wait for the delivery to be counted.
+	for (int_t i = 0; status() && i < 3000 && stats_get_value_by_name("smtp.queue.delivered") == delivered; i++) {
+		usleep(10000);
+	}
+
+	if (stats_get_value_by_name("smtp.queue.delivered") == delivered) {
+		st_sprint(errmsg, "The queued message wasn't delivered. { depth = %lu / age = %lu }", smtp_queue_depth(), smtp_queue_age());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file /check/magma/servers/smtp/relay_check.c
+ *
+ * @brief SMTP relay client test functions.
+ */
+
+#include "magma_check.h"
+
+bool_t check_smtp_relay_pool_sthread(stringer_t *errmsg) {
+
+	client_t *client = NULL;
+	uint64_t reused = stats_get_value_by_name("smtp.relay.reused");
+	stringer_t *mailfrom = NULLER("magma@lavabit.com"), *rcptto = NULLER("princess@example.com"),
+		*message = NULLER("To: \"Princess\" <princess@example.com>\r\n" \
+		"From: \"Magma\" <magma@lavabit.com>\r\n" \
+		"Subject: Relay Pool Test\r\n\r\n" \
+		"This message is relayed twice, and the second copy should reuse the connection opened for the first.\r\n");
+
+	if (!magma.relay.pool.connections || magma.relay.pool.messages < 2) {
+		return true;
+	}
+
+	for (int_t i = 0; i < 2; i++) {
+
+		if (!(client = smtp_client_connect(0))) {
+			st_sprint(errmsg, "Failed to connect with the mail relay. { message = %i }", i + 1);
+			return false;
+		}
+		// The second message should always be handed the connection released by the first, which has already been greeted.
+		else if (i && !(client->smtp.state & SMTP_CLIENT_GREETED)) {
+			st_sprint(errmsg, "The relay connection wasn't reused. { message = %i }", i + 1);
+			smtp_client_close(client);
+			return false;
+		}
+		else if (smtp_client_send_helo(client) != 1) {
+			st_sprint(errmsg, "Failed to return successful state after HELO. { message = %i }", i + 1);
+			smtp_client_close(client);
+			return false;
+		}
+		else if (smtp_client_send_mailfrom(client, mailfrom, 0) != 1) {
+			st_sprint(errmsg, "Failed to return successful state after MAIL FROM. { message = %i }", i + 1);
+			smtp_client_close(client);
+			return false;
+		}
+		else if (smtp_client_send_rcptto(client, rcptto) != 1) {
+			st_sprint(errmsg, "Failed to return successful state after RCPT TO. { message = %i }", i + 1);
+			smtp_client_close(client);
+			return false;
+		}
+		else if (smtp_client_send_data(client, message, false) != 1) {
+			st_sprint(errmsg, "Failed to return successful state after DATA. { message = %i }", i + 1);
+			smtp_client_close(client);
+			return false;
+		}
+
+		smtp_client_close(client);
+	}
+
+	if (stats_get_value_by_name("smtp.relay.reused") <= reused) {
+		st_sprint(errmsg, "The relay connection reuse wasn't counted.");
+		return false;
+	}
+
+	return true;
+}
@@ -60,6 +60,72 @@ START_TEST (check_smtp_accept_store_message_s) {
 }
 END_TEST
 
+START_TEST (check_smtp_relay_pool_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) outcome = check_smtp_relay_pool_sthread(errmsg);
+
+	log_test("SMTP / RELAY / POOL / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_smtp_queue_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) outcome = check_smtp_queue_sthread(errmsg);
+
+	log_test("SMTP / QUEUE / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_smtp_data_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024), *measured = MANAGEDBUF(256);
+
+	if (status()) outcome = check_smtp_data_sthread(errmsg, measured);
+
+	log_test("SMTP / DATA / SINGLE THREADED:", errmsg);
+	log_measure(measured);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_smtp_inspect_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) outcome = check_smtp_inspect_sthread(errmsg);
+
+	log_test("SMTP / INSPECT / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
+START_TEST (check_smtp_prefs_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) outcome = check_smtp_prefs_sthread(errmsg);
+
+	log_test("SMTP / PREFS / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
 START_TEST (check_smtp_checkers_greylist_s) {
 
 	log_disable();
@@ -103,6 +169,19 @@ START_TEST (check_smtp_checkers_rbl_s) {
 }
 END_TEST
 
+START_TEST (check_smtp_checkers_rbl_stub_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	stringer_t *errmsg = MANAGEDBUF(1024);
+
+	if (status()) outcome = check_smtp_checkers_rbl_stub_sthread(errmsg);
+
+	log_test("SMTP / CHECKERS / RBL STUB / SINGLE THREADED:", errmsg);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
 START_TEST (check_smtp_network_auth_plain_s) {
 
 	log_disable();
@@ -191,20 +270,48 @@ START_TEST (check_smtp_network_starttls_s) {
 }
 END_TEST
 
+START_TEST (check_smtp_network_chunking_s) {
+
+	log_disable();
+	bool_t outcome = true;
+	server_t *server = NULL;
+	stringer_t *errmsg = MANAGEDBUF(1024), *measured = MANAGEDBUF(256);
+
+	if (!(server = servers_get_by_protocol(SMTP, false))) {
+		st_sprint(errmsg, "No SMTP servers were configured to support TCP connections.");
+		outcome = false;
+	}
+	else if (status() && !check_smtp_network_chunking_sthread(errmsg, measured, server->network.port)) {
+		outcome = false;
+	}
+
+	log_test("SMTP / NETWORK / CHUNKING / SINGLE THREADED:", errmsg);
+	log_measure(measured);
+	ck_assert_msg(outcome, st_char_get(errmsg));
+}
+END_TEST
+
 Suite * suite_check_smtp(void) {
 
 	Suite *s = suite_create("\tSMTP");
 
 	suite_check_testcase(s, "SMTP", "SMTP Accept Message/S", check_smtp_accept_store_message_s);
+	suite_check_testcase(s, "SMTP", "SMTP Relay Pool/S", check_smtp_relay_pool_s);
+	suite_check_testcase(s, "SMTP", "SMTP Queue/S", check_smtp_queue_s);
+	suite_check_testcase(s, "SMTP", "SMTP Data/S", check_smtp_data_s);
+	suite_check_testcase(s, "SMTP", "SMTP Inspect/S", check_smtp_inspect_s);
+	suite_check_testcase(s, "SMTP", "SMTP Prefs/S", check_smtp_prefs_s);
 	suite_check_testcase(s, "SMTP", "SMTP Checkers Greylist/S", check_smtp_checkers_greylist_s);
 	suite_check_testcase(s, "SMTP", "SMTP Checkers Filters/S", check_smtp_checkers_filters_s);
 	suite_check_testcase(s, "SMTP", "SMTP Checkers RBL", check_smtp_checkers_rbl_s);
+	suite_check_testcase(s, "SMTP", "SMTP Checkers RBL Stub/S", check_smtp_checkers_rbl_stub_s);
 	suite_check_testcase(s, "SMTP", "SMTP Network Basic/ TCP/S", check_smtp_network_basic_tcp_s);
 	suite_check_testcase(s, "SMTP", "SMTP Network Basic/ TLS/S", check_smtp_network_basic_tls_s);
 	suite_check_testcase(s, "SMTP", "SMTP Network Auth Plain/S", check_smtp_network_auth_plain_s);
 	suite_check_testcase(s, "SMTP", "SMTP Network Auth Login/S", check_smtp_network_auth_login_s);
 	suite_check_testcase(s, "SMTP", "SMTP Network Outbound Quota/S", check_smtp_network_outbound_quota_s);
 	suite_check_testcase(s, "SMTP", "SMTP Network STARTTLS/S", check_smtp_network_starttls_s);
+	suite_check_testcase(s, "SMTP", "SMTP Network Chunking/S", check_smtp_network_chunking_s);
 
 	return s;
 }
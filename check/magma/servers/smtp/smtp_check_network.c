@@ -447,3 +447,136 @@ bool_t check_smtp_network_starttls_sthread(stringer_t *errmsg, uint32_t tcp_port
 	client_close(client);
 	return true;
 }
+
+/**
+ * @brief	Send the same multi-megabyte message using DATA, and then again using BDAT, and compare how long each transfer takes.
+ * @note	Every sixteenth line of the body begins with a period, so the DATA copy has to be dot stuffed. The timings are only logged,
+ * 			since they depend on the machine, but both transfers must be accepted.
+ * @param	errmsg	a managed string that will have the error message printed to it in the event of an error.
+ * @param	port	the TCP port of the SMTP server.
+ * @return	true if both transfers succeeded, otherwise false.
+ */
+bool_t check_smtp_network_chunking_sthread(stringer_t *errmsg, stringer_t *measured, uint32_t port) {
+
+	chr_t *raw, *stuffed;
+	client_t *client = NULL;
+	bool_t chunking = false;
+	size_t length = 0, chunk;
+	struct timeval start, end;
+	uint64_t data_time = 0, bdat_time = 0;
+	stringer_t *message = NULL, *dotstuffed = NULL;
+	chr_t *header = "To: princess@example.com\r\nFrom: magma@lavabit.com\r\nSubject: Chunking Benchmark\r\n\r\n";
+
+	// Build the raw message, and the dot stuffed copy sent using DATA, which needs room for the extra periods and the terminator.
+	if (!(message = st_alloc_opts(MAPPED_T | JOINTED | HEAP, SMTP_CHECK_CHUNKING_SIZE)) ||
+		!(dotstuffed = st_alloc_opts(MAPPED_T | JOINTED | HEAP, SMTP_CHECK_CHUNKING_SIZE + (SMTP_CHECK_CHUNKING_SIZE / 16) + 3))) {
+		st_sprint(errmsg, "Unable to allocate the message buffers.");
+		st_cleanup(message, dotstuffed);
+		return false;
+	}
+
+	raw = st_char_get(message);
+	stuffed = st_char_get(dotstuffed);
+
+	mm_copy(raw, header, ns_length_get(header));
+	mm_copy(stuffed, header, ns_length_get(header));
+	raw += ns_length_get(header);
+	stuffed += ns_length_get(header);
+	length = ns_length_get(header);
+
+	for (uint64_t line = 0; length + 80 <= SMTP_CHECK_CHUNKING_SIZE; line++) {
+
+		if (!(line % 16)) {
+			*stuffed++ = '.';
+		}
+
+		for (int_t i = 0; i < 78; i++) {
+			*raw++ = *stuffed++ = (!i && !(line % 16)) ? '.' : 'a' + ((line + i) % 26);
+		}
+
+		*raw++ = *stuffed++ = '\r';
+		*raw++ = *stuffed++ = '\n';
+		length += 80;
+	}
+
+	st_length_set(message, length);
+	mm_copy(stuffed, ".\r\n", 3);
+	st_length_set(dotstuffed, (stuffed + 3) - st_char_get(dotstuffed));
+
+	// Connect, and make sure the server advertises the CHUNKING extension.
+	if (!(client = client_connect("localhost", port)) || !net_set_timeout(client->sockd, 20, 20) || client_read_line(client) <= 0 ||
+		client_write(client, PLACER("EHLO localhost\r\n", 16)) != 16) {
+		st_sprint(errmsg, "Failed to connect with the SMTP server.");
+		st_cleanup(message, dotstuffed);
+		client_close(client);
+		return false;
+	}
+
+	while (client_read_line(client) > 0) {
+		if (!st_cmp_cs_starts(&(client->line), PLACER("250-CHUNKING", 12))) chunking = true;
+		if (pl_char_get(client->line)[3] == ' ') break;
+	}
+
+	if (!chunking) {
+		st_sprint(errmsg, "Failed to find CHUNKING advertised in the EHLO response.");
+		st_cleanup(message, dotstuffed);
+		client_close(client);
+		return false;
+	}
+
+	// Send the message using DATA.
+	gettimeofday(&start, NULL);
+
+	if (!check_smtp_client_mail_rcpt_data(client, "magma@lavabit.com", "princess@example.com", errmsg) ||
+		client_write(client, dotstuffed) != st_length_get(dotstuffed) || !check_smtp_client_read_end(client) ||
+		st_cmp_cs_starts(&(client->line), NULLER("250"))) {
+		if (st_empty(errmsg)) st_sprint(errmsg, "Failed to send the message using DATA.");
+		st_cleanup(message, dotstuffed);
+		client_close(client);
+		return false;
+	}
+
+	gettimeofday(&end, NULL);
+	data_time = ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+
+	// Send the same message using BDAT.
+	gettimeofday(&start, NULL);
+
+	if (client_print(client, "MAIL FROM: <magma@lavabit.com> BODY=8BITMIME SIZE=%zu\r\n", length) <= 0 || !check_smtp_client_read_end(client) ||
+		st_cmp_cs_starts(&(client->line), NULLER("250")) || client_write(client, PLACER("RCPT TO: <princess@example.com>\r\n", 33)) != 33 ||
+		!check_smtp_client_read_end(client) || st_cmp_cs_starts(&(client->line), NULLER("250"))) {
+		st_sprint(errmsg, "Failed to start the BDAT transaction.");
+		st_cleanup(message, dotstuffed);
+		client_close(client);
+		return false;
+	}
+
+	for (size_t offset = 0; offset < length; offset += chunk) {
+
+		chunk = (length - offset > SMTP_CHECK_CHUNKING_CHUNK) ? SMTP_CHECK_CHUNKING_CHUNK : length - offset;
+
+		if (client_print(client, "BDAT %zu%s\r\n", chunk, (offset + chunk == length ? " LAST" : "")) <= 0 ||
+			client_write(client, PLACER(st_char_get(message) + offset, chunk)) != chunk || !check_smtp_client_read_end(client) ||
+			st_cmp_cs_starts(&(client->line), NULLER("250"))) {
+			st_sprint(errmsg, "Failed to send the message using BDAT. { offset = %zu / chunk = %zu }", offset, chunk);
+			st_cleanup(message, dotstuffed);
+			client_close(client);
+			return false;
+		}
+	}
+
+	gettimeofday(&end, NULL);
+	bdat_time = ((end.tv_sec - start.tv_sec) * 1000000) + (end.tv_usec - start.tv_usec);
+
+	st_sprint(measured, "Sent a %zu byte message using DATA and BDAT. { data = %lu microseconds / bdat = %lu microseconds }", length, data_time, bdat_time);
+
+	st_cleanup(message, dotstuffed);
+
+	if (!check_smtp_client_quit(client, errmsg)) {
+		client_close(client);
+		return false;
+	}
+
+	client_close(client);
+	return true;
+}
@@ -20,6 +20,8 @@ memcached_return_t (*memcached_replace_d)(memcached_st *ptr, const char *key, si
 memcached_return_t (*memcached_cas_d)(memcached_st *ptr, const char *key, size_t key_length, const char *value, size_t value_length, time_t expiration, uint32_t flags, uint64_t cas) = NULL;
 memcached_return_t (*memcached_decrement_with_initial_d)(memcached_st *ptr, const char *key, size_t key_length, uint64_t offset, uint64_t initial, time_t expiration, uint64_t *value) = NULL;
 memcached_return_t (*memcached_increment_with_initial_d)(memcached_st *ptr, const char *key, size_t key_length, uint64_t offset, uint64_t initial, time_t expiration, uint64_t *value) = NULL;
+memcached_return_t (*memcached_mget_d)(memcached_st *ptr, const char * const *keys, const size_t *key_length, size_t number_of_keys) = NULL;
+char * (*memcached_fetch_d)(memcached_st *ptr, char *key, size_t *key_length, size_t *value_length, uint32_t *flags, memcached_return_t *error) = NULL;
 const char * (*BZ2_bzlibVersion_d)(void) = NULL;
 int (*BZ2_bzBuffToBuffDecompress_d)(char *dest, unsigned int *destLen, char *source, unsigned int sourceLen, int small, int verbosity) = NULL;
 int (*BZ2_bzBuffToBuffCompress_d)(char *dest, unsigned int *destLen, char *source, unsigned int sourceLen, int blockSize100k, int verbosity, int workFactor) = NULL;
@@ -38,6 +40,9 @@ int (*cl_engine_set_num_d)(struct cl_engine *engine, enum cl_engine_field field,
 int (*cl_engine_set_str_d)(struct cl_engine *engine, enum cl_engine_field field, const char *str) = NULL;
 int (*cl_load_d)(const char *path, struct cl_engine *engine, unsigned int *signo, unsigned int dboptions) = NULL;
 int (*cl_scandesc_d)(int desc, const char **virname, unsigned long int *scanned, const struct cl_engine *engine, unsigned int scanoptions) = NULL;
+void (*cl_fmap_close_d)(cl_fmap_t *map) = NULL;
+cl_fmap_t * (*cl_fmap_open_memory_d)(const void *start, size_t len) = NULL;
+int (*cl_scanmap_callback_d)(cl_fmap_t *map, const char **virname, unsigned long int *scanned, const struct cl_engine *engine, unsigned int scanoptions, void *context) = NULL;
 const char * (*dspam_version_d)(void) = NULL;
 int (*dspam_detach_d)(DSPAM_CTX *CTX) = NULL;
 void (*dspam_destroy_d)(DSPAM_CTX * CTX) = NULL;
@@ -46,6 +51,8 @@ int (*dspam_shutdown_driver_d)(DRIVER_CTX *DTX) = NULL;
 int (*dspam_attach_d)(DSPAM_CTX *CTX, void *dbh) = NULL;
 int (*dspam_process_d)(DSPAM_CTX * CTX, const char *message) = NULL;
 DSPAM_CTX * (*dspam_create_d)(const char *username, const char *group, const char *home, int operating_mode, u_int32_t flags) = NULL;
+void (*_ds_destroy_message_d)(ds_message_t message) = NULL;
+void (*_ds_factor_destroy_d)(struct nt *factors) = NULL;
 DKIM_STAT (*dkim_eoh_d)(DKIM *dkim) = NULL;
 void (*dkim_close_d)(DKIM_LIB *lib) = NULL;
 uint32_t (*dkim_libversion_d)(void) = NULL;
@@ -550,6 +557,12 @@ const char * (*zlibVersion_d)(void) = NULL;
 uLong (*compressBound_d)(uLong sourceLen) = NULL;
 int (*uncompress_d)(Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen) = NULL;
 int (*compress2_d)(Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen, int level) = NULL;
+int (*deflateEnd_d)(z_streamp strm) = NULL;
+int (*deflate_d)(z_streamp strm, int flush) = NULL;
+int (*deflateInit2__d)(z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy, const char *version, int stream_size) = NULL;
+int (*inflateEnd_d)(z_streamp strm) = NULL;
+int (*inflate_d)(z_streamp strm, int flush) = NULL;
+int (*inflateInit2__d)(z_streamp strm, int windowBits, const char *version, int stream_size) = NULL;
 const char * symbols_check(void *magma) {
 if ((*(void **)&(memcached_flush_d) = dlsym(magma, "memcached_flush")) == NULL) return "memcached_flush";
 if ((*(void **)&(memcached_free_d) = dlsym(magma, "memcached_free")) == NULL) return "memcached_free";
@@ -570,6 +583,8 @@ if ((*(void **)&(memcached_replace_d) = dlsym(magma, "memcached_replace")) == NU
 if ((*(void **)&(memcached_cas_d) = dlsym(magma, "memcached_cas")) == NULL) return "memcached_cas";
 if ((*(void **)&(memcached_decrement_with_initial_d) = dlsym(magma, "memcached_decrement_with_initial")) == NULL) return "memcached_decrement_with_initial";
 if ((*(void **)&(memcached_increment_with_initial_d) = dlsym(magma, "memcached_increment_with_initial")) == NULL) return "memcached_increment_with_initial";
+if ((*(void **)&(memcached_mget_d) = dlsym(magma, "memcached_mget")) == NULL) return "memcached_mget";
+if ((*(void **)&(memcached_fetch_d) = dlsym(magma, "memcached_fetch")) == NULL) return "memcached_fetch";
 if ((*(void **)&(BZ2_bzlibVersion_d) = dlsym(magma, "BZ2_bzlibVersion")) == NULL) return "BZ2_bzlibVersion";
 if ((*(void **)&(BZ2_bzBuffToBuffDecompress_d) = dlsym(magma, "BZ2_bzBuffToBuffDecompress")) == NULL) return "BZ2_bzBuffToBuffDecompress";
 if ((*(void **)&(BZ2_bzBuffToBuffCompress_d) = dlsym(magma, "BZ2_bzBuffToBuffCompress")) == NULL) return "BZ2_bzBuffToBuffCompress";
@@ -588,6 +603,9 @@ if ((*(void **)&(cl_engine_set_num_d) = dlsym(magma, "cl_engine_set_num")) == NU
 if ((*(void **)&(cl_engine_set_str_d) = dlsym(magma, "cl_engine_set_str")) == NULL) return "cl_engine_set_str";
 if ((*(void **)&(cl_load_d) = dlsym(magma, "cl_load")) == NULL) return "cl_load";
 if ((*(void **)&(cl_scandesc_d) = dlsym(magma, "cl_scandesc")) == NULL) return "cl_scandesc";
+if ((*(void **)&(cl_fmap_close_d) = dlsym(magma, "cl_fmap_close")) == NULL) return "cl_fmap_close";
+if ((*(void **)&(cl_fmap_open_memory_d) = dlsym(magma, "cl_fmap_open_memory")) == NULL) return "cl_fmap_open_memory";
+if ((*(void **)&(cl_scanmap_callback_d) = dlsym(magma, "cl_scanmap_callback")) == NULL) return "cl_scanmap_callback";
 if ((*(void **)&(dspam_version_d) = dlsym(magma, "dspam_version")) == NULL) return "dspam_version";
 if ((*(void **)&(dspam_detach_d) = dlsym(magma, "dspam_detach")) == NULL) return "dspam_detach";
 if ((*(void **)&(dspam_destroy_d) = dlsym(magma, "dspam_destroy")) == NULL) return "dspam_destroy";
@@ -596,6 +614,8 @@ if ((*(void **)&(dspam_shutdown_driver_d) = dlsym(magma, "dspam_shutdown_driver"
 if ((*(void **)&(dspam_attach_d) = dlsym(magma, "dspam_attach")) == NULL) return "dspam_attach";
 if ((*(void **)&(dspam_process_d) = dlsym(magma, "dspam_process")) == NULL) return "dspam_process";
 if ((*(void **)&(dspam_create_d) = dlsym(magma, "dspam_create")) == NULL) return "dspam_create";
+if ((*(void **)&(_ds_destroy_message_d) = dlsym(magma, "_ds_destroy_message")) == NULL) return "_ds_destroy_message";
+if ((*(void **)&(_ds_factor_destroy_d) = dlsym(magma, "_ds_factor_destroy")) == NULL) return "_ds_factor_destroy";
 if ((*(void **)&(dkim_eoh_d) = dlsym(magma, "dkim_eoh")) == NULL) return "dkim_eoh";
 if ((*(void **)&(dkim_close_d) = dlsym(magma, "dkim_close")) == NULL) return "dkim_close";
 if ((*(void **)&(dkim_libversion_d) = dlsym(magma, "dkim_libversion")) == NULL) return "dkim_libversion";
@@ -1097,5 +1117,11 @@ if ((*(void **)&(zlibVersion_d) = dlsym(magma, "zlibVersion")) == NULL) return "
 if ((*(void **)&(compressBound_d) = dlsym(magma, "compressBound")) == NULL) return "compressBound";
 if ((*(void **)&(uncompress_d) = dlsym(magma, "uncompress")) == NULL) return "uncompress";
 if ((*(void **)&(compress2_d) = dlsym(magma, "compress2")) == NULL) return "compress2";
+if ((*(void **)&(deflateEnd_d) = dlsym(magma, "deflateEnd")) == NULL) return "deflateEnd";
+if ((*(void **)&(deflate_d) = dlsym(magma, "deflate")) == NULL) return "deflate";
+if ((*(void **)&(deflateInit2__d) = dlsym(magma, "deflateInit2_")) == NULL) return "deflateInit2_";
+if ((*(void **)&(inflateEnd_d) = dlsym(magma, "inflateEnd")) == NULL) return "inflateEnd";
+if ((*(void **)&(inflate_d) = dlsym(magma, "inflate")) == NULL) return "inflate";
+if ((*(void **)&(inflateInit2__d) = dlsym(magma, "inflateInit2_")) == NULL) return "inflateInit2_";
 return NULL;
 }
@@ -125,6 +125,8 @@ extern memcached_return_t (*memcached_replace_d)(memcached_st *ptr, const char *
 extern memcached_return_t (*memcached_cas_d)(memcached_st *ptr, const char *key, size_t key_length, const char *value, size_t value_length, time_t expiration, uint32_t flags, uint64_t cas);
 extern memcached_return_t (*memcached_decrement_with_initial_d)(memcached_st *ptr, const char *key, size_t key_length, uint64_t offset, uint64_t initial, time_t expiration, uint64_t *value);
 extern memcached_return_t (*memcached_increment_with_initial_d)(memcached_st *ptr, const char *key, size_t key_length, uint64_t offset, uint64_t initial, time_t expiration, uint64_t *value);
+extern memcached_return_t (*memcached_mget_d)(memcached_st *ptr, const char * const *keys, const size_t *key_length, size_t number_of_keys);
+extern char * (*memcached_fetch_d)(memcached_st *ptr, char *key, size_t *key_length, size_t *value_length, uint32_t *flags, memcached_return_t *error);
 
 //! BZIP
 extern const char * (*BZ2_bzlibVersion_d)(void);
@@ -147,6 +149,9 @@ extern int (*cl_engine_set_num_d)(struct cl_engine *engine, enum cl_engine_field
 extern int (*cl_engine_set_str_d)(struct cl_engine *engine, enum cl_engine_field field, const char *str);
 extern int (*cl_load_d)(const char *path, struct cl_engine *engine, unsigned int *signo, unsigned int dboptions);
 extern int (*cl_scandesc_d)(int desc, const char **virname, unsigned long int *scanned, const struct cl_engine *engine, unsigned int scanoptions);
+extern void (*cl_fmap_close_d)(cl_fmap_t *map);
+extern cl_fmap_t * (*cl_fmap_open_memory_d)(const void *start, size_t len);
+extern int (*cl_scanmap_callback_d)(cl_fmap_t *map, const char **virname, unsigned long int *scanned, const struct cl_engine *engine, unsigned int scanoptions, void *context);
 
 //! DSPAM
 extern const char * (*dspam_version_d)(void);
@@ -157,6 +162,8 @@ extern int (*dspam_shutdown_driver_d)(DRIVER_CTX *DTX);
 extern int (*dspam_attach_d)(DSPAM_CTX *CTX, void *dbh);
 extern int (*dspam_process_d)(DSPAM_CTX * CTX, const char *message);
 extern DSPAM_CTX * (*dspam_create_d)(const char *username, const char *group, const char *home, int operating_mode, u_int32_t flags);
+extern void (*_ds_destroy_message_d)(ds_message_t message);
+extern void (*_ds_factor_destroy_d)(struct nt *factors);
 
 //! DKIM
 /// Note that dkim_getsighdr_d is used by the library, so were using dkim_getsighdrx_d.
@@ -692,6 +699,12 @@ extern const char * (*zlibVersion_d)(void);
 extern uLong (*compressBound_d)(uLong sourceLen);
 extern int (*uncompress_d)(Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen);
 extern int (*compress2_d)(Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen, int level);
+extern int (*deflateEnd_d)(z_streamp strm);
+extern int (*deflate_d)(z_streamp strm, int flush);
+extern int (*deflateInit2__d)(z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy, const char *version, int stream_size);
+extern int (*inflateEnd_d)(z_streamp strm);
+extern int (*inflate_d)(z_streamp strm, int flush);
+extern int (*inflateInit2__d)(z_streamp strm, int windowBits, const char *version, int stream_size);
 
 #endif
 
@@ -79,7 +79,7 @@ INSERT INTO `Domains` VALUES (1,'dark.lavabit.com',0,0,0,0,0,'2010-05-18 02:08:5
 -- ORDER BY:  `foldernum`
 
 /*!40000 ALTER TABLE `Folders` DISABLE KEYS */;
-INSERT INTO `Folders` VALUES (1,1,'Inbox',0,NULL),(2,2,'Inbox',0,NULL),(3,3,'Inbox',0,NULL),(4,4,'Inbox',0,NULL);
+INSERT INTO `Folders` VALUES (1,1,'Inbox',0,NULL,1),(2,2,'Inbox',0,NULL,1),(3,3,'Inbox',0,NULL,1),(4,4,'Inbox',0,NULL,1);
 /*!40000 ALTER TABLE `Folders` ENABLE KEYS */;
 
 --
@@ -70,3 +70,61 @@ CREATE TABLE `Realms` (
   CONSTRAINT `User_Realms_ibfk_1` FOREIGN KEY (`usernum`) REFERENCES `Users` (`usernum`) ON UPDATE CASCADE
 ) ENGINE=InnoDB AUTO_INCREMENT=1 DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=100 COMMENT='User shard values for the different realms.';
 
+
+/* Store the envelope summaries used to list messages without loading the message files. */
+CREATE TABLE `Message_Envelopes` (
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `sender` blob,
+  `recipient` blob,
+  `reply_to` blob,
+  `return_path` blob,
+  `subject` blob,
+  `sent` blob,
+  `snippet` blob,
+  PRIMARY KEY (`messagenum`),
+  CONSTRAINT `Message_Envelopes_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=400 COMMENT='The header fields and preview text used to list a message without loading it.';
+
+/* Track a modification sequence for every message, and the highest value handed out for each folder, so IMAP clients can resynchronize using CONDSTORE and QRESYNC. */
+ALTER TABLE `Folders` ADD COLUMN `modseq` bigint(20) unsigned NOT NULL DEFAULT '1' AFTER `parent`;
+ALTER TABLE `Messages` ADD COLUMN `modseq` bigint(20) unsigned NOT NULL DEFAULT '1' AFTER `created`;
+
+
+/* Store the full text index used to answer searches without loading the message files. */
+CREATE TABLE `Message_Terms` (
+  `usernum` bigint(20) unsigned NOT NULL,
+  `term` varbinary(32) NOT NULL,
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `fields` tinyint(3) unsigned NOT NULL DEFAULT '0',
+  PRIMARY KEY (`usernum`,`term`,`messagenum`),
+  KEY `messagenum` (`messagenum`),
+  CONSTRAINT `Message_Terms_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=60 COMMENT='The full text index, which maps every suffix of each word to the messages it appears in.';
+
+CREATE TABLE `Message_Indexes` (
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `usernum` bigint(20) unsigned NOT NULL,
+  `terms` int(10) unsigned NOT NULL DEFAULT '0',
+  `truncated` tinyint(1) unsigned NOT NULL DEFAULT '0',
+  PRIMARY KEY (`messagenum`),
+  KEY `usernum` (`usernum`),
+  CONSTRAINT `Message_Indexes_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=30 COMMENT='The messages whose words have been added to the full text index.';
+
+
+/* Store the parsed MIME structure of each message, so BODYSTRUCTURE and part fetches don't need to parse the message again. */
+CREATE TABLE `Message_Structures` (
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `length` bigint(20) unsigned NOT NULL DEFAULT '0',
+  `bodystructure` mediumblob NOT NULL,
+  `parts` mediumblob NOT NULL,
+  PRIMARY KEY (`messagenum`),
+  CONSTRAINT `Message_Structures_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=600 COMMENT='The serialized BODYSTRUCTURE and MIME part offsets for each message.';
+
+/* Store the carbon copy list and the identifiers used for threading alongside the other envelope fields, so SORT and THREAD don't need to load the message headers. */
+ALTER TABLE `Message_Envelopes` ADD COLUMN `cc` blob AFTER `snippet`, ADD COLUMN `message_id` blob AFTER `cc`, ADD COLUMN `refs` blob AFTER `message_id`,
+  ADD COLUMN `threading` tinyint(3) unsigned DEFAULT NULL AFTER `refs`;
+
+/* The envelopes stored before these columns existed are left with a NULL threading value. The remaining fields are still valid, and the new
+   ones are filled in from the message files, a limited batch at a time, by the SORT and THREAD commands which need them. */
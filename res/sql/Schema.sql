@@ -187,6 +187,7 @@ CREATE TABLE `Folders` (
   `foldername` varchar(128) NOT NULL DEFAULT '',
   `order` int(10) unsigned NOT NULL DEFAULT '0',
   `parent` bigint(20) unsigned DEFAULT NULL,
+  `modseq` bigint(20) unsigned NOT NULL DEFAULT '1',
   PRIMARY KEY (`foldernum`),
   UNIQUE KEY `UNIQ_FOLDERNAME` (`usernum`,`foldername`,`parent`),
   KEY `IX_USERNUM` (`usernum`),
@@ -335,6 +336,7 @@ CREATE TABLE `Messages` (
   `sigkey` bigint(20) unsigned DEFAULT '0',
   `visible` tinyint(1) NOT NULL DEFAULT '1',
   `created` datetime NOT NULL DEFAULT '0000-00-00 00:00:00',
+  `modseq` bigint(20) unsigned NOT NULL DEFAULT '1',
   PRIMARY KEY (`messagenum`),
   KEY `IX_USERNUM` (`usernum`),
   KEY `IX_SIGNUM` (`signum`),
@@ -344,6 +346,56 @@ CREATE TABLE `Messages` (
   CONSTRAINT `Messages_ibfk_3` FOREIGN KEY (`signum`) REFERENCES `Signatures` (`signum`) ON DELETE SET NULL ON UPDATE CASCADE
 ) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=300 COMMENT='A list of all e-mails we have stored on the system.';
 
+DROP TABLE IF EXISTS `Message_Envelopes`;
+CREATE TABLE `Message_Envelopes` (
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `sender` blob,
+  `recipient` blob,
+  `reply_to` blob,
+  `return_path` blob,
+  `subject` blob,
+  `sent` blob,
+  `snippet` blob,
+  `cc` blob,
+  `message_id` blob,
+  `refs` blob,
+  `threading` tinyint(3) unsigned DEFAULT NULL,
+  PRIMARY KEY (`messagenum`),
+  CONSTRAINT `Message_Envelopes_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=400 COMMENT='The header fields and preview text used to list a message without loading it.';
+
+DROP TABLE IF EXISTS `Message_Terms`;
+CREATE TABLE `Message_Terms` (
+  `usernum` bigint(20) unsigned NOT NULL,
+  `term` varbinary(32) NOT NULL,
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `fields` tinyint(3) unsigned NOT NULL DEFAULT '0',
+  PRIMARY KEY (`usernum`,`term`,`messagenum`),
+  KEY `messagenum` (`messagenum`),
+  CONSTRAINT `Message_Terms_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=60 COMMENT='The full text index, which maps every suffix of each word to the messages it appears in.';
+
+DROP TABLE IF EXISTS `Message_Indexes`;
+CREATE TABLE `Message_Indexes` (
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `usernum` bigint(20) unsigned NOT NULL,
+  `terms` int(10) unsigned NOT NULL DEFAULT '0',
+  `truncated` tinyint(1) unsigned NOT NULL DEFAULT '0',
+  PRIMARY KEY (`messagenum`),
+  KEY `usernum` (`usernum`),
+  CONSTRAINT `Message_Indexes_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=30 COMMENT='The messages whose words have been added to the full text index.';
+
+DROP TABLE IF EXISTS `Message_Structures`;
+CREATE TABLE `Message_Structures` (
+  `messagenum` bigint(20) unsigned NOT NULL,
+  `length` bigint(20) unsigned NOT NULL DEFAULT '0',
+  `bodystructure` mediumblob NOT NULL,
+  `parts` mediumblob NOT NULL,
+  PRIMARY KEY (`messagenum`),
+  CONSTRAINT `Message_Structures_ibfk_1` FOREIGN KEY (`messagenum`) REFERENCES `Messages` (`messagenum`) ON DELETE CASCADE ON UPDATE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=latin1 MAX_ROWS=4294967295 AVG_ROW_LENGTH=600 COMMENT='The serialized BODYSTRUCTURE and MIME part offsets for each message.';
+
 DROP TABLE IF EXISTS `Message_Tags`;
 CREATE TABLE `Message_Tags` (
   `messagetagnum` bigint(20) unsigned NOT NULL AUTO_INCREMENT,
@@ -360,6 +360,89 @@ int_t ar_append(array_t **array, uint32_t type, void *item) {
 	return 1;
 }
 
+/**
+ * @brief	Add an item to the end of an array which already has room for it.
+ * @note	Unlike ar_append(), the array is never reallocated, and the slots aren't scanned for a gap, so filling a presized array is linear.
+ * @param	array	a pointer to the array which will receive the new element.
+ * @param	type	the data type of the new element in the array.
+ * @param	item	the data of the new element to be added to the array.
+ * @return	0 on failure, or if the array is already full, or 1 on success.
+ */
+int_t ar_push(array_t *array, uint32_t type, void *item) {
+
+	size_t length;
+
+	if (!array || type == ARRAY_TYPE_EMPTY) {
+		log_pedantic("An invalid array or item was passed in.");
+		return 0;
+	}
+	else if ((length = ar_length_get(array)) >= ar_avail_get(array)) {
+		log_pedantic("The array is already full. { length = %zu }", length);
+		return 0;
+	}
+
+	*(uint32_t *)(array + sizeof(size_t) + sizeof(size_t) + (length * (sizeof(uint32_t) + sizeof(void *)))) = type;
+	*(void **)(array + sizeof(size_t) + sizeof(size_t) + (length * (sizeof(uint32_t) + sizeof(void *))) + sizeof(uint32_t)) = item;
+	ar_length_set(array, length + 1);
+
+	return 1;
+}
+
+/**
+ * @brief	Free the data held by a single array element.
+ * @param	type	the data type of the element.
+ * @param	pointer	the data held by the element.
+ * @return	This function returns no value.
+ */
+static void ar_free_element(uint32_t type, void *pointer) {
+
+	if (type == ARRAY_TYPE_ARRAY && pointer != NULL) {
+		ar_free(pointer);
+	}
+	else if ((type == ARRAY_TYPE_STRINGER || type == ARRAY_TYPE_PLACER) && pointer) {
+		st_free(pointer);
+	}
+	// We make the assumption that if its a pointer type, its been freed by the consumer.
+	else if (type != ARRAY_TYPE_EMPTY && type != ARRAY_TYPE_POINTER && pointer != NULL) {
+		mm_free(pointer);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Remove elements from the front of an array, moving the remaining elements down so they start at the first slot.
+ * @note	The removed elements are freed, using the same rules as ar_free(), and the slots left behind at the end of the array are emptied.
+ * @param	array	a pointer to the array to be shifted.
+ * @param	count	the number of elements to be removed.
+ * @return	0 on failure, or if the array holds fewer elements than were requested, or 1 on success.
+ */
+int_t ar_shift(array_t *array, size_t count) {
+
+	size_t avail, length, width = sizeof(uint32_t) + sizeof(void *);
+
+	if (!array || count > (length = ar_length_get(array))) {
+		log_pedantic("An invalid element count was passed in.");
+		return 0;
+	}
+	else if (!count) {
+		return 1;
+	}
+
+	avail = ar_avail_get(array);
+
+	for (size_t i = 0; i < count; i++) {
+		ar_free_element(*(uint32_t *)(array + sizeof(size_t) + sizeof(size_t) + (i * width)),
+			*(void **)(array + sizeof(size_t) + sizeof(size_t) + (i * width) + sizeof(uint32_t)));
+	}
+
+	mm_move(array + sizeof(size_t) + sizeof(size_t), array + sizeof(size_t) + sizeof(size_t) + (count * width), (avail - count) * width);
+	mm_wipe(array + sizeof(size_t) + sizeof(size_t) + ((avail - count) * width), count * width);
+	ar_length_set(array, length - count);
+
+	return 1;
+}
+
 /**
  * @brief	Free an array object and all of its underlying elements.
  * @note	Array elements that are managed strings, and aren't empty or of ARRAY_TYPE_POINTER will be freed.
@@ -367,9 +450,7 @@ int_t ar_append(array_t **array, uint32_t type, void *item) {
  */
 void ar_free(array_t *array) {
 
-	uint32_t type;
 	size_t size;
-	void *pointer;
 
 	if (!array) {
 		log_pedantic("A NULL pointer was passed in.");
@@ -380,18 +461,8 @@ void ar_free(array_t *array) {
 
 	// Go through and free each pointer.
 	while (size != 0) {
-		type = *(uint32_t *)(array + sizeof(size_t) + sizeof(size_t) + ((size - 1) * (sizeof(uint32_t) + sizeof(void *))));
-		pointer = *(void **)(array + sizeof(size_t) + sizeof(size_t) + ((size - 1) * (sizeof(uint32_t) + sizeof(void *))) + sizeof(uint32_t));
-		if (type == ARRAY_TYPE_ARRAY && pointer != NULL) {
-			ar_free(pointer);
-		}
-		else if ((type == ARRAY_TYPE_STRINGER || type == ARRAY_TYPE_PLACER) && pointer) {
-			st_free(pointer);
-		}
-		// We make the assumption that if its a pointer type, its been freed by the consumer.
-		else if (type != ARRAY_TYPE_EMPTY && type != ARRAY_TYPE_POINTER && pointer != NULL) {
-			mm_free(pointer);
-		}
+		ar_free_element(*(uint32_t *)(array + sizeof(size_t) + sizeof(size_t) + ((size - 1) * (sizeof(uint32_t) + sizeof(void *)))),
+			*(void **)(array + sizeof(size_t) + sizeof(size_t) + ((size - 1) * (sizeof(uint32_t) + sizeof(void *))) + sizeof(uint32_t)));
 		size--;
 	}
 
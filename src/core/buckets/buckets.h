@@ -98,6 +98,8 @@ uint32_t      ar_field_type(array_t *array, size_t element);
 void          ar_free(array_t *array);
 size_t        ar_length_get(array_t *array);
 void          ar_length_set(array_t *array, size_t used);
+int_t         ar_push(array_t *array, uint32_t type, void *item);
+int_t         ar_shift(array_t *array, size_t count);
 
 /// stacked.c
 int_t stacker_push(stacker_t *stack, void *data);
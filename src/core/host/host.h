@@ -87,7 +87,8 @@ typedef struct {
 enum {
 	MAGMA_SPOOL_BASE = 0,
 	MAGMA_SPOOL_DATA = 1,
-	MAGMA_SPOOL_SCAN = 2
+	MAGMA_SPOOL_SCAN = 2,
+	MAGMA_SPOOL_QUEUE = 3 // The outbound mail queue, which is durable, so it's skipped when the spool is cleaned.
 };
 
 /// color.c
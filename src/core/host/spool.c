@@ -10,7 +10,7 @@
 /**
  * @note	We have to track errors locally so these functions can be used during startup and shutdown when the global statistics system may not be available.
  */
-static stringer_t *spool_base = NULL;
+static stringer_t *spool_base = NULL, *spool_queue = NULL;
 static uint64_t spool_files_cleaned = 0, spool_errors = 0;
 static time_t spool_check_failure = 0, spool_creation_failure = 0;
 static pthread_rwlock_t spool_creation_lock = PTHREAD_RWLOCK_INITIALIZER;
@@ -33,7 +33,7 @@ uint64_t spool_error_stats(void) {
 
 /**
  * @brief	Get the full path to a requested spool directory.
- * @param	the spool id (MAGMA_SPOOL_BASE, MAGMA_SPOOL_DATA, or MAGMA_SPOOL_SCAN); defaults to MAGMA_SPOOL_DATA.
+ * @param	the spool id (MAGMA_SPOOL_BASE, MAGMA_SPOOL_DATA, MAGMA_SPOOL_SCAN, or MAGMA_SPOOL_QUEUE); defaults to MAGMA_SPOOL_DATA.
  * @return	NULL on failure, or a managed string pointing to the requested path inside the magma spool parent directory,
  * 			or /tmp/magma if the spool isn't configured.
  */
@@ -49,6 +49,9 @@ stringer_t * spool_path(int_t spool) {
 	else if (spool == MAGMA_SPOOL_SCAN) {
 		folder = "scan/";
 	}
+	else if (spool == MAGMA_SPOOL_QUEUE) {
+		folder = "queue/";
+	}
 	else {
 		folder = "data/";
 	}
@@ -174,6 +177,7 @@ int_t spool_mktemp(int_t spool, chr_t *prefix) {
 
 /**
  * @brief	An internal function used by the ftw() function to cleanup the file contents of a spool directory.
+ * @note	Files inside the outbound mail queue are left alone, since they must survive a restart.
  * @param	file	a pointer to a null-terminated string containing the pathname of the spool file.
  * @param	info	a pointer to a stat object containing the filesystem info of the specified file.
  * @param	the ftw type flag of the specified file (only FTW_F is handled).
@@ -188,7 +192,10 @@ int_t spool_check_file(const char *file, const struct stat *info, int type) {
 	}
 #endif
 
-	if (type == FTW_F) {
+	if (type == FTW_F && spool_queue && !st_cmp_cs_starts(NULLER((chr_t *)file), spool_queue)) {
+		return 0;
+	}
+	else if (type == FTW_F) {
 		if (unlink(file)) {
 			log_error("An error occurred while trying to unlink a temporary file inside the spool. {%s / %s}", strerror_r(errno, bufptr, buflen), file);
 			mutex_lock(&spool_error_lock);
@@ -262,6 +269,11 @@ void spool_stop(void) {
 		spool_base = false;
 	}
 
+	if (spool_queue) {
+		st_free(spool_queue);
+		spool_queue = NULL;
+	}
+
 #ifdef MAGMA_PEDANTIC
 	if (spool_files_cleaned - before > 0) log_pedantic("%lu files needed to be purged from the spool.", spool_files_cleaned - before);
 #endif
@@ -279,7 +291,7 @@ bool_t spool_start(void) {
 	bool_t result = true;
 
 	// Make sure the spool folder path is valid. If necessary, create any subfolders that are missing.
-	for (int_t i = 0; i < 3 && result == true; i++) {
+	for (int_t i = 0; i < 4 && result == true; i++) {
 
 		// Generate the appropriate path string.
 		// QUESTION: Why not just path = spool_path(i) ?
@@ -289,6 +301,8 @@ bool_t spool_start(void) {
 			path = spool_path(MAGMA_SPOOL_DATA);
 		else if (i == MAGMA_SPOOL_SCAN)
 			path = spool_path(MAGMA_SPOOL_SCAN);
+		else if (i == MAGMA_SPOOL_QUEUE)
+			path = spool_path(MAGMA_SPOOL_QUEUE);
 
 		if (path) {
 			if (spool_check(path)) {
@@ -306,8 +320,11 @@ bool_t spool_start(void) {
 	}
 
 	// We store the base location outside of the config structure since spool_stop needs to be called after the config is freed. And we
-	if (result && !(spool_base = spool_path(MAGMA_SPOOL_BASE))) {
+	// store the queue location so the cleanup logic can skip over the outbound messages waiting for delivery.
+	if (result && (!(spool_base = spool_path(MAGMA_SPOOL_BASE)) || !(spool_queue = spool_path(MAGMA_SPOOL_QUEUE)))) {
 		log_critical("Unable to remove stale files found inside the spool directory.");
+		st_cleanup(spool_base);
+		spool_base = NULL;
 		result = false;
 	}
 	// Note that if the cleanup function fails spool_base is freed and set to NULL which will prevent spool_stop from attempting to cleanup the spool during shutdown.
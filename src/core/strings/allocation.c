@@ -576,10 +576,15 @@ stringer_t * st_alloc_opts(uint32_t opts, size_t len) {
 			// Ensure the allocated size is always a multiple of the memory page size.
 			avail = align(magma.page_length, len);
 
-			//Then truncate the file to ensure it matches the memory map size.
+			// Then truncate the file to ensure it matches the memory map size. Strings allocated with the SHARED flag use a shared mapping, so
+			// the kernel can write the pages back to the spool file and reclaim them, rather than holding the entire string in anonymous memory.
 			if (avail && (handle = spool_mktemp(MAGMA_SPOOL_DATA, "mapped")) != -1 && ftruncate64(handle, avail) == 0 && (result = allocate(sizeof(mapped_t))) &&
-					(joint = mmap64(NULL, avail, PROT_WRITE | PROT_READ, opts & SECURE ? MAP_PRIVATE | MAP_LOCKED : MAP_PRIVATE, handle, 0)) != MAP_FAILED) {
-				mm_set(joint, 0, len);
+					(joint = mmap64(NULL, avail, PROT_WRITE | PROT_READ, opts & SECURE ? MAP_PRIVATE | MAP_LOCKED : (opts & SHARED ? MAP_SHARED : MAP_PRIVATE),
+					handle, 0)) != MAP_FAILED) {
+
+				// The file was just truncated, so a shared mapping is already zero filled, and touching every page would only dirty it.
+				if (!(opts & SHARED)) mm_set(joint, 0, len);
+
 				((mapped_t *)result)->opts = opts;
 				((mapped_t *)result)->avail = avail;
 				((mapped_t *)result)->data = joint;
@@ -8,7 +8,8 @@
 #include "magma.h"
 
 chr_t *st_option_flags[] = {
-	"FOREIGNDATA"
+	"FOREIGNDATA",
+	"SHARED"
 };
 
 chr_t *st_option_types[] = {
@@ -136,6 +137,9 @@ chr_t * st_info_opts(uint32_t opts, chr_t *s, size_t len) {
 		if (opts & FOREIGNDATA) {
 			flags = st_append(flags, NULLER(st_option_flags[0]));
 		}
+		if (opts & SHARED) {
+			flags = st_append(flags, st_empty(flags) ? NULLER(st_option_flags[1]) : NULLER(" | SHARED"));
+		}
 
 		snprintf(s, len, "(%s | %s | %s%s%.*s)", st_info_type(opts), st_info_layout(opts), st_info_allocator(opts), st_empty(flags) ? "" : " | ", st_length_int(flags), st_char_get(flags));
 		st_cleanup(flags);
@@ -31,6 +31,7 @@ enum {
 	SECURE = 1024,				// Must be on the heap
 
 	// Flags
+	SHARED = 2048,				// Mapped strings use a shared mapping, so the kernel can page the data out to the spool file
 	FOREIGNDATA = 4096			// Do not free data upon deallocation - this is somebody else's job!
 
 	// If you add any new flags, make sure you update the info.c arrays!
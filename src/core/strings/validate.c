@@ -162,6 +162,10 @@ bool_t st_valid_opts(uint32_t opts) {
 	else if (bitwise_count(opts & (STACK | HEAP | SECURE)) != 1) {
 		result = false;
 	}
+	// Only mapped strings can be shared, and secure strings must never reach the disk.
+	else if ((opts & SHARED) && (!(opts & MAPPED_T) || (opts & SECURE))) {
+		result = false;
+	}
 
 	switch (opts & (CONSTANT_T | NULLER_T | BLOCK_T | PLACER_T | MANAGED_T | MAPPED_T)) {
 
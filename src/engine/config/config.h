@@ -50,9 +50,23 @@
 // The default caching server connection timeout.
 #define MAGMA_CACHE_SOCKET_TIMEOUT 10
 
+// The default number of seconds a local copy of the object serial numbers may be used before being refreshed.
+#define MAGMA_CACHE_SERIAL_TIMEOUT 2
+
+// The default amount of memory the cached user objects and web sessions may hold before the least recently used are evicted.
+#define MAGMA_OBJECTS_META_LIMIT (256ULL << 20)
+#define MAGMA_OBJECTS_SESSIONS_LIMIT (64ULL << 20)
+
+// The default number of seconds an unused object may remain in the object cache.
+#define MAGMA_OBJECTS_IDLE_TIMEOUT 3600
+
 // The maximum number of server instances.
 #define MAGMA_BLACKLIST_INSTANCES 6
 
+// The default number of milliseconds to wait for the realtime blacklists, and the number of seconds a blacklist verdict is cached.
+#define MAGMA_BLACKLIST_TIMEOUT 2000
+#define MAGMA_BLACKLIST_CACHE 900
+
 // The maximum number of relay instances.
 #define MAGMA_RELAY_INSTANCES 8
 
@@ -79,9 +93,24 @@
 // white space and also including any space added as part of stuffing...
 #define MAGMA_SMTP_LINE_WRAP_LENGTH 80
 
+// The default amount of memory the cached recipient preferences may hold, and how many seconds a cached lookup may be used.
+#define MAGMA_SMTP_PREFS_LIMIT (16ULL << 20)
+#define MAGMA_SMTP_PREFS_TIMEOUT 60
+
+// The default number of attached spam filter contexts kept for reuse, and how many seconds an idle context is kept.
+#define MAGMA_SPAM_CONTEXTS 64
+#define MAGMA_SPAM_TIMEOUT 300
+
 // The maximum size of a message accepted via SMTP.
 #define MAGMA_SMTP_MAX_MESSAGE_SIZE 1073741824
 
+// The default zlib compression level used by IMAP connections which negotiate COMPRESS=DEFLATE.
+#define MAGMA_IMAP_COMPRESS_LEVEL 6
+
+// The largest literal accepted by the IMAP server, and the size above which literals are spooled to disk instead of held on the heap.
+#define MAGMA_IMAP_LITERAL_LIMIT 134217728
+#define MAGMA_IMAP_LITERAL_SPOOL 1048576
+
 // Macros because we have a lot of these checks
 #define CONFIG_CHECK_EXISTS(option,ptype) \
 	do { \
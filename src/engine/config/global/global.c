@@ -314,17 +314,23 @@ void config_output_help(void) {
  *			3. Make sure 10 <= magma.iface.cache.retry <= 86400
  *			4. Make sure 1 <= magma.iface.cache.timeout <= 3600
  *			5. Make sure magma.iface.cache.retry <= magma.iface.cache.timeout
- *			6. Make sure 40 <= magma.smtp.wrap_line_length <= 65535
- *			7. Make sure 8 <= magma.smtp.recipient_limit <= 32768
- *			8. Make sure 16 <= magma.smtp.relay_limit
- *			9. Make sure 16384 <= system_ulimit_max(RLIMIT_STACK)
- *			10. If magma.system.daemonize is set, make sure magma.output.file is not false
- *			11. If magma.output.file is enabled, magma.output.path must be set.
- *			12. If magma.dkim.enabled is set, then magma.dkim.domain, magma.dkim.selector, and magma.dkim.key must all be set.
- *			13. Validate all the configured magma servers, relay servers, and cache servers.
- *			14. Check all config key filenames and directories to ensure that they exist and are accessible.
- *			15. Make sure magma.admin.contact and point to valid email addresses, if they are specified.
- *			16. If magma.config.output_config is set, dump the current configuration.
+ *			6. Make sure magma.iface.cache.serial_timeout <= 60 and magma.iface.spam.contexts <= 4096 and magma.iface.spam.timeout <= 3600
+ *			7. Make sure 1MB <= magma.objects.meta_limit and 1MB <= magma.objects.sessions_limit
+ *			8. Make sure 60 <= magma.objects.idle_timeout <= 86400
+ *			9. Make sure 40 <= magma.smtp.wrap_line_length <= 65535
+ *			10. Make sure 8 <= magma.smtp.recipient_limit <= 32768
+ *			11. Make sure 16 <= magma.smtp.relay_limit, magma.smtp.checker_threads <= 64 and magma.smtp.prefs.timeout <= 3600
+ *				and 100 <= magma.smtp.blacklist_timeout <= 30000 and magma.smtp.blacklist_cache <= 86400
+ *			12. Make sure 1 <= magma.imap.compress_level <= 9
+ *			13. Make sure 1024 <= magma.imap.literal_spool <= magma.imap.literal_limit
+ *			14. Make sure 16384 <= system_ulimit_max(RLIMIT_STACK)
+ *			15. If magma.system.daemonize is set, make sure magma.output.file is not false
+ *			16. If magma.output.file is enabled, magma.output.path must be set.
+ *			17. If magma.dkim.enabled is set, then magma.dkim.domain, magma.dkim.selector, and magma.dkim.key must all be set.
+ *			18. Validate all the configured magma servers, relay servers, and cache servers.
+ *			19. Check all config key filenames and directories to ensure that they exist and are accessible.
+ *			20. Make sure magma.admin.contact and point to valid email addresses, if they are specified.
+ *			21. If magma.config.output_config is set, dump the current configuration.
  */
 bool_t config_validate_settings(void) {
 
@@ -381,6 +387,43 @@ bool_t config_validate_settings(void) {
 		result = false;
 	}
 
+	// The local serial number copies should only ever be used to absorb bursts of requests.
+	if (magma.iface.cache.serial_timeout > 60) {
+		log_critical("magma.iface.cache.serial_timeout is required to be 60 or smaller.");
+		result = false;
+	}
+
+	// Idle spam filter contexts hold totals which haven't been written back yet, so they shouldn't linger.
+	if (magma.iface.spam.contexts > 4096) {
+		log_critical("magma.iface.spam.contexts is required to be 4096 or smaller.");
+		result = false;
+	}
+
+	if (magma.iface.spam.timeout > 3600) {
+		log_critical("magma.iface.spam.timeout is required to be 3600 or smaller.");
+		result = false;
+	}
+
+	// The object cache budgets need to leave room for at least a handful of objects.
+	if (magma.objects.meta_limit < 1048576) {
+		log_critical("magma.objects.meta_limit is required to be 1048576 or larger.");
+		result = false;
+	}
+
+	if (magma.objects.sessions_limit < 1048576) {
+		log_critical("magma.objects.sessions_limit is required to be 1048576 or larger.");
+		result = false;
+	}
+
+	if (magma.objects.idle_timeout < 60) {
+		log_critical("magma.objects.idle_timeout is required to be 60 or larger.");
+		result = false;
+	}
+	else if (magma.objects.idle_timeout > 86400) {
+		log_critical("magma.objects.idle_timeout is required to be 86400 or smaller.");
+		result = false;
+	}
+
 	// Line wrapping range check.
 	if (magma.smtp.wrap_line_length < 40) {
 		log_critical("magma.smtp.wrap_line_length is required to be 40 or larger.");
@@ -411,6 +454,67 @@ bool_t config_validate_settings(void) {
 		result = false;
 	}
 
+	// The content checker pool.
+	if (magma.smtp.checker_threads > 64) {
+		log_critical("magma.smtp.checker_threads is required to be 64 or smaller.");
+		result = false;
+	}
+
+	// Cached recipient lookups aren't tied to a user serial when the address doesn't match a mailbox, so they shouldn't linger.
+	if (magma.smtp.prefs.timeout > 3600) {
+		log_critical("magma.smtp.prefs.timeout is required to be 3600 or smaller.");
+		result = false;
+	}
+
+	// The realtime blacklist queries.
+	if (magma.smtp.blacklists.timeout < 100) {
+		log_critical("magma.smtp.blacklist_timeout is required to be 100 or larger.");
+		result = false;
+	}
+	else if (magma.smtp.blacklists.timeout > 30000) {
+		log_critical("magma.smtp.blacklist_timeout is required to be 30000 or smaller.");
+		result = false;
+	}
+
+	if (magma.smtp.blacklists.cache > 86400) {
+		log_critical("magma.smtp.blacklist_cache is required to be 86400 or smaller.");
+		result = false;
+	}
+
+	// The deflate compression level.
+	if (magma.imap.compress_level < 1) {
+		log_critical("magma.imap.compress_level is required to be 1 or larger.");
+		result = false;
+	}
+	else if (magma.imap.compress_level > 9) {
+		log_critical("magma.imap.compress_level is required to be 9 or smaller.");
+		result = false;
+	}
+
+	// The literal limits.
+	if (magma.imap.literal_spool < 1024) {
+		log_critical("magma.imap.literal_spool is required to be 1024 or larger.");
+		result = false;
+	}
+	else if (magma.imap.literal_spool > magma.imap.literal_limit) {
+		log_critical("magma.imap.literal_spool is required to be less than or equal to magma.imap.literal_limit.");
+		result = false;
+	}
+
+	// The outbound queue limits.
+	if (magma.relay.queue.enable && (magma.relay.queue.batch < 1 || magma.relay.queue.batch > 1024)) {
+		log_critical("magma.relay.queue.batch is required to be between 1 and 1024.");
+		result = false;
+	}
+	else if (magma.relay.queue.enable && (magma.relay.queue.workers < 1 || magma.relay.queue.concurrency < 1)) {
+		log_critical("magma.relay.queue.workers and magma.relay.queue.concurrency are required to be 1 or larger.");
+		result = false;
+	}
+	else if (magma.relay.queue.enable && (magma.relay.queue.retry < 1 || magma.relay.queue.backoff < magma.relay.queue.retry)) {
+		log_critical("magma.relay.queue.retry is required to be 1 or larger, and less than or equal to magma.relay.queue.backoff.");
+		result = false;
+	}
+
 	// The legal thread stack range.
 	if (magma.system.thread_stack_size < PTHREAD_STACK_MIN) {
 		log_critical("magma.system.thread_stack_size is required to be %i or larger.", PTHREAD_STACK_MIN);
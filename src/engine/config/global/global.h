@@ -102,10 +102,19 @@ typedef struct {
 		uint32_t helo_length_limit; /* How big of a HELO/EHLO parameter will the system allow? */
 		uint32_t wrap_line_length; /* When formatting email messages attempt to wrap lines longer than this length. */
 		uint64_t message_length_limit; /* How big of a message will the system allow via SMTP? */
+		uint32_t checker_threads; /* The number of threads used to run the content checks on inbound messages concurrently. */
+
+		// The cache of recipient preferences used to answer RCPT TO commands without querying the database.
+		struct {
+			uint64_t limit; /* The amount of memory the cached lookups may hold before the least recently used are evicted. */
+			uint32_t timeout; /* How long a cached lookup may be used before the database is queried again. */
+		} prefs;
 
 		// Store information about the realtime blacklists used to block messages via SMTP.
 		struct {
 			uint32_t count;
+			uint32_t timeout; /* The number of milliseconds to wait for the blacklists to answer. */
+			uint32_t cache; /* The number of seconds a blacklist verdict for an address is cached. */
 			stringer_t *domain[MAGMA_BLACKLIST_INSTANCES];
 		} blacklists;
 
@@ -122,6 +131,12 @@ typedef struct {
 		uint32_t session_timeout; /* Number of seconds before a session cookie expires. */
 	} http;
 
+	struct {
+		uint32_t compress_level; /* The zlib compression level used by connections which negotiate COMPRESS=DEFLATE. */
+		uint64_t literal_limit; /* The largest literal a client may send, which also caps the size of an appended message. */
+		uint64_t literal_spool; /* Literals larger than this are read into a spool backed memory map, rather than the heap. */
+	} imap;
+
 	struct {
 		relay_t *host[MAGMA_RELAY_INSTANCES];
 		struct {
@@ -129,8 +144,28 @@ typedef struct {
 			uint32_t standard;
 		} count;
 		uint32_t timeout;
+		struct {
+			uint32_t connections; /* The number of idle connections kept open for each relay. */
+			uint32_t messages; /* The number of messages relayed over a connection before it's closed. */
+			uint32_t timeout; /* The number of seconds an idle connection is kept open. */
+		} pool;
+		struct {
+			bool_t enable; /* Queue outbound messages in the spool, rather than relaying them while the sender waits. */
+			uint32_t batch; /* The number of queued messages delivered over a single relay connection. */
+			uint32_t workers; /* The number of delivery batches which may run at the same time. */
+			uint32_t concurrency; /* The number of delivery batches which may run at the same time for a single destination domain. */
+			uint32_t retry; /* The number of seconds before the first retry, which doubles with each failed attempt. */
+			uint32_t backoff; /* The longest interval between retries, in seconds. */
+			uint32_t expire; /* The number of seconds a message is retried before it's returned to the sender. */
+		} queue;
 	} relay;
 
+	struct {
+		uint64_t meta_limit; /* The amount of memory the cached user objects may hold before the least recently used are evicted. */
+		uint64_t sessions_limit; /* The amount of memory the cached web sessions may hold before the least recently used are evicted. */
+		uint32_t idle_timeout; /* How long an unused object may remain in the object cache. */
+	} objects;
+
 	struct {
 		struct {
 			bool_t indent; /* Format the JSON responses before returning them? */
@@ -196,6 +231,7 @@ typedef struct {
 			} pool;
 			uint32_t retry; /* How often should dead caching servers be retried. */
 			uint32_t timeout; /* The TCP socket send/recv timeout. */
+			uint32_t serial_timeout; /* How long a local copy of the object serial numbers remains valid. */
 		} cache;
 
 		struct {
@@ -205,6 +241,11 @@ typedef struct {
 			} pool;
 		} spf;
 
+		struct {
+			uint32_t contexts; /* The number of attached spam filter contexts kept for reuse. Zero creates a new context for every message. */
+			uint32_t timeout; /* The number of seconds an idle context is kept before its totals are written back and it is released. */
+		} spam;
+
 	} iface;
 
 	// Global config section
@@ -352,6 +352,78 @@ magma_keys_t magma_keys[] = {
 		.set = false,
 		.required = false
 	},
+	{
+		.store = (void *)&(magma.imap.compress_level),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_IMAP_COMPRESS_LEVEL,
+		.name = "magma.imap.compress_level",
+		.description = "The zlib compression level used by IMAP connections which negotiate COMPRESS=DEFLATE.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.imap.literal_limit),
+		.norm.type = M_TYPE_UINT64,
+		.norm.val.u64 = MAGMA_IMAP_LITERAL_LIMIT,
+		.name = "magma.imap.literal_limit",
+		.description = "The largest literal, in bytes, accepted by the IMAP server, which also limits the size of appended messages.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.imap.literal_spool),
+		.norm.type = M_TYPE_UINT64,
+		.norm.val.u64 = MAGMA_IMAP_LITERAL_SPOOL,
+		.name = "magma.imap.literal_spool",
+		.description = "Literals larger than this many bytes are read into a memory map backed by the spool, so they don't occupy the heap.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.objects.meta_limit),
+		.norm.type = M_TYPE_UINT64,
+		.norm.val.u64 = MAGMA_OBJECTS_META_LIMIT,
+		.name = "magma.objects.meta_limit",
+		.description = "The number of bytes the cached user objects may hold before the least recently used objects are evicted.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.objects.sessions_limit),
+		.norm.type = M_TYPE_UINT64,
+		.norm.val.u64 = MAGMA_OBJECTS_SESSIONS_LIMIT,
+		.name = "magma.objects.sessions_limit",
+		.description = "The number of bytes the cached web sessions may hold before the least recently used sessions are evicted.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.objects.idle_timeout),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_OBJECTS_IDLE_TIMEOUT,
+		.name = "magma.objects.idle_timeout",
+		.description = "The number of seconds an unused user object or web session may remain in the object cache.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
 	{
 		.store = (void *)&(magma.web.portal.indent),
 		.norm.type = M_TYPE_BOOLEAN,
@@ -736,6 +808,42 @@ magma_keys_t magma_keys[] = {
 		.set = false,
 		.required = false
 	},
+	{
+		.store = (void *)&(magma.smtp.checker_threads),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 4,
+		.name = "magma.smtp.checker_threads",
+		.description = "The number of threads used to run the virus and DKIM checks on inbound messages concurrently. Use zero to run them in sequence.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.smtp.prefs.limit),
+		.norm.type = M_TYPE_UINT64,
+		.norm.val.u64 = MAGMA_SMTP_PREFS_LIMIT,
+		.name = "magma.smtp.prefs.limit",
+		.description = "The number of bytes the cached recipient preferences may hold before the least recently used lookups are evicted. Use zero to disable the cache.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.smtp.prefs.timeout),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_SMTP_PREFS_TIMEOUT,
+		.name = "magma.smtp.prefs.timeout",
+		.description = "The number of seconds a cached recipient lookup may be used before the database is queried again. Changes to an account discard its preferences sooner.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
 	{
 		.store = (void *)&(magma.smtp.recipient_limit),
 		.norm.type = M_TYPE_UINT32,
@@ -772,6 +880,30 @@ magma_keys_t magma_keys[] = {
 		.set = false,
 		.required = false
 	},
+	{
+		.store = (void *)&(magma.smtp.blacklists.timeout),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_BLACKLIST_TIMEOUT,
+		.name = "magma.smtp.blacklist_timeout",
+		.description = "The number of milliseconds to wait for the realtime blacklists to answer. The blacklists are queried concurrently.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.smtp.blacklists.cache),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_BLACKLIST_CACHE,
+		.name = "magma.smtp.blacklist_cache",
+		.description = "The number of seconds the realtime blacklist verdict for an address is cached. Use zero to query the blacklists for every connection.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
 	{
 		.store = (void *)&(magma.smtp.message_length_limit),
 		.norm.type = M_TYPE_UINT64,
@@ -916,6 +1048,30 @@ magma_keys_t magma_keys[] = {
 		.set = false,
 		.required = false
 	},
+	{
+		.store = (void *)&(magma.iface.spam.contexts),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_SPAM_CONTEXTS,
+		.name = "magma.iface.spam.contexts",
+		.description = "The number of idle spam filter contexts kept attached to the statistical database for reuse. Use zero to create a new context for every message.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.iface.spam.timeout),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_SPAM_TIMEOUT,
+		.name = "magma.iface.spam.timeout",
+		.description = "The number of seconds an idle spam filter context is kept before its message totals are written back and the context is released.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
 	{
 		.store = (void *)&(magma.iface.cache.pool.connections),
 		.norm.type = M_TYPE_UINT32,
@@ -964,6 +1120,18 @@ magma_keys_t magma_keys[] = {
 		.set = false,
 		.required = false
 	},
+	{
+		.store = (void *)&(magma.iface.cache.serial_timeout),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = MAGMA_CACHE_SERIAL_TIMEOUT,
+		.name = "magma.iface.cache.serial_timeout",
+		.description = "The number of seconds a local copy of the object serial numbers may be used before they are fetched from the cache again. A value of zero disables the local copy.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
 	{
 		.store = (void *)&(magma.relay.timeout),
 		.norm.type = M_TYPE_UINT32,
@@ -976,6 +1144,126 @@ magma_keys_t magma_keys[] = {
 		.set = false,
 		.required = false
 	},
+	{
+		.store = (void *)&(magma.relay.pool.connections),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 8,
+		.name = "magma.relay.pool.connections",
+		.description = "The number of idle connections kept open for each mail relay, so messages can be relayed without a new handshake. A value of zero disables the pool.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.pool.messages),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 100,
+		.name = "magma.relay.pool.messages",
+		.description = "The number of messages relayed over a single connection before it is closed.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.pool.timeout),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 30,
+		.name = "magma.relay.pool.timeout",
+		.description = "The number of seconds an idle mail relay connection is kept open.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.queue.enable),
+		.norm.type = M_TYPE_BOOLEAN,
+		.norm.val.binary = true,
+		.name = "magma.relay.queue.enable",
+		.description = "If enabled, outbound messages are stored in the spool and delivered to the mail relays in the background, otherwise they are relayed while the sender waits.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.queue.batch),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 20,
+		.name = "magma.relay.queue.batch",
+		.description = "The number of queued messages delivered over a single mail relay connection.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.queue.workers),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 4,
+		.name = "magma.relay.queue.workers",
+		.description = "The number of worker threads which may be delivering queued messages at the same time.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.queue.concurrency),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 2,
+		.name = "magma.relay.queue.concurrency",
+		.description = "The number of worker threads which may be delivering queued messages to the same destination domain at the same time.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.queue.retry),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 60,
+		.name = "magma.relay.queue.retry",
+		.description = "The number of seconds before a queued message is retried, which doubles after each failed attempt.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.queue.backoff),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 3600,
+		.name = "magma.relay.queue.backoff",
+		.description = "The longest interval, in seconds, between attempts to deliver a queued message.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
+	{
+		.store = (void *)&(magma.relay.queue.expire),
+		.norm.type = M_TYPE_UINT32,
+		.norm.val.u32 = 432000,
+		.name = "magma.relay.queue.expire",
+		.description = "The number of seconds a queued message is retried before it is returned to the sender.",
+		.file = true,
+		.database = true,
+		.overwrite = true,
+		.set = false,
+		.required = false
+	},
 };
 
 #endif
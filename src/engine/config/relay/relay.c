@@ -71,6 +71,7 @@ void relay_free(void) {
 		}
 
 		if (magma.relay.host[i]) {
+			mutex_destroy(&(magma.relay.host[i]->lock));
 			mm_free(magma.relay.host[i]);
 			magma.relay.host[i] = NULL;
 		}
@@ -91,6 +92,12 @@ relay_t * relay_alloc(uint32_t number) {
 	if (!(magma.relay.host[number] = mm_alloc(sizeof(relay_t))))
 		return NULL;
 
+	if (mutex_init(&(magma.relay.host[number]->lock), NULL)) {
+		mm_free(magma.relay.host[number]);
+		magma.relay.host[number] = NULL;
+		return NULL;
+	}
+
 	// Loop through and set the default values.
 	for (uint64_t i = 0; i < sizeof(relay_keys) / sizeof(relay_keys_t); i++) {
 		if (!relay_keys[i].required && !relay_set_value(&relay_keys[i], magma.relay.host[number], NULL)) {
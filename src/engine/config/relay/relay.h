@@ -21,6 +21,10 @@ typedef struct {
 	bool_t premium; /* Reserve for premium users. */
 	chr_t *name; /* The relay name. */
 	uint32_t port; /* The relay port. */
+	pthread_mutex_t lock; /* Protects the connection pool and the load counter. */
+	uint32_t active; /* The number of connections currently relaying messages. */
+	uint32_t idle; /* The number of connections waiting in the pool. */
+	void *pool; /* The most recently released connection, which links to the rest of the pool. */
 } relay_t;
 
 void relay_free (void);
@@ -14,7 +14,7 @@ pthread_t *maint = NULL;
 /**
  * @brief	The entry point for the process maintenance thread, which runs in a continuous loop unless canceled.
  * @note	Execute once daily: rotate the log files, update the warehouse, and perform tank maintenance.
- * 			Execute every few (0-10) minutes: refresh the virus engine and prune the object cache.
+ * 			Execute every few (0-10) minutes: refresh the virus engine, prune the object and recipient preferences caches, and write back the idle spam filter contexts.
  * @return	This function returns no value.
  */
 void process_maint(void) {
@@ -38,6 +38,8 @@ void process_maint(void) {
 		// Execute these functions every few minutes.
 		virus_engine_refresh();
 		obj_cache_prune();
+		smtp_prefs_prune();
+		dspam_prune();
 
 		// If were close to midnight, sleep until midnight, otherwise sleep a random number of seconds up to ten minutes.
 		if (status()) {
@@ -104,12 +106,16 @@ void process_stop(void) {
 		tank_stop, /* Shutdown the storage system. This should flush any pending write operations and cleanly close the tank data files. */
 
 		obj_cache_stop,
+		smtp_prefs_stop,
 		mail_cache_stop,
 		warehouse_stop,
 		http_content_stop,
-		NULL, /* Protocol handlers. */
+		protocol_stop, /* Protocol handlers. */
 		servers_encryption_stop,
+		smtp_inspect_stop, /* The checker pool is stopped after the workers which use it. */
 		queue_shutdown, /* Shutdown the thread pool. */
+		con_idle_stop, /* Return the parked connections to the thread pool. */
+		smtp_queue_stop, /* Wait for the outbound queue deliveries to finish. */
 		NULL /* Logging */
 	};
 
@@ -201,12 +207,16 @@ bool_t process_start(void) {
 		(void *)&tank_start,
 
 		(void *)&obj_cache_start,
+		(void *)&smtp_prefs_start,
 		(void *)&mail_cache_start,
 		(void *)&warehouse_start,
 		(void *)&http_content_start,
 		(void *)&protocol_init,
 		(void *)&servers_encryption_start,
+		(void *)&smtp_inspect_start,
 		(void *)&queue_init,
+		(void *)&con_idle_start,
+		(void *)&smtp_queue_start,
 		(void *)&log_start
 	};
 
@@ -248,12 +258,16 @@ bool_t process_start(void) {
 		"Unable to initialize the storage system. Exiting.",
 
 		"Unable to initialize the local object cache. Exiting.",
+		"Unable to initialize the recipient preferences cache. Exiting.",
 		"Unable to initialize the thread local mail cache. Exiting.",
 		"Unable to initialize the data warehouse engine. Exiting.",
 		"Unable to initialize the web content cache. Exiting.",
 		"Unable to initialize the protocol handlers. Exiting.",
 		"Unable to initialize the server encryption context. Exiting.",
+		"Unable to initialize the content checker pool. Exiting.",
 		"Unable to initialize the thread pool. Exiting.",
+		"Unable to initialize the idle connection monitor. Exiting.",
+		"Unable to initialize the outbound mail queue. Exiting.",
 		"Initialization of the log configuration failed. Exiting."
 	};
 
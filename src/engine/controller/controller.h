@@ -19,5 +19,6 @@ void     requeue(void *function, void *requeue, void *data);
 /// protocol.c
 bool_t protocol_init(void);
 void protocol_process(server_t *server, int sockd);
+void protocol_stop(void);
 
 #endif
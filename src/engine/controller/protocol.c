@@ -93,6 +93,16 @@ bool_t protocol_init(void) {
 	return true;
 }
 
+/**
+ * @brief	Release the resources held by the protocol modules, like the idle mail relay connections.
+ * @note	This function should only be called during the shutdown process, after the worker threads have finished.
+ * @return	This function returns no value.
+ */
+void protocol_stop(void) {
+	smtp_client_pool_stop();
+	return;
+}
+
 /**
  * @brief	Enqueue a protocol-specific handler to service a specified connection, and update any statistics accordingly.
  * @note	If an invalid protocol is specified, the connection will be destroyed gracefully.
@@ -23,6 +23,47 @@ struct {
 			// SMTP Statistics
 			"smtp.connections.total",
 			"smtp.connections.secure",
+			"smtp.relay.connected",
+			"smtp.relay.reused",
+			"smtp.queue.queued",
+			"smtp.queue.delivered",
+			"smtp.queue.deferred",
+			"smtp.queue.returned",
+			"smtp.checks.parallel",
+			"smtp.checks.virus.10ms",
+			"smtp.checks.virus.100ms",
+			"smtp.checks.virus.1s",
+			"smtp.checks.virus.10s",
+			"smtp.checks.virus.slow",
+			"smtp.checks.dkim.10ms",
+			"smtp.checks.dkim.100ms",
+			"smtp.checks.dkim.1s",
+			"smtp.checks.dkim.10s",
+			"smtp.checks.dkim.slow",
+			"smtp.data.remapped",
+			"smtp.prefs.hits",
+			"smtp.prefs.misses",
+			"smtp.prefs.stale",
+			"smtp.prefs.queries",
+			"smtp.prefs.total",
+			"smtp.prefs.bytes",
+			"smtp.prefs.expired",
+			"smtp.prefs.evicted",
+			"smtp.rbl.hits",
+			"smtp.rbl.misses",
+			"smtp.rbl.timeouts",
+			"smtp.rbl.1.queries",
+			"smtp.rbl.1.time",
+			"smtp.rbl.2.queries",
+			"smtp.rbl.2.time",
+			"smtp.rbl.3.queries",
+			"smtp.rbl.3.time",
+			"smtp.rbl.4.queries",
+			"smtp.rbl.4.time",
+			"smtp.rbl.5.queries",
+			"smtp.rbl.5.time",
+			"smtp.rbl.6.queries",
+			"smtp.rbl.6.time",
 
 			// DMTP Statistics
 			"dmtp.connections.total",
@@ -35,6 +76,16 @@ struct {
 			// IMAP Statistics
 			"imap.connections.total",
 			"imap.connections.secure",
+			"imap.connections.idle",
+			"imap.connections.compressed",
+			"imap.compress.raw.in",
+			"imap.compress.raw.out",
+			"imap.compress.deflated.in",
+			"imap.compress.deflated.out",
+			"imap.structures.hits",
+			"imap.structures.misses",
+			"imap.literals.spooled",
+			"imap.fetch.prefetched",
 
 			// POP Statistics
 			"pop.connections.total",
@@ -51,6 +102,14 @@ struct {
 			"provider.virus.scan.clean",
 			"provider.virus.scan.infected",
 			"provider.virus.scan.phishing",
+			"provider.virus.scan.bytes",
+			"provider.virus.scan.memory",
+			"provider.virus.scan.spooled",
+			"provider.virus.latency.1ms",
+			"provider.virus.latency.10ms",
+			"provider.virus.latency.100ms",
+			"provider.virus.latency.1s",
+			"provider.virus.latency.slow",
 			"provider.virus.signatures.total",
 			"provider.virus.signatures.loaded",
 
@@ -69,11 +128,22 @@ struct {
 			"provider.dkim.fail",
 			"provider.dkim.pass",
 
+			"provider.spam.contexts.created",
+			"provider.spam.contexts.reused",
+			"provider.spam.contexts.expired",
+			"provider.spam.contexts.evicted",
+
 			// Objects
 			"objects.meta.total",
+			"objects.meta.bytes",
 			"objects.meta.expired",
+			"objects.meta.evicted",
 			"objects.sessions.total",
+			"objects.sessions.bytes",
 			"objects.sessions.expired",
+			"objects.sessions.evicted",
+			"objects.serials.saved",
+			"objects.serials.fetched",
 
 			// Patterns
 			"objects.patterns.checked",
@@ -126,7 +196,14 @@ char *derived[] = {
 
 	// Error Statistics
 	"core.spool.errors",
-	"errors.total"
+	"errors.total",
+
+	// IMAP Statistics
+	"imap.compress.ratio",
+
+	// SMTP Statistics
+	"smtp.queue.depth",
+	"smtp.queue.age"
 };
 
 /**
@@ -233,6 +310,21 @@ uint64_t stats_derived_value(uint64_t position) {
 		result = stats_sum_errors();
 		break;
 
+	// The compressed size of the IMAP stream traffic, as a percentage of the uncompressed size.
+	case (5):
+		if ((total = stats_get_value_by_name("imap.compress.raw.in") + stats_get_value_by_name("imap.compress.raw.out"))) {
+			result = ((stats_get_value_by_name("imap.compress.deflated.in") + stats_get_value_by_name("imap.compress.deflated.out")) * 100) / total;
+		}
+		break;
+
+	// The number of messages in the outbound queue, and the age of the oldest one in seconds.
+	case (6):
+		result = smtp_queue_depth();
+		break;
+	case (7):
+		result = smtp_queue_age();
+		break;
+
 	default:
 		log_pedantic("We don't know how to calculate the derived value requested! {position = %lu}", position);
 		break;
@@ -421,6 +513,33 @@ void stats_increment_by_num(uint64_t position) {
 	return;
 }
 
+/**
+ * @brief	Record the time elapsed since an operation started in a latency histogram.
+ * @note	The bucket names array must hold one more entry than the bounds array, since anything slower than the last bound is counted by the final name.
+ * @param	start	the time the operation started.
+ * @param	bounds	an array of ascending bucket limits, in milliseconds.
+ * @param	count	the number of bucket limits in the bounds array.
+ * @param	names	an array of count + 1 null-terminated statistic names, one for each bucket.
+ * @return	This function returns no value.
+ */
+void stats_latency_by_name(struct timeval *start, uint64_t *bounds, size_t count, char **names) {
+
+	uint64_t elapsed;
+	size_t bucket = 0;
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+	elapsed = (((end.tv_sec - start->tv_sec) * 1000000) + (end.tv_usec - start->tv_usec)) / 1000;
+
+	while (bucket < count && elapsed >= bounds[bucket]) {
+		bucket++;
+	}
+
+	stats_increment_by_name(names[bucket]);
+
+	return;
+}
+
 /**
  * @brief	Provided a statistic by name, decrement its value by 1.
  * @param	name	a null-terminated string containing the name of the statistic to be decremented.
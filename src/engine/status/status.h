@@ -47,6 +47,8 @@ void stats_decrement_by_num(uint64_t position);
 void stats_increment_by_name(char *name);
 void stats_increment_by_num(uint64_t position);
 
+void stats_latency_by_name(struct timeval *start, uint64_t *bounds, size_t count, char **names);
+
 void stats_set_by_name(char *name, uint64_t value);
 void stats_set_by_num(uint64_t position, uint64_t value);
 
@@ -36,6 +36,8 @@
 #include <sys/utsname.h>
 #include <sys/prctl.h>
 #include <sys/epoll.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/sysctl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
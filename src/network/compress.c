@@ -0,0 +1,234 @@
+
+/**
+ * @file /magma/network/compress.c
+ *
+ * @brief	Functions used to layer a raw deflate stream on top of a network connection, as described by RFC 4978.
+ */
+
+#include "magma.h"
+
+/**
+ * @brief	Enable stream compression for a network connection.
+ * @note	Compression takes effect with the next byte read or written, so the caller should send its final uncompressed
+ * 			response before calling this function. Both directions use raw deflate, without the zlib header or checksum.
+ * @param	con		the connection which will be compressed.
+ * @param	level	the zlib compression level used for the output stream.
+ * @return	true on success, or false if compression is already active or the streams couldn't be initialized.
+ */
+bool_t con_compress_start(connection_t *con, int_t level) {
+
+	con_compress_t *compress;
+
+	if (!con || con->network.compress || !(compress = mm_alloc(sizeof(con_compress_t)))) {
+		return false;
+	}
+
+	if (deflateInit2__d(&(compress->deflate), level, Z_DEFLATED, -CON_COMPRESS_WINDOW, CON_COMPRESS_MEMORY, Z_DEFAULT_STRATEGY, ZLIB_VERSION,
+		sizeof(z_stream)) != Z_OK) {
+		log_pedantic("Unable to initialize the connection compression stream.");
+		mm_free(compress);
+		return false;
+	}
+	else if (inflateInit2__d(&(compress->inflate), -CON_COMPRESS_WINDOW, ZLIB_VERSION, sizeof(z_stream)) != Z_OK) {
+		log_pedantic("Unable to initialize the connection decompression stream.");
+		deflateEnd_d(&(compress->deflate));
+		mm_free(compress);
+		return false;
+	}
+
+	con->network.compress = compress;
+	stats_increment_by_name("imap.connections.compressed");
+
+	return true;
+}
+
+/**
+ * @brief	Flush any pending output, and release the compression state of a network connection.
+ * @param	con		the connection whose compression state will be released.
+ * @return	This function returns no value.
+ */
+void con_compress_stop(connection_t *con) {
+
+	if (!con || !con->network.compress) {
+		return;
+	}
+
+	if (con->network.sockd != -1 && con_status(con) >= 0) {
+		con_compress_flush(con);
+	}
+
+	deflateEnd_d(&(con->network.compress->deflate));
+	inflateEnd_d(&(con->network.compress->inflate));
+	mm_free(con->network.compress);
+	con->network.compress = NULL;
+
+	stats_decrement_by_name("imap.connections.compressed");
+
+	return;
+}
+
+/**
+ * @brief	Determine whether decompressed input is waiting inside the compression state of a network connection.
+ * @note	Buffered input won't trigger the socket, so callers need to check this before waiting on the socket for readability.
+ * @param	con		the connection being checked.
+ * @return	true if input is waiting, otherwise false.
+ */
+bool_t con_compress_pending(connection_t *con) {
+
+	if (con && con->network.compress && (con->network.compress->inflate.avail_in || con->network.compress->pending)) {
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief	Compress a block of data and write any finished output to the network.
+ * @note	Small writes are buffered by the deflate stream, so the output isn't guaranteed to reach the client until
+ * 			con_compress_flush() is called, which happens automatically before the connection reads from, or waits on, the socket.
+ * @param	con		the connection across which the data will be written.
+ * @param	buffer	a pointer to the data being written.
+ * @param	length	the length, in bytes, of the data being written.
+ * @return	-1 on failure, or the number of uncompressed bytes which were accepted.
+ */
+int64_t con_compress_write(connection_t *con, void *buffer, size_t length) {
+
+	int ret;
+	size_t have;
+	int64_t written = 0;
+	con_compress_t *compress = con->network.compress;
+
+	compress->deflate.next_in = buffer;
+	compress->deflate.avail_in = length;
+
+	do {
+
+		compress->deflate.next_out = compress->output;
+		compress->deflate.avail_out = CON_COMPRESS_BUFFER;
+
+		if ((ret = deflate_d(&(compress->deflate), Z_NO_FLUSH)) != Z_OK && ret != Z_BUF_ERROR) {
+			log_pedantic("Unable to compress the connection output. { ret = %i }", ret);
+			con->network.status = -1;
+			return -1;
+		}
+
+		if ((have = CON_COMPRESS_BUFFER - compress->deflate.avail_out) && con_write_raw(con, compress->output, have) != (int64_t)have) {
+			con->network.status = -1;
+			return -1;
+		}
+
+		written += have;
+
+	} while (compress->deflate.avail_in || !compress->deflate.avail_out);
+
+	compress->unflushed += length;
+	stats_adjust_by_name("imap.compress.raw.out", length);
+	stats_adjust_by_name("imap.compress.deflated.out", written);
+
+	con->network.status = 1;
+	return length;
+}
+
+/**
+ * @brief	Force any output buffered by the deflate stream out to the network.
+ * @note	A sync flush is used, so the client can decompress everything sent so far without the stream being reset.
+ * @param	con		the connection being flushed.
+ * @return	-1 on failure, or the number of compressed bytes written to the network.
+ */
+int64_t con_compress_flush(connection_t *con) {
+
+	int ret;
+	size_t have;
+	int64_t written = 0;
+	con_compress_t *compress;
+
+	if (!con || !(compress = con->network.compress) || !compress->unflushed) {
+		return 0;
+	}
+
+	compress->deflate.next_in = NULL;
+	compress->deflate.avail_in = 0;
+
+	do {
+
+		compress->deflate.next_out = compress->output;
+		compress->deflate.avail_out = CON_COMPRESS_BUFFER;
+
+		if ((ret = deflate_d(&(compress->deflate), Z_SYNC_FLUSH)) != Z_OK && ret != Z_BUF_ERROR) {
+			log_pedantic("Unable to flush the connection output. { ret = %i }", ret);
+			con->network.status = -1;
+			return -1;
+		}
+
+		if ((have = CON_COMPRESS_BUFFER - compress->deflate.avail_out) && con_write_raw(con, compress->output, have) != (int64_t)have) {
+			con->network.status = -1;
+			return -1;
+		}
+
+		written += have;
+
+	} while (!compress->deflate.avail_out);
+
+	compress->unflushed = 0;
+	stats_adjust_by_name("imap.compress.deflated.out", written);
+
+	return written;
+}
+
+/**
+ * @brief	Read and decompress data from a network connection.
+ * @note	Input which was already read off the network is decompressed before the socket is touched again. Any output still
+ * 			buffered by the deflate stream is flushed before reading, since the client may be waiting on it before sending more data.
+ * @param	con		the connection from which the data will be read.
+ * @param	buffer	a pointer to the buffer which will receive the decompressed data.
+ * @param	length	the maximum number of decompressed bytes to return.
+ * @param	block	if true the network read will block waiting for data.
+ * @return	-1 on failure, 0 if no decompressed data was available, or the number of decompressed bytes stored in the buffer.
+ */
+int64_t con_compress_read(connection_t *con, void *buffer, size_t length, bool_t block) {
+
+	int ret;
+	int64_t bytes;
+	con_compress_t *compress = con->network.compress;
+
+	compress->inflate.next_out = buffer;
+	compress->inflate.avail_out = length;
+
+	// Decompress whatever is left over from the previous network read before going back to the socket.
+	if (compress->inflate.avail_in || compress->pending) {
+
+		if ((ret = inflate_d(&(compress->inflate), Z_SYNC_FLUSH)) != Z_OK && ret != Z_BUF_ERROR) {
+			log_pedantic("Unable to decompress the connection input. { ret = %i }", ret);
+			return -1;
+		}
+
+		compress->pending = !compress->inflate.avail_out;
+
+		if (length - compress->inflate.avail_out) {
+			stats_adjust_by_name("imap.compress.raw.in", length - compress->inflate.avail_out);
+			return length - compress->inflate.avail_out;
+		}
+	}
+
+	if (con_compress_flush(con) < 0) {
+		return -1;
+	}
+	else if ((bytes = con_read_raw(con, compress->input, CON_COMPRESS_BUFFER, block)) <= 0) {
+		return bytes;
+	}
+
+	stats_adjust_by_name("imap.compress.deflated.in", bytes);
+
+	compress->inflate.next_in = compress->input;
+	compress->inflate.avail_in = bytes;
+
+	if ((ret = inflate_d(&(compress->inflate), Z_SYNC_FLUSH)) != Z_OK && ret != Z_BUF_ERROR) {
+		log_pedantic("Unable to decompress the connection input. { ret = %i }", ret);
+		return -1;
+	}
+
+	compress->pending = !compress->inflate.avail_out;
+	stats_adjust_by_name("imap.compress.raw.in", length - compress->inflate.avail_out);
+
+	return length - compress->inflate.avail_out;
+}
@@ -152,6 +152,11 @@ void con_destroy(connection_t *con) {
 				break;
 		}
 
+		// Any compressed output still buffered is flushed before the TLS session is torn down.
+		if (con->network.compress) {
+			con_compress_stop(con);
+		}
+
 		if (con->network.tls) {
 			tls_free(con->network.tls);
 		}
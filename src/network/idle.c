@@ -0,0 +1,338 @@
+
+/**
+ * @file /magma/network/idle.c
+ *
+ * @brief	Functions used to park idle connections, so they can wait for input or change notifications without occupying a worker thread.
+ */
+
+#include "magma.h"
+
+typedef struct idle_record_t {
+	connection_t *con; /* The parked connection. */
+	uint64_t usernum; /* The user whose changes should wake the connection. */
+	time_t parked, checked; /* When the connection was parked, and when the check function last ran. */
+	uint32_t timeout; /* How long, in seconds, the connection may stay parked before it is dropped. */
+	void (*wake)(connection_t *con); /* The function enqueued when the connection wakes up. */
+	bool_t (*check)(connection_t *con); /* An optional function used to poll for changes made by other processes. */
+	uint32_t events; /* The accumulated reasons for waking the connection. */
+	struct idle_record_t *prev, *next;
+} idle_record_t;
+
+struct {
+	int ed; /* The epoll descriptor used to watch the parked sockets. */
+	int fd; /* The eventfd descriptor used to interrupt the epoll wait. */
+	bool_t running;
+	pthread_t *thread;
+	pthread_mutex_t lock;
+	idle_record_t *head;
+} idle = {
+		.ed = -1,
+		.fd = -1,
+		.running = false,
+		.thread = NULL,
+		.head = NULL
+};
+
+/**
+ * @brief	Interrupt the idle thread, so it notices newly flagged records.
+ * @return	This function returns no value.
+ */
+static void con_idle_signal(void) {
+
+	uint64_t one = 1;
+
+	if (idle.fd != -1 && write(idle.fd, &one, sizeof(uint64_t)) != sizeof(uint64_t) && errno != EAGAIN) {
+		log_pedantic("Unable to signal the idle connection thread. {errno = %i}", errno);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Return any flagged records to the worker queue.
+ * @note	Only the idle thread removes records from the list, so a record can never be freed while another thread is using it.
+ * @param	all		if set, every parked record is flagged with this event before being dispatched.
+ * @return	This function returns no value.
+ */
+static void con_idle_dispatch(uint32_t all) {
+
+	idle_record_t *record, *next, *ready = NULL;
+
+	mutex_lock(&idle.lock);
+
+	for (record = idle.head; record; record = next) {
+
+		next = record->next;
+		record->events |= all;
+
+		if (record->events) {
+
+			if (record->prev) record->prev->next = record->next;
+			else idle.head = record->next;
+			if (record->next) record->next->prev = record->prev;
+
+			record->next = ready;
+			ready = record;
+		}
+	}
+
+	mutex_unlock(&idle.lock);
+
+	while ((record = ready)) {
+		ready = record->next;
+
+		epoll_ctl(idle.ed, EPOLL_CTL_DEL, record->con->network.sockd, NULL);
+		record->con->network.idle = record->events;
+		enqueue(record->wake, record->con);
+
+		stats_decrement_by_name("imap.connections.idle");
+		mm_free(record);
+	}
+
+	return;
+}
+
+/**
+ * @brief	The idle thread entry point, which watches the parked sockets and decides when each connection should be returned to a worker.
+ * @note	Readable sockets and local change notifications wake a connection immediately. The optional check function, which catches changes
+ * 			made by other processes, is only run every CON_IDLE_TICK seconds, and connections are dropped once their timeout has passed.
+ * @return	This function returns no value.
+ */
+static void con_idle_thread(void) {
+
+	int count;
+	time_t now;
+	uint64_t drain;
+	idle_record_t *record;
+	struct epoll_event events[64];
+
+	thread_start();
+
+	while (status() && idle.running) {
+
+		if ((count = epoll_wait(idle.ed, events, 64, 1000)) == -1 && errno != EINTR) {
+			log_pedantic("The idle connection thread was unable to wait for events. {errno = %i}", errno);
+		}
+
+		mutex_lock(&idle.lock);
+
+		for (int i = 0; i < count; i++) {
+			if (events[i].data.ptr) {
+				((idle_record_t *)events[i].data.ptr)->events |= CON_IDLE_READ;
+			}
+		}
+
+		mutex_unlock(&idle.lock);
+
+		for (int i = 0; i < count; i++) {
+			if (!events[i].data.ptr && read(idle.fd, &drain, sizeof(uint64_t)) != sizeof(uint64_t) && errno != EAGAIN) {
+				log_pedantic("Unable to drain the idle connection event descriptor. {errno = %i}", errno);
+			}
+		}
+
+		// Records are only unlinked by this thread, so once the head is read the list can be walked without holding the lock, which
+		// keeps the cache round trips made by the check functions from blocking notifications.
+		now = time(NULL);
+		mutex_lock(&idle.lock);
+		record = idle.head;
+		mutex_unlock(&idle.lock);
+
+		for (; record; record = record->next) {
+
+			if (difftime(now, record->parked) >= record->timeout) {
+				mutex_lock(&idle.lock);
+				record->events |= CON_IDLE_EXPIRED;
+				mutex_unlock(&idle.lock);
+			}
+			else if (record->check && difftime(now, record->checked) >= CON_IDLE_TICK) {
+				record->checked = now;
+
+				if (record->check(record->con)) {
+					mutex_lock(&idle.lock);
+					record->events |= CON_IDLE_CHANGED;
+					mutex_unlock(&idle.lock);
+				}
+			}
+		}
+
+		con_idle_dispatch(0);
+	}
+
+	// Once the loop exits, new connections can't be parked, and anything still waiting is handed back so it can be logged out.
+	mutex_lock(&idle.lock);
+	idle.running = false;
+	mutex_unlock(&idle.lock);
+
+	con_idle_dispatch(CON_IDLE_SHUTDOWN);
+
+	thread_stop();
+	pthread_exit(NULL);
+	return;
+}
+
+/**
+ * @brief	Park a connection until its socket becomes readable, or a change is reported for the specified user.
+ * @note	Once parked, the connection belongs to the idle thread until the wake function is enqueued, and the reason for the
+ * 			wake up is stored in con->network.idle as a mask of CON_IDLE_* event values.
+ * @param	con			the connection being parked.
+ * @param	usernum		the numerical id of the user whose change notifications should wake the connection.
+ * @param	timeout		the number of seconds the connection may stay parked before it is woken up and dropped.
+ * @param	wake		the function which will be enqueued, with the connection as its argument, when it wakes up.
+ * @param	check		an optional function, called periodically from the idle thread, which returns true if the connection should wake up.
+ * @return	true if the connection was parked, or false if the caller retains ownership of the connection.
+ */
+bool_t con_idle_park(connection_t *con, uint64_t usernum, uint32_t timeout, void *wake, bool_t (*check)(connection_t *con)) {
+
+	idle_record_t *record;
+	struct epoll_event event;
+
+	if (!con || con->network.sockd == -1 || !wake) {
+		return false;
+	}
+	// Compressed output buffered by the deflate stream has to reach the client before the connection goes to sleep.
+	else if (con->network.compress && con_compress_flush(con) < 0) {
+		return false;
+	}
+	else if (!(record = mm_alloc(sizeof(idle_record_t)))) {
+		return false;
+	}
+
+	record->con = con;
+	record->usernum = usernum;
+	record->timeout = timeout;
+	record->wake = wake;
+	record->check = check;
+	record->parked = record->checked = time(NULL);
+	con->network.idle = 0;
+
+	mm_wipe(&event, sizeof(struct epoll_event));
+	event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+	event.data.ptr = record;
+
+	// The lock is held across the registration so the idle thread can't see the event before the record is linked.
+	mutex_lock(&idle.lock);
+
+	if (!idle.running || epoll_ctl(idle.ed, EPOLL_CTL_ADD, con->network.sockd, &event)) {
+		mutex_unlock(&idle.lock);
+		mm_free(record);
+		return false;
+	}
+
+	if ((record->next = idle.head)) {
+		idle.head->prev = record;
+	}
+
+	idle.head = record;
+	stats_increment_by_name("imap.connections.idle");
+
+	mutex_unlock(&idle.lock);
+
+	return true;
+}
+
+/**
+ * @brief	Wake any parked connections waiting on changes to a user's folders or messages.
+ * @param	usernum		the numerical id of the user whose data changed.
+ * @return	This function returns no value.
+ */
+void con_idle_notify(uint64_t usernum) {
+
+	bool_t signal = false;
+
+	if (!idle.running) {
+		return;
+	}
+
+	mutex_lock(&idle.lock);
+
+	for (idle_record_t *record = idle.head; record; record = record->next) {
+		if (record->usernum == usernum) {
+			record->events |= CON_IDLE_NOTIFY;
+			signal = true;
+		}
+	}
+
+	mutex_unlock(&idle.lock);
+
+	if (signal) {
+		con_idle_signal();
+	}
+
+	return;
+}
+
+/**
+ * @brief	Create the epoll and event descriptors and launch the idle connection thread.
+ * @return	true on success, or false on failure.
+ */
+bool_t con_idle_start(void) {
+
+	struct epoll_event event;
+
+	if (mutex_init(&idle.lock, NULL)) {
+		log_critical("Unable to initialize the idle connection lock.");
+		return false;
+	}
+	else if ((idle.ed = epoll_create1(EPOLL_CLOEXEC)) == -1 || (idle.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		log_critical("Unable to create the idle connection descriptors. {errno = %i}", errno);
+		con_idle_stop();
+		return false;
+	}
+
+	// The event descriptor is registered with an empty data pointer, which is how the idle thread tells it apart from the parked sockets.
+	mm_wipe(&event, sizeof(struct epoll_event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+
+	if (epoll_ctl(idle.ed, EPOLL_CTL_ADD, idle.fd, &event)) {
+		log_critical("Unable to register the idle connection event descriptor. {errno = %i}", errno);
+		con_idle_stop();
+		return false;
+	}
+
+	idle.running = true;
+
+	if (!(idle.thread = thread_alloc(con_idle_thread, NULL))) {
+		log_critical("Unable to launch the idle connection thread.");
+		idle.running = false;
+		con_idle_stop();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Stop the idle connection thread, returning any parked connections to the worker queue, and release the descriptors.
+ * @note	This must run before the worker queue is shutdown, since the parked connections are handed back to the workers for logout.
+ * @return	This function returns no value.
+ */
+void con_idle_stop(void) {
+
+	if (idle.thread) {
+
+		// Clearing the running flag stops the thread even while the process is still running.
+		mutex_lock(&idle.lock);
+		idle.running = false;
+		mutex_unlock(&idle.lock);
+
+		con_idle_signal();
+		thread_join(*idle.thread);
+		mm_free(idle.thread);
+		idle.thread = NULL;
+	}
+
+	if (idle.fd != -1) {
+		close(idle.fd);
+		idle.fd = -1;
+	}
+
+	if (idle.ed != -1) {
+		close(idle.ed);
+		idle.ed = -1;
+	}
+
+	mutex_destroy(&idle.lock);
+
+	return;
+}
@@ -10,13 +10,24 @@
 
 typedef array_t imap_arguments_t;
 
+// The number of messages a FETCH command loads ahead of the one being written, and the total size those messages may occupy.
+#define IMAP_PREFETCH_DEPTH 8
+#define IMAP_PREFETCH_MEMORY_LIMIT 33554432
+
+// The life cycle of a message being loaded ahead.
+#define IMAP_PREFETCH_QUEUED 0
+#define IMAP_PREFETCH_RUNNING 1
+#define IMAP_PREFETCH_COMPLETE 2
+#define IMAP_PREFETCH_CANCELLED 3
+
 // A structure containing the folder status information.
 typedef struct {
-	uint64_t foldernum, recent, unseen, uidnext, messages, first;
+	uint64_t foldernum, recent, unseen, uidnext, messages, first, highestmodseq;
 } imap_folder_status_t;
 
 typedef struct {
-	int_t uid, flags, internaldate, envelope, bodystructure, rfc822, rfc822_header, rfc822_size, rfc822_text, body;
+	int_t uid, flags, internaldate, envelope, bodystructure, rfc822, rfc822_header, rfc822_size, rfc822_text, body, modseq, vanished;
+	uint64_t changedsince;
 	array_t *peek, *peek_partial, *normal, *normal_partial;
 } imap_fetch_dataitems_t;
 
@@ -25,12 +36,37 @@ typedef struct {
 	struct imap_fetch_response_t *next;
 } imap_fetch_response_t;
 
+typedef struct {
+	int_t state;
+	size_t reserved;
+	uint32_t refs;
+	uint64_t ordinal;
+	meta_message_t *meta;
+	stringer_t *text;
+	struct imap_prefetch_t *prefetch;
+} imap_prefetch_job_t;
+
+typedef struct imap_prefetch_t {
+	pthread_mutex_t lock;
+	meta_user_t *user;
+	server_t *server;
+	inx_cursor_t *cursor;
+	uint64_t changedsince, ordinal, consumed;
+	size_t head, count, reserved;
+	uint32_t refs;
+	imap_prefetch_job_t *jobs[IMAP_PREFETCH_DEPTH];
+} imap_prefetch_t;
+
 typedef struct __attribute__ ((packed)) {
 	meta_user_t *user;
 	imap_arguments_t *arguments;
+	inx_t *search; /* The full text index matches for the running SEARCH command, keyed by the address of each search value. */
+	inx_t *structures; /* The MIME structures used by the running FETCH command, keyed by message number. */
 	stringer_t *tag, *command, *username;
-	int_t read_only, uid, session_state;
+	int_t read_only, uid, session_state, condstore, qresync;
 	uint64_t usernum, selected, user_checkpoint, messages_checkpoint, folders_checkpoint, messages_recent, messages_total;
+	uint64_t *known; /* The UIDs of the messages in the selected folder the client has been told about, in sequence order. */
+	uint64_t known_count, known_serial, known_modseq; /* The number of known messages, and the message serial and highest modification sequence when they were recorded. */
 } imap_session_t;
 
 #endif
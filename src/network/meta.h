@@ -83,14 +83,44 @@ typedef struct {
 	chr_t server[33];
 	uint32_t status, updated;
 	uint64_t messagenum, foldernum, sequencenum, signum, sigkey, created;
+	uint64_t modseq; // The modification sequence assigned the last time the message flags changed.
 } meta_message_t;
 
+typedef struct {
+	uint64_t messages, recent, unseen, tagged, bytes; // Every message in the folder.
+	uint64_t visible, visible_bytes; // Only the messages available to POP, which excludes hidden and appended messages.
+	uint64_t highest; // The highest message number seen in the folder, which never decreases until the counters are rebuilt.
+	uint64_t modseq; // The highest modification sequence seen in the folder, which is also bumped whenever a message is expunged.
+} meta_counters_t;
+
 typedef struct {
 	chr_t name[128]; // Even though we limit folder names to 16 characters, with modified UTF-7 escaping, the string could be longer.
 	uint32_t order;
-	uint64_t parent, foldernum;
+	uint64_t parent, foldernum, modseq;
+	meta_counters_t counters;
 } meta_folder_t;
 
+/***
+ * @struct object_link_t
+ * @brief	Links a cached object into the list that orders the object cache from most to least recently used.
+ */
+typedef struct object_link {
+	void *object; /* The object holding the links, or NULL if it isn't on a list. */
+	size_t bytes; /* The estimated amount of memory held by the object. */
+	struct object_link *prev, *next;
+} object_link_t;
+
+/***
+ * @struct meta_snapshot_t
+ * @brief	An immutable, reference counted copy of a user's message meta data, which readers can hold without locking the user object.
+ */
+typedef struct {
+	uint64_t refs; /* The number of readers holding the snapshot, plus one while it's published as the user's current snapshot. */
+	uint64_t serial; /* The messages serial number when the snapshot was taken. */
+	inx_t *messages; /* The message copies, kept in the same order as the live collection. Unchanged copies are shared with later snapshots. */
+	pthread_mutex_t lock;
+} meta_snapshot_t;
+
 // All of a user's information is stored using this structure.
 typedef struct {
 
@@ -121,6 +151,14 @@ typedef struct {
 		pthread_mutex_t lock;
 	} refs;
 
+	// The most recently published message snapshot, and the invalidated snapshot whose message copies can be reused by the next one.
+	struct {
+		meta_snapshot_t *current, *previous;
+		pthread_mutex_t lock;
+	} snapshot;
+
+	object_link_t cache;
+
 } meta_user_t;
 
 #endif
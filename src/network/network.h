@@ -23,12 +23,38 @@ enum {
 	REVERSE_COMPLETE = 2
 };
 
+// The reasons a parked connection can be woken up, which are stored in con->network.idle.
+enum {
+	CON_IDLE_READ = 1,
+	CON_IDLE_NOTIFY = 2,
+	CON_IDLE_CHANGED = 4,
+	CON_IDLE_EXPIRED = 8,
+	CON_IDLE_SHUTDOWN = 16
+};
+
+#define CON_IDLE_TICK 30 /* How often, in seconds, parked connections check for changes made by other processes. */
+#define CON_IDLE_TIMEOUT 1800 /* How long, in seconds, an IMAP connection may stay parked before it is dropped. */
+
+#define CON_COMPRESS_BUFFER 16384 /* The size of the buffers used to hold compressed data on its way to, or from, the socket. */
+#define CON_COMPRESS_WINDOW 15 /* The base two logarithm of the deflate window size, which RFC 4978 requires to be the maximum. */
+#define CON_COMPRESS_MEMORY 8 /* The amount of memory, as a zlib memLevel value, used for the internal compression state. */
+
 typedef struct {
 	char *string;
 	size_t length;
 	void *function;
 } command_t;
 
+// The per connection state used to layer a raw deflate stream, in both directions, on top of the socket or TLS session.
+typedef struct {
+	z_stream inflate; /* The stream used to decompress the client input. */
+	z_stream deflate; /* The stream used to compress the server output. */
+	bool_t pending; /* Set when the last inflate call filled the output buffer, which means decompressed data may still be waiting. */
+	size_t unflushed; /* The number of bytes passed to the deflate stream since the last flush. */
+	uchr_t input[CON_COMPRESS_BUFFER]; /* Compressed data read from the network which hasn't been decompressed yet. */
+	uchr_t output[CON_COMPRESS_BUFFER]; /* Compressed data waiting to be written to the network. */
+} con_compress_t;
+
 // Setup the structure of variables used to relay and bounce messages.
 typedef struct {
 	ip_t *ip; /* The remote host address information. */
@@ -37,6 +63,13 @@ typedef struct {
 	int status; /* Track whether the last network generated an error. */
 	placer_t line; /* The current line being processed. */
 	stringer_t *buffer; /* The connection buffer. */
+	struct {
+		relay_t *relay; /* The mail relay the connection was opened with, and whose pool it returns to. */
+		uint32_t state; /* The SMTP_CLIENT flags describing the relay session. */
+		uint64_t messages; /* The number of messages relayed over the connection. */
+		time_t released; /* When the connection was last returned to the pool. */
+		void *next; /* The next connection in the pool. */
+	} smtp;
 } client_t;
 
 typedef struct {
@@ -59,6 +92,8 @@ typedef struct {
 		int status; /* Track whether the last network operation generated an error. */
 		placer_t line; /* The current line being processed. */
 		stringer_t *buffer; /* The connection buffer. */
+		uint32_t idle; /* The reasons a parked connection was woken up. */
+		con_compress_t *compress; /* The compression state, if the session has negotiated stream compression. */
 
 		struct {
 			ip_t *ip;
@@ -94,6 +129,14 @@ bool_t          con_private(connection_t *con);
 int_t           con_secure(connection_t *con);
 int_t           con_status(connection_t *con);
 
+/// compress.c
+int64_t   con_compress_flush(connection_t *con);
+bool_t    con_compress_pending(connection_t *con);
+int64_t   con_compress_read(connection_t *con, void *buffer, size_t length, bool_t block);
+bool_t    con_compress_start(connection_t *con, int_t level);
+void      con_compress_stop(connection_t *con);
+int64_t   con_compress_write(connection_t *con, void *buffer, size_t length);
+
 /// clients.c
 void        client_close(client_t *client);
 client_t *  client_connect(chr_t *host, uint32_t port);
@@ -114,6 +157,7 @@ int64_t   client_read(client_t *client);
 int64_t   client_read_line(client_t *client);
 int64_t   con_read(connection_t *con);
 int64_t   con_read_line(connection_t *con, bool_t block);
+int64_t   con_read_raw(connection_t *con, void *buffer, size_t length, bool_t block);
 
 /// reverse.c
 stringer_t *  con_reverse_check(connection_t *con, uint32_t timeout);
@@ -122,6 +166,12 @@ void          con_reverse_enqueue(connection_t *con);
 void          con_reverse_lookup(connection_t *con);
 void          con_reverse_status(connection_t *con, int_t status);
 
+/// idle.c
+bool_t   con_idle_park(connection_t *con, uint64_t usernum, uint32_t timeout, void *wake, bool_t (*check)(connection_t *con));
+void     con_idle_notify(uint64_t usernum);
+bool_t   con_idle_start(void);
+void     con_idle_stop(void);
+
 /// listeners.c
 bool_t   net_init(server_t *server);
 void     net_listen(void);
@@ -134,6 +184,7 @@ int64_t   con_print(connection_t *con, chr_t *format, ...);
 int64_t   con_write_bl(connection_t *con, char *block, size_t length);
 int64_t   con_write_ns(connection_t *con, char *string);
 int64_t   con_write_pl(connection_t *con, placer_t string);
+int64_t   con_write_raw(connection_t *con, void *buffer, size_t length);
 int64_t   con_write_st(connection_t *con, stringer_t *string);
 
 stringer_t * protocol_type(connection_t *con);
@@ -7,6 +7,24 @@
 
 #include "magma.h"
 
+/**
+ * @brief	Read data directly from the socket, or TLS session, underlying a network connection.
+ * @note	This function bypasses any stream compression, which is layered on top of it, and is also used by the decompression logic.
+ * @param	con		the network connection across which the data will be read.
+ * @param	buffer	a pointer to the buffer which will receive the data.
+ * @param	length	the maximum number of bytes to read.
+ * @param	block	if true the read operation will block waiting for data.
+ * @return	-1 on failure, 0 if no data was available, or the number of bytes read.
+ */
+int64_t con_read_raw(connection_t *con, void *buffer, size_t length, bool_t block) {
+
+	if (con->network.tls) {
+		return tls_read(con->network.tls, buffer, length, block);
+	}
+
+	return tcp_read(con->network.sockd, buffer, length, block);
+}
+
 /**
  * @brief	Read a line of input from a network connection.
  * @note	This function handles reading data from both regular and ssl connections.
@@ -64,12 +82,12 @@ int64_t con_read_line(connection_t *con, bool_t block) {
 //		blocking = st_length_get(con->network.buffer) ? false : true;
 		block = true;
 
-		if (con->network.tls) {
-			bytes = tls_read(con->network.tls, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
+		if (con->network.compress) {
+			bytes = con_compress_read(con, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
 				st_avail_get(con->network.buffer) - st_length_get(con->network.buffer), block);
 		}
 		else {
-			bytes = tcp_read(con->network.sockd, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
+			bytes = con_read_raw(con, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
 				st_avail_get(con->network.buffer) - st_length_get(con->network.buffer), block);
 		}
 
@@ -216,12 +234,12 @@ int64_t con_read(connection_t *con) {
 //		blocking = st_length_get(con->network.buffer) ? false : true;
 		blocking = true;
 
-		if (con->network.tls) {
-			bytes = tls_read(con->network.tls, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
+		if (con->network.compress) {
+			bytes = con_compress_read(con, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
 				st_avail_get(con->network.buffer) - st_length_get(con->network.buffer), blocking);
 		}
 		else {
-			bytes = tcp_read(con->network.sockd, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
+			bytes = con_read_raw(con, st_char_get(con->network.buffer) + st_length_get(con->network.buffer),
 				st_avail_get(con->network.buffer) - st_length_get(con->network.buffer), blocking);
 		}
 
@@ -63,6 +63,7 @@ typedef struct {
 	} refresh;
 
 	pthread_mutex_t lock;
+	object_link_t cache;
 
 } session_t;
 
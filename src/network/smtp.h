@@ -8,6 +8,14 @@
 #ifndef MAGMA_OBJECTS_SMTP_H
 #define MAGMA_OBJECTS_SMTP_H
 
+// Pooled relay connections which have been idle for more than this many seconds are sent a NOOP before they're reused.
+#define SMTP_CLIENT_POOL_VERIFY 5
+
+// The flags stored in the state of a relay connection.
+#define SMTP_CLIENT_GREETED 0x01 // The relay has accepted our EHLO/HELO.
+#define SMTP_CLIENT_PIPELINING 0x02 // The relay advertised the PIPELINING extension.
+#define SMTP_CLIENT_FINISHED 0x04 // The last transaction completed, so the connection can be reused.
+
 enum {
 	SMTP_ACTION_ERROR = -1,
 	SMTP_ACTION_UNDEFINED = 0,
@@ -53,7 +61,11 @@ enum {
 	SMTP_OUTCOME_BOUNCE_VIRUS = 64,
 	SMTP_OUTCOME_BOUNCE_PHISH = 128,
 	SMTP_OUTCOME_BOUNCE_SPAM = 256,
-	SMTP_OUTCOME_BOUNCE_RBL = 512
+	SMTP_OUTCOME_BOUNCE_RBL = 512,
+
+	SMTP_INSPECT_VIRUS = 0, // The per message content checks run by the checker pool.
+	SMTP_INSPECT_DKIM = 1,
+	SMTP_INSPECT_CHECKS = 2
 };
 
 typedef struct {
@@ -69,6 +81,7 @@ typedef struct {
 // A linked list of recipients.
 typedef struct {
 	stringer_t *address;
+	stringer_t *response; /* The relay's refusal, which is only set in the lists of rejected recipients returned by smtp_client_send_envelope(). */
 	struct smtp_recipients_t *next;
 } smtp_recipients_t;
 
@@ -106,6 +119,7 @@ typedef struct {
 	bool_t submission;
 	bool_t authenticated;
 	bool_t suggested_eight_bit;
+	bool_t suggested_binary;
 
 	size_t max_length;
 	size_t num_recipients;
@@ -123,6 +137,9 @@ typedef struct {
 		int_t virus;
 	} checked;
 
+	// The message data received so far using BDAT, which is assembled until the LAST chunk arrives.
+	stringer_t *chunks;
+
 	smtp_message_t *message;
 	smtp_inbound_prefs_t *in_prefs;
 	smtp_outbound_prefs_t *out_prefs;
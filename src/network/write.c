@@ -23,10 +23,6 @@
  */
 int64_t con_write_bl(connection_t *con, char *block, size_t length) {
 
-	int_t counter = 0;
-	ssize_t bytes = 0, position = 0;
-//	stringer_t *ip = NULL, *cipher = NULL, *error = NULL;
-
 	if (!con || con->network.sockd == -1 || con_status(con) < 0) {
 		return -1;
 	}
@@ -35,6 +31,30 @@ int64_t con_write_bl(connection_t *con, char *block, size_t length) {
 		return 0;
 	}
 
+	// Sessions which have negotiated stream compression pass the data through the deflate stream first.
+	if (con->network.compress) {
+		return con_compress_write(con, block, length);
+	}
+
+	return con_write_raw(con, block, length);
+}
+
+/**
+ * @brief	Write data directly to the socket, or TLS session, underlying a network connection.
+ * @note	This function bypasses any stream compression, and is also used to transmit the output of the compression logic.
+ * 			If the network write requires multiple system calls, then this code will loop until all the data has been transmitted.
+ * @param	con		the connection across which the supplied data will be written.
+ * @param	buffer	a pointer to a data buffer containing the data to be written to the connection's remote client.
+ * @param	length	the length, in bytes, of the data buffer to be written.
+ * @return	-1 on general network failure, or the number of bytes that were written across the connection.
+ */
+int64_t con_write_raw(connection_t *con, void *buffer, size_t length) {
+
+	int_t counter = 0;
+	ssize_t bytes = 0, position = 0;
+	chr_t *block = buffer;
+//	stringer_t *ip = NULL, *cipher = NULL, *error = NULL;
+
 	// Loop until all of the bytes have been sent to the client.
 	do {
 
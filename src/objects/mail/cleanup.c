@@ -23,12 +23,14 @@ void mail_destroy_header(stringer_t *header) {
  * @note	This function fixes broken line separators by making sure each \r is followed by \n and vice versa.
  * 			All Return-Path: header lines are also removed.
  * 			New lines are begun whenever the current length of any line reaches the configuration value set in magma.smtp.wrap_line_length.
- * 			The trailing dot at the end of the smtp DATA command is also stripped.
- * @note	If the original message ends with \r, it will have \n appended to it.
+ * 			Dot stuffing isn't handled here, since the SMTP DATA reader removes it, along with the terminating dot line, as the message arrives.
+ * 			A binary message body is copied verbatim, so only the header is repaired.
+ * @note	If the original message ends with \r, it will have \n appended to it, unless the body is binary.
  * @param	message		a pointer to a managed string that contains the message input, and will also store the cleaned output on success.
+ * @param	flags		MAIL_CLEANUP_BINARY if the message has a BINARYMIME body, or 0 otherwise.
  * @return	true on success or false on failure.
  */
-bool_t mail_message_cleanup(stringer_t **message) {
+bool_t mail_message_cleanup(stringer_t **message, int_t flags) {
 
 	chr_t *new, *orig;
 	stringer_t *output;
@@ -99,6 +101,15 @@ bool_t mail_message_cleanup(stringer_t **message) {
 
 	for (increment = 0; increment < length; increment++) {
 
+		// A binary body can't be repaired without corrupting it, so once the header is finished, the remainder is copied as is.
+		if (header == 3 && (flags & MAIL_CLEANUP_BINARY)) {
+			mm_copy(new, orig, length - increment);
+			used += length - increment;
+			new += length - increment;
+			orig += length - increment;
+			break;
+		}
+
 		if (header != 3) {
 
 			// Logic for detecting the end of the header.
@@ -118,18 +129,12 @@ bool_t mail_message_cleanup(stringer_t **message) {
 				header = 0;
 			}
 
-			// Look for the return path and dotstuffs.
+			// Look for the return path.
 			if (next == 1 && *orig != '\n') {
 
 				if (length - increment >= 12 && mm_cmp_ci_eq(orig, "Return-Path:", 12) == 0) {
 					skip = 1;
 				}
-				else if (length - increment >= 2 && *orig == '.' && (*(orig + 1) == '\r' || *(orig + 1) == '\n')) {
-					skip = 1;
-				}
-				else if (length - increment >= 2 && *orig == '.' && *(orig + 1) == '.') {
-					skip = 2;
-				}
 				else if (skip != 0) {
 					skip = 0;
 				}
@@ -143,23 +148,12 @@ bool_t mail_message_cleanup(stringer_t **message) {
 			}
 		}
 		else {
-			// Now were just looking for dotstuffs.
+			// A return path skip never extends past the first line of the body.
 			if (next == 1 && *orig != '\n') {
-
-				if (length - increment >= 2 && *orig == '.' && (*(orig + 1) == '\r' || *(orig + 1) == '\n')) {
-					skip = 1;
-				}
-				else if (length - increment >= 2 && *orig == '.' && *(orig + 1) == '.') {
-					skip = 2;
-				}
-				else if (skip != 0) {
-					skip = 0;
-				}
-
+				skip = 0;
 				next = 0;
 			}
 
-			// So we check the start of the next line for the return path.
 			if (next == 0 && (*orig == '\n' || *orig == '\r')) {
 				next = 1;
 			}
@@ -212,15 +206,12 @@ bool_t mail_message_cleanup(stringer_t **message) {
 			}*/
 
 		}
-		else if (skip == 2) {
-			skip = 0;
-		}
 
 		orig++;
 	}
 
 	// If the buffer ends with a carriage return add a line break.
-	if (*orig == '\r') {
+	if (*orig == '\r' && (header != 3 || !(flags & MAIL_CLEANUP_BINARY))) {
 		*new++ = '\n';
 		used++;
 	}
@@ -40,11 +40,37 @@ void mail_db_hide_message(uint64_t messagenum) {
  */
 bool_t mail_db_delete_message(uint64_t usernum, uint64_t messagenum, uint32_t size, int_t transaction) {
 
-	MYSQL_BIND parameters[2];
+	MYSQL_BIND parameters[3];
 	int64_t affected;
 
 	mm_wipe(parameters, sizeof(parameters));
 
+	// Usernum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &usernum;
+	parameters[0].is_unsigned = true;
+
+	// Messagenum
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &messagenum;
+	parameters[1].is_unsigned = true;
+
+	// Usernum
+	parameters[2].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[2].buffer_length = sizeof(uint64_t);
+	parameters[2].buffer = &usernum;
+	parameters[2].is_unsigned = true;
+
+	// Expunges advance the modification sequence of the parent folder, so clients using CONDSTORE notice the removal.
+	if (stmt_exec_affected_conn(stmts.update_folder_modseq_message, parameters, transaction) == -1) {
+		log_error("Unable to update the folder modification sequence. The user number was %lu and the message number was %lu.", usernum, messagenum);
+		return false;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+
 	// Messagenum
 	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
 	parameters[0].buffer_length = sizeof(uint64_t);
@@ -99,14 +125,21 @@ bool_t mail_db_delete_message(uint64_t usernum, uint64_t messagenum, uint32_t si
  */
 int_t mail_db_update_message_folder(uint64_t usernum, uint64_t messagenum, uint64_t source, uint64_t target, int64_t transaction) {
 
-	uint64_t result;
-	MYSQL_BIND parameters[4];
+	uint64_t result, modseq;
+	MYSQL_BIND parameters[5];
 
 	if (!usernum || !messagenum || !source || !target || transaction < 0) {
 		log_pedantic("Passed an invalid message parameter.");
 		return -1;
 	}
 
+	// The message leaves the source folder, which counts as an expunge, and arrives in the target folder with a fresh modification sequence.
+	else if (!meta_data_folder_modseq(usernum, source, transaction) || !(modseq = meta_data_folder_modseq(usernum, target, transaction))) {
+		log_pedantic("Unable to update the folder modification sequences. { user = %lu / message = %lu / source = %lu / target = %lu }",
+			usernum, messagenum, source, target);
+		return -1;
+	}
+
 	mm_wipe(parameters, sizeof(parameters));
 
 	// Target Folder
@@ -115,24 +148,30 @@ int_t mail_db_update_message_folder(uint64_t usernum, uint64_t messagenum, uint6
 	parameters[0].buffer = &target;
 	parameters[0].is_unsigned = true;
 
-	// Messagenum
+	// Modification Sequence
 	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
 	parameters[1].buffer_length = sizeof(uint64_t);
-	parameters[1].buffer = &messagenum;
+	parameters[1].buffer = &modseq;
 	parameters[1].is_unsigned = true;
 
-	// Usernum
+	// Messagenum
 	parameters[2].buffer_type = MYSQL_TYPE_LONGLONG;
 	parameters[2].buffer_length = sizeof(uint64_t);
-	parameters[2].buffer = &usernum;
+	parameters[2].buffer = &messagenum;
 	parameters[2].is_unsigned = true;
 
-	// Source Folder
+	// Usernum
 	parameters[3].buffer_type = MYSQL_TYPE_LONGLONG;
 	parameters[3].buffer_length = sizeof(uint64_t);
-	parameters[3].buffer = &source;
+	parameters[3].buffer = &usernum;
 	parameters[3].is_unsigned = true;
 
+	// Source Folder
+	parameters[4].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[4].buffer_length = sizeof(uint64_t);
+	parameters[4].buffer = &source;
+	parameters[4].is_unsigned = true;
+
 	// Since the result is unsigned, an error is indicated by a return value of -1.
 	if ((result = stmt_exec_affected_conn(stmts.update_message_folder, parameters, transaction)) != 1 && result == -1) {
 		log_pedantic("An error occurred while trying to move a message into a different folder. { user = %lu / message = %lu / source = %lu / "
@@ -157,6 +196,78 @@ int_t mail_db_update_message_folder(uint64_t usernum, uint64_t messagenum, uint6
 	return 1;
 }
 
+/**
+ * @brief	Update the parent folder of a contiguous range of mail messages in the database, using a single statement.
+ * @note	Every visible message in the source folder with a message number inside the range is moved, so the caller must make sure the
+ * 			range doesn't span any messages that should stay behind. The folder modification sequences are left for the caller to update.
+ * @param	usernum		the numerical id of the user to whom the mail messages belong.
+ * @param	source		the numerical id of the parent folder in which the mail messages currently reside.
+ * @param	target		the numerical id of the destination folder which is to be the new parent of the mail messages.
+ * @param	first		the lowest message number in the range.
+ * @param	last		the highest message number in the range.
+ * @param	modseq		the modification sequence assigned to each of the moved messages.
+ * @param	transaction	a transaction id for the database operation, in case the caller needs to roll back changes on failure.
+ * @return	-1 on failure, or the number of messages that were moved.
+ */
+int64_t mail_db_update_message_folders(uint64_t usernum, uint64_t source, uint64_t target, uint64_t first, uint64_t last, uint64_t modseq,
+	int64_t transaction) {
+
+	int64_t result;
+	MYSQL_BIND parameters[6];
+
+	if (!usernum || !source || !target || !first || last < first || !modseq || transaction < 0) {
+		log_pedantic("Passed an invalid message range parameter.");
+		return -1;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Target Folder
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &target;
+	parameters[0].is_unsigned = true;
+
+	// Modification Sequence
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &modseq;
+	parameters[1].is_unsigned = true;
+
+	// Usernum
+	parameters[2].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[2].buffer_length = sizeof(uint64_t);
+	parameters[2].buffer = &usernum;
+	parameters[2].is_unsigned = true;
+
+	// Source Folder
+	parameters[3].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[3].buffer_length = sizeof(uint64_t);
+	parameters[3].buffer = &source;
+	parameters[3].is_unsigned = true;
+
+	// First Messagenum
+	parameters[4].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[4].buffer_length = sizeof(uint64_t);
+	parameters[4].buffer = &first;
+	parameters[4].is_unsigned = true;
+
+	// Last Messagenum
+	parameters[5].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[5].buffer_length = sizeof(uint64_t);
+	parameters[5].buffer = &last;
+	parameters[5].is_unsigned = true;
+
+	if ((result = stmt_exec_affected_conn(stmts.update_message_folder_range, parameters, transaction)) < 0) {
+		log_pedantic("An error occurred while trying to move a range of messages into a different folder. { user = %lu / source = %lu / "
+			"target = %lu / first = %lu / last = %lu / error = %u = %s }", usernum, source, target, first, last,
+			mysql_stmt_errno_d(pool_get_obj(sql_pool, transaction)), mysql_stmt_error_d(pool_get_obj(sql_pool, transaction)));
+		return -1;
+	}
+
+	return result;
+}
+
 /**
  * @brief	Insert a mail message into the database.
  * @note	This function will also update the user's storage quota information in the database.
@@ -171,13 +282,17 @@ int_t mail_db_update_message_folder(uint64_t usernum, uint64_t messagenum, uint6
  */
 uint64_t mail_db_insert_message(uint64_t usernum, uint64_t foldernum, uint32_t status, uint32_t size, uint64_t signum, uint64_t sigkey, int_t transaction) {
 
-	uint64_t result;
-	MYSQL_BIND parameters[7];
+	uint64_t result, modseq;
+	MYSQL_BIND parameters[8];
 
 	if (!usernum || !foldernum || !size || transaction < 0) {
 		log_pedantic("Passed an invalid message parameter.");
 		return 0;
 	}
+	else if (!(modseq = meta_data_folder_modseq(usernum, foldernum, transaction))) {
+		log_pedantic("Unable to update the folder modification sequence. { user = %lu / folder = %lu }", usernum, foldernum);
+		return 0;
+	}
 
 	mm_wipe(parameters, sizeof(parameters));
 
@@ -234,6 +349,12 @@ uint64_t mail_db_insert_message(uint64_t usernum, uint64_t foldernum, uint32_t s
 		parameters[6].is_null = ISNULL(true);
 	}
 
+	// Modification Sequence
+	parameters[7].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[7].buffer_length = sizeof(uint64_t);
+	parameters[7].buffer = &modseq;
+	parameters[7].is_unsigned = true;
+
 	// Execute the insert.
 	if (!(result = stmt_insert_conn(stmts.insert_message, parameters, transaction))) {
 
@@ -303,13 +424,17 @@ uint64_t mail_db_insert_message(uint64_t usernum, uint64_t foldernum, uint32_t s
  */
 uint64_t mail_db_insert_duplicate_message(uint64_t usernum, uint64_t foldernum, uint32_t status, uint32_t size, uint64_t signum, uint64_t sigkey, uint64_t created, int_t transaction) {
 
-	uint64_t result;
-	MYSQL_BIND parameters[8];
+	uint64_t result, modseq;
+	MYSQL_BIND parameters[9];
 
 	if (!usernum || !foldernum || !size || transaction < 0) {
 		log_pedantic("Passed an invalid message parameter.");
 		return 0;
 	}
+	else if (!(modseq = meta_data_folder_modseq(usernum, foldernum, transaction))) {
+		log_pedantic("Unable to update the folder modification sequence. { user = %lu / folder = %lu }", usernum, foldernum);
+		return 0;
+	}
 
 	mm_wipe(parameters, sizeof(parameters));
 
@@ -366,12 +491,18 @@ uint64_t mail_db_insert_duplicate_message(uint64_t usernum, uint64_t foldernum,
 		parameters[6].is_null = ISNULL(true);
 	}
 
-	// Created
+	// Modification Sequence
 	parameters[7].buffer_type = MYSQL_TYPE_LONGLONG;
 	parameters[7].buffer_length = sizeof(uint64_t);
-	parameters[7].buffer = &created;
+	parameters[7].buffer = &modseq;
 	parameters[7].is_unsigned = true;
 
+	// Created
+	parameters[8].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[8].buffer_length = sizeof(uint64_t);
+	parameters[8].buffer = &created;
+	parameters[8].is_unsigned = true;
+
 	// Execute the insert.
 	if (!(result = stmt_insert_conn(stmts.insert_message_duplicate, parameters, transaction))) {
 
@@ -422,3 +553,671 @@ uint64_t mail_db_insert_duplicate_message(uint64_t usernum, uint64_t foldernum,
 
 	return result;
 }
+
+/**
+ * @brief	Store the envelope summary for a message.
+ * @note	Only the carbon copy and threading fields of an existing envelope are replaced, so a summary can safely be stored for a message
+ * 			which already has one, and envelopes stored before those fields existed are completed.
+ * @param	messagenum	the numerical id of the message the envelope describes.
+ * @param	envelope	a pointer to the envelope summary to be stored.
+ * @param	transaction	the transaction id for the database operation, or -1 if the insert shouldn't be part of a transaction.
+ * @return	true if the envelope was stored, or false on failure.
+ */
+bool_t mail_db_insert_envelope(uint64_t messagenum, mail_envelope_t *envelope, int_t transaction) {
+
+	MYSQL_BIND parameters[11];
+	stringer_t *fields[10];
+
+	if (!messagenum || !envelope) {
+		log_pedantic("Passed an invalid envelope parameter.");
+		return false;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	fields[0] = envelope->from;
+	fields[1] = envelope->to;
+	fields[2] = envelope->reply_to;
+	fields[3] = envelope->return_path;
+	fields[4] = envelope->subject;
+	fields[5] = envelope->date;
+	fields[6] = envelope->snippet;
+	fields[7] = envelope->cc;
+	fields[8] = envelope->message_id;
+	fields[9] = envelope->references;
+
+	// Messagenum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &messagenum;
+	parameters[0].is_unsigned = true;
+
+	// The header fields, snippet and threading identifiers.
+	for (int_t i = 0; i < 10; i++) {
+		if (fields[i]) {
+			parameters[i + 1].buffer_type = MYSQL_TYPE_BLOB;
+			parameters[i + 1].buffer_length = st_length_get(fields[i]);
+			parameters[i + 1].buffer = st_char_get(fields[i]);
+		}
+		else {
+			parameters[i + 1].buffer_type = MYSQL_TYPE_BLOB;
+			parameters[i + 1].is_null = ISNULL(true);
+		}
+	}
+
+	if ((transaction < 0 ? stmt_exec_affected(stmts.insert_message_envelope, parameters) :
+		stmt_exec_affected_conn(stmts.insert_message_envelope, parameters, transaction)) == -1) {
+		log_pedantic("An error occurred while inserting the message envelope. { messagenum = %lu }", messagenum);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Copy the envelope summary of a message to a duplicate of that message.
+ * @param	messagenum	the numerical id of the new message.
+ * @param	original	the numerical id of the message being copied.
+ * @param	transaction	the transaction id for the database operation.
+ * @return	true if the envelope was copied, or if the original message had no envelope, or false on failure.
+ */
+bool_t mail_db_insert_duplicate_envelope(uint64_t messagenum, uint64_t original, int_t transaction) {
+
+	MYSQL_BIND parameters[2];
+
+	if (!messagenum || !original || transaction < 0) {
+		log_pedantic("Passed an invalid envelope parameter.");
+		return false;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Messagenum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &messagenum;
+	parameters[0].is_unsigned = true;
+
+	// Original
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &original;
+	parameters[1].is_unsigned = true;
+
+	if (stmt_exec_affected_conn(stmts.insert_message_envelope_duplicate, parameters, transaction) == -1) {
+		log_pedantic("An error occurred while copying the message envelope. { messagenum = %lu / original = %lu }", messagenum, original);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Fetch the envelope summaries for every message in a folder, using a single query.
+ * @note	Messages stored before envelopes were introduced, or which are encrypted, won't have an entry in the result. Envelopes stored
+ * 			before the carbon copy and threading fields were introduced are returned with the partial flag set.
+ * @param	usernum		the numerical id of the user who owns the folder.
+ * @param	foldernum	the numerical id of the folder.
+ * @return	NULL on failure, or an index of mail envelopes keyed by message number.
+ */
+inx_t * mail_db_fetch_envelopes(uint64_t usernum, uint64_t foldernum) {
+
+	row_t *row;
+	table_t *result;
+	inx_t *output;
+	mail_envelope_t *envelope;
+	MYSQL_BIND parameters[2];
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Usernum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &usernum;
+	parameters[0].is_unsigned = true;
+
+	// Foldernum
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &foldernum;
+	parameters[1].is_unsigned = true;
+
+	if (!(output = inx_alloc(M_INX_TREE, &mail_envelope_free))) {
+		log_pedantic("Unable to allocate an index for the message envelopes.");
+		return NULL;
+	}
+	else if (!(result = stmt_get_result(stmts.select_message_envelopes, parameters))) {
+		inx_free(output);
+		return NULL;
+	}
+
+	while ((row = res_row_next(result))) {
+
+		if (!(key.val.u64 = res_field_uint64(row, 0)) || !(envelope = mm_alloc(sizeof(mail_envelope_t)))) {
+			continue;
+		}
+
+		envelope->from = res_field_string(row, 1);
+		envelope->to = res_field_string(row, 2);
+		envelope->reply_to = res_field_string(row, 3);
+		envelope->return_path = res_field_string(row, 4);
+		envelope->subject = res_field_string(row, 5);
+		envelope->date = res_field_string(row, 6);
+		envelope->snippet = res_field_string(row, 7);
+		envelope->cc = res_field_string(row, 8);
+		envelope->message_id = res_field_string(row, 9);
+		envelope->references = res_field_string(row, 10);
+		envelope->partial = !res_field_uint8(row, 11);
+
+		if (!inx_insert(output, key, envelope)) {
+			mail_envelope_free(envelope);
+		}
+	}
+
+	res_table_free(result);
+
+	return output;
+}
+
+/**
+ * @brief	Store the MIME structure of a message, replacing any structure already stored for the message.
+ * @param	messagenum	the numerical id of the message the structure describes.
+ * @param	structure	a pointer to the message structure to be stored.
+ * @return	true if the structure was stored, or false on failure.
+ */
+bool_t mail_db_insert_structure(uint64_t messagenum, mail_structure_t *structure) {
+
+	uint64_t length;
+	stringer_t *parts;
+	MYSQL_BIND parameters[4];
+
+	if (!messagenum || !structure || st_empty(structure->bodystructure)) {
+		log_pedantic("Passed an invalid structure parameter.");
+		return false;
+	}
+	else if (!(parts = mail_structure_serialize(structure))) {
+		log_pedantic("Unable to serialize the message structure. { messagenum = %lu }", messagenum);
+		return false;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+	length = structure->length;
+
+	// Messagenum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &messagenum;
+	parameters[0].is_unsigned = true;
+
+	// Length
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &length;
+	parameters[1].is_unsigned = true;
+
+	// Bodystructure
+	parameters[2].buffer_type = MYSQL_TYPE_BLOB;
+	parameters[2].buffer_length = st_length_get(structure->bodystructure);
+	parameters[2].buffer = st_char_get(structure->bodystructure);
+
+	// Parts
+	parameters[3].buffer_type = MYSQL_TYPE_BLOB;
+	parameters[3].buffer_length = st_length_get(parts);
+	parameters[3].buffer = st_char_get(parts);
+
+	if (stmt_exec_affected(stmts.insert_message_structure, parameters) == -1) {
+		log_pedantic("An error occurred while inserting the message structure. { messagenum = %lu }", messagenum);
+		st_free(parts);
+		return false;
+	}
+
+	st_free(parts);
+
+	return true;
+}
+
+/**
+ * @brief	Copy the MIME structure of a message to a duplicate of that message.
+ * @param	messagenum	the numerical id of the new message.
+ * @param	original	the numerical id of the message being copied.
+ * @param	transaction	the transaction id for the database operation.
+ * @return	true if the structure was copied, or if the original message had no stored structure, or false on failure.
+ */
+bool_t mail_db_insert_duplicate_structure(uint64_t messagenum, uint64_t original, int_t transaction) {
+
+	MYSQL_BIND parameters[2];
+
+	if (!messagenum || !original || transaction < 0) {
+		log_pedantic("Passed an invalid structure parameter.");
+		return false;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Messagenum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &messagenum;
+	parameters[0].is_unsigned = true;
+
+	// Original
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &original;
+	parameters[1].is_unsigned = true;
+
+	if (stmt_exec_affected_conn(stmts.insert_message_structure_duplicate, parameters, transaction) == -1) {
+		log_pedantic("An error occurred while copying the message structure. { messagenum = %lu / original = %lu }", messagenum, original);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Build a message structure from a result row, starting at the specified column.
+ * @param	row		the result row holding the length, bodystructure and part table columns.
+ * @param	column	the index of the length column.
+ * @return	NULL if the row doesn't hold a valid structure, or a pointer to the message structure.
+ */
+static mail_structure_t * mail_db_fetch_structure_row(row_t *row, size_t column) {
+
+	mail_structure_t *structure;
+	stringer_t *bodystructure, *parts;
+
+	if (!(bodystructure = res_field_string(row, column + 1))) {
+		return NULL;
+	}
+	else if (!(parts = res_field_string(row, column + 2))) {
+		st_free(bodystructure);
+		return NULL;
+	}
+
+	if (!(structure = mail_structure_parse(res_field_uint64(row, column), bodystructure, parts))) {
+		st_free(bodystructure);
+	}
+
+	st_free(parts);
+
+	return structure;
+}
+
+/**
+ * @brief	Fetch the stored MIME structure of a message.
+ * @param	messagenum	the numerical id of the message.
+ * @return	NULL if no structure was stored, or on failure, otherwise a pointer to the message structure.
+ */
+mail_structure_t * mail_db_fetch_structure(uint64_t messagenum) {
+
+	row_t *row;
+	table_t *result;
+	MYSQL_BIND parameters[1];
+	mail_structure_t *structure = NULL;
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Messagenum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &messagenum;
+	parameters[0].is_unsigned = true;
+
+	if (!(result = stmt_get_result(stmts.select_message_structure, parameters))) {
+		return NULL;
+	}
+
+	if ((row = res_row_next(result))) {
+		structure = mail_db_fetch_structure_row(row, 0);
+	}
+
+	res_table_free(result);
+
+	return structure;
+}
+
+/**
+ * @brief	Fetch the stored MIME structures for a range of messages in a folder, using a single query.
+ * @note	Messages which haven't been fetched since they were stored, or which are encrypted, won't have an entry in the result.
+ * @param	usernum		the numerical id of the user who owns the folder.
+ * @param	foldernum	the numerical id of the folder.
+ * @param	first		the lowest message number to include.
+ * @param	last		the highest message number to include.
+ * @return	NULL on failure, or an index of message structures keyed by message number.
+ */
+inx_t * mail_db_fetch_structures(uint64_t usernum, uint64_t foldernum, uint64_t first, uint64_t last) {
+
+	row_t *row;
+	table_t *result;
+	inx_t *output;
+	MYSQL_BIND parameters[4];
+	mail_structure_t *structure;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Usernum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &usernum;
+	parameters[0].is_unsigned = true;
+
+	// Foldernum
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &foldernum;
+	parameters[1].is_unsigned = true;
+
+	// First
+	parameters[2].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[2].buffer_length = sizeof(uint64_t);
+	parameters[2].buffer = &first;
+	parameters[2].is_unsigned = true;
+
+	// Last
+	parameters[3].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[3].buffer_length = sizeof(uint64_t);
+	parameters[3].buffer = &last;
+	parameters[3].is_unsigned = true;
+
+	if (!(output = inx_alloc(M_INX_TREE, &mail_structure_free))) {
+		log_pedantic("Unable to allocate an index for the message structures.");
+		return NULL;
+	}
+	else if (!(result = stmt_get_result(stmts.select_message_structures, parameters))) {
+		inx_free(output);
+		return NULL;
+	}
+
+	while ((row = res_row_next(result))) {
+
+		if (!(key.val.u64 = res_field_uint64(row, 0)) || !(structure = mail_db_fetch_structure_row(row, 1))) {
+			continue;
+		}
+
+		if (!inx_insert(output, key, structure)) {
+			mail_structure_free(structure);
+		}
+	}
+
+	res_table_free(result);
+
+	return output;
+}
+
+/**
+ * @brief	Store the search terms for a message in the full text index, and record that the message has been indexed.
+ * @note	The terms are written using batched inserts, and the message is only marked as indexed if every term was stored. If the term list
+ * 			was truncated, the message is recorded as indexed, so it isn't loaded again, but searches will still scan it.
+ * @param	usernum		the numerical id of the user who owns the message.
+ * @param	messagenum	the numerical id of the message the terms were extracted from.
+ * @param	terms		a pointer to the list of terms to be stored.
+ * @param	transaction	the transaction id for the database operation, or -1 if the inserts shouldn't be part of a transaction.
+ * @return	true if the terms were stored, or false on failure.
+ */
+bool_t mail_db_insert_terms(uint64_t usernum, uint64_t messagenum, mail_terms_t *terms, int_t transaction) {
+
+	size_t rows;
+	uint64_t count;
+	uint8_t truncated;
+	unsigned long lengths[MAIL_TERMS_BATCH];
+	MYSQL_BIND parameters[MAIL_TERMS_BATCH * 4];
+
+	if (!usernum || !messagenum || !terms) {
+		log_pedantic("Passed an invalid term parameter.");
+		return false;
+	}
+
+	for (size_t i = 0; i < terms->count; i += rows) {
+
+		rows = terms->count - i >= MAIL_TERMS_BATCH ? MAIL_TERMS_BATCH : 1;
+		mm_wipe(parameters, sizeof(parameters));
+
+		for (size_t j = 0; j < rows; j++) {
+
+			lengths[j] = terms->list[i + j].length;
+
+			// Usernum
+			parameters[(j * 4)].buffer_type = MYSQL_TYPE_LONGLONG;
+			parameters[(j * 4)].buffer_length = sizeof(uint64_t);
+			parameters[(j * 4)].buffer = &usernum;
+			parameters[(j * 4)].is_unsigned = true;
+
+			// Term
+			parameters[(j * 4) + 1].buffer_type = MYSQL_TYPE_STRING;
+			parameters[(j * 4) + 1].buffer_length = lengths[j];
+			parameters[(j * 4) + 1].buffer = terms->list[i + j].term;
+			parameters[(j * 4) + 1].length = &(lengths[j]);
+
+			// Messagenum
+			parameters[(j * 4) + 2].buffer_type = MYSQL_TYPE_LONGLONG;
+			parameters[(j * 4) + 2].buffer_length = sizeof(uint64_t);
+			parameters[(j * 4) + 2].buffer = &messagenum;
+			parameters[(j * 4) + 2].is_unsigned = true;
+
+			// Fields
+			parameters[(j * 4) + 3].buffer_type = MYSQL_TYPE_TINY;
+			parameters[(j * 4) + 3].buffer_length = sizeof(uint8_t);
+			parameters[(j * 4) + 3].buffer = &(terms->list[i + j].fields);
+			parameters[(j * 4) + 3].is_unsigned = true;
+		}
+
+		if ((transaction < 0 ? stmt_exec_affected(rows == MAIL_TERMS_BATCH ? stmts.insert_message_terms : stmts.insert_message_term, parameters) :
+			stmt_exec_affected_conn(rows == MAIL_TERMS_BATCH ? stmts.insert_message_terms : stmts.insert_message_term, parameters, transaction)) == -1) {
+			log_pedantic("An error occurred while inserting the message terms. { messagenum = %lu }", messagenum);
+			return false;
+		}
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+	count = terms->count;
+	truncated = terms->truncated ? 1 : 0;
+
+	// Messagenum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &messagenum;
+	parameters[0].is_unsigned = true;
+
+	// Usernum
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &usernum;
+	parameters[1].is_unsigned = true;
+
+	// Terms
+	parameters[2].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[2].buffer_length = sizeof(uint64_t);
+	parameters[2].buffer = &count;
+	parameters[2].is_unsigned = true;
+
+	// Truncated
+	parameters[3].buffer_type = MYSQL_TYPE_TINY;
+	parameters[3].buffer_length = sizeof(uint8_t);
+	parameters[3].buffer = &truncated;
+	parameters[3].is_unsigned = true;
+
+	if ((transaction < 0 ? stmt_exec_affected(stmts.insert_message_index, parameters) :
+		stmt_exec_affected_conn(stmts.insert_message_index, parameters, transaction)) == -1) {
+		log_pedantic("An error occurred while marking the message as indexed. { messagenum = %lu }", messagenum);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Copy the full text index entries of a message to a duplicate of that message.
+ * @param	messagenum	the numerical id of the new message.
+ * @param	original	the numerical id of the message being copied.
+ * @param	transaction	the transaction id for the database operation.
+ * @return	true if the entries were copied, or if the original message wasn't indexed, or false on failure.
+ */
+bool_t mail_db_insert_duplicate_terms(uint64_t messagenum, uint64_t original, int_t transaction) {
+
+	MYSQL_BIND parameters[2];
+
+	if (!messagenum || !original || transaction < 0) {
+		log_pedantic("Passed an invalid term parameter.");
+		return false;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Messagenum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &messagenum;
+	parameters[0].is_unsigned = true;
+
+	// Original
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &original;
+	parameters[1].is_unsigned = true;
+
+	if (stmt_exec_affected_conn(stmts.insert_message_terms_duplicate, parameters, transaction) == -1 ||
+		stmt_exec_affected_conn(stmts.insert_message_index_duplicate, parameters, transaction) == -1) {
+		log_pedantic("An error occurred while copying the message terms. { messagenum = %lu / original = %lu }", messagenum, original);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Read a single column of message numbers from a query result into a match list.
+ * @param	result	the query result, which is freed by this function.
+ * @return	NULL on failure, or a pointer to the match list.
+ */
+static mail_matches_t * mail_db_fetch_matches(table_t *result) {
+
+	row_t *row;
+	mail_matches_t *matches;
+
+	if (!(matches = mm_alloc(sizeof(mail_matches_t)))) {
+		log_pedantic("Unable to allocate %zu bytes for the index matches.", sizeof(mail_matches_t));
+		res_table_free(result);
+		return NULL;
+	}
+	else if (res_row_count(result) && !(matches->messages = mm_alloc(sizeof(uint64_t) * res_row_count(result)))) {
+		log_pedantic("Unable to allocate %zu bytes for the index matches.", sizeof(uint64_t) * res_row_count(result));
+		res_table_free(result);
+		mm_free(matches);
+		return NULL;
+	}
+
+	while ((row = res_row_next(result))) {
+		matches->messages[matches->count++] = res_field_uint64(row, 0);
+	}
+
+	res_table_free(result);
+
+	return matches;
+}
+
+/**
+ * @brief	Fetch the list of messages which have been added to the full text index.
+ * @param	usernum		the numerical id of the user who owns the messages.
+ * @param	foldernum	the numerical id of the folder, or 0 to include every folder.
+ * @param	complete	if true, messages whose term lists were truncated are left out, since the index can't rule them out of a search.
+ * @return	NULL on failure, or a sorted list of indexed message numbers.
+ */
+mail_matches_t * mail_db_fetch_indexed(uint64_t usernum, uint64_t foldernum, bool_t complete) {
+
+	table_t *result;
+	uint8_t filter = complete ? 1 : 0;
+	MYSQL_BIND parameters[4];
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Usernum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &usernum;
+	parameters[0].is_unsigned = true;
+
+	// Foldernum
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &foldernum;
+	parameters[1].is_unsigned = true;
+
+	parameters[2] = parameters[1];
+
+	// Complete
+	parameters[3].buffer_type = MYSQL_TYPE_TINY;
+	parameters[3].buffer_length = sizeof(uint8_t);
+	parameters[3].buffer = &filter;
+	parameters[3].is_unsigned = true;
+
+	if (!(result = stmt_get_result(stmts.select_message_indexes, parameters))) {
+		log_pedantic("Unable to fetch the list of indexed messages. { usernum = %lu / foldernum = %lu }", usernum, foldernum);
+		return NULL;
+	}
+
+	return mail_db_fetch_matches(result);
+}
+
+/**
+ * @brief	Find the messages with a term in the full text index that starts with the specified word.
+ * @note	Every suffix of a word is stored as a term, so a prefix match finds the word anywhere inside a message word, while still using
+ * 			the primary key. Terms only contain letters, digits and multibyte characters, so the word can't contain any LIKE wildcards.
+ * @param	usernum		the numerical id of the user who owns the messages.
+ * @param	foldernum	the numerical id of the folder, or 0 to search every folder.
+ * @param	fields		a mask of the MAIL_TERM_* fields the term must have appeared in.
+ * @param	term		a pointer to the lowercased word being searched for.
+ * @param	length		the length, in bytes, of the word.
+ * @return	NULL on failure, or a sorted list of matching message numbers.
+ */
+mail_matches_t * mail_db_search_terms(uint64_t usernum, uint64_t foldernum, uint8_t fields, chr_t *term, size_t length) {
+
+	table_t *result;
+	unsigned long prefix;
+	MYSQL_BIND parameters[5];
+	chr_t pattern[MAIL_TERM_LENGTH_MAX + 1];
+
+	if (!term || !length || length > MAIL_TERM_LENGTH_MAX) {
+		log_pedantic("Passed an invalid term parameter.");
+		return NULL;
+	}
+
+	mm_copy(pattern, term, length);
+	pattern[length] = '%';
+	prefix = length + 1;
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Usernum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &usernum;
+	parameters[0].is_unsigned = true;
+
+	// Term
+	parameters[1].buffer_type = MYSQL_TYPE_STRING;
+	parameters[1].buffer_length = prefix;
+	parameters[1].buffer = pattern;
+	parameters[1].length = &prefix;
+
+	// Fields
+	parameters[2].buffer_type = MYSQL_TYPE_TINY;
+	parameters[2].buffer_length = sizeof(uint8_t);
+	parameters[2].buffer = &fields;
+	parameters[2].is_unsigned = true;
+
+	// Foldernum
+	parameters[3].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[3].buffer_length = sizeof(uint64_t);
+	parameters[3].buffer = &foldernum;
+	parameters[3].is_unsigned = true;
+
+	parameters[4] = parameters[3];
+
+	if (!(result = stmt_get_result(stmts.select_message_terms, parameters))) {
+		log_pedantic("Unable to search the full text index. { usernum = %lu / foldernum = %lu }", usernum, foldernum);
+		return NULL;
+	}
+
+	return mail_db_fetch_matches(result);
+}
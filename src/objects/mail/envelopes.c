@@ -0,0 +1,268 @@
+
+/**
+ * @file /magma/objects/mail/envelopes.c
+ *
+ * @brief	Functions used to build the envelope summaries stored alongside each message, so listings don't need to load message files.
+ */
+
+#include "magma.h"
+
+/**
+ * @brief	Free a mail envelope summary.
+ * @param	envelope	a pointer to the envelope to be freed.
+ * @return	This function returns no value.
+ */
+void mail_envelope_free(mail_envelope_t *envelope) {
+
+	if (envelope) {
+		st_cleanup(envelope->from, envelope->to, envelope->reply_to, envelope->return_path);
+		st_cleanup(envelope->subject, envelope->date, envelope->snippet);
+		st_cleanup(envelope->cc, envelope->message_id, envelope->references);
+		mm_free(envelope);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Fetch a cleaned header value, truncated so it fits inside an envelope field.
+ * @param	header	a placer pointing to the message header.
+ * @param	key		a managed string containing the name of the header field to be fetched.
+ * @return	NULL if the field isn't present, or a managed string containing the cleaned field value.
+ */
+static stringer_t * mail_envelope_field(placer_t header, stringer_t *key) {
+
+	stringer_t *result;
+
+	if ((result = mail_header_fetch_cleaned(&header, key)) && st_length_get(result) > MAIL_ENVELOPE_FIELD_MAX) {
+		st_length_set(result, MAIL_ENVELOPE_FIELD_MAX);
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Locate the first plain text part of a message, searching the MIME tree depth first.
+ * @param	mime	a pointer to the MIME part to be searched.
+ * @return	NULL if no plain text part was found, or a pointer to the matching MIME part.
+ */
+static mail_mime_t * mail_envelope_text_part(mail_mime_t *mime) {
+
+	size_t count;
+	mail_mime_t *result = NULL;
+
+	if (!mime) {
+		return NULL;
+	}
+	else if (!mime->children || !(count = ar_length_get(mime->children))) {
+		return mime->type == MESSAGE_TYPE_PLAIN && !pl_empty(mime->body) ? mime : NULL;
+	}
+
+	for (size_t i = 0; i < count && !result; i++) {
+		result = mail_envelope_text_part(ar_field_ptr(mime->children, i));
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Generate a short plain text preview of a message body.
+ * @note	The first plain text part is decoded, runs of whitespace are collapsed into a single space, and the result is truncated to
+ * 			MAIL_ENVELOPE_SNIPPET_MAX bytes without splitting a UTF-8 sequence.
+ * @param	message		a managed string containing the raw message.
+ * @return	NULL if the message has no plain text content, or a managed string containing the snippet.
+ */
+stringer_t * mail_envelope_snippet(stringer_t *message) {
+
+	size_t length;
+	uchr_t *stream;
+	mail_mime_t *mime, *part;
+	stringer_t *decoded = NULL, *result = NULL;
+
+	if (st_empty(message) || !(mime = mail_mime_part(message, 1))) {
+		return NULL;
+	}
+
+	if ((part = mail_envelope_text_part(mime))) {
+
+		if (part->encoding == MESSAGE_ENCODING_QUOTED_PRINTABLE) {
+			decoded = qp_decode(&(part->body));
+		}
+		else if (part->encoding == MESSAGE_ENCODING_BASE64) {
+			decoded = base64_decode(&(part->body), NULL);
+		}
+		else {
+			decoded = st_dupe(&(part->body));
+		}
+
+	}
+
+	mail_mime_free(mime);
+
+	if (!decoded || !(result = st_alloc(MAIL_ENVELOPE_SNIPPET_MAX + 1))) {
+		st_cleanup(decoded);
+		return NULL;
+	}
+
+	stream = st_data_get(decoded);
+	length = st_length_get(decoded);
+
+	// Copy the text, collapsing whitespace and control characters into single spaces.
+	for (size_t i = 0, out = 0; i < length && out < MAIL_ENVELOPE_SNIPPET_MAX; i++, stream++) {
+
+		if (*stream <= ' ' || *stream == 0x7f) {
+			if (out && *(st_uchar_get(result) + out - 1) != ' ') {
+				*(st_uchar_get(result) + out++) = ' ';
+			}
+		}
+		else {
+			*(st_uchar_get(result) + out++) = *stream;
+		}
+
+		st_length_set(result, out);
+	}
+
+	st_free(decoded);
+
+	// If the snippet was truncated in the middle of a multibyte character, remove the partial sequence.
+	if ((length = st_length_get(result)) == MAIL_ENVELOPE_SNIPPET_MAX) {
+
+		size_t lead = length, expected = 1;
+		uchr_t *data = st_uchar_get(result);
+
+		while (lead && (data[lead - 1] & 0xC0) == 0x80) {
+			lead--;
+		}
+
+		if (lead && data[lead - 1] >= 0xC0) {
+			expected = data[lead - 1] >= 0xF0 ? 4 : data[lead - 1] >= 0xE0 ? 3 : 2;
+
+			if (lead - 1 + expected > length) {
+				st_length_set(result, lead - 1);
+			}
+		}
+	}
+
+	// Drop any trailing whitespace.
+	while ((length = st_length_get(result)) && *(st_uchar_get(result) + length - 1) == ' ') {
+		st_length_set(result, length - 1);
+	}
+
+	if (st_empty(result)) {
+		st_free(result);
+		return NULL;
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Extract the message identifiers from a Message-ID, In-Reply-To or References header value.
+ * @note	Anything outside the angle brackets, like comments or phrases, is ignored. If the list won't fit inside an envelope field, the
+ * 			oldest identifiers are dropped, since the most recent references are the ones used to thread a message.
+ * @param	value	a managed string containing the header value.
+ * @param	first	if true, only the first identifier is returned.
+ * @return	NULL if no identifiers were found, or a managed string containing the identifiers, separated by a single space.
+ */
+stringer_t * mail_envelope_identifiers(stringer_t *value, bool_t first) {
+
+	chr_t *stream;
+	size_t length, start = 0, skip;
+	bool_t open = false;
+	stringer_t *result = NULL, *trimmed;
+
+	if (st_empty(value)) {
+		return NULL;
+	}
+
+	stream = st_char_get(value);
+	length = st_length_get(value);
+
+	for (size_t i = 0; i < length && (!first || !result); i++) {
+
+		// An identifier can't contain whitespace, or another opening bracket, so either one restarts the scan.
+		if (stream[i] == '<') {
+			open = true;
+			start = i;
+		}
+		else if (open && (stream[i] == ' ' || stream[i] == '\t' || stream[i] == '\r' || stream[i] == '\n')) {
+			open = false;
+		}
+		else if (open && stream[i] == '>') {
+			open = false;
+
+			if (i - start > 1 && (!result || (result = st_append_opts(1024, result, PLACER(" ", 1)))) &&
+				!(result = st_append_opts(1024, result, PLACER(stream + start, i - start + 1)))) {
+				log_pedantic("Unable to allocate the message identifier list.");
+				return NULL;
+			}
+		}
+	}
+
+	if (result && (length = st_length_get(result)) > MAIL_ENVELOPE_FIELD_MAX) {
+
+		// Drop identifiers from the front of the list until the remainder fits.
+		stream = st_char_get(result);
+		skip = length - MAIL_ENVELOPE_FIELD_MAX;
+
+		while (skip < length && stream[skip] != ' ') {
+			skip++;
+		}
+
+		trimmed = skip + 1 < length ? st_import(stream + skip + 1, length - skip - 1) : NULL;
+		st_free(result);
+		result = trimmed;
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Build the envelope summary for a message.
+ * @param	message		a managed string containing the raw, unencrypted message.
+ * @return	NULL on failure, or a pointer to the newly allocated envelope summary, which must be freed with mail_envelope_free().
+ */
+mail_envelope_t * mail_envelope_build(stringer_t *message) {
+
+	size_t length;
+	placer_t header;
+	stringer_t *value;
+	mail_envelope_t *envelope;
+
+	if (st_empty(message) || !(length = mail_header_end(message))) {
+		return NULL;
+	}
+	else if (!(envelope = mm_alloc(sizeof(mail_envelope_t)))) {
+		log_pedantic("Unable to allocate %zu bytes for the message envelope.", sizeof(mail_envelope_t));
+		return NULL;
+	}
+
+	header = pl_init(st_data_get(message), length);
+
+	envelope->from = mail_envelope_field(header, PLACER("From", 4));
+	envelope->to = mail_envelope_field(header, PLACER("To", 2));
+	envelope->cc = mail_envelope_field(header, PLACER("Cc", 2));
+	envelope->reply_to = mail_envelope_field(header, PLACER("Reply-To", 8));
+	envelope->return_path = mail_envelope_field(header, PLACER("Return-Path", 11));
+	envelope->subject = mail_envelope_field(header, PLACER("Subject", 7));
+	envelope->date = mail_envelope_field(header, PLACER("Date", 4));
+	envelope->snippet = mail_envelope_snippet(message);
+
+	// Collect the identifiers used for threading. Messages without a References header fall back to the first In-Reply-To identifier.
+	if ((value = mail_header_fetch_cleaned(&header, PLACER("Message-ID", 10)))) {
+		envelope->message_id = mail_envelope_identifiers(value, true);
+		st_free(value);
+	}
+
+	if ((value = mail_header_fetch_cleaned(&header, PLACER("References", 10)))) {
+		envelope->references = mail_envelope_identifiers(value, false);
+		st_free(value);
+	}
+
+	if (!envelope->references && (value = mail_header_fetch_cleaned(&header, PLACER("In-Reply-To", 11)))) {
+		envelope->references = mail_envelope_identifiers(value, true);
+		st_free(value);
+	}
+
+	return envelope;
+}
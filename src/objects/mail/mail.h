@@ -11,6 +11,35 @@
 #define MAIL_MIME_RECURSION_LIMIT 16
 #define MAIL_SIGNATURES_RECURSION_LIMIT 16
 
+// The maximum length of an envelope header field, and of the message preview text.
+#define MAIL_ENVELOPE_FIELD_MAX 4096
+#define MAIL_ENVELOPE_SNIPPET_MAX 160
+
+// The message fields a search term can be found in, which are stored as a mask alongside each term.
+#define MAIL_TERM_SUBJECT 1
+#define MAIL_TERM_FROM 2
+#define MAIL_TERM_TO 4
+#define MAIL_TERM_CC 8
+#define MAIL_TERM_BCC 16
+#define MAIL_TERM_HEADER 32
+#define MAIL_TERM_BODY 64
+#define MAIL_TERM_ALL (MAIL_TERM_SUBJECT | MAIL_TERM_FROM | MAIL_TERM_TO | MAIL_TERM_CC | MAIL_TERM_BCC | MAIL_TERM_HEADER | MAIL_TERM_BODY)
+
+// Words shorter than the minimum aren't indexed, each stored suffix is cut to the maximum length, and a message never stores more than
+// MAIL_TERMS_MAX distinct terms. A message with more is flagged as truncated, and searches scan it instead.
+#define MAIL_TERM_LENGTH_MIN 2
+#define MAIL_TERM_LENGTH_MAX 32
+#define MAIL_TERMS_MAX 32768
+
+// The number of rows written by each batched term insert, which must match the INSERT_MESSAGE_TERMS query.
+#define MAIL_TERMS_BATCH 16
+
+// The longest dotted section number recorded in a message structure, which leaves room for MAIL_MIME_RECURSION_LIMIT levels of 32 bit part numbers.
+#define MAIL_STRUCTURE_SECTION_MAX 192
+
+// How a message arrived, which decides what mail_message_cleanup() repairs. A BINARYMIME body may legitimately contain bare line breaks.
+#define MAIL_CLEANUP_BINARY 1
+
 typedef struct {
 	uint64_t messagenum;
 	stringer_t *text;
@@ -44,6 +73,68 @@ typedef struct {
 	chr_t *name;
 } media_type_t;
 
+/***
+ * @struct mail_envelope_t
+ * @brief	The header fields and preview text needed to list a message, computed once when the message is stored.
+ */
+typedef struct {
+	stringer_t *from, *to, *cc, *reply_to, *return_path, *subject, *date; /* The cleaned header values, or NULL if the field was missing. */
+	stringer_t *snippet; /* A short preview of the first plain text part of the message body. */
+	stringer_t *message_id; /* The message identifier, including the angle brackets, or NULL if the message doesn't have one. */
+	stringer_t *references; /* The space separated identifiers of the messages this message replies to, oldest first, used for threading. */
+	bool_t partial; /* Set if the envelope was stored before the carbon copy and threading fields existed, so those fields are still missing. */
+} mail_envelope_t;
+
+/***
+ * @struct mail_term_t
+ * @brief	A single lowercased word from a message, along with the fields it was found in.
+ */
+typedef struct {
+	uint8_t fields, length; /* A mask of the MAIL_TERM_* fields the word appeared in, and the length of the word. */
+	chr_t term[MAIL_TERM_LENGTH_MAX]; /* The word itself, which isn't NULL terminated. */
+} mail_term_t;
+
+/***
+ * @struct mail_terms_t
+ * @brief	The sorted, distinct list of words extracted from a message, which are stored in the full text index.
+ */
+typedef struct {
+	size_t count, size; /* The number of terms in the list, and the number of slots allocated. */
+	mail_term_t *list;
+	bool_t truncated; /* Set if some of the words were dropped, so the list can't be used to rule a message out. */
+} mail_terms_t;
+
+/***
+ * @struct mail_matches_t
+ * @brief	A sorted list of message numbers returned by a full text index lookup.
+ */
+typedef struct {
+	size_t count;
+	uint64_t *messages;
+	bool_t candidates; /* Set if the matches may include false positives, which have to be confirmed by scanning the message. */
+} mail_matches_t;
+
+/***
+ * @struct mail_part_t
+ * @brief	The location of a single MIME part, stored as offsets into the message text, so the part can be extracted without parsing.
+ */
+typedef struct {
+	chr_t section[MAIL_STRUCTURE_SECTION_MAX]; /* The dotted IMAP section number of the part, which is empty for the message as a whole. */
+	size_t header_offset, header_length; /* The location of the part header. */
+	size_t body_offset, body_length; /* The location of the part body. */
+} mail_part_t;
+
+/***
+ * @struct mail_structure_t
+ * @brief	The parsed MIME structure of a message, computed once and reused for BODYSTRUCTURE responses and part extraction.
+ */
+typedef struct {
+	size_t length; /* The length of the message text the offsets refer to, which is used to detect a structure that no longer matches. */
+	stringer_t *bodystructure; /* The serialized IMAP BODYSTRUCTURE for the message. */
+	size_t count; /* The number of parts in the table, including the entry for the message as a whole. */
+	mail_part_t *parts; /* The part table, which always begins with the entry for the message as a whole. */
+} mail_structure_t;
+
 /// cache.c
 void          mail_cache_destroy(void *holder);
 stringer_t *  mail_cache_get(uint64_t messagenum);
@@ -55,7 +146,7 @@ void          mail_cache_thread_stop(void);
 
 /// cleanup.c
 void          mail_destroy_header(stringer_t *header);
-bool_t        mail_message_cleanup(stringer_t **message);
+bool_t        mail_message_cleanup(stringer_t **message, int_t flags);
 
 /// counters.c
 uint32_t      mail_count_received(stringer_t *message);
@@ -63,10 +154,28 @@ size_t        mail_header_end(stringer_t *message);
 
 /// datatier.c
 bool_t        mail_db_delete_message(uint64_t usernum, uint64_t messagenum, uint32_t size, int_t transaction);
+inx_t *       mail_db_fetch_envelopes(uint64_t usernum, uint64_t foldernum);
+mail_matches_t *  mail_db_fetch_indexed(uint64_t usernum, uint64_t foldernum, bool_t complete);
+mail_structure_t *  mail_db_fetch_structure(uint64_t messagenum);
+inx_t *       mail_db_fetch_structures(uint64_t usernum, uint64_t foldernum, uint64_t first, uint64_t last);
 void          mail_db_hide_message(uint64_t messagenum);
+bool_t        mail_db_insert_duplicate_envelope(uint64_t messagenum, uint64_t original, int_t transaction);
 uint64_t      mail_db_insert_duplicate_message(uint64_t usernum, uint64_t foldernum, uint32_t status, uint32_t size, uint64_t signum, uint64_t sigkey, uint64_t created, int_t transaction);
+bool_t        mail_db_insert_duplicate_structure(uint64_t messagenum, uint64_t original, int_t transaction);
+bool_t        mail_db_insert_duplicate_terms(uint64_t messagenum, uint64_t original, int_t transaction);
+bool_t        mail_db_insert_envelope(uint64_t messagenum, mail_envelope_t *envelope, int_t transaction);
 uint64_t      mail_db_insert_message(uint64_t usernum, uint64_t foldernum, uint32_t status, uint32_t size, uint64_t signum, uint64_t sigkey, int_t transaction);
+bool_t        mail_db_insert_structure(uint64_t messagenum, mail_structure_t *structure);
+bool_t        mail_db_insert_terms(uint64_t usernum, uint64_t messagenum, mail_terms_t *terms, int_t transaction);
+mail_matches_t *  mail_db_search_terms(uint64_t usernum, uint64_t foldernum, uint8_t fields, chr_t *term, size_t length);
 int_t         mail_db_update_message_folder(uint64_t usernum, uint64_t messagenum, uint64_t source, uint64_t target, int64_t transaction);
+int64_t       mail_db_update_message_folders(uint64_t usernum, uint64_t source, uint64_t target, uint64_t first, uint64_t last, uint64_t modseq, int64_t transaction);
+
+/// envelopes.c
+mail_envelope_t *  mail_envelope_build(stringer_t *message);
+void               mail_envelope_free(mail_envelope_t *envelope);
+stringer_t *       mail_envelope_snippet(stringer_t *message);
+stringer_t *       mail_envelope_identifiers(stringer_t *value, bool_t first);
 
 /// headers.c
 void          mail_add_forward_headers(server_t *server, stringer_t **message, stringer_t *id, int_t mark, uint64_t signum, uint64_t sigkey);
@@ -140,6 +249,24 @@ stringer_t *  mail_insert_chunk_text(server_t *server, stringer_t *message, stri
 int_t         mail_modify_part(server_t *server, mail_message_t *message, stringer_t *part, uint64_t signum, uint64_t sigkey, int_t disposition, int_t recursion);
 void          mail_signature_add(mail_message_t *message, server_t *server, uint64_t signum, uint64_t sigkey, int_t disposition);
 
+/// structures.c
+mail_structure_t *  mail_structure_build(mail_mime_t *mime, stringer_t *text, stringer_t *bodystructure);
+void                mail_structure_free(mail_structure_t *structure);
+mail_mime_t *       mail_structure_mime(mail_structure_t *structure, mail_part_t *part, stringer_t *text, mail_mime_t *output);
+mail_structure_t *  mail_structure_parse(size_t length, stringer_t *bodystructure, stringer_t *parts);
+mail_part_t *       mail_structure_part(mail_structure_t *structure, placer_t section);
+stringer_t *        mail_structure_serialize(mail_structure_t *structure);
+
+/// terms.c
+bool_t            mail_matches_find(mail_matches_t *matches, uint64_t messagenum);
+void              mail_matches_free(mail_matches_t *matches);
+size_t            mail_terms_backfill(meta_user_t *user, uint64_t foldernum, size_t limit);
+mail_terms_t *    mail_terms_build(stringer_t *message);
+bool_t            mail_terms_conclusive(stringer_t *value);
+void              mail_terms_free(mail_terms_t *terms);
+mail_terms_t *    mail_terms_query(stringer_t *value);
+mail_matches_t *  mail_terms_search(uint64_t usernum, uint64_t foldernum, uint8_t fields, stringer_t *value);
+
 /// store_message.c
 uint64_t   mail_copy_message(uint64_t usernum, uint64_t original, chr_t *server, uint32_t size, uint64_t foldernum, uint32_t status, uint64_t signum, uint64_t sigkey, uint64_t created);
 int_t      mail_move_message(uint64_t usernum, uint64_t messagenum, uint64_t source, uint64_t target);
@@ -107,6 +107,8 @@ uint64_t mail_store_message(uint64_t usernum, prime_t *signet, uint64_t foldernu
 	bool_t store_result;
 	compress_t *reduced = NULL;
 	stringer_t *encrypted = NULL;
+	mail_terms_t *terms = NULL;
+	mail_envelope_t *envelope = NULL;
 	int64_t transaction = -1, result = 0;
 	uint8_t flags = 0;
 
@@ -128,12 +130,23 @@ uint64_t mail_store_message(uint64_t usernum, prime_t *signet, uint64_t foldernu
 		}
 
 		flags |= FMESSAGE_OPT_COMPRESSED;
-	}
 
+		// Summarize the message so listings don't have to load it from disk. Encrypted messages are never summarized.
+		if (!(envelope = mail_envelope_build(message))) {
+			log_pedantic("Unable to build the message envelope summary.");
+		}
+
+		// Extract the words used by the full text index, so searches don't have to load the message either.
+		if (!(terms = mail_terms_build(message))) {
+			log_pedantic("Unable to build the message search terms.");
+		}
+	}
 
 	// Begin the transaction.
 	if ((transaction = tran_start()) < 0) {
 		log_error("Could not start a transaction. { transaction = %li }", transaction);
+		mail_envelope_free(envelope);
+		mail_terms_free(terms);
 		compress_cleanup(reduced);
 		prime_cleanup(encrypted);
 		return 0;
@@ -143,11 +156,26 @@ uint64_t mail_store_message(uint64_t usernum, prime_t *signet, uint64_t foldernu
 	if ((messagenum = mail_db_insert_message(usernum, foldernum, *status, st_length_int(message), signum, sigkey, transaction)) == 0) {
 		log_pedantic("Could not create a record in the database. { mail_db_insert_message = 0 }");
 		tran_rollback(transaction);
+		mail_envelope_free(envelope);
+		mail_terms_free(terms);
 		compress_cleanup(reduced);
 		prime_cleanup(encrypted);
 		return 0;
 	}
 
+	// A missing envelope only costs a slower listing, so failures here aren't fatal.
+	if (envelope && !mail_db_insert_envelope(messagenum, envelope, transaction)) {
+		log_pedantic("Unable to store the message envelope summary. { messagenum = %lu }", messagenum);
+	}
+
+	// Likewise, a message that isn't indexed is still found by searches, just more slowly.
+	if (terms && !mail_db_insert_terms(usernum, messagenum, terms, transaction)) {
+		log_pedantic("Unable to store the message search terms. { messagenum = %lu }", messagenum);
+	}
+
+	mail_envelope_free(envelope);
+	mail_terms_free(terms);
+
 	// Now attempt to save everything to disk.
 	store_result = mail_store_message_data(messagenum, flags, (encrypted ? encrypted :
 		PLACER((uchr_t *)reduced, compress_total_length(reduced))), &path);
@@ -229,6 +257,21 @@ uint64_t mail_copy_message(uint64_t usernum, uint64_t original, chr_t *server, u
 		return 0;
 	}
 
+	// Carry the envelope summary over to the copy.
+	if (!mail_db_insert_duplicate_envelope(messagenum, original, transaction)) {
+		log_pedantic("Unable to copy the message envelope summary. { messagenum = %lu / original = %lu }", messagenum, original);
+	}
+
+	// And the full text index entries.
+	if (!mail_db_insert_duplicate_terms(messagenum, original, transaction)) {
+		log_pedantic("Unable to copy the message search terms. { messagenum = %lu / original = %lu }", messagenum, original);
+	}
+
+	// And the cached MIME structure, since the copy is byte for byte identical.
+	if (!mail_db_insert_duplicate_structure(messagenum, original, transaction)) {
+		log_pedantic("Unable to copy the message structure. { messagenum = %lu / original = %lu }", messagenum, original);
+	}
+
 	// Build the message path.
 	if (!(copypath = mail_message_path(messagenum, NULL))) {
 		log_error("Could not build the message path.");
@@ -0,0 +1,317 @@
+
+/**
+ * @file /magma/objects/mail/structures.c
+ *
+ * @brief	Functions used to build, store and query the MIME structure of a message, so IMAP clients can retrieve the body structure
+ * 			and individual parts without the message being parsed again.
+ */
+
+#include "magma.h"
+
+/**
+ * @brief	Free a message structure.
+ * @param	structure	a pointer to the message structure to be freed.
+ * @return	This function returns no value.
+ */
+void mail_structure_free(mail_structure_t *structure) {
+
+	if (structure) {
+		st_cleanup(structure->bodystructure);
+		if (structure->parts) mm_free(structure->parts);
+		mm_free(structure);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Count the number of part table entries needed to describe a MIME tree.
+ * @note	Only multipart children are descended into, which mirrors the way IMAP section numbers are resolved.
+ * @param	mime		a pointer to the MIME part being counted.
+ * @param	recursion	the current recursion depth.
+ * @return	the number of entries needed for the part and its descendants, excluding the part itself.
+ */
+static size_t mail_structure_count(mail_mime_t *mime, uint32_t recursion) {
+
+	size_t result = 0, count;
+	mail_mime_t *child;
+
+	if (!mime || !mime->children || recursion > MAIL_MIME_RECURSION_LIMIT) {
+		return 0;
+	}
+
+	count = ar_length_get(mime->children);
+
+	for (size_t i = 0; i < count; i++) {
+		if ((child = ar_field_ptr(mime->children, i))) {
+			result += 1 + mail_structure_count(child, recursion + 1);
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Record the location of a single MIME part in a message structure.
+ * @param	structure	a pointer to the message structure being built.
+ * @param	mime		a pointer to the MIME part being recorded.
+ * @param	text		a managed string containing the message text the MIME placers point into.
+ * @param	section		a pointer to the dotted section number for the part.
+ * @param	length		the length, in bytes, of the section number.
+ * @return	true on success, or false if the section number or the part offsets were invalid.
+ */
+static bool_t mail_structure_add(mail_structure_t *structure, mail_mime_t *mime, stringer_t *text, chr_t *section, size_t length) {
+
+	mail_part_t *part = &(structure->parts[structure->count]);
+	chr_t *start = st_char_get(text), *header = pl_data_get(mime->header), *body = pl_data_get(mime->body);
+
+	if (length >= MAIL_STRUCTURE_SECTION_MAX || (header && (header < start || header + pl_length_get(mime->header) > start + st_length_get(text))) ||
+		(body && (body < start || body + pl_length_get(mime->body) > start + st_length_get(text)))) {
+		return false;
+	}
+
+	mm_copy(part->section, section, length);
+
+	if (header) {
+		part->header_offset = header - start;
+		part->header_length = pl_length_get(mime->header);
+	}
+
+	if (body) {
+		part->body_offset = body - start;
+		part->body_length = pl_length_get(mime->body);
+	}
+
+	structure->count++;
+
+	return true;
+}
+
+/**
+ * @brief	Record the children of a multipart MIME part in a message structure, recursively.
+ * @param	structure	a pointer to the message structure being built.
+ * @param	mime		a pointer to the multipart MIME part whose children are being recorded.
+ * @param	text		a managed string containing the message text the MIME placers point into.
+ * @param	prefix		a pointer to the dotted section number of the parent, or NULL for the top level.
+ * @param	recursion	the current recursion depth.
+ * @return	true on success, or false on failure.
+ */
+static bool_t mail_structure_children(mail_structure_t *structure, mail_mime_t *mime, stringer_t *text, chr_t *prefix, uint32_t recursion) {
+
+	int length;
+	size_t count;
+	mail_mime_t *child;
+	uint32_t number = 0;
+	chr_t section[MAIL_STRUCTURE_SECTION_MAX];
+
+	if (!mime->children || recursion > MAIL_MIME_RECURSION_LIMIT) {
+		return true;
+	}
+
+	count = ar_length_get(mime->children);
+
+	for (size_t i = 0; i < count; i++) {
+
+		// Section numbers follow the position of each child in the array, so a missing child still consumes a number.
+		number++;
+
+		if (!(child = ar_field_ptr(mime->children, i))) {
+			continue;
+		}
+		else if ((length = snprintf(section, MAIL_STRUCTURE_SECTION_MAX, "%s%s%u", prefix ? prefix : "", prefix ? "." : "", number)) <= 0 ||
+			!mail_structure_add(structure, child, text, section, length) || !mail_structure_children(structure, child, text, section, recursion + 1)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Build the structure of a message from its parsed MIME tree.
+ * @note	The first entry in the part table describes the message as a whole. A message which isn't multipart also gets an entry for
+ * 			section 1, with the same offsets, since IMAP treats the body of a single part message as its first part.
+ * @param	mime			a pointer to the parsed MIME tree of the message.
+ * @param	text			a managed string containing the message text the MIME placers point into.
+ * @param	bodystructure	a managed string containing the serialized IMAP BODYSTRUCTURE, which is owned by the result on success.
+ * @return	NULL on failure, or a pointer to the message structure, which must be freed with mail_structure_free().
+ */
+mail_structure_t * mail_structure_build(mail_mime_t *mime, stringer_t *text, stringer_t *bodystructure) {
+
+	size_t count;
+	mail_structure_t *structure;
+
+	if (!mime || st_empty(text) || st_empty(bodystructure)) {
+		log_pedantic("Passed an invalid structure parameter.");
+		return NULL;
+	}
+
+	count = mime->children ? mail_structure_count(mime, 1) + 1 : 2;
+
+	if (!(structure = mm_alloc(sizeof(mail_structure_t))) || !(structure->parts = mm_alloc(sizeof(mail_part_t) * count))) {
+		log_pedantic("Unable to allocate %zu bytes for the message structure.", sizeof(mail_part_t) * count);
+		if (structure) mm_free(structure);
+		return NULL;
+	}
+
+	structure->length = st_length_get(text);
+
+	if (!mail_structure_add(structure, mime, text, "", 0) || (!mime->children && !mail_structure_add(structure, mime, text, "1", 1)) ||
+		!mail_structure_children(structure, mime, text, NULL, 1)) {
+		log_pedantic("Unable to build the message structure.");
+		mail_structure_free(structure);
+		return NULL;
+	}
+
+	structure->bodystructure = bodystructure;
+
+	return structure;
+}
+
+/**
+ * @brief	Serialize the part table of a message structure, so it can be stored.
+ * @note	Each part is written on its own line as the section number followed by the header and body offsets and lengths. The message
+ * 			as a whole is written first, using section 0, which is never a valid IMAP section number.
+ * @param	structure	a pointer to the message structure being serialized.
+ * @return	NULL on failure, or a managed string containing the serialized part table.
+ */
+stringer_t * mail_structure_serialize(mail_structure_t *structure) {
+
+	stringer_t *result, *line = MANAGEDBUF(MAIL_STRUCTURE_SECTION_MAX + 128);
+
+	if (!structure || !structure->count || !(result = st_alloc_opts(MANAGED_T | JOINTED | HEAP, structure->count * 48))) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < structure->count && result; i++) {
+		st_sprint(line, "%s %zu %zu %zu %zu\n", i ? structure->parts[i].section : "0", structure->parts[i].header_offset,
+			structure->parts[i].header_length, structure->parts[i].body_offset, structure->parts[i].body_length);
+		result = st_append_opts(1024, result, line);
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Rebuild a message structure from its stored form.
+ * @param	length			the length of the message text the structure describes.
+ * @param	bodystructure	a managed string containing the serialized IMAP BODYSTRUCTURE, which is owned by the result on success.
+ * @param	parts			a managed string containing the part table, as generated by mail_structure_serialize().
+ * @return	NULL on failure, or a pointer to the message structure, which must be freed with mail_structure_free().
+ */
+mail_structure_t * mail_structure_parse(size_t length, stringer_t *bodystructure, stringer_t *parts) {
+
+	size_t count;
+	placer_t line, field;
+	mail_part_t *part;
+	mail_structure_t *structure;
+	uint64_t values[4];
+
+	if (!length || st_empty(bodystructure) || st_empty(parts) || !(count = tok_get_count_st(parts, '\n'))) {
+		return NULL;
+	}
+	else if (!(structure = mm_alloc(sizeof(mail_structure_t))) || !(structure->parts = mm_alloc(sizeof(mail_part_t) * count))) {
+		log_pedantic("Unable to allocate %zu bytes for the message structure.", sizeof(mail_part_t) * count);
+		if (structure) mm_free(structure);
+		return NULL;
+	}
+
+	structure->length = length;
+
+	for (size_t i = 0; i < count; i++) {
+
+		// The final token is empty, since every line ends with a newline.
+		if (tok_get_st(parts, '\n', i, &line) < 0 || pl_empty(line)) {
+			continue;
+		}
+
+		part = &(structure->parts[structure->count]);
+
+		if (tok_get_pl(line, ' ', 0, &field) < 0 || pl_empty(field) || pl_length_get(field) >= MAIL_STRUCTURE_SECTION_MAX ||
+			(!structure->count && st_cmp_cs_eq(&field, PLACER("0", 1)))) {
+			mail_structure_free(structure);
+			return NULL;
+		}
+		else if (structure->count) {
+			mm_copy(part->section, pl_data_get(field), pl_length_get(field));
+		}
+
+		for (int_t j = 0; j < 4; j++) {
+			if (tok_get_pl(line, ' ', j + 1, &field) < 0 || !uint64_conv_pl(field, &(values[j]))) {
+				mail_structure_free(structure);
+				return NULL;
+			}
+		}
+
+		// Reject offsets that fall outside the message, so a damaged table can never cause an out of bounds read.
+		if (values[0] > length || values[1] > length - values[0] || values[2] > length || values[3] > length - values[2]) {
+			mail_structure_free(structure);
+			return NULL;
+		}
+
+		part->header_offset = values[0];
+		part->header_length = values[1];
+		part->body_offset = values[2];
+		part->body_length = values[3];
+		structure->count++;
+	}
+
+	if (!structure->count) {
+		mail_structure_free(structure);
+		return NULL;
+	}
+
+	structure->bodystructure = bodystructure;
+
+	return structure;
+}
+
+/**
+ * @brief	Find the part table entry for an IMAP section number.
+ * @note	The entry describing the message as a whole is never returned, since it has no section number.
+ * @param	structure	a pointer to the message structure being searched.
+ * @param	section		a placer containing the dotted section number.
+ * @return	NULL if the section doesn't exist, or a pointer to the matching part table entry.
+ */
+mail_part_t * mail_structure_part(mail_structure_t *structure, placer_t section) {
+
+	if (!structure || pl_empty(section) || pl_length_get(section) >= MAIL_STRUCTURE_SECTION_MAX) {
+		return NULL;
+	}
+
+	for (size_t i = 1; i < structure->count; i++) {
+		if (ns_length_get(structure->parts[i].section) == pl_length_get(section) &&
+			!mm_cmp_cs_eq(structure->parts[i].section, pl_data_get(section), pl_length_get(section))) {
+			return &(structure->parts[i]);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief	Translate a part table entry into a MIME part that points into the message text.
+ * @note	The result has no children, boundary or type, so it can only be used to locate the header and body of the part.
+ * @param	structure	a pointer to the message structure the part belongs to.
+ * @param	part		a pointer to the part table entry.
+ * @param	text		a managed string containing the message text, which must match the length recorded in the structure.
+ * @param	output		a pointer to the MIME object which will receive the part location.
+ * @return	NULL on failure, or the output pointer on success.
+ */
+mail_mime_t * mail_structure_mime(mail_structure_t *structure, mail_part_t *part, stringer_t *text, mail_mime_t *output) {
+
+	chr_t *start;
+
+	if (!structure || !part || !output || st_empty(text) || st_length_get(text) != structure->length) {
+		return NULL;
+	}
+
+	mm_wipe(output, sizeof(mail_mime_t));
+	start = st_char_get(text);
+
+	output->header = pl_init(start + part->header_offset, part->header_length);
+	output->body = pl_init(start + part->body_offset, part->body_length);
+	output->entire = pl_init(start + part->header_offset, part->header_length + part->body_length);
+
+	return output;
+}
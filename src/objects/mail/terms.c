@@ -0,0 +1,536 @@
+/**
+ * @file /magma/objects/mail/terms.c
+ *
+ * @brief	Functions used to build and query the full text index, which lets searches find messages without loading the message files.
+ */
+
+#include "magma.h"
+
+/**
+ * @brief	Free a list of message terms.
+ * @param	terms	a pointer to the term list to be freed.
+ * @return	This function returns no value.
+ */
+void mail_terms_free(mail_terms_t *terms) {
+
+	if (terms) {
+		if (terms->list) mm_free(terms->list);
+		mm_free(terms);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Free a list of full text index matches.
+ * @param	matches	a pointer to the match list to be freed.
+ * @return	This function returns no value.
+ */
+void mail_matches_free(mail_matches_t *matches) {
+
+	if (matches) {
+		if (matches->messages) mm_free(matches->messages);
+		mm_free(matches);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Check whether a message number is part of a list of full text index matches.
+ * @param	matches		a pointer to the sorted match list.
+ * @param	messagenum	the numerical id of the message being checked.
+ * @return	true if the message is in the list, or false if it isn't.
+ */
+bool_t mail_matches_find(mail_matches_t *matches, uint64_t messagenum) {
+
+	size_t low = 0, high, middle;
+
+	if (!matches || !matches->count) {
+		return false;
+	}
+
+	high = matches->count;
+
+	while (low < high) {
+		middle = low + ((high - low) / 2);
+
+		if (matches->messages[middle] == messagenum) {
+			return true;
+		}
+		else if (matches->messages[middle] < messagenum) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief	Internal qsort() comparison function used to order terms bytewise, with shorter terms sorting first on a common prefix.
+ */
+static int mail_terms_compare(const void *one, const void *two) {
+
+	int result;
+	const mail_term_t *a = one, *b = two;
+
+	if ((result = memcmp(a->term, b->term, a->length < b->length ? a->length : b->length))) {
+		return result;
+	}
+
+	return (int)a->length - (int)b->length;
+}
+
+/**
+ * @brief	Sort a term list and merge any duplicate entries, combining their field masks.
+ * @param	terms	a pointer to the term list being compacted.
+ * @return	This function returns no value.
+ */
+static void mail_terms_compact(mail_terms_t *terms) {
+
+	size_t out = 0;
+
+	if (terms->count < 2) {
+		return;
+	}
+
+	qsort(terms->list, terms->count, sizeof(mail_term_t), mail_terms_compare);
+
+	for (size_t i = 1; i < terms->count; i++) {
+
+		if (!mail_terms_compare(&(terms->list[out]), &(terms->list[i]))) {
+			terms->list[out].fields |= terms->list[i].fields;
+		}
+		else if (++out != i) {
+			terms->list[out] = terms->list[i];
+		}
+
+	}
+
+	terms->count = out + 1;
+
+	return;
+}
+
+/**
+ * @brief	Add a word to a term list, growing the list as needed.
+ * @note	Once the list reaches its maximum size it is compacted, and words are only accepted while there are fewer than MAIL_TERMS_MAX distinct
+ * 			terms. If a word is refused, the list is flagged as truncated.
+ * @param	terms	a pointer to the term list being updated.
+ * @param	word	a pointer to the lowercased word.
+ * @param	length	the length, in bytes, of the word.
+ * @param	fields	the MAIL_TERM_* field mask describing where the word was found.
+ * @return	true if the word was added, or false if the list is full.
+ */
+static bool_t mail_terms_add(mail_terms_t *terms, chr_t *word, size_t length, uint8_t fields) {
+
+	mail_term_t *list;
+
+	if (terms->count == terms->size) {
+
+		// Before growing past the cap, collapse the duplicates and see whether that freed enough room.
+		if (terms->size >= MAIL_TERMS_MAX * 2) {
+			mail_terms_compact(terms);
+
+			if (terms->count >= MAIL_TERMS_MAX) {
+				terms->truncated = true;
+				return false;
+			}
+		}
+		else if (!(list = mm_alloc(sizeof(mail_term_t) * (terms->size ? terms->size * 2 : 256)))) {
+			log_pedantic("Unable to grow the message term list.");
+			terms->truncated = true;
+			return false;
+		}
+		else {
+
+			if (terms->list) {
+				mm_copy(list, terms->list, sizeof(mail_term_t) * terms->count);
+				mm_free(terms->list);
+			}
+
+			terms->size = terms->size ? terms->size * 2 : 256;
+			terms->list = list;
+		}
+	}
+
+	terms->list[terms->count].fields = fields;
+	terms->list[terms->count].length = length;
+	mm_copy(terms->list[terms->count].term, word, length);
+	terms->count++;
+
+	return true;
+}
+
+/**
+ * @brief	Add a word to a term list, optionally along with every one of its suffixes.
+ * @note	Storing the suffixes lets the index find a search word anywhere inside a message word using a prefix match. Each term holds at most
+ * 			MAIL_TERM_LENGTH_MAX bytes, but since a term is taken from every offset, no part of a long word is lost.
+ * @param	terms		a pointer to the term list being updated.
+ * @param	word		a pointer to the word, which may contain uppercase ASCII letters.
+ * @param	length		the length, in bytes, of the word.
+ * @param	fields		the MAIL_TERM_* field mask describing where the word was found.
+ * @param	suffixes	if true every suffix of the word is added, otherwise only the word itself.
+ * @return	true if the terms were added, or false if the list is full.
+ */
+static bool_t mail_terms_word(mail_terms_t *terms, uchr_t *word, size_t length, uint8_t fields, bool_t suffixes) {
+
+	size_t window;
+	chr_t lower[MAIL_TERM_LENGTH_MAX];
+
+	for (size_t offset = 0; offset + MAIL_TERM_LENGTH_MIN <= length; offset++) {
+
+		window = length - offset < MAIL_TERM_LENGTH_MAX ? length - offset : MAIL_TERM_LENGTH_MAX;
+
+		for (size_t i = 0; i < window; i++) {
+			lower[i] = (word[offset + i] >= 'A' && word[offset + i] <= 'Z') ? word[offset + i] + ('a' - 'A') : word[offset + i];
+		}
+
+		if (!mail_terms_add(terms, lower, window, fields)) {
+			return false;
+		}
+		else if (!suffixes) {
+			break;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Split a block of text into words, and add each one to a term list.
+ * @note	Words are runs of ASCII letters and digits, or bytes belonging to multibyte UTF-8 sequences. ASCII letters are lowercased. If
+ * 			markup is set, anything between angle brackets is skipped.
+ * @param	terms		a pointer to the term list being updated.
+ * @param	data		a pointer to the text.
+ * @param	length		the length, in bytes, of the text.
+ * @param	fields		the MAIL_TERM_* field mask assigned to every word found in the text.
+ * @param	markup		if true the text is treated as HTML, and the tags are ignored.
+ * @param	suffixes	if true every suffix of each word is added, which is how message words are stored, otherwise only the words
+ * 						themselves are added, cut to MAIL_TERM_LENGTH_MAX bytes, which is how search words are looked up.
+ * @return	false if the term list is full, or true otherwise.
+ */
+static bool_t mail_terms_tokenize(mail_terms_t *terms, uchr_t *data, size_t length, uint8_t fields, bool_t markup, bool_t suffixes) {
+
+	uchr_t c;
+	bool_t tag = false;
+	size_t start = 0, used = 0;
+
+	for (size_t i = 0; i <= length; i++) {
+
+		c = i < length ? data[i] : ' ';
+
+		if (markup && c == '<') {
+			tag = true;
+			c = ' ';
+		}
+		else if (tag) {
+			tag = c != '>';
+			c = ' ';
+		}
+
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80) {
+			if (!used) start = i;
+			used++;
+		}
+		else if (used) {
+
+			if (used >= MAIL_TERM_LENGTH_MIN && !mail_terms_word(terms, data + start, used, fields, suffixes)) {
+				return false;
+			}
+
+			used = 0;
+		}
+
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Add the words from every text part of a message body to a term list, decoding each part first.
+ * @param	terms		a pointer to the term list being updated.
+ * @param	mime		a pointer to the MIME part being indexed.
+ * @param	recursion	the current recursion depth, which is limited by MAIL_MIME_RECURSION_LIMIT.
+ * @return	false if the term list is full, or true otherwise.
+ */
+static bool_t mail_terms_mime(mail_terms_t *terms, mail_mime_t *mime, uint32_t recursion) {
+
+	size_t count;
+	bool_t result = true;
+	stringer_t *decoded = NULL;
+
+	if (!mime || recursion > MAIL_MIME_RECURSION_LIMIT) {
+		return true;
+	}
+	else if (mime->children && (count = ar_length_get(mime->children))) {
+
+		for (size_t i = 0; i < count && result; i++) {
+			result = mail_terms_mime(terms, ar_field_ptr(mime->children, i), recursion + 1);
+		}
+
+		return result;
+	}
+	else if ((mime->type != MESSAGE_TYPE_PLAIN && mime->type != MESSAGE_TYPE_HTML) || pl_empty(mime->body)) {
+		return true;
+	}
+
+	if (mime->encoding == MESSAGE_ENCODING_QUOTED_PRINTABLE) {
+		decoded = qp_decode(&(mime->body));
+	}
+	else if (mime->encoding == MESSAGE_ENCODING_BASE64) {
+		decoded = base64_decode(&(mime->body), NULL);
+	}
+
+	if (decoded) {
+		result = mail_terms_tokenize(terms, st_uchar_get(decoded), st_length_get(decoded), MAIL_TERM_BODY, mime->type == MESSAGE_TYPE_HTML, true);
+		st_free(decoded);
+	}
+	else {
+		result = mail_terms_tokenize(terms, pl_data_get(mime->body), pl_length_get(mime->body), MAIL_TERM_BODY, mime->type == MESSAGE_TYPE_HTML, true);
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Extract the distinct words from a message, so they can be stored in the full text index.
+ * @note	The addressing and subject fields are tagged individually, every word in the header is also tagged as MAIL_TERM_HEADER, and
+ * 			the decoded plain text and HTML parts are tagged as MAIL_TERM_BODY. Every suffix of each word is stored, and if the message has
+ * 			more than MAIL_TERMS_MAX distinct terms the list is flagged as truncated.
+ * @param	message		a managed string containing the raw, unencrypted message.
+ * @return	NULL on failure, or a pointer to a sorted, and possibly empty, list of distinct terms, which must be freed with mail_terms_free().
+ */
+mail_terms_t * mail_terms_build(stringer_t *message) {
+
+	size_t length;
+	mail_mime_t *mime;
+	placer_t header;
+	mail_terms_t *terms;
+	stringer_t *value;
+	struct {
+		stringer_t *name;
+		uint8_t field;
+	} fields[] = {
+		{ PLACER("Subject", 7), MAIL_TERM_SUBJECT },
+		{ PLACER("From", 4), MAIL_TERM_FROM },
+		{ PLACER("To", 2), MAIL_TERM_TO },
+		{ PLACER("Cc", 2), MAIL_TERM_CC },
+		{ PLACER("Bcc", 3), MAIL_TERM_BCC }
+	};
+
+	if (!(terms = mm_alloc(sizeof(mail_terms_t)))) {
+		log_pedantic("Unable to allocate %zu bytes for the message terms.", sizeof(mail_terms_t));
+		return NULL;
+	}
+	// An empty message yields an empty list, so it can still be recorded as indexed.
+	else if (st_empty(message)) {
+		return terms;
+	}
+
+	// Without a blank line separating the header from the body, the entire message is treated as the header.
+	if (!(length = mail_header_end(message))) {
+		length = st_length_get(message);
+	}
+
+	header = pl_init(st_data_get(message), length);
+
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		if ((value = mail_header_fetch_all(&header, fields[i].name))) {
+			mail_terms_tokenize(terms, st_uchar_get(value), st_length_get(value), fields[i].field, false, true);
+			st_free(value);
+		}
+	}
+
+	mail_terms_tokenize(terms, pl_data_get(header), pl_length_get(header), MAIL_TERM_HEADER, false, true);
+
+	if ((mime = mail_mime_part(message, 1))) {
+		mail_terms_mime(terms, mime, 1);
+		mail_mime_free(mime);
+	}
+
+	mail_terms_compact(terms);
+
+	// Any terms past the cap are dropped, so the message has to be flagged, otherwise searches would rule it out for the missing words.
+	if (terms->count > MAIL_TERMS_MAX) {
+		terms->count = MAIL_TERMS_MAX;
+		terms->truncated = true;
+	}
+
+	return terms;
+}
+
+/**
+ * @brief	Split a search value into the words used to query the full text index.
+ * @note	Words are cut to MAIL_TERM_LENGTH_MAX bytes, the same as the stored terms, so a longer word still finds its candidates.
+ * @param	value	a managed string containing the search value.
+ * @return	NULL if the value doesn't contain any indexable words, or a pointer to a sorted list of distinct words.
+ */
+mail_terms_t * mail_terms_query(stringer_t *value) {
+
+	mail_terms_t *terms;
+
+	if (st_empty(value) || !(terms = mm_alloc(sizeof(mail_terms_t)))) {
+		return NULL;
+	}
+
+	mail_terms_tokenize(terms, st_uchar_get(value), st_length_get(value), MAIL_TERM_ALL, false, false);
+	mail_terms_compact(terms);
+
+	if (!terms->count) {
+		mail_terms_free(terms);
+		return NULL;
+	}
+
+	return terms;
+}
+
+/**
+ * @brief	Determine whether the full text index can answer a search value exactly, with substring semantics.
+ * @note	Only a value made up of a single word, which fits inside a stored term, can be found exactly. Values with several words, or
+ * 			punctuation, may span term boundaries, and longer words are cut before the lookup, so any matches are only candidates.
+ * @param	value	a managed string containing the search value.
+ * @return	true if the index matches for the value are exact, or false if they need to be confirmed by scanning the message.
+ */
+bool_t mail_terms_conclusive(stringer_t *value) {
+
+	uchr_t c, *data;
+	size_t length;
+
+	if (st_empty(value) || (length = st_length_get(value)) < MAIL_TERM_LENGTH_MIN || length > MAIL_TERM_LENGTH_MAX) {
+		return false;
+	}
+
+	data = st_uchar_get(value);
+
+	for (size_t i = 0; i < length; i++) {
+		c = data[i];
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Find the messages containing every word of a search value, using the full text index.
+ * @note	Since every suffix of a message word is stored, each word is matched as a prefix of the stored terms, so a search for "port" will
+ * 			match "report" and "portable", which keeps the results consistent with the substring semantics of an IMAP SEARCH. A message without any term containing one of
+ * 			the words can't contain the value, but when the value isn't a single whole word the result is flagged as candidates only.
+ * 			Values without any indexable words, like punctuation or single characters, can't be answered by the index.
+ * @param	usernum		the numerical id of the user who owns the messages.
+ * @param	foldernum	the numerical id of the folder being searched, or 0 to search every folder.
+ * @param	fields		a mask of the MAIL_TERM_* fields the words must appear in.
+ * @param	value		a managed string containing the search value.
+ * @return	NULL if the value can't be answered using the index, or a sorted list of matching message numbers.
+ */
+mail_matches_t * mail_terms_search(uint64_t usernum, uint64_t foldernum, uint8_t fields, stringer_t *value) {
+
+	size_t out;
+	mail_terms_t *query;
+	mail_matches_t *result = NULL, *next;
+
+	if (!(query = mail_terms_query(value))) {
+		return NULL;
+	}
+
+	// Intersect the matches for each word, stopping early once the result is empty.
+	for (size_t i = 0; i < query->count && (!result || result->count); i++) {
+
+		if (!(next = mail_db_search_terms(usernum, foldernum, fields, query->list[i].term, query->list[i].length))) {
+			mail_matches_free(result);
+			mail_terms_free(query);
+			return NULL;
+		}
+		else if (!result) {
+			result = next;
+			continue;
+		}
+
+		out = 0;
+
+		for (size_t j = 0, k = 0; j < result->count && k < next->count;) {
+
+			if (result->messages[j] == next->messages[k]) {
+				result->messages[out++] = result->messages[j];
+				j++;
+				k++;
+			}
+			else if (result->messages[j] < next->messages[k]) {
+				j++;
+			}
+			else {
+				k++;
+			}
+
+		}
+
+		result->count = out;
+		mail_matches_free(next);
+	}
+
+	mail_terms_free(query);
+
+	if (result) {
+		result->candidates = !mail_terms_conclusive(value);
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Index any messages which were stored before the full text index existed.
+ * @note	The caller must hold a lock on the user object. Encrypted messages are never indexed, so no plaintext ends up in the database.
+ * 			Every message loaded counts against the limit, even if it couldn't be indexed, so a damaged message can't stall each search.
+ * @param	user		a pointer to the meta user object whose messages are being indexed.
+ * @param	foldernum	the numerical id of the folder being indexed, or 0 to index every folder.
+ * @param	limit		the maximum number of messages to load and index, or 0 for no limit.
+ * @return	the number of messages which were newly indexed.
+ */
+size_t mail_terms_backfill(meta_user_t *user, uint64_t foldernum, size_t limit) {
+
+	size_t result = 0, attempts = 0;
+	mail_terms_t *terms;
+	inx_cursor_t *cursor;
+	meta_message_t *active;
+	mail_message_t *message;
+	mail_matches_t *indexed;
+
+	if (!user || !user->messages || !(indexed = mail_db_fetch_indexed(user->usernum, foldernum, false))) {
+		return 0;
+	}
+	else if (!(cursor = inx_cursor_alloc(user->messages))) {
+		mail_matches_free(indexed);
+		return 0;
+	}
+
+	while ((!limit || attempts < limit) && (active = inx_cursor_value_next(cursor))) {
+
+		if ((foldernum && active->foldernum != foldernum) || (active->status & MAIL_STATUS_ENCRYPTED) || mail_matches_find(indexed, active->messagenum)) {
+			continue;
+		}
+
+		attempts++;
+
+		if (!(message = mail_load_message(active, user, NULL, false))) {
+			continue;
+		}
+
+		// Messages without any words still get recorded, so they aren't loaded again by the next search.
+		if ((terms = mail_terms_build(message->text)) && mail_db_insert_terms(user->usernum, active->messagenum, terms, -1)) {
+			result++;
+		}
+
+		mail_terms_free(terms);
+		mail_destroy(message);
+	}
+
+	inx_cursor_free(cursor);
+	mail_matches_free(indexed);
+
+	return result;
+}
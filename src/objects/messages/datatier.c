@@ -127,6 +127,9 @@ bool_t meta_data_fetch_messages(meta_user_t *user) {
 		return false;
 	}
 
+	// Any snapshot of the current collection is about to be stale.
+	meta_snapshot_invalidate(user);
+
 	// If we're updating an existing index, free the current collection of messages.
 	if (user->messages) {
 		inx_truncate(user->messages);
@@ -178,6 +181,7 @@ bool_t meta_data_fetch_messages(meta_user_t *user) {
 		message->signum = res_field_uint64(row, 5);
 		message->sigkey = res_field_uint64(row, 6);
 		message->created = res_field_uint64(row, 7);
+		message->modseq = res_field_uint64(row, 8);
 
 		if (!message->messagenum || !message->foldernum || !message->size || *(message->server) == '\0') {
 			log_error("One of the critical message variables was zero or NULL. {usernum = %lu}", user->usernum);
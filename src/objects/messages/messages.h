@@ -124,6 +124,7 @@ meta_message_t *  meta_message_dupe(meta_message_t *message);
 void              meta_message_free(meta_message_t *message);
 bool_t            meta_messages_copier(meta_user_t *user, meta_message_t *message, uint64_t target, uint64_t *outnum, bool_t sequences, META_LOCK_STATUS locked);
 bool_t            meta_messages_login_update(meta_user_t *user, META_LOCK_STATUS locked);
+int64_t           meta_messages_move(meta_user_t *user, inx_t *messages, uint64_t source, uint64_t target, META_LOCK_STATUS locked);
 int_t             meta_messages_mover(meta_user_t *user, meta_message_t *message, uint64_t target, bool_t lookup, bool_t sequences, META_LOCK_STATUS locked);
 int_t             meta_messages_update(meta_user_t *user, META_LOCK_STATUS locked);
 void              meta_messages_update_sequences(inx_t *folders, inx_t *messages);
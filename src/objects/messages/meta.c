@@ -146,6 +146,8 @@ bool_t meta_messages_login_update(meta_user_t *user, META_LOCK_STATUS locked) {
 		if ((output = meta_data_fetch_messages(user)) && user->folders) {
 			meta_messages_update_sequences(user->folders, user->messages);
 		}
+
+		meta_counters_rebuild(user->folders, user->messages);
 	}
 
 	// We need to build the messages table.
@@ -158,6 +160,8 @@ bool_t meta_messages_login_update(meta_user_t *user, META_LOCK_STATUS locked) {
 		if ((output = meta_data_fetch_messages(user)) && user->folders) {
 			meta_messages_update_sequences(user->folders, user->messages);
 		}
+
+		meta_counters_rebuild(user->folders, user->messages);
 	}
 
 	// Do we need to clear the lock.
@@ -200,6 +204,8 @@ int_t meta_messages_update(meta_user_t *user, META_LOCK_STATUS locked) {
 		if ((output = meta_data_fetch_messages(user)) && user->folders) {
 			meta_messages_update_sequences(user->folders, user->messages);
 		}
+
+		meta_counters_rebuild(user->folders, user->messages);
 	}
 
 	// We need to build the messages table.
@@ -213,6 +219,8 @@ int_t meta_messages_update(meta_user_t *user, META_LOCK_STATUS locked) {
 			meta_messages_update_sequences(user->folders, user->messages);
 		}
 
+		meta_counters_rebuild(user->folders, user->messages);
+
 	}
 
 	// Do we need to clear the lock.
@@ -276,6 +284,7 @@ bool_t meta_messages_copier(meta_user_t *user, meta_message_t *message, uint64_t
 
 	*outnum = new->messagenum = key.val.u64;
 	new->foldernum = target;
+	new->modseq = 0;
 
 	// Messages added to a folder should be distinguished by having the recent flag.
 	new->status = status | MAIL_STATUS_RECENT;
@@ -288,6 +297,11 @@ bool_t meta_messages_copier(meta_user_t *user, meta_message_t *message, uint64_t
 		log_error("Failed to insert message copy into user's messages.");
 		mm_free(new);
 	}
+	else {
+		meta_counters_add(user->folders, new);
+	}
+
+	meta_snapshot_invalidate(user);
 
 	// If this operation is part of a much larger one we might want to wait until the end to update the message sequence numbers.
 	if (sequences) {
@@ -352,10 +366,11 @@ int_t meta_messages_mover(meta_user_t *user, meta_message_t *message, uint64_t t
 	}
 
 	// Update the message context so it uses the new folder.
-	message->foldernum = target;
+	meta_counters_move(user->folders, message, target);
 
 	// New messages in a folder should be distinguished by the recent flag.
-	message->status |= MAIL_STATUS_RECENT;
+	meta_counters_status(user->folders, message, message->status | MAIL_STATUS_RECENT);
+	meta_snapshot_invalidate(user);
 
 	// If this operation is part of a much larger one we might want to wait until the end to update the message sequence numbers.
 	if (sequences) {
@@ -368,3 +383,175 @@ int_t meta_messages_mover(meta_user_t *user, meta_message_t *message, uint64_t t
 
 	return 1;
 }
+
+/**
+ * @brief	Move a contiguous run of messages to another folder, and verify the database agrees with the size of the run.
+ * @param	user		a pointer to the meta user object to whom the messages belong.
+ * @param	source		the numerical id of the folder currently holding the messages.
+ * @param	target		the numerical id of the folder to which the messages will be moved.
+ * @param	first		the lowest message number in the run.
+ * @param	last		the highest message number in the run.
+ * @param	count		the number of messages in the run.
+ * @param	modseq		the modification sequence assigned to the moved messages.
+ * @param	transaction	the transaction id for the database operation.
+ * @return	true on success or false on failure.
+ */
+static bool_t meta_messages_move_run(meta_user_t *user, uint64_t source, uint64_t target, uint64_t first, uint64_t last, uint64_t count,
+	uint64_t modseq, int64_t transaction) {
+
+	int64_t result;
+
+	// A mismatch means the database holds messages this context doesn't know about, so the whole move has to be abandoned.
+	if ((result = mail_db_update_message_folders(user->usernum, source, target, first, last, modseq, transaction)) < 0 || (uint64_t)result != count) {
+		log_pedantic("The message range update didn't match the number of selected messages. { user = %lu / first = %lu / last = %lu / "
+			"expected = %lu / result = %li }", user->usernum, first, last, count, result);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Move a collection of mail messages to another folder, using a single database transaction.
+ * @note	The selected messages are grouped into runs that are contiguous within the source folder, and each run is moved with a single
+ * 			statement, so moving every message in a folder only takes one update. The folder modification sequences are incremented once,
+ * 			and every moved message receives the new target folder modification sequence. Like meta_messages_mover(), the message numbers
+ * 			are preserved, and the moved messages are given the recent flag in memory.
+ * @param	user		a pointer to the meta user object to whom the messages belong.
+ * @param	messages	an inx holder with the messages to be moved, keyed by message number, which may contain copies of the meta messages.
+ * @param	source		the numerical id of the folder currently holding the messages.
+ * @param	target		the numerical id of the folder to which the messages will be moved.
+ * @param	locked		if set to META_NEED_LOCK, lock the specified meta user object for the duration of the request.
+ * @return	-1 on failure, or the number of messages that were moved.
+ */
+int64_t meta_messages_move(meta_user_t *user, inx_t *messages, uint64_t source, uint64_t target, META_LOCK_STATUS locked) {
+
+	int64_t transaction;
+	bool_t result = true;
+	inx_cursor_t *cursor;
+	meta_folder_t *folder;
+	meta_message_t *active;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+	uint64_t source_modseq = 0, target_modseq = 0, first = 0, last = 0, run = 0, moved = 0, highest;
+
+	if (!user || !messages || !source || !target || source == target) {
+		return -1;
+	}
+
+	if (locked == META_NEED_LOCK) {
+		meta_user_wlock(user);
+	}
+
+	if (!user->messages || !(cursor = inx_cursor_alloc(user->messages))) {
+
+		if (locked == META_NEED_LOCK) {
+			meta_user_unlock(user);
+		}
+
+		return -1;
+	}
+
+	// The source folder loses messages, which counts as an expunge, while the target folder gains them.
+	if ((transaction = tran_start()) < 0 || !(source_modseq = meta_data_folder_modseq(user->usernum, source, transaction)) ||
+		!(target_modseq = meta_data_folder_modseq(user->usernum, target, transaction))) {
+		log_pedantic("Unable to update the folder modification sequences. { user = %lu / source = %lu / target = %lu }", user->usernum,
+			source, target);
+
+		if (transaction >= 0) {
+			tran_rollback(transaction);
+		}
+
+		if (locked == META_NEED_LOCK) {
+			meta_user_unlock(user);
+		}
+
+		inx_cursor_free(cursor);
+		return -1;
+	}
+
+	// The user's messages are kept in message number order, so any message left behind in the source folder ends the current run.
+	while (result && (active = inx_cursor_value_next(cursor))) {
+
+		if (active->foldernum != source) {
+			continue;
+		}
+
+		key.val.u64 = active->messagenum;
+
+		if (run && (!inx_find(messages, key) || active->messagenum < last)) {
+			result = meta_messages_move_run(user, source, target, first, last, run, target_modseq, transaction);
+			moved += run;
+			run = 0;
+		}
+
+		if (inx_find(messages, key)) {
+			if (!run++) first = active->messagenum;
+			last = active->messagenum;
+		}
+
+	}
+
+	inx_cursor_free(cursor);
+
+	if (result && run) {
+		result = meta_messages_move_run(user, source, target, first, last, run, target_modseq, transaction);
+		moved += run;
+	}
+
+	if (!result || !moved) {
+		tran_rollback(transaction);
+
+		if (locked == META_NEED_LOCK) {
+			meta_user_unlock(user);
+		}
+
+		return result ? 0 : -1;
+	}
+	else if (tran_commit(transaction)) {
+		log_error("Could not commit the message move transaction. { user = %lu / source = %lu / target = %lu }", user->usernum, source, target);
+
+		if (locked == META_NEED_LOCK) {
+			meta_user_unlock(user);
+		}
+
+		return -1;
+	}
+
+	// Update the message contexts so they use the new folder.
+	highest = (folder = meta_folders_by_number(user->folders, source)) ? folder->counters.modseq : 0;
+
+	if ((cursor = inx_cursor_alloc(user->messages))) {
+
+		while ((active = inx_cursor_value_next(cursor))) {
+
+			key.val.u64 = active->messagenum;
+
+			if (active->foldernum == source && inx_find(messages, key)) {
+				meta_counters_remove(user->folders, active);
+				active->foldernum = target;
+				active->modseq = target_modseq;
+				meta_counters_add(user->folders, active);
+
+				// New messages in a folder should be distinguished by the recent flag.
+				meta_counters_status(user->folders, active, active->status | MAIL_STATUS_RECENT);
+			}
+
+		}
+
+		inx_cursor_free(cursor);
+	}
+
+	// Each removal advances the source counter, but the database only advanced it once, so the two are brought back in line.
+	if (folder) {
+		folder->counters.modseq = highest > source_modseq ? highest : source_modseq;
+	}
+
+	meta_snapshot_invalidate(user);
+	meta_messages_update_sequences(user->folders, user->messages);
+
+	if (locked == META_NEED_LOCK) {
+		meta_user_unlock(user);
+	}
+
+	return moved;
+}
@@ -0,0 +1,306 @@
+
+/**
+ * @file /magma/objects/meta/counters.c
+ *
+ * @brief	Functions used to maintain the per folder message counters, so folder status requests don't need to scan every message.
+ */
+
+#include "magma.h"
+
+/**
+ * @brief	Add or subtract the contribution of a single message to a set of folder counters.
+ * @param	counters	a pointer to the counters being updated.
+ * @param	message		a pointer to the meta message object being counted.
+ * @param	add			if true the message is added to the counters, otherwise it is removed.
+ * @return	This function returns no value.
+ */
+static void meta_counters_apply(meta_counters_t *counters, meta_message_t *message, bool_t add) {
+
+	// The visible counters match what the POP server presents, so they exclude hidden messages and those added using IMAP APPEND.
+	bool_t recent = (message->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT, unseen = (message->status & MAIL_STATUS_SEEN) != MAIL_STATUS_SEEN,
+		tagged = (message->status & MAIL_STATUS_TAGGED) == MAIL_STATUS_TAGGED, visible = !(message->status & (MAIL_STATUS_APPENDED | MAIL_STATUS_HIDDEN));
+
+	if (add) {
+		counters->messages++;
+		counters->bytes += message->size;
+		if (recent) counters->recent++;
+		if (unseen) counters->unseen++;
+		if (tagged) counters->tagged++;
+		if (visible) counters->visible++;
+		if (visible) counters->visible_bytes += message->size;
+		if (message->messagenum > counters->highest) counters->highest = message->messagenum;
+
+		// Messages that haven't been assigned a modification sequence take the next value, which mirrors the folder increment made
+		// in the database when the message was inserted.
+		if (!message->modseq) message->modseq = counters->modseq + 1;
+		if (message->modseq > counters->modseq) counters->modseq = message->modseq;
+	}
+
+	// Removals never push a counter below zero, and the highest message number and modification sequence are left alone, since
+	// neither UIDNEXT nor HIGHESTMODSEQ may move backward.
+	else {
+		counters->messages -= counters->messages ? 1 : 0;
+		counters->bytes -= counters->bytes >= message->size ? message->size : counters->bytes;
+		if (recent && counters->recent) counters->recent--;
+		if (unseen && counters->unseen) counters->unseen--;
+		if (tagged && counters->tagged) counters->tagged--;
+		if (visible && counters->visible) counters->visible--;
+		if (visible) counters->visible_bytes -= counters->visible_bytes >= message->size ? message->size : counters->visible_bytes;
+	}
+
+	return;
+}
+
+/**
+ * @brief	Count a message which has been added to a user's message collection.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	message		a pointer to the newly added meta message object.
+ * @return	This function returns no value.
+ */
+void meta_counters_add(inx_t *folders, meta_message_t *message) {
+
+	meta_folder_t *folder;
+
+	if (folders && message && (folder = meta_folders_by_number(folders, message->foldernum))) {
+		meta_counters_apply(&(folder->counters), message, true);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Discount a message which is about to be removed from a user's message collection.
+ * @note	The folder modification sequence is advanced, matching the database increment made when the message is expunged.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	message		a pointer to the meta message object being removed.
+ * @return	This function returns no value.
+ */
+void meta_counters_remove(inx_t *folders, meta_message_t *message) {
+
+	meta_folder_t *folder;
+
+	if (folders && message && (folder = meta_folders_by_number(folders, message->foldernum))) {
+		meta_counters_apply(&(folder->counters), message, false);
+		folder->counters.modseq++;
+	}
+
+	return;
+}
+
+/**
+ * @brief	Update the status flags of a message, and adjust the counters of its folder to match.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	message		a pointer to the meta message object being updated.
+ * @param	status		the new status flags for the message.
+ * @return	This function returns no value.
+ */
+void meta_counters_status(inx_t *folders, meta_message_t *message, uint32_t status) {
+
+	meta_folder_t *folder;
+
+	if (!message) {
+		return;
+	}
+	else if (!folders || !(folder = meta_folders_by_number(folders, message->foldernum))) {
+		message->status = status;
+		return;
+	}
+
+	// The flag update functions assign the new modification sequence before the status is updated here.
+	if (message->modseq > folder->counters.modseq) {
+		folder->counters.modseq = message->modseq;
+	}
+
+	if (message->status == status) {
+		return;
+	}
+
+	meta_counters_apply(&(folder->counters), message, false);
+	message->status = status;
+	meta_counters_apply(&(folder->counters), message, true);
+
+	return;
+}
+
+/**
+ * @brief	Move a message into a different folder, and update the counters of both folders.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	message		a pointer to the meta message object being moved.
+ * @param	foldernum	the numerical id of the folder the message is moving into.
+ * @return	This function returns no value.
+ */
+void meta_counters_move(inx_t *folders, meta_message_t *message, uint64_t foldernum) {
+
+	if (!message) {
+		return;
+	}
+
+	meta_counters_remove(folders, message);
+	message->foldernum = foldernum;
+	message->modseq = 0;
+	meta_counters_add(folders, message);
+
+	return;
+}
+
+/**
+ * @brief	Recalculate the counters for every folder using a full scan of the message collection.
+ * @note	This is used whenever the folders or messages are reloaded from the database. The modification sequence is seeded with
+ * 			the larger of the stored folder value and the previous counter, since HIGHESTMODSEQ may never move backward.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	messages	an inx holder containing the user's messages.
+ * @return	This function returns no value.
+ */
+void meta_counters_rebuild(inx_t *folders, inx_t *messages) {
+
+	uint64_t modseq;
+	inx_cursor_t *cursor;
+	meta_folder_t *folder;
+	meta_message_t *message;
+
+	if (!folders || !(cursor = inx_cursor_alloc(folders))) {
+		return;
+	}
+
+	while ((folder = inx_cursor_value_next(cursor))) {
+		modseq = folder->counters.modseq > folder->modseq ? folder->counters.modseq : folder->modseq;
+		mm_wipe(&(folder->counters), sizeof(meta_counters_t));
+		folder->counters.modseq = modseq;
+	}
+
+	inx_cursor_free(cursor);
+
+	if (messages && (cursor = inx_cursor_alloc(messages))) {
+
+		while ((message = inx_cursor_value_next(cursor))) {
+			meta_counters_add(folders, message);
+		}
+
+		inx_cursor_free(cursor);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Compare the maintained folder counters against a full scan of the message collection.
+ * @note	The highest message number and modification sequence are only checked as upper bounds, since the maintained values never decrease.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	messages	an inx holder containing the user's messages.
+ * @return	true if every folder's counters match the scan, or false if they have drifted.
+ */
+bool_t meta_counters_verify(inx_t *folders, inx_t *messages) {
+
+	bool_t result = true;
+	meta_counters_t scan;
+	meta_folder_t *folder;
+	meta_message_t *message;
+	inx_cursor_t *cursor_folders, *cursor_messages;
+
+	if (!folders || !(cursor_folders = inx_cursor_alloc(folders))) {
+		return true;
+	}
+
+	while (result && (folder = inx_cursor_value_next(cursor_folders))) {
+
+		mm_wipe(&scan, sizeof(meta_counters_t));
+
+		if (messages && (cursor_messages = inx_cursor_alloc(messages))) {
+
+			while ((message = inx_cursor_value_next(cursor_messages))) {
+
+				if (message->foldernum == folder->foldernum) {
+					meta_counters_apply(&scan, message, true);
+				}
+
+			}
+
+			inx_cursor_free(cursor_messages);
+		}
+
+		if (scan.messages != folder->counters.messages || scan.recent != folder->counters.recent || scan.unseen != folder->counters.unseen ||
+			scan.tagged != folder->counters.tagged || scan.bytes != folder->counters.bytes || scan.visible != folder->counters.visible ||
+			scan.visible_bytes != folder->counters.visible_bytes || scan.highest > folder->counters.highest ||
+			scan.modseq > folder->counters.modseq) {
+			log_error("The folder counters don't match the message collection. { foldernum = %lu / messages = %lu:%lu / recent = %lu:%lu / "
+				"unseen = %lu:%lu / bytes = %lu:%lu }", folder->foldernum, folder->counters.messages, scan.messages, folder->counters.recent,
+				scan.recent, folder->counters.unseen, scan.unseen, folder->counters.bytes, scan.bytes);
+			result = false;
+		}
+
+	}
+
+	inx_cursor_free(cursor_folders);
+
+	return result;
+}
+
+/**
+ * @brief	Clear the recent flag, in memory, for every message in a folder.
+ * @note	The folder counters are consulted first, so the scan is skipped entirely when the folder has no recent messages.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	messages	an inx holder containing the user's messages.
+ * @param	foldernum	the numerical id of the folder being cleared.
+ * @return	This function returns no value.
+ */
+void meta_counters_recent_clear(inx_t *folders, inx_t *messages, uint64_t foldernum) {
+
+	inx_cursor_t *cursor;
+	meta_folder_t *folder;
+	meta_message_t *active;
+
+	if ((folder = meta_folders_by_number(folders, foldernum)) && !folder->counters.recent) {
+		return;
+	}
+	else if (!(cursor = inx_cursor_alloc(messages))) {
+		return;
+	}
+
+	while ((active = inx_cursor_value_next(cursor))) {
+
+		if (active->foldernum == foldernum && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
+			meta_counters_status(folders, active, (active->status | MAIL_STATUS_RECENT) ^ MAIL_STATUS_RECENT);
+		}
+
+	}
+
+	inx_cursor_free(cursor);
+
+	return;
+}
+
+/**
+ * @brief	Sum the counters of every folder belonging to a user.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	output		a pointer to the counters object which will receive the totals.
+ * @return	This function returns no value.
+ */
+void meta_counters_total(inx_t *folders, meta_counters_t *output) {
+
+	inx_cursor_t *cursor;
+	meta_folder_t *folder;
+
+	mm_wipe(output, sizeof(meta_counters_t));
+
+	if (!folders || !(cursor = inx_cursor_alloc(folders))) {
+		return;
+	}
+
+	while ((folder = inx_cursor_value_next(cursor))) {
+		output->messages += folder->counters.messages;
+		output->recent += folder->counters.recent;
+		output->unseen += folder->counters.unseen;
+		output->tagged += folder->counters.tagged;
+		output->bytes += folder->counters.bytes;
+		output->visible += folder->counters.visible;
+		output->visible_bytes += folder->counters.visible_bytes;
+
+		if (folder->counters.highest > output->highest) {
+			output->highest = folder->counters.highest;
+		}
+	}
+
+	inx_cursor_free(cursor);
+
+	return;
+}
@@ -161,6 +161,7 @@ bool_t meta_data_fetch_folders(meta_user_t *user) {
 		folder->parent = res_field_uint64(row, 1);
 		folder->order = res_field_uint32(row, 2);
 		mm_copy(folder->name, res_field_block(row, 3), res_field_length(row, 3));
+		folder->modseq = res_field_uint64(row, 4);
 
 		if (!folder->foldernum || *(folder->name) == '\0') {
 			log_error("One of the critical message variables was zero or NULL. {usernum = %lu}", user->usernum);
@@ -724,10 +725,101 @@ inx_t * meta_data_fetch_alerts(uint64_t usernum) {
 	return alerts;
 }
 
+/**
+ * @brief	Increment the modification sequence of a message folder, and return the new value.
+ * @note	The folder row stays locked until the transaction finishes, so concurrent changes are always handed distinct values.
+ * @param	usernum		the numerical id of the user that owns the folder.
+ * @param	foldernum	the numerical id of the folder being modified.
+ * @param	transaction	the transaction id for the database operation, or -1 if the increment should use its own transaction.
+ * @return	0 on failure, or the new modification sequence of the folder on success.
+ */
+uint64_t meta_data_folder_modseq(uint64_t usernum, uint64_t foldernum, int64_t transaction) {
+
+	row_t *row;
+	table_t *result;
+	uint64_t modseq = 0;
+	int64_t connection = transaction;
+	MYSQL_BIND parameters[2];
+
+	if (!usernum || !foldernum) {
+		return 0;
+	}
+	else if (transaction < 0 && (connection = tran_start()) < 0) {
+		log_pedantic("Unable to start a transaction for the folder modification sequence. { user = %lu / folder = %lu }", usernum, foldernum);
+		return 0;
+	}
+
+	mm_wipe(parameters, sizeof(parameters));
+
+	// Foldernum
+	parameters[0].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[0].buffer_length = sizeof(uint64_t);
+	parameters[0].buffer = &foldernum;
+	parameters[0].is_unsigned = true;
+
+	// Usernum
+	parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+	parameters[1].buffer_length = sizeof(uint64_t);
+	parameters[1].buffer = &usernum;
+	parameters[1].is_unsigned = true;
+
+	if (stmt_exec_affected_conn(stmts.update_folder_modseq, parameters, connection) == 1 &&
+		(result = stmt_get_result_conn(stmts.select_folder_modseq, parameters, connection))) {
+
+		if ((row = res_row_next(result))) {
+			modseq = res_field_uint64(row, 0);
+		}
+
+		res_table_free(result);
+	}
+
+	if (!modseq) {
+		log_pedantic("Unable to increment the folder modification sequence. { user = %lu / folder = %lu }", usernum, foldernum);
+	}
+
+	if (transaction < 0 && (!modseq ? tran_rollback(connection) : tran_commit(connection))) {
+		return 0;
+	}
+
+	return modseq;
+}
+
+/**
+ * @brief	Allocate the modification sequence used for a flag update.
+ * @note	Changes to the recent flag are session state, so they never consume a modification sequence.
+ * @param	messages	an inx holder containing the collection of messages being updated.
+ * @param	usernum		the numerical id of the user to whom the target messages belong.
+ * @param	foldernum	the numerical id of the parent folder containing the messages to be updated.
+ * @param	flags		the mask of flags being updated.
+ * @param	transaction	the transaction id for the flag update.
+ * @return	0 if no modification sequence is required, or the newly allocated folder modification sequence.
+ */
+static uint64_t meta_data_flags_modseq(inx_t *messages, uint64_t usernum, uint64_t foldernum, uint32_t flags, int64_t transaction) {
+
+	bool_t found = false;
+	inx_cursor_t *cursor;
+	meta_message_t *active;
+
+	if (!(flags & ~((uint32_t)MAIL_STATUS_RECENT)) || !(cursor = inx_cursor_alloc(messages))) {
+		return 0;
+	}
+
+	while (!found && (active = inx_cursor_value_next(cursor))) {
+		if (active->foldernum == foldernum) {
+			found = true;
+		}
+	}
+
+	inx_cursor_free(cursor);
+
+	return found ? meta_data_folder_modseq(usernum, foldernum, transaction) : 0;
+}
+
 /**
  * @brief	Remove all user (non-system) flags from a collection of mail messages, and set the specified flags mask for them.
  *
  * @note	The new mask can contain both user and system flags, but only user flags will be stripped from each message initially.
+ * 			Messages whose flags change are given a new modification sequence, both in the database and in memory.
  *
  * @param	messages	an inx holder containing the collection of messages to have their flags updated.
  * @param	usernum		the numerical of the user to whom the target messages belong, for validation purposes.
@@ -738,9 +830,11 @@ inx_t * meta_data_fetch_alerts(uint64_t usernum) {
  */
 bool_t meta_data_flags_replace(inx_t *messages, uint64_t usernum, uint64_t foldernum, uint32_t flags) {
 
+	uint64_t modseq;
+	int64_t transaction;
 	inx_cursor_t *cursor;
 	meta_message_t *active;
-	MYSQL_BIND parameters[6];
+	MYSQL_BIND parameters[10];
 	uint32_t complete = MAIL_STATUS_USER_FLAGS;
 	bool_t result = true;
 
@@ -749,6 +843,14 @@ bool_t meta_data_flags_replace(inx_t *messages, uint64_t usernum, uint64_t folde
 		return false;
 	}
 
+	// The updates share a transaction, so a large collection is committed once instead of once per message.
+	else if ((transaction = tran_start()) < 0) {
+		log_pedantic("Unable to start a transaction for the message flag update. { user = %lu / folder = %lu }", usernum, foldernum);
+		return false;
+	}
+
+	modseq = meta_data_flags_modseq(messages, usernum, foldernum, flags, transaction);
+
 	// Iterate through and see if any messages have the recent flag set. Store the range.
 	if ((cursor = inx_cursor_alloc(messages))) {
 
@@ -758,46 +860,59 @@ bool_t meta_data_flags_replace(inx_t *messages, uint64_t usernum, uint64_t folde
 
 				mm_wipe(parameters, sizeof(parameters));
 
-				// Complete
+				// Flags to Clear
 				parameters[0].buffer_type = MYSQL_TYPE_LONG;
 				parameters[0].buffer_length = sizeof(uint32_t);
 				parameters[0].buffer = &complete;
 				parameters[0].is_unsigned = true;
 
-				// Complete
 				parameters[1].buffer_type = MYSQL_TYPE_LONG;
 				parameters[1].buffer_length = sizeof(uint32_t);
 				parameters[1].buffer = &complete;
 				parameters[1].is_unsigned = true;
 
-				// Replacement Flags
+				// Flags to Set
 				parameters[2].buffer_type = MYSQL_TYPE_LONG;
 				parameters[2].buffer_length = sizeof(uint32_t);
 				parameters[2].buffer = &flags;
 				parameters[2].is_unsigned = true;
 
-				// Usernum
+				// Modification Sequence
 				parameters[3].buffer_type = MYSQL_TYPE_LONGLONG;
 				parameters[3].buffer_length = sizeof(uint64_t);
-				parameters[3].buffer = &usernum;
+				parameters[3].buffer = &modseq;
 				parameters[3].is_unsigned = true;
 
+				// The modification sequence is only updated if the new flags differ from the current flags, so the flags are bound twice.
+				parameters[4] = parameters[0];
+				parameters[5] = parameters[1];
+				parameters[6] = parameters[2];
+
+				// Usernum
+				parameters[7].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[7].buffer_length = sizeof(uint64_t);
+				parameters[7].buffer = &usernum;
+				parameters[7].is_unsigned = true;
+
 				// Foldernum
-				parameters[4].buffer_type = MYSQL_TYPE_LONGLONG;
-				parameters[4].buffer_length = sizeof(uint64_t);
-				parameters[4].buffer = &foldernum;
-				parameters[4].is_unsigned = true;
+				parameters[8].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[8].buffer_length = sizeof(uint64_t);
+				parameters[8].buffer = &foldernum;
+				parameters[8].is_unsigned = true;
 
 				// Message Numbers
-				parameters[5].buffer_type = MYSQL_TYPE_LONGLONG;
-				parameters[5].buffer_length = sizeof(uint64_t);
-				parameters[5].buffer = &(active->messagenum);
-				parameters[5].is_unsigned = true;
+				parameters[9].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[9].buffer_length = sizeof(uint64_t);
+				parameters[9].buffer = &(active->messagenum);
+				parameters[9].is_unsigned = true;
 
-				if (!stmt_exec(stmts.update_message_flags_replace, parameters)) {
+				if (!stmt_exec_conn(stmts.update_message_flags_replace, parameters, transaction)) {
 					log_pedantic("Message flag replace failed. { user = %lu / message = %lu / flags = %u }", usernum, active->messagenum, flags);
 					result = false;
 				}
+				else if (modseq && (((active->status | complete) ^ complete) | flags) != active->status) {
+					active->modseq = modseq;
+				}
 
 			}
 		}
@@ -805,12 +920,19 @@ bool_t meta_data_flags_replace(inx_t *messages, uint64_t usernum, uint64_t folde
 		inx_cursor_free(cursor);
 	}
 
+	if (tran_commit(transaction)) {
+		log_pedantic("Unable to commit the message flag update. { user = %lu / folder = %lu }", usernum, foldernum);
+		result = false;
+	}
+
 	return result;
 }
 
 /**
  * @brief	Remove the specified flags mask from a collection of mail messages.
  *
+ * @note	Messages whose flags change are given a new modification sequence, both in the database and in memory.
+ *
  * @param	messages	an inx holder containing the collection of messages to have their flags removed.
  * @param	usernum		the numerical id of the user to whom the target messages belong, for validation purposes.
  * @param	foldernum	the numerical id of the parent folder containing the messages to be updated, for validation purposes.
@@ -820,9 +942,11 @@ bool_t meta_data_flags_replace(inx_t *messages, uint64_t usernum, uint64_t folde
  */
 bool_t meta_data_flags_remove(inx_t *messages, uint64_t usernum, uint64_t foldernum, uint32_t flags) {
 
+	uint64_t modseq;
+	int64_t transaction;
 	inx_cursor_t *cursor;
 	meta_message_t *active;
-	MYSQL_BIND parameters[5];
+	MYSQL_BIND parameters[7];
 	bool_t result = true;
 
 	// Sanity check.
@@ -830,6 +954,13 @@ bool_t meta_data_flags_remove(inx_t *messages, uint64_t usernum, uint64_t folder
 		return false;
 	}
 
+	else if ((transaction = tran_start()) < 0) {
+		log_pedantic("Unable to start a transaction for the message flag update. { user = %lu / folder = %lu }", usernum, foldernum);
+		return false;
+	}
+
+	modseq = meta_data_flags_modseq(messages, usernum, foldernum, flags, transaction);
+
 	// Iterate through and see if any messages have the recent flag set. Store the range.
 	if ((cursor = inx_cursor_alloc(messages))) {
 
@@ -838,40 +969,55 @@ bool_t meta_data_flags_remove(inx_t *messages, uint64_t usernum, uint64_t folder
 
 				mm_wipe(parameters, sizeof(parameters));
 
-				// Flag to Remove
+				// Flag to Check
 				parameters[0].buffer_type = MYSQL_TYPE_LONG;
 				parameters[0].buffer_length = sizeof(uint32_t);
 				parameters[0].buffer = &flags;
 				parameters[0].is_unsigned = true;
 
-				// Flag to Remove
-				parameters[1].buffer_type = MYSQL_TYPE_LONG;
-				parameters[1].buffer_length = sizeof(uint32_t);
-				parameters[1].buffer = &flags;
+				// Modification Sequence
+				parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[1].buffer_length = sizeof(uint64_t);
+				parameters[1].buffer = &modseq;
 				parameters[1].is_unsigned = true;
 
-				// Usernum
-				parameters[2].buffer_type = MYSQL_TYPE_LONGLONG;
-				parameters[2].buffer_length = sizeof(uint64_t);
-				parameters[2].buffer = &usernum;
+				// Flag to Remove
+				parameters[2].buffer_type = MYSQL_TYPE_LONG;
+				parameters[2].buffer_length = sizeof(uint32_t);
+				parameters[2].buffer = &flags;
 				parameters[2].is_unsigned = true;
 
-				// Foldernum
-				parameters[3].buffer_type = MYSQL_TYPE_LONGLONG;
-				parameters[3].buffer_length = sizeof(uint64_t);
-				parameters[3].buffer = &foldernum;
+				// Flag to Remove
+				parameters[3].buffer_type = MYSQL_TYPE_LONG;
+				parameters[3].buffer_length = sizeof(uint32_t);
+				parameters[3].buffer = &flags;
 				parameters[3].is_unsigned = true;
 
-				// Message Numbers
+				// Usernum
 				parameters[4].buffer_type = MYSQL_TYPE_LONGLONG;
-				parameters[4].buffer_length =  sizeof(uint64_t);
-				parameters[4].buffer = &(active->messagenum);
+				parameters[4].buffer_length = sizeof(uint64_t);
+				parameters[4].buffer = &usernum;
 				parameters[4].is_unsigned = true;
 
-				if (!stmt_exec(stmts.update_message_flags_remove, parameters)) {
+				// Foldernum
+				parameters[5].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[5].buffer_length = sizeof(uint64_t);
+				parameters[5].buffer = &foldernum;
+				parameters[5].is_unsigned = true;
+
+				// Message Numbers
+				parameters[6].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[6].buffer_length =  sizeof(uint64_t);
+				parameters[6].buffer = &(active->messagenum);
+				parameters[6].is_unsigned = true;
+
+				if (!stmt_exec_conn(stmts.update_message_flags_remove, parameters, transaction)) {
 					log_pedantic("Message flag removal failed. { user = %lu / message = %lu / flags = %u }", usernum, active->messagenum, flags);
 					result = false;
 				}
+				else if (modseq && (active->status & flags)) {
+					active->modseq = modseq;
+				}
 
 			}
 		}
@@ -879,12 +1025,19 @@ bool_t meta_data_flags_remove(inx_t *messages, uint64_t usernum, uint64_t folder
 		inx_cursor_free(cursor);
 	}
 
+	if (tran_commit(transaction)) {
+		log_pedantic("Unable to commit the message flag update. { user = %lu / folder = %lu }", usernum, foldernum);
+		result = false;
+	}
+
 	return result;
 }
 
 /**
  * @brief	Add the specified flags mask to a collection of mail messages.
  *
+ * @note	Messages whose flags change are given a new modification sequence, both in the database and in memory.
+ *
  * @param	messages	an inx holder containing the collection of messages to have their flags updated.
  * @param	usernum		the numerical id of the user to whom the target messages belong, for validation purposes.
  * @param	foldernum	the numerical id of the parent folder containing the messages to be updated, for validation purposes.
@@ -894,9 +1047,11 @@ bool_t meta_data_flags_remove(inx_t *messages, uint64_t usernum, uint64_t folder
  */
 bool_t meta_data_flags_add(inx_t *messages, uint64_t usernum, uint64_t foldernum, uint32_t flags) {
 
+	uint64_t modseq;
+	int64_t transaction;
 	inx_cursor_t *cursor;
 	meta_message_t *active;
-	MYSQL_BIND parameters[4];
+	MYSQL_BIND parameters[6];
 	bool_t result = true;
 
 	// Sanity check.
@@ -904,46 +1059,76 @@ bool_t meta_data_flags_add(inx_t *messages, uint64_t usernum, uint64_t foldernum
 		return false;
 	}
 
+	else if ((transaction = tran_start()) < 0) {
+		log_pedantic("Unable to start a transaction for the message flag update. { user = %lu / folder = %lu }", usernum, foldernum);
+		return false;
+	}
+
+	modseq = meta_data_flags_modseq(messages, usernum, foldernum, flags, transaction);
+
 	// Iterate through and see if any messages have the recent flag set. Store the range.
 	if ((cursor = inx_cursor_alloc(messages))) {
 
 		while ((active = inx_cursor_value_next(cursor))) {
+			if (active->foldernum == foldernum) {
+
 				mm_wipe(parameters, sizeof(parameters));
 
-				// Flag to Add
+				// Flag to Check
 				parameters[0].buffer_type = MYSQL_TYPE_LONG;
 				parameters[0].buffer_length = sizeof(uint32_t);
 				parameters[0].buffer = &flags;
 				parameters[0].is_unsigned = true;
 
-				// Usernum
+				// Modification Sequence
 				parameters[1].buffer_type = MYSQL_TYPE_LONGLONG;
 				parameters[1].buffer_length = sizeof(uint64_t);
-				parameters[1].buffer = &usernum;
+				parameters[1].buffer = &modseq;
 				parameters[1].is_unsigned = true;
 
-				// Foldernum
-				parameters[2].buffer_type = MYSQL_TYPE_LONGLONG;
-				parameters[2].buffer_length = sizeof(uint64_t);
-				parameters[2].buffer = &foldernum;
+				// Flag to Add
+				parameters[2].buffer_type = MYSQL_TYPE_LONG;
+				parameters[2].buffer_length = sizeof(uint32_t);
+				parameters[2].buffer = &flags;
 				parameters[2].is_unsigned = true;
 
-				// Message Numbers
+				// Usernum
 				parameters[3].buffer_type = MYSQL_TYPE_LONGLONG;
 				parameters[3].buffer_length = sizeof(uint64_t);
-				parameters[3].buffer = &(active->messagenum);
+				parameters[3].buffer = &usernum;
 				parameters[3].is_unsigned = true;
 
-				if (!stmt_exec(stmts.update_message_flags_add, parameters)) {
+				// Foldernum
+				parameters[4].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[4].buffer_length = sizeof(uint64_t);
+				parameters[4].buffer = &foldernum;
+				parameters[4].is_unsigned = true;
+
+				// Message Numbers
+				parameters[5].buffer_type = MYSQL_TYPE_LONGLONG;
+				parameters[5].buffer_length = sizeof(uint64_t);
+				parameters[5].buffer = &(active->messagenum);
+				parameters[5].is_unsigned = true;
+
+				if (!stmt_exec_conn(stmts.update_message_flags_add, parameters, transaction)) {
 					log_pedantic("Message flag addition failed. { user = %lu / message = %lu / flags = %u }", usernum, active->messagenum, flags);
 					result = false;
 				}
+				else if (modseq && (active->status & flags) != flags) {
+					active->modseq = modseq;
+				}
 
 			}
+		}
 
 		inx_cursor_free(cursor);
 	}
 
+	if (tran_commit(transaction)) {
+		log_pedantic("Unable to commit the message flag update. { user = %lu / folder = %lu }", usernum, foldernum);
+		result = false;
+	}
+
 	return result;
 }
 
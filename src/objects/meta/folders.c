@@ -33,15 +33,17 @@ meta_stats_tag_t * meta_folder_stats_tag_alloc(stringer_t *tag) {
 /**
  * @brief	Create a collection of meta tag stats for a set of messages.
  * @note	Each meta tag stat will contain the name of a message tag, along with the number of messages with which it was associated.
+ * @param	folders		an inx holder containing the user's folders, which is used to skip the scan if the folder has no tagged messages.
  * @param	messages	an inx holder containing the list of messages to be examined.
  * @param	folder		the numerical id of the parent folder that contains all target messages.
  * @return	NULL on failure, or an inx holder containing all of the messages' meta tag stats on success.
  */
-inx_t * meta_folders_stats_tags(inx_t *messages, uint64_t folder) {
+inx_t * meta_folders_stats_tags(inx_t *folders, inx_t *messages, uint64_t folder) {
 
 	size_t len;
 	inx_t *result;
 	inx_cursor_t *cursor;
+	meta_folder_t *parent;
 	meta_message_t *active;
 	meta_stats_tag_t *track;
 	multi_t multi = { .type = M_TYPE_STRINGER, .val.st = NULL };
@@ -51,6 +53,11 @@ inx_t * meta_folders_stats_tags(inx_t *messages, uint64_t folder) {
 		return NULL;
 	}
 
+	// If the folder counters show no tagged messages, there is nothing to scan for.
+	else if ((parent = meta_folders_by_number(folders, folder)) && !parent->counters.tagged) {
+		return result;
+	}
+
 	/// LOW: This is a very inefficient method for counting the number of times each tag appears.
 	else if ((cursor = inx_cursor_alloc(messages))) {
 
@@ -26,9 +26,14 @@ void meta_inx_remove(uint64_t usernum, META_PROTOCOL protocol) {
 	// Lock the object cache.
 	inx_lock_read(objects.meta);
 
-	// If we find the meta object, decrement the reference counter so it gets gets removed by the prune function.
+	// If we find the meta object, decrement the reference counter so it gets gets removed by the prune function. Once the last
+	// reference is released the object can't change, so we take the opportunity to update its memory estimate.
 	if ((user = inx_find(objects.meta, key))) {
 		meta_user_ref_dec(user, protocol);
+
+		if (!meta_user_ref_total(user)) {
+			obj_cache_resize(&(objects.lru.meta), &(user->cache), meta_size(user));
+		}
 	}
 
 	// Release the object cache.
@@ -62,10 +67,19 @@ meta_user_t * meta_inx_find(uint64_t usernum, META_PROTOCOL protocol) {
 			user->usernum = usernum;
 		}
 
+		// Trim the least recently used objects if the new one pushed us over budget.
+		meta_user_ref_add(user, protocol);
+		obj_cache_touch(&(objects.lru.meta), &(user->cache), user);
+		obj_cache_resize(&(objects.lru.meta), &(user->cache), meta_size(user));
+		obj_cache_evict_meta(time(NULL), OBJECT_CACHE_EVICT_SLICE);
+		inx_unlock(objects.meta);
+
+		return user;
 	}
 
-	// Add a reference.
+	// Add a reference, and move the object to the head of the cache list.
 	meta_user_ref_add(user, protocol);
+	obj_cache_touch(&(objects.lru.meta), &(user->cache), user);
 	inx_unlock(objects.meta);
 
 	return user;
@@ -18,6 +18,9 @@ void meta_free(meta_user_t *user) {
 
 	if (user) {
 
+		// Take the object off the cache list before it's released.
+		obj_cache_unlink(&(objects.lru.meta), &(user->cache));
+
 		prime_cleanup(user->prime.key);
 		prime_cleanup(user->prime.signet);
 
@@ -29,9 +32,13 @@ void meta_free(meta_user_t *user) {
 
 		st_cleanup(user->username, user->verification, user->realm.mail);
 
+		// Readers may still be holding the snapshots, so we only drop the references held by the user object.
+		meta_snapshot_discard(user);
+
 		// When read/write locking issues have been fixed, this line can be used once again.
 		rwlock_destroy(&(user->lock));
 		mutex_destroy(&(user->refs.lock));
+		mutex_destroy(&(user->snapshot.lock));
 
 		mm_free(user);
 	}
@@ -39,6 +46,31 @@ void meta_free(meta_user_t *user) {
 	return;
 }
 
+/**
+ * @brief	Estimate the amount of memory held by a meta user object.
+ * @note	The estimate reads the object's indexes without locking them, so it should only be taken while no references are held.
+ * @param	user	a pointer to the meta user object to be measured.
+ * @return	the approximate number of bytes held by the object, including its strings, messages, folders, contacts and aliases.
+ */
+size_t meta_size(meta_user_t *user) {
+
+	size_t result;
+
+	if (!user) {
+		return 0;
+	}
+
+	result = sizeof(meta_user_t) + st_length_get(user->username) + st_length_get(user->verification) + st_length_get(user->realm.mail);
+
+	if (user->messages) result += inx_count(user->messages) * (sizeof(meta_message_t) + OBJECT_CACHE_RECORD_BYTES);
+	if (user->folders) result += inx_count(user->folders) * (sizeof(meta_folder_t) + OBJECT_CACHE_RECORD_BYTES);
+	if (user->message_folders) result += inx_count(user->message_folders) * (sizeof(meta_folder_t) + OBJECT_CACHE_RECORD_BYTES);
+	if (user->aliases) result += inx_count(user->aliases) * (sizeof(meta_alias_t) + OBJECT_CACHE_RECORD_BYTES);
+	if (user->contacts) result += inx_count(user->contacts) * (sizeof(contact_t) + OBJECT_CACHE_RECORD_BYTES);
+
+	return result;
+}
+
 /**
  * @brief	Allocate and initialize a meta user object.
  *
@@ -85,6 +117,14 @@ meta_user_t * meta_alloc(void) {
 		mm_free(user);
 		return NULL;
 	}
+	else if (mutex_init(&(user->snapshot.lock), NULL) != 0) {
+		log_pedantic("Unable to initialize the user snapshot lock.");
+		mutex_destroy(&(user->refs.lock));
+		rwlock_destroy(&(user->lock));
+		rwlock_attr_destroy(&attr);
+		mm_free(user);
+		return NULL;
+	}
 
 	rwlock_attr_destroy(&attr);
 
@@ -21,13 +21,23 @@ typedef struct {
 /// alerts.c
 meta_alert_t * alert_alloc(uint64_t alertnum, stringer_t *type, stringer_t *message, uint64_t created);
 
+/// counters.c
+void     meta_counters_add(inx_t *folders, meta_message_t *message);
+void     meta_counters_move(inx_t *folders, meta_message_t *message, uint64_t foldernum);
+void     meta_counters_rebuild(inx_t *folders, inx_t *messages);
+void     meta_counters_recent_clear(inx_t *folders, inx_t *messages, uint64_t foldernum);
+void     meta_counters_remove(inx_t *folders, meta_message_t *message);
+void     meta_counters_status(inx_t *folders, meta_message_t *message, uint32_t status);
+void     meta_counters_total(inx_t *folders, meta_counters_t *output);
+bool_t   meta_counters_verify(inx_t *folders, inx_t *messages);
+
 /// folders.c
 meta_stats_tag_t *  meta_folder_stats_tag_alloc(stringer_t *tag);
 meta_folder_t *     meta_folders_by_name(inx_t *folders, stringer_t *name);
 meta_folder_t *     meta_folders_by_number(inx_t *folders, uint64_t number);
 int_t               meta_folders_children(inx_t *folders, uint64_t number);
 stringer_t *        meta_folders_name(inx_t *list, meta_folder_t *folder);
-inx_t *             meta_folders_stats_tags(inx_t *messages, uint64_t folder);
+inx_t *             meta_folders_stats_tags(inx_t *folders, inx_t *messages, uint64_t folder);
 
 /// serials.c
 bool_t     meta_user_serial_check(meta_user_t *user, uint64_t object);
@@ -53,6 +63,7 @@ uint64_t   meta_user_ref_total(meta_user_t *user);
 /// meta.c
 meta_user_t *  meta_alloc(void);
 void           meta_free(meta_user_t *user);
+size_t         meta_size(meta_user_t *user);
 int_t          meta_get(uint64_t usernum, stringer_t *username, stringer_t *master, stringer_t *verification, META_PROTOCOL protocol, META_GET get, meta_user_t **output);
 
 /// datatier.c
@@ -69,6 +80,7 @@ int_t      meta_data_fetch_user(meta_user_t *user);
 bool_t     meta_data_flags_add(inx_t *messages, uint64_t usernum, uint64_t foldernum, uint32_t flags);
 bool_t     meta_data_flags_remove(inx_t *messages, uint64_t usernum, uint64_t foldernum, uint32_t flags);
 bool_t     meta_data_flags_replace(inx_t *messages, uint64_t usernum, uint64_t foldernum, uint32_t flags);
+uint64_t   meta_data_folder_modseq(uint64_t usernum, uint64_t foldernum, int64_t transaction);
 uint64_t   meta_data_insert_folder(uint64_t usernum, stringer_t *name, uint64_t parent, uint32_t order);
 int_t      meta_data_insert_keys(uint64_t usernum, stringer_t *username, key_pair_t *input, int64_t transaction);
 int_t      meta_data_insert_shard(uint64_t usernum, uint16_t serial, stringer_t *label, stringer_t *shard, int64_t transaction);
@@ -87,6 +99,12 @@ void   meta_user_wlock(meta_user_t *user);
 meta_user_t *  meta_inx_find(uint64_t usernum, META_PROTOCOL protocol);
 void           meta_inx_remove(uint64_t usernum, META_PROTOCOL protocol);
 
+/// snapshots.c
+void               meta_snapshot_discard(meta_user_t *user);
+meta_snapshot_t *  meta_snapshot_get(meta_user_t *user);
+void               meta_snapshot_invalidate(meta_user_t *user);
+void               meta_snapshot_release(meta_snapshot_t *snapshot);
+
 /// crypto.c
 int_t   meta_crypto_keys_create(uint64_t usernum, stringer_t *username, stringer_t *realm, int64_t transaction);
 
@@ -0,0 +1,351 @@
+
+/**
+ * @file /magma/objects/meta/snapshots.c
+ *
+ * @brief Functions for publishing and pinning immutable snapshots of a user's message meta data.
+ *
+ * Readers pin the shared snapshot instead of making their own deep copy, and writers discard it after changing the live
+ * messages so the next reader gets a fresh snapshot. The message copies are reference counted, and a new snapshot only copies
+ * the messages which changed, sharing the rest with the snapshot it replaces. Old snapshots are freed when the last reader
+ * releases them.
+ */
+
+#include "magma.h"
+
+typedef struct {
+	meta_message_t message; /* The copy handed to readers. It has to be the first member, so a pointer to the copy is also a pointer to the entry. */
+	uint64_t refs; /* The number of snapshots holding the copy. */
+} meta_snapshot_entry_t;
+
+// Copies are shared by snapshots which may be released by different threads.
+static pthread_mutex_t meta_snapshot_entries = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief	Release a snapshot's reference to a message copy, and free the copy if no other snapshot holds it.
+ * @param	message		a pointer to the message copy being released.
+ * @return	This function returns no value.
+ */
+static void meta_snapshot_entry_release(meta_message_t *message) {
+
+	uint64_t refs;
+	meta_snapshot_entry_t *entry = (meta_snapshot_entry_t *)message;
+
+	if (!entry) {
+		return;
+	}
+
+	mutex_lock(&meta_snapshot_entries);
+	refs = --entry->refs;
+	mutex_unlock(&meta_snapshot_entries);
+
+	if (!refs) {
+		if (entry->message.tags) ar_free(entry->message.tags);
+		mm_free(entry);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Make a reference counted copy of a live message, along with a deep copy of its tags.
+ * @param	active	a pointer to the live message being copied.
+ * @return	NULL on failure, or a pointer to the message copy, holding a single reference, on success.
+ */
+static meta_message_t * meta_snapshot_entry_alloc(meta_message_t *active) {
+
+	meta_snapshot_entry_t *entry;
+
+	if (!(entry = mm_alloc(sizeof(meta_snapshot_entry_t)))) {
+		return NULL;
+	}
+
+	mm_copy(&(entry->message), active, sizeof(meta_message_t));
+	entry->message.tags = NULL;
+	entry->refs = 1;
+
+	if (active->tags && !(entry->message.tags = ar_dupe(active->tags))) {
+		mm_free(entry);
+		return NULL;
+	}
+
+	return &(entry->message);
+}
+
+/**
+ * @brief	Determine whether a message copy still matches the live message it was taken from.
+ * @param	copy	a pointer to the message copy held by a snapshot.
+ * @param	active	a pointer to the live message.
+ * @return	true if every field, including the tags, is unchanged, or false if the message needs to be copied again.
+ */
+static bool_t meta_snapshot_entry_current(meta_message_t *copy, meta_message_t *active) {
+
+	size_t count;
+
+	if (copy->messagenum != active->messagenum || copy->foldernum != active->foldernum || copy->sequencenum != active->sequencenum ||
+		copy->status != active->status || copy->updated != active->updated || copy->modseq != active->modseq || copy->size != active->size ||
+		copy->signum != active->signum || copy->sigkey != active->sigkey || copy->created != active->created ||
+		mm_cmp_cs_eq(copy->server, active->server, sizeof(copy->server))) {
+		return false;
+	}
+	else if ((count = (copy->tags ? ar_length_get(copy->tags) : 0)) != (active->tags ? ar_length_get(active->tags) : 0)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (ar_field_type(copy->tags, i) != ar_field_type(active->tags, i) || st_cmp_cs_eq(ar_field_st(copy->tags, i), ar_field_st(active->tags, i))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Free a message snapshot, releasing its references to the message copies.
+ * @param	snapshot	a pointer to the snapshot to be freed.
+ * @return	This function returns no value.
+ */
+static void meta_snapshot_free(meta_snapshot_t *snapshot) {
+
+	if (snapshot) {
+		inx_cleanup(snapshot->messages);
+		mutex_destroy(&(snapshot->lock));
+		mm_free(snapshot);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Build a snapshot of the user's current message meta data.
+ * @note	The caller must hold at least a read lock on the meta user object. Messages which haven't changed since the previous
+ * 			snapshot was taken share its copies. The live collection usually keeps its order, so the previous snapshot is walked
+ * 			alongside it, and it's only indexed by message number once a message is found out of place.
+ * @param	user		a pointer to the meta user object to be copied.
+ * @param	previous	if not NULL, a snapshot taken earlier, whose unchanged message copies should be reused.
+ * @return	NULL on failure, or a pointer to a snapshot holding a single reference on success.
+ */
+static meta_snapshot_t * meta_snapshot_alloc(meta_user_t *user, meta_snapshot_t *previous) {
+
+	meta_snapshot_t *snapshot;
+	inx_t *lookup = NULL;
+	inx_cursor_t *cursor, *walk = NULL;
+	meta_message_t *active, *copy, *candidate;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (!(snapshot = mm_alloc(sizeof(meta_snapshot_t)))) {
+		log_pedantic("Unable to allocate %zu bytes for a message snapshot.", sizeof(meta_snapshot_t));
+		return NULL;
+	}
+	else if (mutex_init(&(snapshot->lock), NULL) != 0) {
+		log_pedantic("Unable to initialize the message snapshot lock.");
+		mm_free(snapshot);
+		return NULL;
+	}
+	else if (!(snapshot->messages = inx_alloc(M_INX_LINKED, &meta_snapshot_entry_release))) {
+		log_pedantic("Unable to allocate an index for the message snapshot.");
+		meta_snapshot_free(snapshot);
+		return NULL;
+	}
+
+	snapshot->refs = 1;
+	snapshot->serial = user->serials.messages;
+
+	if (previous && previous->messages) {
+		walk = inx_cursor_alloc(previous->messages);
+	}
+
+	if (user->messages && (cursor = inx_cursor_alloc(user->messages))) {
+
+		while ((active = inx_cursor_value_next(cursor))) {
+
+			copy = NULL;
+			key.val.u64 = active->messagenum;
+
+			// Once the two collections fall out of step, index the previous copies, so each message can be found directly. New messages
+			// are appended to the live collection, so running off the end of the previous snapshot doesn't count.
+			if (walk && !lookup && (candidate = inx_cursor_value_next(walk)) && candidate->messagenum != active->messagenum) {
+				lookup = inx_alloc(M_INX_TREE, NULL);
+				inx_cursor_reset(walk);
+
+				while (lookup && (candidate = inx_cursor_value_next(walk))) {
+					multi_t index = { .type = M_TYPE_UINT64, .val.u64 = candidate->messagenum };
+					if (!inx_insert(lookup, index, candidate)) {
+						inx_cleanup(lookup);
+						lookup = NULL;
+					}
+				}
+
+				inx_cursor_free(walk);
+				walk = NULL;
+			}
+			else if (walk && !lookup) {
+				copy = candidate;
+			}
+
+			if (lookup) {
+				copy = inx_find(lookup, key);
+			}
+
+			// Share the previous copy if the message hasn't changed, otherwise make a new one.
+			if (copy && meta_snapshot_entry_current(copy, active)) {
+				mutex_lock(&meta_snapshot_entries);
+				((meta_snapshot_entry_t *)copy)->refs++;
+				mutex_unlock(&meta_snapshot_entries);
+			}
+			else if (!(copy = meta_snapshot_entry_alloc(active))) {
+				log_error("Unable to duplicate the message structure.");
+				inx_cursor_free(cursor);
+				if (walk) inx_cursor_free(walk);
+				inx_cleanup(lookup);
+				meta_snapshot_free(snapshot);
+				return NULL;
+			}
+
+			if (!key.val.u64 || !inx_append(snapshot->messages, key, copy)) {
+				log_error("Unable to add the duplicate message to the snapshot.");
+				meta_snapshot_entry_release(copy);
+				inx_cursor_free(cursor);
+				if (walk) inx_cursor_free(walk);
+				inx_cleanup(lookup);
+				meta_snapshot_free(snapshot);
+				return NULL;
+			}
+
+		}
+
+		inx_cursor_free(cursor);
+	}
+
+	if (walk) {
+		inx_cursor_free(walk);
+	}
+
+	inx_cleanup(lookup);
+
+	return snapshot;
+}
+
+/**
+ * @brief	Release a reference to a message snapshot, and free it if it was the last one.
+ * @param	snapshot	a pointer to the snapshot being released.
+ * @return	This function returns no value.
+ */
+void meta_snapshot_release(meta_snapshot_t *snapshot) {
+
+	uint64_t refs;
+
+	if (!snapshot) {
+		return;
+	}
+
+	mutex_lock(&(snapshot->lock));
+	refs = --snapshot->refs;
+	mutex_unlock(&(snapshot->lock));
+
+	if (!refs) {
+		meta_snapshot_free(snapshot);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Pin the current snapshot of a user's message meta data, building a new one if the messages have changed.
+ * @note	The caller must hold at least a read lock on the meta user object, but may release it as soon as this function returns.
+ * 			The snapshot must be treated as read only, and returned using meta_snapshot_release().
+ * @param	user	a pointer to the meta user object.
+ * @return	NULL on failure, or a pointer to the pinned snapshot on success.
+ */
+meta_snapshot_t * meta_snapshot_get(meta_user_t *user) {
+
+	meta_snapshot_t *snapshot;
+
+	if (!user) {
+		return NULL;
+	}
+
+	mutex_lock(&(user->snapshot.lock));
+
+	// A snapshot taken before the messages were refreshed is no longer current, but its copies may still be reused.
+	if ((snapshot = user->snapshot.current) && snapshot->serial != user->serials.messages) {
+		meta_snapshot_release(user->snapshot.previous);
+		user->snapshot.previous = snapshot;
+		user->snapshot.current = NULL;
+		snapshot = NULL;
+	}
+
+	// Build and publish a new snapshot. The published reference belongs to the user object.
+	if (!snapshot && (snapshot = meta_snapshot_alloc(user, user->snapshot.previous))) {
+		user->snapshot.current = snapshot;
+		meta_snapshot_release(user->snapshot.previous);
+		user->snapshot.previous = NULL;
+	}
+
+	if (snapshot) {
+		mutex_lock(&(snapshot->lock));
+		snapshot->refs++;
+		mutex_unlock(&(snapshot->lock));
+	}
+
+	mutex_unlock(&(user->snapshot.lock));
+
+	return snapshot;
+}
+
+/**
+ * @brief	Discard the current message snapshot, so the next reader gets a snapshot which reflects the latest changes.
+ * @note	Writers should call this function after updating the messages collection, while still holding the user write lock.
+ * 			The discarded snapshot is kept until the next one is built, so the copies of the unchanged messages can be shared.
+ * @param	user	a pointer to the meta user object which was modified.
+ * @return	This function returns no value.
+ */
+void meta_snapshot_invalidate(meta_user_t *user) {
+
+	meta_snapshot_t *snapshot = NULL;
+
+	if (!user) {
+		return;
+	}
+
+	mutex_lock(&(user->snapshot.lock));
+
+	// If the current snapshot was never read since the last invalidation, the older snapshot is still the better base.
+	if (user->snapshot.current) {
+		snapshot = user->snapshot.previous;
+		user->snapshot.previous = user->snapshot.current;
+		user->snapshot.current = NULL;
+	}
+
+	mutex_unlock(&(user->snapshot.lock));
+
+	meta_snapshot_release(snapshot);
+
+	return;
+}
+
+/**
+ * @brief	Release every snapshot reference held by a meta user object.
+ * @note	Readers may still be holding the snapshots, so only the references held by the user object are dropped.
+ * @param	user	a pointer to the meta user object being freed.
+ * @return	This function returns no value.
+ */
+void meta_snapshot_discard(meta_user_t *user) {
+
+	meta_snapshot_t *current, *previous;
+
+	if (!user) {
+		return;
+	}
+
+	mutex_lock(&(user->snapshot.lock));
+	current = user->snapshot.current;
+	previous = user->snapshot.previous;
+	user->snapshot.current = user->snapshot.previous = NULL;
+	mutex_unlock(&(user->snapshot.lock));
+
+	meta_snapshot_release(current);
+	meta_snapshot_release(previous);
+
+	return;
+}
@@ -381,7 +381,10 @@ int_t meta_update_folders(meta_user_t *user, META_LOCK_STATUS locked) {
 
 		if ((output = meta_data_fetch_folders(user)) && user->messages) {
 			meta_messages_update_sequences(user->folders, user->messages);
+			meta_snapshot_invalidate(user);
 		}
+
+		meta_counters_rebuild(user->folders, user->messages);
 	}
 
 	// We need to build the folders table.
@@ -393,7 +396,10 @@ int_t meta_update_folders(meta_user_t *user, META_LOCK_STATUS locked) {
 
 		if ((output = meta_data_fetch_folders(user)) && user->messages) {
 			meta_messages_update_sequences(user->folders, user->messages);
+			meta_snapshot_invalidate(user);
 		}
+
+		meta_counters_rebuild(user->folders, user->messages);
 	}
 
 	// Do we need to clear the lock.
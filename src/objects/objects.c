@@ -9,11 +9,16 @@
 
 object_cache_t objects = {
 	.meta = NULL,
-	.sessions = NULL
+	.sessions = NULL,
+	.serials = NULL,
+	.lru = {
+		.meta = { .bytes = 0, .count = 0, .head = NULL, .tail = NULL, .lock = PTHREAD_MUTEX_INITIALIZER },
+		.sessions = { .bytes = 0, .count = 0, .head = NULL, .tail = NULL, .lock = PTHREAD_MUTEX_INITIALIZER }
+	}
 };
 
 /**
- * @brief	Initialize the object cache for all active user objects and web sessions.
+ * @brief	Initialize the object cache for all active user objects, web sessions and the local serial number copies.
  * @return	true on success or false on failure.
  */
 bool_t obj_cache_start(void) {
@@ -28,6 +33,11 @@ bool_t obj_cache_start(void) {
 		return false;
 	}
 
+	if (!(objects.serials = inx_alloc(M_INX_TREE | M_INX_LOCK_MANUAL, &mm_free))) {
+		log_critical("Unable to initialize the serial number cache.");
+		return false;
+	}
+
 	return true;
 }
 
@@ -48,116 +58,277 @@ void obj_cache_stop(void) {
 		objects.meta = NULL;
 	}
 
+	if (objects.serials) {
+		inx_free(objects.serials);
+		objects.serials = NULL;
+	}
 
 	return;
 }
 
 /**
- * @brief	The prune function runs every few minutes and scans the object cache and removes any stale objects it finds.
- *
- * @note	If the number of entries is over 4,096, then the prune function will remove entries candidates which have been unused more
- * 			then 5 minutes. If the index holds more than 2,048, entries older than 30 minutes are pruned, otherwise if the index holds
- * 			fewer than 2,048 entries, only those objects older than 1 hour are removed. Also, note that the precise interval between
- * 			scans is somewhat random, because the background thread responsible for running the prune function goes to sleep for a
- * 			random number of seconds.
+ * @brief	Move a cached object to the head of its list, linking it into the list if necessary.
+ * @param	list	a pointer to the object list being updated.
+ * @param	link	a pointer to the list links embedded in the object.
+ * @param	object	a pointer to the object holding the links.
+ * @return	This function returns no value.
  */
-void obj_cache_prune(void) {
+void obj_cache_touch(object_list_t *list, object_link_t *link, void *object) {
 
-	time_t now;
-	double_t gap;
-	session_t *sess;
-	inx_cursor_t *cursor;
-	meta_user_t *meta;
-	uint64_t count, expired;
+	if (!list || !link || !object) {
+		return;
+	}
 
-	if ((now = time(NULL)) == (time_t)(-1)) {
+	mutex_lock(&(list->lock));
+
+	// If the object is already on the list, detach it from its current position.
+	if (link->object) {
+
+		// Already the most recently used object.
+		if (list->head == link) {
+			mutex_unlock(&(list->lock));
+			return;
+		}
+
+		link->prev->next = link->next;
+
+		if (link->next) link->next->prev = link->prev;
+		else list->tail = link->prev;
+	}
+	else {
+		link->object = object;
+		list->bytes += link->bytes;
+		list->count++;
+	}
+
+	link->prev = NULL;
+	link->next = list->head;
+
+	if (list->head) list->head->prev = link;
+	else list->tail = link;
+
+	list->head = link;
+
+	mutex_unlock(&(list->lock));
+
+	return;
+}
+
+/**
+ * @brief	Update the memory estimate for a cached object, and adjust the list total to match.
+ * @param	list	a pointer to the object list holding the object.
+ * @param	link	a pointer to the list links embedded in the object.
+ * @param	bytes	the estimated number of bytes held by the object.
+ * @return	This function returns no value.
+ */
+void obj_cache_resize(object_list_t *list, object_link_t *link, size_t bytes) {
+
+	if (!list || !link) {
 		return;
 	}
 
-	if (objects.meta && (cursor = inx_cursor_alloc(objects.meta))) {
+	mutex_lock(&(list->lock));
 
-		expired = 0;
+	if (link->object) {
+		list->bytes = list->bytes - link->bytes + bytes;
+	}
 
-		inx_lock_read(objects.meta);
+	link->bytes = bytes;
 
-		// If were currently holding more than 4,096 meta objects, prune those older than 5 minutes.
-		if ((count = inx_count(objects.meta)) > 4096) {
-			gap = 300;
-		}
-		// If the count is above 2,048, prune entries older than 30 minutes.
-		else if (count > 2048) {
-			gap = 1800;
-		}
-		// Otherwise only prune those older than 1 hour.
-		else  {
-			gap = 3600;
-		}
+	mutex_unlock(&(list->lock));
+
+	return;
+}
+
+/**
+ * @brief	Remove a cached object from its list.
+ * @note	This is called by the object destructors, so it quietly ignores objects which were never placed on a list.
+ * @param	list	a pointer to the object list holding the object.
+ * @param	link	a pointer to the list links embedded in the object.
+ * @return	This function returns no value.
+ */
+void obj_cache_unlink(object_list_t *list, object_link_t *link) {
+
+	if (!list || !link || !link->object) {
+		return;
+	}
 
-		inx_unlock(objects.meta);
-		inx_lock_write(objects.meta);
+	mutex_lock(&(list->lock));
 
-		meta = inx_cursor_value_next(cursor);
+	if (link->prev) link->prev->next = link->next;
+	else list->head = link->next;
 
-		while (meta) {
-			if (difftime(now, meta_user_ref_stamp(meta)) > gap && !meta_user_ref_total(meta)) {
-				inx_delete(objects.meta, inx_cursor_key_active(cursor));
-				inx_cursor_reset(cursor);
-				expired++;
-			}
-			meta = inx_cursor_value_next(cursor);
+	if (link->next) link->next->prev = link->prev;
+	else list->tail = link->prev;
+
+	list->bytes -= link->bytes;
+	list->count--;
+
+	link->prev = link->next = link->object = NULL;
+
+	mutex_unlock(&(list->lock));
+
+	return;
+}
+
+/**
+ * @brief	Evict the least recently used user objects which are either idle, or pushing the cache over its memory budget.
+ * @note	The caller must hold the write lock for the meta object index. Objects which are still referenced are moved back to the
+ * 			head of the list, so they won't be examined again until the rest of the list has been.
+ * @param	now		the current time, used to decide whether an object has been idle long enough to expire.
+ * @param	slice	the maximum number of objects to examine.
+ * @return	true if the slice was exhausted and more objects may need evicting, or false if the cache is within its limits.
+ */
+bool_t obj_cache_evict_meta(time_t now, uint64_t slice) {
+
+	meta_user_t *user;
+	bool_t over, result = true;
+	uint64_t expired = 0, evicted = 0;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	for (uint64_t i = 0; i < slice; i++) {
+
+		mutex_lock(&(objects.lru.meta.lock));
+		user = objects.lru.meta.tail ? objects.lru.meta.tail->object : NULL;
+		over = objects.lru.meta.bytes > magma.objects.meta_limit;
+		mutex_unlock(&(objects.lru.meta.lock));
+
+		// The list is ordered by use, so once the tail is recent enough, and we're inside the budget, we're done.
+		if (!user || (!over && difftime(now, meta_user_ref_stamp(user)) <= magma.objects.idle_timeout)) {
+			result = false;
+			break;
+		}
+		else if (meta_user_ref_total(user)) {
+			obj_cache_touch(&(objects.lru.meta), &(user->cache), user);
+			continue;
 		}
 
-		// Record the total so we can update the statistics variable.
-		count = inx_count(objects.meta);
-		inx_unlock(objects.meta);
-		inx_cursor_free(cursor);
+		// Deleting the object from the index will free it, which also removes it from the list.
+		key.val.u64 = user->usernum;
 
-		stats_set_by_name("objects.meta.total", count);
-		stats_adjust_by_name("objects.meta.expired", expired);
+		if (inx_delete(objects.meta, key)) {
+			if (over) evicted++;
+			else expired++;
+		}
+		else {
+			obj_cache_unlink(&(objects.lru.meta), &(user->cache));
+		}
 	}
 
-	if (objects.sessions && (cursor = inx_cursor_alloc(objects.sessions))) {
+	if (expired) stats_adjust_by_name("objects.meta.expired", expired);
+	if (evicted) stats_adjust_by_name("objects.meta.evicted", evicted);
+
+	return result;
+}
+
+/**
+ * @brief	Evict the least recently used web sessions which are either idle, or pushing the cache over its memory budget.
+ * @note	The caller must hold the write lock for the session index. Sessions which are still referenced are moved back to the
+ * 			head of the list, so they won't be examined again until the rest of the list has been.
+ * @param	now		the current time, used to decide whether a session has been idle long enough to expire.
+ * @param	slice	the maximum number of sessions to examine.
+ * @return	true if the slice was exhausted and more sessions may need evicting, or false if the cache is within its limits.
+ */
+bool_t obj_cache_evict_sessions(time_t now, uint64_t slice) {
+
+	session_t *sess;
+	bool_t over, result = true;
+	uint64_t expired = 0, evicted = 0;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
 
-		expired = 0;
+	for (uint64_t i = 0; i < slice; i++) {
 
-		inx_lock_read(objects.sessions);
+		mutex_lock(&(objects.lru.sessions.lock));
+		sess = objects.lru.sessions.tail ? objects.lru.sessions.tail->object : NULL;
+		over = objects.lru.sessions.bytes > magma.objects.sessions_limit;
+		mutex_unlock(&(objects.lru.sessions.lock));
 
-		// If were currently holding more than 4,096 sessions, prune those older than 5 minutes.
-		if ((count = inx_count(objects.sessions)) > 4096) {
-			gap = 300;
+		// The list is ordered by use, so once the tail is recent enough, and we're inside the budget, we're done.
+		if (!sess || (!over && difftime(now, sess_ref_stamp(sess)) <= magma.objects.idle_timeout)) {
+			result = false;
+			break;
 		}
-		// If the count is above 2,048, prune entries older than 30 minutes.
-		else if (count > 2048) {
-			gap = 1800;
+		else if (sess_ref_total(sess)) {
+			obj_cache_touch(&(objects.lru.sessions), &(sess->cache), sess);
+			continue;
 		}
-		// Otherwise only prune those older than 1 hour.
-		else  {
-			gap = 3600;
+
+		// Deleting the session from the index will free it, which also removes it from the list.
+		key.val.u64 = sess->warden.number;
+
+		if (inx_delete(objects.sessions, key)) {
+			if (over) evicted++;
+			else expired++;
+		}
+		else {
+			obj_cache_unlink(&(objects.lru.sessions), &(sess->cache));
 		}
+	}
 
-		inx_unlock(objects.sessions);
-		inx_lock_write(objects.sessions);
+	if (expired) stats_adjust_by_name("objects.sessions.expired", expired);
+	if (evicted) stats_adjust_by_name("objects.sessions.evicted", evicted);
 
-		sess = inx_cursor_value_next(cursor);
+	return result;
+}
 
-		while (sess) {
-			if (difftime(now, sess_ref_stamp(sess)) > gap && !sess_ref_total(sess)) {
-				inx_delete(objects.sessions, inx_cursor_key_active(cursor));
-				inx_cursor_reset(cursor);
-				expired++;
-			}
-			sess = inx_cursor_value_next(cursor);
-		}
+/**
+ * @brief	The prune function runs every few minutes and removes any stale objects from the object cache.
+ *
+ * @note	The user objects and web sessions are kept on lists ordered from most to least recently used, so only the tail of each list
+ * 			needs to be examined. Objects unused for longer than magma.objects.idle_timeout are expired, and if the estimated memory held
+ * 			by a cache is over its budget, the least recently used objects are evicted until it fits. The work is done in small slices,
+ * 			and the index lock is released between slices so requests aren't stalled while a large cache is being trimmed. Also, note
+ * 			that the precise interval between scans is somewhat random, because the background thread responsible for running the prune
+ * 			function goes to sleep for a random number of seconds.
+ */
+void obj_cache_prune(void) {
+
+	time_t now;
+	bool_t more;
+	uint64_t passes;
+
+	if ((now = time(NULL)) == (time_t)(-1)) {
+		return;
+	}
+
+	if (objects.meta) {
+
+		// Each object is examined at most once per prune, even if they're all in use.
+		mutex_lock(&(objects.lru.meta.lock));
+		passes = (objects.lru.meta.count / OBJECT_CACHE_EVICT_SLICE) + 1;
+		mutex_unlock(&(objects.lru.meta.lock));
+
+		do {
+			inx_lock_write(objects.meta);
+			more = obj_cache_evict_meta(now, OBJECT_CACHE_EVICT_SLICE);
+			inx_unlock(objects.meta);
+		} while (more && --passes && status());
+
+		mutex_lock(&(objects.lru.meta.lock));
+		stats_set_by_name("objects.meta.total", objects.lru.meta.count);
+		stats_set_by_name("objects.meta.bytes", objects.lru.meta.bytes);
+		mutex_unlock(&(objects.lru.meta.lock));
+	}
+
+	if (objects.sessions) {
+
+		mutex_lock(&(objects.lru.sessions.lock));
+		passes = (objects.lru.sessions.count / OBJECT_CACHE_EVICT_SLICE) + 1;
+		mutex_unlock(&(objects.lru.sessions.lock));
 
-		// Record the total so we can update the statistics variable.
-		count = inx_count(objects.sessions);
-		inx_unlock(objects.sessions);
-		inx_cursor_free(cursor);
+		do {
+			inx_lock_write(objects.sessions);
+			more = obj_cache_evict_sessions(now, OBJECT_CACHE_EVICT_SLICE);
+			inx_unlock(objects.sessions);
+		} while (more && --passes && status());
 
-		stats_set_by_name("objects.sessions.total", count);
-		stats_adjust_by_name("objects.sessions.expired", expired);
+		mutex_lock(&(objects.lru.sessions.lock));
+		stats_set_by_name("objects.sessions.total", objects.lru.sessions.count);
+		stats_set_by_name("objects.sessions.bytes", objects.lru.sessions.bytes);
+		mutex_unlock(&(objects.lru.sessions.lock));
 	}
 
+	serial_local_prune();
 
 	return;
 }
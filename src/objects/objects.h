@@ -27,8 +27,32 @@ enum {
 	OBJECT_ALIASES
 };
 
+// The number of object types tracked using serial numbers.
+#define SERIAL_OBJECT_TYPES (OBJECT_ALIASES + 1)
+
+typedef struct {
+	time_t stamp; /* When the values were retrieved from the cache. */
+	uint64_t serials[SERIAL_OBJECT_TYPES]; /* The serial numbers, indexed by object type. */
+} serial_local_t;
+
+// The number of objects examined from the tail of a cache list each time eviction runs.
+#define OBJECT_CACHE_EVICT_SLICE 16
+
+// The approximate memory held by each record inside a cached object, including the index node and any short strings.
+#define OBJECT_CACHE_RECORD_BYTES 64
+
+typedef struct {
+	size_t bytes; /* The estimated memory held by every object on the list. */
+	uint64_t count; /* The number of objects on the list. */
+	object_link_t *head, *tail; /* The most and least recently used objects. */
+	pthread_mutex_t lock;
+} object_list_t;
+
 typedef struct {
-	inx_t *meta, *sessions;
+	inx_t *meta, *sessions, *serials;
+	struct {
+		object_list_t meta, sessions;
+	} lru;
 } object_cache_t;
 
 extern object_cache_t objects;
@@ -40,13 +64,22 @@ int_t   user_lock(uint64_t usernum);
 void    user_unlock(uint64_t usernum);
 
 /// objects.c
+bool_t obj_cache_evict_meta(time_t now, uint64_t slice);
+bool_t obj_cache_evict_sessions(time_t now, uint64_t slice);
+void   obj_cache_prune(void);
+void   obj_cache_resize(object_list_t *list, object_link_t *link, size_t bytes);
 bool_t obj_cache_start(void);
-void obj_cache_prune(void);
-void obj_cache_stop(void);
+void   obj_cache_stop(void);
+void   obj_cache_touch(object_list_t *list, object_link_t *link, void *object);
+void   obj_cache_unlink(object_list_t *list, object_link_t *link);
 
 /// serials.c
 uint64_t serial_get(uint64_t type, uint64_t num);
 uint64_t serial_increment(uint64_t type, uint64_t num);
+bool_t   serial_local_fetch(uint64_t num, serial_local_t *local);
+void     serial_local_prune(void);
+void     serial_local_truncate(void);
+void     serial_local_update(uint64_t type, uint64_t num, uint64_t serial);
 uint64_t serial_reset(uint64_t type, uint64_t num);
 
 #endif
@@ -53,16 +53,230 @@ stringer_t * serial_prefix(uint64_t type) {
 	return prefix;
 }
 
+/**
+ * @brief	Track how many serial number requests were answered locally, and how many multi-get round trips were needed.
+ * @note	The counters are folded into the statistics by serial_local_prune().
+ */
+static struct {
+	pthread_mutex_t lock;
+	uint64_t saved, fetched;
+} serial_local_stats = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.saved = 0,
+	.fetched = 0
+};
+
+/**
+ * @brief	Fetch every object serial number for a user from memcached using a single round trip.
+ * @param	num		the specific object identifier.
+ * @param	local	the local serial number record which will receive the values.
+ * @return	true on success, or false if the values could not be retrieved.
+ */
+bool_t serial_local_fetch(uint64_t num, serial_local_t *local) {
+
+	bool_t result;
+	stringer_t *keys[SERIAL_OBJECT_TYPES];
+
+	mm_wipe(keys, sizeof(keys));
+
+	// Build the keys for every object type.
+	for (uint64_t type = 0; type < SERIAL_OBJECT_TYPES; type++) {
+		if (!(keys[type] = st_aprint("magma.%.*s.%lu", st_length_int(serial_prefix_strings[type]), st_char_get(serial_prefix_strings[type]), num))) {
+			log_pedantic("Unable to build %.*s serial key.", st_length_int(serial_prefix_strings[type]), st_char_get(serial_prefix_strings[type]));
+			for (uint64_t i = 0; i < type; i++) st_free(keys[i]);
+			return false;
+		}
+	}
+
+	if ((result = cache_get_counters(SERIAL_OBJECT_TYPES, keys, local->serials))) {
+		local->stamp = time(NULL);
+	}
+
+	for (uint64_t type = 0; type < SERIAL_OBJECT_TYPES; type++) {
+		st_free(keys[type]);
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Update the local copy of an object serial number following an increment or reset.
+ * @note	If the new value is zero the request failed, and the local copy is discarded so the next request goes back to the cache.
+ * @param	type	the serial type being updated.
+ * @param	num		the specific object identifier.
+ * @param	serial	the value returned by the cache server.
+ * @return	This function returns no value.
+ */
+void serial_local_update(uint64_t type, uint64_t num, uint64_t serial) {
+
+	serial_local_t *local;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = num };
+
+	if (!objects.serials || type >= SERIAL_OBJECT_TYPES) {
+		return;
+	}
+
+	inx_lock_write(objects.serials);
+
+	if ((local = inx_find(objects.serials, key))) {
+
+		// Only replace the local value if this thread is the one which advanced it, otherwise we could overwrite a newer value.
+		if (serial && serial > local->serials[type]) {
+			local->serials[type] = serial;
+		}
+		else if (!serial) {
+			inx_delete(objects.serials, key);
+		}
+	}
+
+	inx_unlock(objects.serials);
+	return;
+}
+
+/**
+ * @brief	Remove stale serial number records from the local index, and update the related statistics.
+ * @return	This function returns no value.
+ */
+void serial_local_prune(void) {
+
+	time_t now;
+	uint64_t *expired;
+	inx_cursor_t *cursor;
+	serial_local_t *local;
+	uint64_t saved, fetched, count = 0;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (!objects.serials || (now = time(NULL)) == (time_t)(-1)) {
+		return;
+	}
+
+	inx_lock_write(objects.serials);
+
+	// Deleting a record invalidates the cursor, so the expired keys are collected in a single pass, and then deleted.
+	if (inx_count(objects.serials) && (expired = mm_alloc(inx_count(objects.serials) * sizeof(uint64_t)))) {
+
+		if ((cursor = inx_cursor_alloc(objects.serials))) {
+			while ((local = inx_cursor_value_next(cursor))) {
+				if (difftime(now, local->stamp) > magma.iface.cache.serial_timeout) {
+					expired[count++] = inx_cursor_key_active(cursor).val.u64;
+				}
+			}
+			inx_cursor_free(cursor);
+		}
+
+		for (uint64_t i = 0; i < count; i++) {
+			key.val.u64 = expired[i];
+			inx_delete(objects.serials, key);
+		}
+
+		mm_free(expired);
+	}
+
+	inx_unlock(objects.serials);
+
+	mutex_lock(&(serial_local_stats.lock));
+	saved = serial_local_stats.saved;
+	fetched = serial_local_stats.fetched;
+	serial_local_stats.saved = serial_local_stats.fetched = 0;
+	mutex_unlock(&(serial_local_stats.lock));
+
+	stats_adjust_by_name("objects.serials.saved", saved);
+	stats_adjust_by_name("objects.serials.fetched", fetched);
+
+	return;
+}
+
+/**
+ * @brief	Discard every local serial number record, forcing the next request for each user back to the cache.
+ * @return	This function returns no value.
+ */
+void serial_local_truncate(void) {
+
+	if (!objects.serials) {
+		return;
+	}
+
+	inx_lock_write(objects.serials);
+	inx_truncate(objects.serials);
+	inx_unlock(objects.serials);
+
+	return;
+}
+
 /**
  * @brief	Get the serial number (checkpoint value) for an object from memcached.
+ * @note	The serial numbers for every object type are retrieved together, and a local copy is kept for magma.iface.cache.serial_timeout
+ * 			seconds, so a session checking several object types only triggers a single network round trip. Increments made by this process
+ * 			are applied to the local copy, so only changes made by other processes may be delayed.
  * @param	type	the serial type to be queried (OBJECT_USER, OBJECT_CONFIG, OBJECT_FOLDERS, OBJECT_MESSAGES, or OBJECT_CONTACTS).
  * @param	num		the specific object identifier.
  * @return	0 on failure or the serial number of the requested object.
  */
 uint64_t serial_get(uint64_t type, uint64_t num) {
 
+	time_t now, stale = 0;
 	uint64_t result = 0;
 	stringer_t *key, *prefix;
+	serial_local_t *local, fetched;
+	multi_t lookup = { .type = M_TYPE_UINT64, .val.u64 = num };
+
+	// Check the local copy first.
+	if (objects.serials && magma.iface.cache.serial_timeout && type < SERIAL_OBJECT_TYPES && (now = time(NULL)) != (time_t)(-1)) {
+
+		inx_lock_read(objects.serials);
+
+		if ((local = inx_find(objects.serials, lookup)) && difftime(now, local->stamp) < magma.iface.cache.serial_timeout) {
+			result = local->serials[type];
+			inx_unlock(objects.serials);
+
+			mutex_lock(&(serial_local_stats.lock));
+			serial_local_stats.saved++;
+			mutex_unlock(&(serial_local_stats.lock));
+			return result;
+		}
+		// Remember which stale record we saw, so we can tell whether another thread refreshed it during the round trip.
+		else if (local) {
+			stale = local->stamp;
+		}
+
+		inx_unlock(objects.serials);
+
+		// The local copy is missing, or stale, so refresh every object type at once. The lock isn't held during the round trip.
+		if (serial_local_fetch(num, &fetched)) {
+
+			inx_lock_write(objects.serials);
+
+			// If the record is still the stale copy we saw, it's replaced outright, since a counter may legitimately go backwards when
+			// the cache server loses, or resets, a value.
+			if ((local = inx_find(objects.serials, lookup)) && stale && local->stamp == stale) {
+				mm_copy(local->serials, fetched.serials, sizeof(fetched.serials));
+				local->stamp = fetched.stamp;
+				result = local->serials[type];
+			}
+			// Another thread stored, or advanced, the values while we were waiting so we merge the two copies.
+			else if (local) {
+				for (uint64_t i = 0; i < SERIAL_OBJECT_TYPES; i++) {
+					local->serials[i] = (local->serials[i] > fetched.serials[i] ? local->serials[i] : fetched.serials[i]);
+				}
+				local->stamp = fetched.stamp;
+				result = local->serials[type];
+			}
+			else if ((local = mm_dupe(&fetched, sizeof(serial_local_t))) && !inx_insert(objects.serials, lookup, local)) {
+				mm_free(local);
+				result = fetched.serials[type];
+			}
+			else {
+				result = fetched.serials[type];
+			}
+
+			inx_unlock(objects.serials);
+
+			mutex_lock(&(serial_local_stats.lock));
+			serial_local_stats.fetched++;
+			mutex_unlock(&(serial_local_stats.lock));
+			return result;
+		}
+	}
 
 	// Build retrieval key.
 	if (!(prefix = serial_prefix(type)) || !(key = st_aprint("magma.%.*s.%lu", st_length_int(prefix), st_char_get(prefix), num))) {
@@ -98,6 +312,14 @@ uint64_t serial_increment(uint64_t type, uint64_t num) {
 	result = cache_increment(key, 1, 1, 2592000);
 	st_free(key);
 
+	// Keep the local copy in sync with changes made by this process.
+	serial_local_update(type, num, result);
+
+	// Wake any idling connections belonging to the user, so they see the change without waiting for the next tick.
+	if (type == OBJECT_MESSAGES || type == OBJECT_FOLDERS) {
+		con_idle_notify(num);
+	}
+
 	return result;
 }
 
@@ -125,6 +347,9 @@ uint64_t serial_reset(uint64_t type, uint64_t num) {
 
 	st_free(key);
 
+	// A reset moves the value backward, so the local copy is simply discarded.
+	serial_local_update(type, num, 0);
+
 	return result;
 }
 
@@ -60,6 +60,9 @@ void sess_destroy(session_t *sess) {
 
 	if (sess) {
 
+		// Take the session off the cache list before it's released.
+		obj_cache_unlink(&(objects.lru.sessions), &(sess->cache));
+
 		if (sess->user) {
 			meta_inx_remove(sess->user->usernum, META_PROTOCOL_WEB);
 		}
@@ -79,6 +82,28 @@ void sess_destroy(session_t *sess) {
 	return;
 }
 
+/**
+ * @brief	Estimate the amount of memory held by a web session.
+ * @note	The linked user object isn't included, since it's accounted for separately by the meta object cache.
+ * @param	sess	a pointer to the web session to be measured.
+ * @return	the approximate number of bytes held by the session.
+ */
+size_t sess_size(session_t *sess) {
+
+	size_t result;
+
+	if (!sess) {
+		return 0;
+	}
+
+	result = sizeof(session_t) + st_length_get(sess->warden.token) + st_length_get(sess->warden.agent) + st_length_get(sess->request.host) +
+		st_length_get(sess->request.path) + st_length_get(sess->request.application);
+
+	if (sess->compositions) result += inx_count(sess->compositions) * (sizeof(composition_t) + OBJECT_CACHE_RECORD_BYTES);
+
+	return result;
+}
+
 /**
  * @brief	Increment the web session's reference counter and update its timestamp.
  * @param	sess	a pointer to the web session to be updated.
@@ -405,13 +430,23 @@ session_t *sess_create(connection_t *con, stringer_t *path, stringer_t *applicat
 
 	sess_ref_add(output);
 
+	inx_lock_write(objects.sessions);
+
 	if (inx_insert(objects.sessions, key, output) != 1) {
+		inx_unlock(objects.sessions);
 		log_pedantic("Unable to insert the session into the global context.");
 		sess_ref_dec(output);
 		sess_destroy(output);
 		return NULL;
 	}
 
+	// Put the new session at the head of the cache list, and then trim the least recently used sessions if we're over budget.
+	obj_cache_touch(&(objects.lru.sessions), &(output->cache), output);
+	obj_cache_resize(&(objects.lru.sessions), &(output->cache), sess_size(output));
+	obj_cache_evict_sessions(time(NULL), OBJECT_CACHE_EVICT_SLICE);
+
+	inx_unlock(objects.sessions);
+
 	return output;
 }
 
@@ -459,6 +494,7 @@ int_t sess_get(connection_t *con, stringer_t *application, stringer_t *path, str
 
 	if ((con->http.session = inx_find(objects.sessions, key))) {
 		sess_ref_add(con->http.session);
+		obj_cache_touch(&(objects.lru.sessions), &(con->http.session->cache), con->http.session);
 	}
 
 	inx_unlock(objects.sessions);
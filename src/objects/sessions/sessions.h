@@ -23,6 +23,7 @@ void          sess_refresh_flush(session_t *sess);
 time_t        sess_refresh_stamp(session_t *sess);
 void          sess_release(session_t *sess);
 void          sess_serial_check(session_t *sess, uint64_t object);
+size_t        sess_size(session_t *sess);
 stringer_t *  sess_token(session_t *sess);
 void          sess_trigger(session_t *sess);
 void          sess_update(session_t *sess);
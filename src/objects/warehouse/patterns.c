@@ -1,4 +1,3 @@
-
 /**
  * @file /magma/objects/warehouse/patterns.c
  *
@@ -7,42 +6,206 @@
 
 #include "magma.h"
 
-inx_t *patterns_list = NULL;
 uint64_t patterns_stamp = 0;
-pthread_mutex_t patterns_mutex = PTHREAD_MUTEX_INITIALIZER;
+pattern_automaton_t *patterns_automaton = NULL;
+pthread_rwlock_t patterns_lock = PTHREAD_RWLOCK_INITIALIZER;
 
 /**
- * @brief	Check to see if any of the entries in the patterns list are found in a body of text.
- * @param	message		a managed string containing the raw data of the text to be searched.
- * @return	-2 on pattern match, -1 if an error occurs, or 1 if none of the patterns in the patterns list were detected.
+ * @brief	Free a compiled pattern automaton.
+ * @param	automaton	a pointer to the automaton to be freed.
+ * @return	This function returns no value.
  */
-int_t pattern_check(stringer_t *message) {
+void pattern_free(pattern_automaton_t *automaton) {
 
-	size_t location;
-	int_t result = 1;
+	if (!automaton) {
+		return;
+	}
+
+	mm_cleanup(automaton->delta, automaton->matches);
+	mm_free(automaton);
+
+	return;
+}
+
+/**
+ * @brief	Compile a list of patterns into a case insensitive Aho-Corasick automaton, so a body of text can be checked for every pattern in a single pass.
+ * @note	The bytes which appear in the patterns are assigned to classes, with upper and lower case letters sharing a class, and every other byte
+ * 			sharing class zero. The failure links are then folded into a complete transition table, with a row of classes entries for each
+ * 			state, so the search never has to backtrack. Empty patterns are ignored.
+ * @param	patterns	an inx holder containing a collection of managed strings with the patterns.
+ * @return	NULL on failure, or a pointer to the compiled automaton, which must be freed using pattern_free().
+ */
+pattern_automaton_t * pattern_compile(inx_t *patterns) {
+
+	uchr_t *data;
+	size_t length;
+	uint64_t limit = 1;
 	stringer_t *current;
 	inx_cursor_t *cursor;
+	uint32_t state, next, head = 0, tail = 0, *fail = NULL, *queue = NULL, *delta;
+	pattern_automaton_t *automaton = NULL;
 
-	stats_adjust_by_name("objects.patterns.checked", 1);
+	if (!patterns || !(cursor = inx_cursor_alloc(patterns))) {
+		log_pedantic("Unable to iterate through the list of patterns.");
+		return NULL;
+	}
+	else if (!(automaton = mm_alloc(sizeof(pattern_automaton_t)))) {
+		log_pedantic("Unable to allocate memory for the pattern automaton.");
+		inx_cursor_free(cursor);
+		return NULL;
+	}
 
-	mutex_lock(&patterns_mutex);
-	cursor = inx_cursor_alloc(patterns_list);
-	mutex_unlock(&patterns_mutex);
+	// Assign a class to each byte found in the patterns, and total up the pattern lengths, which limits the number of states.
+	automaton->classes = 1;
 
-	if (!cursor) {
-		result = -1;
-	} else {
+	while ((current = inx_cursor_value_next(cursor))) {
+
+		if (st_empty_out(current, &data, &length)) {
+			continue;
+		}
 
-		while (result == 1 && (current = inx_cursor_value_next(cursor))) {
+		for (size_t i = 0; i < length; i++) {
+			if (!automaton->map[lower_chr(data[i])]) automaton->map[lower_chr(data[i])] = automaton->classes++;
+		}
+
+		limit += length;
+	}
+
+	for (uint_t i = 0; i < 256; i++) {
+		automaton->map[i] = automaton->map[lower_chr(i)];
+	}
+
+	if (limit >= UINT32_MAX || !(automaton->delta = mm_alloc(limit * automaton->classes * sizeof(uint32_t))) ||
+		!(automaton->matches = mm_alloc(limit)) || !(fail = mm_alloc(limit * sizeof(uint32_t))) || !(queue = mm_alloc(limit * sizeof(uint32_t)))) {
+		log_pedantic("Unable to allocate memory for the pattern automaton. { states = %lu / classes = %u }", limit, automaton->classes);
+		inx_cursor_free(cursor);
+		pattern_free(automaton);
+		mm_cleanup(fail, queue);
+		return NULL;
+	}
+
+	// Build a trie out of the patterns. State zero is the root, so a zero transition means the state has no child for that class.
+	automaton->states = 1;
+	inx_cursor_reset(cursor);
+
+	while ((current = inx_cursor_value_next(cursor))) {
+
+		if (st_empty_out(current, &data, &length)) {
+			continue;
+		}
 
-			if (st_search_ci(message, current, &location)) {
-				result = -2;
+		state = 0;
+
+		for (size_t i = 0; i < length; i++) {
+
+			if (!(next = automaton->delta[(state * automaton->classes) + automaton->map[data[i]]])) {
+				next = automaton->delta[(state * automaton->classes) + automaton->map[data[i]]] = automaton->states++;
 			}
 
+			state = next;
 		}
 
-		inx_cursor_free(cursor);
+		automaton->matches[state] = 1;
+	}
+
+	inx_cursor_free(cursor);
+
+	// Walk the trie breadth first, so the failure state of each state has been completed before the state itself. Missing transitions are
+	// copied from the failure state, and a state matches if its failure state does.
+	for (uint32_t c = 0; c < automaton->classes; c++) {
+		if ((next = automaton->delta[c])) {
+			fail[next] = 0;
+			queue[tail++] = next;
+		}
+	}
+
+	while (head < tail) {
+
+		state = queue[head++];
+		automaton->matches[state] |= automaton->matches[fail[state]];
+
+		for (uint32_t c = 0; c < automaton->classes; c++) {
+
+			if ((next = automaton->delta[(state * automaton->classes) + c])) {
+				fail[next] = automaton->delta[(fail[state] * automaton->classes) + c];
+				queue[tail++] = next;
+			}
+			else {
+				automaton->delta[(state * automaton->classes) + c] = automaton->delta[(fail[state] * automaton->classes) + c];
+			}
+		}
+	}
+
+	mm_free(fail);
+	mm_free(queue);
+
+	// Patterns which share a prefix share states, so release the rows which weren't needed.
+	if (automaton->states < limit && (delta = mm_dupe(automaton->delta, automaton->states * automaton->classes * sizeof(uint32_t)))) {
+		mm_free(automaton->delta);
+		automaton->delta = delta;
+	}
+
+	return automaton;
+}
+
+/**
+ * @brief	Check to see if any of the patterns compiled into an automaton are found in a body of text, ignoring case.
+ * @param	automaton	the compiled patterns.
+ * @param	message		a managed string containing the raw data of the text to be searched.
+ * @return	true if a pattern was found, or false if none of the patterns were found, or the text was empty.
+ */
+bool_t pattern_search(pattern_automaton_t *automaton, stringer_t *message) {
+
+	uchr_t *data;
+	size_t length;
+	uint8_t *map, *matches;
+	uint32_t state = 0, classes, *delta;
+
+	if (!automaton || st_empty_out(message, &data, &length)) {
+		return false;
+	}
+
+	map = automaton->map;
+	delta = automaton->delta;
+	matches = automaton->matches;
+	classes = automaton->classes;
+
+	for (size_t i = 0; i < length; i++) {
+
+		state = delta[(state * classes) + map[data[i]]];
+
+		if (matches[state]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief	Check to see if any of the entries in the patterns list are found in a body of text.
+ * @param	message		a managed string containing the raw data of the text to be searched.
+ * @return	-2 on pattern match, -1 if an error occurs, or 1 if none of the patterns in the patterns list were detected.
+ */
+int_t pattern_check(stringer_t *message) {
+
+	int_t result;
+
+	stats_adjust_by_name("objects.patterns.checked", 1);
+
+	rwlock_lock_read(&patterns_lock);
+
+	if (!patterns_automaton) {
+		result = -1;
 	}
+	else if (pattern_search(patterns_automaton, message)) {
+		result = -2;
+	}
+	else {
+		result = 1;
+	}
+
+	rwlock_unlock(&patterns_lock);
 
 	if (result == -2) {
 		stats_adjust_by_name("objects.patterns.fail", 1);
@@ -57,11 +220,14 @@ int_t pattern_check(stringer_t *message) {
 
 /**
  * @brief	Update the patterns list from the database, but no more frequently than once daily.
+ * @note	The patterns are compiled before the lock is taken, so checks only wait on the pointer swap. If the patterns can't be
+ * 			compiled, the previous automaton remains in use.
  * @return	This function returns no value.
  */
 void pattern_update(void) {
 
-	inx_t *patterns_new, *patterns_old;
+	inx_t *patterns;
+	pattern_automaton_t *automaton_new, *automaton_old;
 
 	// Refresh the list of user patterns whenever the date changes.
 	if (patterns_stamp == time_datestamp()) {
@@ -70,34 +236,41 @@ void pattern_update(void) {
 
 	patterns_stamp = time_datestamp();
 
-	// Fetch the patterns and allocate a cursor for iterating.
-	if (!(patterns_new = warehouse_fetch_patterns())) {
+	// Fetch the patterns and compile them.
+	if (!(patterns = warehouse_fetch_patterns())) {
 		return;
 	}
 
-	// Swap the old pointers for the new ones.
-	mutex_lock(&patterns_mutex);
-	patterns_old = patterns_list;
-	patterns_list = patterns_new;
-	mutex_unlock(&patterns_mutex);
+	automaton_new = pattern_compile(patterns);
+	inx_free(patterns);
 
-	// If we replaced an existing index we can free it now.
-	inx_cleanup(patterns_old);
+	if (!automaton_new) {
+		return;
+	}
+
+	// Swap the old pointer for the new one.
+	rwlock_lock_write(&patterns_lock);
+	automaton_old = patterns_automaton;
+	patterns_automaton = automaton_new;
+	rwlock_unlock(&patterns_lock);
+
+	// If we replaced an existing automaton we can free it now.
+	pattern_free(automaton_old);
 
 	return;
 }
 
 /**
- * @brief	Destroy the patterns list.
+ * @brief	Destroy the compiled patterns.
  * @return	This function returns no value.
  */
 void pattern_stop(void) {
 
-	mutex_lock(&patterns_mutex);
+	rwlock_lock_write(&patterns_lock);
 
-	inx_cleanup(patterns_list);
-	patterns_list = NULL;
-	mutex_unlock(&patterns_mutex);
+	pattern_free(patterns_automaton);
+	patterns_automaton = NULL;
+	rwlock_unlock(&patterns_lock);
 
 	return;
 }
@@ -111,4 +284,3 @@ bool_t pattern_start(void) {
 	pattern_update();
 	return true;
 }
-
@@ -20,6 +20,14 @@ typedef struct __attribute__ ((packed)) {
 	stringer_t *domain;
 } domain_t;
 
+typedef struct {
+	uint32_t classes; /* The number of byte classes, which is the width of each row in the transition table. */
+	uint32_t states; /* The number of states, including the root state. */
+	uint8_t map[256]; /* The class of each byte value. Upper and lower case letters share a class, and bytes which aren't in any pattern use class zero. */
+	uint32_t *delta; /* The transition table, which holds a row of classes entries for each state. */
+	uint8_t *matches; /* Whether a pattern ends at each state, either directly, or by way of the failure links. */
+} pattern_automaton_t;
+
 /// datatier.c
 inx_t *  warehouse_fetch_domains(void);
 inx_t *  warehouse_fetch_patterns(void);
@@ -35,10 +43,13 @@ void        domain_stop(void);
 int_t       domain_wildcard(stringer_t *domain);
 
 /// patterns.c
-int_t    pattern_check(stringer_t *message);
-bool_t   pattern_start(void);
-void     pattern_stop(void);
-void     pattern_update(void);
+int_t                  pattern_check(stringer_t *message);
+pattern_automaton_t *  pattern_compile(inx_t *patterns);
+void                   pattern_free(pattern_automaton_t *automaton);
+bool_t                 pattern_search(pattern_automaton_t *automaton, stringer_t *message);
+bool_t                 pattern_start(void);
+void                   pattern_stop(void);
+void                   pattern_update(void);
 
 /// warehouse.c
 bool_t warehouse_start(void);
@@ -53,9 +53,11 @@ const           chr_t * lib_version_dkim(void);
 
 /// dspam.c
 int_t    dspam_check(uint64_t usernum, stringer_t *message, stringer_t **signature);
+void     dspam_prune(void);
 bool_t   dspam_start(void);
 void     dspam_stop(void);
 bool_t   dspam_train(uint64_t usernum, int_t disposition, stringer_t *signature);
+void     dspam_truncate(void);
 bool_t   lib_load_dspam(void);
 chr_t *  lib_version_dspam(void);
 
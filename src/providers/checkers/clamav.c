@@ -350,8 +350,31 @@ int virus_engine_refresh(void) {
 	return 1;
 }
 
+// The scan latency histogram buckets, in milliseconds.
+static uint64_t virus_latency_buckets[] = { 1, 10, 100, 1000 };
+
+static chr_t *virus_latency_names[] = {
+	"provider.virus.latency.1ms", "provider.virus.latency.10ms", "provider.virus.latency.100ms", "provider.virus.latency.1s", "provider.virus.latency.slow"
+};
+
+/**
+ * @brief	Record how long a scan took in the latency histogram, along with the number of bytes scanned.
+ * @param	start	the time the scan started.
+ * @param	length	the number of bytes scanned.
+ * @return	This function returns no value.
+ */
+static void virus_check_record(struct timeval *start, size_t length) {
+
+	stats_latency_by_name(start, virus_latency_buckets, sizeof(virus_latency_buckets) / sizeof(uint64_t), virus_latency_names);
+	stats_adjust_by_name("provider.virus.scan.bytes", length);
+
+	return;
+}
+
 /**
  * @brief	Virus scan a block of data.
+ * @note	The data is scanned directly from memory using a ClamAV map of the buffer. If the map can't be created, the data is
+ * 			written to a temporary file in the scan spool, and the file is scanned instead.
  * @param	data	a managed string containing the block of data to be scanned.
  * @return	1 if the message passed the scan, or < 0 on failure.
  *        -1: general failure, or the virus scanner was not enabled.
@@ -360,9 +383,12 @@ int virus_engine_refresh(void) {
  */
 int virus_check(stringer_t *data) {
 
-	int fd, state;
 	char *virname;
+	int fd = -1, state;
 	ssize_t written;
+	cl_fmap_t *map = NULL;
+	struct timeval start;
+	int_t result = 1;
 	unsigned long int scanned;
 
 	// If we are not supposed to be scanning messages.
@@ -376,26 +402,42 @@ int virus_check(stringer_t *data) {
 		return -1;
 	}
 
+	gettimeofday(&start, NULL);
+
+	// Map the message buffer, so ClamAV can scan it without a trip through the spool.
+	if ((map = cl_fmap_open_memory_d(st_data_get(data), st_length_get(data)))) {
+		stats_increment_by_name("provider.virus.scan.memory");
+	}
+
 	// Create a temporary file to store the message being scanned.
-	if ((fd = spool_mktemp(MAGMA_SPOOL_SCAN, "virus")) < 0) {
+	else if ((fd = spool_mktemp(MAGMA_SPOOL_SCAN, "virus")) < 0) {
 		log_pedantic("Unable to open a temporary file to hold the message being scanned.");
 		stats_increment_by_name("provider.virus.error");
 		return -1;
 	}
 
 	// Stick the message in the file for ClamAV.
-	if ((written = write(fd, st_data_get(data), st_length_get(data))) != st_length_get(data)) {
+	else if ((written = write(fd, st_data_get(data), st_length_get(data))) != st_length_get(data)) {
 		log_error("Not all of the bytes were written to disk. Was %zi, but should have been %zu.", written, st_length_get(data));
 		stats_increment_by_name("provider.virus.error");
 		close(fd);
 		return -1;
 	}
+	else {
+		stats_increment_by_name("provider.virus.scan.spooled");
+	}
 
 	// Scan the message.
 	pthread_rwlock_rdlock(&virus_lock);
-	state = cl_scandesc_d(fd, (const char **)&virname, &scanned, virus_engine, CL_SCAN_STDOPT);
 
-	// If we found something, then spit it back.
+	if (map) {
+		state = cl_scanmap_callback_d(map, (const char **)&virname, &scanned, virus_engine, CL_SCAN_STDOPT, NULL);
+	}
+	else {
+		state = cl_scandesc_d(fd, (const char **)&virname, &scanned, virus_engine, CL_SCAN_STDOPT);
+	}
+
+	// If we found something, then spit it back. The name belongs to the engine, so it must be examined before the lock is released.
 	// http://wiki.clamav.net/Main/MalwareNaming has naming conventions.
 	if (state == CL_VIRUS) {
 
@@ -403,44 +445,38 @@ int virus_check(stringer_t *data) {
 
 		// These are signature based phishing matches.
 		if (!st_cmp_ci_starts(PLACER(virname, ns_length_get(virname)), CONSTANT("Email.Phishing")) || !st_cmp_ci_starts(PLACER(virname, ns_length_get(virname)), CONSTANT("HTML.Phishing"))) {
-			pthread_rwlock_unlock(&virus_lock);
-			stats_increment_by_name("provider.virus.scan.total");
-			stats_increment_by_name("provider.virus.scan.phishing");
-			close(fd);
-			return -3;
+			result = -3;
 		}
 		// We ignore email that ClamAV thinks is a phishing based on scanner's internal heuristic checks.
 		else if (!st_cmp_ci_starts(PLACER(virname, ns_length_get(virname)), CONSTANT("Phishing")) ||
 			!st_cmp_ci_starts(PLACER(virname, ns_length_get(virname)), CONSTANT("Joke"))) {
-			pthread_rwlock_unlock(&virus_lock);
-			stats_increment_by_name("provider.virus.scan.total");
-			stats_increment_by_name("provider.virus.scan.clean");
-			close(fd);
-			return 1;
+			result = 1;
 		}
 		// Its probably a worm, trojan, virus or something similar.
 		else {
-			pthread_rwlock_unlock(&virus_lock);
-			stats_increment_by_name("provider.virus.scan.total");
-			stats_increment_by_name("provider.virus.scan.infected");
-			close(fd);
-			return -2;
+			result = -2;
 		}
 	}
 
 	pthread_rwlock_unlock(&virus_lock);
-	close(fd);
 
-	// Track the number of clean messages. We can do the tracking after the mutex is released.
-	if (state == CL_CLEAN) {
+	if (map) cl_fmap_close_d(map);
+	else close(fd);
+
+	// Track the scan outcomes. We can do the tracking after the lock is released.
+	if (state == CL_VIRUS || state == CL_CLEAN) {
+		virus_check_record(&start, st_length_get(data));
 		stats_increment_by_name("provider.virus.scan.total");
-		stats_increment_by_name("provider.virus.scan.clean");
+
+		if (result == -3) stats_increment_by_name("provider.virus.scan.phishing");
+		else if (result == -2) stats_increment_by_name("provider.virus.scan.infected");
+		else stats_increment_by_name("provider.virus.scan.clean");
 	} else {
-		log_error("An error occurred while scanning a message. {cl_scandesc = %i = %s}", state, cl_strerror_d(state));
+		log_error("An error occurred while scanning a message. {cl_scan = %i = %s}", state, cl_strerror_d(state));
 		stats_increment_by_name("provider.virus.error");
 	}
 
-	return 1;
+	return result;
 }
 
 /**
@@ -460,8 +496,9 @@ bool_t lib_load_clamav(void) {
 
 	symbol_t clamav[] = {
 		M_BIND(cl_countsigs), M_BIND(cl_engine_compile), M_BIND(cl_engine_free), M_BIND(cl_engine_new),	M_BIND(cl_engine_set_num),
-		M_BIND(cl_engine_set_str), M_BIND(cl_init),	M_BIND(cl_load), M_BIND(cl_retver),	M_BIND(cl_scandesc), M_BIND(cl_shutdown),
-		M_BIND(cl_statchkdir), M_BIND(cl_statfree), M_BIND(cl_statinidir), M_BIND(cl_strerror),	M_BIND(lt_dlexit),
+		M_BIND(cl_engine_set_str), M_BIND(cl_fmap_close), M_BIND(cl_fmap_open_memory), M_BIND(cl_init),	M_BIND(cl_load), M_BIND(cl_retver),
+		M_BIND(cl_scandesc), M_BIND(cl_scanmap_callback), M_BIND(cl_shutdown), M_BIND(cl_statchkdir), M_BIND(cl_statfree), M_BIND(cl_statinidir),
+		M_BIND(cl_strerror),	M_BIND(lt_dlexit),
 	};
 
 	if (!lib_symbols(sizeof(clamav) / sizeof(symbol_t), clamav)) {
@@ -9,6 +9,24 @@
 
 extern pool_t *sql_pool;
 
+typedef struct {
+	time_t stamp; /* When the context was last returned to the pool. */
+	uint64_t usernum; /* The user the context, and the totals it holds, belong to. */
+	DSPAM_CTX *ctx;
+	struct _mysql_drv_dbh dbh; /* The storage driver keeps a pointer to this handle, so it's pointed at whichever connection is held by the caller. */
+} dspam_context_t;
+
+static struct {
+	uint32_t count, limit;
+	pthread_mutex_t lock;
+	dspam_context_t **idle;
+} dspam_contexts = {
+	.count = 0,
+	.limit = 0,
+	.idle = NULL,
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
 /**
  * @brief	Return the version string of the dspam library.
  * @return	a pointer to a character string containing the dspam library version information.
@@ -25,7 +43,7 @@ bool_t lib_load_dspam(void) {
 
 	symbol_t dspam[] = {
 		M_BIND(dspam_attach), M_BIND(dspam_create), M_BIND(dspam_destroy), M_BIND(dspam_detach), M_BIND(dspam_init_driver),
-		M_BIND(dspam_process), M_BIND(dspam_shutdown_driver), M_BIND(dspam_version)
+		M_BIND(dspam_process), M_BIND(dspam_shutdown_driver), M_BIND(dspam_version), M_BIND(_ds_destroy_message), M_BIND(_ds_factor_destroy)
 	};
 
 	if (lib_symbols(sizeof(dspam) / sizeof(symbol_t), dspam) != 1) {
@@ -35,15 +53,313 @@ bool_t lib_load_dspam(void) {
 	return true;
 }
 
+/**
+ * @brief	Clear the per message state left inside a DSPAM context, so the context can be used to process another message.
+ * @note	The library only releases these fields when the context is destroyed, and it parses the message again only when the
+ * 			message field is empty, so every field set by dspam_process() has to be reset before the context is reused.
+ * @param	ctx		the DSPAM context to be reset.
+ * @return	This function returns no value.
+ */
+static void dspam_context_reset(DSPAM_CTX *ctx) {
+
+	if (ctx->message) {
+		_ds_destroy_message_d(ctx->message);
+		ctx->message = NULL;
+	}
+
+	// A signature provided by the caller belongs to the caller, otherwise it was allocated by the library.
+	if (!ctx->_sig_provided && ctx->signature) {
+		free(ctx->signature->data);
+		free(ctx->signature);
+	}
+
+	if (ctx->factors) {
+		_ds_factor_destroy_d(ctx->factors);
+		ctx->factors = NULL;
+	}
+
+	ctx->signature = NULL;
+	ctx->_sig_provided = 0;
+
+	ctx->learned = 0;
+	ctx->class[0] = '\0';
+	ctx->result = DSR_NONE;
+	ctx->source = DSS_NONE;
+	ctx->classification = DSR_NONE;
+	ctx->probability = DSP_UNCALCULATED;
+	ctx->confidence = 0;
+
+	ctx->operating_mode = DSM_PROCESS;
+	ctx->training_mode = DST_TEFT;
+
+	return;
+}
+
+/**
+ * @brief	Detach a DSPAM context from the statistical database, writing back any changes to the user totals, and then destroy it.
+ * @param	context		the context to be destroyed.
+ * @param	handle		the database connection used to write back the user totals, or NULL to discard them.
+ * @return	This function returns no value.
+ */
+static void dspam_context_free(dspam_context_t *context, MYSQL *handle) {
+
+	int_t ret;
+
+	if (!context) {
+		return;
+	}
+
+	// Without a connection the totals can't be written, and the library only skips writing them when it thinks nothing could have changed.
+	if (!(context->dbh.dbh_read = context->dbh.dbh_write = handle)) {
+		log_pedantic("Discarding the message totals of an idle DSPAM context. {usernum = %lu}", context->usernum);
+		context->ctx->operating_mode = DSM_CLASSIFY;
+	}
+
+	if (context->ctx->storage && (ret = dspam_detach_d(context->ctx))) {
+		log_pedantic("Could not detach the DB connection. {dspam_detach = %i}", ret);
+	}
+
+	dspam_destroy_d(context->ctx);
+	mm_free(context);
+
+	return;
+}
+
+/**
+ * @brief	Get a DSPAM context for a user, attached to the statistical database, reusing an idle context if one is available.
+ * @note	A reused context still holds the user totals, and the user id, loaded when it was attached, so the storage driver doesn't
+ * 			have to load them again. The context is pointed at the database connection held by the caller.
+ * @param	usernum		the numerical id of the user whose statistics should be used.
+ * @param	connection	the database connection reserved by the caller.
+ * @return	NULL on failure, or a pointer to the context, which must be returned using dspam_context_release().
+ */
+static dspam_context_t * dspam_context_acquire(uint64_t usernum, uint32_t connection) {
+
+	int_t ret;
+	chr_t unum[20];
+	stringer_t *tmpdir;
+	dspam_context_t *context = NULL;
+
+	mutex_lock(&(dspam_contexts.lock));
+
+	for (uint32_t i = 0; !context && i < dspam_contexts.count; i++) {
+		if (dspam_contexts.idle[i]->usernum == usernum) {
+			context = dspam_contexts.idle[i];
+			dspam_contexts.idle[i] = dspam_contexts.idle[--dspam_contexts.count];
+		}
+	}
+
+	mutex_unlock(&(dspam_contexts.lock));
+
+	if (context) {
+		context->dbh.dbh_read = context->dbh.dbh_write = pool_get_obj(sql_pool, connection);
+		stats_increment_by_name("provider.spam.contexts.reused");
+		return context;
+	}
+
+	// Generate a string version of the dispatch number.
+	if (snprintf(unum, 20, "%lu", usernum) <= 0 || !(context = mm_alloc(sizeof(dspam_context_t))) || !(tmpdir = spool_path(MAGMA_SPOOL_DATA))) {
+		log_pedantic("Context setup error.");
+		mm_cleanup(context);
+		return NULL;
+	}
+	// Initialize the DSPAM context.
+	else if (!(context->ctx = dspam_create_d(unum, NULL, st_char_get(tmpdir), DSM_PROCESS, DSF_SIGNATURE | DSF_NOISE | DSF_WHITELIST))) {
+		log_pedantic("An error occurred inside the DSPAM library. {dspam_create = NULL}");
+		st_free(tmpdir);
+		mm_free(context);
+		return NULL;
+	}
+
+	st_free(tmpdir);
+
+	// Setup the database handle in a structure format.
+	context->usernum = usernum;
+	context->dbh.dbh_read = context->dbh.dbh_write = pool_get_obj(sql_pool, connection);
+
+	if ((ret = dspam_attach_d(context->ctx, &(context->dbh)))) {
+		log_pedantic("An error occurred while attaching to the statistical database. {dspam_attach = %i}", ret);
+		dspam_context_free(context, pool_get_obj(sql_pool, connection));
+		return NULL;
+	}
+
+	// Tokenization method and statistical algorithm.
+	context->ctx->algorithms = DSA_GRAHAM | DSA_BURTON | DSP_GRAHAM;
+	context->ctx->tokenizer = DSZ_CHAIN;
+
+	stats_increment_by_name("provider.spam.contexts.created");
+
+	return context;
+}
+
+/**
+ * @brief	Return a DSPAM context to the pool of idle contexts, or destroy it.
+ * @note	When the pool is full, the least recently used context is destroyed instead, and its totals are written back using the
+ * 			connection held by the caller.
+ * @param	context		the context being returned.
+ * @param	connection	the database connection reserved by the caller, which is still held.
+ * @param	reuse		if false, the context is destroyed, since it may have been left in an unknown state.
+ * @return	This function returns no value.
+ */
+static void dspam_context_release(dspam_context_t *context, uint32_t connection, bool_t reuse) {
+
+	dspam_context_t *victim = NULL;
+
+	dspam_context_reset(context->ctx);
+
+	if (!reuse || !dspam_contexts.limit || (context->stamp = time(NULL)) == (time_t)(-1)) {
+		dspam_context_free(context, pool_get_obj(sql_pool, connection));
+		return;
+	}
+
+	mutex_lock(&(dspam_contexts.lock));
+
+	// If a user had several messages processed at once, the pool already holds a context for them, so that's the one replaced.
+	for (uint32_t i = 0; !victim && i < dspam_contexts.count; i++) {
+		if (dspam_contexts.idle[i]->usernum == context->usernum) {
+			victim = dspam_contexts.idle[i];
+			dspam_contexts.idle[i] = context;
+		}
+	}
+
+	if (!victim && dspam_contexts.count < dspam_contexts.limit) {
+		dspam_contexts.idle[dspam_contexts.count++] = context;
+	}
+	else if (!victim) {
+
+		uint32_t oldest = 0;
+
+		for (uint32_t i = 1; i < dspam_contexts.count; i++) {
+			if (dspam_contexts.idle[i]->stamp < dspam_contexts.idle[oldest]->stamp) oldest = i;
+		}
+
+		victim = dspam_contexts.idle[oldest];
+		dspam_contexts.idle[oldest] = context;
+	}
+
+	mutex_unlock(&(dspam_contexts.lock));
+
+	if (victim) {
+		stats_increment_by_name("provider.spam.contexts.evicted");
+		dspam_context_free(victim, pool_get_obj(sql_pool, connection));
+	}
+
+	return;
+}
+
+/**
+ * @brief	Destroy the idle DSPAM contexts which haven't been used within the configured timeout, or all of them.
+ * @param	all		if true, every idle context is destroyed, regardless of when it was last used.
+ * @return	This function returns no value.
+ */
+static void dspam_context_expire(bool_t all) {
+
+	time_t now;
+	uint32_t connection;
+	MYSQL *handle = NULL;
+	dspam_context_t *context;
+
+	if (!dspam_contexts.limit || (now = time(NULL)) == (time_t)(-1)) {
+		return;
+	}
+
+	// The totals held by the expired contexts are written back using a connection from the pool.
+	if (pool_pull(sql_pool, &connection) != PL_RESERVED) {
+		log_info("Unable to get an available connection for the query.");
+		if (!all) return;
+	}
+	else if (sql_ping(connection) < 0 || !stmt_rebuild(connection)) {
+		log_info("The database connection has been lost and the reconnection attempt failed.");
+		pool_release(sql_pool, connection);
+		if (!all) return;
+	}
+	else {
+		handle = pool_get_obj(sql_pool, connection);
+	}
+
+	do {
+
+		context = NULL;
+
+		mutex_lock(&(dspam_contexts.lock));
+
+		for (uint32_t i = 0; !context && i < dspam_contexts.count; i++) {
+			if (all || dspam_contexts.idle[i]->stamp + magma.iface.spam.timeout <= now) {
+				context = dspam_contexts.idle[i];
+				dspam_contexts.idle[i] = dspam_contexts.idle[--dspam_contexts.count];
+			}
+		}
+
+		mutex_unlock(&(dspam_contexts.lock));
+
+		if (context) {
+			if (!all) stats_increment_by_name("provider.spam.contexts.expired");
+			dspam_context_free(context, handle);
+		}
+
+	} while (context);
+
+	if (handle) {
+		pool_release(sql_pool, connection);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Write back and destroy the idle DSPAM contexts which haven't been used within magma.iface.spam.timeout seconds.
+ * @return	This function returns no value.
+ */
+void dspam_prune(void) {
+	dspam_context_expire(false);
+	return;
+}
+
+/**
+ * @brief	Write back and destroy every idle DSPAM context.
+ * @return	This function returns no value.
+ */
+void dspam_truncate(void) {
+	dspam_context_expire(true);
+	return;
+}
+
+/**
+ * @brief	Initialize the DSPAM storage driver, and allocate the pool of idle contexts.
+ * @return	true on success or false on failure.
+ */
 bool_t dspam_start(void) {
+
 	if (dspam_init_driver_d(NULL) != 0) {
 		return false;
 	}
+	else if (magma.iface.spam.contexts && !(dspam_contexts.idle = mm_alloc(sizeof(dspam_context_t *) * magma.iface.spam.contexts))) {
+		log_critical("Unable to allocate memory for the pool of DSPAM contexts.");
+		dspam_shutdown_driver_d(NULL);
+		return false;
+	}
+
+	dspam_contexts.limit = magma.iface.spam.contexts;
+
 	return true;
 }
 
+/**
+ * @brief	Write back and destroy the idle DSPAM contexts, then shutdown the storage driver.
+ * @return	This function returns no value.
+ */
 void dspam_stop(void) {
+
+	dspam_truncate();
+
+	if (dspam_contexts.idle) {
+		mm_free(dspam_contexts.idle);
+		dspam_contexts.idle = NULL;
+	}
+
+	dspam_contexts.limit = 0;
 	dspam_shutdown_driver_d(NULL);
+
 	return;
 }
 
@@ -53,112 +369,63 @@ void dspam_stop(void) {
 /// Layman's terms: How spammy is this message
 int_t dspam_check(uint64_t usernum, stringer_t *message, stringer_t **signature) {
 
-	DSPAM_CTX *ctx;
-	chr_t unum[20];
+	int_t result, ret;
 	uint32_t connection;
-	int_t result = 2, ret;
-	struct _mysql_drv_dbh dbh;
-	stringer_t *tmpdir, *output;
-
-	// Generate a string version of the dispatch number.
-	if (snprintf(unum, 20, "%lu", usernum) <= 0 || !(tmpdir = spool_path(MAGMA_SPOOL_DATA))) {
-		log_pedantic("Context setup error.");
-		return -1;
-	}
-	// Initialize the DSPAM context.
-	else if (!(ctx = dspam_create_d(unum, NULL, st_char_get(tmpdir), DSM_PROCESS, DSF_SIGNATURE | DSF_NOISE | DSF_WHITELIST))) {
-		log_pedantic("An error occurred inside the DSPAM library. {dspam_create = NULL}");
-		st_free(tmpdir);
-    return -1;
- 	}
-
-	st_free(tmpdir);
+	stringer_t *output;
+	dspam_context_t *context;
 
 	if (pool_pull(sql_pool, &connection) != PL_RESERVED) {
 		log_info("Unable to get an available connection for the query.");
-		dspam_destroy_d(ctx);
 		return -1;
 	}
 	else if (sql_ping(connection) < 0 || !stmt_rebuild(connection)) {
 		log_info("The database connection has been lost and the reconnection attempt failed.");
-		dspam_destroy_d(ctx);
+		pool_release(sql_pool, connection);
 		return -1;
 	}
-
-	// Setup the database handle in a structure format.
-	dbh.dbh_read = pool_get_obj(sql_pool, connection);
-	dbh.dbh_write = pool_get_obj(sql_pool, connection);
-
-	if ((ret = dspam_attach_d(ctx, &dbh))) {
-   	if (dspam_detach_d(ctx) != 0) {
-			log_pedantic("Could not detach the DB connection.");
-		}
+	else if (!(context = dspam_context_acquire(usernum, connection))) {
 		pool_release(sql_pool, connection);
-		log_pedantic("An error occurred while attaching to the statistical database. {dspam_attach = %i}", ret);
-		dspam_destroy_d(ctx);
 		return -1;
-  }
-
-	// Tokenization method and statistical algorithm.
-	ctx->algorithms = DSA_GRAHAM | DSA_BURTON | DSP_GRAHAM;
-	ctx->tokenizer = DSZ_CHAIN;
+	}
 
 	// To prevent the message tokens from being stored in the database we disable training.
-	ctx->training_mode = DST_NOTRAIN;
+	context->ctx->training_mode = DST_NOTRAIN;
 
 	// This actually processes the message.
-	if ((ret = dspam_process_d(ctx, st_char_get(message)))) {
-		if (dspam_detach_d(ctx) != 0) {
-			log_pedantic("Could not detach the DB connection.");
-		}
-		pool_release(sql_pool, connection);
+	if ((ret = dspam_process_d(context->ctx, st_char_get(message)))) {
 		log_pedantic("An error occurred while analyzing an email with DSPAM. {dspam_process = %i}", ret);
-		dspam_destroy_d(ctx);
-    return -1;
-	}
-
-	// We assume that the SQL connection will no longer be needed.
-	if ((ret = dspam_detach_d(ctx))) {
-		log_pedantic("Could not detach the DB connection. {dspam_detach = %i}", ret);
+		dspam_context_release(context, connection, false);
 		pool_release(sql_pool, connection);
-		dspam_destroy_d(ctx);
-    return -1;
+		return -1;
 	}
 
-	// Return the connection to our pool.
-	pool_release(sql_pool, connection);
-
 	// Check to see if the message is junk mail.
-	if (ctx->result == DSR_ISSPAM) {
+	if (context->ctx->result == DSR_ISSPAM) {
 		result = -2;
 	}
 	else {
 		result = 1;
 	}
 
-	//log_pedantic("Probability: %2.4f Confidence: %2.4f, Result: %s", ctx->probability, ctx->confidence,
- 	//	(ctx->result == DSR_ISSPAM) ? "JUNK" : "INNOCENT");
-
 	// See what happens if we don't get a signature back.
-	if (ctx->signature == NULL) {
+	if (context->ctx->signature == NULL) {
 		log_error("DSPAM did not return a signature. {ctx->signature = NULL}");
-		dspam_destroy_d(ctx);
-    return result;
-  }
-
+	}
 	// Copy over the signature.
-	if (!(output = st_import(ctx->signature->data, ctx->signature->length))) {
-		log_pedantic("Could not import the statistical signature. {length = %lu}", ctx->signature->length);
-		dspam_destroy_d(ctx);
-		return result;
-  }
-
-	if (signature) {
+	else if (!(output = st_import(context->ctx->signature->data, context->ctx->signature->length))) {
+		log_pedantic("Could not import the statistical signature. {length = %lu}", context->ctx->signature->length);
+	}
+	else if (signature) {
 		*signature = output;
 	}
+	else {
+		st_free(output);
+	}
+
+	// Return the context, and then the connection, to their pools.
+	dspam_context_release(context, connection, true);
+	pool_release(sql_pool, connection);
 
-	// Destroy the context and return the result.
-	dspam_destroy_d(ctx);
 	return result;
 }
 
@@ -173,74 +440,39 @@ int_t dspam_check(uint64_t usernum, stringer_t *message, stringer_t **signature)
 bool_t dspam_train(uint64_t usernum, int_t disposition, stringer_t *signature) {
 
 	int_t ret;
-	DSPAM_CTX *ctx;
-	chr_t unum[20];
-	stringer_t *tmpdir;
 	uint32_t connection;
-	struct _mysql_drv_dbh dbh;
+	dspam_context_t *context;
 	struct _ds_spam_signature sig;
 
-	// Generate a string version of the dispatch number.
-	if (snprintf(unum, 20, "%lu", usernum) <= 0 || !(tmpdir = spool_path(MAGMA_SPOOL_DATA))) {
-		log_pedantic("Context setup error.");
-		return false;
-	}
-	// Initialize the DSPAM context.
-	else if (!(ctx = dspam_create_d(unum, NULL, st_char_get(tmpdir), DSM_PROCESS, DSF_SIGNATURE | DSF_NOISE | DSF_WHITELIST))) {
-		log_pedantic("An error occurred inside the DSPAM library. {dspam_create = NULL}");
-		st_free(tmpdir);
-		return false;
- 	}
-
-	st_free(tmpdir);
-
 	// Get a DB connection.
 	if (pool_pull(sql_pool, &connection) != PL_RESERVED) {
 		log_info("Unable to get an available connection for the query.");
-		dspam_destroy_d(ctx);
 		return false;
 	}
 	else if (sql_ping(connection) < 0 || !stmt_rebuild(connection)) {
 		log_info("The database connection has been lost and the reconnection attempt failed.");
-		dspam_destroy_d(ctx);
+		pool_release(sql_pool, connection);
 		return false;
 	}
-
-	// Setup the database handle in a structure format.
-	dbh.dbh_read = pool_get_obj(sql_pool, connection);
-	dbh.dbh_write = pool_get_obj(sql_pool, connection);
-
-	if ((ret = dspam_attach_d(ctx, &dbh))) {
-
-		if (dspam_detach_d(ctx) != 0) {
-			log_pedantic("Could not detach the DB connection.");
-		}
-
+	else if (!(context = dspam_context_acquire(usernum, connection))) {
 		pool_release(sql_pool, connection);
-		log_pedantic("An error occurred while attaching to the statistical database. {dspam_attach = %i}", ret);
-		dspam_destroy_d(ctx);
 		return false;
 	}
 
-	// Tokenization method and statistical algorithm.
-	ctx->algorithms = DSA_GRAHAM | DSA_BURTON | DSP_GRAHAM;
-	ctx->tokenizer = DSZ_CHAIN;
-
 	// Setup the classification as opposite of what the original was.
-	ctx->classification = disposition ? DSR_ISINNOCENT : DSR_ISSPAM;
+	context->ctx->classification = disposition ? DSR_ISINNOCENT : DSR_ISSPAM;
 
 	// Set up the context for error correction.
-	ctx->source = DSS_ERROR;
+	context->ctx->source = DSS_ERROR;
 
 	// Setup the signature.
 	sig.length = st_length_get(signature);
 	sig.data = st_char_get(signature);
-	ctx->signature = &sig;
+	context->ctx->signature = &sig;
 
-	// Call DSPAM, and then destroy the context.
-	ret = dspam_process_d(ctx, NULL);
-	dspam_detach_d(ctx);
-	dspam_destroy_d(ctx);
+	// Call DSPAM. The updated totals are written back when the context is destroyed.
+	ret = dspam_process_d(context->ctx, NULL);
+	dspam_context_release(context, connection, !ret);
 	pool_release(sql_pool, connection);
 
 	if (ret) {
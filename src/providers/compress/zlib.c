@@ -10,6 +10,9 @@
 int (*deflateEnd_d)(z_streamp strm) = NULL;
 int (*deflate_d)(z_streamp strm, int flush) = NULL;
 int (*deflateInit2__d)(z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy, const char *version, int stream_size) = NULL;
+int (*inflateEnd_d)(z_streamp strm) = NULL;
+int (*inflate_d)(z_streamp strm, int flush) = NULL;
+int (*inflateInit2__d)(z_streamp strm, int windowBits, const char *version, int stream_size) = NULL;
 
 /**
  * @brief	Return the version string of zlib.
@@ -27,7 +30,7 @@ bool_t lib_load_zlib(void) {
 
 	symbol_t zlib[] = {
 		M_BIND(compress2), M_BIND(compressBound), M_BIND(deflate), M_BIND(deflateEnd),	M_BIND(deflateInit2_),
-		M_BIND(uncompress),	M_BIND(zlibVersion)
+		M_BIND(inflate), M_BIND(inflateEnd), M_BIND(inflateInit2_), M_BIND(uncompress),	M_BIND(zlibVersion)
 	};
 
 	if (lib_symbols(sizeof(zlib) / sizeof(symbol_t), zlib) != 1) {
@@ -20,7 +20,7 @@ bool_t lib_load_cache(void) {
 		M_BIND(memcached_decrement), M_BIND(memcached_decrement_with_initial), M_BIND(memcached_delete), M_BIND(memcached_flush),
 		M_BIND(memcached_free), M_BIND(memcached_get), M_BIND(memcached_increment),	M_BIND(memcached_increment_with_initial),
 		M_BIND(memcached_lib_version), M_BIND(memcached_prepend), M_BIND(memcached_replace), M_BIND(memcached_server_add_with_weight),
-		M_BIND(memcached_set), M_BIND(memcached_strerror)
+		M_BIND(memcached_set), M_BIND(memcached_strerror), M_BIND(memcached_mget), M_BIND(memcached_fetch)
 	};
 
 	if (lib_symbols(sizeof(cache) / sizeof(symbol_t), cache) != 1) {
@@ -221,6 +221,67 @@ uint64_t cache_get_u64(stringer_t *key) {
 	return result;
 }
 
+/**
+ * @brief	Retrieve a collection of counter values from memcached using a single round trip.
+ * @note	Counters are created by the increment/decrement functions and are stored by the server as decimal strings. Any key
+ * 			that isn't found, or whose value can't be parsed, is returned as zero.
+ * @param	count	the number of keys being requested.
+ * @param	keys	an array of managed strings holding the key names.
+ * @param	values	an array of 64 bit integers which will receive the counter values.
+ * @return	false on failure, or true if the request was executed successfully.
+ */
+bool_t cache_get_counters(size_t count, stringer_t *keys[], uint64_t values[]) {
+
+	void *data;
+	uint32_t flags = 0, pool;
+	memcached_st *object;
+	memcached_return_t error;
+	chr_t key[MEMCACHED_MAX_KEY];
+	const chr_t *names[count];
+	size_t klen = 0, vlen = 0, lengths[count], digits;
+
+	if (!count || !keys || !values || (pool_pull(cache_pool, &pool)) != PL_RESERVED) {
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		names[i] = st_char_get(keys[i]);
+		lengths[i] = st_length_get(keys[i]);
+		values[i] = 0;
+	}
+
+	object = pool_get_obj(cache_pool, pool);
+
+	if ((error = memcached_mget_d(object, names, lengths, count)) != MEMCACHED_SUCCESS) {
+		log_info("Unable to request the %zu counter objects. {%s}", count, memcached_strerror_d(object, error));
+		pool_release(cache_pool, pool);
+		return false;
+	}
+
+	// Read every value returned, even if we can't match the key, otherwise the connection would be left in an inconsistent state.
+	while ((data = memcached_fetch_d(object, key, &klen, &vlen, &flags, &error))) {
+
+		for (digits = 0; digits < vlen && chr_numeric(*((chr_t *)data + digits)); digits++);
+
+		for (size_t i = 0; i < count; i++) {
+			if (klen == lengths[i] && !mm_cmp_cs_eq(key, (void *)names[i], klen) && (!digits || !uint64_conv_bl(data, digits, &values[i]))) {
+				values[i] = 0;
+			}
+		}
+
+		mm_free(data);
+	}
+
+	if (error != MEMCACHED_END && error != MEMCACHED_SUCCESS && error != MEMCACHED_NOTFOUND) {
+		log_info("An error occurred while trying to fetch the %zu counter objects. {%s}", count, memcached_strerror_d(object, error));
+		pool_release(cache_pool, pool);
+		return false;
+	}
+
+	pool_release(cache_pool, pool);
+	return true;
+}
+
 /**
  * @brief	Set a value in memcached by key.
  * @param	key			a managed string containing a key to be passed to memcached.
@@ -22,6 +22,7 @@ int_t         cache_delete(stringer_t *key);
 void          cache_flush(void);
 stringer_t *  cache_get(stringer_t *key);
 uint64_t      cache_get_u64(stringer_t *key);
+bool_t        cache_get_counters(size_t count, stringer_t *keys[], uint64_t values[]);
 uint64_t      cache_increment(stringer_t *key, uint64_t offset, uint64_t initial, time_t expiration);
 int_t         cache_set(stringer_t *key, stringer_t *object, time_t expiration);
 int_t         cache_set_u64(stringer_t *key, uint64_t value, time_t expiration);
@@ -157,6 +157,7 @@ void *        tls_client_alloc(int_t sockd);
 int           tls_continue(TLS *tls, int result, int syserror);
 stringer_t *  tls_error(TLS *tls, int_t code, stringer_t *output);
 void          tls_free(TLS *tls);
+int           tls_pending(TLS *tls);
 int           tls_print(TLS *tls, const char *format, va_list args);
 int           tls_read(TLS *tls, void *buffer, int length, bool_t block);
 TLS *         tls_server_alloc(void *server, int sockd, int flags);
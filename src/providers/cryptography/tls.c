@@ -410,6 +410,23 @@ int tls_status(TLS *tls) {
 	return result;
 }
 
+/**
+ * @brief	Return the number of decrypted bytes already buffered by a TLS connection, which can be read without touching the socket.
+ * @see		SSL_pending()
+ * @param	tls		the TLS connection to be checked.
+ * @return	the number of buffered bytes available, or 0 if none are pending.
+ */
+int tls_pending(TLS *tls) {
+
+	int_t result = 0;
+
+	if (tls) {
+		result = SSL_pending_d(tls);
+	}
+
+	return result;
+}
+
 /**
  * @brief	Consolidate the complicated logic associated with handling SSL_read/SSL_write calls which result in 0, or a negative number.
  */
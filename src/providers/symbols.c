@@ -27,6 +27,8 @@ memcached_return_t (*memcached_replace_d)(memcached_st *ptr, const char *key, si
 memcached_return_t (*memcached_cas_d)(memcached_st *ptr, const char *key, size_t key_length, const char *value, size_t value_length, time_t expiration, uint32_t flags, uint64_t cas) = NULL;
 memcached_return_t (*memcached_decrement_with_initial_d)(memcached_st *ptr, const char *key, size_t key_length, uint64_t offset, uint64_t initial, time_t expiration, uint64_t *value) = NULL;
 memcached_return_t (*memcached_increment_with_initial_d)(memcached_st *ptr, const char *key, size_t key_length, uint64_t offset, uint64_t initial, time_t expiration, uint64_t *value) = NULL;
+memcached_return_t (*memcached_mget_d)(memcached_st *ptr, const char * const *keys, const size_t *key_length, size_t number_of_keys) = NULL;
+char * (*memcached_fetch_d)(memcached_st *ptr, char *key, size_t *key_length, size_t *value_length, uint32_t *flags, memcached_return_t *error) = NULL;
 
 //! BZIP
 const char * (*BZ2_bzlibVersion_d)(void) = NULL;
@@ -50,6 +52,9 @@ int (*cl_engine_set_num_d)(struct cl_engine *engine, enum cl_engine_field field,
 int (*cl_engine_set_str_d)(struct cl_engine *engine, enum cl_engine_field field, const char *str) = NULL;
 int (*cl_load_d)(const char *path, struct cl_engine *engine, unsigned int *signo, unsigned int dboptions) = NULL;
 int (*cl_scandesc_d)(int desc, const char **virname, unsigned long int *scanned, const struct cl_engine *engine, unsigned int scanoptions) = NULL;
+void (*cl_fmap_close_d)(cl_fmap_t *map) = NULL;
+cl_fmap_t * (*cl_fmap_open_memory_d)(const void *start, size_t len) = NULL;
+int (*cl_scanmap_callback_d)(cl_fmap_t *map, const char **virname, unsigned long int *scanned, const struct cl_engine *engine, unsigned int scanoptions, void *context) = NULL;
 
 //! DSPAM
 const char * (*dspam_version_d)(void) = NULL;
@@ -60,6 +65,8 @@ int (*dspam_shutdown_driver_d)(DRIVER_CTX *DTX) = NULL;
 int (*dspam_attach_d)(DSPAM_CTX *CTX, void *dbh) = NULL;
 int (*dspam_process_d)(DSPAM_CTX * CTX, const char *message) = NULL;
 DSPAM_CTX * (*dspam_create_d)(const char *username, const char *group, const char *home, int operating_mode, u_int32_t flags) = NULL;
+void (*_ds_destroy_message_d)(ds_message_t message) = NULL;
+void (*_ds_factor_destroy_d)(struct nt *factors) = NULL;
 
 //! DKIM
 /// @note that dkim_getsighdr_d is used by the library, so were using dkim_getsighdrx_d.
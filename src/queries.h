@@ -48,21 +48,25 @@
 #define UPDATE_LOG_WEB "UPDATE Log SET lastweb = NOW(), websessions = websessions + 1 WHERE usernum = ?"
 
 // Folder table
-#define SELECT_FOLDERS "SELECT foldernum, parent, `order`, foldername FROM Folders WHERE usernum = ? AND type = ?"
+#define SELECT_FOLDERS "SELECT foldernum, parent, `order`, foldername, modseq FROM Folders WHERE usernum = ? AND type = ?"
 #define INSERT_FOLDER "INSERT INTO Folders (usernum, foldername, `order`, parent, type) VALUES (?, ?, ?, ?, ?)"
 #define DELETE_FOLDER "DELETE FROM Folders WHERE foldernum = ? AND usernum = ? AND type = ?"
 #define UPDATE_FOLDER "UPDATE Folders SET foldername = ?, parent = ?, `order` = ? WHERE foldernum = ? AND usernum = ? AND type = ?"
 #define RENAME_FOLDER "UPDATE Folders SET foldername = ? WHERE foldernum = ? AND usernum = ? AND type = ?"
+#define UPDATE_FOLDER_MODSEQ "UPDATE Folders SET modseq = modseq + 1 WHERE foldernum = ? AND usernum = ?"
+#define UPDATE_FOLDER_MODSEQ_MESSAGE "UPDATE Folders SET modseq = modseq + 1 WHERE usernum = ? AND foldernum = (SELECT foldernum FROM Messages WHERE messagenum = ? AND usernum = ?)"
+#define SELECT_FOLDER_MODSEQ "SELECT modseq FROM Folders WHERE foldernum = ? AND usernum = ?"
 
 // Messages table
-#define SELECT_MESSAGES "SELECT messagenum, foldernum, server, status, size, signum, sigkey, UNIX_TIMESTAMP(created) FROM Messages WHERE usernum = ? AND visible = 1 ORDER BY messagenum ASC"
+#define SELECT_MESSAGES "SELECT messagenum, foldernum, server, status, size, signum, sigkey, UNIX_TIMESTAMP(created), modseq FROM Messages WHERE usernum = ? AND visible = 1 ORDER BY messagenum ASC"
 #define UPDATE_MESSAGE_VISIBILITY "UPDATE Messages SET visible = 0 WHERE messagenum = ?"
-#define UPDATE_MESSAGE_FLAGS_ADD "UPDATE Messages SET status = (status | ?) WHERE usernum = ? AND foldernum = ? AND messagenum = ?"
-#define UPDATE_MESSAGE_FLAGS_REMOVE "UPDATE Messages SET status = ((status | ?) ^ ?) WHERE usernum = ? AND foldernum = ? AND messagenum = ?"
-#define UPDATE_MESSAGE_FLAGS_REPLACE  "UPDATE Messages SET status = (((status | ?) ^ ?) | ?) WHERE usernum = ? AND foldernum = ? AND messagenum = ?"
-#define UPDATE_MESSAGE_FOLDER "UPDATE Messages SET foldernum = ? WHERE messagenum = ? AND usernum = ? AND foldernum = ?"
-#define INSERT_MESSAGE "INSERT INTO Messages (usernum, foldernum, server, status, size, signum, sigkey, created) VALUES (?, ?, ?, ?, ?, ?, ?, NOW())"
-#define INSERT_MESSAGE_DUPLICATE "INSERT INTO Messages (usernum, foldernum, server, status, size, signum, sigkey, created) VALUES (?, ?, ?, ?, ?, ?, ?, FROM_UNIXTIME(?))"
+#define UPDATE_MESSAGE_FLAGS_ADD "UPDATE Messages SET modseq = IF((status | ?) = status, modseq, GREATEST(modseq, ?)), status = (status | ?) WHERE usernum = ? AND foldernum = ? AND messagenum = ?"
+#define UPDATE_MESSAGE_FLAGS_REMOVE "UPDATE Messages SET modseq = IF((status & ?) = 0, modseq, GREATEST(modseq, ?)), status = ((status | ?) ^ ?) WHERE usernum = ? AND foldernum = ? AND messagenum = ?"
+#define UPDATE_MESSAGE_FLAGS_REPLACE  "UPDATE Messages SET modseq = IF((((status | ?) ^ ?) | ?) = status, modseq, GREATEST(modseq, ?)), status = (((status | ?) ^ ?) | ?) WHERE usernum = ? AND foldernum = ? AND messagenum = ?"
+#define UPDATE_MESSAGE_FOLDER "UPDATE Messages SET foldernum = ?, modseq = ? WHERE messagenum = ? AND usernum = ? AND foldernum = ?"
+#define UPDATE_MESSAGE_FOLDER_RANGE "UPDATE Messages SET foldernum = ?, modseq = ? WHERE usernum = ? AND foldernum = ? AND visible = 1 AND messagenum BETWEEN ? AND ?"
+#define INSERT_MESSAGE "INSERT INTO Messages (usernum, foldernum, server, status, size, signum, sigkey, modseq, created) VALUES (?, ?, ?, ?, ?, ?, ?, ?, NOW())"
+#define INSERT_MESSAGE_DUPLICATE "INSERT INTO Messages (usernum, foldernum, server, status, size, signum, sigkey, modseq, created) VALUES (?, ?, ?, ?, ?, ?, ?, ?, FROM_UNIXTIME(?))"
 #define DELETE_MESSAGE "DELETE FROM Messages WHERE messagenum = ? AND usernum = ?"
 
 // Message Tags table
@@ -72,6 +76,27 @@
 #define INSERT_MESSAGE_TAG "INSERT INTO Message_Tags (messagenum, tag) VALUES (?, ?)"
 #define DELETE_MESSAGE_TAG "DELETE FROM Message_Tags WHERE messagenum = ? AND tag = ?"
 
+// Message Envelopes table
+#define SELECT_MESSAGE_ENVELOPES "SELECT Message_Envelopes.messagenum, sender, recipient, reply_to, return_path, subject, sent, snippet, cc, message_id, refs, threading FROM Message_Envelopes INNER JOIN Messages ON Message_Envelopes.messagenum = Messages.messagenum WHERE Messages.usernum = ? AND Messages.foldernum = ? AND Messages.visible = 1"
+#define INSERT_MESSAGE_ENVELOPE "INSERT INTO Message_Envelopes (messagenum, sender, recipient, reply_to, return_path, subject, sent, snippet, cc, message_id, refs, threading) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, 1) ON DUPLICATE KEY UPDATE cc = VALUES(cc), message_id = VALUES(message_id), refs = VALUES(refs), threading = 1"
+#define INSERT_MESSAGE_ENVELOPE_DUPLICATE "INSERT IGNORE INTO Message_Envelopes (messagenum, sender, recipient, reply_to, return_path, subject, sent, snippet, cc, message_id, refs, threading) SELECT ?, sender, recipient, reply_to, return_path, subject, sent, snippet, cc, message_id, refs, threading FROM Message_Envelopes WHERE messagenum = ?"
+
+// Message Terms and Message Indexes tables, which hold the full text index. Every suffix of a word is stored as a term, so the term search
+// is a prefix match which can use the primary key. The batched insert must have MAIL_TERMS_BATCH rows.
+#define SELECT_MESSAGE_TERMS "SELECT DISTINCT Message_Terms.messagenum FROM Message_Terms INNER JOIN Messages ON Message_Terms.messagenum = Messages.messagenum WHERE Message_Terms.usernum = ? AND Message_Terms.term LIKE ? AND (Message_Terms.fields & ?) != 0 AND (? = 0 OR Messages.foldernum = ?) ORDER BY Message_Terms.messagenum"
+#define INSERT_MESSAGE_TERM "INSERT IGNORE INTO Message_Terms (usernum, term, messagenum, fields) VALUES (?, ?, ?, ?)"
+#define INSERT_MESSAGE_TERMS "INSERT IGNORE INTO Message_Terms (usernum, term, messagenum, fields) VALUES (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?), (?, ?, ?, ?)"
+#define INSERT_MESSAGE_TERMS_DUPLICATE "INSERT IGNORE INTO Message_Terms (usernum, term, messagenum, fields) SELECT usernum, term, ?, fields FROM Message_Terms WHERE messagenum = ?"
+#define SELECT_MESSAGE_INDEXES "SELECT Message_Indexes.messagenum FROM Message_Indexes INNER JOIN Messages ON Message_Indexes.messagenum = Messages.messagenum WHERE Message_Indexes.usernum = ? AND (? = 0 OR Messages.foldernum = ?) AND (? = 0 OR Message_Indexes.truncated = 0) ORDER BY Message_Indexes.messagenum"
+#define INSERT_MESSAGE_INDEX "INSERT INTO Message_Indexes (messagenum, usernum, terms, truncated) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE terms = VALUES(terms), truncated = VALUES(truncated)"
+#define INSERT_MESSAGE_INDEX_DUPLICATE "INSERT IGNORE INTO Message_Indexes (messagenum, usernum, terms, truncated) SELECT ?, usernum, terms, truncated FROM Message_Indexes WHERE messagenum = ?"
+
+// Message Structures table
+#define SELECT_MESSAGE_STRUCTURE "SELECT length, bodystructure, parts FROM Message_Structures WHERE messagenum = ?"
+#define SELECT_MESSAGE_STRUCTURES "SELECT Message_Structures.messagenum, length, bodystructure, parts FROM Message_Structures INNER JOIN Messages ON Message_Structures.messagenum = Messages.messagenum WHERE Messages.usernum = ? AND Messages.foldernum = ? AND Messages.messagenum BETWEEN ? AND ?"
+#define INSERT_MESSAGE_STRUCTURE "INSERT INTO Message_Structures (messagenum, length, bodystructure, parts) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE length = VALUES(length), bodystructure = VALUES(bodystructure), parts = VALUES(parts)"
+#define INSERT_MESSAGE_STRUCTURE_DUPLICATE "INSERT IGNORE INTO Message_Structures (messagenum, length, bodystructure, parts) SELECT ?, length, bodystructure, parts FROM Message_Structures WHERE messagenum = ?"
+
 // Advertising queries
 #define SELECT_AGENTS "SELECT agentnum, agent, popularity FROM Agents"
 
@@ -198,12 +223,16 @@
 											DELETE_FOLDER, \
 											UPDATE_FOLDER, \
 											RENAME_FOLDER, \
+											UPDATE_FOLDER_MODSEQ, \
+											UPDATE_FOLDER_MODSEQ_MESSAGE, \
+											SELECT_FOLDER_MODSEQ, \
 											SELECT_MESSAGES, \
 											UPDATE_MESSAGE_VISIBILITY, \
 											UPDATE_MESSAGE_FLAGS_ADD, \
 											UPDATE_MESSAGE_FLAGS_REMOVE, \
 											UPDATE_MESSAGE_FLAGS_REPLACE, \
 											UPDATE_MESSAGE_FOLDER, \
+											UPDATE_MESSAGE_FOLDER_RANGE, \
 											INSERT_MESSAGE, \
 											INSERT_MESSAGE_DUPLICATE, \
 											DELETE_MESSAGE, \
@@ -212,6 +241,20 @@
 											SELECT_MESSAGE_TAGS, \
 											INSERT_MESSAGE_TAG, \
 											DELETE_MESSAGE_TAG, \
+											SELECT_MESSAGE_ENVELOPES, \
+											INSERT_MESSAGE_ENVELOPE, \
+											INSERT_MESSAGE_ENVELOPE_DUPLICATE, \
+											SELECT_MESSAGE_TERMS, \
+											INSERT_MESSAGE_TERM, \
+											INSERT_MESSAGE_TERMS, \
+											INSERT_MESSAGE_TERMS_DUPLICATE, \
+											SELECT_MESSAGE_INDEXES, \
+											INSERT_MESSAGE_INDEX, \
+											INSERT_MESSAGE_INDEX_DUPLICATE, \
+											SELECT_MESSAGE_STRUCTURE, \
+											SELECT_MESSAGE_STRUCTURES, \
+											INSERT_MESSAGE_STRUCTURE, \
+											INSERT_MESSAGE_STRUCTURE_DUPLICATE, \
 											SELECT_AGENTS, \
 											SELECT_MAILBOX_ADDRESS, \
 											SELECT_MAILBOX_ADDRESS_ANY, \
@@ -303,12 +346,16 @@
 											**delete_folder, \
 											**update_folder, \
 											**rename_folder, \
+											**update_folder_modseq, \
+											**update_folder_modseq_message, \
+											**select_folder_modseq, \
 											**select_messages, \
 											**update_message_visibility, \
 											**update_message_flags_add, \
 											**update_message_flags_remove, \
 											**update_message_flags_replace, \
 											**update_message_folder, \
+											**update_message_folder_range, \
 											**insert_message, \
 											**insert_message_duplicate, \
 											**delete_message, \
@@ -317,6 +364,20 @@
 											**select_message_tags, \
 											**insert_message_tag, \
 											**delete_message_tag, \
+											**select_message_envelopes, \
+											**insert_message_envelope, \
+											**insert_message_envelope_duplicate, \
+											**select_message_terms, \
+											**insert_message_term, \
+											**insert_message_terms, \
+											**insert_message_terms_duplicate, \
+											**select_message_indexes, \
+											**insert_message_index, \
+											**insert_message_index_duplicate, \
+											**select_message_structure, \
+											**select_message_structures, \
+											**insert_message_structure, \
+											**insert_message_structure_duplicate, \
 											**select_agents, \
 											**select_mailbox_address, \
 											**select_mailbox_address_any, \
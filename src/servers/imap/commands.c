@@ -116,7 +116,8 @@ void imap_process(connection_t *con) {
 		con->command = command;
 		con->protocol.spins = 0;
 
-		if (command->function == &imap_logout) {
+		// The logout command destroys the connection, and the idle command either parks the connection or requeues it once the client is done.
+		if (command->function == &imap_logout || command->function == &imap_idle) {
 			enqueue(command->function, con);
 		}
 		else {
@@ -14,7 +14,9 @@ command_t imap_commands[] = {
 	{	.string = "IDLE", .length = 4, .function = &imap_idle},
 	{	.string = "LIST", .length = 4, .function = &imap_list},
 	{	.string = "LSUB", .length = 4, .function = &imap_lsub},
+	{	.string = "MOVE", .length = 4, .function = &imap_move},
 	{	.string = "NOOP", .length = 4, .function = &imap_noop},
+	{	.string = "SORT", .length = 4, .function = &imap_sort_command},
 	{	.string = "CHECK", .length = 5, .function = &imap_check},
 	{	.string = "CLOSE", .length = 5, .function = &imap_close},
 	{	.string = "FETCH", .length = 5, .function = &imap_fetch},
@@ -23,13 +25,16 @@ command_t imap_commands[] = {
 	{	.string = "APPEND", .length = 6, .function = &imap_append},
 	{	.string = "CREATE", .length = 6, .function = &imap_create},
 	{	.string = "DELETE", .length = 6, .function = &imap_delete},
+	{	.string = "ENABLE", .length = 6, .function = &imap_enable},
 	{	.string = "RENAME", .length = 6, .function = &imap_rename},
 	{	.string = "SEARCH", .length = 6, .function = &imap_search},
 	{	.string = "SELECT", .length = 6, .function = &imap_select},
 	{	.string = "LOGOUT", .length = 6, .function = &imap_logout},
 	{	.string = "STATUS", .length = 6, .function = &imap_status},
+	{	.string = "THREAD", .length = 6, .function = &imap_thread},
 	{	.string = "EXAMINE", .length = 7, .function = &imap_examine},
 	{	.string = "EXPUNGE", .length = 7, .function = &imap_expunge},
+	{	.string = "COMPRESS", .length = 8, .function = &imap_compress},
 	{	.string = "STARTTLS", .length = 8, .function = &imap_starttls},
 	{	.string = "SUBSCRIBE", .length = 9, .function = &imap_subscribe},
 	{	.string = "CAPABILITY", .length = 10, .function = &imap_capability},
@@ -40,14 +40,47 @@ void imap_fetch_free_items(imap_fetch_dataitems_t *items) {
 	return;
 }
 
+/**
+ * @brief	Parse the CHANGEDSINCE and VANISHED fetch modifiers defined by RFC 7162.
+ * @param	modifiers	the parenthetical list of modifiers which followed the data items.
+ * @param	output		the data items structure which will record the modifiers.
+ * @return	true if the modifiers were valid, or false if they weren't recognized.
+ */
+static bool_t imap_parse_modifiers(imap_arguments_t *modifiers, imap_fetch_dataitems_t *output) {
+
+	stringer_t *item;
+	size_t number = ar_length_get(modifiers);
+
+	for (size_t i = 0; i < number; i++) {
+
+		if (imap_get_type_ar(modifiers, i) == IMAP_ARGUMENT_TYPE_ARRAY || !(item = imap_get_st_ar(modifiers, i))) {
+			return false;
+		}
+		else if (!st_cmp_ci_eq(item, PLACER("CHANGEDSINCE", 12)) && i + 1 < number && imap_get_type_ar(modifiers, i + 1) != IMAP_ARGUMENT_TYPE_ARRAY &&
+			uint64_conv_st(imap_get_st_ar(modifiers, i + 1), &(output->changedsince)) && output->changedsince) {
+			output->modseq = 1;
+			i++;
+		}
+		else if (!st_cmp_ci_eq(item, PLACER("VANISHED", 8))) {
+			output->vanished = 1;
+		}
+		else {
+			return false;
+		}
+	}
+
+	// The VANISHED modifier is only valid alongside CHANGEDSINCE.
+	return !output->vanished || output->changedsince;
+}
+
 // This function is used with the fetch command to find out what dataitems need to be output.
 imap_fetch_dataitems_t * imap_parse_dataitems(imap_arguments_t *arguments) {
 
 	int_t type;
 	stringer_t *item = NULL;
-	imap_arguments_t *array = NULL;
+	imap_arguments_t *array = NULL, *modifiers = NULL;
 	imap_fetch_dataitems_t *output;
-	size_t number, increment;
+	size_t number, increment, limit;
 
 	if (!arguments) {
 		log_error("Sanity check failed, passed a NULL parameter.");
@@ -59,6 +92,19 @@ imap_fetch_dataitems_t * imap_parse_dataitems(imap_arguments_t *arguments) {
 		return NULL;
 	}
 
+	// Any modifiers follow the data items as a parenthetical list, so they're set aside before the data items are parsed.
+	if ((limit = ar_length_get(arguments)) > 2 && imap_get_type_ar(arguments, limit - 1) == IMAP_ARGUMENT_TYPE_ARRAY &&
+		(modifiers = imap_get_ar_ar(arguments, limit - 1)) && ar_length_get(modifiers) && imap_get_type_ar(modifiers, 0) != IMAP_ARGUMENT_TYPE_ARRAY &&
+		(item = imap_get_st_ar(modifiers, 0)) && (!st_cmp_ci_eq(item, PLACER("CHANGEDSINCE", 12)) || !st_cmp_ci_eq(item, PLACER("VANISHED", 8)))) {
+
+		if (!imap_parse_modifiers(modifiers, output)) {
+			imap_fetch_free_items(output);
+			return NULL;
+		}
+
+		limit--;
+	}
+
 	// If its a array, find the length.
 	if ((type = imap_get_type_ar(arguments, 1)) == IMAP_ARGUMENT_TYPE_ARRAY) {
 		array = imap_get_ar_ar(arguments, 1);
@@ -67,7 +113,7 @@ imap_fetch_dataitems_t * imap_parse_dataitems(imap_arguments_t *arguments) {
 	}
 	else {
 		array = arguments;
-		number = ar_length_get(array);
+		number = limit;
 		increment = 1;
 	}
 
@@ -96,6 +142,9 @@ imap_fetch_dataitems_t * imap_parse_dataitems(imap_arguments_t *arguments) {
 		else if (!st_cmp_ci_eq(item, PLACER("FLAGS", 5))) {
 			output->flags = 1;
 		}
+		else if (!st_cmp_ci_eq(item, PLACER("MODSEQ", 6))) {
+			output->modseq = 1;
+		}
 		else if (!st_cmp_ci_eq(item, PLACER("INTERNALDATE", 12))) {
 			output->internaldate = 1;
 		}
@@ -759,13 +808,92 @@ mail_mime_t * imap_fetch_return_mime(connection_t *con, meta_message_t *meta, ma
 	return (*message)->mime;
 }
 
+/**
+ * @brief	Find the MIME structure of a message, building and storing it if necessary.
+ * @note	Structures are looked up in the set preloaded for the running command, then in the database, and are only built from the message
+ * 			when neither has a usable copy. The structures of encrypted messages are never stored, since they're derived from the plaintext.
+ * 			On failure the message, header and output are freed, like the other imap_fetch_return functions.
+ * @param	con		the connection issuing the fetch request.
+ * @param	meta	the meta message object for the message being fetched.
+ * @param	message	a pointer to the loaded message, which is loaded if necessary.
+ * @param	header	a pointer to the loaded message header.
+ * @param	output	the fetch response being built.
+ * @param	text	if true the message text is loaded, and the structure is checked against it, so the part table can be used.
+ * @return	NULL on failure, or a pointer to the message structure, which is owned by the connection until the command completes.
+ */
+mail_structure_t * imap_fetch_return_structure(connection_t *con, meta_message_t *meta, mail_message_t **message, stringer_t **header,
+	imap_fetch_response_t *output, bool_t text) {
+
+	stringer_t *bodystructure;
+	mail_structure_t *structure = NULL;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = meta->messagenum };
+	bool_t encrypted = (meta->status & MAIL_STATUS_ENCRYPTED) == MAIL_STATUS_ENCRYPTED;
+
+	if (!con->imap.structures && !(con->imap.structures = inx_alloc(M_INX_TREE, &mail_structure_free))) {
+		mail_destroy(*message);
+		mail_destroy_header(*header);
+		imap_fetch_response_free(output);
+		return NULL;
+	}
+	else if (text && !imap_fetch_return_text(con, meta, message, header, output)) {
+		return NULL;
+	}
+
+	// Use the preloaded structure, or the stored structure, as long as it matches the message text, if the text has been loaded.
+	if ((structure = inx_find(con->imap.structures, key)) || (!encrypted && (structure = mail_db_fetch_structure(meta->messagenum)) &&
+		inx_insert(con->imap.structures, key, structure))) {
+
+		if (!*message || !(*message)->text || st_length_get((*message)->text) == structure->length) {
+			stats_increment_by_name("imap.structures.hits");
+			return structure;
+		}
+
+		log_pedantic("The stored message structure doesn't match the message. { messagenum = %lu }", meta->messagenum);
+		inx_delete(con->imap.structures, key);
+	}
+	else if (structure) {
+		mail_structure_free(structure);
+	}
+
+	// Otherwise parse the message, and build the structure from the result.
+	if (!imap_fetch_return_mime(con, meta, message, header, output)) {
+		return NULL;
+	}
+	else if (!(bodystructure = imap_fetch_bodystructure((*message)->mime)) || !(structure = mail_structure_build((*message)->mime,
+		(*message)->text, bodystructure))) {
+		st_cleanup(bodystructure);
+		mail_destroy(*message);
+		mail_destroy_header(*header);
+		imap_fetch_response_free(output);
+		return NULL;
+	}
+	else if (!inx_insert(con->imap.structures, key, structure)) {
+		mail_structure_free(structure);
+		mail_destroy(*message);
+		mail_destroy_header(*header);
+		imap_fetch_response_free(output);
+		return NULL;
+	}
+
+	stats_increment_by_name("imap.structures.misses");
+
+	if (!encrypted) {
+		mail_db_insert_structure(meta->messagenum, structure);
+	}
+
+	return structure;
+}
+
 imap_fetch_response_t * imap_fetch_body(array_t *outer, array_t *partial, connection_t *con, meta_message_t *meta,
 	mail_message_t **message, stringer_t **header, imap_fetch_response_t *output) {
 
 	int_t state;
 	array_t *inner;
-	mail_mime_t *mime;
+	mail_part_t *part;
 	uint32_t number;
+	mail_structure_t *structure = NULL;
+	mail_mime_t *mime, location;
+	bool_t whole;
 	chr_t buffer[128], *stream;
 	size_t start, length, value_len;
 	placer_t value_pl, headpl, portion = pl_null();
@@ -785,6 +913,7 @@ imap_fetch_response_t * imap_fetch_body(array_t *outer, array_t *partial, connec
 		holder = value_st = tag = NULL;
 		portion = headpl = value_pl = pl_null();
 		mime = NULL;
+		whole = false;
 
 		// We should always have arrays.
 		if (ar_field_type(outer, i) != ARRAY_TYPE_ARRAY) {
@@ -818,11 +947,17 @@ imap_fetch_response_t * imap_fetch_body(array_t *outer, array_t *partial, connec
 			complete = item = imap_get_st_ar(inner, 0);
 
 			// See if were supposed to be looking at a subsection.
+			// The part table locates the section, so the message doesn't need to be parsed. A section with the same offsets as the
+			// message itself is the body of a single part message.
 			if (!pl_empty((portion = imap_fetch_body_portion(item)))) {
-				if ((*message = imap_fetch_return_message(con, meta, message, header, output)) == NULL) {
+				if ((structure = imap_fetch_return_structure(con, meta, message, header, output, true)) == NULL) {
 					return NULL;
 				}
-				mime = imap_fetch_body_part(*message, portion);
+				else if ((part = mail_structure_part(structure, portion))) {
+					mime = mail_structure_mime(structure, part, (*message)->text, &location);
+					whole = part->header_offset == structure->parts[0].header_offset && part->body_offset == structure->parts[0].body_offset &&
+						part->body_length == structure->parts[0].body_length;
+				}
 			}
 
 			// We've extracted a portion, so build a new stringer with the trailing part.
@@ -849,15 +984,15 @@ imap_fetch_response_t * imap_fetch_body(array_t *outer, array_t *partial, connec
 			}
 
 			// The MIME section wasn't found or its not a multipart message and were requesting a subsection.
-			if (!pl_empty(portion) && item != NULL && (mime == NULL || (*message != NULL && (*message)->mime == mime))) {
+			if (!pl_empty(portion) && item != NULL && (mime == NULL || whole)) {
 				tag = imap_fetch_body_tag(complete, NULL);
 			}
 			// If the item is NULL, its because we were asked for the body section.
 			else if (item == NULL) {
 
 				// If a portion was requested, and mime is NULL then the return value should be NIL.
-				if (mime == NULL && !pl_empty(portion) && (mime = imap_fetch_return_mime(con, meta, message, header, output)) == NULL) {
-					return NULL;
+				if (mime == NULL && !pl_empty(portion)) {
+					mime = mail_structure_mime(structure, &(structure->parts[0]), (*message)->text, &location);
 				}
 				if (mime != NULL) {
 					value_pl = pl_init(st_char_get(&(mime->body)), st_length_get(&(mime->body)));
@@ -929,7 +1064,8 @@ imap_fetch_response_t * imap_fetch_body(array_t *outer, array_t *partial, connec
 					value_pl = pl_init(st_char_get(&(mime->body)), st_length_get(&(mime->body)));
 				}
 				else {
-					if ((mime = imap_fetch_return_mime(con, meta, message, header, output)) == NULL) {
+					if ((structure = imap_fetch_return_structure(con, meta, message, header, output, true)) == NULL ||
+						(mime = mail_structure_mime(structure, &(structure->parts[0]), (*message)->text, &location)) == NULL) {
 						return NULL;
 					}
 					value_pl = pl_init(st_char_get(&(mime->body)), st_length_get(&(mime->body)));
@@ -1048,6 +1184,7 @@ imap_fetch_response_t * imap_fetch_message(connection_t *con, meta_message_t *me
 	chr_t buffer[128];
 	mail_message_t *message = NULL;
 	stringer_t *value, *header = NULL;
+	mail_structure_t *structure;
 	imap_fetch_response_t *output = NULL;
 
 	// Process the UID.
@@ -1078,6 +1215,15 @@ imap_fetch_response_t * imap_fetch_message(connection_t *con, meta_message_t *me
 		output = imap_fetch_response_add(output, PLACER("FLAGS", 5), value);
 	}
 
+	// Process the modification sequence, which is also included whenever a flag change is reported to a CONDSTORE client.
+	if (items->modseq == 1 || (con->imap.condstore == 1 && meta->updated == 1)) {
+		if (!(value = st_aprint_opts(MANAGED_T | HEAP | CONTIGUOUS, "(%lu)", meta->modseq))) {
+			imap_fetch_response_free(output);
+			return NULL;
+		}
+		output = imap_fetch_response_add(output, PLACER("MODSEQ", 6), value);
+	}
+
 	// Process the internal date.
 	if (items->internaldate == 1) {
 		ctime = meta->created;
@@ -1128,14 +1274,10 @@ imap_fetch_response_t * imap_fetch_message(connection_t *con, meta_message_t *me
 
 	// Process the body.
 	if (items->body == 1) {
-		if (message == NULL && ((message = mail_load_message(meta, con->imap.user, con->server, true)) == NULL
-			|| mail_mime_update(message) == 0)) {
-			mail_destroy(message);
-			mail_destroy_header(header);
-			imap_fetch_response_free(output);
+		if ((structure = imap_fetch_return_structure(con, meta, &message, &header, output, false)) == NULL) {
 			return NULL;
 		}
-		else if ((value = imap_fetch_bodystructure(message->mime)) == NULL) {
+		else if ((value = st_dupe(structure->bodystructure)) == NULL) {
 			mail_destroy(message);
 			mail_destroy_header(header);
 			imap_fetch_response_free(output);
@@ -1146,14 +1288,10 @@ imap_fetch_response_t * imap_fetch_message(connection_t *con, meta_message_t *me
 
 	// Process the bodystructure.
 	if (items->bodystructure == 1) {
-		if (message == NULL && ((message = mail_load_message(meta, con->imap.user, con->server, true)) == NULL
-			|| mail_mime_update(message) == 0)) {
-			mail_destroy(message);
-			mail_destroy_header(header);
-			imap_fetch_response_free(output);
+		if ((structure = imap_fetch_return_structure(con, meta, &message, &header, output, false)) == NULL) {
 			return NULL;
 		}
-		else if ((value = imap_fetch_bodystructure(message->mime)) == NULL) {
+		else if ((value = st_dupe(structure->bodystructure)) == NULL) {
 			mail_destroy(message);
 			mail_destroy_header(header);
 			imap_fetch_response_free(output);
@@ -1231,50 +1369,6 @@ imap_fetch_response_t * imap_fetch_message(connection_t *con, meta_message_t *me
 	return output;
 }
 
-/**
- * @brief	Create a copy of a collection of messages.
- * @see		meta_message_dupe()
- * @param	messages	a collection of meta message objects to be duplicated.
- * @return	the copied collection of meta messages on success, or NULL on failure.
- */
-inx_t * imap_duplicate_messages(inx_t *messages) {
-
-	inx_t *output = NULL;
-	inx_cursor_t *cursor;
-	meta_message_t *active, *duplicate;
-	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
-
-	// Allocate the linked the list.
-	if (!(output = inx_alloc(M_INX_LINKED, &meta_message_free))) {
-		return NULL;
-	}
-
-	if ((cursor = inx_cursor_alloc(messages))) {
-
-		while ((active = inx_cursor_value_next(cursor))) {
-
-			if (!(duplicate = meta_message_dupe(active))) {
-				log_error("Unable to duplicate the message structure.");
-				inx_cursor_free(cursor);
-				inx_free(output);
-				return NULL;
-			}
-			else if (!(key.val.u64 = active->messagenum) || !inx_append(output, key, duplicate)) {
-				log_error("Unable to add the duplicate message to our list.");
-				meta_message_free(duplicate);
-				inx_cursor_free(cursor);
-				inx_free(output);
-				return NULL;
-			}
-
-		}
-
-		inx_cursor_free(cursor);
-	}
-
-	return output;
-}
-
 // Returns a copy of the messages. Make sure you rely on the message numbers and not the sequence numbers.
 inx_t * imap_narrow_messages(inx_t *messages, uint64_t selected, stringer_t *range, int_t uid) {
 
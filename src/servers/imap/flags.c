@@ -141,13 +141,13 @@ void imap_update_flags(meta_user_t *user, inx_t *messages, uint64_t foldernum, i
 		while ((active = inx_cursor_value_next(cursor))) {
 			if (active->foldernum == foldernum) {
 				if ((action & IMAP_FLAG_ADD) == IMAP_FLAG_ADD) {
-					active->status = active->status | flags;
+					meta_counters_status(user->folders, active, active->status | flags);
 				}
 				else if ((action & IMAP_FLAG_REMOVE) == IMAP_FLAG_REMOVE) {
-					active->status = (active->status | flags) ^ flags;
+					meta_counters_status(user->folders, active, (active->status | flags) ^ flags);
 				}
 				else if ((action & IMAP_FLAG_REPLACE) == IMAP_FLAG_REPLACE) {
-					active->status = ((active->status | complete) ^ complete) | flags;
+					meta_counters_status(user->folders, active, ((active->status | complete) ^ complete) | flags);
 				}
 			}
 		}
@@ -155,5 +155,48 @@ void imap_update_flags(meta_user_t *user, inx_t *messages, uint64_t foldernum, i
 		inx_cursor_free(cursor);
 	}
 
+	// Discard the message snapshot so readers see the new flags.
+	meta_snapshot_invalidate(user);
+
 	return;
 }
+
+/**
+ * @brief	Print the untagged FETCH response used to report the current flags of a message.
+ * @param	output	the managed string that will receive the response, which should hold at least 256 bytes.
+ * @param	message	the message whose flags are being reported.
+ * @param	uid		if true, the message UID is included in the response.
+ * @param	modseq	if true, the message modification sequence is included in the response.
+ * @return	a pointer to the output string.
+ */
+stringer_t * imap_flags_fetch(stringer_t *output, meta_message_t *message, int_t uid, int_t modseq) {
+
+	chr_t buffer[128], sequence[64];
+
+	if (uid) {
+		snprintf(buffer, 128, " UID %lu", message->messagenum);
+	}
+	else {
+		buffer[0] = '\0';
+	}
+
+	if (modseq) {
+		snprintf(sequence, 64, " MODSEQ (%lu)", message->modseq);
+	}
+	else {
+		sequence[0] = '\0';
+	}
+
+	return st_quick(output, "* %lu FETCH (FLAGS (%s%s%s%s%s%s%s%s%s%s%s)%s%s)\r\n", message->sequencenum,
+		(message->status & MAIL_STATUS_ANSWERED) != 0 ? "\\Answered" : "",
+		(message->status & MAIL_STATUS_ANSWERED) != 0 && (message->status & MAIL_STATUS_FLAGGED) != 0 ? " " : "",
+		(message->status & MAIL_STATUS_FLAGGED) != 0 ? "\\Flagged" : "",
+		(message->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED)) != 0 && (message->status & MAIL_STATUS_DELETED) != 0 ? " " : "",
+		(message->status & MAIL_STATUS_DELETED) != 0 ? "\\Deleted" : "",
+		(message->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED | MAIL_STATUS_DELETED)) != 0 && (message->status & MAIL_STATUS_SEEN) != 0 ? " " : "",
+		(message->status & MAIL_STATUS_SEEN) != 0 ? "\\Seen" : "",
+		(message->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED | MAIL_STATUS_DELETED | MAIL_STATUS_SEEN)) != 0 && (message->status & MAIL_STATUS_DRAFT) != 0 ? " " : "",
+		(message->status & MAIL_STATUS_DRAFT) != 0 ? "\\Draft" : "",
+		(message->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED | MAIL_STATUS_DELETED | MAIL_STATUS_SEEN | MAIL_STATUS_DRAFT)) != 0 && (message->status & MAIL_STATUS_RECENT) != 0 ? " " : "",
+		(message->status & MAIL_STATUS_RECENT) != 0 ? "\\Recent" : "", buffer, sequence);
+}
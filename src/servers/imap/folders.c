@@ -446,6 +446,7 @@ int_t imap_folder_remove(uint64_t usernum, inx_t *folders, inx_t *messages, stri
 
 			if (message->foldernum == active->foldernum && mail_remove_message(usernum, message->messagenum, message->size, message->server)) {
 				key.val.u64 = message->messagenum;
+				meta_counters_remove(folders, message);
 				inx_delete(messages, key);
 			}
 
@@ -664,10 +665,10 @@ int_t imap_folder_rename(uint64_t usernum, inx_t *folders, stringer_t *original,
 
 /**
  * @brief	Get the status of a folder.
- * @note	This function will count the number of messages in a folder, as well as the number of messages marked recent or unseen,
- * 			as well as the numerical id of the first message in the folder and the UIDNEXT of the specified folder.
+ * @note	The message, recent and unseen totals come from the counters maintained on each folder, so this function doesn't need to
+ * 			scan the user's messages. The sequence number of the first unseen message isn't calculated here; use imap_folder_unseen()
+ * 			when it's needed.
  * @param	folders		an inx holder containing a list of folders to be searched for the specified folder.
- * @param	messages	an inx holder containing a complete list of a user's messages to be examined for gathering statistics.
  * @param	name		a managed string containing the name of the imap folder to be queried.
  * @param	status		a pointer to an imap folder status object to receive the folder's status information.
  * @return	1 on success or <= 0 on failure.
@@ -675,11 +676,10 @@ int_t imap_folder_rename(uint64_t usernum, inx_t *folders, stringer_t *original,
  *         -1:	The specified folder name was invalid.
  *         -2:	The folder did not exist.
  */
-int_t imap_folder_status(inx_t *folders, inx_t *messages, stringer_t *name, imap_folder_status_t *status) {
+int_t imap_folder_status(inx_t *folders, stringer_t *name, imap_folder_status_t *status) {
 
 	meta_folder_t *folder;
-	inx_cursor_t *cursor;
-	meta_message_t *message;
+	meta_counters_t totals;
 
 	if (!folders || !name || !status) {
 		log_pedantic("We were passed an invalid pointer.");
@@ -699,44 +699,57 @@ int_t imap_folder_status(inx_t *folders, inx_t *messages, stringer_t *name, imap
 		return -2;
 	}
 
-	// Store the folder number.
+	// Store the folder number and the maintained totals.
 	status->foldernum = folder->foldernum;
+	status->messages = folder->counters.messages;
+	status->recent = folder->counters.recent;
+	status->unseen = folder->counters.unseen;
+	status->highestmodseq = folder->counters.modseq > folder->modseq ? folder->counters.modseq : folder->modseq;
 
-	// Iterate through the messages structure and collect status information.
-	if ((cursor = inx_cursor_alloc(messages))) {
-
-		while ((message = inx_cursor_value_next(cursor))) {
+	// The next UID is based on the highest message number across every folder.
+	meta_counters_total(folders, &totals);
+	status->uidnext = totals.highest + 1;
 
-			if (message->foldernum == folder->foldernum) {
-				status->messages++;
+	return 1;
+}
 
-				if ((message->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
-					status->recent++;
-				}
+/**
+ * @brief	Find the sequence number of the first unseen message in a folder.
+ * @note	The scan is skipped entirely if the folder counters show no unseen messages.
+ * @param	folders		an inx holder containing the user's folders.
+ * @param	messages	an inx holder containing the user's messages.
+ * @param	foldernum	the numerical id of the folder to be scanned.
+ * @return	0 if the folder has no unseen messages, or the sequence number of the first unseen message.
+ */
+uint64_t imap_folder_unseen(inx_t *folders, inx_t *messages, uint64_t foldernum) {
 
-				if ((message->status & MAIL_STATUS_SEEN) != MAIL_STATUS_SEEN) {
-					status->unseen++;
+	uint64_t sequence = 0, result = 0;
+	meta_folder_t *folder;
+	inx_cursor_t *cursor;
+	meta_message_t *message;
 
-					if (!status->first) {
-						status->first = status->messages;
-					}
+	if ((folder = meta_folders_by_number(folders, foldernum)) && !folder->counters.unseen) {
+		return 0;
+	}
+	else if (!(cursor = inx_cursor_alloc(messages))) {
+		return 0;
+	}
 
-				}
+	while (!result && (message = inx_cursor_value_next(cursor))) {
 
-			}
+		if (message->foldernum == foldernum) {
+			sequence++;
 
-			if (message->messagenum > status->uidnext) {
-				status->uidnext = message->messagenum;
+			if ((message->status & MAIL_STATUS_SEEN) != MAIL_STATUS_SEEN) {
+				result = sequence;
 			}
-
 		}
 
-		inx_cursor_free(cursor);
 	}
 
-	status->uidnext += 1;
+	inx_cursor_free(cursor);
 
-	return 1;
+	return result;
 }
 
 // Will take a reference pattern and return a linked list of the folders it refers to.
@@ -285,23 +285,20 @@ void imap_login(connection_t *con) {
 }
 
 void imap_noop(connection_t *con) {
-	if (con->imap.session_state == 1 && con->imap.selected != 0 && con->imap.user && imap_session_update(con) == 1) {
-		con_print(con, "* %lu EXISTS\r\n* %lu RECENT\r\n%.*s OK NOOP Completed.\r\n", con->imap.messages_total, con->imap.messages_recent,
-			st_length_int(con->imap.tag), st_char_get(con->imap.tag));
-	}
-	else {
-		con_print(con, "%.*s OK NOOP Completed.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+
+	// Bring the client up to date with any changes to the selected folder.
+	if (con->imap.session_state == 1 && con->imap.selected != 0 && con->imap.user) {
+		imap_session_report(con);
 	}
+
+	con_print(con, "%.*s OK NOOP Completed.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 	return;
 }
 
 void imap_check(connection_t *con) {
 
-	if (con->imap.session_state == 1 && con->imap.selected != 0 && con->imap.user && imap_session_update(con) == 0) {
-		con_print(con, "* %lu EXISTS\r\n* %lu RECENT\r\n%.*s OK CHECK Completed.\r\n", con->imap.messages_total,
-			con->imap.messages_recent, st_length_int(con->imap.tag), st_char_get(con->imap.tag));
-	}
-	else if (con->imap.session_state == 1) {
+	if (con->imap.session_state == 1) {
+		if (con->imap.selected != 0 && con->imap.user) imap_session_report(con);
 		con_print(con, "%.*s OK CHECK Completed.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 	}
 	else {
@@ -556,6 +553,7 @@ void imap_delete(connection_t *con) {
 
 	// Delete the folder.
 	state = imap_folder_remove(con->imap.user->usernum, con->imap.user->folders, con->imap.user->messages, imap_get_st_ar(con->imap.arguments, 0));
+	meta_snapshot_invalidate(con->imap.user);
 
 	// If the serial number indicates no outside changes we can increment it without forcing a refresh.
 	if (con->imap.user->serials.folders == serial_get(OBJECT_FOLDERS, con->imap.user->usernum)) {
@@ -679,7 +677,7 @@ void imap_status(connection_t *con) {
 
 	// Get the folder status.
 	meta_user_rlock(con->imap.user);
-	state = imap_folder_status(con->imap.user->folders, con->imap.user->messages, imap_get_st_ar(con->imap.arguments, 0), &status);
+	state = imap_folder_status(con->imap.user->folders, imap_get_st_ar(con->imap.arguments, 0), &status);
 	meta_user_unlock(con->imap.user);
 
 	// Figure out what to output.
@@ -711,6 +709,11 @@ void imap_status(connection_t *con) {
 				snprintf(buffer, 128, "%sUIDVALIDITY %lu", (output == NULL ? "" : " "), status.foldernum);
 				output = st_append_opts(1024, output, NULLER(buffer));
 			}
+			else if (!st_cmp_ci_eq(imap_get_st_ar(values, i), PLACER("HIGHESTMODSEQ", 13))) {
+				snprintf(buffer, 128, "%sHIGHESTMODSEQ %lu", (output == NULL ? "" : " "), status.highestmodseq);
+				output = st_append_opts(1024, output, NULLER(buffer));
+				con->imap.condstore = 1;
+			}
 			// Unrecognized item requested.
 			else {
 				con_print(con, "%.*s BAD Invalid data item requested via the status command.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
@@ -800,13 +803,200 @@ void imap_unsubscribe(connection_t *con) {
 	return;
 }
 
-void imap_examine(connection_t *con) {
+/**
+ * @brief	Write a single untagged FETCH response to the client.
+ * @note	The UID is always written first, followed by the message size, since some clients expect that ordering.
+ * @param	con			a pointer to the connection object of the remote session.
+ * @param	active		the meta message object which the response describes.
+ * @param	response	the list of fetch response items for the message.
+ * @return	This function returns no value.
+ */
+static void imap_fetch_write(connection_t *con, meta_message_t *active, imap_fetch_response_t *response) {
+
+	int_t space = 0;
+	imap_fetch_response_t *iterate = response;
+
+	// Output the response.
+	con_print(con, "* %lu FETCH (", active->sequencenum);
+
+	// Output the UID first.
+	while (iterate != NULL) {
+
+		if (!st_cmp_cs_eq(iterate->key, PLACER("UID", 3))) {
+			con_write_st(con, iterate->key);
+			con_write_bl(con, " ", 1);
+			con_write_st(con, iterate->value);
+			iterate = NULL;
+			space = 1;
+		}
+		else {
+			iterate = (imap_fetch_response_t *)iterate->next;
+		}
+	}
+
+	// Now output the size, if it is present.
+	iterate = response;
+	while (iterate != NULL) {
+		if (!st_cmp_cs_eq(iterate->key, PLACER("RFC822.SIZE", 11))) {
+			if (space == 1) {
+				con_write_bl(con, " ", 1);
+			}
+			else {
+				space = 1;
+			}
+			con_write_st(con, iterate->key);
+			con_write_bl(con, " ", 1);
+			con_write_st(con, iterate->value);
+			iterate = NULL;
+		}
+		else {
+			iterate = (imap_fetch_response_t *)iterate->next;
+		}
+	}
+
+	// Output the rest of the items.
+	iterate = response;
+	while (iterate != NULL) {
+		if (st_cmp_cs_eq(iterate->key, PLACER("UID", 3)) && st_cmp_cs_eq(iterate->key, PLACER("RFC822.SIZE", 11))) {
+			if (space == 1) {
+				con_write_bl(con, " ", 1);
+			}
+			else {
+				space = 1;
+			}
+			con_write_st(con, iterate->key);
+			con_write_bl(con, " ", 1);
+			con_write_st(con, iterate->value);
+		}
+		iterate = (imap_fetch_response_t *)iterate->next;
+	}
+
+	con_write_bl(con, ")\r\n", 3);
+
+	return;
+}
+
+/**
+ * @brief	Parse the optional CONDSTORE and QRESYNC parameters accepted by the SELECT and EXAMINE commands.
+ * @see		RFC 7162
+ * @param	con			a pointer to the connection object of the remote session.
+ * @param	uidvalidity	a pointer to receive the UIDVALIDITY value supplied with the QRESYNC parameter.
+ * @param	modseq		a pointer to receive the last known modification sequence supplied with the QRESYNC parameter.
+ * @param	known		a pointer to receive the optional set of known UIDs supplied with the QRESYNC parameter.
+ * @return	-1 if the arguments are invalid, 0 if no resynchronization was requested, or 1 if the QRESYNC parameter was supplied.
+ */
+static int_t imap_select_parameters(connection_t *con, uint64_t *uidvalidity, uint64_t *modseq, stringer_t **known) {
+
+	int_t result = 0;
+	size_t number;
+	stringer_t *item;
+	imap_arguments_t *parameters, *qresync;
+
+	*uidvalidity = *modseq = 0;
+	*known = NULL;
+
+	// Requires a folder name, and optionally a parenthetical list of parameters.
+	if ((ar_length_get(con->imap.arguments) != 1 && ar_length_get(con->imap.arguments) != 2) || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY ||
+		(ar_length_get(con->imap.arguments) == 2 && imap_get_type_ar(con->imap.arguments, 1) != IMAP_ARGUMENT_TYPE_ARRAY)) {
+		return -1;
+	}
+	else if (ar_length_get(con->imap.arguments) == 1 || !(parameters = imap_get_ar_ar(con->imap.arguments, 1))) {
+		return 0;
+	}
+
+	number = ar_length_get(parameters);
+
+	for (size_t i = 0; i < number; i++) {
+
+		if (imap_get_type_ar(parameters, i) == IMAP_ARGUMENT_TYPE_ARRAY || !(item = imap_get_st_ar(parameters, i))) {
+			return -1;
+		}
+		else if (!st_cmp_ci_eq(item, PLACER("CONDSTORE", 9))) {
+			con->imap.condstore = 1;
+		}
+
+		// The QRESYNC parameter is only valid once it has been enabled, and must be followed by the UIDVALIDITY and modification sequence
+		// the client last saw, with an optional set of known UIDs. The sequence match data which can follow is ignored.
+		else if (!st_cmp_ci_eq(item, PLACER("QRESYNC", 7)) && con->imap.qresync == 1 && i + 1 < number &&
+			imap_get_type_ar(parameters, i + 1) == IMAP_ARGUMENT_TYPE_ARRAY && (qresync = imap_get_ar_ar(parameters, ++i)) &&
+			ar_length_get(qresync) >= 2 && imap_get_type_ar(qresync, 0) != IMAP_ARGUMENT_TYPE_ARRAY && imap_get_type_ar(qresync, 1) != IMAP_ARGUMENT_TYPE_ARRAY &&
+			uint64_conv_st(imap_get_st_ar(qresync, 0), uidvalidity) && uint64_conv_st(imap_get_st_ar(qresync, 1), modseq)) {
+
+			if (ar_length_get(qresync) >= 3 && imap_get_type_ar(qresync, 2) != IMAP_ARGUMENT_TYPE_ARRAY) {
+				*known = imap_get_st_ar(qresync, 2);
+			}
+
+			result = 1;
+		}
+		else {
+			return -1;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Send the changes a QRESYNC client missed since it last had a folder open.
+ * @note	Messages which were expunged are reported using VANISHED (EARLIER), and messages with a newer modification sequence are
+ * 			reported using untagged FETCH responses, which carry the UID, flags and modification sequence of each message.
+ * @param	con			a pointer to the connection object of the remote session.
+ * @param	status		the status of the folder being selected.
+ * @param	modseq		the last modification sequence seen by the client.
+ * @param	known		an optional set of UIDs known to the client, which limits the VANISHED response.
+ * @return	This function returns no value.
+ */
+static void imap_select_resync(connection_t *con, imap_folder_status_t *status, uint64_t modseq, stringer_t *known) {
 
-	int_t state;
-	chr_t buffer[128];
 	inx_cursor_t *cursor;
 	meta_message_t *active;
+	meta_snapshot_t *snapshot;
+	stringer_t *vanished = NULL;
+	imap_fetch_dataitems_t items;
+	imap_fetch_response_t *response;
+	uint64_t first = 1, last = status->uidnext - 1;
+
+	meta_user_rlock(con->imap.user);
+	snapshot = con->imap.user->messages ? meta_snapshot_get(con->imap.user) : NULL;
+	meta_user_unlock(con->imap.user);
+
+	if (!snapshot) {
+		return;
+	}
+
+	if ((!known || imap_range_bounds(known, status->uidnext - 1, &first, &last)) &&
+		(vanished = imap_range_vanished(snapshot->messages, status->foldernum, first, last))) {
+		con_print(con, "* VANISHED (EARLIER) %.*s\r\n", st_length_int(vanished), st_char_get(vanished));
+		st_free(vanished);
+	}
+
+	mm_wipe(&items, sizeof(imap_fetch_dataitems_t));
+	items.uid = items.flags = items.modseq = 1;
+
+	if ((cursor = inx_cursor_alloc(snapshot->messages))) {
+
+		while (con_status(con) >= 0 && (active = inx_cursor_value_next(cursor))) {
+			if (active->foldernum == status->foldernum && active->modseq > modseq && (response = imap_fetch_message(con, active, &items))) {
+				imap_fetch_write(con, active, response);
+				imap_fetch_response_free(response);
+			}
+		}
+
+		inx_cursor_free(cursor);
+	}
+
+	meta_snapshot_release(snapshot);
+
+	return;
+}
+
+void imap_examine(connection_t *con) {
+
+	int_t state, resync;
+	chr_t buffer[128];
+	stringer_t *known;
 	imap_folder_status_t status;
+	uint64_t uidvalidity, modseq;
 
 	// Check for the right state.
 	if (con->imap.session_state != 1) {
@@ -814,8 +1004,8 @@ void imap_examine(connection_t *con) {
 		return;
 	}
 
-	// Input validation. Requires one string argument, which cannot be NULL.
-	if (ar_length_get(con->imap.arguments) != 1 || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY) {
+	// Input validation. Requires one string argument, which cannot be NULL, and accepts an optional list of parameters.
+	if ((resync = imap_select_parameters(con, &uidvalidity, &modseq, &known)) < 0) {
 		con_print(con, "%.*s BAD The examine command requires a string argument.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 		return;
 	}
@@ -823,21 +1013,22 @@ void imap_examine(connection_t *con) {
 	// If a folder was previously selected, clear the recent flag before closing the mailbox.
 	if (con->imap.selected != 0 && con->imap.read_only == 0) {
 		meta_user_wlock(con->imap.user);
-		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
-			while ((active = inx_cursor_value_next(cursor))) {
-				if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
-					active->status = (active->status | MAIL_STATUS_RECENT) ^ MAIL_STATUS_RECENT;
-				}
-			}
-		inx_cursor_free(cursor);
-		}
+		meta_counters_recent_clear(con->imap.user->folders, con->imap.user->messages, con->imap.selected);
 		meta_user_unlock(con->imap.user);
 	}
+
+	// Tell QRESYNC clients where the responses for the previous folder end.
+	if (con->imap.selected != 0 && con->imap.qresync == 1) {
+		con_write_bl(con, "* OK [CLOSED] Previous mailbox closed.\r\n", 40);
+	}
+
 	con->imap.read_only = con->imap.selected = con->imap.messages_total = con->imap.messages_recent = 0;
 
 	// Get the folder status.
 	meta_user_rlock(con->imap.user);
-	state = imap_folder_status(con->imap.user->folders, con->imap.user->messages, imap_get_st_ar(con->imap.arguments, 0), &status);
+	if ((state = imap_folder_status(con->imap.user->folders, imap_get_st_ar(con->imap.arguments, 0), &status)) == 1) {
+		status.first = imap_folder_unseen(con->imap.user->folders, con->imap.user->messages, status.foldernum);
+	}
 	meta_user_unlock(con->imap.user);
 
 	if (state == 1) {
@@ -849,14 +1040,20 @@ void imap_examine(connection_t *con) {
 		// Some clients expect the flags line to come first.
 		con_print(con, "* FLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft \\Recent)\r\n" \
 			"* OK [PERMANENTFLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft)]\r\n" \
-			"* %lu EXISTS\r\n* %lu RECENT\r\n%s* OK [UIDVALIDITY %lu]\r\n* OK [UIDNEXT %lu]\r\n" \
-			"%.*s OK EXAMINE [READ-ONLY] Complete.\r\n",
-			status.messages, status.recent, (status.first != 0 ? buffer : ""), status.foldernum, status.uidnext,
-			st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+			"* %lu EXISTS\r\n* %lu RECENT\r\n%s* OK [UIDVALIDITY %lu]\r\n* OK [UIDNEXT %lu]\r\n* OK [HIGHESTMODSEQ %lu]\r\n",
+			status.messages, status.recent, (status.first != 0 ? buffer : ""), status.foldernum, status.uidnext, status.highestmodseq);
+
+		// A resynchronization is only possible if the folder hasn't been recreated since the client last saw it.
+		if (resync == 1 && uidvalidity == status.foldernum) {
+			imap_select_resync(con, &status, modseq, known);
+		}
+
+		con_print(con, "%.*s OK EXAMINE [READ-ONLY] Complete.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 		con->imap.messages_total = status.messages;
 		con->imap.messages_recent = status.recent;
 		con->imap.selected = status.foldernum;
 		con->imap.read_only = 1;
+		imap_session_known(con, META_NEED_LOCK);
 	}
 	else if (state == -1) {
 		con_print(con, "%.*s NO EXAMINE Failed. The folder name provided is invalid.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
@@ -873,11 +1070,11 @@ void imap_examine(connection_t *con) {
 
 void imap_select(connection_t *con) {
 
-	int_t state;
+	int_t state, resync;
 	chr_t buffer[128];
-	inx_cursor_t *cursor;
-	meta_message_t *active;
+	stringer_t *known;
 	imap_folder_status_t status;
+	uint64_t uidvalidity, modseq;
 
 	// Check for the right state.
 	if (con->imap.session_state != 1) {
@@ -886,8 +1083,8 @@ void imap_select(connection_t *con) {
 		return;
 	}
 
-	// Input validation. Requires one string argument, which cannot be NULL.
-	if (ar_length_get(con->imap.arguments) != 1 || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY) {
+	// Input validation. Requires one string argument, which cannot be NULL, and accepts an optional list of parameters.
+	if ((resync = imap_select_parameters(con, &uidvalidity, &modseq, &known)) < 0) {
 
 		con_print(con, "%.*s BAD The select command requires a string argument.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 		return;
@@ -896,22 +1093,22 @@ void imap_select(connection_t *con) {
 	// If a folder was previously selected, clear the recent flag before closing the mailbox.
 	if (con->imap.selected != 0 && con->imap.read_only == 0) {
 		meta_user_wlock(con->imap.user);
-		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
-			while ((active = inx_cursor_value_next(cursor))) {
-				if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
-					active->status = (active->status | MAIL_STATUS_RECENT) ^ MAIL_STATUS_RECENT;
-				}
-			}
-			inx_cursor_free(cursor);
-		}
+		meta_counters_recent_clear(con->imap.user->folders, con->imap.user->messages, con->imap.selected);
 		meta_user_unlock(con->imap.user);
 	}
 
+	// Tell QRESYNC clients where the responses for the previous folder end.
+	if (con->imap.selected != 0 && con->imap.qresync == 1) {
+		con_write_bl(con, "* OK [CLOSED] Previous mailbox closed.\r\n", 40);
+	}
+
 	con->imap.read_only = con->imap.selected = con->imap.messages_total = con->imap.messages_recent = 0;
 
 	// Get the folder status.
 	meta_user_wlock(con->imap.user);
-	if ((state = imap_folder_status(con->imap.user->folders, con->imap.user->messages, imap_get_st_ar(con->imap.arguments, 0), &status)) == 1) {
+	if ((state = imap_folder_status(con->imap.user->folders, imap_get_st_ar(con->imap.arguments, 0), &status)) == 1) {
+
+		status.first = imap_folder_unseen(con->imap.user->folders, con->imap.user->messages, status.foldernum);
 
 		// Now that this folder has been opened, remove the recent flag in the database.
 		meta_data_flags_remove(con->imap.user->messages, con->imap.user->usernum, status.foldernum, MAIL_STATUS_RECENT);
@@ -928,14 +1125,20 @@ void imap_select(connection_t *con) {
 		// Some clients expect the flags line to come first.
 		con_print(con, "* FLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft \\Recent)\r\n" \
 			"* OK [PERMANENTFLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft)]\r\n" \
-			"* %lu EXISTS\r\n* %lu RECENT\r\n%s* OK [UIDVALIDITY %lu]\r\n* OK [UIDNEXT %lu]\r\n" \
-			"%.*s OK SELECT [READ-WRITE] Complete.\r\n",
-			status.messages, status.recent, (status.first != 0 ? buffer : ""), status.foldernum, status.uidnext,
-			st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+			"* %lu EXISTS\r\n* %lu RECENT\r\n%s* OK [UIDVALIDITY %lu]\r\n* OK [UIDNEXT %lu]\r\n* OK [HIGHESTMODSEQ %lu]\r\n",
+			status.messages, status.recent, (status.first != 0 ? buffer : ""), status.foldernum, status.uidnext, status.highestmodseq);
+
+		// A resynchronization is only possible if the folder hasn't been recreated since the client last saw it.
+		if (resync == 1 && uidvalidity == status.foldernum) {
+			imap_select_resync(con, &status, modseq, known);
+		}
+
+		con_print(con, "%.*s OK SELECT [READ-WRITE] Complete.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 		con->imap.messages_total = status.messages;
 		con->imap.messages_recent = status.recent;
 		con->imap.selected = status.foldernum;
 		con->imap.read_only = 0;
+		imap_session_known(con, META_NEED_LOCK);
 	}
 	else if (state == -1) {
 		con_print(con, "%.*s NO SELECT Failed. The folder name provided is invalid.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
@@ -954,10 +1157,15 @@ void imap_store(connection_t *con) {
 
 	int_t action;
 	uint32_t flags;
-	chr_t buffer[128];
 	inx_cursor_t *cursor;
 	meta_message_t *active;
-	inx_t *messages, *duplicate;
+	size_t length, total, count = 0;
+	imap_arguments_t *modifiers;
+	meta_snapshot_t *snapshot = NULL;
+	inx_t *messages, *updated = NULL;
+	stringer_t *modified = NULL;
+	uint64_t unchangedsince = UINT64_MAX, *skipped = NULL;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
 
 	// Check for the right state.
 	if (con->imap.session_state != 1) {
@@ -973,20 +1181,29 @@ void imap_store(connection_t *con) {
 		return;
 	}
 
-	// Input validation. Requires three arguments.
-	else if (ar_length_get(con->imap.arguments) != 3|| imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY || imap_get_type_ar(con->imap.arguments, 1) == IMAP_ARGUMENT_TYPE_ARRAY) {
+	// Input validation. Requires three arguments, with an optional list of modifiers following the sequence.
+	else if (((length = ar_length_get(con->imap.arguments)) != 3 && length != 4) || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY ||
+		imap_get_type_ar(con->imap.arguments, length - 2) == IMAP_ARGUMENT_TYPE_ARRAY) {
 		con_print(con, "%.*s BAD The store command requires three arguments.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 		return;
 	}
 
+	// The only modifier supported is UNCHANGEDSINCE, which is defined by RFC 7162.
+	else if (length == 4 && (imap_get_type_ar(con->imap.arguments, 1) != IMAP_ARGUMENT_TYPE_ARRAY || !(modifiers = imap_get_ar_ar(con->imap.arguments, 1)) ||
+		ar_length_get(modifiers) != 2 || imap_get_type_ar(modifiers, 0) == IMAP_ARGUMENT_TYPE_ARRAY || imap_get_type_ar(modifiers, 1) == IMAP_ARGUMENT_TYPE_ARRAY ||
+		st_cmp_ci_eq(imap_get_st_ar(modifiers, 0), PLACER("UNCHANGEDSINCE", 14)) || !uint64_conv_st(imap_get_st_ar(modifiers, 1), &unchangedsince))) {
+		con_print(con, "%.*s BAD An invalid modifier was passed to the store command.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+
 	// Determine whether we are replacing, removing, or adding.
-	else if ((action = imap_flag_action(imap_get_st_ar(con->imap.arguments, 1))) == 0) {
+	else if ((action = imap_flag_action(imap_get_st_ar(con->imap.arguments, length - 2))) == 0) {
 		con_print(con, "%.*s BAD An invalid data item parameter was passed to the store command.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 		return;
 	}
 
 	// Parse the list of flags.
-	else if ((flags = imap_flag_parse(imap_get_ptr(con->imap.arguments, 2), imap_get_type_ar(con->imap.arguments, 2))) == 0) {
+	else if ((flags = imap_flag_parse(imap_get_ptr(con->imap.arguments, length - 1), imap_get_type_ar(con->imap.arguments, length - 1))) == 0) {
 		con_print(con, "%.*s BAD Unable to parse the list of flags provided to the store command.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 		return;
 	}
@@ -1018,6 +1235,34 @@ void imap_store(connection_t *con) {
 		return;
 	}
 
+	// Messages which have changed since the UNCHANGEDSINCE value are left alone, and reported back to the client using the MODIFIED response code.
+	if (length == 4) {
+
+		con->imap.condstore = 1;
+
+		// The first half of the buffer holds the message numbers, and the second half holds the numbers reported back to the client.
+		if ((total = inx_count(messages)) && (skipped = mm_alloc(total * sizeof(uint64_t) * 2)) && (cursor = inx_cursor_alloc(messages))) {
+
+			while ((active = inx_cursor_value_next(cursor))) {
+				if (active->modseq > unchangedsince) {
+					skipped[total + count] = con->imap.uid ? active->messagenum : active->sequencenum;
+					skipped[count++] = active->messagenum;
+				}
+			}
+
+			inx_cursor_free(cursor);
+		}
+
+		// The messages are removed in a second pass, since the narrowed index can't be modified while the cursor is walking it.
+		for (size_t i = 0; i < count; i++) {
+			key.val.u64 = skipped[i];
+			inx_delete(messages, key);
+		}
+
+		modified = count ? imap_range_build(count, skipped + total) : NULL;
+		mm_cleanup(skipped);
+	}
+
 	/// LOW: Shouldn't we be checking for stale status info so the update doesn't make decisions based on incorrect status data? On the other
 	/// hand the actual IMAP logic is passed all the way through to the DB so even if the server ends up with incorrect status information, the database
 	/// should remain accurate.
@@ -1034,49 +1279,46 @@ void imap_store(connection_t *con) {
 		serial_increment(OBJECT_MESSAGES, con->imap.user->usernum);
 	}
 
-	// Now that the updates are done we can create a deep copy of the meta data so we don't need to hold onto the session lock
+	inx_free(messages);
+
+	// Now that the updates are done we can pin a snapshot of the meta data so we don't need to hold onto the session lock
 	// while the status information is streamed out to the network.
-	if ((duplicate = imap_duplicate_messages(messages))) {
-		inx_free(messages);
+	if ((action & IMAP_FLAG_SILENT) != IMAP_FLAG_SILENT) {
+		snapshot = meta_snapshot_get(con->imap.user);
 	}
 
 	meta_user_unlock(con->imap.user);
 
 	// Loop through and output each message.
-	if ((action & IMAP_FLAG_SILENT) != IMAP_FLAG_SILENT && (cursor = inx_cursor_alloc(duplicate))) {
+	if (snapshot && (updated = imap_narrow_messages(snapshot->messages, con->imap.selected, imap_get_st_ar(con->imap.arguments, 0), con->imap.uid)) &&
+		(cursor = inx_cursor_alloc(updated))) {
 
 			while ((active = inx_cursor_value_next(cursor))) {
 
-				if (con->imap.uid) {
-					snprintf(buffer, 128, " UID %lu", active->messagenum);
-				}
-				else {
-					buffer[0] = '\0';
+				// Messages skipped because of the UNCHANGEDSINCE modifier weren't updated, so they aren't reported.
+				if (modified && imap_search_messages_range(active, modified, con->imap.uid) == 1) {
+					continue;
 				}
 
-				con_print(con, "* %lu FETCH (FLAGS (%s%s%s%s%s%s%s%s%s%s%s)%s)\r\n", active->sequencenum,
-					(active->status & MAIL_STATUS_ANSWERED) != 0 ? "\\Answered" : "",
-					(active->status & MAIL_STATUS_ANSWERED) != 0 && (active->status & MAIL_STATUS_FLAGGED) != 0 ? " " : "",
-					(active->status & MAIL_STATUS_FLAGGED) != 0 ? "\\Flagged" : "",
-					(active->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED)) != 0 && (active->status & MAIL_STATUS_DELETED) != 0 ? " " : "",
-					(active->status & MAIL_STATUS_DELETED) != 0 ? "\\Deleted" : "",
-					(active->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED | MAIL_STATUS_DELETED)) != 0 && (active->status & MAIL_STATUS_SEEN) != 0 ? " " : "",
-					(active->status & MAIL_STATUS_SEEN) != 0 ? "\\Seen" : "",
-					(active->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED | MAIL_STATUS_DELETED | MAIL_STATUS_SEEN)) != 0 && (active->status & MAIL_STATUS_DRAFT) != 0 ? " " : "",
-					(active->status & MAIL_STATUS_DRAFT) != 0 ? "\\Draft" : "",
-					(active->status & (MAIL_STATUS_ANSWERED | MAIL_STATUS_FLAGGED | MAIL_STATUS_DELETED | MAIL_STATUS_SEEN | MAIL_STATUS_DRAFT)) != 0 && (active->status & MAIL_STATUS_RECENT) != 0 ? " " : "",
-					(active->status & MAIL_STATUS_RECENT) != 0 ? "\\Recent" : "", buffer);
+				con_write_st(con, imap_flags_fetch(MANAGEDBUF(256), active, con->imap.uid, con->imap.condstore == 1));
 			}
 
 			inx_cursor_free(cursor);
 	}
 
 	// Cleanup
-	inx_free(duplicate);
+	inx_cleanup(updated);
+	meta_snapshot_release(snapshot);
 
 	// The relevant folder status changed.
 	if (imap_session_update(con) == 1) {
-		con_print(con, "* %lu EXISTS\r\n* %lu RECENT\r\n%.*s OK Store complete.\r\n", con->imap.messages_total, con->imap.messages_recent, st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		con_print(con, "* %lu EXISTS\r\n* %lu RECENT\r\n", con->imap.messages_total, con->imap.messages_recent);
+	}
+
+	if (modified) {
+		con_print(con, "%.*s OK [MODIFIED %.*s] Conditional store failed.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag),
+			st_length_int(modified), st_char_get(modified));
+		st_free(modified);
 	}
 	else {
 		con_print(con, "%.*s OK Store complete.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
@@ -1179,14 +1421,7 @@ void imap_close(connection_t *con) {
 	// If a folder was previously selected, clear the recent flag before closing the mailbox.
 	if (recent == 1) {
 		meta_user_wlock(con->imap.user);
-		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
-			while ((active = inx_cursor_value_next(cursor))) {
-				if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
-					active->status = (active->status | MAIL_STATUS_RECENT) ^ MAIL_STATUS_RECENT;
-				}
-			}
-			inx_cursor_free(cursor);
-		}
+		meta_counters_recent_clear(con->imap.user->folders, con->imap.user->messages, con->imap.selected);
 		meta_user_unlock(con->imap.user);
 	}
 
@@ -1200,7 +1435,8 @@ void imap_expunge(connection_t *con) {
 	int_t deleted = 0;
 	inx_cursor_t *cursor;
 	meta_message_t *active;
-	uint64_t sequencenum, expunged = 0;
+	stringer_t *vanished;
+	uint64_t sequencenum, messagenum, expunged = 0, *uids = NULL;
 
 	// Check for the right state.
 	if (con->imap.session_state != 1) {
@@ -1255,19 +1491,40 @@ void imap_expunge(connection_t *con) {
 			return;
 		}
 
+		// The expunged UIDs are recorded so they can be dropped from the messages the client knows about.
+		uids = mm_alloc(inx_count(con->imap.user->messages) * sizeof(uint64_t));
+
 		// Loop through and perform the deletes.
 		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
 			while ((active = inx_cursor_value_next(cursor))) {
 				if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_DELETED) == MAIL_STATUS_DELETED) {
 					sequencenum = active->sequencenum;
+					messagenum = active->messagenum;
 					if (imap_message_expunge(con, active) != 0) {
-						con_print(con, "* %lu EXPUNGE\r\n", sequencenum - expunged++);
+						if (uids) uids[expunged] = messagenum;
+						if (con->imap.qresync != 1) con_print(con, "* %lu EXPUNGE\r\n", sequencenum - expunged);
+						expunged++;
 					}
 				}
 			}
 			inx_cursor_free(cursor);
 		}
 
+		// Once QRESYNC is enabled, the expunged messages are reported using a single VANISHED response instead.
+		if (uids && expunged && con->imap.qresync == 1 && (vanished = imap_range_build(expunged, uids))) {
+			con_print(con, "* VANISHED %.*s\r\n", st_length_int(vanished), st_char_get(vanished));
+			st_free(vanished);
+		}
+
+		if (uids) {
+			imap_session_known_remove(con, uids, expunged);
+		}
+		else {
+			imap_session_known(con, META_LOCKED);
+		}
+
+		mm_cleanup(uids);
+
 		// Update all of the sequences at once.
 		meta_messages_update_sequences(con->imap.user->folders, con->imap.user->messages);
 
@@ -1460,86 +1717,253 @@ void imap_copy(connection_t *con) {
 	return;
 }
 
-void imap_append(connection_t *con) {
+void imap_move(connection_t *con) {
 
-	meta_folder_t *folder;
+	inx_t *messages;
+	int64_t moved;
 	inx_cursor_t *cursor;
+	meta_folder_t *folder;
 	meta_message_t *active;
-	uint32_t flags = MAIL_STATUS_EMPTY;
-	uint64_t recent = 0, exists = 0, outnum = 0;
+	size_t nodes, count = 0;
+	stringer_t *range = NULL;
+	uint64_t *uids = NULL, *sequences = NULL, target;
 
+	// Check for the right state.
 	if (con->imap.session_state != 1) {
-		con_print(con, "%.*s BAD The APPEND command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag),
+		con_print(con, "%.*s BAD The MOVE command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag),
 			st_char_get(con->imap.tag));
 		return;
 	}
-
-	// Input validation. Requires at least two arguments, and maximum of four. The first argument must be a string, and the last argument must be a literal.
-	if (ar_length_get(con->imap.arguments) < 2 || ar_length_get(con->imap.arguments) > 4 || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY ||
-		imap_get_type_ar(con->imap.arguments, ar_length_get(con->imap.arguments) - 1) != IMAP_ARGUMENT_TYPE_LITERAL) {
-
-		con_print(con, "%.*s NO The APPEND command must have between two and four arguments. The first argument must be a string "
-			"and the last argument must be a literal.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
-		log_pedantic("Invalid APPEND parameters.");
+	else if (con->imap.selected == 0) {
+		con_print(con, "%.*s BAD The MOVE command is not available until you have selected a folder.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
 		return;
 	}
-
-	// Over quota.
-	/// BUG: If the user is over their quota check whether rollout is enabled and if so. If enabled make room for the appended message using the rollout logic.
-	if ((con->imap.user->flags & META_USER_OVERQUOTA) == META_USER_OVERQUOTA) {
-		con_print(con, "%.*s NO This user account is over its quota. Try deleting older messages to free up space.\r\n", st_length_int(con->imap.tag),
+	else if (con->imap.read_only == 1) {
+		con_print(con, "%.*s BAD The MOVE command is not available while in read only mode.\r\n", st_length_int(con->imap.tag),
 			st_char_get(con->imap.tag));
 		return;
 	}
 
-	// Parse the list of flags.
-	if (ar_length_get(con->imap.arguments) > 2) {
-		flags = imap_flag_parse(imap_get_ptr(con->imap.arguments, 1), imap_get_type_ar(con->imap.arguments, 1));
+	// Input validation. Requires two string arguments.
+	else if (ar_length_get(con->imap.arguments) != 2 || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY ||
+		imap_get_type_ar(con->imap.arguments, 1) == IMAP_ARGUMENT_TYPE_ARRAY) {
+		con_print(con, "%.*s BAD The MOVE command requires two string arguments.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
 	}
 
 	meta_user_wlock(con->imap.user);
 
 	// Pull the folder structure.
-	if ((folder = meta_folders_by_name(con->imap.user->folders, imap_get_st_ar(con->imap.arguments, 0))) == NULL) {
+	if ((folder = meta_folders_by_name(con->imap.user->folders, imap_get_st_ar(con->imap.arguments, 1))) == NULL) {
 		meta_user_unlock(con->imap.user);
 		con_print(con, "%.*s NO [TRYCREATE] Unable to find the requested target folder.\r\n", st_length_int(con->imap.tag),
 			st_char_get(con->imap.tag));
 		return;
 	}
 
-	if (imap_append_message(con, folder, flags, imap_get_st_ar(con->imap.arguments, ar_length_get(con->imap.arguments) - 1), &outnum) != 1) {
+	// Make sure were not moving to the same folder.
+	else if ((target = folder->foldernum) == con->imap.selected) {
 		meta_user_unlock(con->imap.user);
-		con_print(con, "%.*s NO Unable to APPEND the message provided. Please try again later.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		con_print(con, "%.*s NO The target folder must be different than the selected folder.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
 		return;
 	}
 
-	// The message appended to the current folder, so we need to output the current status.
-	if (con->imap.selected == folder->foldernum) {
-
-		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
-			while ((active = inx_cursor_value_next(cursor))) {
-				if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
-					recent++;
-					exists++;
-				}
-				else if (active->foldernum == con->imap.selected) {
-					exists++;
-				}
-			}
-			inx_cursor_free(cursor);
-		}
+	// Make sure its a valid sequence number.
+	else if (imap_valid_sequence(imap_get_st_ar(con->imap.arguments, 0)) != 1) {
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s NO An invalid sequence was provided to the move command.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
+	}
 
-		con_print(con, "* %lu EXISTS\r\n* %lu RECENT\r\n", exists, recent);
+	// Narrow by the sequence range provided.
+	else if (con->imap.user->messages == NULL || (messages = imap_narrow_messages(con->imap.user->messages, con->imap.selected,
+		imap_get_st_ar(con->imap.arguments, 0), con->imap.uid)) == NULL) {
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s OK No messages were found matching the range provided.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
+	}
 
-		// Store the current serial number and folder status.
-		con->imap.messages_checkpoint = con->imap.user->serials.messages;
-		con->imap.messages_recent = recent;
-		con->imap.messages_total = exists;
+	// Figure out how many nodes.
+	else if ((nodes = inx_count(messages)) == 0) {
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s OK No messages were found matching the range provided.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		inx_free(messages);
+		return;
 	}
 
-	// Stash the folder number so we can release the session lock before making the final network print.
-	recent = folder->foldernum;
-	meta_user_unlock(con->imap.user);
+	// Setup the UID and sequence number buffers.
+	else if ((uids = mm_alloc(nodes * sizeof(uint64_t))) == NULL || (sequences = mm_alloc(nodes * sizeof(uint64_t))) == NULL) {
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s NO Internal server error. Please try again later.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		inx_free(messages);
+		mm_cleanup(uids);
+		return;
+	}
+
+	// Lock the account.
+	if (user_lock(con->imap.user->usernum) != 1) {
+		log_pedantic("Could not lock the user account %lu.", con->imap.user->usernum);
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s NO The MOVE command could not lock the user account. Try again later.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		inx_free(messages);
+		mm_free(uids);
+		mm_free(sequences);
+		return;
+	}
+
+	// Record the numbers before the move, since the narrowed collection holds copies which are ordered by message number.
+	if ((cursor = inx_cursor_alloc(messages))) {
+		while ((active = inx_cursor_value_next(cursor)) && count < nodes) {
+			uids[count] = active->messagenum;
+			sequences[count++] = active->sequencenum;
+		}
+		inx_cursor_free(cursor);
+	}
+
+	// The whole collection is moved inside a single transaction, so either every message moves or none of them do.
+	if ((moved = meta_messages_move(con->imap.user, messages, con->imap.selected, target, META_LOCKED)) < 0 || (size_t)moved != count) {
+		user_unlock(con->imap.user->usernum);
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s NO The messages could not be moved. Please try again later.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		inx_free(messages);
+		mm_free(uids);
+		mm_free(sequences);
+		return;
+	}
+
+	// If the serial number indicates no outside changes we can increment it without forcing a refresh.
+	if (con->imap.user->serials.messages == serial_get(OBJECT_MESSAGES, con->imap.user->usernum)) {
+		con->imap.messages_checkpoint = con->imap.user->serials.messages = serial_increment(OBJECT_MESSAGES, con->imap.user->usernum);
+	}
+	// The context is already due for a refresh, but we increment the serial to let the rest of the cluster know about the change.
+	else {
+		serial_increment(OBJECT_MESSAGES, con->imap.user->usernum);
+	}
+
+	// The expunge responses below account for the messages that left, so the session status is updated without being announced.
+	if ((folder = meta_folders_by_number(con->imap.user->folders, con->imap.selected))) {
+		con->imap.messages_recent = folder->counters.recent;
+		con->imap.messages_total = folder->counters.messages;
+	}
+
+	// The moved messages are reported as expunged below, so the client no longer knows about them.
+	imap_session_known_remove(con, uids, count);
+
+	user_unlock(con->imap.user->usernum);
+	meta_user_unlock(con->imap.user);
+
+	// The message numbers are preserved, so the UID set is the same in both folders.
+	if ((range = imap_range_build(count, uids))) {
+		con_print(con, "* OK [COPYUID %lu %.*s %.*s]\r\n", target, st_length_int(range), st_char_get(range), st_length_int(range),
+			st_char_get(range));
+	}
+
+	// Once QRESYNC is enabled, the moved messages are reported using a single VANISHED response instead.
+	if (con->imap.qresync == 1 && range) {
+		con_print(con, "* VANISHED %.*s\r\n", st_length_int(range), st_char_get(range));
+	}
+	else {
+		for (size_t i = 0; i < count; i++) {
+			con_print(con, "* %lu EXPUNGE\r\n", sequences[i] - i);
+		}
+	}
+
+	con_print(con, "%.*s OK Move completed.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+
+	st_cleanup(range);
+	inx_free(messages);
+	mm_free(uids);
+	mm_free(sequences);
+	return;
+}
+
+void imap_append(connection_t *con) {
+
+	meta_folder_t *folder;
+	inx_cursor_t *cursor;
+	meta_message_t *active;
+	uint32_t flags = MAIL_STATUS_EMPTY;
+	uint64_t recent = 0, exists = 0, outnum = 0;
+
+	if (con->imap.session_state != 1) {
+		con_print(con, "%.*s BAD The APPEND command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
+	}
+
+	// Input validation. Requires at least two arguments, and maximum of four. The first argument must be a string, and the last argument must be a literal.
+	if (ar_length_get(con->imap.arguments) < 2 || ar_length_get(con->imap.arguments) > 4 || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY ||
+		imap_get_type_ar(con->imap.arguments, ar_length_get(con->imap.arguments) - 1) != IMAP_ARGUMENT_TYPE_LITERAL) {
+
+		con_print(con, "%.*s NO The APPEND command must have between two and four arguments. The first argument must be a string "
+			"and the last argument must be a literal.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		log_pedantic("Invalid APPEND parameters.");
+		return;
+	}
+
+	// Over quota.
+	/// BUG: If the user is over their quota check whether rollout is enabled and if so. If enabled make room for the appended message using the rollout logic.
+	if ((con->imap.user->flags & META_USER_OVERQUOTA) == META_USER_OVERQUOTA) {
+		con_print(con, "%.*s NO This user account is over its quota. Try deleting older messages to free up space.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
+	}
+
+	// Parse the list of flags.
+	if (ar_length_get(con->imap.arguments) > 2) {
+		flags = imap_flag_parse(imap_get_ptr(con->imap.arguments, 1), imap_get_type_ar(con->imap.arguments, 1));
+	}
+
+	meta_user_wlock(con->imap.user);
+
+	// Pull the folder structure.
+	if ((folder = meta_folders_by_name(con->imap.user->folders, imap_get_st_ar(con->imap.arguments, 0))) == NULL) {
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s NO [TRYCREATE] Unable to find the requested target folder.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
+	}
+
+	if (imap_append_message(con, folder, flags, imap_get_st_ar(con->imap.arguments, ar_length_get(con->imap.arguments) - 1), &outnum) != 1) {
+		meta_user_unlock(con->imap.user);
+		con_print(con, "%.*s NO Unable to APPEND the message provided. Please try again later.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+
+	// The message appended to the current folder, so we need to output the current status.
+	if (con->imap.selected == folder->foldernum) {
+
+		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
+			while ((active = inx_cursor_value_next(cursor))) {
+				if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
+					recent++;
+					exists++;
+				}
+				else if (active->foldernum == con->imap.selected) {
+					exists++;
+				}
+			}
+			inx_cursor_free(cursor);
+		}
+
+		con_print(con, "* %lu EXISTS\r\n* %lu RECENT\r\n", exists, recent);
+
+		// Store the current serial number and folder status.
+		con->imap.messages_checkpoint = con->imap.user->serials.messages;
+		con->imap.messages_recent = recent;
+		con->imap.messages_total = exists;
+	}
+
+	// Stash the folder number so we can release the session lock before making the final network print.
+	recent = folder->foldernum;
+	meta_user_unlock(con->imap.user);
 
 	con_print(con, "%.*s OK [APPENDUID %lu %lu] Append complete.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag), recent, outnum);
 	return;
@@ -1547,12 +1971,17 @@ void imap_append(connection_t *con) {
 
 void imap_fetch(connection_t *con) {
 
-	int_t space = 0;
+	bool_t changed = false;
 	inx_cursor_t *cursor;
+	meta_counters_t totals = { .highest = 0 };
 	meta_message_t *active;
-	inx_t *messages, *duplicate;
+	meta_snapshot_t *snapshot;
+	inx_t *messages = NULL;
+	uint64_t first, last;
+	stringer_t *vanished;
 	imap_fetch_dataitems_t *items;
-	imap_fetch_response_t *response, *iterate;
+	imap_fetch_response_t *response;
+	imap_prefetch_t *prefetch;
 
 	// Check for the right state.
 	if (con->imap.session_state != 1) {
@@ -1582,6 +2011,18 @@ void imap_fetch(connection_t *con) {
 		return;
 	}
 
+	// The VANISHED modifier is only permitted with UID FETCH, and only once QRESYNC has been enabled.
+	else if (items->vanished == 1 && (con->imap.uid != 1 || con->imap.qresync != 1)) {
+		con_print(con, "%.*s BAD The VANISHED modifier requires UID FETCH and QRESYNC.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		imap_fetch_free_items(items);
+		return;
+	}
+
+	// Requesting modification sequences implicitly enables CONDSTORE.
+	if (items->modseq == 1) {
+		con->imap.condstore = 1;
+	}
+
 	// If were going to be updating flags, get a write lock.
 	if (con->imap.read_only == 0 && (items->normal != NULL || items->rfc822 == 1 || items->rfc822_header == 1 || items->rfc822_text == 1)) {
 		meta_user_wlock(con->imap.user);
@@ -1590,22 +2031,17 @@ void imap_fetch(connection_t *con) {
 		meta_user_rlock(con->imap.user);
 	}
 
-	// Narrow by the sequence range provided.
-	if (con->imap.user->messages == NULL || (messages = imap_narrow_messages(con->imap.user->messages, con->imap.selected, imap_get_st_ar(con->imap.arguments, 0), con->imap.uid)) == NULL) {
-		meta_user_unlock(con->imap.user);
-		con_print(con, "%.*s OK Fetch complete. No messages were found matching the range provided.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
-		imap_fetch_free_items(items);
-		return;
-	}
-
-	// If RFC822, RFC822.TEXT or any BODY[] items are requested, add the seen flag.
-	if (con->imap.read_only == 0 && (items->normal != NULL || items->rfc822 == 1 || items->rfc822_text == 1)) {
+	// If RFC822, RFC822.TEXT or any BODY[] items are requested, add the seen flag. The live messages are narrowed here, since
+	// the flag changes need to be applied to them, rather than to the snapshot.
+	if (con->imap.read_only == 0 && (items->normal != NULL || items->rfc822 == 1 || items->rfc822_text == 1) && con->imap.user->messages &&
+		(messages = imap_narrow_messages(con->imap.user->messages, con->imap.selected, imap_get_st_ar(con->imap.arguments, 0), con->imap.uid))) {
 		meta_data_flags_add(messages, con->imap.user->usernum, con->imap.selected, MAIL_STATUS_SEEN);
 		if ((cursor = inx_cursor_alloc(messages))) {
 			while ((active = inx_cursor_value_next(cursor))) {
 				if ((active->status & MAIL_STATUS_SEEN) != MAIL_STATUS_SEEN) {
-					active->status = (active->status | MAIL_STATUS_SEEN);
+					meta_counters_status(con->imap.user->folders, active, active->status | MAIL_STATUS_SEEN);
 					active->updated = 1;
+					changed = true;
 				}
 			}
 
@@ -1617,95 +2053,94 @@ void imap_fetch(connection_t *con) {
 			inx_cursor_free(cursor);
 		}
 
-		// If the serial number indicates no outside changes we can increment it without forcing a refresh.
-		if (con->imap.user->serials.messages == serial_get(OBJECT_MESSAGES, con->imap.user->usernum)) {
-			con->imap.messages_checkpoint = con->imap.user->serials.messages = serial_increment(OBJECT_MESSAGES, con->imap.user->usernum);
-		}
-		// The context is already due for a refresh, but we increment the serial to let the rest of the cluster know about the change.
-		else {
-			serial_increment(OBJECT_MESSAGES, con->imap.user->usernum);
+		// Only announce a change, and discard the snapshot, if a message was actually marked as seen.
+		if (changed) {
+
+			// If the serial number indicates no outside changes we can increment it without forcing a refresh.
+			if (con->imap.user->serials.messages == serial_get(OBJECT_MESSAGES, con->imap.user->usernum)) {
+				con->imap.messages_checkpoint = con->imap.user->serials.messages = serial_increment(OBJECT_MESSAGES, con->imap.user->usernum);
+			}
+			// The context is already due for a refresh, but we increment the serial to let the rest of the cluster know about the change.
+			else {
+				serial_increment(OBJECT_MESSAGES, con->imap.user->usernum);
+			}
+
+			meta_snapshot_invalidate(con->imap.user);
 		}
+
+		inx_free(messages);
+		messages = NULL;
+	}
+
+	// Pin a snapshot of the mailbox so we can unlock it during the fetch, without copying the messages.
+	snapshot = con->imap.user->messages ? meta_snapshot_get(con->imap.user) : NULL;
+
+	// The highest UID in use is needed to resolve an asterisk in the range used by the VANISHED modifier.
+	if (items->vanished == 1) {
+		meta_counters_total(con->imap.user->folders, &totals);
 	}
 
-	// Create a deep copy so we can unlock the mailbox during the fetch.
-	duplicate = imap_duplicate_messages(messages);
-	inx_free(messages);
 	meta_user_unlock(con->imap.user);
 
-	// Loop through and output each message.
-	if ((cursor = inx_cursor_alloc(duplicate))) {
-		while (status() && con_status(con) >= 0 && (active = inx_cursor_value_next(cursor))) {
+	// Report the messages in the requested range which have been expunged.
+	if (snapshot && items->vanished == 1 && imap_range_bounds(imap_get_st_ar(con->imap.arguments, 0), totals.highest, &first, &last) &&
+		(vanished = imap_range_vanished(snapshot->messages, con->imap.selected, first, last))) {
+		con_print(con, "* VANISHED (EARLIER) %.*s\r\n", st_length_int(vanished), st_char_get(vanished));
+		st_free(vanished);
+	}
 
-			// Fetch the data.
-			iterate = response = imap_fetch_message(con, active, items);
-			space = 0;
+	// Narrow by the sequence range provided.
+	if (!snapshot || !(messages = imap_narrow_messages(snapshot->messages, con->imap.selected, imap_get_st_ar(con->imap.arguments, 0), con->imap.uid))) {
+		con_print(con, "%.*s OK Fetch complete. No messages were found matching the range provided.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		meta_snapshot_release(snapshot);
+		imap_fetch_free_items(items);
+		return;
+	}
 
-			// Output the response.
-			con_print(con, "* %lu FETCH (", active->sequencenum);
+	// When structure items are requested, the stored structures for the whole range are loaded using a single query. Any message without
+	// a stored structure is parsed, and its structure stored, the first time it's fetched.
+	if ((items->body == 1 || items->bodystructure == 1 || items->normal != NULL || items->peek != NULL) && (cursor = inx_cursor_alloc(messages))) {
+		first = last = 0;
 
-			// Output the UID first.
-			while (iterate != NULL) {
+		while ((active = inx_cursor_value_next(cursor))) {
+			if (!first || active->messagenum < first) first = active->messagenum;
+			if (active->messagenum > last) last = active->messagenum;
+		}
 
-				if (!st_cmp_cs_eq(iterate->key, PLACER("UID", 3))) {
-					con_write_st(con, iterate->key);
-					con_write_bl(con, " ", 1);
-					con_write_st(con, iterate->value);
-					iterate = NULL;
-					space = 1;
-				}
-				else {
-					iterate = (imap_fetch_response_t *)iterate->next;
-				}
-			}
+		inx_cursor_free(cursor);
+		con->imap.structures = first ? mail_db_fetch_structures(con->imap.usernum, con->imap.selected, first, last) : NULL;
+	}
 
-			// Now output the size, if it is present.
-			iterate = response;
-			while (iterate != NULL) {
-				if (!st_cmp_cs_eq(iterate->key, PLACER("RFC822.SIZE", 11))) {
-					if (space == 1) {
-						con_write_bl(con, " ", 1);
-					}
-					else {
-						space = 1;
-					}
-					con_write_st(con, iterate->key);
-					con_write_bl(con, " ", 1);
-					con_write_st(con, iterate->value);
-					iterate = NULL;
-				}
-				else {
-					iterate = (imap_fetch_response_t *)iterate->next;
-				}
-			}
+	// Messages are loaded ahead on the worker threads, so the next message is read from disk while the current one is being written.
+	prefetch = imap_prefetch_start(con, messages, items);
 
-			// Output the rest of the items.
-			iterate = response;
-			while (iterate != NULL) {
-				if (st_cmp_cs_eq(iterate->key, PLACER("UID", 3)) && st_cmp_cs_eq(iterate->key, PLACER("RFC822.SIZE", 11))) {
-					if (space == 1) {
-						con_write_bl(con, " ", 1);
-					}
-					else {
-						space = 1;
-					}
-					con_write_st(con, iterate->key);
-					con_write_bl(con, " ", 1);
-					con_write_st(con, iterate->value);
-				}
-				iterate = (imap_fetch_response_t *)iterate->next;
+	// Loop through and output each message.
+	if ((cursor = inx_cursor_alloc(messages))) {
+		while (status() && con_status(con) >= 0 && (active = inx_cursor_value_next(cursor))) {
+
+			// The CHANGEDSINCE modifier limits the output to messages with a newer modification sequence.
+			if (items->changedsince && active->modseq <= items->changedsince) {
+				continue;
 			}
 
-			// Free the response and advance.
+			imap_prefetch_next(prefetch, active);
+			response = imap_fetch_message(con, active, items);
+			imap_fetch_write(con, active, response);
 			imap_fetch_response_free(response);
-			con_write_bl(con, ")\r\n", 3);
 		}
 
 		inx_cursor_free(cursor);
 	}
 
+	// Cancel anything still queued if the client disconnected, and wait for the messages being loaded before the snapshot is released.
+	imap_prefetch_finish(prefetch);
+
 	con_print(con, "%.*s OK Fetch complete.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 	imap_fetch_free_items(items);
-	inx_free(duplicate);
+	inx_cleanup(con->imap.structures);
+	con->imap.structures = NULL;
+	inx_free(messages);
+	meta_snapshot_release(snapshot);
 
 	return;
 }
@@ -1763,15 +2198,314 @@ void imap_search(connection_t *con) {
 	return;
 }
 
+/**
+ * @brief	Check whether the charset supplied with a SORT or THREAD command is supported.
+ * @param	charset		a managed string containing the charset name.
+ * @return	true if the charset is US-ASCII or UTF-8, or false otherwise.
+ */
+static bool_t imap_sort_charset(stringer_t *charset) {
+
+	return charset && (!st_cmp_ci_eq(charset, PLACER("US-ASCII", 8)) || !st_cmp_ci_eq(charset, PLACER("UTF-8", 5)));
+}
+
+/**
+ * @brief	Sort the messages matching a set of search criteria, as described by RFC 5256.
+ * @note	The handler isn't named imap_sort(), since that name is used by the function which sorts the command table.
+ * @param	con		a pointer to the connection object of the client issuing the command.
+ * @return	This function returns no value.
+ */
+void imap_sort_command(connection_t *con) {
+
+	inx_t *messages;
+	stringer_t *output;
+	uint8_t criteria[IMAP_SORT_CRITERIA_MAX + 1];
+
+	// Check for the right state.
+	if (con->imap.session_state != 1) {
+		con_print(con, "%.*s BAD The SORT command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (con->imap.selected == 0) {
+		con_print(con, "%.*s BAD The SORT command is not available until you have selected a folder.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+
+	// Input validation. Requires the sort criteria, a charset and at least one search key.
+	if (ar_length_get(con->imap.arguments) < 3 || imap_get_type_ar(con->imap.arguments, 0) != IMAP_ARGUMENT_TYPE_ARRAY ||
+		imap_get_type_ar(con->imap.arguments, 1) == IMAP_ARGUMENT_TYPE_ARRAY) {
+		con_print(con, "%.*s BAD The SORT command requires sort criteria, a charset and search criteria.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (imap_sort_criteria(imap_get_ar_ar(con->imap.arguments, 0), criteria) < 0) {
+		con_print(con, "%.*s BAD Invalid sort criteria.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (!imap_sort_charset(imap_get_st_ar(con->imap.arguments, 1))) {
+		con_print(con, "%.*s NO [BADCHARSET (US-ASCII UTF-8)] The requested charset is not supported.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	// Drop the sort criteria and charset, so the remaining arguments can be evaluated by the search functions.
+	else if (!ar_shift(con->imap.arguments, 2)) {
+		con_print(con, "%.*s NO Unable to process the search criteria.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+
+	// Perform the search, and then order the results using the stored envelopes.
+	messages = imap_search_messages(con);
+	output = imap_sort_messages(con, messages, criteria);
+
+	if (output && (output = st_append_opts(1024, output, con->imap.tag))) {
+		output = st_append_opts(1024, output, PLACER(" OK Sort completed.\r\n", 21));
+	}
+
+	if (st_populated(output) && status()) con_write_st(con, output);
+	else con_print(con, "%.*s NO Unable to sort the messages.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+
+	inx_cleanup(messages);
+	st_cleanup(output);
+	return;
+}
+
+/**
+ * @brief	Thread the messages matching a set of search criteria, using the REFERENCES algorithm described in RFC 5256.
+ * @param	con		a pointer to the connection object of the client issuing the command.
+ * @return	This function returns no value.
+ */
+void imap_thread(connection_t *con) {
+
+	inx_t *messages;
+	stringer_t *output;
+
+	// Check for the right state.
+	if (con->imap.session_state != 1) {
+		con_print(con, "%.*s BAD The THREAD command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (con->imap.selected == 0) {
+		con_print(con, "%.*s BAD The THREAD command is not available until you have selected a folder.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+
+	// Input validation. Requires the algorithm, a charset and at least one search key.
+	if (ar_length_get(con->imap.arguments) < 3 || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY ||
+		imap_get_type_ar(con->imap.arguments, 1) == IMAP_ARGUMENT_TYPE_ARRAY) {
+		con_print(con, "%.*s BAD The THREAD command requires an algorithm, a charset and search criteria.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (st_cmp_ci_eq(imap_get_st_ar(con->imap.arguments, 0), PLACER("REFERENCES", 10))) {
+		con_print(con, "%.*s BAD The requested threading algorithm is not supported.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (!imap_sort_charset(imap_get_st_ar(con->imap.arguments, 1))) {
+		con_print(con, "%.*s NO [BADCHARSET (US-ASCII UTF-8)] The requested charset is not supported.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (!ar_shift(con->imap.arguments, 2)) {
+		con_print(con, "%.*s NO Unable to process the search criteria.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+
+	messages = imap_search_messages(con);
+	output = imap_thread_messages(con, messages);
+
+	if (output && (output = st_append_opts(1024, output, con->imap.tag))) {
+		output = st_append_opts(1024, output, PLACER(" OK Thread completed.\r\n", 23));
+	}
+
+	if (st_populated(output) && status()) con_write_st(con, output);
+	else con_print(con, "%.*s NO Unable to thread the messages.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+
+	inx_cleanup(messages);
+	st_cleanup(output);
+	return;
+}
+
+/**
+ * @brief	Check whether another process has changed the folders or messages of an idling session.
+ * @note	This function is called from the idle connection thread, while the connection is parked.
+ * @param	con		a pointer to the connection object of the idling session.
+ * @return	true if the session should wake up and refresh its status, or false if nothing has changed.
+ */
+bool_t imap_idle_check(connection_t *con) {
+
+	if (con->imap.session_state != 1 || !con->imap.user || !con->imap.selected) {
+		return false;
+	}
+	else if (serial_get(OBJECT_MESSAGES, con->imap.user->usernum) != con->imap.messages_checkpoint ||
+		serial_get(OBJECT_FOLDERS, con->imap.user->usernum) != con->imap.folders_checkpoint) {
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief	Park an idling session until the client sends input or the mailbox changes.
+ * @note	If the client has already sent data, or the connection can't be parked, the session is resumed immediately.
+ * @param	con		a pointer to the connection object of the idling session.
+ * @return	This function returns no value.
+ */
+void imap_idle_wait(connection_t *con) {
+
+	// Input which has already been buffered won't trigger the socket, so it needs to be handled right away.
+	if ((pl_length_get(con->network.line) && st_length_get(con->network.buffer) > pl_length_get(con->network.line)) ||
+		(con->network.tls && tls_pending(con->network.tls) > 0) || con_compress_pending(con)) {
+		con->network.idle = CON_IDLE_READ;
+		imap_idle_resume(con);
+	}
+	else if (!con_idle_park(con, con->imap.user ? con->imap.user->usernum : 0, CON_IDLE_TIMEOUT, &imap_idle_resume, &imap_idle_check)) {
+		con->network.idle = CON_IDLE_READ;
+		imap_idle_resume(con);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Resume an idling session after it has been woken up by the idle connection thread.
+ * @note	Mailbox changes are reported using untagged EXPUNGE, FETCH, EXISTS and RECENT responses, the same as NOOP. The session stays idle until the
+ * 			client sends DONE, at which point the tagged response is sent and normal command processing resumes.
+ * @param	con		a pointer to the connection object of the idling session.
+ * @return	This function returns no value.
+ */
+void imap_idle_resume(connection_t *con) {
+
+	if (!status() || (con->network.idle & CON_IDLE_SHUTDOWN)) {
+		enqueue(&imap_logout, con);
+		return;
+	}
+	else if (con->network.idle & CON_IDLE_EXPIRED) {
+		con_write_bl(con, "* BYE The session has been idle too long. Goodbye.\r\n", 52);
+		con_destroy(con);
+		return;
+	}
+
+	if (con->imap.selected && con->imap.user) {
+		imap_session_report(con);
+	}
+
+	if (!(con->network.idle & CON_IDLE_READ)) {
+		imap_idle_wait(con);
+		return;
+	}
+
+	// Once data arrives the only valid input is the DONE continuation.
+	if (con_read_line(con, true) < 0) {
+		enqueue(&imap_logout, con);
+		return;
+	}
+	else if (!st_cmp_ci_eq(&(con->network.line), PLACER("DONE\r\n", 6)) || !st_cmp_ci_eq(&(con->network.line), PLACER("DONE\n", 5))) {
+		con_print(con, "%.*s OK IDLE terminated.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+	}
+	else {
+		con_print(con, "%.*s BAD Expected DONE to terminate the IDLE command.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		con->protocol.violations++;
+	}
+
+	imap_requeue(con);
+	return;
+}
+
+/**
+ * @brief	Enter the idle state, and wait for mailbox changes without occupying a worker thread.
+ * @see		RFC 2177
+ * @param	con		a pointer to the connection object of the remote session.
+ * @return	This function returns no value.
+ */
 void imap_idle(connection_t *con) {
 
 	if (con->imap.session_state != 1) {
 		con_print(con, "%.*s BAD The IDLE command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag),
 			st_char_get(con->imap.tag));
+		imap_requeue(con);
+		return;
 	}
-	else {
-		con_print(con, "%.*s NO IDLE Failed. The IDLE command is not currently supported.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+
+	con_write_bl(con, "+ idling\r\n", 10);
+	imap_idle_wait(con);
+
+	return;
+}
+
+/**
+ * @brief	Enable the CONDSTORE and QRESYNC extensions for the remainder of the session.
+ * @see		RFC 5161 and RFC 7162
+ * @note	Enabling QRESYNC implicitly enables CONDSTORE. Any other extension names are silently ignored, as the RFC requires.
+ * @param	con		a pointer to the connection object of the remote session.
+ * @return	This function returns no value.
+ */
+void imap_enable(connection_t *con) {
+
+	size_t number;
+	stringer_t *item;
+	int_t condstore = 0, qresync = 0;
+
+	if (con->imap.session_state != 1) {
+		con_print(con, "%.*s BAD The ENABLE command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
+	}
+	else if (!con->imap.arguments || !(number = ar_length_get(con->imap.arguments))) {
+		con_print(con, "%.*s BAD The ENABLE command requires at least one argument.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+
+	for (size_t i = 0; i < number; i++) {
+		if (imap_get_type_ar(con->imap.arguments, i) != IMAP_ARGUMENT_TYPE_ARRAY && (item = imap_get_st_ar(con->imap.arguments, i))) {
+			if (!st_cmp_ci_eq(item, PLACER("CONDSTORE", 9))) condstore = 1;
+			else if (!st_cmp_ci_eq(item, PLACER("QRESYNC", 7))) qresync = 1;
+		}
+	}
+
+	// Only the extensions which weren't already enabled are listed in the response.
+	con_print(con, "* ENABLED%s%s\r\n%.*s OK ENABLE Complete.\r\n", condstore && !con->imap.condstore ? " CONDSTORE" : "",
+		qresync && !con->imap.qresync ? " QRESYNC" : "", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+
+	con->imap.condstore |= condstore | qresync;
+	con->imap.qresync |= qresync;
+
+	return;
+}
+
+/**
+ * @brief	Enable DEFLATE compression for the remainder of the session.
+ * @see		RFC 4978
+ * @note	The tagged response is the last thing sent uncompressed, so the streams are only created after it has been written. If they
+ * 			can't be created the client will already be expecting compressed data, so the connection is dropped.
+ * @param	con		a pointer to the connection object of the remote session.
+ * @return	This function returns no value.
+ */
+void imap_compress(connection_t *con) {
+
+	stringer_t *mechanism;
+
+	if (con->imap.session_state != 1) {
+		con_print(con, "%.*s BAD The COMPRESS command is not available until you are authenticated.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
 	}
+	else if (!con->imap.arguments || ar_length_get(con->imap.arguments) != 1 || imap_get_type_ar(con->imap.arguments, 0) == IMAP_ARGUMENT_TYPE_ARRAY ||
+		!(mechanism = imap_get_st_ar(con->imap.arguments, 0))) {
+		con_print(con, "%.*s BAD The COMPRESS command requires a single argument.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (st_cmp_ci_eq(mechanism, PLACER("DEFLATE", 7))) {
+		con_print(con, "%.*s BAD The only supported compression mechanism is DEFLATE.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+		return;
+	}
+	else if (con->network.compress) {
+		con_print(con, "%.*s NO [COMPRESSIONACTIVE] DEFLATE compression is already active.\r\n", st_length_int(con->imap.tag),
+			st_char_get(con->imap.tag));
+		return;
+	}
+
+	con_print(con, "%.*s OK DEFLATE active.\r\n", st_length_int(con->imap.tag), st_char_get(con->imap.tag));
+
+	if (!con_compress_start(con, magma.imap.compress_level)) {
+		log_pedantic("Unable to enable compression for an IMAP session.");
+		con->network.status = -1;
+	}
+
 	return;
 }
 
@@ -1837,7 +2571,7 @@ void imap_capability(connection_t *con) {
 	}
 
 	// STARTTLS should only appear if the server instance has been configured with an TLS certificate. The connection must also be pre-authentication and unencrypted.
-	con_print(con, "* CAPABILITY IMAP4 IMAP4rev1%sLITERAL+ ID\r\n%.*s OK Completed.\r\n", con_secure(con) == 0 && con->imap.session_state == 0 ?
+	con_print(con, "* CAPABILITY IMAP4 IMAP4rev1%sLITERAL+ ID IDLE ENABLE CONDSTORE QRESYNC COMPRESS=DEFLATE SORT THREAD=REFERENCES MOVE\r\n%.*s OK Completed.\r\n", con_secure(con) == 0 && con->imap.session_state == 0 ?
 		" STARTTLS " : " ",	st_length_int(con->imap.tag), st_char_get(con->imap.tag));
 
 	return;
@@ -1856,7 +2590,7 @@ void imap_init(connection_t *con) {
 	con_reverse_enqueue(con);
 
 	// Introduce ourselves. Note the string below needs to stay in sync with the capability command.
-	con_print(con, "* OK [CAPABILITY IMAP4 IMAP4rev1%sLITERAL+ ID]%s%.*s%sMagma IMAP server v%s is ready.\r\n",
+	con_print(con, "* OK [CAPABILITY IMAP4 IMAP4rev1%sLITERAL+ ID IDLE ENABLE CONDSTORE QRESYNC COMPRESS=DEFLATE SORT THREAD=REFERENCES MOVE]%s%.*s%sMagma IMAP server v%s is ready.\r\n",
 		con_secure(con) == 0 ? " STARTTLS " : " ", st_length_get(con->server->domain) ? " " : "", st_length_int(con->server->domain),
 		st_char_get(con->server->domain), st_length_get(con->server->domain) ? " " : "", build_version());
 
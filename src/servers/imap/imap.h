@@ -12,6 +12,12 @@
 #define IMAP_SEARCH_RECURSION_LIMIT 16
 #define IMAP_FOLDER_RECURSION_LMIIT 16
 
+// The number of unindexed messages a single SEARCH command will add to the full text index, before falling back to scanning.
+#define IMAP_SEARCH_INDEX_LIMIT 1024
+
+// The number of partial envelopes a single SORT or THREAD command will complete by loading the messages they describe.
+#define IMAP_SORT_REFRESH_LIMIT 1024
+
 // IMAP Argument types.
 #define IMAP_ARGUMENT_TYPE_EMPTY 0
 #define IMAP_ARGUMENT_TYPE_ARRAY 1
@@ -28,6 +34,17 @@
 #define IMAP_FETCH_BODY_MIME 5
 #define IMAP_FETCH_BODY_PART 6
 
+// IMAP SORT criteria, which are combined with the reverse modifier bit.
+#define IMAP_SORT_ARRIVAL 1
+#define IMAP_SORT_CC 2
+#define IMAP_SORT_DATE 3
+#define IMAP_SORT_FROM 4
+#define IMAP_SORT_SIZE 5
+#define IMAP_SORT_SUBJECT 6
+#define IMAP_SORT_TO 7
+#define IMAP_SORT_REVERSE 0x80
+#define IMAP_SORT_CRITERIA_MAX 16
+
 // IMAP Flags actions.
 #define IMAP_FLAG_SILENT 1
 #define IMAP_FLAG_ADD 2
@@ -45,7 +62,6 @@ imap_fetch_response_t *  imap_fetch_response_add(imap_fetch_response_t *response
 void                     imap_fetch_response_free(imap_fetch_response_t *response);
 
 /// fetch.c
-inx_t *                   imap_duplicate_messages(inx_t *messages);
 imap_fetch_response_t *   imap_fetch_body(array_t *outer, array_t *partial, connection_t *con, meta_message_t *meta,mail_message_t **message, stringer_t **header, imap_fetch_response_t *output);
 stringer_t *              imap_fetch_body_header(placer_t header, imap_arguments_t *array, int_t not);
 stringer_t *              imap_fetch_body_mime(placer_t header);
@@ -60,6 +76,7 @@ int_t                     imap_fetch_parse_partial(stringer_t *partial, size_t *
 stringer_t *              imap_fetch_return_header(connection_t *con, meta_message_t *meta, mail_message_t **message, stringer_t **header, imap_fetch_response_t *output);
 mail_message_t *          imap_fetch_return_message(connection_t *con, meta_message_t *meta, mail_message_t **message, stringer_t **header, imap_fetch_response_t *output);
 mail_mime_t *             imap_fetch_return_mime(connection_t *con, meta_message_t *meta, mail_message_t **message, stringer_t **header, imap_fetch_response_t *output);
+mail_structure_t *        imap_fetch_return_structure(connection_t *con, meta_message_t *meta, mail_message_t **message, stringer_t **header, imap_fetch_response_t *output, bool_t text);
 stringer_t *              imap_fetch_return_text(connection_t *con, meta_message_t *meta, mail_message_t **message, stringer_t **header, imap_fetch_response_t *output);
 inx_t *                   imap_narrow_messages(inx_t *messages, uint64_t selected, stringer_t *range, int_t uid);
 imap_fetch_dataitems_t *  imap_parse_dataitems(imap_arguments_t *arguments);
@@ -68,6 +85,7 @@ int_t                     imap_valid_sequence(stringer_t *range);
 /// flags.c
 int_t      imap_flag_action(stringer_t *string);
 uint32_t   imap_flag_parse(void *ptr, int_t type);
+stringer_t * imap_flags_fetch(stringer_t *output, meta_message_t *message, int_t uid, int_t modseq);
 uint32_t   imap_get_flag(stringer_t *string);
 void       imap_update_flags(meta_user_t *user, inx_t *messages, uint64_t foldernum, int_t action, uint32_t flags);
 
@@ -78,7 +96,8 @@ int_t         imap_folder_create(uint64_t usernum, inx_t *folders, stringer_t *n
 stringer_t *  imap_folder_name_escaped(inx_t *folders, meta_folder_t *active);
 int_t         imap_folder_remove(uint64_t usernum, inx_t *folders, inx_t *messages, stringer_t *name);
 int_t         imap_folder_rename(uint64_t usernum, inx_t *folders, stringer_t *original, stringer_t *rename);
-int_t         imap_folder_status(inx_t *folders, inx_t *messages, stringer_t *name, imap_folder_status_t *status);
+int_t         imap_folder_status(inx_t *folders, stringer_t *name, imap_folder_status_t *status);
+uint64_t      imap_folder_unseen(inx_t *folders, inx_t *messages, uint64_t foldernum);
 inx_t *       imap_narrow_folders(inx_t *folders, stringer_t *reference, stringer_t *mailbox);
 uint64_t      imap_next_folder_order(inx_t *folders, uint64_t parent);
 bool_t        imap_valid_folder_name(stringer_t *name);
@@ -88,28 +107,36 @@ void   imap_append(connection_t *con);
 void   imap_capability(connection_t *con);
 void   imap_check(connection_t *con);
 void   imap_close(connection_t *con);
+void   imap_compress(connection_t *con);
 void   imap_copy(connection_t *con);
 void   imap_create(connection_t *con);
 void   imap_delete(connection_t *con);
+void   imap_enable(connection_t *con);
 void   imap_examine(connection_t *con);
 void   imap_expunge(connection_t *con);
 void   imap_fetch(connection_t *con);
 void   imap_id(connection_t *con);
 void   imap_idle(connection_t *con);
+bool_t imap_idle_check(connection_t *con);
+void   imap_idle_resume(connection_t *con);
+void   imap_idle_wait(connection_t *con);
 void   imap_init(connection_t *con);
 void   imap_invalid(connection_t *con);
 void   imap_list(connection_t *con);
 void   imap_login(connection_t *con);
 void   imap_logout(connection_t *con);
 void   imap_lsub(connection_t *con);
+void   imap_move(connection_t *con);
 void   imap_noop(connection_t *con);
 void   imap_rename(connection_t *con);
 void   imap_search(connection_t *con);
 void   imap_select(connection_t *con);
+void   imap_sort_command(connection_t *con);
 void   imap_starttls(connection_t *con);
 void   imap_status(connection_t *con);
 void   imap_store(connection_t *con);
 void   imap_subscribe(connection_t *con);
+void   imap_thread(connection_t *con);
 void   imap_unsubscribe(connection_t *con);
 
 /// messages.c
@@ -140,8 +167,16 @@ int_t               imap_parse_literal(connection_t *con, stringer_t **output, c
 int_t               imap_parse_nstring(stringer_t **output, chr_t **start, size_t *length, chr_t type);
 int_t               imap_parse_qstring(stringer_t **output, chr_t **start, size_t *length);
 
+/// prefetch.c
+void               imap_prefetch_finish(imap_prefetch_t *prefetch);
+void               imap_prefetch_load(imap_prefetch_job_t *job);
+void               imap_prefetch_next(imap_prefetch_t *prefetch, meta_message_t *active);
+imap_prefetch_t *  imap_prefetch_start(connection_t *con, inx_t *messages, imap_fetch_dataitems_t *items);
+
 /// range.c
+bool_t        imap_range_bounds(stringer_t *range, uint64_t star, uint64_t *first, uint64_t *last);
 stringer_t *  imap_range_build(size_t length, uint64_t *numbers);
+stringer_t *  imap_range_vanished(inx_t *messages, uint64_t foldernum, uint64_t first, uint64_t last);
 
 /// search.c
 int_t    imap_search_flag(uint32_t status, uint32_t flag, int_t has);
@@ -157,6 +192,16 @@ int_t    imap_search_messages_text(connection_t *con, meta_user_t *user, mail_me
 
 /// sessions.c
 void    imap_session_destroy(connection_t *con);
+void    imap_session_known(connection_t *con, META_LOCK_STATUS locked);
+void    imap_session_known_remove(connection_t *con, uint64_t *uids, size_t count);
+void    imap_session_report(connection_t *con);
 int_t   imap_session_update(connection_t *con);
 
+/// sort.c
+int_t         imap_sort_criteria(imap_arguments_t *array, uint8_t *criteria);
+time_t        imap_sort_date(stringer_t *date);
+stringer_t *  imap_sort_messages(connection_t *con, inx_t *messages, uint8_t *criteria);
+stringer_t *  imap_sort_subject(stringer_t *subject, bool_t *reply);
+stringer_t *  imap_thread_messages(connection_t *con, inx_t *messages);
+
 #endif
@@ -36,8 +36,12 @@ int_t imap_append_message(connection_t *con, meta_folder_t *folder, uint32_t fla
 	if (inx_append(con->imap.user->messages, key, new) != true) {
 		mm_free(new);
 	}
+	else {
+		meta_counters_add(con->imap.user->folders, new);
+	}
 
 	meta_messages_update_sequences(con->imap.user->folders, con->imap.user->messages);
+	meta_snapshot_invalidate(con->imap.user);
 
 	// Update the checkpoint, so other connections know things have changed.
 	if (con->imap.user->serials.messages != serial_get(OBJECT_MESSAGES, con->imap.user->usernum)) {
@@ -58,7 +62,9 @@ int_t imap_message_expunge(connection_t *con, meta_message_t *message) {
 		return 0;
 	}
 
+	meta_counters_remove(con->imap.user->folders, message);
 	inx_delete(con->imap.user->messages, key);
+	meta_snapshot_invalidate(con->imap.user);
 	return 1;
 }
 
@@ -86,6 +92,7 @@ int_t imap_message_copier(connection_t *con, meta_message_t *message, uint64_t t
 
 	*outnum = new->messagenum = key.val.u64;
 	new->foldernum = target;
+	new->modseq = 0;
 
 	// Messages added to a folder should be distinguished by having the recent flag.
 	new->status = status | MAIL_STATUS_RECENT;
@@ -97,8 +104,12 @@ int_t imap_message_copier(connection_t *con, meta_message_t *message, uint64_t t
 	if (inx_append(con->imap.user->messages, key, new) != true) {
 		mm_free(new);
 	}
+	else {
+		meta_counters_add(con->imap.user->folders, new);
+	}
 
 	meta_messages_update_sequences(con->imap.user->folders, con->imap.user->messages);
+	meta_snapshot_invalidate(con->imap.user);
 
 	// If the serial number indicates no outside changes we can increment the checkpoint and store the value. Otherwise we just increment it
 	// so a full refresh will be triggered.
@@ -139,6 +139,165 @@ stringer_t * imap_mailbox_to_string(stringer_t *mailbox) {
 
 */
 
+// The character classes used by the string parsers. Each byte of input is classified with a single table lookup, instead of
+// the chain of comparisons the grammar would otherwise require, so the scanning loops only branch on the characters which end a token.
+#define IMAP_PARSE_ATOM 0x01
+#define IMAP_PARSE_PAREN 0x02
+#define IMAP_PARSE_BRACKET 0x04
+#define IMAP_PARSE_QUOTED 0x08
+
+// The number of elements a list can hold before the parser has to allocate a larger scratch buffer.
+#define IMAP_PARSE_LIST_LOCAL 16
+
+static const uint8_t imap_parse_classes[256] = {
+	[0x01 ... 0x7f] = IMAP_PARSE_QUOTED,
+	['!' ... '~'] = IMAP_PARSE_ATOM | IMAP_PARSE_PAREN | IMAP_PARSE_BRACKET | IMAP_PARSE_QUOTED,
+	['\r'] = 0,
+	['\n'] = 0,
+	['"'] = 0,
+	['\\'] = IMAP_PARSE_ATOM | IMAP_PARSE_PAREN | IMAP_PARSE_BRACKET,
+	['['] = IMAP_PARSE_QUOTED,
+	['('] = IMAP_PARSE_PAREN | IMAP_PARSE_BRACKET | IMAP_PARSE_QUOTED,
+	[')'] = IMAP_PARSE_ATOM | IMAP_PARSE_BRACKET | IMAP_PARSE_QUOTED,
+	[']'] = IMAP_PARSE_ATOM | IMAP_PARSE_PAREN | IMAP_PARSE_QUOTED
+};
+
+typedef struct {
+	uint32_t type;
+	void *pointer;
+} imap_parse_item_t;
+
+// The elements of a list are collected here while it's being parsed, so the resulting array can be allocated once, at its final size.
+typedef struct {
+	size_t count, avail;
+	imap_parse_item_t *items, local[IMAP_PARSE_LIST_LOCAL];
+} imap_parse_list_t;
+
+/**
+ * @brief	Prepare an empty list builder.
+ * @param	list	a pointer to the list builder being initialized.
+ * @return	This function returns no value.
+ */
+static void imap_parse_list_init(imap_parse_list_t *list) {
+
+	list->count = 0;
+	list->items = list->local;
+	list->avail = IMAP_PARSE_LIST_LOCAL;
+
+	return;
+}
+
+/**
+ * @brief	Free a list builder, along with any of the elements it's still holding.
+ * @param	list	a pointer to the list builder being freed.
+ * @return	This function returns no value.
+ */
+static void imap_parse_list_free(imap_parse_list_t *list) {
+
+	for (size_t i = 0; i < list->count; i++) {
+
+		if (list->items[i].type == IMAP_ARGUMENT_TYPE_ARRAY && list->items[i].pointer) {
+			ar_free(list->items[i].pointer);
+		}
+		else {
+			st_cleanup(list->items[i].pointer);
+		}
+	}
+
+	if (list->items != list->local) {
+		mm_free(list->items);
+	}
+
+	imap_parse_list_init(list);
+
+	return;
+}
+
+/**
+ * @brief	Add an element to the end of a list builder.
+ * @note	The scratch buffer doubles in size whenever it fills up, so a long list costs a logarithmic number of allocations.
+ * @param	list	a pointer to the list builder.
+ * @param	type	the IMAP argument type of the element.
+ * @param	pointer	the value of the element, which the list takes ownership of, even on failure.
+ * @return	true on success, or false on failure.
+ */
+static bool_t imap_parse_list_push(imap_parse_list_t *list, uint32_t type, void *pointer) {
+
+	imap_parse_item_t *items;
+
+	if (list->count == list->avail) {
+
+		if (list->avail * 2 >= ARRAY_MAX_ELEMENTS || !(items = mm_alloc(list->avail * 2 * sizeof(imap_parse_item_t)))) {
+			log_pedantic("Unable to grow the IMAP argument list. { count = %zu }", list->count);
+
+			if (type == IMAP_ARGUMENT_TYPE_ARRAY && pointer) {
+				ar_free(pointer);
+			}
+			else {
+				st_cleanup(pointer);
+			}
+
+			return false;
+		}
+
+		mm_copy(items, list->items, list->count * sizeof(imap_parse_item_t));
+
+		if (list->items != list->local) {
+			mm_free(list->items);
+		}
+
+		list->items = items;
+		list->avail *= 2;
+	}
+
+	list->items[list->count].type = type;
+	list->items[list->count].pointer = pointer;
+	list->count++;
+
+	return true;
+}
+
+/**
+ * @brief	Convert a list builder into an imap arguments array, sized to fit the elements exactly.
+ * @note	The list builder is emptied, whether or not the conversion succeeds.
+ * @param	list	a pointer to the list builder.
+ * @param	output	the address of a pointer that will receive the resulting array, or NULL if the list was empty.
+ * @return	true on success, or false on failure.
+ */
+static bool_t imap_parse_list_build(imap_parse_list_t *list, imap_arguments_t **output) {
+
+	imap_arguments_t *array;
+
+	*output = NULL;
+
+	if (!list->count) {
+		imap_parse_list_free(list);
+		return true;
+	}
+	else if (!(array = ar_alloc(list->count))) {
+		imap_parse_list_free(list);
+		return false;
+	}
+
+	// The array was sized to fit, so the push can only fail on an invalid element, which means the list itself is broken.
+	for (size_t i = 0; i < list->count; i++) {
+		if (!ar_push(array, list->items[i].type, list->items[i].pointer)) {
+			ar_length_set(array, 0);
+			mm_free(array);
+			imap_parse_list_free(list);
+			return false;
+		}
+	}
+
+	// The elements now belong to the array.
+	list->count = 0;
+	imap_parse_list_free(list);
+
+	*output = array;
+
+	return true;
+}
+
 /**
  * @brief	Extract the contents of an atomic string and advance the position of the parser stream.
  * @note	This function scans a string, expecting printable ASCII characters until it encounters a space, \r, \n, (, or [.
@@ -163,7 +322,7 @@ int_t imap_parse_astring(stringer_t **output, chr_t **start, size_t *length) {
 	*output = NULL;
 
 	// Advance until we have a break character.
-	while (left && *holder >= '!' && *holder <= '~' && *holder != '"' && *holder != '[' && *holder != '(') {
+	while (left && (imap_parse_classes[(uchr_t)*holder] & IMAP_PARSE_ATOM)) {
 		holder++;
 		left--;
 	}
@@ -199,6 +358,7 @@ int_t imap_parse_nstring(stringer_t **output, chr_t **start, size_t *length, chr
 	chr_t *holder;
 	size_t left;
 	stringer_t *result;
+	uint8_t class = (type == ']' ? IMAP_PARSE_BRACKET : IMAP_PARSE_PAREN);
 
 	// Get setup.
 	holder = *start;
@@ -206,7 +366,7 @@ int_t imap_parse_nstring(stringer_t **output, chr_t **start, size_t *length, chr
 	*output = NULL;
 
 	// Advance until we have a break character.
-	while (left != 0 && *holder >= '!' && *holder <= '~' && *holder != '"' && *holder != '[' && *holder != type) {
+	while (left != 0 && (imap_parse_classes[(uchr_t)*holder] & class)) {
 		holder++;
 		left--;
 	}
@@ -250,10 +410,8 @@ int_t imap_parse_nstring(stringer_t **output, chr_t **start, size_t *length, chr
  */
 int_t imap_parse_qstring(stringer_t **output, chr_t **start, size_t *length) {
 
-	chr_t *writer;
-	chr_t *holder;
-	size_t left;
-	int_t escape = 0;
+	chr_t *writer, *reader, *begin, *holder;
+	size_t left, escapes = 0;
 	stringer_t *result;
 
 	// Get setup.
@@ -270,87 +428,71 @@ int_t imap_parse_qstring(stringer_t **output, chr_t **start, size_t *length) {
 		left--;
 	}
 
-	// Advance until we have a break character. Technically holder should be less than 127, but because were using a signed char, greater values are below NULL.
-	while (left && *holder > '\0' && *holder != '\r' && *holder != '\n' && (escape == 1 || *holder != '"')) {
+	begin = holder;
+
+	// Advance until we have a break character. Ordinary characters are skipped using the class table, which also rejects anything
+	// outside of the 7-bit range, so only the escapes need to be examined individually.
+	while (left) {
 
-		if (escape == 0 && *holder == '\\') {
-			escape = 1;
+		if (imap_parse_classes[(uchr_t)*holder] & IMAP_PARSE_QUOTED) {
+			holder++;
+			left--;
 		}
-		else if (escape != 0) {
-			escape = 0;
+		// The escaped character is taken literally, provided it could legally appear in a quoted string.
+		else if (*holder == '\\' && left > 1 && *(holder + 1) > '\0' && *(holder + 1) != '\r' && *(holder + 1) != '\n') {
+			holder += 2;
+			left -= 2;
+			escapes++;
+		}
+		else {
+			break;
 		}
-
-		holder++;
-		left--;
 	}
 
 	// Check for valid data.
-	if (*holder != '"') {
+	if (!left || *holder != '"') {
 		return -1;
 	}
-	// Check for empty quoted strings. We return 1, but we also return a NULL pointer.
-	if ((*start) + 1 == holder) {
 
-		// Advance to the next argument.
-		if (left) {
-			holder++;
-			left--;
-		}
+	// Check for empty quoted strings. We return 1, but we also return a NULL pointer.
+	if (begin == holder) {
+		result = NULL;
+	}
+	// Without any escapes, the contents can be copied as is.
+	else if (!escapes) {
 
-		// There should be a space before the next argument.
-		if (left && *holder == ' ') {
-			holder++;
-			left--;
+		if (!(result = st_import(begin, holder - begin))) {
+			log_pedantic("Unable to extract the quoted string.");
+			return -1;
 		}
 
-		// Update
-		*start = holder;
-		*length = left;
-		return 1;
-	}
-
-	// Allocate a buffer for the output.
-	if (!(result = st_alloc(holder - *start))) {
-		log_pedantic("Unable to allocate a buffer for the quoted string.");
-		return -1;
 	}
+	else {
 
-	// Get setup for the copy.
-	writer = st_char_get(result);
-	holder = *start;
-	left = *length;
+		// Allocate a buffer for the output.
+		if (!(result = st_alloc(holder - begin - escapes))) {
+			log_pedantic("Unable to allocate a buffer for the quoted string.");
+			return -1;
+		}
 
-	// Skip the open quote again.
-	holder++;
-	left--;
+		writer = st_char_get(result);
 
-	// Advance until we have a break character. Technically holder should be less than 127, but because were using a signed char, greater values are below NULL.
-	while (left && *holder > '\0' && *holder != '\r' && *holder != '\n' && (escape == 1 || *holder != '"')) {
+		// Copy everything except the escape characters themselves.
+		for (reader = begin; reader < holder; reader++) {
 
-		if (escape == 0 && *holder == '\\') {
-			escape = 1;
-		}
-		else if (escape != 0) {
-			escape = 0;
-		}
+			if (*reader == '\\') {
+				reader++;
+			}
 
-		// Copy unless we have the escape character.
-		if (!escape) {
-			*writer = *holder;
-			writer++;
+			*writer++ = *reader;
 		}
 
-		holder++;
-		left--;
+		st_length_set(result, holder - begin - escapes);
 	}
 
-	st_length_set(result, writer - (chr_t *)st_char_get(result));
-
-	// Advance to the next argument.
-	if (left) {
-		holder++;
-		left--;
-	}
+	// Skip the closing quote.
+	holder++;
+	left--;
 
 	// There should be a space before the next argument.
 	if (left && *holder == ' ') {
@@ -427,12 +569,12 @@ int_t imap_parse_literal(connection_t *con, stringer_t **output, chr_t **start,
 
 	literal = (size_t)number;
 
-	// If the number is larger than 128 megabytes, then reject it.
-	if (!plus && number > 134217728) {
+	// If the number is larger than the configured limit, then reject it.
+	if (!plus && number > magma.imap.literal_limit) {
 		return -1;
 	}
 	// They client is already transmitting, so read the entire file, then reject it.
-	else if (number > 134217728) {
+	else if (number > magma.imap.literal_limit) {
 
 		while (number > 0) {
 
@@ -501,11 +643,15 @@ int_t imap_parse_literal(connection_t *con, stringer_t **output, chr_t **start,
 		return 1;
 	}
 
-	// Allocate a stringer for the buffer.
-	if (!(result = st_alloc(literal))) {
+	// Allocate a stringer for the buffer. Large literals, which are usually appended messages, are read into a shared memory map backed
+	// by the spool, so the kernel can page them out while they're compressed and stored.
+	if (!(result = (literal > magma.imap.literal_spool ? st_alloc_opts(MAPPED_T | JOINTED | HEAP | SHARED, literal) : st_alloc(literal)))) {
 		log_pedantic("Unable to allocate a buffer of %lu bytes for the literal argument.", literal);
 		return -1;
 	}
+	else if (literal > magma.imap.literal_spool) {
+		stats_increment_by_name("imap.literals.spooled");
+	}
 
 	// So we know how many more characters to read.
 	left = literal;
@@ -597,6 +743,7 @@ int_t imap_parse_array(int_t recursion, connection_t *con, imap_arguments_t **ar
 	chr_t type;
 	stringer_t *result = NULL;
 	imap_arguments_t *inner = NULL;
+	imap_parse_list_t list;
 
 	// Recursion limiter.
 	if (recursion >= IMAP_ARRAY_RECURSION_LIMIT) {
@@ -624,53 +771,51 @@ int_t imap_parse_array(int_t recursion, connection_t *con, imap_arguments_t **ar
 		return -1;
 	}
 
+	imap_parse_list_init(&list);
+
 	while (*length && **start != type && **start >= '!' && **start <= '~') {
 		// Quoted strings.
 		if (**start == '"') {
 
-			if (imap_parse_qstring(&result, start, length) != 1) {
+			if (imap_parse_qstring(&result, start, length) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_QSTRING, result)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(array, IMAP_ARGUMENT_TYPE_QSTRING, result);
 		}
 		// Literal strings.
 		else if (**start == '{') {
 
-			if (imap_parse_literal(con, &result, start, length) != 1) {
+			if (imap_parse_literal(con, &result, start, length) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_LITERAL, result)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(array, IMAP_ARGUMENT_TYPE_LITERAL, result);
 		}
 		// Parenthetical/blocked arrays.
 		else if (**start == '(' || **start == '[') {
 
-			if (imap_parse_array(recursion + 1, con, &inner, start, length) != 1) {
-
-				if (inner) {
-					ar_free(inner);
-				}
-
+			if (imap_parse_array(recursion + 1, con, &inner, start, length) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_ARRAY, inner)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(array, IMAP_ARGUMENT_TYPE_ARRAY, inner);
 			inner = NULL;
 		}
 		// Nil strings.
 		else if (**start >= '!' && **start <= '~') {
 
-			if (imap_parse_nstring(&result, start, length, type) != 1) {
+			if (imap_parse_nstring(&result, start, length, type) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_NSTRING, result)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(array, IMAP_ARGUMENT_TYPE_NSTRING, result);
 		}
 	}
 
 	// Parser error.
-	if (**start != type) {
+	if (**start != type || !imap_parse_list_build(&list, array)) {
+		imap_parse_list_free(&list);
 		return -1;
 	}
 
@@ -699,6 +844,7 @@ int_t imap_parse_array(int_t recursion, connection_t *con, imap_arguments_t **ar
  * 			( or [ : Parse argument as array with imap_parse_astring().
  * 			other  : Defaults to parsing argument as atomic string with imap_parse_atomic().
  * 			The supplied start and length pointers will be updated to reflect the input stream if the quoted string is parsed successfully.
+ * 			The arguments are only stored in the connection once the whole line has been parsed, in an array allocated at its final size.
 
  * @param	start	the address of a pointer to the start of the buffer to be parsed, that will be continually updated
  * 					to point to the next argument in the sequence during the parsing loop.
@@ -710,53 +856,55 @@ int_t imap_parse_arguments(connection_t *con, chr_t **start, size_t *length) {
 
 	stringer_t *result = NULL;
 	imap_arguments_t *array = NULL;
+	imap_parse_list_t list;
+
+	imap_parse_list_init(&list);
 
 	while (*length && **start >= '!' && **start <= '~') {
 		// Quoted strings.
 		if (**start == '"') {
 
-			if (imap_parse_qstring(&result, start, length) != 1) {
+			if (imap_parse_qstring(&result, start, length) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_QSTRING, result)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(&(con->imap.arguments), IMAP_ARGUMENT_TYPE_QSTRING, result);
 		}
 		// Literal strings.
 		else if (**start == '{') {
 
-			if (imap_parse_literal(con, &result, start, length) != 1) {
+			if (imap_parse_literal(con, &result, start, length) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_LITERAL, result)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(&(con->imap.arguments), IMAP_ARGUMENT_TYPE_LITERAL, result);
 		}
 		// Parenthetical/blocked arrays.
 		else if (**start == '(' || **start == '[') {
 
-			if (imap_parse_array(0, con, &array, start, length) != 1) {
-
-				if (array != NULL) {
-					ar_free(array);
-				}
-
+			if (imap_parse_array(0, con, &array, start, length) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_ARRAY, array)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(&(con->imap.arguments), IMAP_ARGUMENT_TYPE_ARRAY, array);
 			array = NULL;
 		}
 		// Atomic strings.
 		else if (**start >= '!' && **start <= '~') {
 
-			if (imap_parse_astring(&result, start, length) != 1) {
+			if (imap_parse_astring(&result, start, length) != 1 || !imap_parse_list_push(&list, IMAP_ARGUMENT_TYPE_ASTRING, result)) {
+				imap_parse_list_free(&list);
 				return -1;
 			}
 
-			ar_append(&(con->imap.arguments), IMAP_ARGUMENT_TYPE_ASTRING, result);
 		}
 
 	}
 
+	if (!imap_parse_list_build(&list, &(con->imap.arguments))) {
+		return -1;
+	}
+
 	return 1;
 }
 
@@ -0,0 +1,318 @@
+
+/**
+ * @file /magma/servers/imap/prefetch.c
+ *
+ * @brief	Functions used to load messages ahead of a FETCH command, so the disk and the network are kept busy at the same time.
+ * @note	The messages are loaded by the worker threads, and handed to the FETCH command using the thread local message cache. A message
+ * 			which hasn't been picked up by a worker by the time it's needed is simply loaded by the FETCH command itself, so a busy server
+ * 			never waits on the queue.
+ */
+
+#include "magma.h"
+
+/**
+ * @brief	Free a prefetch context.
+ * @param	prefetch	a pointer to the prefetch context to be freed.
+ * @return	This function returns no value.
+ */
+static void imap_prefetch_free(imap_prefetch_t *prefetch) {
+
+	if (prefetch) {
+		if (prefetch->cursor) inx_cursor_free(prefetch->cursor);
+		mutex_destroy(&(prefetch->lock));
+		mm_free(prefetch);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Release a reference to a prefetch job, and free the job once it's no longer referenced.
+ * @note	The caller must hold the prefetch context lock.
+ * @param	job		a pointer to the prefetch job being released.
+ * @return	true if the prefetch context is no longer referenced, and should be freed by the caller, otherwise false.
+ */
+static bool_t imap_prefetch_release(imap_prefetch_job_t *job) {
+
+	imap_prefetch_t *prefetch = (imap_prefetch_t *)job->prefetch;
+
+	if (--job->refs) {
+		return false;
+	}
+
+	st_cleanup(job->text);
+	mm_free(job);
+
+	return !--prefetch->refs;
+}
+
+/**
+ * @brief	Load a message on behalf of a FETCH command. This function is executed by the worker threads.
+ * @note	The loaded message is kept out of the worker's own message cache, since it's only useful to the FETCH command.
+ * @param	job		a pointer to the prefetch job describing the message to be loaded.
+ * @return	This function returns no value.
+ */
+void imap_prefetch_load(imap_prefetch_job_t *job) {
+
+	bool_t running, unreferenced;
+	stringer_t *text = NULL;
+	mail_message_t *message;
+	imap_prefetch_t *prefetch = (imap_prefetch_t *)job->prefetch;
+
+	mutex_lock(&(prefetch->lock));
+	if ((running = (job->state == IMAP_PREFETCH_QUEUED && status()))) {
+		job->state = IMAP_PREFETCH_RUNNING;
+	}
+	mutex_unlock(&(prefetch->lock));
+
+	if (running) {
+
+		if ((message = mail_load_message(job->meta, prefetch->user, prefetch->server, true))) {
+			text = message->text;
+			message->text = NULL;
+			mail_destroy(message);
+		}
+
+		mail_cache_reset();
+	}
+
+	mutex_lock(&(prefetch->lock));
+
+	if (running) {
+		job->text = text;
+		job->state = IMAP_PREFETCH_COMPLETE;
+	}
+
+	unreferenced = imap_prefetch_release(job);
+	mutex_unlock(&(prefetch->lock));
+
+	if (unreferenced) {
+		imap_prefetch_free(prefetch);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Schedule the loading of messages until the prefetch window, or the memory limit, has been reached.
+ * @note	A message which is too large to fit alongside those already scheduled is left for the FETCH command to load itself, unless
+ * 			nothing else is scheduled, in which case it's loaded ahead like any other message.
+ * @param	prefetch	a pointer to the prefetch context.
+ * @return	This function returns no value.
+ */
+static void imap_prefetch_fill(imap_prefetch_t *prefetch) {
+
+	meta_message_t *active;
+	imap_prefetch_job_t *job;
+
+	while (prefetch->cursor && prefetch->count < IMAP_PREFETCH_DEPTH) {
+
+		if (!(active = inx_cursor_value_next(prefetch->cursor))) {
+			inx_cursor_free(prefetch->cursor);
+			prefetch->cursor = NULL;
+			return;
+		}
+
+		// The same filter is applied by the FETCH command, so the jobs line up with the messages it outputs.
+		else if (prefetch->changedsince && active->modseq <= prefetch->changedsince) {
+			continue;
+		}
+
+		// Without a job the message is skipped over, and the FETCH command loads it itself.
+		if (!(job = mm_alloc(sizeof(imap_prefetch_job_t)))) {
+			log_pedantic("Unable to allocate a message prefetch job.");
+			prefetch->ordinal++;
+			continue;
+		}
+
+		job->meta = active;
+		job->ordinal = prefetch->ordinal++;
+		job->prefetch = (struct imap_prefetch_t *)prefetch;
+
+		// A message which doesn't fit is given a cancelled job, which holds its place in the window until the memory is released.
+		job->state = prefetch->count && prefetch->reserved + active->size > IMAP_PREFETCH_MEMORY_LIMIT ? IMAP_PREFETCH_CANCELLED : IMAP_PREFETCH_QUEUED;
+		job->reserved = job->state == IMAP_PREFETCH_QUEUED ? active->size : 0;
+		job->refs = job->state == IMAP_PREFETCH_QUEUED ? 2 : 1;
+
+		mutex_lock(&(prefetch->lock));
+		prefetch->refs++;
+		mutex_unlock(&(prefetch->lock));
+
+		prefetch->jobs[(prefetch->head + prefetch->count++) % IMAP_PREFETCH_DEPTH] = job;
+		prefetch->reserved += job->reserved;
+
+		if (job->state == IMAP_PREFETCH_QUEUED) {
+			enqueue(&imap_prefetch_load, job);
+		}
+		else {
+			return;
+		}
+	}
+
+	return;
+}
+
+/**
+ * @brief	Remove the job at the front of the prefetch window.
+ * @param	prefetch	a pointer to the prefetch context.
+ * @return	the job which was removed.
+ */
+static imap_prefetch_job_t * imap_prefetch_pop(imap_prefetch_t *prefetch) {
+
+	imap_prefetch_job_t *job = prefetch->jobs[prefetch->head];
+
+	prefetch->head = (prefetch->head + 1) % IMAP_PREFETCH_DEPTH;
+	prefetch->reserved -= job->reserved;
+	prefetch->count--;
+
+	return job;
+}
+
+/**
+ * @brief	Collect the result of a prefetch job, and release it.
+ * @note	A job which hasn't been started is cancelled, while a job which is running is waited on, since it relies on the snapshot and
+ * 			user objects held by the FETCH command.
+ * @param	prefetch	a pointer to the prefetch context.
+ * @param	job			a pointer to the job being collected.
+ * @param	seed		if true, and the message was loaded, it's placed in the message cache of the calling thread.
+ * @return	This function returns no value.
+ */
+static void imap_prefetch_collect(imap_prefetch_t *prefetch, imap_prefetch_job_t *job, bool_t seed) {
+
+	mutex_lock(&(prefetch->lock));
+
+	if (job->state == IMAP_PREFETCH_QUEUED) {
+		job->state = IMAP_PREFETCH_CANCELLED;
+	}
+
+	while (job->state == IMAP_PREFETCH_RUNNING) {
+		mutex_unlock(&(prefetch->lock));
+		usleep(1000);
+		mutex_lock(&(prefetch->lock));
+	}
+
+	if (seed && job->state == IMAP_PREFETCH_COMPLETE && job->text) {
+		mail_cache_set(job->meta->messagenum, job->text);
+		stats_increment_by_name("imap.fetch.prefetched");
+	}
+
+	// The FETCH command holds its own reference, so the context can't become unreferenced here.
+	imap_prefetch_release(job);
+	mutex_unlock(&(prefetch->lock));
+
+	return;
+}
+
+/**
+ * @brief	Start loading the messages of a FETCH command ahead of their output.
+ * @note	Messages are only loaded ahead when the requested data items require the message itself, and more than one message is being fetched.
+ * @param	con			the connection of the client issuing the FETCH command.
+ * @param	messages	an inx holder with the messages being fetched, which must remain valid until imap_prefetch_finish() is called.
+ * @param	items		a pointer to the parsed data items requested by the FETCH command.
+ * @return	NULL if the messages won't be loaded ahead, or a pointer to the prefetch context.
+ */
+imap_prefetch_t * imap_prefetch_start(connection_t *con, inx_t *messages, imap_fetch_dataitems_t *items) {
+
+	imap_prefetch_t *prefetch;
+
+	if (!con || !messages || !items || inx_count(messages) < 2 || (!items->rfc822 && !items->rfc822_text && !items->rfc822_header &&
+		!items->envelope && !items->normal && !items->peek)) {
+		return NULL;
+	}
+	else if (!(prefetch = mm_alloc(sizeof(imap_prefetch_t)))) {
+		log_pedantic("Unable to allocate the message prefetch context.");
+		return NULL;
+	}
+	else if (mutex_init(&(prefetch->lock), NULL)) {
+		log_pedantic("Unable to initialize the message prefetch lock.");
+		mm_free(prefetch);
+		return NULL;
+	}
+	else if (!(prefetch->cursor = inx_cursor_alloc(messages))) {
+		imap_prefetch_free(prefetch);
+		return NULL;
+	}
+
+	prefetch->refs = 1;
+	prefetch->user = con->imap.user;
+	prefetch->server = con->server;
+	prefetch->changedsince = items->changedsince;
+
+	imap_prefetch_fill(prefetch);
+
+	return prefetch;
+}
+
+/**
+ * @brief	Hand the next message of a FETCH command to the calling thread, and schedule the loading of another.
+ * @note	This function must be called once for each message, in order, immediately before it's fetched. When the message has been
+ * 			loaded ahead, it's placed in the thread local message cache, where it will be found by mail_load_message().
+ * @param	prefetch	a pointer to the prefetch context, which may be NULL.
+ * @param	active		a pointer to the message about to be fetched.
+ * @return	This function returns no value.
+ */
+void imap_prefetch_next(imap_prefetch_t *prefetch, meta_message_t *active) {
+
+	imap_prefetch_job_t *job = NULL;
+	uint64_t ordinal;
+
+	if (!prefetch || !active) {
+		return;
+	}
+
+	ordinal = prefetch->consumed++;
+
+	// Discard any jobs scheduled for messages the command didn't output.
+	while (prefetch->count && prefetch->jobs[prefetch->head]->ordinal < ordinal) {
+		imap_prefetch_collect(prefetch, imap_prefetch_pop(prefetch), false);
+	}
+
+	if (prefetch->count && prefetch->jobs[prefetch->head]->ordinal == ordinal) {
+		job = imap_prefetch_pop(prefetch);
+	}
+
+	// Refill the window before waiting, so the workers stay busy while this message is written.
+	imap_prefetch_fill(prefetch);
+
+	if (job) {
+		imap_prefetch_collect(prefetch, job, job->meta == active);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Stop loading messages ahead of a FETCH command, and release the prefetch context.
+ * @note	Jobs which haven't been started are cancelled, and any job which is still running is waited on, so the messages passed to
+ * 			imap_prefetch_start() may be freed as soon as this function returns.
+ * @param	prefetch	a pointer to the prefetch context, which may be NULL.
+ * @return	This function returns no value.
+ */
+void imap_prefetch_finish(imap_prefetch_t *prefetch) {
+
+	bool_t unreferenced;
+
+	if (!prefetch) {
+		return;
+	}
+
+	if (prefetch->cursor) {
+		inx_cursor_free(prefetch->cursor);
+		prefetch->cursor = NULL;
+	}
+
+	while (prefetch->count) {
+		imap_prefetch_collect(prefetch, imap_prefetch_pop(prefetch), false);
+	}
+
+	// Cancelled jobs which are still sitting in the queue hold a reference, in which case the last of them frees the context.
+	mutex_lock(&(prefetch->lock));
+	unreferenced = !--prefetch->refs;
+	mutex_unlock(&(prefetch->lock));
+
+	if (unreferenced) {
+		imap_prefetch_free(prefetch);
+	}
+
+	return;
+}
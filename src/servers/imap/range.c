@@ -66,3 +66,127 @@ stringer_t * imap_range_build(size_t length, uint64_t *numbers) {
 
 	return result;
 }
+
+static int imap_range_compare(const void *one, const void *two) {
+	return *((const uint64_t *)one) < *((const uint64_t *)two) ? -1 : *((const uint64_t *)one) > *((const uint64_t *)two) ? 1 : 0;
+}
+
+/**
+ * @brief	Build the UID set used by a VANISHED response, which contains every UID in a range that isn't present in the folder.
+ * @note	Expunged messages aren't tracked, so the gaps in the folder's UIDs are reported instead. This is a superset of the messages
+ * 			which were actually expunged, which RFC 7162 permits, since clients ignore UIDs they don't know about.
+ * @param	messages	an inx holder containing the user's messages.
+ * @param	foldernum	the numerical id of the folder being checked.
+ * @param	first		the lowest UID to consider.
+ * @param	last		the highest UID to consider.
+ * @return	NULL if no UIDs are missing, or a managed string holding the missing UIDs in IMAP sequence set form.
+ */
+stringer_t * imap_range_vanished(inx_t *messages, uint64_t foldernum, uint64_t first, uint64_t last) {
+
+	chr_t buffer[128];
+	inx_cursor_t *cursor;
+	meta_message_t *active;
+	size_t count = 0, total;
+	uint64_t *numbers, current, next = first;
+	stringer_t *result = NULL;
+
+	if (!messages || !first || first > last || !(total = inx_count(messages)) || !(cursor = inx_cursor_alloc(messages))) {
+		return NULL;
+	}
+	else if (!(numbers = mm_alloc(total * sizeof(uint64_t)))) {
+		inx_cursor_free(cursor);
+		return NULL;
+	}
+
+	while (count < total && (active = inx_cursor_value_next(cursor))) {
+		if (active->foldernum == foldernum && active->messagenum >= first && active->messagenum <= last) {
+			numbers[count++] = active->messagenum;
+		}
+	}
+
+	inx_cursor_free(cursor);
+	qsort(numbers, count, sizeof(uint64_t), &imap_range_compare);
+
+	// Every UID can split off at most one span, and each span needs at most two 20 digit numbers, a colon and a comma, so the buffer is sized once.
+	if (!(result = st_alloc_opts(MANAGED_T | HEAP | JOINTED, (count + 1) * 42))) {
+		mm_free(numbers);
+		return NULL;
+	}
+
+	// Walk the sorted UIDs, and output the span between each one and the UID before it. A final sentinel covers the span after the last UID.
+	for (size_t i = 0; i <= count; i++) {
+
+		current = i < count ? numbers[i] : last + 1;
+
+		if (current > next) {
+
+			if (current - 1 == next) {
+				snprintf(buffer, 128, "%s%lu", st_empty(result) ? "" : ",", next);
+			}
+			else {
+				snprintf(buffer, 128, "%s%lu:%lu", st_empty(result) ? "" : ",", next, current - 1);
+			}
+
+			st_append(result, NULLER(buffer));
+		}
+
+		next = current + 1;
+	}
+
+	if (st_empty(result)) {
+		st_free(result);
+		result = NULL;
+	}
+
+	mm_free(numbers);
+
+	return result;
+}
+
+/**
+ * @brief	Find the lowest and highest numbers referenced by an IMAP sequence set.
+ * @param	range	the sequence set being examined.
+ * @param	star	the value substituted for the asterisk, which represents the largest number in use.
+ * @param	first	a pointer to receive the lowest number in the set.
+ * @param	last	a pointer to receive the highest number in the set.
+ * @return	true if the sequence set was valid, or false if it couldn't be parsed.
+ */
+bool_t imap_range_bounds(stringer_t *range, uint64_t star, uint64_t *first, uint64_t *last) {
+
+	chr_t *stream;
+	size_t length;
+	uint64_t number;
+
+	if (imap_valid_sequence(range) != 1) {
+		return false;
+	}
+
+	stream = st_char_get(range);
+	length = st_length_get(range);
+	*first = UINT64_MAX;
+	*last = 0;
+
+	while (length) {
+
+		if (*stream == '*') {
+			number = star;
+			stream++;
+			length--;
+		}
+		else if (*stream >= '0' && *stream <= '9') {
+			for (number = 0; length && *stream >= '0' && *stream <= '9'; stream++, length--) {
+				number = (number * 10) + (*stream - '0');
+			}
+		}
+		else {
+			stream++;
+			length--;
+			continue;
+		}
+
+		if (number < *first) *first = number;
+		if (number > *last) *last = number;
+	}
+
+	return *last != 0;
+}
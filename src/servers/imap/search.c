@@ -157,6 +157,113 @@ int_t imap_search_messages_date(connection_t *con, meta_user_t *user, mail_messa
 	return -1;
 }
 
+/**
+ * @brief	Answer a header, body or text search criterion using the full text index.
+ * @param	con		a pointer to the connection object running the search.
+ * @param	active	a pointer to the meta message being evaluated.
+ * @param	value	a managed string containing the search value, which is used to find the matches prepared for this criterion.
+ * @note	A message missing from the matches can't contain the value, but when the matches are only candidates, a message found in them
+ * 			still has to be scanned, since the words of the value may not appear together, in the same order.
+ * @return	0 if the index can't answer the criterion for this message, 1 if the message matches, or -1 if it doesn't.
+ */
+static int_t imap_search_messages_indexed(connection_t *con, meta_message_t *active, stringer_t *value) {
+
+	mail_matches_t *indexed, *matches;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	// The list of indexed messages is stored using a key of zero, since that can never be the address of a search value.
+	if (!con->imap.search || !(indexed = inx_find(con->imap.search, key)) || !mail_matches_find(indexed, active->messagenum)) {
+		return 0;
+	}
+
+	key.val.u64 = (uint64_t)(uintptr_t)value;
+
+	if (!(matches = inx_find(con->imap.search, key))) {
+		return 0;
+	}
+
+	if (!mail_matches_find(matches, active->messagenum)) {
+		return -1;
+	}
+
+	return matches->candidates ? 0 : 1;
+}
+
+/**
+ * @brief	Query the full text index for every header, body and text criterion in a search, before the messages are evaluated.
+ * @note	The first time a criterion is found, any unindexed messages in the selected folder are indexed, up to IMAP_SEARCH_INDEX_LIMIT,
+ * 			and the list of indexed messages is fetched. Messages outside that list, and criteria the index can't answer, fall back to scanning.
+ * @param	con			a pointer to the connection object running the search.
+ * @param	array		a pointer to the search arguments being examined.
+ * @param	recursion	the current recursion depth, which is limited by IMAP_SEARCH_RECURSION_LIMIT.
+ * @return	This function returns no value.
+ */
+static void imap_search_messages_prepare(connection_t *con, imap_arguments_t *array, unsigned recursion) {
+
+	uint8_t fields;
+	size_t number;
+	stringer_t *item, *value;
+	mail_matches_t *matches;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (!array || recursion >= IMAP_SEARCH_RECURSION_LIMIT) {
+		return;
+	}
+
+	number = ar_length_get(array);
+
+	for (size_t i = 0; i < number; i++) {
+
+		if (imap_get_type_ar(array, i) == IMAP_ARGUMENT_TYPE_ARRAY) {
+			imap_search_messages_prepare(con, imap_get_ar_ar(array, i), recursion + 1);
+			continue;
+		}
+		else if (!(item = imap_get_st_ar(array, i))) {
+			continue;
+		}
+		// The HEADER criterion takes a field name and a value, and neither can be answered using the index.
+		else if (!st_cmp_ci_eq(item, PLACER("HEADER", 6))) {
+			i += 2;
+			continue;
+		}
+		else if (i + 1 >= number || imap_get_type_ar(array, i + 1) == IMAP_ARGUMENT_TYPE_ARRAY) {
+			continue;
+		}
+		else if (!st_cmp_ci_eq(item, PLACER("SUBJECT", 7))) fields = MAIL_TERM_SUBJECT;
+		else if (!st_cmp_ci_eq(item, PLACER("FROM", 4))) fields = MAIL_TERM_FROM;
+		else if (!st_cmp_ci_eq(item, PLACER("TO", 2))) fields = MAIL_TERM_TO;
+		else if (!st_cmp_ci_eq(item, PLACER("CC", 2))) fields = MAIL_TERM_CC;
+		else if (!st_cmp_ci_eq(item, PLACER("BCC", 3))) fields = MAIL_TERM_BCC;
+		else if (!st_cmp_ci_eq(item, PLACER("BODY", 4))) fields = MAIL_TERM_BODY;
+		else if (!st_cmp_ci_eq(item, PLACER("TEXT", 4))) fields = MAIL_TERM_ALL;
+		else continue;
+
+		value = imap_get_st_ar(array, ++i);
+		key.val.u64 = 0;
+
+		if (!inx_find(con->imap.search, key)) {
+
+			mail_terms_backfill(con->imap.user, con->imap.selected, IMAP_SEARCH_INDEX_LIMIT);
+
+			if (!(matches = mail_db_fetch_indexed(con->imap.usernum, con->imap.selected, true))) {
+				return;
+			}
+			else if (!inx_insert(con->imap.search, key, matches)) {
+				mail_matches_free(matches);
+				return;
+			}
+		}
+
+		key.val.u64 = (uint64_t)(uintptr_t)value;
+
+		if (value && (matches = mail_terms_search(con->imap.usernum, con->imap.selected, fields, value)) && !inx_insert(con->imap.search, key, matches)) {
+			mail_matches_free(matches);
+		}
+	}
+
+	return;
+}
+
 // Search the header.
 int_t imap_search_messages_header(connection_t *con, meta_user_t *user, mail_message_t **data, stringer_t **header, meta_message_t *active, stringer_t *field, stringer_t *value) {
 
@@ -165,6 +272,11 @@ int_t imap_search_messages_header(connection_t *con, meta_user_t *user, mail_mes
 	placer_t area = pl_null();
 	stringer_t *current = NULL;
 
+	// Use the full text index, if it can answer this criterion.
+	if ((compare = imap_search_messages_indexed(con, active, value))) {
+		return compare;
+	}
+
 	// Load the message, if necessary.
 	if (*data != NULL) {
 		area = pl_init(st_char_get((*data)->text), (*data)->header_length);
@@ -200,6 +312,11 @@ int_t imap_search_messages_body(connection_t *con, meta_user_t *user, mail_messa
 	int_t compare = -1;
 	stringer_t *current = NULL;
 
+	// Use the full text index, if it can answer this criterion.
+	if ((compare = imap_search_messages_indexed(con, active, value))) {
+		return compare;
+	}
+
 	// Load the message, if necessary.
 	if (*data == NULL && ((*data = mail_load_message(active, user, con->server, true)) == NULL || mail_mime_update(*data) == 0)) {
 		compare = -1;
@@ -224,6 +341,11 @@ int_t imap_search_messages_text(connection_t *con, meta_user_t *user, mail_messa
 	int_t compare = -1;
 	stringer_t *current = NULL;
 
+	// Use the full text index, if it can answer this criterion.
+	if ((compare = imap_search_messages_indexed(con, active, value))) {
+		return compare;
+	}
+
 	// Load the message, if necessary.
 	if (*data == NULL && ((*data = mail_load_message(active, user, con->server, true)) == NULL || mail_mime_update(*data) == 0)) {
 		compare = -1;
@@ -575,6 +697,13 @@ inx_t * imap_search_messages(connection_t *con) {
 		return NULL;
 	}
 
+	// Resolve the header, body and text criteria using the full text index, so matching messages don't have to be loaded.
+	if ((con->imap.search = inx_alloc(M_INX_HASHED, &mail_matches_free))) {
+		meta_user_rlock(con->imap.user);
+		imap_search_messages_prepare(con, con->imap.arguments, 0);
+		meta_user_unlock(con->imap.user);
+	}
+
 	while (status() && !finished) {
 
 		/// LOW: Is a read lock necessary now that were using index reference counters and thread safe iteration cursors?
@@ -655,6 +784,9 @@ inx_t * imap_search_messages(connection_t *con) {
 		inx_cursor_free(cursor);
 	}
 
+	inx_cleanup(con->imap.search);
+	con->imap.search = NULL;
+
 	return output;
 }
 
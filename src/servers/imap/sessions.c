@@ -14,8 +14,7 @@
 int_t imap_session_update(connection_t *con) {
 
 	int_t result = 0;
-	inx_cursor_t *cursor;
-	meta_message_t *active;
+	meta_folder_t *folder;
 	uint64_t recent = 0, exists = 0, checkpoint;
 
 	// Check for the right state.
@@ -56,22 +55,10 @@ int_t imap_session_update(connection_t *con) {
 			meta_messages_update(con->imap.user, META_LOCKED);
 		}
 
-		// If there is a selected folder, scan the status.
-		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
-
-			while ((active = inx_cursor_value_next(cursor))) {
-
-				if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
-					recent++;
-					exists++;
-				}
-				else if (active->foldernum == con->imap.selected) {
-					exists++;
-				}
-
-			}
-
-			inx_cursor_free(cursor);
+		// If there is a selected folder, read its status from the maintained counters.
+		if ((folder = meta_folders_by_number(con->imap.user->folders, con->imap.selected))) {
+			recent = folder->counters.recent;
+			exists = folder->counters.messages;
 		}
 
 		// If the folder has changed, output the current status.
@@ -90,28 +77,195 @@ int_t imap_session_update(connection_t *con) {
 	return result;
 }
 
-void imap_session_destroy(connection_t *con) {
+/**
+ * @brief	Record the messages in the selected folder which the client has been told about.
+ * @note	The known messages are kept in sequence order, which is also UID order, along with the highest modification sequence among
+ * 			them, so imap_session_report() can work out which messages were expunged, or had their flags changed, by another session.
+ * @param	con		the IMAP client connection with the selected folder.
+ * @param	locked	if set to META_NEED_LOCK, the meta user object is read locked for the duration of the call.
+ * @return	This function returns no value.
+ */
+void imap_session_known(connection_t *con, META_LOCK_STATUS locked) {
 
+	size_t count = 0;
+	uint64_t modseq = 0;
 	inx_cursor_t *cursor;
+	meta_folder_t *folder;
 	meta_message_t *active;
 
-	meta_user_wlock(con->imap.user);
+	mm_cleanup(con->imap.known);
+	con->imap.known = NULL;
+	con->imap.known_count = con->imap.known_serial = con->imap.known_modseq = 0;
 
-	// If a folder was selected, clear the recent flag before closing the mailbox.
-	if (con->imap.session_state == 1 && con->imap.user && con->imap.selected && !con->imap.read_only &&
-		(cursor = inx_cursor_alloc(con->imap.user->messages))) {
+	if (con->imap.session_state != 1 || !con->imap.user || !con->imap.selected) {
+		return;
+	}
 
-		while ((active = inx_cursor_value_next(cursor))) {
+	if (locked == META_NEED_LOCK) {
+		meta_user_rlock(con->imap.user);
+	}
 
-			if (active->foldernum == con->imap.selected && (active->status & MAIL_STATUS_RECENT) == MAIL_STATUS_RECENT) {
-				active->status = (active->status | MAIL_STATUS_RECENT) ^ MAIL_STATUS_RECENT;
-			}
+	// The folder counters tell us how many messages to expect, so the list only needs to be allocated once.
+	if ((folder = meta_folders_by_number(con->imap.user->folders, con->imap.selected)) && folder->counters.messages &&
+		(con->imap.known = mm_alloc(folder->counters.messages * sizeof(uint64_t))) && (cursor = inx_cursor_alloc(con->imap.user->messages))) {
 
+		while ((active = inx_cursor_value_next(cursor)) && count < folder->counters.messages) {
+			if (active->foldernum == con->imap.selected) {
+				con->imap.known[count++] = active->messagenum;
+				if (active->modseq > modseq) modseq = active->modseq;
+			}
 		}
 
 		inx_cursor_free(cursor);
 	}
 
+	con->imap.known_count = count;
+	con->imap.known_modseq = modseq;
+	con->imap.known_serial = con->imap.user->serials.messages;
+
+	if (locked == META_NEED_LOCK) {
+		meta_user_unlock(con->imap.user);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Remove messages the session has already reported as expunged from its list of known messages.
+ * @param	con		the IMAP client connection with the selected folder.
+ * @param	uids	the UIDs of the expunged messages, in ascending order.
+ * @param	count	the number of expunged messages.
+ * @return	This function returns no value.
+ */
+void imap_session_known_remove(connection_t *con, uint64_t *uids, size_t count) {
+
+	size_t position = 0, kept = 0;
+
+	for (uint64_t i = 0; i < con->imap.known_count; i++) {
+
+		while (position < count && uids[position] < con->imap.known[i]) {
+			position++;
+		}
+
+		if (position == count || uids[position] != con->imap.known[i]) {
+			con->imap.known[kept++] = con->imap.known[i];
+		}
+	}
+
+	con->imap.known_count = kept;
+	return;
+}
+
+/**
+ * @brief	Determine whether the client has been told about a message.
+ * @param	con		the IMAP client connection with the selected folder.
+ * @param	uid		the UID of the message.
+ * @return	true if the message is in the list of known messages, otherwise false.
+ */
+static bool_t imap_session_known_find(connection_t *con, uint64_t uid) {
+
+	uint64_t low = 0, high = con->imap.known_count, middle;
+
+	while (low < high) {
+		middle = low + ((high - low) / 2);
+		if (con->imap.known[middle] == uid) return true;
+		else if (con->imap.known[middle] < uid) low = middle + 1;
+		else high = middle;
+	}
+
+	return false;
+}
+
+/**
+ * @brief	Send the untagged responses which bring the client up to date with changes made to the selected folder by other sessions.
+ * @note	Messages which were expunged are reported using EXPUNGE, or a single VANISHED response once QRESYNC is enabled, and known
+ * 			messages whose flags changed are reported using FETCH, followed by the EXISTS and RECENT counts. Since expunges may be reported,
+ * 			this function is only used by NOOP, CHECK and IDLE, and must not be called while a FETCH, STORE or SEARCH is running.
+ * @param	con		the IMAP client connection with the selected folder.
+ * @return	This function returns no value.
+ */
+void imap_session_report(connection_t *con) {
+
+	int_t state;
+	size_t vanished = 0;
+	inx_cursor_t *cursor;
+	meta_message_t *active;
+	stringer_t *output = NULL, *range;
+	uint64_t expunged = 0, *uids = NULL;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if ((state = imap_session_update(con)) < 0) {
+		return;
+	}
+
+	meta_user_rlock(con->imap.user);
+
+	// The responses are collected while the lock is held, and written once it's been released.
+	if (con->imap.user->serials.messages != con->imap.known_serial) {
+
+		if (con->imap.qresync == 1 && con->imap.known_count) {
+			uids = mm_alloc(con->imap.known_count * sizeof(uint64_t));
+		}
+
+		// Any known message which has left the folder was expunged, and every expunge shifts the sequence numbers after it down by one.
+		for (uint64_t i = 0; i < con->imap.known_count; i++) {
+
+			key.val.u64 = con->imap.known[i];
+
+			if (!(active = inx_find(con->imap.user->messages, key)) || active->foldernum != con->imap.selected) {
+				if (uids) uids[vanished++] = con->imap.known[i];
+				else output = st_append(output, st_quick(MANAGEDBUF(64), "* %lu EXPUNGE\r\n", i + 1 - expunged));
+				expunged++;
+			}
+		}
+
+		if (uids && vanished && (range = imap_range_build(vanished, uids))) {
+			output = st_append(output, PLACER("* VANISHED ", 11));
+			output = st_append(output, range);
+			output = st_append(output, PLACER("\r\n", 2));
+			st_free(range);
+		}
+
+		mm_cleanup(uids);
+
+		// Known messages with a newer modification sequence had their flags changed.
+		if ((cursor = inx_cursor_alloc(con->imap.user->messages))) {
+			while ((active = inx_cursor_value_next(cursor))) {
+				if (active->foldernum == con->imap.selected && active->modseq > con->imap.known_modseq &&
+					imap_session_known_find(con, active->messagenum)) {
+					output = st_append(output, imap_flags_fetch(MANAGEDBUF(256), active, con->imap.qresync == 1, con->imap.condstore == 1));
+				}
+			}
+			inx_cursor_free(cursor);
+		}
+
+		imap_session_known(con, META_LOCKED);
+	}
+
+	meta_user_unlock(con->imap.user);
+
+	if (output) {
+		con_write_st(con, output);
+		st_free(output);
+	}
+
+	// Expunges lower the message count on their own, so the count is repeated to cover any messages which arrived at the same time.
+	if (state == 1 || expunged) {
+		con_print(con, "* %lu EXISTS\r\n* %lu RECENT\r\n", con->imap.messages_total, con->imap.messages_recent);
+	}
+
+	return;
+}
+
+void imap_session_destroy(connection_t *con) {
+
+	meta_user_wlock(con->imap.user);
+
+	// If a folder was selected, clear the recent flag before closing the mailbox.
+	if (con->imap.session_state == 1 && con->imap.user && con->imap.selected && !con->imap.read_only) {
+		meta_counters_recent_clear(con->imap.user->folders, con->imap.user->messages, con->imap.selected);
+	}
+
 	meta_user_unlock(con->imap.user);
 
 	// Is there a user session.
@@ -132,6 +286,15 @@ void imap_session_destroy(connection_t *con) {
 	st_cleanup(con->imap.command);
 	con->imap.command = NULL;
 
+	// Free any structures left behind by an interrupted fetch.
+	inx_cleanup(con->imap.structures);
+	con->imap.structures = NULL;
+
+	// Free the list of known messages.
+	mm_cleanup(con->imap.known);
+	con->imap.known = NULL;
+	con->imap.known_count = 0;
+
 	// Free the arguments array.
 	if (con->imap.arguments) {
 		ar_free(con->imap.arguments);
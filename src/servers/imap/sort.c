@@ -0,0 +1,1043 @@
+
+/**
+ * @file /magma/servers/imap/sort.c
+ *
+ * @brief	Functions used to handle the IMAP SORT and THREAD commands, as described by RFC 5256.
+ * @note	The sort keys and threading identifiers are read from the stored message envelopes, so the messages themselves are only loaded
+ * 			when an envelope is missing.
+ */
+
+#include "magma.h"
+
+/**
+ * @struct imap_sort_key_t
+ * @brief	The values a single message is sorted and threaded by.
+ */
+typedef struct {
+	meta_message_t *message; /* The search result, which supplies the message number, sequence number, size and arrival time. */
+	time_t date; /* The sent date, or the arrival time if the Date header was missing or invalid. */
+	bool_t reply; /* Set if the subject was marked as a reply or forward, which is only used for threading. */
+	stringer_t *from, *to, *cc, *subject; /* The lower case mailboxes, and the base subject, or NULL if the field was empty. */
+	mail_envelope_t *envelope; /* The envelope holding the message identifiers, which is owned by the envelope index. */
+} imap_sort_key_t;
+
+/**
+ * @struct imap_thread_t
+ * @brief	A node in the thread tree, which holds either a message, or a placeholder for a message which was referenced but isn't present.
+ */
+typedef struct imap_thread_t {
+	imap_sort_key_t *key; /* The message held by the container, or NULL for a placeholder. */
+	struct imap_thread_t *parent, *child, *next;
+} imap_thread_t;
+
+/**
+ * @brief	Parse the sent date of a message.
+ * @note	The parser accepts the RFC 5322 date format, along with the obsolete two digit years and named time zones. Any text
+ * 			following the time zone, like a comment, is ignored.
+ * @param	date	a managed string containing the Date header value.
+ * @return	0 if the date couldn't be parsed, or the date as a UTC timestamp.
+ */
+time_t imap_sort_date(stringer_t *date) {
+
+	struct tm parsed;
+	chr_t buffer[128], month[4], *cursor, *months = "janfebmaraprmayjunjulaugsepoctnovdec";
+	int_t day, year, hour, minute, second = 0, offset = 0, consumed = 0, number;
+	struct { chr_t *name; int_t hours; } zones[] = {
+		{ "ut", 0 }, { "gmt", 0 }, { "utc", 0 }, { "z", 0 }, { "est", -5 }, { "edt", -4 }, { "cst", -6 }, { "cdt", -5 },
+		{ "mst", -7 }, { "mdt", -6 }, { "pst", -8 }, { "pdt", -7 }
+	};
+
+	if (st_empty(date)) {
+		return 0;
+	}
+
+	mm_wipe(buffer, sizeof(buffer));
+	mm_copy(buffer, st_data_get(date), st_length_get(date) < sizeof(buffer) ? st_length_get(date) : sizeof(buffer) - 1);
+
+	// Skip the optional day of the week.
+	cursor = (cursor = strchr(buffer, ',')) ? cursor + 1 : buffer;
+
+	if (sscanf(cursor, " %d %3s %d %d:%d%n", &day, month, &year, &hour, &minute, &consumed) != 5 || !consumed) {
+		return 0;
+	}
+
+	cursor += consumed;
+
+	if (*cursor == ':' && sscanf(cursor + 1, "%d%n", &second, &consumed) == 1) {
+		cursor += consumed + 1;
+	}
+
+	while (*cursor == ' ' || *cursor == '\t') {
+		cursor++;
+	}
+
+	// Numeric zones are written as an offset in hours and minutes, and the named zones are translated using the table above.
+	if ((*cursor == '+' || *cursor == '-') && sscanf(cursor + 1, "%4d", &number) == 1) {
+		offset = (((number / 100) * 60) + (number % 100)) * 60 * (*cursor == '-' ? -1 : 1);
+	}
+	else {
+		for (size_t i = 0; i < sizeof(zones) / sizeof(zones[0]); i++) {
+			if (!strncasecmp(cursor, zones[i].name, ns_length_get(zones[i].name)) && (lower_chr(cursor[ns_length_get(zones[i].name)]) < 'a' || lower_chr(cursor[ns_length_get(zones[i].name)]) > 'z')) {
+				offset = zones[i].hours * 3600;
+				break;
+			}
+		}
+	}
+
+	for (number = 0; number < 12 && strncasecmp(month, months + (number * 3), 3); number++);
+
+	// Two and three digit years are interpreted as described in RFC 5322 section 4.3.
+	if (year < 50) year += 2000;
+	else if (year < 1000) year += 1900;
+
+	if (number == 12 || day < 1 || day > 31 || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+		return 0;
+	}
+
+	mm_wipe(&parsed, sizeof(struct tm));
+	parsed.tm_year = year - 1900;
+	parsed.tm_mon = number;
+	parsed.tm_mday = day;
+	parsed.tm_hour = hour;
+	parsed.tm_min = minute;
+	parsed.tm_sec = second;
+
+	return timegm(&parsed) - offset;
+}
+
+/**
+ * @brief	Measure a subject blob, which is a bracketed tag like a mailing list name, along with any whitespace that follows it.
+ * @param	stream	a pointer to the subject text being examined.
+ * @param	length	the number of bytes remaining in the subject text.
+ * @return	0 if the text doesn't start with a blob, or the length of the blob.
+ */
+static size_t imap_sort_subject_blob(chr_t *stream, size_t length) {
+
+	size_t result = 1;
+
+	if (!length || *stream != '[') {
+		return 0;
+	}
+
+	while (result < length && stream[result] != '[' && stream[result] != ']') {
+		result++;
+	}
+
+	if (result == length || stream[result++] != ']') {
+		return 0;
+	}
+
+	while (result < length && stream[result] == ' ') {
+		result++;
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Measure a subject leader, which is any number of blobs, followed by a reply or forward marker and a colon.
+ * @note	The subject has already been folded to lower case.
+ * @param	stream	a pointer to the subject text being examined.
+ * @param	length	the number of bytes remaining in the subject text.
+ * @return	0 if the text doesn't start with a leader, or the length of the leader.
+ */
+static size_t imap_sort_subject_leader(chr_t *stream, size_t length) {
+
+	size_t result = 0, marker, blob;
+
+	while (result < length) {
+
+		if (length - result >= 3 && !mm_cmp_cs_eq(stream + result, "fwd", 3)) marker = 3;
+		else if (length - result >= 2 && (!mm_cmp_cs_eq(stream + result, "fw", 2) || !mm_cmp_cs_eq(stream + result, "re", 2))) marker = 2;
+		else marker = 0;
+
+		if (marker) {
+
+			blob = result + marker;
+
+			while (blob < length && stream[blob] == ' ') {
+				blob++;
+			}
+
+			blob += imap_sort_subject_blob(stream + blob, length - blob);
+
+			if (blob < length && stream[blob] == ':') {
+				return blob + 1;
+			}
+		}
+
+		// Otherwise a blob may precede the marker, so skip it and try again.
+		if (!(blob = imap_sort_subject_blob(stream + result, length - result))) {
+			return 0;
+		}
+
+		result += blob;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief	Extract the base subject of a message, using the algorithm described in RFC 5256 section 2.1.
+ * @note	The result is folded to lower case, so it can be compared using the i;ascii-casemap collation. Encoded words are compared
+ * 			in their encoded form, rather than being decoded first.
+ * @param	subject		a managed string containing the Subject header value.
+ * @param	reply		if not NULL, receives true if the subject was marked as a reply or forward.
+ * @return	NULL if the base subject is empty, or a managed string containing the base subject.
+ */
+stringer_t * imap_sort_subject(stringer_t *subject, bool_t *reply) {
+
+	chr_t *stream;
+	bool_t changed;
+	stringer_t *result;
+	size_t length, start = 0, end = 0, skip;
+
+	if (reply) {
+		*reply = false;
+	}
+
+	if (st_empty(subject) || !(result = st_alloc(st_length_get(subject)))) {
+		return NULL;
+	}
+
+	// Fold the subject to lower case, and collapse each run of whitespace into a single space.
+	stream = st_char_get(result);
+	length = st_length_get(subject);
+
+	for (size_t i = 0; i < length; i++) {
+
+		chr_t c = *(st_char_get(subject) + i);
+
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			if (end && stream[end - 1] != ' ') stream[end++] = ' ';
+		}
+		else {
+			stream[end++] = lower_chr(c);
+		}
+	}
+
+	do {
+
+		changed = false;
+
+		// Remove any trailing whitespace, and any trailing forward markers.
+		while (end > start) {
+			if (stream[end - 1] == ' ') {
+				end--;
+			}
+			else if (end - start >= 5 && !mm_cmp_cs_eq(stream + end - 5, "(fwd)", 5)) {
+				end -= 5;
+				if (reply) *reply = true;
+			}
+			else {
+				break;
+			}
+		}
+
+		// Remove leading whitespace, leaders and blobs, stopping before a blob which would leave the subject empty.
+		while (start < end) {
+			if (stream[start] == ' ') {
+				start++;
+			}
+			else if ((skip = imap_sort_subject_leader(stream + start, end - start))) {
+				start += skip;
+				if (reply) *reply = true;
+			}
+			else if ((skip = imap_sort_subject_blob(stream + start, end - start)) && skip < end - start) {
+				start += skip;
+			}
+			else {
+				break;
+			}
+		}
+
+		// A subject wrapped as a forward is unwrapped, and the whole process repeated.
+		if (end - start >= 6 && !mm_cmp_cs_eq(stream + start, "[fwd:", 5) && stream[end - 1] == ']') {
+			start += 5;
+			end--;
+			changed = true;
+			if (reply) *reply = true;
+		}
+
+	} while (changed);
+
+	if (start == end) {
+		st_free(result);
+		return NULL;
+	}
+
+	mm_move(stream, stream + start, end - start);
+	st_length_set(result, end - start);
+
+	return result;
+}
+
+/**
+ * @brief	Extract the mailbox of the first address in an address list, which is the part of the address before the @ symbol.
+ * @param	address		a managed string containing the address list.
+ * @return	NULL if the address list is empty, or a managed string containing the mailbox, folded to lower case.
+ */
+static stringer_t * imap_sort_mailbox(stringer_t *address) {
+
+	chr_t *stream;
+	bool_t quoted = false;
+	size_t length, start = 0, end, angle;
+
+	if (st_empty(address)) {
+		return NULL;
+	}
+
+	stream = st_char_get(address);
+	length = st_length_get(address);
+	angle = end = length;
+
+	// Find the end of the first address, and the opening bracket of an address with a display name.
+	for (size_t i = 0; i < length; i++) {
+		if (stream[i] == '"') {
+			quoted = !quoted;
+		}
+		else if (!quoted && stream[i] == ',') {
+			end = i;
+			break;
+		}
+		else if (!quoted && stream[i] == '<' && angle == length) {
+			angle = i;
+		}
+	}
+
+	if (angle < end) {
+		start = angle + 1;
+	}
+
+	for (size_t i = start; i < end; i++) {
+		if (stream[i] == '@' || stream[i] == '>') {
+			end = i;
+			break;
+		}
+	}
+
+	while (start < end && (stream[start] == ' ' || stream[start] == '\t' || stream[start] == '"')) start++;
+	while (end > start && (stream[end - 1] == ' ' || stream[end - 1] == '\t' || stream[end - 1] == '"')) end--;
+
+	return start < end ? lower_st(st_import(stream + start, end - start)) : NULL;
+}
+
+/**
+ * @brief	Compare two sort key strings, with a missing value sorting before any other value.
+ * @param	one		the first string.
+ * @param	two		the second string.
+ * @return	a negative value, zero or a positive value if the first string sorts before, the same as, or after the second string.
+ */
+static int_t imap_sort_compare_st(stringer_t *one, stringer_t *two) {
+
+	int_t result;
+	size_t first = one ? st_length_get(one) : 0, second = two ? st_length_get(two) : 0;
+
+	if ((result = memcmp(first ? st_data_get(one) : (uchr_t *)"", second ? st_data_get(two) : (uchr_t *)"", first < second ? first : second))) {
+		return result;
+	}
+
+	return first < second ? -1 : first > second ? 1 : 0;
+}
+
+/**
+ * @brief	The comparison function used to order messages for the SORT command.
+ * @note	Messages which compare as equal for every criterion are ordered by message number, which matches their sequence order.
+ * @param	one			a pointer to the first sort key.
+ * @param	two			a pointer to the second sort key.
+ * @param	criteria	a pointer to the zero terminated list of sort criteria.
+ * @return	a negative value, zero or a positive value if the first message sorts before, the same as, or after the second message.
+ */
+static int imap_sort_compare(const void *one, const void *two, void *criteria) {
+
+	int_t result = 0;
+	const imap_sort_key_t *first = one, *second = two;
+
+	for (uint8_t *criterion = criteria; *criterion && !result; criterion++) {
+
+		switch (*criterion & ~IMAP_SORT_REVERSE) {
+			case (IMAP_SORT_ARRIVAL):
+				result = first->message->created < second->message->created ? -1 : first->message->created > second->message->created;
+				break;
+			case (IMAP_SORT_CC):
+				result = imap_sort_compare_st(first->cc, second->cc);
+				break;
+			case (IMAP_SORT_DATE):
+				result = first->date < second->date ? -1 : first->date > second->date;
+				break;
+			case (IMAP_SORT_FROM):
+				result = imap_sort_compare_st(first->from, second->from);
+				break;
+			case (IMAP_SORT_SIZE):
+				result = first->message->size < second->message->size ? -1 : first->message->size > second->message->size;
+				break;
+			case (IMAP_SORT_SUBJECT):
+				result = imap_sort_compare_st(first->subject, second->subject);
+				break;
+			case (IMAP_SORT_TO):
+				result = imap_sort_compare_st(first->to, second->to);
+				break;
+		}
+
+		if (*criterion & IMAP_SORT_REVERSE) {
+			result = -result;
+		}
+	}
+
+	if (!result) {
+		result = first->message->messagenum < second->message->messagenum ? -1 : first->message->messagenum > second->message->messagenum;
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Free the sort keys generated for a set of messages.
+ * @param	keys	a pointer to the array of sort keys.
+ * @param	count	the number of keys in the array.
+ * @return	This function returns no value.
+ */
+static void imap_sort_free(imap_sort_key_t *keys, size_t count) {
+
+	if (keys) {
+		for (size_t i = 0; i < count; i++) {
+			st_cleanup(keys[i].from, keys[i].to, keys[i].cc, keys[i].subject);
+		}
+		mm_free(keys);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Generate the sort keys for the messages returned by a search.
+ * @note	The keys are derived from the stored message envelopes. If a message doesn't have an envelope, because it was stored before
+ * 			envelopes existed, the envelope is rebuilt from the message, and stored so the next sort won't need to load the message. Envelopes
+ * 			generated for encrypted messages are only kept in memory, and discarded once the command completes. Envelopes stored before the
+ * 			carbon copy and threading fields existed are completed the same way, when the command needs those fields, but only up to
+ * 			IMAP_SORT_REFRESH_LIMIT per command, so an upgraded mailbox is filled in gradually rather than stalling a single command.
+ * @param	con			the client IMAP connection issuing the command.
+ * @param	messages	the index of messages returned by the search.
+ * @param	threading	if true the command needs the carbon copy and threading fields, so partial envelopes are completed.
+ * @param	envelopes	receives the envelope index which owns the envelopes referenced by the keys, which must be freed by the caller.
+ * @param	count		receives the number of keys generated.
+ * @return	NULL if there were no messages, or if an error occurred, or an array of sort keys which must be freed with imap_sort_free().
+ */
+static imap_sort_key_t * imap_sort_load(connection_t *con, inx_t *messages, bool_t threading, inx_t **envelopes, size_t *count) {
+
+	size_t total, refreshed = 0;
+	inx_cursor_t *cursor;
+	meta_message_t *active;
+	mail_message_t *message;
+	imap_sort_key_t *keys, *key;
+	mail_envelope_t *envelope;
+	multi_t search = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	*count = 0;
+
+	if (!messages || !(total = inx_count(messages))) {
+		*envelopes = NULL;
+		return NULL;
+	}
+	else if (!(keys = mm_alloc(sizeof(imap_sort_key_t) * total))) {
+		log_pedantic("Unable to allocate %zu bytes for the message sort keys.", sizeof(imap_sort_key_t) * total);
+		*envelopes = NULL;
+		return NULL;
+	}
+	else if (!(*envelopes = mail_db_fetch_envelopes(con->imap.usernum, con->imap.selected)) &&
+		!(*envelopes = inx_alloc(M_INX_TREE, &mail_envelope_free))) {
+		log_pedantic("Unable to allocate an index for the message envelopes.");
+		mm_free(keys);
+		return NULL;
+	}
+	else if (!(cursor = inx_cursor_alloc(messages))) {
+		inx_free(*envelopes);
+		*envelopes = NULL;
+		mm_free(keys);
+		return NULL;
+	}
+
+	while ((active = inx_cursor_value_next(cursor)) && *count < total) {
+
+		// Messages removed while the search was running have their sequence number cleared, and are left out of sequence number results.
+		if (!con->imap.uid && !active->sequencenum) {
+			continue;
+		}
+
+		search.val.u64 = active->messagenum;
+
+		if ((!(envelope = inx_find(*envelopes, search)) || (threading && envelope->partial && refreshed++ < IMAP_SORT_REFRESH_LIMIT)) &&
+			(message = mail_load_message(active, con->imap.user, con->server, false))) {
+
+			if ((envelope = mail_envelope_build(message->text))) {
+
+				if (!(active->status & MAIL_STATUS_ENCRYPTED) && !mail_db_insert_envelope(active->messagenum, envelope, -1)) {
+					log_pedantic("Unable to store the message envelope summary. { messagenum = %lu }", active->messagenum);
+				}
+
+				// Any partial envelope for the message is released when it's replaced.
+				if (!inx_replace(*envelopes, search, envelope)) {
+					mail_envelope_free(envelope);
+					envelope = NULL;
+				}
+			}
+			else {
+				envelope = inx_find(*envelopes, search);
+			}
+
+			mail_destroy(message);
+		}
+
+		key = &(keys[(*count)++]);
+		key->message = active;
+		key->envelope = envelope;
+
+		if (envelope) {
+			key->from = imap_sort_mailbox(envelope->from);
+			key->to = imap_sort_mailbox(envelope->to);
+			key->cc = imap_sort_mailbox(envelope->cc);
+			key->subject = imap_sort_subject(envelope->subject, &(key->reply));
+			key->date = imap_sort_date(envelope->date);
+		}
+
+		if (!key->date) {
+			key->date = active->created;
+		}
+	}
+
+	inx_cursor_free(cursor);
+
+	return keys;
+}
+
+/**
+ * @brief	Parse the list of sort criteria supplied with a SORT command.
+ * @param	array		a pointer to the imap arguments array holding the criteria.
+ * @param	criteria	a pointer to a buffer of IMAP_SORT_CRITERIA_MAX + 1 bytes which will receive the zero terminated list of criteria.
+ * @return	-1 if the criteria are invalid, or the number of criteria on success.
+ */
+int_t imap_sort_criteria(imap_arguments_t *array, uint8_t *criteria) {
+
+	size_t number;
+	int_t count = 0;
+	uint8_t reverse = 0;
+	stringer_t *item;
+	struct { chr_t *name; uint8_t value; } keys[] = {
+		{ "ARRIVAL", IMAP_SORT_ARRIVAL }, { "CC", IMAP_SORT_CC }, { "DATE", IMAP_SORT_DATE }, { "FROM", IMAP_SORT_FROM },
+		{ "SIZE", IMAP_SORT_SIZE }, { "SUBJECT", IMAP_SORT_SUBJECT }, { "TO", IMAP_SORT_TO }
+	};
+
+	if (!array || !criteria || !(number = ar_length_get(array)) || number > IMAP_SORT_CRITERIA_MAX) {
+		return -1;
+	}
+
+	mm_wipe(criteria, IMAP_SORT_CRITERIA_MAX + 1);
+
+	for (size_t i = 0; i < number; i++) {
+
+		if (imap_get_type_ar(array, i) == IMAP_ARGUMENT_TYPE_ARRAY || !(item = imap_get_st_ar(array, i))) {
+			return -1;
+		}
+		// The reverse modifier applies to the criterion which follows it, and can't be repeated.
+		else if (!st_cmp_ci_eq(item, PLACER("REVERSE", 7))) {
+			if (reverse) return -1;
+			reverse = IMAP_SORT_REVERSE;
+			continue;
+		}
+
+		for (size_t j = 0; j < sizeof(keys) / sizeof(keys[0]) && !criteria[count]; j++) {
+			if (!st_cmp_ci_eq(item, NULLER(keys[j].name))) {
+				criteria[count] = keys[j].value | reverse;
+			}
+		}
+
+		if (!criteria[count++]) {
+			return -1;
+		}
+
+		reverse = 0;
+	}
+
+	// A trailing reverse modifier, or a list made up of only modifiers, is invalid.
+	return reverse || !count ? -1 : count;
+}
+
+/**
+ * @brief	Sort the messages returned by a search, and generate the untagged SORT response.
+ * @param	con			the client IMAP connection issuing the command.
+ * @param	messages	the index of messages returned by the search, which may be NULL.
+ * @param	criteria	a pointer to the zero terminated list of criteria generated by imap_sort_criteria().
+ * @return	NULL on failure, or a managed string containing the untagged SORT response, which lists UIDs if the command used the UID prefix,
+ * 			or sequence numbers otherwise.
+ */
+stringer_t * imap_sort_messages(connection_t *con, inx_t *messages, uint8_t *criteria) {
+
+	size_t count = 0;
+	bool_t threading = false;
+	inx_t *envelopes = NULL;
+	imap_sort_key_t *keys;
+	stringer_t *output, *buffer = MANAGEDBUF(32);
+
+	if (!(output = st_aprint_opts(MANAGED_T | HEAP | JOINTED, "* SORT"))) {
+		return NULL;
+	}
+
+	// Only the CC criterion needs the fields which are missing from partial envelopes.
+	for (uint8_t *criterion = criteria; *criterion && !threading; criterion++) {
+		threading = (*criterion & ~IMAP_SORT_REVERSE) == IMAP_SORT_CC;
+	}
+
+	if ((keys = imap_sort_load(con, messages, threading, &envelopes, &count))) {
+
+		qsort_r(keys, count, sizeof(imap_sort_key_t), &imap_sort_compare, criteria);
+
+		for (size_t i = 0; i < count && output; i++) {
+			st_sprint(buffer, " %lu", con->imap.uid ? keys[i].message->messagenum : keys[i].message->sequencenum);
+			output = st_append_opts(8192, output, buffer);
+		}
+	}
+
+	output = st_append_opts(1024, output, PLACER("\r\n", 2));
+
+	imap_sort_free(keys, count);
+	inx_cleanup(envelopes);
+
+	return output;
+}
+
+/**
+ * @brief	Add a node to the children of another node.
+ * @param	parent	the node which will become the parent.
+ * @param	child	the node being added, which must not already have a parent.
+ * @return	This function returns no value.
+ */
+static void imap_thread_link(imap_thread_t *parent, imap_thread_t *child) {
+
+	child->parent = parent;
+	child->next = parent->child;
+	parent->child = child;
+
+	return;
+}
+
+/**
+ * @brief	Remove a node from the children of its parent.
+ * @param	node	the node being removed.
+ * @return	This function returns no value.
+ */
+static void imap_thread_unlink(imap_thread_t *node) {
+
+	imap_thread_t **link;
+
+	if (node->parent) {
+
+		for (link = &(node->parent->child); *link && *link != node; link = &((*link)->next));
+
+		if (*link) {
+			*link = node->next;
+		}
+	}
+
+	node->parent = node->next = NULL;
+
+	return;
+}
+
+/**
+ * @brief	Check whether linking a child to a parent would create a loop, which happens if the parent is the child, or is one of its descendants.
+ * @param	parent	the proposed parent.
+ * @param	child	the proposed child.
+ * @return	true if the link would create a loop, or false if the link is safe.
+ */
+static bool_t imap_thread_loop(imap_thread_t *parent, imap_thread_t *child) {
+
+	for (imap_thread_t *node = parent; node; node = node->parent) {
+		if (node == child) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief	Find the message used to represent a node when it's sorted, or grouped by subject, which is the first message found by
+ * 			following the first child of each placeholder.
+ * @param	node	the thread node.
+ * @return	NULL if no message was found, or a pointer to the message sort key.
+ */
+static imap_sort_key_t * imap_thread_first(imap_thread_t *node) {
+
+	while (node && !node->key) {
+		node = node->child;
+	}
+
+	return node ? node->key : NULL;
+}
+
+/**
+ * @brief	The comparison function used to order sibling nodes, which are sorted by sent date, and then by message number.
+ * @param	one		a pointer to the first node pointer.
+ * @param	two		a pointer to the second node pointer.
+ * @return	a negative value, zero or a positive value if the first node sorts before, the same as, or after the second node.
+ */
+static int imap_thread_compare(const void *one, const void *two) {
+
+	imap_sort_key_t *first = imap_thread_first(*(imap_thread_t **)one), *second = imap_thread_first(*(imap_thread_t **)two);
+
+	if (!first || !second) {
+		return first ? 1 : second ? -1 : 0;
+	}
+	else if (first->date != second->date) {
+		return first->date < second->date ? -1 : 1;
+	}
+
+	return first->message->messagenum < second->message->messagenum ? -1 : first->message->messagenum > second->message->messagenum;
+}
+
+/**
+ * @brief	Remove the placeholders which aren't needed to hold a thread together, as described by step 4 of the REFERENCES algorithm.
+ * @note	Placeholders without children are discarded, and placeholders with children are replaced by their children, unless they sit
+ * 			at the top level and have more than one child.
+ * @param	parent	the node whose children are being pruned.
+ * @param	root	the top level node.
+ * @return	This function returns no value.
+ */
+static void imap_thread_prune(imap_thread_t *parent, imap_thread_t *root) {
+
+	imap_thread_t **link = &(parent->child), *node, *last;
+
+	while ((node = *link)) {
+
+		imap_thread_prune(node, root);
+
+		if (!node->key && !node->child) {
+			*link = node->next;
+			continue;
+		}
+		else if (!node->key && (parent != root || !node->child->next)) {
+
+			for (last = node->child; last; last = last->next) {
+				last->parent = parent;
+				if (!last->next) break;
+			}
+
+			last->next = node->next;
+			*link = node->child;
+			link = &(last->next);
+			continue;
+		}
+
+		link = &(node->next);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Merge the top level threads which share a base subject, as described by step 5 of the REFERENCES algorithm.
+ * @param	root		the top level node.
+ * @param	pool		a pointer to the node pool, which supplies the new placeholders.
+ * @param	used		a pointer to the number of nodes used from the pool.
+ * @return	This function returns no value.
+ */
+static void imap_thread_group(imap_thread_t *root, imap_thread_t *pool, size_t *used) {
+
+	inx_t *subjects;
+	size_t count = 0;
+	imap_sort_key_t *key;
+	imap_thread_t **roots, *node, *existing, *child, *placeholder;
+	multi_t search = { .type = M_TYPE_STRINGER, .val.st = NULL };
+
+	for (node = root->child; node; node = node->next) {
+		count++;
+	}
+
+	if (count < 2 || !(roots = mm_alloc(sizeof(imap_thread_t *) * count))) {
+		return;
+	}
+	else if (!(subjects = inx_alloc(M_INX_HASHED, NULL))) {
+		mm_free(roots);
+		return;
+	}
+
+	count = 0;
+
+	// Record the preferred thread for each subject, which is a placeholder if there is one, or a message which isn't a reply.
+	for (node = root->child; node; node = node->next) {
+
+		roots[count++] = node;
+
+		if (!(key = imap_thread_first(node)) || !(search.val.st = key->subject)) {
+			continue;
+		}
+		else if (!(existing = inx_find(subjects, search))) {
+			inx_insert(subjects, search, node);
+		}
+		else if ((!node->key && existing->key) || (existing->key && node->key && existing->key->reply && !node->key->reply)) {
+			inx_replace(subjects, search, node);
+		}
+	}
+
+	// Then merge the remaining threads into the preferred thread for their subject.
+	for (size_t i = 0; i < count; i++) {
+
+		node = roots[i];
+
+		if (!(key = imap_thread_first(node)) || !(search.val.st = key->subject) || !(existing = inx_find(subjects, search)) || existing == node) {
+			continue;
+		}
+
+		imap_thread_unlink(node);
+
+		if (!existing->key && !node->key) {
+			while ((child = node->child)) {
+				imap_thread_unlink(child);
+				imap_thread_link(existing, child);
+			}
+		}
+		else if (!existing->key || (node->key && !existing->key->reply && node->key->reply)) {
+			imap_thread_link(existing, node);
+		}
+		else if (node->key && existing->key->reply && !node->key->reply) {
+			imap_thread_unlink(existing);
+			imap_thread_link(node, existing);
+			imap_thread_link(root, node);
+			inx_replace(subjects, search, node);
+		}
+		else {
+			placeholder = &(pool[(*used)++]);
+			imap_thread_unlink(existing);
+			imap_thread_link(placeholder, existing);
+			imap_thread_link(placeholder, node);
+			imap_thread_link(root, placeholder);
+			inx_replace(subjects, search, placeholder);
+		}
+	}
+
+	inx_free(subjects);
+	mm_free(roots);
+
+	return;
+}
+
+/**
+ * @brief	Sort the children of a node, and their descendants, by sent date.
+ * @param	node	the node whose children are being sorted.
+ * @return	This function returns no value.
+ */
+static void imap_thread_sort(imap_thread_t *node) {
+
+	size_t count = 0;
+	imap_thread_t *child, **children;
+
+	for (child = node->child; child; child = child->next) {
+		imap_thread_sort(child);
+		count++;
+	}
+
+	if (count < 2 || !(children = mm_alloc(sizeof(imap_thread_t *) * count))) {
+		return;
+	}
+
+	count = 0;
+
+	for (child = node->child; child; child = child->next) {
+		children[count++] = child;
+	}
+
+	qsort(children, count, sizeof(imap_thread_t *), &imap_thread_compare);
+
+	node->child = children[0];
+
+	for (size_t i = 0; i < count; i++) {
+		children[i]->next = i + 1 < count ? children[i + 1] : NULL;
+	}
+
+	mm_free(children);
+
+	return;
+}
+
+/**
+ * @brief	Write a thread to the THREAD response.
+ * @note	A chain of single replies is written as a flat list of numbers, and each branch is written as a nested, parenthesized list.
+ * @param	output	the address of the managed string holding the response.
+ * @param	node	the first node of the thread.
+ * @param	uid		if true, UIDs are written, and otherwise sequence numbers are.
+ * @return	This function returns no value.
+ */
+static void imap_thread_print(stringer_t **output, imap_thread_t *node, bool_t uid) {
+
+	bool_t space = false;
+	stringer_t *buffer = MANAGEDBUF(32);
+
+	*output = st_append_opts(1024, *output, PLACER("(", 1));
+
+	while (node && *output) {
+
+		if (node->key) {
+			st_sprint(buffer, space ? " %lu" : "%lu", uid ? node->key->message->messagenum : node->key->message->sequencenum);
+			*output = st_append_opts(8192, *output, buffer);
+			space = true;
+		}
+
+		if (node->child && !node->child->next) {
+			node = node->child;
+			continue;
+		}
+
+		if (node->child && space) {
+			*output = st_append_opts(1024, *output, PLACER(" ", 1));
+		}
+
+		for (imap_thread_t *child = node->child; child && *output; child = child->next) {
+			imap_thread_print(output, child, uid);
+		}
+
+		break;
+	}
+
+	if (*output) {
+		*output = st_append_opts(1024, *output, PLACER(")", 1));
+	}
+
+	return;
+}
+
+/**
+ * @brief	Thread the messages returned by a search using the REFERENCES algorithm described in RFC 5256, and generate the untagged THREAD response.
+ * @param	con			the client IMAP connection issuing the command.
+ * @param	messages	the index of messages returned by the search, which may be NULL.
+ * @return	NULL on failure, or a managed string containing the untagged THREAD response, which lists UIDs if the command used the UID prefix,
+ * 			or sequence numbers otherwise.
+ */
+stringer_t * imap_thread_messages(connection_t *con, inx_t *messages) {
+
+	placer_t token;
+	imap_sort_key_t *keys;
+	inx_t *envelopes = NULL, *identifiers = NULL;
+	size_t count = 0, total, used = 0, references;
+	imap_thread_t root, *pool = NULL, *node, *previous, *found;
+	multi_t search = { .type = M_TYPE_STRINGER, .val.st = NULL };
+	stringer_t *output;
+
+	if (!(output = st_aprint_opts(MANAGED_T | HEAP | JOINTED, "* THREAD"))) {
+		return NULL;
+	}
+
+	mm_wipe(&root, sizeof(imap_thread_t));
+
+	if (!(keys = imap_sort_load(con, messages, true, &envelopes, &count))) {
+		inx_cleanup(envelopes);
+		return st_append_opts(1024, output, PLACER("\r\n", 2));
+	}
+
+	// Each message needs a node, along with one for each reference, and one for each placeholder created while merging subjects.
+	total = count * 2;
+
+	for (size_t i = 0; i < count; i++) {
+		if (keys[i].envelope && !st_empty(keys[i].envelope->references)) {
+			total += tok_get_count_st(keys[i].envelope->references, ' ');
+		}
+	}
+
+	if (!(pool = mm_alloc(sizeof(imap_thread_t) * total)) || !(identifiers = inx_alloc(M_INX_HASHED, NULL))) {
+		log_pedantic("Unable to allocate the message thread nodes.");
+		if (pool) mm_free(pool);
+		imap_sort_free(keys, count);
+		inx_cleanup(envelopes);
+		st_free(output);
+		return NULL;
+	}
+
+	// Link each message to the messages it references, creating placeholders for the messages which aren't present.
+	for (size_t i = 0; i < count; i++) {
+
+		node = NULL;
+
+		if (keys[i].envelope && (search.val.st = keys[i].envelope->message_id)) {
+
+			// A message which reuses the identifier of another message is treated as though it didn't have one.
+			if ((found = inx_find(identifiers, search)) && !found->key) {
+				node = found;
+			}
+			else if (!found && (node = &(pool[used++])) && !inx_insert(identifiers, search, node)) {
+				log_pedantic("Unable to index the message identifier. { messagenum = %lu }", keys[i].message->messagenum);
+			}
+		}
+
+		if (!node) {
+			node = &(pool[used++]);
+		}
+
+		node->key = &(keys[i]);
+		previous = NULL;
+
+		if (keys[i].envelope && !st_empty(keys[i].envelope->references)) {
+
+			references = tok_get_count_st(keys[i].envelope->references, ' ');
+
+			for (size_t j = 0; j < references; j++) {
+
+				if (tok_get_st(keys[i].envelope->references, ' ', j, &token) < 0 || pl_empty(token)) {
+					continue;
+				}
+
+				search.val.st = &token;
+
+				if (!(found = inx_find(identifiers, search))) {
+					found = &(pool[used++]);
+					inx_insert(identifiers, search, found);
+				}
+
+				// Existing links are left alone, and links which would create a loop are skipped.
+				if (previous && !found->parent && !imap_thread_loop(previous, found)) {
+					imap_thread_link(previous, found);
+				}
+
+				previous = found;
+			}
+		}
+
+		// The message always becomes a child of its final reference, replacing whatever parent was presumed from the references of
+		// another message, and a message without references loses any presumed parent.
+		if (!previous || previous != node->parent) {
+
+			if (node->parent) {
+				imap_thread_unlink(node);
+			}
+
+			if (previous && !imap_thread_loop(previous, node)) {
+				imap_thread_link(previous, node);
+			}
+		}
+	}
+
+	inx_free(identifiers);
+
+	// The nodes without a parent form the top level of the tree.
+	for (size_t i = 0; i < used; i++) {
+		if (!pool[i].parent) {
+			imap_thread_link(&root, &(pool[i]));
+		}
+	}
+
+	imap_thread_prune(&root, &root);
+	imap_thread_group(&root, pool, &used);
+	imap_thread_sort(&root);
+
+	output = st_append_opts(1024, output, PLACER(" ", 1));
+
+	for (node = root.child; node && output; node = node->next) {
+		imap_thread_print(&output, node, con->imap.uid);
+	}
+
+	output = st_append_opts(1024, output, PLACER("\r\n", 2));
+
+	mm_free(pool);
+	imap_sort_free(keys, count);
+	inx_cleanup(envelopes);
+
+	return output;
+}
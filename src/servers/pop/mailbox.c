@@ -9,60 +9,34 @@
 
 /**
  * @brief	Get the number of messages available to a POP3 user.
- * @note	This function only counts messages that aren't deleted or hidden, and weren't created by the IMAP APPEND command.
- * @param	messages	an inx holder containing a collection of messages to be analyzed.
+ * @note	This function only counts messages that aren't deleted or hidden, and weren't created by the IMAP APPEND command. The
+ * 			total is summed from the counters maintained on each folder, rather than by scanning the messages.
+ * @param	folders		an inx holder containing the user's folders.
  * @return	the total number of messages available to the POP3 user, or 0 on failure.
  */
-uint64_t pop_total_messages(inx_t *messages) {
-
-	uint64_t result = 0;
-	inx_cursor_t *cursor;
-	meta_message_t *active;
-
-	if (!messages || !(cursor = inx_cursor_alloc(messages))) {
-		return 0;
-	}
-
-	while ((active = inx_cursor_value_next(cursor))) {
-
-		if (!(active->status & (MAIL_STATUS_APPENDED | MAIL_STATUS_HIDDEN))) {
-			result++;
-		}
+uint64_t pop_total_messages(inx_t *folders) {
 
-	}
+	meta_counters_t totals;
 
-	inx_cursor_free(cursor);
+	meta_counters_total(folders, &totals);
 
-	return result;
+	return totals.visible;
 }
 
 /**
  * @brief	Get the total size of all messages available to a POP3 user.
- * @note	This function only counts messages that aren't deleted or hidden, and weren't created by the IMAP APPEND command.
- * @param	messages	an inx holder containing a collection of messages to be analyzed.
+ * @note	This function only counts messages that aren't deleted or hidden, and weren't created by the IMAP APPEND command. The
+ * 			total is summed from the counters maintained on each folder, rather than by scanning the messages.
+ * @param	folders		an inx holder containing the user's folders.
  * @return	the total size, in bytes, of all messages available to the POP3 user, or 0 on failure.
  */
-uint64_t pop_total_size(inx_t *messages) {
-
-	uint64_t result = 0;
-	inx_cursor_t *cursor;
-	meta_message_t *active;
-
-	if (!messages || !(cursor = inx_cursor_alloc(messages))) {
-		return 0;
-	}
-
-	while ((active = inx_cursor_value_next(cursor))) {
-
-		if (!(active->status & (MAIL_STATUS_APPENDED | MAIL_STATUS_HIDDEN))) {
-			result += active->size;
-		}
+uint64_t pop_total_size(inx_t *folders) {
 
-	}
+	meta_counters_t totals;
 
-	inx_cursor_free(cursor);
+	meta_counters_total(folders, &totals);
 
-	return result;
+	return totals.visible_bytes;
 }
 
 /**
@@ -372,8 +372,8 @@ void pop_stat(connection_t *con) {
 	}
 
 	meta_user_rlock(con->pop.user);
-	count = pop_total_messages(con->pop.user->messages);
-	size = pop_total_size(con->pop.user->messages);
+	count = pop_total_messages(con->pop.user->folders);
+	size = pop_total_size(con->pop.user->folders);
 	meta_user_unlock(con->pop.user);
 
 	// Print the information.
@@ -433,7 +433,7 @@ void pop_list(connection_t *con) {
 	// Output all of the messages that aren't deleted or appended.
 	if (!result) {
 		number = 1;
-		con_print(con, "+OK %llu messages total.\r\n", pop_total_messages(con->pop.user->messages));
+		con_print(con, "+OK %llu messages total.\r\n", pop_total_messages(con->pop.user->folders));
 
 		if (con->pop.user->messages && (cursor = inx_cursor_alloc(con->pop.user->messages))) {
 
@@ -501,7 +501,7 @@ void pop_dele(connection_t *con) {
 		con_write_bl(con, "-ERR Message already deleted.\r\n", 31);
 	}
 	else {
-		active->status += MAIL_STATUS_HIDDEN;
+		meta_counters_status(con->pop.user->folders, active, active->status + MAIL_STATUS_HIDDEN);
 		con_write_bl(con, "+OK Message marked for deletion.\r\n", 34);
 	}
 
@@ -535,7 +535,7 @@ void pop_uidl(connection_t *con) {
 	// Output all of the messages that aren't deleted or appended.
 	if (!result) {
 		number = 1;
-		con_print(con, "+OK %llu messages total.\r\n", pop_total_messages(con->pop.user->messages));
+		con_print(con, "+OK %llu messages total.\r\n", pop_total_messages(con->pop.user->folders));
 
 		if (con->pop.user->messages && (cursor = inx_cursor_alloc(con->pop.user->messages))) {
 
@@ -29,7 +29,7 @@ int_t pop_session_reset(connection_t *con) {
 		while ((active = inx_cursor_value_next(cursor))) {
 
 			if ((active->status & MAIL_STATUS_HIDDEN) == MAIL_STATUS_HIDDEN) {
-				active->status -= MAIL_STATUS_HIDDEN;
+				meta_counters_status(con->pop.user->folders, active, active->status - MAIL_STATUS_HIDDEN);
 			}
 
 		}
@@ -69,6 +69,7 @@ void pop_session_destroy(connection_t *con) {
 					if ((active->status & MAIL_STATUS_HIDDEN) == MAIL_STATUS_HIDDEN) {
 						mail_remove_message(con->pop.user->usernum, active->messagenum, active->size, active->server);
 						key.val.u64 = active->messagenum;
+						meta_counters_remove(con->pop.user->folders, active);
 						inx_delete(con->pop.user->messages, key);
 						deleted = true;
 					}
@@ -77,6 +78,7 @@ void pop_session_destroy(connection_t *con) {
 
 				if (deleted) {
 					meta_messages_update_sequences(con->pop.user->folders, con->pop.user->messages);
+					meta_snapshot_invalidate(con->pop.user);
 					con->pop.user->serials.messages = serial_increment(OBJECT_MESSAGES, con->pop.user->usernum);
 				}
 
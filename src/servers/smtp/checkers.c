@@ -68,55 +68,310 @@ int_t smtp_check_greylist(connection_t *con, smtp_inbound_prefs_t *prefs) {
 	return result;
 }
 
+// The statistics used to track how many queries were sent to each blacklist, and how long the answers took, in configuration order.
+static chr_t *smtp_rbl_stats[MAGMA_BLACKLIST_INSTANCES][2] = {
+	{ "smtp.rbl.1.queries", "smtp.rbl.1.time" },
+	{ "smtp.rbl.2.queries", "smtp.rbl.2.time" },
+	{ "smtp.rbl.3.queries", "smtp.rbl.3.time" },
+	{ "smtp.rbl.4.queries", "smtp.rbl.4.time" },
+	{ "smtp.rbl.5.queries", "smtp.rbl.5.time" },
+	{ "smtp.rbl.6.queries", "smtp.rbl.6.time" }
+};
+
+/**
+ * @brief	Query a single name server for every blacklist which hasn't been resolved yet, sending every query at once, and stopping at
+ * 			the first listing.
+ * @note	The queries are sent over a single UDP socket, and the answers are matched to their queries using the message id and question.
+ * 			Any queries still outstanding once the address is found on a list are abandoned. If some queries haven't been answered by the
+ * 			time half of magma.smtp.blacklist_timeout has passed, they are sent again.
+ * @param	state		the resolver state used to build the queries.
+ * @param	addr		the reversed form of the address being checked, as returned by con_addr_reversed().
+ * @param	lists		an array of managed strings holding the blacklist domain names.
+ * @param	count		the number of blacklists to query, up to MAGMA_BLACKLIST_INSTANCES.
+ * @param	resolved	an array of flags, one per blacklist, which are set once the blacklist gives a definitive answer. Blacklists which
+ * 						have already been resolved aren't queried again.
+ * @param	resolver	the address of the name server to query.
+ * @param	length		the length of the name server address.
+ * @return	-2 if the address was blacklisted, or 0 otherwise.
+ */
+static int_t smtp_rbl_query_server(struct __res_state *state, stringer_t *addr, stringer_t **lists, uint32_t count, bool_t *resolved,
+	struct sockaddr *resolver, socklen_t length) {
+
+	ns_msg msg;
+	ns_rr record;
+	uint16_t base;
+	ssize_t received;
+	struct pollfd pfd;
+	int_t result = 0;
+	uint32_t outstanding = 0;
+	bool_t listed, resent = false;
+	uint64_t elapsed;
+	struct timeval start, now;
+	uchr_t response[NS_PACKETSZ];
+	int sock, ret, i, packet[MAGMA_BLACKLIST_INSTANCES];
+	chr_t names[MAGMA_BLACKLIST_INSTANCES][NS_MAXDNAME];
+	uchr_t queries[MAGMA_BLACKLIST_INSTANCES][NS_PACKETSZ];
+	bool_t answered[MAGMA_BLACKLIST_INSTANCES];
+
+	// Connecting the socket means the kernel will discard any datagrams which don't come from the name server.
+	if ((sock = socket(resolver->sa_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) == -1) {
+		log_pedantic("Unable to create a socket for the blacklist queries. { errno = %i / error = %s }", errno, errno_name(errno));
+		return 0;
+	}
+	else if (connect(sock, resolver, length)) {
+		log_pedantic("Unable to connect the blacklist query socket with the name server. { errno = %i / error = %s }", errno, errno_name(errno));
+		close(sock);
+		return 0;
+	}
+
+	// The queries use consecutive message ids, so an answer can be matched to its query using the difference.
+	base = rand_get_uint16();
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < (int)count; i++) {
+
+		answered[i] = true;
+
+		if (resolved[i]) {
+			continue;
+		}
+		else if (st_empty(lists[i]) || (ret = snprintf(names[i], NS_MAXDNAME, "%.*s.%.*s", st_length_int(addr), st_char_get(addr),
+			st_length_int(lists[i]), st_char_get(lists[i]))) <= 0 || ret >= NS_MAXDNAME) {
+			log_pedantic("Blacklist query name creation failed.");
+		}
+		else if ((packet[i] = res_nmkquery(state, ns_o_query, names[i], ns_c_in, ns_t_a, NULL, 0, NULL, queries[i], NS_PACKETSZ)) <= 0) {
+			log_pedantic("Blacklist query creation failed. { name = %s }", names[i]);
+		}
+		else {
+
+			((HEADER *)queries[i])->id = htons((uint16_t)(base + i));
+
+			if (send(sock, queries[i], packet[i], 0) != packet[i]) {
+				log_pedantic("Unable to send a blacklist query. { name = %s / errno = %i / error = %s }", names[i], errno, errno_name(errno));
+			}
+			else {
+				stats_increment_by_name(smtp_rbl_stats[i][0]);
+				answered[i] = false;
+				outstanding++;
+			}
+		}
+	}
+
+	while (outstanding && result != -2) {
+
+		gettimeofday(&now, NULL);
+		elapsed = (((now.tv_sec - start.tv_sec) * 1000000) + (now.tv_usec - start.tv_usec)) / 1000;
+
+		if (elapsed >= magma.smtp.blacklists.timeout) {
+			break;
+		}
+
+		// Datagrams can be lost, so anything still outstanding halfway to the deadline is sent again.
+		else if (!resent && elapsed >= (magma.smtp.blacklists.timeout / 2)) {
+
+			for (i = 0; i < (int)count; i++) {
+				if (!answered[i] && send(sock, queries[i], packet[i], 0) == packet[i]) {
+					stats_increment_by_name(smtp_rbl_stats[i][0]);
+				}
+			}
+
+			resent = true;
+		}
+
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		if ((ret = poll(&pfd, 1, resent ? magma.smtp.blacklists.timeout - elapsed : (magma.smtp.blacklists.timeout / 2) - elapsed)) == -1 &&
+			errno == EINTR) {
+			continue;
+		}
+		else if (ret == -1) {
+			log_pedantic("Unable to poll the blacklist query socket. { errno = %i / error = %s }", errno, errno_name(errno));
+			break;
+		}
+		else if (!ret) {
+			continue;
+		}
+
+		// A refused connection means the name server isn't listening, so there is no point in waiting for the rest.
+		if ((received = recv(sock, response, NS_PACKETSZ, 0)) <= 0) {
+			if (received == -1 && errno == ECONNREFUSED) {
+				log_pedantic("The name server refused the blacklist queries.");
+				break;
+			}
+			continue;
+		}
+
+		// Ignore anything which isn't an answer to one of the questions we asked.
+		if (ns_initparse(response, received, &msg) || !ns_msg_getflag(msg, ns_f_qr) || (i = (uint16_t)(ns_msg_id(msg) - base)) >= (int)count ||
+			answered[i] || ns_msg_count(msg, ns_s_qd) != 1 || ns_parserr(&msg, ns_s_qd, 0, &record) || strcasecmp(ns_rr_name(record), names[i])) {
+			continue;
+		}
+
+		gettimeofday(&now, NULL);
+		stats_adjust_by_name(smtp_rbl_stats[i][1], (((now.tv_sec - start.tv_sec) * 1000000) + (now.tv_usec - start.tv_usec)) / 1000);
+
+		answered[i] = true;
+		outstanding--;
+
+		// An address record means the address is listed, while a missing name means it isn't. Any other response code leaves the
+		// blacklist unresolved, so the next name server can be asked.
+		if ((ret = ns_msg_getflag(msg, ns_f_rcode)) == ns_r_noerror) {
+
+			listed = false;
+
+			for (int j = 0; !listed && j < ns_msg_count(msg, ns_s_an); j++) {
+				if (!ns_parserr(&msg, ns_s_an, j, &record) && ns_rr_type(record) == ns_t_a) {
+					listed = true;
+				}
+			}
+
+			resolved[i] = true;
+			if (listed) result = -2;
+		}
+		else if (ret == ns_r_nxdomain) {
+			resolved[i] = true;
+		}
+		else {
+			log_pedantic("Blacklist DNS query resulted in an error. { name = %s / rcode = %i }", names[i], ret);
+		}
+	}
+
+	if (outstanding && result != -2) {
+		stats_adjust_by_name("smtp.rbl.timeouts", outstanding);
+	}
+
+	close(sock);
+
+	return result;
+}
+
+/**
+ * @brief	Query a collection of real-time blacklists for an address, stopping at the first listing.
+ * @note	When a name server isn't supplied, every name server configured for the system is tried in turn, including those with IPv6
+ * 			addresses, until each blacklist has given a definitive answer. Only the blacklists left unresolved by one name server are
+ * 			sent to the next.
+ * @param	addr		the reversed form of the address being checked, as returned by con_addr_reversed().
+ * @param	lists		an array of managed strings holding the blacklist domain names.
+ * @param	count		the number of blacklists to query, up to MAGMA_BLACKLIST_INSTANCES.
+ * @param	resolver	the address of the name server to query, or NULL to use the name servers configured for the system.
+ * @param	length		the length of the name server address.
+ * @return	-1 if none of the blacklists answered, -2 if the address was blacklisted, 0 if it wasn't found on the blacklists that answered,
+ * 			but some didn't, or 1 if every blacklist answered and it wasn't found on any of them.
+ */
+int_t smtp_rbl_query(stringer_t *addr, stringer_t **lists, uint32_t count, struct sockaddr *resolver, socklen_t length) {
+
+	int_t result = 0;
+	uint32_t resolved = 0;
+	struct __res_state state;
+	bool_t verdicts[MAGMA_BLACKLIST_INSTANCES];
+
+	if (st_empty(addr) || !lists || !count || count > MAGMA_BLACKLIST_INSTANCES) {
+		return -1;
+	}
+
+	// The resolver state is needed to build the queries, and provides the system name servers when one isn't supplied.
+	mm_wipe(&state, sizeof(struct __res_state));
+	mm_wipe(verdicts, sizeof(verdicts));
+
+	if (res_ninit(&state)) {
+		log_pedantic("Unable to initialize the resolver state.");
+		return -1;
+	}
+
+	if (resolver) {
+		result = smtp_rbl_query_server(&state, addr, lists, count, verdicts, resolver, length);
+	}
+	else {
+
+		for (int i = 0; i < state.nscount && i < MAXNS && result != -2 && resolved != count; i++) {
+
+			// The system resolver keeps IPv6 name servers in the extended state, and leaves the IPv4 slot empty.
+			if (state._u._ext.nsaddrs[i] && state._u._ext.nsaddrs[i]->sin6_family == AF_INET6) {
+				result = smtp_rbl_query_server(&state, addr, lists, count, verdicts, (struct sockaddr *)state._u._ext.nsaddrs[i],
+					sizeof(struct sockaddr_in6));
+			}
+			else if (state.nsaddr_list[i].sin_family == AF_INET) {
+				result = smtp_rbl_query_server(&state, addr, lists, count, verdicts, (struct sockaddr *)&(state.nsaddr_list[i]),
+					sizeof(struct sockaddr_in));
+			}
+			else {
+				continue;
+			}
+
+			resolved = 0;
+			for (uint32_t j = 0; j < count; j++) {
+				if (verdicts[j]) resolved++;
+			}
+		}
+
+		if (!state.nscount) {
+			log_pedantic("No name server is available for the blacklist queries.");
+		}
+	}
+
+	res_nclose(&state);
+
+	if (result == -2) {
+		return -2;
+	}
+
+	resolved = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		if (verdicts[i]) resolved++;
+	}
+
+	return !resolved ? -1 : (resolved == count ? 1 : 0);
+}
+
 /**
  * @brief	Check the SMTP connection's remote address against a collection of real-time blacklists.
- * @note	The connection's IP address will be checked against each of the servers configured in magma.smtp.blacklists.domain.
+ * @note	The connection's IP address will be checked against each of the servers configured in magma.smtp.blacklists.domain, and
+ * 			the verdict is stored in the cache for magma.smtp.blacklist_cache seconds, so subsequent connections from the same address
+ * 			can skip the queries. A clean verdict is only cached when every blacklist answered.
  * @param	con		the connection to have its address examined against the RBLs.
  * @return	-1 on general error, -2 if the address was blacklisted, or 1 if it passed the check.
  */
 int_t smtp_check_rbl(connection_t *con) {
 
-	int_t ret, result = -1;
-	chr_t query[NI_MAXHOST];
-	struct addrinfo *lookup, hints;
-	stringer_t *addr = MANAGEDBUF(128);
-
-	mm_wipe(&hints, sizeof(struct addrinfo));
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = 0;
-	hints.ai_flags = 0;
-	hints.ai_protocol = 0;
+	int_t result = -1;
+	stringer_t *value = NULL, *addr = MANAGEDBUF(128), *key = MANAGEDBUF(256);
 
 	if (!(addr = con_addr_reversed(con, addr))) {
 		log_pedantic("Address string creation failed.");
 		return result;
 	}
 
-	for (uint32_t i = 0; i < magma.smtp.blacklists.count; i++) {
+	// Check whether the verdict for this address is already known.
+	if (magma.smtp.blacklists.cache && st_sprint(key, "magma.rbl.%.*s", st_length_int(addr), st_char_get(addr)) > 0 &&
+		(value = cache_get(key))) {
 
-		// Build the DNS query.
-		if ((snprintf(query, NI_MAXHOST, "%.*s.%*s", st_length_int(addr), st_char_get(addr),
-			st_length_int(magma.smtp.blacklists.domain[i]),	st_char_get(magma.smtp.blacklists.domain[i]))) == 0) {
-				log_pedantic("Address string creation failed.");
+		if (st_length_get(value) == sizeof(int64_t)) {
+			result = *((int64_t *)st_data_get(value));
 		}
 
-		// A zero means we found a blacklist entry, so we need to free the entry.
-		else if (!(ret = getaddrinfo(query, NULL, &hints, &lookup))) {
-			freeaddrinfo(lookup);
-			return -2;
-		}
-		// If the return code code indicates an error, rather than simply not finding a matching entry.
-		// Do we also want to exclude EAI_ADDRFAMILY or EAI_NODATA
-		else if (ret != EAI_NONAME) {
-			log_pedantic("Blacklist DNS attempt resulted in an error. { getaddrinfo = %s }", gai_strerror(ret));
-		}
-		else {
-			result = 1;
+		st_free(value);
+
+		if (result == -2 || result == 1) {
+			stats_increment_by_name("smtp.rbl.hits");
+			return result;
 		}
+	}
+
+	stats_increment_by_name("smtp.rbl.misses");
 
+	// Only definitive verdicts are cached. Errors, and clean verdicts where some of the blacklists didn't answer, are left for the next
+	// connection to try again.
+	if (((result = smtp_rbl_query(addr, magma.smtp.blacklists.domain, magma.smtp.blacklists.count, NULL, 0)) == -2 || result == 1) &&
+		magma.smtp.blacklists.cache && !st_empty(key) && (value = st_alloc_opts(BLOCK_T | CONTIGUOUS | HEAP, sizeof(int64_t)))) {
+		*((int64_t *)st_data_get(value)) = result;
+		cache_set(key, value, magma.smtp.blacklists.cache);
+		st_free(value);
 	}
 
-	return result;
+	// The blacklists which did answer cleared the address.
+	return result == 0 ? 1 : result;
 }
 
 /**
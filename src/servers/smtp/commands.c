@@ -72,10 +72,10 @@ void smtp_process(connection_t *con) {
 		con->command = command;
 		con->protocol.spins = 0;
 
-		// If the DATA and QUIT commands need control over the requeue process. If the DATA command is successful it will enqueue the
-		// inbound or outbound processor instead the command processor, and the QUIT command destroys a connection thereby eliminating the need
-		// to enqueue it.
-		if (command->function == &smtp_data || command->function == &smtp_quit) {
+		// If the DATA, BDAT and QUIT commands need control over the requeue process. If the DATA command, or a BDAT command with the last
+		// chunk, is successful it will enqueue the inbound or outbound processor instead the command processor, and the QUIT command destroys
+		// a connection thereby eliminating the need to enqueue it.
+		if (command->function == &smtp_data || command->function == &smtp_bdat || command->function == &smtp_quit) {
 			enqueue(command->function, con);
 		}
 		else {
@@ -137,6 +137,9 @@ int_t smtp_fetch_inbound(stringer_t *address, smtp_inbound_prefs_t **output) {
 	parameters[0].buffer_length = st_length_get(address);
 	parameters[0].buffer = st_char_get(address);
 
+	// Each database round trip is counted, so the effectiveness of the recipient preferences cache can be measured.
+	stats_increment_by_name("smtp.prefs.queries");
+
 	// If the address isn't found locally, check whether the domain configuration indicates we should also perform a wildcard search.
 	if ((result = stmt_get_result(stmts.select_prefs_inbound, parameters)) && res_row_count(result) == 0 && (local = domain_wildcard(&domain)) == 1) {
 
@@ -147,6 +150,7 @@ int_t smtp_fetch_inbound(stringer_t *address, smtp_inbound_prefs_t **output) {
 		parameters[0].buffer_length = st_length_get(&domain);
 		parameters[0].buffer = st_char_get(&domain);
 
+		stats_increment_by_name("smtp.prefs.queries");
 		result = stmt_get_result(stmts.select_prefs_inbound, parameters);
 	}
 
@@ -289,6 +293,8 @@ int_t smtp_fetch_inbound(stringer_t *address, smtp_inbound_prefs_t **output) {
 		parameters[0].is_unsigned = true;
 
 		// Execute the query, and store the result.
+		stats_increment_by_name("smtp.prefs.queries");
+
 		if ((result = stmt_get_result(stmts.select_filters, parameters)) != NULL) {
 
 			// Allocate our linked list.
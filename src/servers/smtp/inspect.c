@@ -0,0 +1,282 @@
+
+/**
+ * @file /magma/servers/smtp/inspect.c
+ *
+ * @brief	Functions used to run the content checks on an inbound message concurrently, using a dedicated pool of checker threads.
+ */
+
+#include "magma.h"
+
+typedef struct {
+	sem_t *done;
+	int_t check, result;
+	stringer_t *id, *text;
+	struct smtp_inspect_job_t *next;
+} smtp_inspect_job_t;
+
+static struct {
+	sem_t sema;
+	bool_t running;
+	pthread_t *threads;
+	pthread_mutex_t lock;
+	smtp_inspect_job_t *items, *last;
+} smtp_inspect = {
+	.running = false,
+	.threads = NULL,
+	.items = NULL,
+	.last = NULL,
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+// The latency histogram buckets for each check, in milliseconds.
+static uint64_t smtp_inspect_buckets[] = { 10, 100, 1000, 10000 };
+
+static chr_t *smtp_inspect_histograms[SMTP_INSPECT_CHECKS][5] = {
+	{ "smtp.checks.virus.10ms", "smtp.checks.virus.100ms", "smtp.checks.virus.1s", "smtp.checks.virus.10s", "smtp.checks.virus.slow" },
+	{ "smtp.checks.dkim.10ms", "smtp.checks.dkim.100ms", "smtp.checks.dkim.1s", "smtp.checks.dkim.10s", "smtp.checks.dkim.slow" }
+};
+
+/**
+ * @brief	Run a single content check, and record how long it took in the latency histogram for that check.
+ * @param	job		the check to be run, which receives the result.
+ * @return	This function returns no value.
+ */
+static void smtp_inspect_run(smtp_inspect_job_t *job) {
+
+	struct timeval start;
+
+	gettimeofday(&start, NULL);
+
+	if (job->check == SMTP_INSPECT_VIRUS) {
+		job->result = virus_check(job->text);
+	}
+	else if (job->check == SMTP_INSPECT_DKIM) {
+		job->result = dkim_signature_verify(job->id, job->text);
+	}
+
+	stats_latency_by_name(&start, smtp_inspect_buckets, sizeof(smtp_inspect_buckets) / sizeof(uint64_t), smtp_inspect_histograms[job->check]);
+
+	return;
+}
+
+/**
+ * @brief	The entry point for the checker threads, which run the queued content checks until the pool is stopped.
+ * @return	This function returns no value.
+ */
+void smtp_inspect_thread(void) {
+
+	smtp_inspect_job_t *job;
+
+	if (!thread_start()) {
+		log_error("Unable to setup the thread context.");
+		pthread_exit(NULL);
+	}
+
+	do {
+
+		sem_wait(&smtp_inspect.sema);
+
+		mutex_lock(&smtp_inspect.lock);
+
+		if ((job = smtp_inspect.items) && !(smtp_inspect.items = (smtp_inspect_job_t *)job->next)) {
+			smtp_inspect.last = NULL;
+		}
+
+		mutex_unlock(&smtp_inspect.lock);
+
+		if (job) {
+			smtp_inspect_run(job);
+			sem_post(job->done);
+		}
+
+	// A check is never abandoned, since the worker which queued it is waiting on the result.
+	} while (job || smtp_inspect.running);
+
+	thread_stop();
+	pthread_exit(NULL);
+
+	return;
+}
+
+/**
+ * @brief	Run the per message content checks needed by the recipients of an inbound message, and store the results in the session.
+ * @note	The checks only depend on the message, so each is run once, no matter how many recipients there are, and the results are left
+ * 			in con->smtp.checked, where smtp_accept_message() will find them. When several checks are needed, all but one are handed to the
+ * 			checker pool, while the calling worker runs the remaining check itself, so the delay is that of the slowest check, rather than
+ * 			their sum.
+ * @param	con		the SMTP client connection which delivered the message.
+ * @return	This function returns no value.
+ */
+void smtp_inspect_message(connection_t *con) {
+
+	sem_t done;
+	int_t count = 0;
+	bool_t queued = false;
+	smtp_inbound_prefs_t *prefs;
+	smtp_inspect_job_t jobs[SMTP_INSPECT_CHECKS];
+	bool_t virus = false, dkim = false;
+
+	if (!con || !con->smtp.message) {
+		return;
+	}
+
+	// Figure out which checks at least one recipient needs, skipping any which already have a result for this message.
+	for (prefs = con->smtp.in_prefs; prefs; prefs = (smtp_inbound_prefs_t *)prefs->next) {
+
+		if ((prefs->virus == 1 || prefs->phish == 1) && (con->smtp.checked.virus == 0 || con->smtp.checked.virus == -1)) {
+			virus = true;
+		}
+
+		if (!con->smtp.bypass && prefs->mark == SMTP_MARK_NONE && prefs->dkim == 1 && con->smtp.checked.dkim == 0) {
+			dkim = true;
+		}
+	}
+
+	if (virus) {
+		jobs[count++] = (smtp_inspect_job_t){ .done = &done, .check = SMTP_INSPECT_VIRUS, .text = con->smtp.message->text };
+	}
+
+	if (dkim) {
+		jobs[count++] = (smtp_inspect_job_t){ .done = &done, .check = SMTP_INSPECT_DKIM, .id = con->smtp.message->id, .text = con->smtp.message->text };
+	}
+
+	if (!count) {
+		return;
+	}
+
+	// Hand every check but the first to the pool. If the pool isn't running, they are all run by this thread instead.
+	if (count > 1 && !sem_init(&done, 0, 0)) {
+
+		mutex_lock(&smtp_inspect.lock);
+
+		if (smtp_inspect.running) {
+
+			for (int_t i = 1; i < count; i++) {
+
+				jobs[i].next = NULL;
+
+				if (smtp_inspect.last) smtp_inspect.last->next = (struct smtp_inspect_job_t *)&jobs[i];
+				else smtp_inspect.items = &jobs[i];
+
+				smtp_inspect.last = &jobs[i];
+			}
+
+			queued = true;
+		}
+
+		mutex_unlock(&smtp_inspect.lock);
+
+		if (queued) {
+
+			for (int_t i = 1; i < count; i++) {
+				sem_post(&smtp_inspect.sema);
+			}
+
+			stats_increment_by_name("smtp.checks.parallel");
+		}
+		else {
+			sem_destroy(&done);
+		}
+	}
+
+	for (int_t i = 0; i < (queued ? 1 : count); i++) {
+		smtp_inspect_run(&jobs[i]);
+	}
+
+	// The jobs live on this stack, so we have to wait for every queued check to finish, even if a signal interrupts the wait.
+	if (queued) {
+
+		for (int_t i = 1; i < count; i++) {
+			while (sem_wait(&done) && errno == EINTR);
+		}
+
+		sem_destroy(&done);
+	}
+
+	for (int_t i = 0; i < count; i++) {
+
+		if (jobs[i].check == SMTP_INSPECT_VIRUS) {
+			con->smtp.checked.virus = jobs[i].result;
+		}
+		else if (jobs[i].check == SMTP_INSPECT_DKIM) {
+			con->smtp.checked.dkim = jobs[i].result;
+		}
+	}
+
+	return;
+}
+
+/**
+ * @brief	Launch the pool of checker threads.
+ * @note	If magma.smtp.checker_threads is zero, the checks are run by the workers, one after the other.
+ * @return	true on success, or false on failure.
+ */
+bool_t smtp_inspect_start(void) {
+
+	if (!magma.smtp.checker_threads) {
+		return true;
+	}
+	else if (sem_init(&smtp_inspect.sema, 0, 0)) {
+		log_critical("Unable to initialize the checker pool semaphore.");
+		return false;
+	}
+	else if (!(smtp_inspect.threads = mm_alloc(sizeof(pthread_t) * magma.smtp.checker_threads))) {
+		log_critical("Unable to allocate memory for the checker thread handles.");
+		sem_destroy(&smtp_inspect.sema);
+		return false;
+	}
+
+	smtp_inspect.running = true;
+
+	for (uint32_t i = 0; i < magma.smtp.checker_threads; i++) {
+
+		if (thread_launch(smtp_inspect.threads + i, &smtp_inspect_thread, NULL)) {
+			log_critical("Unable to launch the configured number of checker threads. {threads = %u / configured = %u}", i, magma.smtp.checker_threads);
+
+			// Stop the threads which did launch.
+			mutex_lock(&smtp_inspect.lock);
+			smtp_inspect.running = false;
+			mutex_unlock(&smtp_inspect.lock);
+
+			for (uint32_t j = 0; j < i; j++) sem_post(&smtp_inspect.sema);
+			for (uint32_t j = 0; j < i; j++) thread_join(*(smtp_inspect.threads + j));
+
+			mm_free(smtp_inspect.threads);
+			sem_destroy(&smtp_inspect.sema);
+			smtp_inspect.threads = NULL;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Stop the checker threads, once any queued checks are finished.
+ * @note	This runs after the worker threads have exited, so nothing new can be queued.
+ * @return	This function returns no value.
+ */
+void smtp_inspect_stop(void) {
+
+	if (!smtp_inspect.threads) {
+		return;
+	}
+
+	mutex_lock(&smtp_inspect.lock);
+	smtp_inspect.running = false;
+	mutex_unlock(&smtp_inspect.lock);
+
+	for (uint32_t i = 0; i < magma.smtp.checker_threads; i++) {
+		sem_post(&smtp_inspect.sema);
+	}
+
+	for (uint32_t i = 0; i < magma.smtp.checker_threads; i++) {
+		thread_join(*(smtp_inspect.threads + i));
+	}
+
+	mm_free(smtp_inspect.threads);
+	sem_destroy(&smtp_inspect.sema);
+	smtp_inspect.threads = NULL;
+
+	return;
+}
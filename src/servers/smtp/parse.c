@@ -268,10 +268,11 @@ stringer_t * smtp_parse_mail_from_path(connection_t *con) {
 
 		if (tok_get_bl(input, length, ' ', i, &token) >= 0 && !pl_empty(token = pl_trim(token)) && pl_length_get(token) > 5) {
 
-			// The BODY parameter provided by RFCs 1426 and 1652.
+			// The BODY parameter provided by RFCs 1426 and 1652, and the BINARYMIME value provided by RFC 3030.
 			if (!st_cmp_ci_starts(&token, CONSTANT("BODY=")) && tok_get_pl(token, '=', 1, &token) >= 0) {
 				if (!st_cmp_ci_starts(&token, CONSTANT("7BIT"))) con->smtp.suggested_eight_bit = false;
 				else if (!st_cmp_ci_starts(&token, CONSTANT("8BITMIME"))) con->smtp.suggested_eight_bit = true;
+				else if (!st_cmp_ci_starts(&token, CONSTANT("BINARYMIME"))) con->smtp.suggested_eight_bit = con->smtp.suggested_binary = true;
 #ifdef MAGMA_PEDANTIC
 				else {
 					tok_get_bl(input, length, ' ', i, &token);
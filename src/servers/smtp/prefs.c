@@ -0,0 +1,385 @@
+
+/**
+ * @file /magma/servers/smtp/prefs.c
+ *
+ * @brief	Functions used to cache the inbound preferences of recipient addresses, so repeated RCPT TO commands don't query the database.
+ */
+
+#include "magma.h"
+
+typedef struct {
+	int_t state; /* The result of the database lookup. Addresses which didn't match an active mailbox are cached too. */
+	time_t stamp; /* When the database lookup was performed. */
+	uint64_t serial; /* The user serial number when the database lookup was performed. */
+	stringer_t *address; /* The recipient address, which is also the index key. */
+	stringer_t *signet; /* The binary form of the user signet, since prime objects can't be copied directly. */
+	smtp_inbound_prefs_t *prefs; /* The preferences copied for each lookup, or NULL if the address didn't match an active mailbox. */
+	object_link_t cache;
+} smtp_prefs_entry_t;
+
+static struct {
+	inx_t *entries;
+	object_list_t lru;
+} smtp_prefs = {
+	.entries = NULL,
+	.lru = { .bytes = 0, .count = 0, .head = NULL, .tail = NULL, .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+
+/**
+ * @brief	Free a cached recipient lookup, and remove it from the list of cached lookups.
+ * @param	entry	a pointer to the cached lookup to be destroyed.
+ * @return	This function returns no value.
+ */
+static void smtp_prefs_entry_free(smtp_prefs_entry_t *entry) {
+
+	if (!entry) {
+		return;
+	}
+
+	obj_cache_unlink(&(smtp_prefs.lru), &(entry->cache));
+	smtp_free_inbound(entry->prefs);
+	st_cleanup(entry->address, entry->signet);
+	mm_free(entry);
+
+	return;
+}
+
+/**
+ * @brief	Create a deep copy of a set of inbound preferences, which the caller is free to modify.
+ * @param	prefs	a pointer to the inbound preferences being copied.
+ * @param	signet	if not NULL, the binary form of the user signet, which is parsed and attached to the copy.
+ * @return	NULL on failure, or a pointer to the copy of the inbound preferences on success.
+ */
+static smtp_inbound_prefs_t * smtp_prefs_copy(smtp_inbound_prefs_t *prefs, stringer_t *signet) {
+
+	inx_cursor_t *cursor;
+	smtp_inbound_prefs_t *result;
+	smtp_inbound_filter_t *filter, *holder;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (!(result = mm_dupe(prefs, sizeof(smtp_inbound_prefs_t)))) {
+		log_pedantic("Could not allocate %zu bytes for the inbound preferences.", sizeof(smtp_inbound_prefs_t));
+		return NULL;
+	}
+
+	// Clear the pointers which were copied along with the rest of the structure, so a failure below doesn't free the originals.
+	result->rcptto = result->address = result->domain = result->forwarded = result->spamsig = NULL;
+	result->signet = NULL;
+	result->filters = NULL;
+	result->next = NULL;
+
+	if ((prefs->rcptto && !(result->rcptto = st_dupe(prefs->rcptto))) ||
+		(prefs->address && !(result->address = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, prefs->address))) ||
+		(prefs->domain && !(result->domain = st_dupe(prefs->domain))) ||
+		(prefs->forwarded && !(result->forwarded = st_dupe(prefs->forwarded))) ||
+		(prefs->spamsig && !(result->spamsig = st_dupe(prefs->spamsig))) ||
+		(signet && !(result->signet = prime_set(signet, BINARY, NONE)))) {
+		log_pedantic("Could not duplicate the inbound preferences.");
+		smtp_free_inbound(result);
+		return NULL;
+	}
+
+	if (prefs->filters) {
+
+		if (!(result->filters = inx_alloc(M_INX_LINKED, &smtp_list_free_filter)) || !(cursor = inx_cursor_alloc(prefs->filters))) {
+			log_pedantic("Could not duplicate the inbound filters.");
+			smtp_free_inbound(result);
+			return NULL;
+		}
+
+		while ((filter = inx_cursor_value_next(cursor))) {
+
+			if (!(holder = mm_dupe(filter, sizeof(smtp_inbound_filter_t)))) {
+				log_pedantic("Could not allocate %zu bytes for an inbound filter.", sizeof(smtp_inbound_filter_t));
+				inx_cursor_free(cursor);
+				smtp_free_inbound(result);
+				return NULL;
+			}
+
+			holder->field = holder->label = holder->expression = NULL;
+			key.val.u64 = holder->rulenum;
+
+			if ((filter->field && !(holder->field = st_dupe(filter->field))) || (filter->label && !(holder->label = st_dupe(filter->label))) ||
+				(filter->expression && !(holder->expression = st_dupe(filter->expression))) || !inx_insert(result->filters, key, holder)) {
+				log_pedantic("Could not duplicate an inbound filter.");
+				smtp_list_free_filter(holder);
+				inx_cursor_free(cursor);
+				smtp_free_inbound(result);
+				return NULL;
+			}
+		}
+
+		inx_cursor_free(cursor);
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Estimate the amount of memory held by a cached recipient lookup.
+ * @param	entry	a pointer to the cached lookup.
+ * @return	the estimated number of bytes held by the cached lookup, including its index node.
+ */
+static size_t smtp_prefs_bytes(smtp_prefs_entry_t *entry) {
+
+	inx_cursor_t *cursor;
+	smtp_inbound_filter_t *filter;
+	size_t result = sizeof(smtp_prefs_entry_t) + OBJECT_CACHE_RECORD_BYTES + (st_length_get(entry->address) * 2) + st_length_get(entry->signet);
+
+	if (entry->prefs) {
+
+		result += sizeof(smtp_inbound_prefs_t) + st_length_get(entry->prefs->rcptto) + st_length_get(entry->prefs->address) +
+			st_length_get(entry->prefs->domain) + st_length_get(entry->prefs->forwarded);
+
+		if (entry->prefs->filters && (cursor = inx_cursor_alloc(entry->prefs->filters))) {
+
+			while ((filter = inx_cursor_value_next(cursor))) {
+				result += sizeof(smtp_inbound_filter_t) + OBJECT_CACHE_RECORD_BYTES + st_length_get(filter->field) + st_length_get(filter->label) +
+					st_length_get(filter->expression);
+			}
+
+			inx_cursor_free(cursor);
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Evict the least recently used recipient lookups which have either expired, or are pushing the cache over its memory budget.
+ * @note	The caller must hold the write lock for the cache index.
+ * @param	now		the current time, used to decide whether a lookup has expired.
+ * @param	slice	the maximum number of lookups to examine.
+ * @return	true if the slice was exhausted and more lookups may need evicting, or false if the cache is within its limits.
+ */
+static bool_t smtp_prefs_evict(time_t now, uint64_t slice) {
+
+	bool_t over, result = true;
+	smtp_prefs_entry_t *entry;
+	uint64_t expired = 0, evicted = 0;
+	multi_t key = { .type = M_TYPE_STRINGER, .val.st = NULL };
+
+	for (uint64_t i = 0; i < slice; i++) {
+
+		mutex_lock(&(smtp_prefs.lru.lock));
+		entry = smtp_prefs.lru.tail ? smtp_prefs.lru.tail->object : NULL;
+		over = smtp_prefs.lru.bytes > magma.smtp.prefs.limit;
+		mutex_unlock(&(smtp_prefs.lru.lock));
+
+		if (!entry || (!over && difftime(now, entry->stamp) <= magma.smtp.prefs.timeout)) {
+			result = false;
+			break;
+		}
+
+		// Deleting the lookup from the index will free it, which also removes it from the list.
+		key.val.st = entry->address;
+
+		if (inx_delete(smtp_prefs.entries, key)) {
+			if (over) evicted++;
+			else expired++;
+		}
+		else {
+			obj_cache_unlink(&(smtp_prefs.lru), &(entry->cache));
+		}
+	}
+
+	if (expired) stats_adjust_by_name("smtp.prefs.expired", expired);
+	if (evicted) stats_adjust_by_name("smtp.prefs.evicted", evicted);
+
+	return result;
+}
+
+/**
+ * @brief	Store the result of a recipient lookup in the cache.
+ * @note	Database errors are never cached. The serial number is read after the lookup, so an update which lands in between can go
+ * 			unnoticed until the entry expires.
+ * @param	address	a pointer to the sanitized recipient address.
+ * @param	state	the value returned by smtp_fetch_inbound() for the address.
+ * @param	prefs	a pointer to the inbound preferences returned by the lookup, or NULL if the address didn't match an active mailbox.
+ * @return	This function returns no value.
+ */
+static void smtp_prefs_insert(stringer_t *address, int_t state, smtp_inbound_prefs_t *prefs) {
+
+	time_t now;
+	smtp_prefs_entry_t *entry;
+	multi_t key = { .type = M_TYPE_STRINGER, .val.st = address };
+
+	if (state == -1 || (state == 1 && !prefs) || (now = time(NULL)) == (time_t)(-1)) {
+		return;
+	}
+	else if (!(entry = mm_alloc(sizeof(smtp_prefs_entry_t)))) {
+		log_pedantic("Could not allocate %zu bytes for a cached recipient lookup.", sizeof(smtp_prefs_entry_t));
+		return;
+	}
+
+	entry->state = state;
+	entry->stamp = now;
+
+	if (!(entry->address = st_dupe(address)) || (prefs && ((prefs->signet && !(entry->signet = prime_get(prefs->signet, BINARY, NULL))) ||
+		!(entry->prefs = smtp_prefs_copy(prefs, NULL))))) {
+		smtp_prefs_entry_free(entry);
+		return;
+	}
+
+	if (prefs) {
+		entry->serial = serial_get(OBJECT_USER, prefs->usernum);
+	}
+
+	entry->cache.bytes = smtp_prefs_bytes(entry);
+
+	inx_lock_write(smtp_prefs.entries);
+
+	// A concurrent lookup for the same address may have beaten us here, in which case the older entry is replaced.
+	if (inx_replace(smtp_prefs.entries, key, entry)) {
+		obj_cache_touch(&(smtp_prefs.lru), &(entry->cache), entry);
+	}
+	else {
+		smtp_prefs_entry_free(entry);
+	}
+
+	smtp_prefs_evict(now, OBJECT_CACHE_EVICT_SLICE);
+	inx_unlock(smtp_prefs.entries);
+
+	return;
+}
+
+/**
+ * @brief	Fetch the inbound preferences for a recipient address, using the cached result of an earlier lookup when possible.
+ * @note	Cached preferences are discarded when the user serial number changes. Lookups which didn't find an active mailbox are
+ * 			cached as well, but since they can't be tied to a user, they only expire after magma.smtp.prefs.timeout seconds.
+ * @param	address	a pointer to the sanitized recipient address.
+ * @param	output	a pointer to the address which will receive a copy of the inbound preferences, which the caller must free.
+ * @return	the same values as smtp_fetch_inbound().
+ */
+int_t smtp_prefs_fetch(stringer_t *address, smtp_inbound_prefs_t **output) {
+
+	time_t now;
+	int_t state = -1;
+	uint64_t serial = 0;
+	bool_t found = false;
+	smtp_prefs_entry_t *entry;
+	smtp_inbound_prefs_t *prefs = NULL;
+	multi_t key = { .type = M_TYPE_STRINGER, .val.st = address };
+
+	if (st_empty(address) || !output) {
+		return -1;
+	}
+	else if (!smtp_prefs.entries || !magma.smtp.prefs.limit || !magma.smtp.prefs.timeout || (now = time(NULL)) == (time_t)(-1)) {
+		return smtp_fetch_inbound(address, output);
+	}
+
+	*output = NULL;
+
+	inx_lock_read(smtp_prefs.entries);
+
+	if ((entry = inx_find(smtp_prefs.entries, key)) && difftime(now, entry->stamp) <= magma.smtp.prefs.timeout &&
+		(!entry->prefs || (prefs = smtp_prefs_copy(entry->prefs, entry->signet)))) {
+		obj_cache_touch(&(smtp_prefs.lru), &(entry->cache), entry);
+		state = entry->state;
+		serial = entry->serial;
+		found = true;
+	}
+
+	inx_unlock(smtp_prefs.entries);
+
+	// The serial number may require a trip to the cache server, so it's checked after the index lock has been released.
+	if (found && prefs && serial != serial_get(OBJECT_USER, prefs->usernum)) {
+		stats_increment_by_name("smtp.prefs.stale");
+		smtp_free_inbound(prefs);
+		found = false;
+		prefs = NULL;
+	}
+
+	if (found) {
+		stats_increment_by_name("smtp.prefs.hits");
+		*output = prefs;
+		return state;
+	}
+
+	stats_increment_by_name("smtp.prefs.misses");
+
+	if ((state = smtp_fetch_inbound(address, &prefs)) != -1) {
+		smtp_prefs_insert(address, state, prefs);
+	}
+
+	*output = prefs;
+	return state;
+}
+
+/**
+ * @brief	Remove any expired recipient lookups from the cache, and update the cache statistics.
+ * @note	This is called periodically by the maintenance thread. The index lock is released between slices.
+ * @return	This function returns no value.
+ */
+void smtp_prefs_prune(void) {
+
+	time_t now;
+	bool_t more;
+	uint64_t passes;
+
+	if (!smtp_prefs.entries || (now = time(NULL)) == (time_t)(-1)) {
+		return;
+	}
+
+	mutex_lock(&(smtp_prefs.lru.lock));
+	passes = (smtp_prefs.lru.count / OBJECT_CACHE_EVICT_SLICE) + 1;
+	mutex_unlock(&(smtp_prefs.lru.lock));
+
+	do {
+		inx_lock_write(smtp_prefs.entries);
+		more = smtp_prefs_evict(now, OBJECT_CACHE_EVICT_SLICE);
+		inx_unlock(smtp_prefs.entries);
+	} while (more && --passes && status());
+
+	mutex_lock(&(smtp_prefs.lru.lock));
+	stats_set_by_name("smtp.prefs.total", smtp_prefs.lru.count);
+	stats_set_by_name("smtp.prefs.bytes", smtp_prefs.lru.bytes);
+	mutex_unlock(&(smtp_prefs.lru.lock));
+
+	return;
+}
+
+/**
+ * @brief	Discard every cached recipient lookup.
+ * @return	This function returns no value.
+ */
+void smtp_prefs_truncate(void) {
+
+	if (!smtp_prefs.entries) {
+		return;
+	}
+
+	inx_lock_write(smtp_prefs.entries);
+	inx_truncate(smtp_prefs.entries);
+	inx_unlock(smtp_prefs.entries);
+
+	return;
+}
+
+/**
+ * @brief	Initialize the recipient preferences cache.
+ * @return	true on success or false on failure.
+ */
+bool_t smtp_prefs_start(void) {
+
+	if (!(smtp_prefs.entries = inx_alloc(M_INX_TREE | M_INX_LOCK_MANUAL, &smtp_prefs_entry_free))) {
+		log_critical("Unable to initialize the recipient preferences cache.");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Free the recipient preferences cache, along with any cached lookups.
+ * @return	This function returns no value.
+ */
+void smtp_prefs_stop(void) {
+
+	if (smtp_prefs.entries) {
+		inx_free(smtp_prefs.entries);
+		smtp_prefs.entries = NULL;
+	}
+
+	return;
+}
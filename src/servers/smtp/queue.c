@@ -0,0 +1,1053 @@
+
+/**
+ * @file /magma/servers/smtp/queue.c
+ *
+ * @brief	Functions used to store outbound messages in the spool, and deliver them to the mail relays in the background.
+ * @note	Every queued message is written to its own file inside the queue spool, named using the time it was queued in microseconds, which
+ * 			also orders the index. A file starts with a fixed width status line, which holds the relay class and the number of failed delivery
+ * 			attempts, followed by the envelope, a blank line, and the message. The index only holds what the scheduler needs, so the rest of
+ * 			the file is read back when the message is delivered.
+ */
+
+#include "magma.h"
+
+// The status line found at the start of every queue file. It's rewritten in place after each failed delivery attempt.
+#define SMTP_QUEUE_STATUS "MAGMA-QUEUE %05u %i\r\n"
+#define SMTP_QUEUE_STATUS_LENGTH 21
+#define SMTP_QUEUE_ATTEMPTS_MAX 99999
+
+// The amount of each queue file read during startup, which only needs to include the status line and the first recipient.
+#define SMTP_QUEUE_HEAD_LENGTH 4096
+
+typedef struct {
+	uint64_t number; /* The name of the queue file, which is also the time the message was queued, in microseconds. */
+	int_t premium; /* Set if the message should be delivered using a premium relay. */
+	uint32_t attempts; /* The number of failed delivery attempts. */
+	time_t next; /* The earliest time the next delivery attempt may be made. */
+	bool_t active; /* Set while the message belongs to a delivery batch. */
+	stringer_t *destination; /* The domain of the first recipient, which is used to enforce the per destination concurrency limit. */
+} smtp_queue_entry_t;
+
+typedef struct smtp_queue_batch_t {
+	int_t premium;
+	size_t count;
+	stringer_t *destination;
+	smtp_queue_entry_t **entries;
+	struct smtp_queue_batch_t *next;
+} smtp_queue_batch_t;
+
+struct {
+	bool_t running;
+	pthread_t *thread;
+	pthread_mutex_t lock;
+	uint32_t writers; /* The number of messages being written to the spool. */
+	inx_t *entries; /* The queued messages, keyed by number. */
+	smtp_queue_batch_t *batches; /* The delivery batches which have been handed to the worker threads. */
+	stringer_t *path;
+	uint64_t last; /* The number assigned to the most recently queued message. */
+} smtp_queue = {
+		.running = false,
+		.thread = NULL,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.writers = 0,
+		.entries = NULL,
+		.batches = NULL,
+		.path = NULL,
+		.last = 0
+};
+
+/**
+ * @brief	Free a queue index entry.
+ * @param	entry	a pointer to the queue entry to be freed.
+ * @return	This function returns no value.
+ */
+static void smtp_queue_entry_free(smtp_queue_entry_t *entry) {
+
+	if (entry) {
+		st_cleanup(entry->destination);
+		mm_free(entry);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Build the path of a queue file.
+ * @param	number		the number of the queued message.
+ * @param	temporary	if true, the path of the hidden file used while the message is being written is returned instead.
+ * @return	NULL on failure, or a managed string containing the null-terminated file path.
+ */
+static stringer_t * smtp_queue_file(uint64_t number, bool_t temporary) {
+
+	return st_aprint("%.*s%s%020lu", st_length_int(smtp_queue.path), st_char_get(smtp_queue.path), temporary ? "." : "", number);
+}
+
+/**
+ * @brief	Find the destination domain of an address.
+ * @param	address		a managed string containing the recipient address.
+ * @return	NULL on failure, or a managed string containing the lower case domain portion of the address.
+ */
+static stringer_t * smtp_queue_destination(stringer_t *address) {
+
+	size_t length;
+	chr_t *domain;
+	stringer_t *result;
+
+	if (st_empty(address)) {
+		return NULL;
+	}
+
+	domain = st_char_get(address);
+	length = st_length_get(address);
+
+	for (size_t i = 0; i < st_length_get(address); i++) {
+		if (*(st_char_get(address) + i) == '@') {
+			domain = st_char_get(address) + i + 1;
+			length = st_length_get(address) - i - 1;
+		}
+	}
+
+	if (!(result = st_import(domain, length))) {
+		return NULL;
+	}
+
+	return lower_st(result);
+}
+
+/**
+ * @brief	Parse the status line and envelope found at the start of a queue file.
+ * @param	data		a managed string holding the file contents, or the start of them.
+ * @param	attempts	a pointer to receive the number of failed delivery attempts.
+ * @param	premium		a pointer to receive the relay class.
+ * @param	mailfrom	a pointer to receive a managed string with the return path, which will be NULL for the null sender.
+ * @param	recipients	a pointer to receive the list of recipients, which must be freed by the caller.
+ * @return	-1 if the data isn't a valid queue file, 0 if the envelope was cut short, or the offset of the message on success.
+ */
+static int64_t smtp_queue_parse(stringer_t *data, uint32_t *attempts, int_t *premium, stringer_t **mailfrom, smtp_recipients_t **recipients) {
+
+	chr_t *line, *end;
+	size_t offset, length;
+	smtp_recipients_t *holder, *tail = NULL;
+
+	*mailfrom = NULL;
+	*recipients = NULL;
+
+	if (st_length_get(data) < SMTP_QUEUE_STATUS_LENGTH || mm_cmp_cs_eq(st_char_get(data), "MAGMA-QUEUE ", 12) ||
+		mm_cmp_cs_eq(st_char_get(data) + SMTP_QUEUE_STATUS_LENGTH - 2, "\r\n", 2)) {
+		return -1;
+	}
+
+	// The status line holds a five digit attempt counter, followed by the relay class.
+	for (offset = 12, *attempts = 0; offset < 17; offset++) {
+
+		if (!chr_numeric(*(st_char_get(data) + offset))) {
+			return -1;
+		}
+
+		*attempts = (*attempts * 10) + (*(st_char_get(data) + offset) - '0');
+	}
+
+	*premium = *(st_char_get(data) + 18) == '1' ? 1 : 0;
+	offset = SMTP_QUEUE_STATUS_LENGTH;
+
+	while (offset < st_length_get(data)) {
+
+		line = st_char_get(data) + offset;
+
+		if (!(end = memchr(line, '\n', st_length_get(data) - offset))) {
+			return 0;
+		}
+
+		offset += end - line + 1;
+		length = end - line;
+
+		if (length && *(end - 1) == '\r') {
+			length--;
+		}
+
+		// The blank line marks the end of the envelope.
+		if (!length) {
+			return offset;
+		}
+		else if (length > 5 && !mm_cmp_cs_eq(line, "FROM ", 5)) {
+			st_cleanup(*mailfrom);
+			*mailfrom = st_import(line + 5, length - 5);
+		}
+		else if (length > 3 && !mm_cmp_cs_eq(line, "TO ", 3)) {
+
+			if (!(holder = mm_alloc(sizeof(smtp_recipients_t))) || !(holder->address = st_import(line + 3, length - 3))) {
+				mm_cleanup(holder);
+				return -1;
+			}
+
+			if (tail) tail->next = (struct smtp_recipients_t *)holder;
+			else *recipients = holder;
+			tail = holder;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief	Read a queued message back from the spool.
+ * @param	number		the number of the queued message.
+ * @param	mailfrom	a pointer to receive a managed string with the return path, which will be NULL for the null sender.
+ * @param	recipients	a pointer to receive the list of recipients.
+ * @param	message		a pointer to receive a managed string with the message.
+ * @return	-1 on failure, or 1 on success, in which case the caller is responsible for freeing the outputs.
+ */
+static int_t smtp_queue_read(uint64_t number, stringer_t **mailfrom, smtp_recipients_t **recipients, stringer_t **message) {
+
+	int_t premium;
+	int64_t offset;
+	uint32_t attempts;
+	stringer_t *path, *data = NULL;
+
+	*message = *mailfrom = NULL;
+	*recipients = NULL;
+
+	if (!(path = smtp_queue_file(number, false)) || !(data = file_load(st_char_get(path)))) {
+		log_error("Unable to read a queued message. {path = %.*s}", st_length_int(path), st_char_get(path));
+		st_cleanup(path);
+		return -1;
+	}
+
+	if ((offset = smtp_queue_parse(data, &attempts, &premium, mailfrom, recipients)) <= 0 || !*recipients ||
+		!(*message = st_import(st_char_get(data) + offset, st_length_get(data) - offset))) {
+		log_error("A queued message is invalid. {path = %.*s}", st_length_int(path), st_char_get(path));
+		smtp_free_recipients(*recipients);
+		st_cleanup(*mailfrom);
+		*recipients = NULL;
+		*mailfrom = NULL;
+		st_free(path);
+		st_free(data);
+		return -1;
+	}
+
+	st_free(path);
+	st_free(data);
+
+	return 1;
+}
+
+/**
+ * @brief	Write a buffer to a file descriptor, retrying until the entire buffer has been written.
+ * @param	fd		the file descriptor to be written.
+ * @param	data	a pointer to the buffer.
+ * @param	length	the number of bytes to be written.
+ * @return	true if the entire buffer was written, otherwise false.
+ */
+static bool_t smtp_queue_write_all(int fd, chr_t *data, size_t length) {
+
+	ssize_t written;
+
+	while (length) {
+
+		if ((written = write(fd, data, length)) <= 0 && errno != EINTR) {
+			return false;
+		}
+		else if (written > 0) {
+			data += written;
+			length -= written;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Store an outbound message in the spool.
+ * @note	The message is written to a hidden file, which is flushed to disk and then renamed, so a crash can't leave a partial message
+ * 			in the queue.
+ * @param	number		the number assigned to the message.
+ * @param	premium		set if the message should be delivered using a premium relay.
+ * @param	mailfrom	a managed string containing the return path, which may be empty for the null sender.
+ * @param	recipients	the list of recipients.
+ * @param	message		a managed string containing the message.
+ * @return	true on success, or false on failure.
+ */
+static bool_t smtp_queue_write(uint64_t number, int_t premium, stringer_t *mailfrom, smtp_recipients_t *recipients, stringer_t *message) {
+
+	int fd;
+	chr_t *writer;
+	size_t length;
+	bool_t result;
+	stringer_t *envelope, *temporary = NULL, *path = NULL;
+
+	// Add up the space needed by the status line and envelope, including the terminating null written by snprintf().
+	length = SMTP_QUEUE_STATUS_LENGTH + st_length_get(mailfrom) + 7 + 2 + 1;
+
+	for (smtp_recipients_t *holder = recipients; holder; holder = (smtp_recipients_t *)holder->next) {
+		length += st_length_get(holder->address) + 5;
+	}
+
+	if (!(envelope = st_alloc(length))) {
+		log_pedantic("Unable to allocate a buffer for the queued message envelope.");
+		return false;
+	}
+
+	writer = st_char_get(envelope);
+	writer += snprintf(writer, length, SMTP_QUEUE_STATUS "FROM %.*s\r\n", 0, premium ? 1 : 0, st_length_int(mailfrom), st_char_get(mailfrom));
+
+	for (smtp_recipients_t *holder = recipients; holder; holder = (smtp_recipients_t *)holder->next) {
+		writer += snprintf(writer, length - (writer - st_char_get(envelope)), "TO %.*s\r\n", st_length_int(holder->address), st_char_get(holder->address));
+	}
+
+	writer += snprintf(writer, length - (writer - st_char_get(envelope)), "\r\n");
+	st_length_set(envelope, writer - st_char_get(envelope));
+
+	if (!(temporary = smtp_queue_file(number, true)) || !(path = smtp_queue_file(number, false)) ||
+		(fd = open(st_char_get(temporary), O_WRONLY | O_CREAT | O_EXCL | O_NOATIME, S_IRUSR | S_IWUSR)) == -1) {
+		log_error("Unable to create a queued message file. {errno = %i / path = %.*s}", errno, st_length_int(temporary), st_char_get(temporary));
+		st_cleanup(temporary);
+		st_cleanup(path);
+		st_free(envelope);
+		return false;
+	}
+
+	result = smtp_queue_write_all(fd, st_char_get(envelope), st_length_get(envelope)) &&
+		smtp_queue_write_all(fd, st_char_get(message), st_length_get(message)) && !fsync(fd);
+
+	close(fd);
+
+	if (!result || rename(st_char_get(temporary), st_char_get(path))) {
+		log_error("Unable to write a queued message file. {errno = %i / path = %.*s}", errno, st_length_int(path), st_char_get(path));
+		unlink(st_char_get(temporary));
+		result = false;
+	}
+
+	st_free(temporary);
+	st_free(envelope);
+	st_free(path);
+
+	return result;
+}
+
+/**
+ * @brief	Record the number of failed delivery attempts in the status line of a queue file.
+ * @param	entry	the queue entry being updated.
+ * @return	This function returns no value.
+ */
+static void smtp_queue_status(smtp_queue_entry_t *entry) {
+
+	int fd;
+	stringer_t *path;
+	chr_t status[SMTP_QUEUE_STATUS_LENGTH + 1];
+
+	snprintf(status, SMTP_QUEUE_STATUS_LENGTH + 1, SMTP_QUEUE_STATUS, MIN(entry->attempts, SMTP_QUEUE_ATTEMPTS_MAX), entry->premium ? 1 : 0);
+
+	if (!(path = smtp_queue_file(entry->number, false)) || (fd = open(st_char_get(path), O_WRONLY | O_NOATIME)) == -1) {
+		log_pedantic("Unable to open a queued message file. {errno = %i / path = %.*s}", errno, st_length_int(path), st_char_get(path));
+		st_cleanup(path);
+		return;
+	}
+
+	if (pwrite(fd, status, SMTP_QUEUE_STATUS_LENGTH, 0) != SMTP_QUEUE_STATUS_LENGTH || fdatasync(fd)) {
+		log_pedantic("Unable to update a queued message file. {errno = %i / path = %.*s}", errno, st_length_int(path), st_char_get(path));
+	}
+
+	close(fd);
+	st_free(path);
+
+	return;
+}
+
+/**
+ * @brief	Transmit a message using a relay connection, which is opened if necessary.
+ * @note	If the transmission fails, the relay response is left in the client line, and the connection is left open, since the relay may
+ * 			need to be asked for the rejection before the caller releases it.
+ * @param	client		a pointer to the relay connection, which will be set if a new connection is opened.
+ * @param	premium		set if a new connection should use a premium relay.
+ * @param	mailfrom	a managed string containing the return path, which may be NULL or empty for the null sender.
+ * @param	recipients	the list of recipients.
+ * @param	message		a managed string containing the message, which hasn't been dot stuffed.
+ * @param	rejected	a pointer to receive the list of recipients the relay refused individually, as returned by smtp_client_send_envelope(),
+ * 						which must be freed by the caller. If the message itself fails, the outcome applies to every recipient, and the
+ * 						list is set to NULL.
+ * @return	-3 if the message is invalid, -2 if the relay rejected the message, -1 on network failure, or 1 on success.
+ */
+static int_t smtp_queue_transmit(client_t **client, int_t premium, stringer_t *mailfrom, smtp_recipients_t *recipients, stringer_t *message,
+	smtp_recipients_t **rejected) {
+
+	int_t state;
+
+	*rejected = NULL;
+
+	if (!*client && !(*client = smtp_client_connect(premium))) {
+		log_pedantic("Could not relay the message.");
+		return -1;
+	}
+	else if (smtp_client_send_helo(*client) != 1) {
+		log_pedantic("An error occurred while trying to say hello.");
+		return -1;
+	}
+	else if ((state = smtp_client_send_envelope(*client, st_empty(mailfrom) ? PLACER("", 0) : mailfrom, recipients, rejected)) != 1) {
+		log_pedantic("An error occurred while trying to send the message envelope.");
+		return state;
+	}
+	else if ((state = smtp_client_send_data(*client, message, false)) != 1) {
+		log_pedantic("An error occurred while trying to send the message.");
+		smtp_free_recipients(*rejected);
+		*rejected = NULL;
+		return state;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief	Queue a failure notice for a message which couldn't be delivered.
+ * @note	The notice is built and queued by smtp_bounce_notice(), and only the header of the failed message is returned.
+ * @param	mailfrom	a managed string containing the return path of the failed message.
+ * @param	recipients	the list of recipients the message couldn't be delivered to, which are listed alongside their refusal, if the
+ * 						relay refused them individually.
+ * @param	message		a managed string containing the failed message.
+ * @param	reason		an optional managed string containing the last response from the relay.
+ * @return	This function returns no value.
+ */
+static void smtp_queue_notify(stringer_t *mailfrom, smtp_recipients_t *recipients, stringer_t *message, stringer_t *reason) {
+
+	size_t headers;
+	stringer_t *addresses = NULL, *holder;
+
+	if (st_empty(mailfrom)) {
+		return;
+	}
+
+	for (smtp_recipients_t *current = recipients; current; current = (smtp_recipients_t *)current->next) {
+		if ((holder = st_merge("snsnsn", addresses, "    ", current->address, " - ", current->response ? NULL : "The message couldn't be relayed.",
+			current->response, "\r\n"))) {
+			st_cleanup(addresses);
+			addresses = holder;
+		}
+	}
+
+	for (headers = 0; headers + 4 <= st_length_get(message) && mm_cmp_cs_eq(st_char_get(message) + headers, "\r\n\r\n", 4); headers++);
+
+	if (headers + 4 > st_length_get(message)) {
+		headers = st_length_get(message);
+	}
+
+	if (smtp_bounce_notice(mailfrom, addresses, reason ? reason : PLACER("The message expired before it could be delivered.", 49),
+		PLACER(st_char_get(message), headers)) != 1) {
+		log_pedantic("Unable to queue the delivery failure notice. {mailfrom = %.*s}", st_length_int(mailfrom), st_char_get(mailfrom));
+	}
+
+	st_cleanup(addresses);
+
+	return;
+}
+
+/**
+ * @brief	Record the outcome of a delivery attempt.
+ * @note	Delivered messages, and messages which were permanently rejected or have expired, are removed from the queue. Otherwise the
+ * 			next attempt is delayed by the retry interval, which doubles with every failed attempt until it reaches the backoff limit.
+ * 			Recipients the relay refused individually are handled on their own, so the recipients it accepted are neither bounced
+ * 			nor sent the message again. Permanent refusals are returned to the sender, and the queue file is rewritten so only the
+ * 			temporarily refused recipients are retried.
+ * @param	entry		the queue entry which was attempted.
+ * @param	state		the result of the attempt, where 0 indicates the message was skipped, and not attempted.
+ * @param	mailfrom	a managed string containing the return path.
+ * @param	recipients	the list of recipients.
+ * @param	rejected	the list of recipients the relay refused individually, which is consumed by this function.
+ * @param	message		a managed string containing the message.
+ * @param	reason		an optional managed string containing the last response from the relay.
+ * @return	This function returns no value.
+ */
+static void smtp_queue_finish(smtp_queue_entry_t *entry, int_t state, stringer_t *mailfrom, smtp_recipients_t *recipients,
+	smtp_recipients_t *rejected, stringer_t *message, stringer_t *reason) {
+
+	uint64_t delay;
+	uint32_t doubled;
+	stringer_t *path;
+	time_t now = time(NULL);
+	bool_t remove = true, individual = (rejected != NULL), expired, permanent;
+	smtp_recipients_t *holder, *bounced = NULL, *deferred = NULL;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = entry->number };
+
+	expired = now - (time_t)(entry->number / 1000000) >= magma.relay.queue.expire;
+
+	// An invalid message, or a permanent rejection, won't succeed if it's retried, and an expired message has been retried long enough.
+	permanent = state == -3 || (state == -2 && reason && *st_char_get(reason) == '5') || expired;
+
+	while (rejected) {
+
+		holder = rejected;
+		rejected = (smtp_recipients_t *)holder->next;
+
+		if (expired || *st_char_get(holder->response) == '5') {
+			holder->next = (struct smtp_recipients_t *)bounced;
+			bounced = holder;
+		}
+		else {
+			holder->next = (struct smtp_recipients_t *)deferred;
+			deferred = holder;
+		}
+	}
+
+	if (bounced) {
+		log_pedantic("A queued message couldn't be delivered to some of its recipients. {number = %lu / attempts = %u}", entry->number,
+			entry->attempts + 1);
+		smtp_queue_notify(mailfrom, bounced, message, PLACER("The mail relay refused the message for one or more recipients.", 62));
+		stats_increment_by_name("smtp.queue.returned");
+	}
+
+	// If the envelope can't be rewritten, the deferred recipients are returned, since retrying the original envelope would send the
+	// message to the accepted recipients a second time.
+	if (deferred && !smtp_queue_write(entry->number, entry->premium, mailfrom, deferred, message)) {
+		log_error("Unable to rewrite the envelope of a queued message. {number = %lu}", entry->number);
+		smtp_queue_notify(mailfrom, deferred, message, PLACER("The mail relay refused the message for one or more recipients.", 62));
+		stats_increment_by_name("smtp.queue.returned");
+		smtp_free_recipients(deferred);
+		deferred = NULL;
+	}
+
+	if (state == 1) {
+		stats_increment_by_name("smtp.queue.delivered");
+	}
+
+	// Once every recipient has been accepted, or returned above, the message is removed, unless the relay refused the whole message.
+	if (state == 0) {
+		remove = false;
+	}
+	else if (state != 1 && !individual && permanent) {
+		log_pedantic("A queued message couldn't be delivered. {number = %lu / attempts = %u}", entry->number, entry->attempts + 1);
+		if (message) smtp_queue_notify(mailfrom, recipients, message, reason);
+		stats_increment_by_name("smtp.queue.returned");
+	}
+	else if (deferred || (state != 1 && !individual)) {
+		remove = false;
+		entry->attempts++;
+
+		for (delay = magma.relay.queue.retry, doubled = 1; doubled < entry->attempts && delay < magma.relay.queue.backoff; doubled++) {
+			delay *= 2;
+		}
+
+		entry->next = now + MIN(delay, magma.relay.queue.backoff);
+		smtp_queue_status(entry);
+		stats_increment_by_name("smtp.queue.deferred");
+	}
+
+	smtp_free_recipients(bounced);
+	smtp_free_recipients(deferred);
+
+	if (remove && (path = smtp_queue_file(entry->number, false))) {
+		if (unlink(st_char_get(path))) {
+			log_error("Unable to remove a queued message file. {errno = %i / path = %.*s}", errno, st_length_int(path), st_char_get(path));
+		}
+		st_free(path);
+	}
+
+	mutex_lock(&smtp_queue.lock);
+
+	if (remove) {
+		inx_delete(smtp_queue.entries, key);
+	}
+	else {
+		entry->active = false;
+	}
+
+	mutex_unlock(&smtp_queue.lock);
+
+	return;
+}
+
+/**
+ * @brief	Count the delivery batches running for a destination.
+ * @note	The caller must hold the queue lock.
+ * @param	destination		a managed string containing the destination domain.
+ * @return	the number of batches running for the destination.
+ */
+static uint32_t smtp_queue_running(stringer_t *destination) {
+
+	uint32_t result = 0;
+
+	for (smtp_queue_batch_t *batch = smtp_queue.batches; batch; batch = batch->next) {
+		if (!st_cmp_ci_eq(batch->destination, destination)) {
+			result++;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * @brief	Deliver a batch of queued messages over a single relay connection. This function is executed by the worker threads.
+ * @note	If the relay can't be reached, the rest of the batch is deferred without being attempted. Once the batch finishes, the
+ * 			scheduler is run again, so any messages waiting on the concurrency limits are picked up right away.
+ * @param	batch	a pointer to the delivery batch.
+ * @return	This function returns no value.
+ */
+static void smtp_queue_deliver(smtp_queue_batch_t *batch) {
+
+	int_t state;
+	bool_t reachable = true;
+	client_t *client = NULL;
+	smtp_queue_batch_t **holder;
+	smtp_recipients_t *recipients, *rejected;
+	stringer_t *mailfrom, *message, *reason;
+
+	for (size_t i = 0; i < batch->count; i++) {
+
+		reason = NULL;
+		rejected = NULL;
+
+		if (smtp_queue_read(batch->entries[i]->number, &mailfrom, &recipients, &message) != 1) {
+			state = -3;
+		}
+		// During shutdown the messages are left for the next start.
+		else if (!status()) {
+			state = 0;
+		}
+		else if (!reachable) {
+			state = -1;
+		}
+		else if ((state = smtp_queue_transmit(&client, batch->premium, mailfrom, recipients, message, &rejected)) != 1 && client) {
+
+			if (state == -2) {
+				reason = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, &(client->line));
+			}
+
+			// The connection was left in the middle of a transaction, so it's closed, rather than being reused.
+			smtp_client_close(client);
+			client = NULL;
+		}
+
+		if (state == -1) {
+			reachable = false;
+		}
+
+		smtp_queue_finish(batch->entries[i], state, mailfrom, recipients, rejected, message, reason);
+
+		smtp_free_recipients(recipients);
+		st_cleanup(mailfrom);
+		st_cleanup(message);
+		st_cleanup(reason);
+	}
+
+	if (client) {
+		smtp_client_close(client);
+	}
+
+	mutex_lock(&smtp_queue.lock);
+
+	for (holder = &(smtp_queue.batches); *holder; holder = &((*holder)->next)) {
+		if (*holder == batch) {
+			*holder = batch->next;
+			break;
+		}
+	}
+
+	mutex_unlock(&smtp_queue.lock);
+
+	st_free(batch->destination);
+	mm_free(batch);
+
+	smtp_queue_schedule();
+
+	return;
+}
+
+/**
+ * @brief	Hand the queued messages which are due for delivery to the worker threads.
+ * @note	Messages are grouped into batches which share a destination domain and relay class, so they can be delivered over the same
+ * 			relay connection. The number of batches is limited overall, and for each destination, so a busy or unavailable destination
+ * 			can't occupy all of the worker threads.
+ * @return	This function returns no value.
+ */
+void smtp_queue_schedule(void) {
+
+	uint32_t running = 0;
+	time_t now = time(NULL);
+	inx_cursor_t *cursor;
+	smtp_queue_entry_t *entry;
+	smtp_queue_batch_t *batch;
+
+	mutex_lock(&smtp_queue.lock);
+
+	for (batch = smtp_queue.batches; batch; batch = batch->next) {
+		running++;
+	}
+
+	while (smtp_queue.running && status() && running < magma.relay.queue.workers && (cursor = inx_cursor_alloc(smtp_queue.entries))) {
+
+		batch = NULL;
+
+		while ((entry = inx_cursor_value_next(cursor))) {
+
+			if (entry->active || entry->next > now) {
+				continue;
+			}
+			else if (!batch && smtp_queue_running(entry->destination) < magma.relay.queue.concurrency) {
+
+				if (!(batch = mm_alloc(sizeof(smtp_queue_batch_t) + (sizeof(smtp_queue_entry_t *) * magma.relay.queue.batch))) ||
+					!(batch->destination = st_dupe(entry->destination))) {
+					log_pedantic("Unable to allocate a queue delivery batch.");
+					mm_cleanup(batch);
+					batch = NULL;
+					break;
+				}
+
+				batch->premium = entry->premium;
+				batch->entries = (smtp_queue_entry_t **)((chr_t *)batch + sizeof(smtp_queue_batch_t));
+			}
+			else if (!batch || entry->premium != batch->premium || st_cmp_ci_eq(entry->destination, batch->destination)) {
+				continue;
+			}
+
+			entry->active = true;
+			batch->entries[batch->count++] = entry;
+
+			if (batch->count == magma.relay.queue.batch) {
+				break;
+			}
+		}
+
+		inx_cursor_free(cursor);
+
+		if (!batch) {
+			break;
+		}
+
+		batch->next = smtp_queue.batches;
+		smtp_queue.batches = batch;
+		running++;
+
+		enqueue(&smtp_queue_deliver, batch);
+	}
+
+	mutex_unlock(&smtp_queue.lock);
+
+	return;
+}
+
+/**
+ * @brief	Queue an outbound message for delivery.
+ * @note	If the queue isn't running, because it has been disabled, or the server is shutting down, the message is relayed right away,
+ * 			and any recipients the relay refused individually are returned to the sender, while the rest receive the message.
+ * @param	premium		set if the message should be delivered using a premium relay.
+ * @param	mailfrom	a managed string containing the return path, which may be NULL for the null sender.
+ * @param	recipients	the list of recipients.
+ * @param	message		a managed string containing the message, which hasn't been dot stuffed.
+ * @param	response	an optional pointer to receive the response of the relay, if the message was relayed right away, which must be freed
+ * 						by the caller. If the message was queued, the pointer is set to NULL.
+ * @return	-2 if the relay rejected the message, -1 on failure, or 1 if the message was queued or relayed.
+ */
+int_t smtp_queue_message(int_t premium, stringer_t *mailfrom, smtp_recipients_t *recipients, stringer_t *message, stringer_t **response) {
+
+	int_t state;
+	uint64_t number;
+	struct timeval now;
+	client_t *client = NULL;
+	stringer_t *path = NULL;
+	smtp_queue_entry_t *entry;
+	smtp_recipients_t *rejected = NULL;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (response) {
+		*response = NULL;
+	}
+
+	if (!recipients || st_empty(message)) {
+		log_pedantic("Passed an invalid message.");
+		return -1;
+	}
+
+	mutex_lock(&smtp_queue.lock);
+
+	// Each message is numbered using the current time in microseconds, bumped forward if necessary, so the numbers are always unique.
+	if (smtp_queue.running && !gettimeofday(&now, NULL)) {
+		number = smtp_queue.last = MAX(((uint64_t)now.tv_sec * 1000000) + now.tv_usec, smtp_queue.last + 1);
+		smtp_queue.writers++;
+	}
+	else {
+		number = 0;
+	}
+
+	mutex_unlock(&smtp_queue.lock);
+
+	if (!number) {
+
+		state = smtp_queue_transmit(&client, premium, mailfrom, recipients, message, &rejected);
+
+		if (client && response) {
+			*response = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, &(client->line));
+		}
+
+		if (client) {
+			smtp_client_close(client);
+		}
+
+		if (state == 1 && rejected) {
+			smtp_queue_notify(mailfrom, rejected, message, PLACER("The mail relay refused the message for one or more recipients.", 62));
+		}
+
+		smtp_free_recipients(rejected);
+
+		return state == 1 ? 1 : (state == -2 ? -2 : -1);
+	}
+
+	if (!(entry = mm_alloc(sizeof(smtp_queue_entry_t))) || !(entry->destination = smtp_queue_destination(recipients->address))) {
+		log_pedantic("Unable to allocate a queue entry.");
+		smtp_queue_entry_free(entry);
+		entry = NULL;
+	}
+	else if (!smtp_queue_write(number, premium, mailfrom, recipients, message)) {
+		smtp_queue_entry_free(entry);
+		entry = NULL;
+	}
+	else {
+		key.val.u64 = entry->number = number;
+		entry->premium = premium ? 1 : 0;
+		entry->next = time(NULL);
+	}
+
+	mutex_lock(&smtp_queue.lock);
+
+	// If the message was written, but couldn't be indexed, because the queue was stopped or the insert failed, the file is removed
+	// and the failure reported, so the client retries, rather than being told the message was accepted.
+	if (entry && (!smtp_queue.running || !inx_insert(smtp_queue.entries, key, entry))) {
+		path = smtp_queue_file(number, false);
+		smtp_queue_entry_free(entry);
+		entry = NULL;
+	}
+
+	smtp_queue.writers--;
+	mutex_unlock(&smtp_queue.lock);
+
+	if (path) {
+		unlink(st_char_get(path));
+		st_free(path);
+	}
+
+	if (!entry) {
+		return -1;
+	}
+
+	stats_increment_by_name("smtp.queue.queued");
+
+	smtp_queue_schedule();
+
+	return 1;
+}
+
+/**
+ * @brief	Get the number of messages waiting in the outbound queue.
+ * @return	the number of queued messages.
+ */
+uint64_t smtp_queue_depth(void) {
+
+	uint64_t result = 0;
+
+	mutex_lock(&smtp_queue.lock);
+	if (smtp_queue.entries) result = inx_count(smtp_queue.entries);
+	mutex_unlock(&smtp_queue.lock);
+
+	return result;
+}
+
+/**
+ * @brief	Get the age of the oldest message waiting in the outbound queue.
+ * @return	the number of seconds since the oldest queued message was queued, or 0 if the queue is empty.
+ */
+uint64_t smtp_queue_age(void) {
+
+	uint64_t result = 0;
+	inx_cursor_t *cursor;
+	smtp_queue_entry_t *entry;
+
+	mutex_lock(&smtp_queue.lock);
+
+	// The index is ordered by number, so the first entry is always the oldest.
+	if (smtp_queue.entries && (cursor = inx_cursor_alloc(smtp_queue.entries))) {
+
+		if ((entry = inx_cursor_value_next(cursor)) && (time_t)(entry->number / 1000000) < time(NULL)) {
+			result = time(NULL) - (entry->number / 1000000);
+		}
+
+		inx_cursor_free(cursor);
+	}
+
+	mutex_unlock(&smtp_queue.lock);
+
+	return result;
+}
+
+/**
+ * @brief	Load the messages left in the queue spool by a previous run.
+ * @note	Hidden files are messages which were still being written, and are removed.
+ * @return	true on success, or false if the queue spool couldn't be read.
+ */
+static bool_t smtp_queue_load(void) {
+
+	int fd;
+	DIR *directory;
+	ssize_t length;
+	struct dirent *file;
+	int_t premium;
+	uint32_t attempts;
+	smtp_queue_entry_t *entry;
+	smtp_recipients_t *recipients;
+	stringer_t *path, *mailfrom, *head = MANAGEDBUF(SMTP_QUEUE_HEAD_LENGTH);
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
+
+	if (!(directory = opendir(st_char_get(smtp_queue.path)))) {
+		log_critical("Unable to open the outbound queue spool. {errno = %i / path = %.*s}", errno, st_length_int(smtp_queue.path),
+			st_char_get(smtp_queue.path));
+		return false;
+	}
+
+	while ((file = readdir(directory))) {
+
+		if (*(file->d_name) == '.' && strcmp(file->d_name, ".") && strcmp(file->d_name, "..") &&
+			(path = st_aprint("%.*s%s", st_length_int(smtp_queue.path), st_char_get(smtp_queue.path), file->d_name))) {
+			unlink(st_char_get(path));
+			st_free(path);
+			continue;
+		}
+		else if (!chr_numeric(*(file->d_name)) || !(key.val.u64 = strtoull(file->d_name, NULL, 10))) {
+			continue;
+		}
+		else if (!(path = smtp_queue_file(key.val.u64, false))) {
+			continue;
+		}
+
+		if ((fd = open(st_char_get(path), O_RDONLY | O_NOATIME)) == -1 || (length = read(fd, st_char_get(head), SMTP_QUEUE_HEAD_LENGTH)) <= 0) {
+			log_error("Unable to read a queued message. {errno = %i / path = %.*s}", errno, st_length_int(path), st_char_get(path));
+			if (fd != -1) close(fd);
+			st_free(path);
+			continue;
+		}
+
+		close(fd);
+		st_length_set(head, length);
+
+		// Only the first recipient is needed here, so an envelope which doesn't fit in the buffer is acceptable.
+		if (smtp_queue_parse(head, &attempts, &premium, &mailfrom, &recipients) < 0 || !recipients ||
+			!(entry = mm_alloc(sizeof(smtp_queue_entry_t)))) {
+			log_error("A queued message is invalid. {path = %.*s}", st_length_int(path), st_char_get(path));
+			smtp_free_recipients(recipients);
+			st_cleanup(mailfrom);
+			st_free(path);
+			continue;
+		}
+
+		entry->number = key.val.u64;
+		entry->premium = premium;
+		entry->attempts = attempts;
+		entry->next = time(NULL);
+
+		if (!(entry->destination = smtp_queue_destination(recipients->address)) || !inx_insert(smtp_queue.entries, key, entry)) {
+			smtp_queue_entry_free(entry);
+		}
+		else {
+			smtp_queue.last = MAX(smtp_queue.last, key.val.u64);
+		}
+
+		smtp_free_recipients(recipients);
+		st_cleanup(mailfrom);
+		st_free(path);
+	}
+
+	closedir(directory);
+
+	if (inx_count(smtp_queue.entries)) {
+		log_info("Messages found in the outbound queue will be delivered. {count = %lu}", inx_count(smtp_queue.entries));
+	}
+
+	return true;
+}
+
+/**
+ * @brief	The queue thread entry point, which hands the messages to the worker threads as their retry intervals expire.
+ * @return	This function returns no value.
+ */
+static void smtp_queue_thread(void) {
+
+	thread_start();
+
+	while (status() && smtp_queue.running) {
+		smtp_queue_schedule();
+		sleep(1);
+	}
+
+	thread_stop();
+	pthread_exit(NULL);
+	return;
+}
+
+/**
+ * @brief	Load the outbound queue from the spool, and launch the queue thread.
+ * @note	If the queue has been disabled, this function does nothing, and outbound messages are relayed right away.
+ * @return	true on success, or false on failure.
+ */
+bool_t smtp_queue_start(void) {
+
+	if (!magma.relay.queue.enable) {
+		return true;
+	}
+	else if (!(smtp_queue.path = spool_path(MAGMA_SPOOL_QUEUE)) || spool_check(smtp_queue.path) < 0) {
+		log_critical("Unable to access the outbound queue spool.");
+		smtp_queue_stop();
+		return false;
+	}
+	else if (!(smtp_queue.entries = inx_alloc(M_INX_TREE | M_INX_LOCK_MANUAL, &smtp_queue_entry_free))) {
+		log_critical("Unable to allocate the outbound queue index.");
+		smtp_queue_stop();
+		return false;
+	}
+	else if (!smtp_queue_load()) {
+		smtp_queue_stop();
+		return false;
+	}
+
+	smtp_queue.running = true;
+
+	if (!(smtp_queue.thread = thread_alloc(smtp_queue_thread, NULL))) {
+		log_critical("Unable to launch the outbound queue thread.");
+		smtp_queue_stop();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Stop the outbound queue thread, wait for the delivery batches and spool writes to finish, and release the queue index.
+ * @note	This must run before the worker queue is shutdown, since the delivery batches are run by the worker threads. Any messages
+ * 			which are still queued remain in the spool, and are loaded again the next time the queue is started.
+ * @return	This function returns no value.
+ */
+void smtp_queue_stop(void) {
+
+	mutex_lock(&smtp_queue.lock);
+	smtp_queue.running = false;
+	mutex_unlock(&smtp_queue.lock);
+
+	if (smtp_queue.thread) {
+		thread_join(*smtp_queue.thread);
+		mm_free(smtp_queue.thread);
+		smtp_queue.thread = NULL;
+	}
+
+	mutex_lock(&smtp_queue.lock);
+
+	while (smtp_queue.batches || smtp_queue.writers) {
+		mutex_unlock(&smtp_queue.lock);
+		usleep(1000);
+		mutex_lock(&smtp_queue.lock);
+	}
+
+	if (smtp_queue.entries) {
+		inx_free(smtp_queue.entries);
+		smtp_queue.entries = NULL;
+	}
+
+	mutex_unlock(&smtp_queue.lock);
+
+	st_cleanup(smtp_queue.path);
+	smtp_queue.path = NULL;
+
+	return;
+}
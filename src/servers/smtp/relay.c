@@ -3,16 +3,18 @@
  * @file /magma/servers/smtp/relay.c
  *
  * @brief	Functions to relay messages via SMTP to the outbound mail server.
+ * @note	Connections are pooled per relay. A connection which completes a transaction is returned to its relay's pool when it's closed,
+ * 			and handed out again by smtp_client_connect(), already greeted, so subsequent messages skip the TCP and TLS handshakes.
  */
 
 #include "magma.h"
 
 /**
- * @brief	Issue an smtp client QUIT command.
+ * @brief	Issue an smtp client QUIT command, and close the connection.
  * @param	client	 a pointer to the smtp client session to be closed.
  * @return	This function returns no value.
  */
-void smtp_client_close(client_t *client) {
+static void smtp_client_quit(client_t *client) {
 
 	if (client_write(client, PLACER("QUIT\r\n", 6)) >= 0) {
 		client_read_line(client);
@@ -24,55 +26,169 @@ void smtp_client_close(client_t *client) {
 }
 
 /**
- * @brief	Connect to a randomly selected mail relay server, and wait for a successful banner message.
- * @param	premium		if set, a premium relay will be selected instead of a standard one.
- * @return	NULL on failure or a pointer to the newly established network client object connected to a mail relay on success.
+ * @brief	Check whether a pooled relay connection is still usable.
+ * @note	An idle relay shouldn't send anything, so a closed socket, or unsolicited data like a timeout notice, disqualifies the
+ * 			connection without a round trip. Connections idle for longer than SMTP_CLIENT_POOL_VERIFY seconds are also sent a NOOP,
+ * 			which catches connections silently dropped somewhere along the network path.
+ * @param	client	a pointer to the pooled connection.
+ * @return	true if the connection can be reused, otherwise false.
  */
-client_t * smtp_client_connect(int_t premium) {
+static bool_t smtp_client_pool_check(client_t *client) {
+
+	chr_t byte;
+	ssize_t peek;
+
+	errno = 0;
+
+	if ((peek = recv(client->sockd, &byte, 1, MSG_PEEK | MSG_DONTWAIT | MSG_NOSIGNAL)) >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+		return false;
+	}
+	else if (time(NULL) - client->smtp.released >= SMTP_CLIENT_POOL_VERIFY && (client_write(client, PLACER("NOOP\r\n", 6)) != 6 ||
+		client_read_line(client) <= 0 || !pl_starts_with_char(client->line, '2'))) {
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief	Take the most recently used connection out of a relay's pool, discarding any which have expired along the way.
+ * @param	relay	a pointer to the relay.
+ * @return	NULL if the pool is empty, or a pointer to a connection which is ready to start a new transaction.
+ */
+static client_t * smtp_client_pool_get(relay_t *relay) {
 
-	uint32_t num = 0;
 	client_t *client;
-	relay_t *relay = NULL;
 
-	// If the premium flag is set, pick a random premium relay.
-	if (premium && magma.relay.count.premium) {
-		num = (rand_get_uint32() % magma.relay.count.premium);
+	do {
 
-		for (uint32_t i = 0; !relay && i < MAGMA_RELAY_INSTANCES; i++) {
+		mutex_lock(&(relay->lock));
 
-			if (magma.relay.host[i] && magma.relay.host[i]->premium && !num) {
-					relay = magma.relay.host[i];
-			}
-			else if (magma.relay.host[i] && magma.relay.host[i]->premium) {
-				num--;
-			}
+		if ((client = relay->pool)) {
+			relay->pool = client->smtp.next;
+			relay->idle--;
+		}
+
+		mutex_unlock(&(relay->lock));
 
+		if (client && time(NULL) - client->smtp.released < magma.relay.pool.timeout && smtp_client_pool_check(client)) {
+			stats_increment_by_name("smtp.relay.reused");
+			client->smtp.next = NULL;
+			return client;
+		}
+		// The relay has probably given up on the connection already, so there's no point in saying goodbye.
+		else if (client) {
+			client_close(client);
+		}
+
+	} while (client);
+
+	return NULL;
+}
+
+/**
+ * @brief	Close the connections waiting in the relay pools.
+ * @note	This function should only be called during the shutdown process, after the worker threads have finished.
+ * @return	This function returns no value.
+ */
+void smtp_client_pool_stop(void) {
+
+	client_t *client;
+
+	for (uint32_t i = 0; i < MAGMA_RELAY_INSTANCES; i++) {
+
+		while (magma.relay.host[i] && (client = magma.relay.host[i]->pool)) {
+			magma.relay.host[i]->pool = client->smtp.next;
+			magma.relay.host[i]->idle--;
+			smtp_client_quit(client);
 		}
 
 	}
 
-	// Otherwise, if no premium relays are defined, or premium is zero, pick a standard relay.
-	else {
-		num = (rand_get_uint32() % magma.relay.count.standard);
+	return;
+}
 
-		for (uint32_t i = 0; !relay && i < MAGMA_RELAY_INSTANCES; i++) {
+/**
+ * @brief	Release a connection opened by smtp_client_connect().
+ * @note	Connections which completed their last transaction are returned to their relay's pool, unless the pool is full or the
+ * 			connection has reached the reuse limit. Otherwise a QUIT command is issued and the connection is closed.
+ * @param	client	 a pointer to the smtp client session to be released.
+ * @return	This function returns no value.
+ */
+void smtp_client_close(client_t *client) {
 
-			if (magma.relay.host[i] && !magma.relay.host[i]->premium && !num) {
-					relay = magma.relay.host[i];
-			}
-			else if (magma.relay.host[i] && !magma.relay.host[i]->premium) {
-				num--;
-			}
+	relay_t *relay;
+
+	if (!client) {
+		return;
+	}
+	else if (!(relay = client->smtp.relay)) {
+		smtp_client_quit(client);
+		return;
+	}
+
+	mutex_lock(&(relay->lock));
+
+	relay->active--;
+
+	if ((client->smtp.state & SMTP_CLIENT_FINISHED) && client->smtp.messages < magma.relay.pool.messages &&
+		relay->idle < magma.relay.pool.connections && status()) {
+		client->smtp.released = time(NULL);
+		client->smtp.next = relay->pool;
+		relay->pool = client;
+		relay->idle++;
+		client = NULL;
+	}
+
+	mutex_unlock(&(relay->lock));
+
+	if (client) {
+		smtp_client_quit(client);
+	}
+
+	return;
+}
+
+/**
+ * @brief	Select the least loaded relay of the requested class, and count the connection against it.
+ * @note	Relays are examined starting from a random position, so relays carrying the same load share new connections evenly. A relay
+ * 			with idle connections in its pool is preferred over an equally loaded relay without any.
+ * @param	premium		if set, a premium relay will be selected instead of a standard one, provided any premium relays are defined.
+ * @return	NULL if no suitable relay is configured, or a pointer to the selected relay.
+ */
+static relay_t * smtp_client_select(int_t premium) {
+
+	relay_t *relay = NULL, *candidate;
+	uint32_t offset = rand_get_uint32() % MAGMA_RELAY_INSTANCES;
+	bool_t class = (premium && magma.relay.count.premium ? true : false);
+
+	for (uint32_t i = 0; i < MAGMA_RELAY_INSTANCES; i++) {
 
+		if ((candidate = magma.relay.host[(offset + i) % MAGMA_RELAY_INSTANCES]) && candidate->premium == class && (!relay ||
+			candidate->active < relay->active || (candidate->active == relay->active && candidate->idle > relay->idle))) {
+			relay = candidate;
 		}
 
 	}
 
-	if (!relay) {
-		log_pedantic("Unable to find a suitable mail relay to connect to.");
-		return NULL;
+	if (relay) {
+		mutex_lock(&(relay->lock));
+		relay->active++;
+		mutex_unlock(&(relay->lock));
 	}
 
+	return relay;
+}
+
+/**
+ * @brief	Open a new connection to a mail relay, and wait for a successful banner message.
+ * @param	relay	a pointer to the relay.
+ * @return	NULL on failure or a pointer to the newly established network client object on success.
+ */
+static client_t * smtp_client_open(relay_t *relay) {
+
+	client_t *client;
+
 	// Connect
 	if (!(client = client_connect(relay->name, relay->port))) {
 		log_pedantic("Unable to establish a network connection with the mail relay. {host = %s:%u}", relay->name, relay->port);
@@ -80,7 +196,7 @@ client_t * smtp_client_connect(int_t premium) {
 	}
 
 	// If a valid timeout was provided.
-	if (!magma.relay.timeout) {
+	if (magma.relay.timeout) {
 		net_set_timeout(client->sockd, magma.relay.timeout, magma.relay.timeout);
 	}
 
@@ -99,11 +215,43 @@ client_t * smtp_client_connect(int_t premium) {
 		return NULL;
 	}
 
+	stats_increment_by_name("smtp.relay.connected");
+
+	return client;
+}
+
+/**
+ * @brief	Connect to the least loaded mail relay, reusing a pooled connection when one is available.
+ * @note	Connections taken from the pool have already been greeted, in which case smtp_client_send_helo() returns immediately.
+ * 			The connection must be released using smtp_client_close().
+ * @param	premium		if set, a premium relay will be selected instead of a standard one.
+ * @return	NULL on failure or a pointer to the network client object connected to a mail relay on success.
+ */
+client_t * smtp_client_connect(int_t premium) {
+
+	client_t *client;
+	relay_t *relay = NULL;
+
+	if (!(relay = smtp_client_select(premium))) {
+		log_pedantic("Unable to find a suitable mail relay to connect to.");
+		return NULL;
+	}
+
+	if (!(client = smtp_client_pool_get(relay)) && !(client = smtp_client_open(relay))) {
+		mutex_lock(&(relay->lock));
+		relay->active--;
+		mutex_unlock(&(relay->lock));
+		return NULL;
+	}
+
+	client->smtp.relay = relay;
+
 	return client;
 }
 
 /**
  * @brief	Issue a EHLO command to an smtp server, or fall back to HELO, and wait for a successful response.
+ * @note	Connections which have already been greeted, because they came from the pool, aren't greeted again.
  * @param	client	a pointer to the network client to issue the remote command.
  * @return	-1 on failure or 1 on success.
  */
@@ -111,6 +259,10 @@ int_t smtp_client_send_helo(client_t *client) {
 
 	int_t state;
 
+	if (client->smtp.state & SMTP_CLIENT_GREETED) {
+		return 1;
+	}
+
 	client_print(client, "EHLO %s\r\n", magma.host.name);
 
 	if ((client_read_line(client)) <= 0) {
@@ -134,6 +286,12 @@ int_t smtp_client_send_helo(client_t *client) {
 
 		do {
 
+			// Note whether the server will accept a batch of commands without waiting for each response.
+			if (st_length_get(&(client->line)) >= 14 && !st_cmp_ci_starts(PLACER(st_char_get(client->buffer) + 4,
+				st_length_get(&(client->line)) - 4), PLACER("PIPELINING", 10))) {
+				client->smtp.state |= SMTP_CLIENT_PIPELINING;
+			}
+
 			if (st_length_get(&(client->line)) < 4 || *(st_char_get(client->buffer) + 3) == ' ') {
 				state = 0;
 			}
@@ -147,6 +305,8 @@ int_t smtp_client_send_helo(client_t *client) {
 
 	}
 
+	client->smtp.state |= SMTP_CLIENT_GREETED;
+
 	return 1;
 }
 
@@ -159,6 +319,8 @@ int_t smtp_client_send_helo(client_t *client) {
  */
 int_t smtp_client_send_mailfrom(client_t *client, stringer_t *mailfrom, size_t send_size) {
 
+	client->smtp.state &= ~SMTP_CLIENT_FINISHED;
+
 	/// LOW: Technically we should only be sending the size parameter if the EHLO response indicates support.
 	if (!send_size) {
 		client_print(client, "MAIL FROM: <%.*s>\r\n", st_length_get(mailfrom), st_char_get(mailfrom));
@@ -187,6 +349,7 @@ int_t smtp_client_send_mailfrom(client_t *client, stringer_t *mailfrom, size_t s
  */
 int_t smtp_client_send_nullfrom(client_t *client) {
 
+	client->smtp.state &= ~SMTP_CLIENT_FINISHED;
 	client_print(client, "MAIL FROM: <>\r\n");
 
 	if (client_read_line(client) <= 0) {
@@ -225,6 +388,155 @@ int_t smtp_client_send_rcptto(client_t *client, stringer_t *rcptto) {
 	return 1;
 }
 
+/**
+ * @brief	Record a recipient the relay refused, along with the refusal, at the end of a list of rejected recipients.
+ * @param	client		a pointer to the network client, which holds the refusal in its current line.
+ * @param	rejected	the address of the list of rejected recipients.
+ * @param	address		a managed string containing the refused recipient address.
+ * @return	true on success, or false if the recipient couldn't be recorded.
+ */
+static bool_t smtp_client_rejected(client_t *client, smtp_recipients_t **rejected, stringer_t *address) {
+
+	smtp_recipients_t *holder, **tail;
+	size_t length = pl_length_get(client->line);
+
+	// The refusal is stored without its line terminator.
+	while (length && (*(pl_char_get(client->line) + length - 1) == '\r' || *(pl_char_get(client->line) + length - 1) == '\n')) {
+		length--;
+	}
+
+	if (!(holder = mm_alloc(sizeof(smtp_recipients_t))) || !(holder->address = st_dupe(address)) ||
+		!(holder->response = st_import(pl_char_get(client->line), length))) {
+		log_pedantic("Unable to record a rejected recipient.");
+		smtp_free_recipients(holder);
+		return false;
+	}
+
+	for (tail = rejected; *tail; tail = (smtp_recipients_t **)&((*tail)->next));
+	*tail = holder;
+
+	return true;
+}
+
+/**
+ * @brief	Issue a MAIL FROM command, followed by a RCPT TO command for each recipient, and wait for the responses.
+ * @note	If the relay advertised the PIPELINING extension, the commands are written together and the responses read afterward,
+ * 			so the whole envelope costs a single round trip. Otherwise the commands are issued one at a time. A refused recipient
+ * 			doesn't end the transaction, so the message can still be sent to the recipients the relay accepted.
+ * @param	client		a pointer to the network client to issue the commands.
+ * @param	mailfrom	a pointer to a managed string containing the address parameter for the MAIL FROM command.
+ * @param	recipients	a pointer to the list of recipients, each of which is sent a RCPT TO command.
+ * @param	rejected	a pointer to receive a list of the recipients the relay refused, each holding the refusal in its response, which
+ * 						must be freed by the caller. The list is only returned alongside a result of 1, or a result of -2 which was
+ * 						caused by every recipient being refused, and is otherwise set to NULL.
+ * @return	-2 if the remote server rejected the MAIL FROM command, or every recipient, in which case the last rejection is left in the
+ * 			client line, -1 on general network failure, or 1 if at least one recipient was accepted.
+ */
+int_t smtp_client_send_envelope(client_t *client, stringer_t *mailfrom, smtp_recipients_t *recipients, smtp_recipients_t **rejected) {
+
+	int_t state;
+	chr_t *writer;
+	stringer_t *commands;
+	smtp_recipients_t *holder;
+	size_t length, accepted = 0, responses = 1;
+
+	*rejected = NULL;
+
+	if (!(client->smtp.state & SMTP_CLIENT_PIPELINING)) {
+
+		if ((state = smtp_client_send_mailfrom(client, mailfrom, 0)) != 1) {
+			return state;
+		}
+
+		for (holder = recipients; holder; holder = (smtp_recipients_t *)holder->next) {
+
+			if ((state = smtp_client_send_rcptto(client, holder->address)) == 1) {
+				accepted++;
+			}
+			else if (state != -2 || !smtp_client_rejected(client, rejected, holder->address)) {
+				smtp_free_recipients(*rejected);
+				*rejected = NULL;
+				return -1;
+			}
+
+		}
+
+		return accepted ? 1 : -2;
+	}
+
+	client->smtp.state &= ~SMTP_CLIENT_FINISHED;
+
+	// Add up the space needed, including the terminating null written by snprintf(), so the commands can be written in one call.
+	length = st_length_get(mailfrom) + 15 + 1;
+
+	for (holder = recipients; holder; holder = (smtp_recipients_t *)holder->next) {
+		length += st_length_get(holder->address) + 13;
+	}
+
+	if (!(commands = st_alloc(length))) {
+		log_pedantic("Unable to allocate a buffer for the pipelined envelope commands.");
+		return -1;
+	}
+
+	writer = st_char_get(commands);
+	writer += snprintf(writer, length, "MAIL FROM: <%.*s>\r\n", st_length_int(mailfrom), st_char_get(mailfrom));
+
+	for (holder = recipients; holder; holder = (smtp_recipients_t *)holder->next) {
+		writer += snprintf(writer, length - (writer - st_char_get(commands)), "RCPT TO: <%.*s>\r\n", st_length_int(holder->address),
+			st_char_get(holder->address));
+		responses++;
+	}
+
+	st_length_set(commands, writer - st_char_get(commands));
+
+	if (client_write(client, commands) != st_length_get(commands)) {
+		log_pedantic("An error occurred while attempting to send the pipelined envelope commands.");
+		st_free(commands);
+		return -1;
+	}
+
+	st_free(commands);
+
+	// The responses arrive in the same order as the commands, so the first belongs to the MAIL FROM command, and the rest are matched
+	// to the recipients as they're read.
+	holder = recipients;
+
+	for (size_t i = 0; i < responses; i++) {
+
+		if (client_read_line(client) <= 0) {
+			log_pedantic("An error occurred while attempting to read the pipelined envelope responses.");
+			smtp_free_recipients(*rejected);
+			*rejected = NULL;
+			return -1;
+		}
+		else if (!i && *(st_char_get(client->buffer)) != '2') {
+			log_pedantic("The mail relay rejected a pipelined MAIL FROM command. {mailfrom = %.*s / response = %.*s}",
+				st_length_int(mailfrom), st_char_get(mailfrom), st_length_int(&(client->line)), st_char_get(&(client->line)));
+			return -2;
+		}
+		else if (i) {
+
+			if (*(st_char_get(client->buffer)) == '2') {
+				accepted++;
+			}
+			else if (!smtp_client_rejected(client, rejected, holder->address)) {
+				smtp_free_recipients(*rejected);
+				*rejected = NULL;
+				return -1;
+			}
+			else {
+				log_pedantic("The mail relay rejected a pipelined RCPT TO command. {rcptto = %.*s / response = %.*s}",
+					st_length_int(holder->address), st_char_get(holder->address), st_length_int(&(client->line)), st_char_get(&(client->line)));
+			}
+
+			holder = (smtp_recipients_t *)holder->next;
+		}
+
+	}
+
+	return accepted ? 1 : -2;
+}
+
 /**
  * @brief	Issue a DATA command to an smtp server, and wait for a successful response.
  * @param	client		a pointer to the network client to issue the DATA command.
@@ -294,5 +606,9 @@ int_t smtp_client_send_data(client_t *client, stringer_t *message, bool_t dotstu
 		return (sent != 3 || line <= 0 ? -1 : -2);
 	}
 
+	// The transaction is complete, so the connection can be reused.
+	client->smtp.state |= SMTP_CLIENT_FINISHED;
+	client->smtp.messages++;
+
 	return 1;
 }
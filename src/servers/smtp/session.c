@@ -17,6 +17,9 @@ void smtp_session_reset(connection_t *con) {
 	st_cleanup(con->smtp.mailfrom);
 	con->smtp.mailfrom = NULL;
 
+	st_cleanup(con->smtp.chunks);
+	con->smtp.chunks = NULL;
+
 	if (con->smtp.message) {
 		mail_destroy_message(con->smtp.message);
 		con->smtp.message = NULL;
@@ -43,6 +46,7 @@ void smtp_session_reset(connection_t *con) {
 	con->smtp.checked.virus = 0;
 
 	con->smtp.suggested_eight_bit = false;
+	con->smtp.suggested_binary = false;
 	con->smtp.suggested_length = 0;
 	con->smtp.num_recipients = 0;
 
@@ -57,6 +61,7 @@ void smtp_session_reset(connection_t *con) {
 void smtp_session_destroy(connection_t *con) {
 
 	st_cleanup(con->smtp.helo);
+	st_cleanup(con->smtp.chunks);
 	st_cleanup(con->smtp.mailfrom);
 
 	if (con->smtp.message) {
@@ -194,6 +199,7 @@ void smtp_free_recipients(smtp_recipients_t *recipients) {
 
 	while (recipients) {
 		st_cleanup(recipients->address);
+		st_cleanup(recipients->response);
 		holder = recipients;
 		recipients = (smtp_recipients_t *)holder->next;
 		mm_free(holder);
@@ -110,7 +110,8 @@ void smtp_ehlo(connection_t *con) {
 	con->smtp.esmtp = true;
 
 	// If the user is connected via SSL already, or there is no SSL context, omit the STARTTLS parameter.
-	con_print(con, "250-%.*s\r\n250-8BITMIME\r\n%s250-PIPELINING\r\n250-SIZE %lu\r\n250-AUTH LOGIN PLAIN\r\n250-AUTH=LOGIN PLAIN\r\n250 EHLO COMPLETE\r\n",
+	con_print(con, "250-%.*s\r\n250-8BITMIME\r\n250-BINARYMIME\r\n250-CHUNKING\r\n%s250-PIPELINING\r\n250-SIZE %lu\r\n250-AUTH LOGIN PLAIN\r\n" \
+		"250-AUTH=LOGIN PLAIN\r\n250 EHLO COMPLETE\r\n",
 		st_length_int(con->server->domain), st_char_get(con->server->domain), (con_secure(con) != 0 ? "" : "250-STARTTLS\r\n"),
 		magma.smtp.message_length_limit);
 
@@ -603,8 +604,8 @@ void smtp_rcpt_to(connection_t *con) {
 		return;
 	}
 
-	// Hit the mailboxes table, and see if this is a legitimate address.
-	state = smtp_fetch_inbound(sanitized, &result);
+	// Check the preferences cache, or hit the mailboxes table, and see if this is a legitimate address.
+	state = smtp_prefs_fetch(sanitized, &result);
 	st_free(sanitized);
 
 	// If the account is locked.
@@ -844,147 +845,186 @@ void smtp_data_finish(connection_t *con, size_t read, int_t checker) {
 	return;
 }
 
+/**
+ * @brief	Read the message sent by an SMTP client after a DATA command, until the terminating dot line.
+ * @note	Instead of stepping through the input one byte at a time, each read is split into lines using memchr(), which the C library
+ * 			implements with vector instructions, and the text between the line breaks is copied in bulk. Only the first byte of each line
+ * 			is inspected, which is where dot stuffing is undone, and the terminating dot line is detected. Bare line feeds are given a carriage
+ * 			return, and non-ASCII characters are dropped from the header. The terminating dot line is not included in the output.
+ *
+ * 			The buffer is sized using the SIZE parameter from the MAIL FROM, when one was provided, so most messages are read without being
+ * 			remapped. Otherwise the buffer starts at 128 KB, and doubles when it runs out of room, up to the size limit for the session.
+ * @param	con		the SMTP client connection sending the message data.
+ * @param	message	the address of a managed string pointer that will receive the message on success, or NULL on failure.
+ * @return	1 on success, -1 if the buffer couldn't be allocated, -2 if the message exceeded the size limit, -3 if the server is shutting down,
+ * 			or -4 if the client disconnected.
+ */
 int_t smtp_data_read(connection_t *con, stringer_t **message) {
 
-	chr_t *stream, *buffer;
+	int64_t read;
+	chr_t *stream, *end, *buffer;
 	stringer_t *result, *holder;
-	int_t read = 0, increment;
-	size_t used = 0, size = 128 * 1024;
-	int_t header = 1, checker = 1, carriage = 0;
+	size_t used = 0, size, position = 0, span, line = 0, slack, needed;
+	int_t header = 1, start = 1, dot = 0, carriage = 0, finished = 0;
 
 	// In case we end early.
 	*message = NULL;
-	stream = st_data_get(con->network.buffer);
 
-	// Expand the stringer in 128 KB chunks.
+	// Leave enough room for a full network buffer, which could double in size if every byte were a bare line feed.
+	slack = (magma.system.network_buffer * 2) + 2;
+
+	if (con->smtp.suggested_length && con->smtp.suggested_length <= con->smtp.max_length) {
+		size = con->smtp.suggested_length + slack;
+	}
+	else {
+		size = 128 * 1024;
+	}
+
 	if (!(result = st_alloc_opts(MAPPED_T | JOINTED | HEAP, size))) {
-		smtp_data_finish(con, 0, checker);
+		smtp_data_finish(con, 0, 1);
 		return -1;
 	}
 
-	// Setup the pointer into the stringer.
 	buffer = st_char_get(result);
-	read = con_read(con);
 
-	while (checker != 4 && read > 0 && status()) {
-
-		// Setup the stream.
-		stream = st_data_get(con->network.buffer);
+	while (!finished && status() && (read = con_read(con)) > 0) {
 
 		// Size check.
 		if ((read + used) > con->smtp.max_length) {
 			log_pedantic("Message exceeded size limit of %zu bytes. Reading till the end, and then returning an error.", con->smtp.max_length);
-			smtp_data_finish(con, read, checker);
+			smtp_data_finish(con, read, dot ? dot + 1 : start);
 			st_free(result);
 			return -2;
 		}
 
-		// Read in the new data.
-		for (increment = 0; checker != 4 && increment < read; increment++) {
+		// Make sure the buffer can hold this read, even if every line feed needs a carriage return.
+		if (used + (read * 2) + 2 > size) {
 
-			// Logic for detecting header mode.
-			if (header != 3) {
-				if (header == 0 && *stream == '\n') {
-					header++;
-				}
-				else if (header == 1 && *stream == '\n') {
-					header += 2;
-				}
-				else if (header == 1 && *stream == '\r') {
-					header++;
+			// Double the buffer, but never beyond what the size limit allows.
+			needed = used + (read * 2) + 2;
+			needed = (size * 2 > needed ? (size * 2 < con->smtp.max_length + slack ? size * 2 : con->smtp.max_length + slack) : needed);
+
+			if (!(holder = st_realloc(result, needed))) {
+				log_pedantic("Attempted to allocate a buffer of %zu bytes to hold an incoming message, and failed. Returning an error to the client.", needed);
+				smtp_data_finish(con, read, dot ? dot + 1 : start);
+				st_free(result);
+				return -1;
+			}
+
+			size = needed;
+			result = holder;
+			buffer = st_char_get(result) + used;
+			stats_increment_by_name("smtp.data.remapped");
+		}
+
+		stream = st_char_get(con->network.buffer);
+		position = 0;
+
+		while (!finished && position < (size_t)read) {
+
+			// A period at the start of a line is held until the next character shows whether it's the terminator, or dot stuffing.
+			if (dot == 1) {
+				if (stream[position] == '\n') {
+					finished = 1;
+					position++;
+					break;
 				}
-				else if (header == 2 && *stream == '\n') {
-					header++;
+				else if (stream[position] == '\r') {
+					dot = 2;
+					position++;
+					continue;
 				}
-				else if (header != 0) {
-					header = 0;
+				else if (stream[position] != '.') {
+					*buffer++ = '.';
+					used++;
+					line++;
 				}
+				dot = 0;
 			}
+			else if (dot == 2) {
+				if (stream[position] == '\n') {
+					finished = 1;
+					position++;
+					break;
+				}
 
-			// Logic for detecting the end of a message.
-			if (checker == 0 && *stream == '\n') {
-				checker++;
-			}
-			else if (checker == 1 && *stream == '.') {
-				checker++;
-			}
-			else if (checker == 2 && *stream == '\n') {
-				checker += 2;
-			}
-			else if (checker == 2 && *stream == '\r') {
-				checker++;
-			}
-			else if (checker == 3 && *stream == '\n') {
-				checker++;
-			}
-			else if (*stream == '\n') {
-				checker = 1;
-			}
-			else if (checker != 0) {
-				checker = 0;
-			}
-
-			// Make sure every line ends with a carriage return, then line break.
-			if (*stream == '\n' && carriage == 0) {
+				*buffer++ = '.';
 				*buffer++ = '\r';
-				used++;
-			}
-			else if (*stream == '\r') {
+				used += 2;
+				line += 2;
 				carriage = 1;
+				dot = 0;
 			}
-			else if (carriage != 0) {
-				carriage = 0;
+			else if (start && stream[position] == '.') {
+				start = 0;
+				dot = 1;
+				position++;
+				continue;
 			}
 
-			// In header mode, we only read in ASCII (0x00 to 0x7F) characters.
-			if (header != 3 && *stream >= 0) {
-				*buffer++ = *stream;
-				used++;
-			}
-			// Otherwise we read in anything.
-			else if (header == 3) {
-				*buffer++ = *stream;
-				used++;
-			}
+			start = 0;
+
+			// Find the end of the line, and copy everything up to it.
+			end = memchr(stream + position, '\n', read - position);
+			span = (end ? end - stream : read) - position;
 
-			// Make sure we have enough room in the buffer.
-			if (used + 32 > size) {
-				if ((holder = st_realloc(result, size + (128 * 1024))) == NULL) {
-					log_pedantic("Attempted to allocate a buffer of %zu bytes to hold an incoming message, and failed. Returning an error to the client.", size + (128 * 1024));
-					smtp_data_finish(con, read, checker);
-					st_free(result);
-					return -1;
+			if (span) {
+
+				// In header mode, we only read in ASCII (0x00 to 0x7F) characters.
+				if (header) {
+					for (size_t i = 0; i < span; i++) {
+						if (stream[position + i] >= 0) {
+							*buffer++ = stream[position + i];
+							used++;
+						}
+					}
+				}
+				else {
+					mm_copy(buffer, stream + position, span);
+					buffer += span;
+					used += span;
 				}
 
-				// Setup the pointers again.
-				size += 128 * 1024;
-				result = holder;
-				buffer = st_char_get(result) + used;
+				carriage = (stream[position + span - 1] == '\r');
+				line += span;
+				position += span;
 			}
 
-			stream++;
-		}
+			// Make sure every line ends with a carriage return, then line break.
+			if (end) {
 
-		if (checker != 4) {
-			read = con_read(con);
+				if (!carriage) {
+					*buffer++ = '\r';
+					used++;
+				}
+
+				*buffer++ = '\n';
+				used++;
+
+				// An empty line marks the end of the header.
+				if (header && (!line || (line == 1 && carriage))) {
+					header = 0;
+				}
+
+				position++;
+				carriage = line = 0;
+				start = 1;
+			}
 		}
 	}
 
 	// The server is shutting down or the client disconnected.
-	if (!status()) {
+	if (!finished && !status()) {
 		st_free(result);
 		return -3;
 	}
-	else if (read <= 0) {
+	else if (!finished) {
 		st_free(result);
 		return -4;
 	}
 
 	// So that read line will get anything left in buffer.
-	if ((stream - st_char_get(con->network.buffer)) < read) {
-		st_data_set(&(con->network.line), st_data_get(con->network.buffer));
-		st_length_set(&(con->network.line), stream - st_char_get(con->network.buffer));
-	}
+	con->network.line = pl_init(st_char_get(con->network.buffer), position);
 
 	// Setup the output.
 	st_length_set(result, used);
@@ -1072,11 +1112,16 @@ void smtp_data_outbound(connection_t *con) {
 		con_write_st(con, holder);
 		st_free(holder);
 	}
-	else if (state > 0) {
+	else if (state > 0 && holder) {
 		con_write_st(con, holder);
 		smtp_update_transmission_stats(con);
 		st_free(holder);
 	}
+	// The message was stored in the outbound queue.
+	else if (state > 0) {
+		con_write_bl(con, "250 MESSAGE QUEUED FOR DELIVERY\r\n", 33);
+		smtp_update_transmission_stats(con);
+	}
 	else {
 		con_write_bl(con, "451 DATA FAILED - UNABLE TO RELAY OUTBOUND MESSAGES AT THIS TIME - PLEASE TRY AGAIN LATER\n\n", 91);
 	}
@@ -1091,6 +1136,9 @@ void smtp_data_inbound(connection_t *con) {
 	smtp_inbound_prefs_t *current;
 	uint32_t perm_errors = 0, temp_errors = 0, delivered = 0, bounces = 0;
 
+	// Run the content checks which only depend on the message up front, and concurrently, so every recipient can share the results.
+	smtp_inspect_message(con);
+
 	current = con->smtp.in_prefs;
 	while (current != NULL) {
 
@@ -1138,7 +1186,6 @@ void smtp_data(connection_t *con) {
 
 	int_t state;
 	stringer_t *text;
-	smtp_message_t *message;
 
 	// Make sure outsiders say HELO.
 	// If the remote host tries to send data before sending a MAIL FROM and RCPT TO, return a protocol error.
@@ -1157,6 +1204,17 @@ void smtp_data(connection_t *con) {
 		smtp_requeue(con);
 		return;
 	}
+	// RFC 3030 doesn't allow DATA and BDAT to be mixed inside a transaction, and a BINARYMIME body can't be dot terminated.
+	else if (con->smtp.chunks) {
+		con_write_bl(con, "503 DATA REJECTED - A BDAT TRANSFER IS ALREADY IN PROGRESS\r\n", 60);
+		smtp_requeue(con);
+		return;
+	}
+	else if (con->smtp.suggested_binary) {
+		con_write_bl(con, "503 DATA REJECTED - BINARYMIME MESSAGES MUST BE SENT USING BDAT\r\n", 65);
+		smtp_requeue(con);
+		return;
+	}
 
 	// Tell the user we are ready to receive.
 	con_write_bl(con, "354 Enter mail, end with \".\" on a line by itself.\r\n", 51);
@@ -1192,6 +1250,22 @@ void smtp_data(connection_t *con) {
 		return;
 	}
 
+	smtp_data_accept(con, text, 0);
+
+	return;
+}
+
+/**
+ * @brief	Check a complete message received using DATA or BDAT, and hand it off to the inbound or outbound processor.
+ * @param	con		the SMTP client connection which sent the message.
+ * @param	text	a managed string holding the message data, which is consumed by this function.
+ * @param	flags	the MAIL_CLEANUP flags which describe how the message data was transferred.
+ * @return	This function returns no value.
+ */
+void smtp_data_accept(connection_t *con, stringer_t *text, int_t flags) {
+
+	smtp_message_t *message;
+
 	// Count the number of Received lines. Some servers return error code 446 when the number of received lines indicates a delivery
 	// loop. Unfortunately that is a temporary error code, which would result in the server attempting delivery again later. Since the
 	// problem is unlikely to correct itself, we decided to return a permanent error code instead.
@@ -1204,7 +1278,7 @@ void smtp_data(connection_t *con) {
 	}
 
 	// Setup the message structure and cleanup the message data.
-	if (mail_message_cleanup(&text) != 1) {
+	if (mail_message_cleanup(&text, flags) != 1) {
 		con_write_bl(con, "451 DATA FAILED - INTERNAL SERVER ERROR - PLEASE TRY AGAIN LATER\n\n", 66);
 		smtp_requeue(con);
 		st_free(text);
@@ -1240,6 +1314,158 @@ void smtp_data(connection_t *con) {
 	return;
 }
 
+/**
+ * @brief	Read a BDAT chunk of a known length off the network.
+ * @note	Any bytes which follow the chunk, such as pipelined commands, are left in the network buffer for the command processor.
+ * @param	con		the SMTP client connection sending the chunk.
+ * @param	output	if not NULL, a managed string with enough room to hold the chunk, which the data is appended to, otherwise the chunk is discarded.
+ * @param	size	the length of the chunk in bytes.
+ * @return	1 on success, -3 if the server is shutting down, or -4 if the client disconnected.
+ */
+int_t smtp_bdat_read(connection_t *con, stringer_t *output, size_t size) {
+
+	int64_t read;
+	size_t copy;
+
+	while (size && status()) {
+
+		// The first read discards the BDAT command line, along with the data consumed by the previous pass.
+		if ((read = con_read(con)) <= 0) {
+			return -4;
+		}
+
+		copy = ((uint64_t)read > size) ? size : (size_t)read;
+
+		if (output) {
+			mm_copy(st_char_get(output) + st_length_get(output), st_char_get(con->network.buffer), copy);
+			st_length_set(output, st_length_get(output) + copy);
+		}
+
+		// Mark the bytes copied as consumed.
+		con->network.line = pl_init(st_char_get(con->network.buffer), copy);
+		size -= copy;
+	}
+
+	return size ? -3 : 1;
+}
+
+/**
+ * @brief	Process an SMTP BDAT command, which transfers a message as a series of length prefixed chunks (RFC 3030).
+ * @note	Each chunk is copied straight into the message buffer, so unlike DATA, there is no dot stuffing to undo, and no need to scan
+ * 			for the end of the data. The chunks are assembled until one marked LAST arrives, and the message is then processed the same way
+ * 			as one sent using DATA. A chunk is always read off the network, even when it's rejected, so it won't be mistaken for commands.
+ * @param	con		the SMTP client connection issuing the command.
+ * @return	This function returns no value.
+ */
+void smtp_bdat(connection_t *con) {
+
+	int_t state;
+	placer_t token;
+	uint64_t size = 0;
+	bool_t last = false;
+	size_t used, avail;
+	chr_t *error = NULL;
+	stringer_t *holder = NULL;
+	placer_t line = pl_trim(con->network.line);
+	uint64_t tokens = tok_get_count_bl(pl_char_get(line), pl_length_get(line), ' ');
+
+	// Without a valid chunk size there is no way to tell where the chunk ends, and the next command begins, so the connection is dropped.
+	if (tokens < 2 || tokens > 3 || tok_get_pl(line, ' ', 1, &token) < 0 || !uint64_conv_pl(token, &size) ||
+		(tokens == 3 && (tok_get_pl(line, ' ', 2, &token) < 0 || st_cmp_ci_eq(&token, CONSTANT("LAST"))))) {
+		con_write_bl(con, "501 BDAT SYNTAX ERROR - A VALID CHUNK SIZE IS REQUIRED - GOOD BYE\r\n", 67);
+		smtp_quit(con);
+		return;
+	}
+
+	last = (tokens == 3);
+
+	if (con->smtp.helo == NULL && con->smtp.authenticated == false) {
+		error = "503 BDAT REJECTED - PLEASE PROVIDE A HELO OR EHLO AND TRY AGAIN\r\n";
+	}
+	else if (con->smtp.mailfrom == NULL) {
+		error = "503 BDAT REJECTED - PLEASE PROVIDE A MAIL FROM AND TRY AGAIN\r\n";
+	}
+	else if ((con->smtp.authenticated == false && con->smtp.in_prefs == NULL) || (con->smtp.authenticated == true && con->smtp.out_prefs->recipients == NULL)) {
+		error = "503 BDAT REJECTED - PLEASE PROVIDE A RCPT AND TRY AGAIN\r\n";
+	}
+
+	used = con->smtp.chunks ? st_length_get(con->smtp.chunks) : 0;
+
+	// Reject the chunk if it would push the message over the size limit, and abandon the transaction.
+	if (!error && used + size > con->smtp.max_length) {
+		log_pedantic("Message exceeded size limit of %zu bytes. Reading the chunk, and then returning an error.", con->smtp.max_length);
+
+		if ((state = smtp_bdat_read(con, NULL, size)) == 1) {
+			con_print(con, "552 BDAT FAILED - SIZE LIMIT EXCEEDED - MESSAGES MAY ONLY BE UP TO %zu BYTES IN LENGTH\r\n", con->smtp.max_length);
+			smtp_session_reset(con);
+			smtp_requeue(con);
+			return;
+		}
+	}
+	else if (error) {
+		state = smtp_bdat_read(con, NULL, size);
+	}
+
+	// The first chunk allocates a buffer large enough for the size suggested by the MAIL FROM, so most messages are only allocated once.
+	// Later chunks which don't fit double the buffer.
+	else if (!con->smtp.chunks) {
+
+		avail = (con->smtp.suggested_length > size && con->smtp.suggested_length <= con->smtp.max_length) ? con->smtp.suggested_length : size;
+
+		if (!(con->smtp.chunks = st_alloc_opts(MAPPED_T | JOINTED | HEAP, avail > 128 * 1024 ? avail : 128 * 1024))) {
+			log_pedantic("Unable to allocate a buffer of %zu bytes to hold an incoming message.", avail > 128 * 1024 ? avail : 128 * 1024);
+			error = "451 BDAT FAILED - MEMORY ALLOCATION FAILED - PLEASE TRY AGAIN LATER\r\n";
+			smtp_session_reset(con);
+			state = smtp_bdat_read(con, NULL, size);
+		}
+		else {
+			state = smtp_bdat_read(con, con->smtp.chunks, size);
+		}
+	}
+	else if (used + size > (avail = st_avail_get(con->smtp.chunks)) && !(holder = st_realloc(con->smtp.chunks,
+		used + size > avail * 2 ? used + size : avail * 2))) {
+		log_pedantic("Unable to grow the buffer holding an incoming message to %zu bytes.", used + size > avail * 2 ? used + size : avail * 2);
+		error = "451 BDAT FAILED - MEMORY ALLOCATION FAILED - PLEASE TRY AGAIN LATER\r\n";
+		smtp_session_reset(con);
+		state = smtp_bdat_read(con, NULL, size);
+	}
+	else {
+		if (used + size > avail) {
+			con->smtp.chunks = holder;
+		}
+		state = smtp_bdat_read(con, con->smtp.chunks, size);
+	}
+
+	if (state == -3) {
+		con_write_bl(con, "451 BDAT FAILED - THE SERVER IS SHUTTING DOWN FOR MAINTENANCE - PLEASE TRY AGAIN LATER\r\n", 88);
+		smtp_quit(con);
+		return;
+	}
+	else if (state == -4) {
+		con_write_bl(con, "421 BDAT FAILED - THE CONNECTION TIMED OUT WHILE WAITING FOR DATA - GOOD BYE\r\n", 78);
+		smtp_quit(con);
+		return;
+	}
+	else if (error) {
+		con_write_bl(con, error, ns_length_get(error));
+		smtp_requeue(con);
+		return;
+	}
+	else if (!last) {
+		con_print(con, "250 %lu OCTETS RECEIVED\r\n", size);
+		smtp_requeue(con);
+		return;
+	}
+
+	// The message is complete, so take ownership of the buffer, and process it like any other.
+	holder = con->smtp.chunks;
+	con->smtp.chunks = NULL;
+
+	smtp_data_accept(con, holder, con->smtp.suggested_binary ? MAIL_CLEANUP_BINARY : 0);
+
+	return;
+}
+
 /**
  * @brief	The start of the protocol handler for the SMTP server.
  * @param	con		the new inbound SMTP client connection.
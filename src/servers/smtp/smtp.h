@@ -18,6 +18,7 @@ bool_t  smtp_store_spamsig(smtp_inbound_prefs_t *prefs, int_t spam);
 int_t   smtp_check_filters(smtp_inbound_prefs_t *prefs, stringer_t **local);
 int_t   smtp_check_greylist(connection_t *con, smtp_inbound_prefs_t *prefs);
 int_t   smtp_check_rbl(connection_t *con);
+int_t   smtp_rbl_query(stringer_t *addr, stringer_t **lists, uint32_t count, struct sockaddr *resolver, socklen_t length);
 bool_t  smtp_add_bypass_entry(stringer_t *subnet);
 bool_t  smtp_bypass_check(connection_t *con);
 
@@ -43,8 +44,12 @@ void          smtp_update_transmission_stats(connection_t *con);
 /// smtp.c
 void   smtp_auth_login(connection_t *con);
 void   smtp_auth_plain(connection_t *con);
+void   smtp_bdat(connection_t *con);
+int_t  smtp_bdat_read(connection_t *con, stringer_t *output, size_t size);
 void   smtp_data(connection_t *con);
 void   smtp_data(connection_t *con);
+void   smtp_data_accept(connection_t *con, stringer_t *text, int_t flags);
+int_t  smtp_data_read(connection_t *con, stringer_t **message);
 void   smtp_disabled(connection_t *con);
 void   smtp_ehlo(connection_t *con);
 void   smtp_helo(connection_t *con);
@@ -58,16 +63,39 @@ void   smtp_rset(connection_t *con);
 void   smtp_starttls(connection_t *con);
 void   submission_init(connection_t *con);
 
+/// inspect.c
+void    smtp_inspect_message(connection_t *con);
+bool_t  smtp_inspect_start(void);
+void    smtp_inspect_stop(void);
+void    smtp_inspect_thread(void);
+
 /// parse.c
 stringer_t *  smtp_parse_auth(stringer_t *data);
 stringer_t *  smtp_parse_helo_domain(connection_t *con);
 stringer_t *  smtp_parse_mail_from_path(connection_t *con);
 stringer_t *  smtp_parse_rcpt_to(connection_t *con);
 
+/// prefs.c
+int_t   smtp_prefs_fetch(stringer_t *address, smtp_inbound_prefs_t **output);
+void    smtp_prefs_prune(void);
+bool_t  smtp_prefs_start(void);
+void    smtp_prefs_stop(void);
+void    smtp_prefs_truncate(void);
+
+/// queue.c
+uint64_t  smtp_queue_age(void);
+uint64_t  smtp_queue_depth(void);
+int_t     smtp_queue_message(int_t premium, stringer_t *mailfrom, smtp_recipients_t *recipients, stringer_t *message, stringer_t **response);
+void      smtp_queue_schedule(void);
+bool_t    smtp_queue_start(void);
+void      smtp_queue_stop(void);
+
 /// relay.c
 void        smtp_client_close(client_t *client);
 client_t *  smtp_client_connect(int_t premium);
+void        smtp_client_pool_stop(void);
 int_t       smtp_client_send_data(client_t *client, stringer_t *message, bool_t dotstuffed);
+int_t       smtp_client_send_envelope(client_t *client, stringer_t *mailfrom, smtp_recipients_t *recipients, smtp_recipients_t **rejected);
 int_t       smtp_client_send_helo(client_t *client);
 int_t       smtp_client_send_mailfrom(client_t *client, stringer_t *mailfrom, size_t send_size);
 int_t       smtp_client_send_nullfrom(client_t *client);
@@ -87,6 +115,7 @@ void    smtp_session_reset(connection_t *con);
 
 /// transmit.c
 int_t   smtp_bounce(connection_t *con);
+int_t   smtp_bounce_notice(stringer_t *mailfrom, stringer_t *summary, stringer_t *explain, stringer_t *original);
 int_t   smtp_forward_message(server_t *server, stringer_t *sender, stringer_t *address, stringer_t *message, stringer_t *id, int_t mark, uint64_t signum, uint64_t sigkey);
 int_t   smtp_relay_message(connection_t *con, stringer_t **result);
 int_t   smtp_reply(stringer_t *from, stringer_t *to, uint64_t usernum, uint64_t autoreply, int_t spf, int_t dkim);
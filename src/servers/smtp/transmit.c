@@ -11,20 +11,15 @@
  * @brief	Relay an outbound smtp message for a user.
  * @note	The following process occurs before the message will be sent:
  * 			1. Necessary outbound headers are attached to the message.*
- * 			2. An outbound connection to a mail relay server is established (with a premium or normal server pool).
- * 			3. Once the connection is negotiated, an RCPT TO command is issued for each of the message's recipients.
- * 			4. The mail message data is sent and the client connection is closed.
+ * 			2. The message is stored in the outbound queue, which delivers it to a mail relay server (with a premium or normal server pool).
+ * 			3. If the queue has been disabled, the message is relayed right away, and the relay's response is passed back to the caller.
  * @param	con		a pointer to the connection object across which the outbound mail was attempted to be sent.
  * @param	result	a pointer to the address of a managed string that will receive the server's last response to the mail send attempt,
- * 			regardless of whether or not it was successful.
- * @return	1 if the message was successfully sent or -1 on failure.
+ * 			regardless of whether or not it was successful, or NULL if the message was queued.
+ * @return	1 if the message was successfully queued or sent, or -1 on failure.
  */
 int_t smtp_relay_message(connection_t *con, stringer_t **result) {
 
-	int_t state;
-	smtp_recipients_t *holder;
-	client_t *client;
-
 	if (!result || !con || !con->smtp.message || !con->smtp.message->text || !con->smtp.out_prefs->recipients) {
 		log_pedantic("Passed a NULL pointer.");
 		return -1;
@@ -38,74 +33,12 @@ int_t smtp_relay_message(connection_t *con, stringer_t **result) {
 		return -1;
 	}
 
-	// Open the connection to the SMTP server.
-	if (!(client = smtp_client_connect(con->smtp.out_prefs->importance))) {
+	// The message is dot stuffed as it's sent, so it's queued as is.
+	if (smtp_queue_message(con->smtp.out_prefs->importance, con->smtp.mailfrom, con->smtp.out_prefs->recipients, con->smtp.message->text, result) != 1) {
 		log_pedantic("Could not relay the message.");
 		return -1;
 	}
 
-	// Send HELO.
-	if (smtp_client_send_helo(client) != 1) {
-		log_pedantic("An error occurred while trying to say hello.");
-		smtp_client_close(client);
-		return -1;
-	}
-
-	// Send MAIL FROM.
-	if ((state = smtp_client_send_mailfrom(client, con->smtp.mailfrom, 0)) == -2) {
-		log_pedantic("An error occurred while trying to send the mail from.");
-		*result = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, &(client->line));
-		smtp_client_close(client);
-		return -1;
-	}
-	else if (state != 1) {
-		log_pedantic("An error occurred while trying to send the mail from.");
-		smtp_client_close(client);
-		return -1;
-	}
-
-	// Send the RCPT TO command.
-	holder = con->smtp.out_prefs->recipients;
-
-	while (holder) {
-
-		if ((state = smtp_client_send_rcptto(client, holder->address)) == -2) {
-			log_pedantic("An error occurred while trying to send a rcpt to command.");
-			*result = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, &(client->line));
-			smtp_client_close(client);
-			return -1;
-		}
-		else if (state != 1) {
-			log_pedantic("An error occurred while trying to send a rcpt to command.");
-			smtp_client_close(client);
-			return -1;
-		}
-
-		holder = (smtp_recipients_t *)holder->next;
-	}
-
-	// Ensure the message is properly dot stuffed before sending.
-	st_replace(&(con->smtp.message->text), PLACER("\n.", 2), PLACER("\n..", 3));
-
-	// Send the the message.
-	state = smtp_client_send_data(client, con->smtp.message->text, true);
-
-	if (state == -2) {
-		log_pedantic("An error occurred while trying to send the message.");
-		*result = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, &(client->line));
-		smtp_client_close(client);
-		return -1;
-	}
-	else if (state != 1) {
-		log_pedantic("An error occurred while trying to send the message.");
-		smtp_client_close(client);
-		return -1;
-	}
-
-	// Store the result.
-	*result = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, &(client->line));
-	smtp_client_close(client);
-
 	return 1;
 }
 
@@ -114,14 +47,14 @@ int_t smtp_forward_message(server_t *server, stringer_t *sender, stringer_t *add
 
 	int_t state;
 	stringer_t *new;
-	client_t *client;
+	smtp_recipients_t recipient;
 
 	if (!address || !message) {
 		log_pedantic("Passed a NULL pointer.");
 		return -2;
 	}
-	// Duplicate and then dot stuff the output message.
-	else if (!(new = st_dupe_opts(MAPPED_T | JOINTED | HEAP, message)) || st_replace(&new, PLACER("\n.", 2), PLACER("\n..", 3)) < 0) {
+	// Duplicate the message, so the forwarding headers can be added.
+	else if (!(new = st_dupe_opts(MAPPED_T | JOINTED | HEAP, message))) {
 		log_pedantic("Could not duplicate the message.");
 		return -1;
 	}
@@ -129,68 +62,45 @@ int_t smtp_forward_message(server_t *server, stringer_t *sender, stringer_t *add
 	// Add the new message headers associated with this forward operation.
 	mail_add_forward_headers(server, &new, id, mark, signum, sigkey);
 
-	// Open the connection to the SMTP server. Always use the default servers for forwards.
-	if (!(client = smtp_client_connect(0))) {
-		log_pedantic("Could not relay the message.");
-		smtp_client_close(client);
-		st_free(new);
-		return -1;
-	}
-
-	// Send HELO.
-	if (smtp_client_send_helo(client)!= 1) {
-		log_pedantic("An error occurred while trying to say hello.");
-		smtp_client_close(client);
-		st_free(new);
-		return -1;
-	}
-
-	// Send MAIL FROM.
-	if (smtp_client_send_mailfrom(client, sender, st_length_get(new)) != 1) {
-		log_pedantic("An error occurred while trying to send the mail from.");
-		smtp_client_close(client);
-		st_free(new);
-		return -1;
-	}
+	recipient.address = address;
+	recipient.response = NULL;
+	recipient.next = NULL;
 
-	// Send the RCPT TO command. If this fails, use a permanent failure code.
-	if ((state = smtp_client_send_rcptto(client, address)) != 1) {
-		log_pedantic("An error occurred while trying to send a rcpt to command.");
-		smtp_client_close(client);
+	// Always use the default servers for forwards. If the relay rejects the message, use a permanent failure code.
+	if ((state = smtp_queue_message(0, sender, &recipient, new, NULL)) != 1) {
+		log_pedantic("An error occurred while trying to forward the message.");
 		st_free(new);
-		return -2;
-	}
-
-	// Send the the message.
-	if ((state = smtp_client_send_data(client, new, true)) != 1) {
-		log_pedantic("An error occurred while trying to send the message.");
-		smtp_client_close(client);
-		st_free(new);
-		return -1;
+		return state == -2 ? -2 : -1;
 	}
 
-	// Store the result.
-	smtp_client_close(client);
 	st_free(new);
 
 	return 1;
 }
 
-int_t smtp_bounce(connection_t *con) {
+/**
+ * @brief	Queue a bounce notice for the sender of a message which couldn't be delivered.
+ * @note	Bounces are sent using the null sender and the default relay servers, so a bounce which can't be delivered is discarded, rather than
+ * 			generating another bounce.
+ * @param	mailfrom	a managed string containing the return path of the failed message, which receives the notice.
+ * @param	summary		a managed string listing the recipients the message couldn't be delivered to, one per line.
+ * @param	explain		a managed string explaining why the message couldn't be delivered.
+ * @param	original	an optional managed string containing the original message, or just its header.
+ * @return	-1 on failure, or 1 if the notice was queued.
+ */
+int_t smtp_bounce_notice(stringer_t *mailfrom, stringer_t *summary, stringer_t *explain, stringer_t *original) {
 
 	time_t utime;
 	struct tm ltime;
-	uint32_t number = 0;
+	int_t result = 1;
 	chr_t date_buffer[1024];
-	smtp_inbound_prefs_t *prefs;
-	client_t *client;
-	int_t explanations = SMTP_OUTCOME_SUCESS;
+	smtp_recipients_t recipient;
 	static const chr_t *date_format = "Date: %a, %d %b %Y %H:%M:%S %z\r\n";
-	stringer_t *message = NULL, *holder = NULL, *explain = NULL, *bounces = NULL, *signature = NULL, *id = MANAGEDBUF(16);
+	stringer_t *message = NULL, *holder = NULL, *signature = NULL, *id = MANAGEDBUF(16);
 
-	// Only send bounces if the SPF and DKIM checks didn't explicitly fail, and the return path isn't empty.
-	if (!con || con->smtp.checked.spf == -2 || con->smtp.checked.dkim == -2 || !st_cmp_cs_eq(con->smtp.mailfrom, "<>")) {
-		return 0;
+	if (st_empty(mailfrom)) {
+		log_pedantic("Passed an empty return path.");
+		return -1;
 	}
 
 	// Build the date string. Otherwise null the buffer so it doesn't get appended to the header.
@@ -199,7 +109,7 @@ int_t smtp_bounce(connection_t *con) {
 		date_buffer[0] = '\0';
 	}
 
-		// Generate the ID string. If the random method fails, use a hash of the current time.
+	// Generate the ID string. If the random method fails, use a hash of the current time.
 	if ((holder = rand_choices("ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789", 12, NULL))) {
 		st_sprint(id, "%.*s", st_length_int(holder), st_char_get(holder));
 		st_free(holder);
@@ -209,31 +119,51 @@ int_t smtp_bounce(connection_t *con) {
 		st_sprint(id, "%lu", crc64_checksum(&utime, sizeof(time_t)));
 	}
 
-	// Open the connection to the SMTP server. Always use the default servers for forwards.
-	if (!(client = smtp_client_connect(0))) {
-		log_pedantic("Could not relay the message.");
-		smtp_client_close(client);
-		return 0;
+	// Build the bounce message.
+	message = st_merge("nsnnnsnsnsnsnsn", "From: Magma Mail Daemon <daemon@", magma.system.domain, ">\r\nSubject: Bounce Notification\r\n", date_buffer, "To: ", mailfrom, "\r\n\r\n"
+		"This is the Magma Mail Daemon faithfully reporting a bounced message. A message sent by you (", mailfrom, ") could not be delivered to all of its recipients. "
+		"Please direct any questions or comments you may have to the support address, thank you.\r\n\r\n\r\n          ------- Summary -------\r\n\r\n\r\n", summary,
+		"\r\n\r\n          ------- Explanations -------\r\n\r\n\r\n", explain, "\r\n\r\n          ------- Original Message -------\r\n\r\n\r\n", original, "\r\n\r\n");
+
+	// Add a DKIM signature.
+	if (!message) {
+		log_pedantic("Unable to build the bounce message.");
+		return -1;
 	}
+	else if ((signature = dkim_signature_create(id, message))) {
+
+		if ((holder = st_merge("ss", signature, message))) {
+			st_free(message);
+			message = holder;
+		}
 
-	// Send HELO.
-	if (smtp_client_send_helo(client)!= 1) {
-		log_pedantic("An error occurred while trying to say hello.");
-		smtp_client_close(client);
-		return 0;
 	}
 
-	// Send NULL MAIL FROM.
-	if (smtp_client_send_nullfrom(client) != 1) {
-		log_pedantic("An error occurred while trying to send the mail from.");
-		smtp_client_close(client);
-		return 0;
+	recipient.address = mailfrom;
+	recipient.response = NULL;
+	recipient.next = NULL;
+
+	// Queue the bounce using the null sender. Always use the default servers for bounces.
+	if (smtp_queue_message(0, NULL, &recipient, message, NULL) != 1) {
+		log_pedantic("An error occurred while trying to send the message.");
+		result = -1;
 	}
 
-	// Send the RCPT TO command. If this fails, use a permanent failure code.
-	if (smtp_client_send_rcptto(client, con->smtp.mailfrom) != 1) {
-		log_pedantic("An error occurred while trying to send a rcpt to command.");
-		smtp_client_close(client);
+	st_cleanup(signature);
+	st_free(message);
+
+	return result;
+}
+
+int_t smtp_bounce(connection_t *con) {
+
+	uint32_t number = 0;
+	smtp_inbound_prefs_t *prefs;
+	int_t explanations = SMTP_OUTCOME_SUCESS;
+	stringer_t *holder = NULL, *explain = NULL, *bounces = NULL;
+
+	// Only send bounces if the SPF and DKIM checks didn't explicitly fail, and the return path isn't empty.
+	if (!con || con->smtp.checked.spf == -2 || con->smtp.checked.dkim == -2 || !st_cmp_cs_eq(con->smtp.mailfrom, "<>")) {
 		return 0;
 	}
 
@@ -325,37 +255,12 @@ int_t smtp_bounce(connection_t *con) {
 		"if the sending server has recently been responsible for sending out unsolicited bulk mail. Consult your local system administrator and have them correct the issue." : NULL);
 
 
-	// Build the bounce message.
-	message = st_merge("nsnnnsnsnsnsnsn", "From: Magma Mail Daemon <daemon@", magma.system.domain, ">\r\nSubject: Bounce Notification\r\n", date_buffer, "To: ", con->smtp.mailfrom, "\r\n\r\n"
-		"This is the Magma Mail Daemon faithfully reporting a bounced message. A message sent by you (", con->smtp.mailfrom, ") could not be delivered to all of its recipients. "
-		"Please direct any questions or comments you may have to the support address, thank you.\r\n\r\n\r\n          ------- Summary -------\r\n\r\n\r\n", bounces,
-		"\r\n\r\n          ------- Explanations -------\r\n\r\n\r\n", explain, "\r\n\r\n          ------- Original Message -------\r\n\r\n\r\n",
-		(con->smtp.message != NULL) ? con->smtp.message->text : NULL, "\r\n\r\n");
-
-	// Add a DKIM signature.
-	if (!message) {
-		log_pedantic("Unable to build the bounce message.");
-	}
-	else if ((signature = dkim_signature_create(id, message))) {
-
-		if ((holder = st_merge("ss", signature, message))) {
-			st_free(message);
-			message = holder;
-		}
-
-	}
-
-	// Transmit the bounce.
-	if (message && smtp_client_send_data(client, message, false) != 1) {
-		log_pedantic("An error occurred while trying to send the message.");
-	}
+	// Queue the notice, with the original message attached.
+	smtp_bounce_notice(con->smtp.mailfrom, bounces, explain, (con->smtp.message != NULL) ? con->smtp.message->text : NULL);
 
-	// Close the connection and cleanup.
-	smtp_client_close(client);
+	// Cleanup.
 	st_cleanup(bounces);
 	st_cleanup(explain);
-	st_cleanup(signature);
-	st_cleanup(message);
 
 	return 1;
 }
@@ -364,8 +269,8 @@ int_t smtp_reply(stringer_t *from, stringer_t *to, uint64_t usernum, uint64_t au
 
 	time_t utime;
 	struct tm ltime;
-	client_t *client;
 	chr_t buffer[1024];
+	smtp_recipients_t recipient;
 	static const chr_t *date_format = "Date: %a, %d %b %Y %H:%M:%S %z\r\n";
 	stringer_t *message = NULL, *holder = NULL, *signature = NULL, *text = NULL, *key = NULL, *id = MANAGEDBUF(16);
 
@@ -417,46 +322,6 @@ int_t smtp_reply(stringer_t *from, stringer_t *to, uint64_t usernum, uint64_t au
 		st_sprint(id, "%lu", crc64_checksum(&utime, sizeof(time_t)));
 	}
 
-	// Open the connection to the SMTP server. Always use the default servers for forwards.
-	if (!(client = smtp_client_connect(0))) {
-		log_pedantic("Could not relay the message.");
-		smtp_client_close(client);
-		lock_release(key);
-		st_free(text);
-		st_free(key);
-		return 0;
-	}
-
-	// Send HELO.
-	if (smtp_client_send_helo(client) != 1) {
-		log_pedantic("An error occurred while trying to say hello.");
-		smtp_client_close(client);
-		lock_release(key);
-		st_free(text);
-		st_free(key);
-		return 0;
-	}
-
-	// Send NULL MAIL FROM.
-	if (smtp_client_send_nullfrom(client) != 1) {
-		log_pedantic("An error occurred while trying to send the mail from.");
-		smtp_client_close(client);
-		lock_release(key);
-		st_free(text);
-		st_free(key);
-		return 0;
-	}
-
-	// Send the RCPT TO command. If this fails, use a permanent failure code.
-	if (smtp_client_send_rcptto(client, to) != 1) {
-		log_pedantic("An error occurred while trying to send a rcpt to command.");
-		smtp_client_close(client);
-		lock_release(key);
-		st_free(text);
-		st_free(key);
-		return 0;
-	}
-
 	// Build the autoreply message.
 	message = st_merge("nsnnnsnsn", "From: ", from, "\r\nSubject: Autoreply\r\n", buffer, "To: ", to, "\r\n\r\n", text, "\r\n\r\n");
 
@@ -471,17 +336,18 @@ int_t smtp_reply(stringer_t *from, stringer_t *to, uint64_t usernum, uint64_t au
 		}
 	}
 
-	// Transmit the auto reply and set the timestamp.
-	if (message != NULL && smtp_client_send_data(client, message, false) == 1) {
+	recipient.address = to;
+	recipient.response = NULL;
+	recipient.next = NULL;
+
+	// Queue the auto reply using the null sender and set the timestamp. Always use the default servers for replies.
+	if (message != NULL && smtp_queue_message(0, NULL, &recipient, message, NULL) == 1) {
 		cache_set_u64(key, time(NULL), 86460);
 	}
 	else if (message != NULL) {
 		log_pedantic("An error occurred while trying to send the message.");
 	}
 
-	// Close the connection and cleanup.
-	smtp_client_close(client);
-
 	// Release the lock.
 	lock_release(key);
 
@@ -502,50 +368,22 @@ int_t smtp_reply(stringer_t *from, stringer_t *to, uint64_t usernum, uint64_t au
  */
 int_t smtp_send_message(stringer_t *to, stringer_t *from, stringer_t *message) {
 
-	client_t *client;
+	smtp_recipients_t recipient;
 
 	if (!to || !from || !message) {
 		log_pedantic("Passed a NULL pointer.");
 		return -1;
 	}
 
-	// Open the connection to the SMTP server.
-	if (!(client = smtp_client_connect(1))) {
-		log_pedantic("Could not relay the message.");
-		smtp_client_close(client);
-		return -1;
-	}
+	recipient.address = to;
+	recipient.response = NULL;
+	recipient.next = NULL;
 
-	// Send HELO.
-	if (smtp_client_send_helo(client)!= 1) {
-		log_pedantic("An error occurred while trying to say hello.");
-		smtp_client_close(client);
-		return -1;
-	}
-
-	// Send MAIL FROM.
-	if (smtp_client_send_mailfrom(client, from, 0) != 1) {
-		log_pedantic("An error occurred while trying to send the mail from.");
-		smtp_client_close(client);
-		return -1;
-	}
-
-	// Send the RCPT TO command.
-	if (smtp_client_send_rcptto(client, to) != 1) {
-		log_pedantic("An error occurred while trying to send a rcpt to command.");
-		smtp_client_close(client);
-		return -1;
-	}
-
-	// Send the the message.
-	if (smtp_client_send_data(client, message, false) != 1) {
-		log_pedantic("An error occurred while trying to send the message.");
-		smtp_client_close(client);
+	// Queue the message, using the premium relays.
+	if (smtp_queue_message(1, from, &recipient, message, NULL) != 1) {
+		log_pedantic("Could not relay the message.");
 		return -1;
 	}
 
-	// Store the result.
-	smtp_client_close(client);
-
 	return 1;
 }
@@ -955,7 +955,7 @@ void portal_endpoint_folders_tags(connection_t *con) {
 	}
 
 	/// HIGH: Right now we only have indexes with the mail folders so other context types generate an empty array result.
-	if (context == PORTAL_ENDPOINT_CONTEXT_MAIL && (stats = meta_folders_stats_tags(con->http.session->user->messages, folder))) {
+	if (context == PORTAL_ENDPOINT_CONTEXT_MAIL && (stats = meta_folders_stats_tags(con->http.session->user->folders, con->http.session->user->messages, folder))) {
 		if ((cursor = inx_cursor_alloc(stats))) {
 			while ((active = inx_cursor_value_next(cursor))) {
 				if (!(entry = json_integer_d(active->count))) {
@@ -989,7 +989,11 @@ void portal_endpoint_messages_list(connection_t *con) {
 	inx_cursor_t *cursor;
 	meta_message_t *active;
 	uint64_t foldernum, count;
+	inx_t *envelopes = NULL;
+	mail_message_t *message;
+	mail_envelope_t *envelope;
 	stringer_t *header, *fields[8];
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
 
 	// Check the session state. Method has 1 parameter.
 	if (!portal_validate_request (con, PORTAL_ENDPOINT_ERROR_MESSAGES_LIST, "messages.list", true, 1)) {
@@ -1008,11 +1012,57 @@ void portal_endpoint_messages_list(connection_t *con) {
 		return;
 	}
 
+	// Fetch the stored envelope summaries for the entire folder using a single query.
+	if (!(envelopes = mail_db_fetch_envelopes(con->http.session->user->usernum, foldernum))) {
+		log_pedantic("Unable to fetch the message envelopes. Falling back to the message headers. { foldernum = %lu }", foldernum);
+	}
+
 	if ((cursor = inx_cursor_alloc(con->http.session->user->messages)))	{
 
 		while ((active = inx_cursor_value_next(cursor))) {
 
-			if (active->foldernum == foldernum && (header = mail_load_header(active, con->http.session->user, con->server, true))) {
+			if (active->foldernum != foldernum) {
+				continue;
+			}
+
+			key.val.u64 = active->messagenum;
+			envelope = envelopes ? inx_find(envelopes, key) : NULL;
+
+			// Messages stored before envelopes were introduced get summarized, and the summary saved, the first time they're listed.
+			if (!envelope && !(active->status & MAIL_STATUS_ENCRYPTED) &&
+				(message = mail_load_message(active, con->http.session->user, con->server, false))) {
+
+				if ((envelope = mail_envelope_build(message->text))) {
+
+					if (!mail_db_insert_envelope(active->messagenum, envelope, -1)) {
+						log_pedantic("Unable to store the message envelope summary. { messagenum = %lu }", active->messagenum);
+					}
+
+					if (!envelopes || !inx_insert(envelopes, key, envelope)) {
+						mail_envelope_free(envelope);
+						envelope = NULL;
+					}
+				}
+
+				mail_destroy(message);
+			}
+
+			header = NULL;
+
+			if (envelope) {
+				fields[0] = envelope->from ? st_dupe(envelope->from) : NULL;
+				fields[1] = envelope->to ? st_dupe(envelope->to) : NULL;
+
+				/// LOW: Add the ability to track the recipient email address for a message, even if its not provided in the To field.
+				fields[2] = envelope->to ? st_dupe(envelope->to) : NULL;
+
+				fields[3] = envelope->reply_to ? st_dupe(envelope->reply_to) : NULL;
+				fields[4] = envelope->return_path ? st_dupe(envelope->return_path) : NULL;
+				fields[5] = envelope->subject ? st_dupe(envelope->subject) : NULL;
+				fields[6] = envelope->date ? st_dupe(envelope->date) : NULL;
+				fields[7] = envelope->snippet ? st_dupe(envelope->snippet) : st_import("", 0);
+			}
+			else if ((header = mail_load_header(active, con->http.session->user, con->server, true))) {
 
 				fields[0] = mail_header_fetch_cleaned(header, PLACER("From", 4));
 				fields[1] = mail_header_fetch_cleaned(header, PLACER("To", 2));
@@ -1024,44 +1074,46 @@ void portal_endpoint_messages_list(connection_t *con) {
 				fields[4] = mail_header_fetch_cleaned(header, PLACER("Return-Path", 11));
 				fields[5] = mail_header_fetch_cleaned(header, PLACER("Subject", 7));
 				fields[6] = mail_header_fetch_cleaned(header, PLACER("Date", 4));
+				fields[7] = st_import("", 0);
+			}
+			else {
+				continue;
+			}
 
-				/// LOW: Add snippet support.
-				fields[7] = st_import("...", 3);
-
-				// Tags
-				if ((tags = json_array_d()) && active->tags && (count = ar_length_get(active->tags))) {
-
-					for (uint64_t i = 0; i < count; i++) {
-						json_array_append_new_d(tags, json_string_d(st_char_get(ar_field_st(active->tags, i))));
-					}
+			// Tags
+			if ((tags = json_array_d()) && active->tags && (count = ar_length_get(active->tags))) {
 
+				for (uint64_t i = 0; i < count; i++) {
+					json_array_append_new_d(tags, json_string_d(st_char_get(ar_field_st(active->tags, i))));
 				}
 
-				if (!(entry = json_pack_ex_d(&err, JSON_ENSURE_ASCII, "{s:I, s:o, s:o, s:S, s:S, s:S, s:S, s:S, s:S, s:I, s:I, s:S, s:I}", "messageID",
-					active->messagenum, "flags", portal_message_flags_array(active), "tags", tags, "from", st_char_get(fields[0]), "to", st_char_get(fields[1]),
-					"addressedTo", st_char_get(fields[2]), "replyTo", st_char_get(fields[3]), "returnPath", st_char_get(fields[4]), "subject",
-					st_char_get(fields[5]), "utc", active->created, "arrivalUtc", active->created, "snippet", st_char_get(fields[7]), "bytes",
-					active->size))) {
-					log_pedantic("Message packing attempt failed. { error = %s }", err.text);
-				}
-				else if (json_array_append_new_d(list, entry)) {
-					log_pedantic("The message object could not be appended to the result list. { error = %s }", err.text);
-					json_decref_d(entry);
-				}
+			}
 
-				// Release the header fields.
-				for (int_t i = 0; i <= 7; i++) {
-					st_cleanup(fields[i]);
-				}
+			if (!(entry = json_pack_ex_d(&err, JSON_ENSURE_ASCII, "{s:I, s:o, s:o, s:S, s:S, s:S, s:S, s:S, s:S, s:I, s:I, s:S, s:I}", "messageID",
+				active->messagenum, "flags", portal_message_flags_array(active), "tags", tags, "from", st_char_get(fields[0]), "to", st_char_get(fields[1]),
+				"addressedTo", st_char_get(fields[2]), "replyTo", st_char_get(fields[3]), "returnPath", st_char_get(fields[4]), "subject",
+				st_char_get(fields[5]), "utc", active->created, "arrivalUtc", active->created, "snippet", st_char_get(fields[7]), "bytes",
+				active->size))) {
+				log_pedantic("Message packing attempt failed. { error = %s }", err.text);
+			}
+			else if (json_array_append_new_d(list, entry)) {
+				log_pedantic("The message object could not be appended to the result list. { error = %s }", err.text);
+				json_decref_d(entry);
+			}
 
-				// Release header string.
-				st_free(header);
+			// Release the header fields.
+			for (int_t i = 0; i <= 7; i++) {
+				st_cleanup(fields[i]);
 			}
+
+			// Release header string.
+			st_cleanup(header);
 		}
 
 		inx_cursor_free(cursor);
 	}
 
+	inx_cleanup(envelopes);
 	portal_endpoint_response(con, "{s:s, s:o, s:I}", "jsonrpc", "2.0", "result", list, "id", con->http.portal.id);
 
 	return;
@@ -1290,13 +1342,13 @@ void portal_endpoint_messages_flag(connection_t *con) {
 				while ((active = inx_cursor_value_next(cursor))) {
 					switch (action) {
 					case (PORTAL_ENDPOINT_ACTION_ADD):
-						active->status = active->status | bits;
+						meta_counters_status(con->http.session->user->folders, active, active->status | bits);
 						break;
 					case (PORTAL_ENDPOINT_ACTION_REMOVE):
-						active->status = (active->status | bits) ^ bits;
+						meta_counters_status(con->http.session->user->folders, active, (active->status | bits) ^ bits);
 						break;
 					case (PORTAL_ENDPOINT_ACTION_REPLACE):
-						active->status = ((active->status | MAIL_STATUS_USER_FLAGS) ^ MAIL_STATUS_USER_FLAGS) | bits;
+						meta_counters_status(con->http.session->user->folders, active, ((active->status | MAIL_STATUS_USER_FLAGS) ^ MAIL_STATUS_USER_FLAGS) | bits);
 						break;
 					case (PORTAL_ENDPOINT_ACTION_LIST):
 						if (!(entry = json_pack_ex_d(&err, JSON_ENSURE_ASCII, "{s:I, s:o}", "messageID", active->messagenum, "flags", portal_message_flags_array(active)))) {
@@ -1312,6 +1364,10 @@ void portal_endpoint_messages_flag(connection_t *con) {
 				inx_cursor_free(cursor);
 			}
 
+			if (action != PORTAL_ENDPOINT_ACTION_LIST) {
+				meta_snapshot_invalidate(con->http.session->user);
+			}
+
 			// And finally, increment the serial number. If the serial number indicates no outside changes we can increment it without forcing a refresh.
 			if (con->http.session->user->serials.messages == serial_get(OBJECT_MESSAGES, con->http.session->user->usernum)) {
 				con->http.session->user->serials.messages = serial_increment(OBJECT_MESSAGES, con->http.session->user->usernum);
@@ -1496,6 +1552,7 @@ void portal_endpoint_messages_remove(connection_t *con) {
 				commit = false;
 			} else {
 				// Remove the message from the mailbox context.
+				meta_counters_remove(con->http.session->user->folders, active);
 				inx_delete(con->http.session->user->messages, key);
 			}
 
@@ -1503,6 +1560,7 @@ void portal_endpoint_messages_remove(connection_t *con) {
 
 		// If any messages are moved to a different folder we'll need to update the sequence numbers to reflect the new status.
 		meta_messages_update_sequences(con->http.session->user->folders, con->http.session->user->messages);
+		meta_snapshot_invalidate(con->http.session->user);
 
 		if (commit) {
 
@@ -1730,6 +1788,14 @@ void portal_endpoint_messages_tag(connection_t *con) {
 				}
 
 				meta_data_fetch_message_tags(active);
+
+				// Keep the in memory tagged flag in step with the database, so the folder counters know which messages carry tags.
+				if (action == PORTAL_ENDPOINT_ACTION_ADD || (action == PORTAL_ENDPOINT_ACTION_REPLACE && tag_count)) {
+					meta_counters_status(con->http.session->user->folders, active, active->status | MAIL_STATUS_TAGGED);
+				}
+				else if (action == PORTAL_ENDPOINT_ACTION_REPLACE && !tag_count) {
+					meta_counters_status(con->http.session->user->folders, active, (active->status | MAIL_STATUS_TAGGED) ^ MAIL_STATUS_TAGGED);
+				}
 			}
 
 			inx_cursor_free(cursor);
@@ -2171,7 +2237,7 @@ void portal_endpoint_messages_send(connection_t *con) {
 	}
 
 	// Relay our message.
-	if (!portal_smtp_relay_message(NULLER(from), tos, newbody, st_length_get(newbody), &errmsg)) {
+	if (!portal_smtp_relay_message(NULLER(from), tos, newbody, &errmsg)) {
 		log_pedantic("User was unable to send email through portal: {%s}", errmsg);
 		st_free(newbody);
 		inx_free(tos);
@@ -5680,20 +5746,84 @@ void portal_endpoint_ad(connection_t *con) {
 	return;
 }
 
+/**
+ * @brief	Search the user's messages using the full text index, in response to a json-rpc "search" portal request.
+ * @note	Every word in the query must appear in the message, either in the header or a text part, and each word can match anywhere
+ * 			inside a word. Messages stored before the index existed are indexed first, up to PORTAL_SEARCH_INDEX_LIMIT per request, so
+ * 			a large mailbox is added to the index gradually, over several searches, rather than stalling a single request.
+ * @param	con		a pointer to the connection object of the requesting user.
+ * @return	This function returns no value.
+ */
 void portal_endpoint_search(connection_t *con) {
 
-	stringer_t *response;
+	json_error_t err;
+	json_t *list, *entry;
+	chr_t *query = NULL;
+	uint64_t foldernum = 0;
+	mail_terms_t *terms;
+	meta_message_t *active;
+	mail_matches_t *matches;
+	multi_t key = { .type = M_TYPE_UINT64, .val.u64 = 0 };
 
-	if ((response = st_aprint("{\"jsonrpc\": \"2.0\", \"error\": {\"code\": %i, \"message\": \"%s%s%s\"}, \"id\": %lu}\r\n",
-		PORTAL_ENDPOINT_ERROR_SEARCH, "Method (", __FUNCTION__, ") is under construction.", con->http.portal.id))) {
-		http_response_header(con, 200, PLACER("application/json; charset=utf-8", 31), st_length_get(response));
-		con_write_st(con, response);
-		st_free(response);
+	// Check the session state. The folder parameter is optional.
+	if (!portal_validate_request (con, PORTAL_ENDPOINT_ERROR_SEARCH, "search", true, 0)) {
+		return;
 	}
-	else {
-		con->http.mode = HTTP_ERROR_500;
+	// Validate the request format and extract the submitted values.
+	else if (json_unpack_ex_d(con->http.portal.params, &err, JSON_STRICT, "{s:s, s?:I}", "query", &query, "folderID", &foldernum)) {
+		log_pedantic("Received invalid portal search request parameters { user = %.*s, errmsg = %s }",
+			(int)st_length_get(con->http.session->user->username), st_char_get(con->http.session->user->username), err.text);
+		portal_endpoint_error(con, 400, JSON_RPC_2_ERROR_SERVER_METHOD_PARAMS, "Invalid method parameters.");
+		return;
+	}
+	// The query needs at least one word the index can look up.
+	else if (!(terms = mail_terms_query(NULLER(query)))) {
+		portal_endpoint_error(con, 400, JSON_RPC_2_ERROR_SERVER_METHOD_PARAMS, "The search query doesn't contain any searchable words.");
+		return;
+	}
+
+	mail_terms_free(terms);
+
+	if (!(list = json_array_d())) {
+		portal_endpoint_error(con, 500, JSON_RPC_2_ERROR_SERVER_INTERNAL, "Internal server error.");
+		return;
+	}
+
+	meta_user_rlock(con->http.session->user);
+
+	mail_terms_backfill(con->http.session->user, foldernum, PORTAL_SEARCH_INDEX_LIMIT);
+
+	if (!(matches = mail_terms_search(con->http.session->user->usernum, foldernum, MAIL_TERM_ALL, NULLER(query)))) {
+		meta_user_unlock(con->http.session->user);
+		json_decref_d(list);
+		portal_endpoint_error(con, 500, JSON_RPC_2_ERROR_SERVER_INTERNAL, "Internal server error.");
+		return;
 	}
 
+	for (size_t i = 0; i < matches->count; i++) {
+
+		key.val.u64 = matches->messages[i];
+
+		// Skip any messages which were removed, or hidden, since the index was queried.
+		if (!(active = inx_find(con->http.session->user->messages, key)) || (active->status & MAIL_STATUS_HIDDEN)) {
+			continue;
+		}
+
+		if (!(entry = json_pack_ex_d(&err, JSON_ENSURE_ASCII, "{s:I, s:I, s:o, s:I, s:I}", "messageID", active->messagenum, "folderID",
+			active->foldernum, "flags", portal_message_flags_array(active), "utc", active->created, "bytes", active->size))) {
+			log_pedantic("Message packing attempt failed. { error = %s }", err.text);
+		}
+		else if (json_array_append_new_d(list, entry)) {
+			log_pedantic("The message object could not be appended to the result list. { error = %s }", err.text);
+			json_decref_d(entry);
+		}
+	}
+
+	meta_user_unlock(con->http.session->user);
+	mail_matches_free(matches);
+
+	portal_endpoint_response(con, "{s:s, s:o, s:I}", "jsonrpc", "2.0", "result", list, "id", con->http.portal.id);
+
 	return;
 }
 
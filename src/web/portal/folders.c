@@ -167,6 +167,8 @@ void portal_folder_mail_remove(connection_t *con, uint64_t foldernum) {
 		sess_serial_check(con->http.session, OBJECT_FOLDERS);
 	}
 
+	meta_snapshot_invalidate(con->http.session->user);
+
 	meta_user_unlock(con->http.session->user);
 
 	// Let the user know what happened.
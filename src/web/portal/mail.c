@@ -76,22 +76,24 @@ bool_t portal_outbound_checks(uint64_t usernum, stringer_t *username, stringer_t
 /**
  * @brief	Send (relay) a message composed by a user via a portal session.
  * @see	smtp_relay_message() - a lot of logic borrowed from here.
+ * @note	The message is handed to the outbound queue, which relays it in the background, unless the queue isn't running.
  * @param	from		a pointer to a managed string containing the email address specified as the From address.
- * @param	to			a pointer to a managed string containing the destination email address of the message.
+ * @param	to			an inx holder containing the destination email addresses of the message as managed strings.
  * @param	data		a pointer to a managed string containing the raw data of the mail message.
- * @param	send_size	if greater than 0, specify the optional SIZE parameter to the MAIL FROM command.
  * @param	errmsg		the address of a pointer to a null-terminated string that will be set to a descriptive error message on failure.
- * @return	true if the mail message was sent successfully, or false otherwise.
+ * @return	true if the mail message was queued or sent successfully, or false otherwise.
  */
-bool_t portal_smtp_relay_message(stringer_t *from, inx_t *to, stringer_t *data, size_t send_size, chr_t **errmsg) {
+bool_t portal_smtp_relay_message(stringer_t *from, inx_t *to, stringer_t *data, chr_t **errmsg) {
 
+	int_t state;
+	uint64_t count;
 	inx_cursor_t *cursor;
 	stringer_t *to_address;
-	client_t *client;
-	int_t state, nsentto = 0;
+	smtp_recipients_t *recipients;
+	size_t nsentto = 0;
 
 	if (!from || !to || !data || !errmsg) {
-		*errmsg = "Unexpected internal failure occurred while sending message.";
+		if (errmsg) *errmsg = "Unexpected internal failure occurred while sending message.";
 		return false;
 	}
 
@@ -100,40 +102,24 @@ bool_t portal_smtp_relay_message(stringer_t *from, inx_t *to, stringer_t *data,
 		return false;
 	}*/
 
-	// Open the connection to the SMTP server.
-	if (!(client = smtp_client_connect(0))) {
-		*errmsg = "Encountered transport error with relay server.";
-		return false;
-	}
-
-	// Send HELO.
-	if (smtp_client_send_helo(client)!= 1) {
-		*errmsg = "Handshake with relay server failed.";
-		smtp_client_close(client);
-		return false;
-	}
-
-	// Send MAIL FROM.
-	if ((state = smtp_client_send_mailfrom(client, from, send_size)) != 1) {
-		*errmsg = "Error occurred while sending From field to email server.";
-		smtp_client_close(client);
+	if (!(count = inx_count(to))) {
+		*errmsg = "Mail message could not be sent without recipient.";
 		return false;
 	}
 
-	// Send the RCPT TO command.
-	if (!(cursor = inx_cursor_alloc(to))) {
+	// Build the recipient list the queue expects.
+	if (!(recipients = mm_alloc(count * sizeof(smtp_recipients_t))) || !(cursor = inx_cursor_alloc(to))) {
 		*errmsg = "Internal occurred while expanding recipient list.";
-		smtp_client_close(client);
+		mm_cleanup(recipients);
 		return false;
 	}
 
-	while ((to_address = inx_cursor_value_next(cursor))) {
+	while (nsentto < count && (to_address = inx_cursor_value_next(cursor))) {
+		recipients[nsentto].address = to_address;
+		recipients[nsentto].next = NULL;
 
-		if ((state = smtp_client_send_rcptto(client, to_address)) != 1) {
-			*errmsg = "Error occurred while specifying recipient to email server.";
-			smtp_client_close(client);
-			inx_cursor_free(cursor);
-			return false;
+		if (nsentto) {
+			recipients[nsentto - 1].next = (struct smtp_recipients_t *)&recipients[nsentto];
 		}
 
 		nsentto++;
@@ -143,20 +129,18 @@ bool_t portal_smtp_relay_message(stringer_t *from, inx_t *to, stringer_t *data,
 
 	if (!nsentto) {
 		*errmsg = "Mail message could not be sent without recipient.";
-		smtp_client_close(client);
+		mm_free(recipients);
 		return false;
 	}
 
-	// Send the the message.
-	if ((state = smtp_client_send_data(client, data, true)) != 1) {
-		*errmsg = "Error occurred while sending email message body.";
-		smtp_client_close(client);
+	// Queue the message, using the default relay servers.
+	if ((state = smtp_queue_message(0, from, recipients, data, NULL)) != 1) {
+		*errmsg = state == -2 ? "The relay server rejected the email message." : "Encountered transport error with relay server.";
+		mm_free(recipients);
 		return false;
 	}
 
-	// Store the result.
-	//*result = st_dupe_opts(MANAGED_T | CONTIGUOUS | HEAP, &(client->line));
-	smtp_client_close(client);
+	mm_free(recipients);
 
 	// TODO: smtp_update_transmission_stats() needs to be called here.
 	return true;
@@ -10,6 +10,9 @@
 
 #define MAGMA_PORTAL_VERSION	"1.02"
 
+// The maximum number of unindexed messages a single search request will load and add to the full text index.
+#define PORTAL_SEARCH_INDEX_LIMIT 256
+
 // Definitions for the json-rpc 2.0 protocol specification
 enum {
 	JSON_RPC_2_ERROR_PARSE_MALFORMED       = -32700, /* Parse error: request was not well formed; invalid JSON was received by the server. */
@@ -164,7 +167,7 @@ void    portal_debug(connection_t *con);
 
 /// mail.c
 bool_t       portal_outbound_checks(uint64_t usernum, stringer_t *username, stringer_t *verification, stringer_t *from, size_t num_recipients, stringer_t *body_plain, stringer_t *body_html, chr_t **errmsg);
-bool_t       portal_smtp_relay_message(stringer_t *from, inx_t *to, stringer_t *data, size_t send_size, chr_t **errmsg);
+bool_t       portal_smtp_relay_message(stringer_t *from, inx_t *to, stringer_t *data, chr_t **errmsg);
 stringer_t * portal_smtp_create_data(inx_t *attachments, stringer_t *from, inx_t *to, inx_t *cc, inx_t *bcc, stringer_t *subject, stringer_t *body_plain, stringer_t *body_html);
 stringer_t * portal_smtp_merge_headers(inx_t *headers, stringer_t *leading, stringer_t *trailing);
 